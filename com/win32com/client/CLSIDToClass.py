@@ -18,6 +18,10 @@ Access.
 """
 mapCLSIDToClass = {}
 
+# Called by GetClass for a CLSID with no class registered - see
+# SetClassLoader.
+classLoader = None
+
 
 def RegisterCLSID(clsid, pythonClass):
     """Register a class that wraps a CLSID
@@ -46,7 +50,27 @@ def GetClass(clsid):
 
     clsid -- a string CLSID representation to check.
     """
-    return mapCLSIDToClass[clsid]
+    try:
+        return mapCLSIDToClass[clsid]
+    except KeyError:
+        if classLoader is None:
+            raise
+    cls = classLoader(clsid)
+    if cls is None:
+        raise KeyError(clsid)
+    return cls
+
+
+def SetClassLoader(loader):
+    """Set a function which loads the class for a CLSID on demand.
+
+    GetClass calls loader(clsid) for a CLSID with no class registered.  The
+    loader should import the module which registers the class and return
+    it, or return None if there is no such class.  The gencache module uses
+    this to load generated modules as their classes are needed.
+    """
+    global classLoader
+    classLoader = loader
 
 
 def HasClass(clsid):
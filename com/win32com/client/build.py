@@ -372,14 +372,24 @@ class DispatchItem(OleItem):
         bad_params = [flag for flag in param_flags if flag & (
             pythoncom.PARAMFLAG_FOUT | pythoncom.PARAMFLAG_FRETVAL) != 0]
         s = None
+        sigLine = None
         if len(bad_params) == 0 and len(retDesc) == 2 and retDesc[1] == 0:
             rd = retDesc[0]
+            if bMakeClass:
+                # Compile the type descriptions once, when the class is
+                # built, rather than on every call.
+                sigName = "_sig_" + name
+                sigLine = '%s%s = pythoncom.CompileInvokeTypes(%d, LCID, %s, %s, %s)' % (
+                    linePrefix, sigName, id, fdesc[4], retDesc, repr(argsDesc))
+                invoke = 'self.%s(self._oleobj_%s)' % (
+                    sigName, _BuildArgList(fdesc, names))
+            else:
+                invoke = 'self._oleobj_.InvokeTypes(%d, LCID, %s, %s, %s%s)' % (
+                    id, fdesc[4], retDesc, repr(argsDesc), _BuildArgList(fdesc, names))
             if rd in NoTranslateMap:
-                s = '%s\treturn self._oleobj_.InvokeTypes(%d, LCID, %s, %s, %s%s)' % (
-                    linePrefix, id, fdesc[4], retDesc, argsDesc, _BuildArgList(fdesc, names))
+                s = '%s\treturn %s' % (linePrefix, invoke)
             elif rd in [pythoncom.VT_DISPATCH, pythoncom.VT_UNKNOWN]:
-                s = '%s\tret = self._oleobj_.InvokeTypes(%d, LCID, %s, %s, %s%s)\n' % (
-                    linePrefix, id, fdesc[4], retDesc, repr(argsDesc), _BuildArgList(fdesc, names))
+                s = '%s\tret = %s\n' % (linePrefix, invoke)
                 s = s + '%s\tif ret is not None:\n' % (linePrefix,)
                 if rd == pythoncom.VT_UNKNOWN:
                     s = s + \
@@ -397,12 +407,13 @@ class DispatchItem(OleItem):
                 s = s + '%s\treturn ret' % (linePrefix)
             elif rd == pythoncom.VT_BSTR:
                 s = "%s\t# Result is a Unicode object\n" % (linePrefix,)
-                s = s + '%s\treturn self._oleobj_.InvokeTypes(%d, LCID, %s, %s, %s%s)' % (
-                    linePrefix, id, fdesc[4], retDesc, repr(argsDesc), _BuildArgList(fdesc, names))
+                s = s + '%s\treturn %s' % (linePrefix, invoke)
             # else s remains None
         if s is None:
             s = '%s\treturn self._ApplyTypes_(%d, %s, %s, %s, %s, %s%s)' % (linePrefix, id, fdesc[
                 4], retDesc, argsDesc, repr(name), resclsid, _BuildArgList(fdesc, names))
+        elif sigLine is not None:
+            ret.insert(0, sigLine)
 
         ret.append(s)
         ret.append("")
@@ -140,6 +140,7 @@ def Dispatch(IDispatch, userName=None, createClass=None, typeinfo=None,
     if createClass is None:
         createClass = CDispatch
     lazydata = None
+    attr = membercache = None
     try:
         if typeinfo is None:
             typeinfo = IDispatch.GetTypeInfo()
@@ -148,19 +149,27 @@ def Dispatch(IDispatch, userName=None, createClass=None, typeinfo=None,
                 # try for a typecomp
                 typecomp = typeinfo.GetTypeComp()
                 lazydata = typeinfo, typecomp
+                # Names bound via the typecomp are shared with all other
+                # objects of this type.
+                attr = typeinfo.GetTypeAttr()
+                membercache = pythoncom.GetMemberCache(attr[0], attr[1])
             except pythoncom.com_error:
                 pass
     except pythoncom.com_error:
         typeinfo = None
-    olerepr = MakeOleRepr(IDispatch, typeinfo, lazydata)
-    return createClass(IDispatch, olerepr, userName, lazydata=lazydata)
+    olerepr = MakeOleRepr(IDispatch, typeinfo, lazydata, attr)
+    ob = createClass(IDispatch, olerepr, userName, lazydata=lazydata)
+    if membercache is not None:
+        ob.__dict__['_membercache_'] = membercache
+    return ob
 
 
-def MakeOleRepr(IDispatch, typeinfo, typecomp):
+def MakeOleRepr(IDispatch, typeinfo, typecomp, attr=None):
     olerepr = None
     if typeinfo is not None:
         try:
-            attr = typeinfo.GetTypeAttr()
+            if attr is None:
+                attr = typeinfo.GetTypeAttr()
             # If the type info is a special DUAL interface, magically turn it into
             # a DISPATCH typeinfo.
             if attr[5] == pythoncom.TKIND_INTERFACE and attr[
@@ -207,6 +216,7 @@ class CDispatch:
         self.__dict__['_enum_'] = None
         self.__dict__['_unicode_to_string_'] = None
         self.__dict__['_lazydata_'] = lazydata
+        self.__dict__['_membercache_'] = None
 
     def __call__(self, *args):
         "Provide 'default dispatch' COM functionality - allow instance to be called"
@@ -443,9 +453,35 @@ class CDispatch:
     def _LazyAddAttr_(self, attr):
         if self._lazydata_ is None:
             return 0
-        res = 0
         typeinfo, typecomp = self._lazydata_
+        membercache = self._membercache_
         olerepr = self._olerepr_
+        # What a name binds to only depends on the type, so another object
+        # of this type may have already done the work.  Types with a null
+        # GUID have no cache.
+        cached = None
+        if membercache is not None:
+            cached = membercache.Lookup(attr)
+        if cached is None:
+            # Bind into an empty item, so we know exactly what was added.
+            scratch = build.DispatchItem()
+            res = self._BindLazyAttr_(typeinfo, typecomp, attr, scratch)
+            added = []
+            for mapName in ("propMap", "propMapGet", "propMapPut", "mapFuncs"):
+                for key, item in getattr(scratch, mapName).items():
+                    added.append((mapName, key, item))
+            cached = res, scratch.defaultDispatchName, tuple(added)
+            if membercache is not None:
+                membercache.Add(attr, cached)
+        res, defaultDispatchName, added = cached
+        for mapName, key, item in added:
+            getattr(olerepr, mapName)[key] = item
+        if defaultDispatchName is not None:
+            olerepr.defaultDispatchName = defaultDispatchName
+        return res
+
+    def _BindLazyAttr_(self, typeinfo, typecomp, attr, olerepr):
+        res = 0
         # We need to explicitly check each invoke type individually - simply
         # specifying '0' will bind to "any member", which may not be the one
         # we are actually after (ie, we may be after prop_get, but returned
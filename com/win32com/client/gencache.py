@@ -7,8 +7,8 @@ Description
 Implementation
   Each typelib is generated into a filename of format "{guid}x{lcid}x{major}x{minor}.py"
 
-  An external persistant dictionary maps from all known IIDs in all known type libraries
-  to the type library itself.
+  An external persistant index (see gencacheindex) maps from all known IIDs in all known
+  type libraries to the type library itself, and the name of the class generated for it.
 
   Thus, whenever Python code knows the IID of an object, it can find the IID, LCID and version of
   the type library which supports it.  Given this information, it can find the Python module
@@ -16,9 +16,9 @@ Implementation
 
   If necessary, this support can be generated on the fly.
 
-Hacks, to do, etc
-  Currently just uses a pickled dictionary, but should used some sort of indexed file.
-  Maybe an OLE2 compound file, or a bsddb file?
+  The index is memory mapped and searched in place, so loading it does not depend on
+  how many type libraries are in the cache.  Each save writes a new "dicts.N.idx" file,
+  as a file another process has mapped can't be replaced.
 """
 import glob
 import imp
@@ -30,7 +30,7 @@ import pywintypes
 import win32com
 import win32com.client
 
-from . import CLSIDToClass
+from . import CLSIDToClass, gencacheindex
 
 try:
     from imp import reload  # exported by the imp module in py3k.
@@ -41,8 +41,98 @@ except:
 # makepy.py
 bForDemandDefault = 0
 
+
+class _ClassIndex:
+    """Maps CLSID strings to (typelibCLSID, lcid, major, minor).
+
+    Behaves as a dictionary, with the entries read from the on-disk index
+    plus those added since it was loaded.
+    """
+
+    def __init__(self):
+        self._index = None
+        # clsid -> (typelib, kind, name), or None if deleted.
+        self._added = {}
+        # clsid -> the result of LookupClass, for entries from the index.
+        self._cache = {}
+
+    def SetIndex(self, index):
+        """Replaces the on-disk index, dropping all added entries."""
+        if self._index is not None:
+            self._index.Close()
+        self._index = index
+        self._added.clear()
+        self._cache.clear()
+
+    def LookupClass(self, clsid):
+        """Returns (typelib, kind, name) for a CLSID, or None."""
+        clsid = str(clsid)
+        try:
+            return self._added[clsid]
+        except KeyError:
+            pass
+        try:
+            return self._cache[clsid]
+        except KeyError:
+            pass
+        ret = None
+        if self._index is not None:
+            ret = self._index.Lookup(clsid)
+        self._cache[clsid] = ret
+        return ret
+
+    def Add(self, clsid, typelib, kind=gencacheindex.KIND_UNKNOWN, name=None):
+        self._added[str(clsid)] = typelib, kind, name
+
+    def Entries(self):
+        """Yields (clsid, typelib, kind, name) for every class."""
+        if self._index is not None:
+            for entry in self._index.Entries():
+                if entry[0] not in self._added:
+                    yield entry
+        for clsid, entry in list(self._added.items()):
+            if entry is not None:
+                yield (clsid,) + entry
+
+    def __getitem__(self, clsid):
+        entry = self.LookupClass(clsid)
+        if entry is None:
+            raise KeyError(clsid)
+        return entry[0]
+
+    def __setitem__(self, clsid, typelib):
+        self.Add(clsid, typelib)
+
+    def __delitem__(self, clsid):
+        self[clsid]  # KeyError if not present.
+        self._added[str(clsid)] = None
+
+    def __contains__(self, clsid):
+        return self.LookupClass(clsid) is not None
+
+    def get(self, clsid, default=None):
+        entry = self.LookupClass(clsid)
+        if entry is None:
+            return default
+        return entry[0]
+
+    def clear(self):
+        self.SetIndex(None)
+
+    def items(self):
+        return [(entry[0], entry[1]) for entry in self.Entries()]
+
+    def keys(self):
+        return [entry[0] for entry in self.Entries()]
+
+    def __iter__(self):
+        return iter(self.keys())
+
+    def __len__(self):
+        return len(self.keys())
+
 # The global dictionary
-clsidToTypelib = {}
+clsidToTypelib = _ClassIndex()
 
 # If we have a different version of the typelib generated, this
 # maps the "requested version" to the "generated version".
@@ -70,67 +160,85 @@ def __init__():
     # Initialize the module.  Called once explicitly at module import below.
     try:
         _LoadDicts()
-    except IOError:
+    except (IOError, gencacheindex.error):
         Rebuild()
-
-pickleVersion = 1
+    CLSIDToClass.SetClassLoader(_LoadClassForCLSID)
 
 
 def _SaveDicts():
     if is_readonly:
         raise RuntimeError("Trying to write to a readonly gencache ('%s')!"
                            % win32com.__gen_path__)
-    f = open(os.path.join(GetGeneratePath(), "dicts.dat"), "wb")
-    try:
-        p = pickle.Pickler(f)
-        p.dump(pickleVersion)
-        p.dump(clsidToTypelib)
-    finally:
-        f.close()
+    fname = gencacheindex.Save(GetGeneratePath(), clsidToTypelib.Entries())
+    # Map the new index, so what was added is no longer held in memory.
+    clsidToTypelib.SetIndex(gencacheindex.Open(fname))
 
 
 def _LoadDicts():
-    # Load the dictionary from a .zip file if that is where we live.
+    # Load the index from a .zip file if that is where we live.
     if is_zip:
-        import io as io
         loader = win32com.__loader__
         arc_path = loader.archive
-        dicts_path = os.path.join(win32com.__gen_path__, "dicts.dat")
-        if dicts_path.startswith(arc_path):
-            dicts_path = dicts_path[len(arc_path) + 1:]
-        else:
+        gen_path = win32com.__gen_path__
+        if not gen_path.startswith(arc_path):
             # Hm. See below.
             return
+        gen_path = gen_path[len(arc_path) + 1:]
+        import zipfile
+        zf = zipfile.ZipFile(arc_path)
         try:
-            data = loader.get_data(dicts_path)
-        except AttributeError:
-            # The __loader__ has no get_data method.  See below.
-            return
-        except IOError:
+            prefix = gen_path.replace("\\", "/") + "/"
+            names = [n[len(prefix):] for n in zf.namelist()
+                     if n.startswith(prefix)]
+        finally:
+            zf.close()
+        index_name = gencacheindex.FindIndexName(names)
+        if index_name is None:
             # Our gencache is in a .zip file (and almost certainly readonly)
-            # but no dicts file.  That actually needn't be fatal for a frozen
+            # but no index.  That actually needn't be fatal for a frozen
             # application.  Assuming they call "EnsureModule" with the same
             # typelib IDs they have been frozen with, that EnsureModule will
-            # correctly re-build the dicts on the fly.  However, objects that
+            # correctly re-build the index on the fly.  However, objects that
             # rely on the gencache but have not done an EnsureModule will
             # fail (but their apps are likely to fail running from source
             # with a clean gencache anyway, as then they would be getting
             # Dynamic objects until the cache is built - so the best answer
             # for these apps is to call EnsureModule, rather than freezing
-            # the dict)
+            # the index)
             return
-        f = io.StringIO(data)
+        try:
+            data = loader.get_data(os.path.join(gen_path, index_name))
+        except (AttributeError, IOError):
+            # The __loader__ has no get_data method.  See above.
+            return
+        index = gencacheindex.Index(data)
     else:
-        # NOTE: IOError on file open must be caught by caller.
-        f = open(os.path.join(win32com.__gen_path__, "dicts.dat"), "rb")
+        # NOTE: IOError must be caught by caller.
+        index_name = gencacheindex.FindIndexName(
+            os.listdir(win32com.__gen_path__))
+        if index_name is None:
+            _LoadLegacyDicts()
+            return
+        index = gencacheindex.Open(
+            os.path.join(win32com.__gen_path__, index_name))
+    clsidToTypelib.SetIndex(index)
+    versionRedirectMap.clear()
+
+
+def _LoadLegacyDicts():
+    # The pickled dictionary written by earlier versions - the index
+    # replaces it at the next save.
+    f = open(os.path.join(win32com.__gen_path__, "dicts.dat"), "rb")
     try:
         p = pickle.Unpickler(f)
         version = p.load()
-        global clsidToTypelib
-        clsidToTypelib = p.load()
-        versionRedirectMap.clear()
+        d = p.load()
     finally:
         f.close()
+    clsidToTypelib.clear()
+    for clsid, info in d.items():
+        clsidToTypelib[clsid] = info
+    versionRedirectMap.clear()
 
 
 def GetGeneratedFileName(clsid, lcid, major, minor):
@@ -213,6 +321,18 @@ def GetClassForCLSID(clsid):
         return None
 
 
+def _LoadClassForCLSID(clsid):
+    # The CLSIDToClass loader - import the module for a class we have
+    # generated.  Must not call CLSIDToClass.GetClass, which called us.
+    entry = clsidToTypelib.LookupClass(clsid)
+    if entry is None or entry[1] in (gencacheindex.KIND_VTABLE,
+                                     gencacheindex.KIND_VTABLE_PACKAGE):
+        return None
+    if GetModuleForCLSID(clsid) is None:
+        return None
+    return CLSIDToClass.mapCLSIDToClass.get(str(clsid))
+
+
 def GetModuleForProgID(progid):
     """Get a Python module for a Program ID
 
@@ -662,19 +782,21 @@ def AddModuleToCache(typelibclsid, lcid, major, minor,
     dict = mod.CLSIDToClassMap
     info = str(typelibclsid), lcid, major, minor
     for clsid, cls in dict.items():
-        clsidToTypelib[clsid] = info
+        clsidToTypelib.Add(clsid, info, gencacheindex.KIND_CLASS,
+                           cls.__name__)
 
     dict = mod.CLSIDToPackageMap
     for clsid, name in dict.items():
-        clsidToTypelib[clsid] = info
+        clsidToTypelib.Add(clsid, info, gencacheindex.KIND_PACKAGE, name)
 
     dict = mod.VTablesToClassMap
-    for clsid, cls in dict.items():
-        clsidToTypelib[clsid] = info
+    for clsid, name in dict.items():
+        clsidToTypelib.Add(clsid, info, gencacheindex.KIND_VTABLE, name)
 
     dict = mod.VTablesToPackageMap
-    for clsid, cls in dict.items():
-        clsidToTypelib[clsid] = info
+    for clsid, name in dict.items():
+        clsidToTypelib.Add(clsid, info, gencacheindex.KIND_VTABLE_PACKAGE,
+                           name)
 
     # If this lib was previously redirected, drop it
     if info in versionRedirectMap:
@@ -0,0 +1,314 @@
+"""The index of generated classes used by gencache.
+
+The index maps the CLSID of every class makepy has generated to the type
+library, and the name of the class within the module generated for it.  It
+replaces the pickled dictionary gencache used to load in full at startup:
+the index is a binary file which is memory mapped and searched in place, so
+opening it only checks the offsets in its tables, without building any
+objects for them, and processes using the same cache share a single copy
+of it.
+
+All values are little-endian.  The file is:
+  header -- "<8sIIIIII": MAGIC, VERSION, the number of type libraries,
+            the number of classes, and the offsets of the type library
+            table, the class table and the string table.
+  type libraries -- "<16sIHHII" each: the library's GUID, LCID, flags,
+            reserved, major and minor versions.  A version given as a
+            string is stored as a string offset, with flag bit 1 (major) or
+            2 (minor) set.
+  classes -- "<16sIII" each, sorted by CLSID: the CLSID, the index of its
+            type library, its kind (one of the KIND_ values) and the offset
+            of the class name.
+  strings -- a 16 bit length and that many UTF-8 bytes each.  NO_STRING
+            stands for None.
+
+GUIDs are stored in the byte order of uuid.UUID.bytes.
+
+Writers never modify an index that exists - each update is written as a new
+generation with a higher number, and old generations are deleted once no
+process has them mapped.
+
+This module only needs the standard library.
+"""
+
+import mmap
+import os
+import re
+import struct
+import uuid
+
+MAGIC = b"PYWGCIDX"
+VERSION = 1
+
+# Where the class comes from in the generated module.
+KIND_CLASS = 0  # CLSIDToClassMap
+KIND_PACKAGE = 1  # CLSIDToPackageMap - the name is of the child module.
+KIND_VTABLE = 2  # VTablesToClassMap
+KIND_VTABLE_PACKAGE = 3  # VTablesToPackageMap
+KIND_UNKNOWN = 4  # Only the type library is known.
+
+NO_STRING = 0xFFFFFFFF
+
+_header = struct.Struct("<8sIIIIII")
+_typelib = struct.Struct("<16sIHHII")
+_class = struct.Struct("<16sIII")
+
+_MAJOR_IS_STRING = 1
+_MINOR_IS_STRING = 2
+
+_index_file_re = re.compile(r"^dicts\.(\d+)\.idx$")
+
+
+class error(Exception):
+    pass
+
+
+def _GuidBytes(s):
+    """Returns the 16 bytes for a GUID string, or None if it is invalid"""
+    try:
+        return uuid.UUID(str(s)).bytes
+    except ValueError:
+        return None
+
+
+def _GuidString(b):
+    # The same form as str(pywintypes.IID(...))
+    return "{%s}" % (str(uuid.UUID(bytes=b)).upper(),)
+
+
+class Index:
+    """An index, read from a buffer (usually a memory mapped file)."""
+
+    def __init__(self, data, mapping=None):
+        self._data = data
+        self._mapping = mapping
+        if len(data) < _header.size:
+            raise error("The index is truncated")
+        magic, version, self._numTypelibs, self._numClasses, \
+            self._typelibsOffset, self._classesOffset, self._stringsOffset = \
+            _header.unpack_from(data, 0)
+        if magic != MAGIC or version != VERSION:
+            raise error("The file is not a version %d index" % (VERSION,))
+        end = self._classesOffset + self._numClasses * _class.size
+        if self._typelibsOffset + self._numTypelibs * _typelib.size > len(data) or \
+                end > len(data) or self._stringsOffset > len(data):
+            raise error("The index is truncated")
+        # Check what the tables refer to now, so a damaged index is rebuilt
+        # rather than failing in Lookup.
+        for i in range(self._numTypelibs):
+            guid, lcid, flags, reserved, major, minor = _typelib.unpack_from(
+                data, self._typelibsOffset + i * _typelib.size)
+            if flags & _MAJOR_IS_STRING:
+                self._CheckString(major)
+            if flags & _MINOR_IS_STRING:
+                self._CheckString(minor)
+        for i in range(self._numClasses):
+            clsid, typelib, kind, name = _class.unpack_from(
+                data, self._classesOffset + i * _class.size)
+            if typelib >= self._numTypelibs:
+                raise error("The index refers to a missing type library")
+            self._CheckString(name)
+        self._typelibs = {}
+
+    def _CheckString(self, offset):
+        if offset == NO_STRING:
+            return
+        offset += self._stringsOffset
+        if offset + 2 > len(self._data):
+            raise error("The index refers to a missing string")
+        size, = struct.unpack_from("<H", self._data, offset)
+        if offset + 2 + size > len(self._data):
+            raise error("The index refers to a missing string")
+
+    def Close(self):
+        if self._mapping is not None:
+            self._mapping.close()
+            self._mapping = None
+        self._data = None
+
+    def __len__(self):
+        return self._numClasses
+
+    def _GetString(self, offset):
+        if offset == NO_STRING:
+            return None
+        offset += self._stringsOffset
+        size, = struct.unpack_from("<H", self._data, offset)
+        return self._data[offset + 2:offset + 2 + size].decode("utf-8")
+
+    def _GetTypelib(self, index):
+        # (clsid, lcid, major, minor), cached as the same tuple is returned
+        # for every class in the library.
+        try:
+            return self._typelibs[index]
+        except KeyError:
+            pass
+        guid, lcid, flags, reserved, major, minor = _typelib.unpack_from(
+            self._data, self._typelibsOffset + index * _typelib.size)
+        if flags & _MAJOR_IS_STRING:
+            major = self._GetString(major)
+        if flags & _MINOR_IS_STRING:
+            minor = self._GetString(minor)
+        ret = self._typelibs[index] = _GuidString(guid), lcid, major, minor
+        return ret
+
+    def _GetClass(self, index):
+        clsid, typelib, kind, name = _class.unpack_from(
+            self._data, self._classesOffset + index * _class.size)
+        return _GuidString(clsid), self._GetTypelib(typelib), kind, \
+            self._GetString(name)
+
+    def Lookup(self, clsid):
+        """Returns (typelib, kind, name) for a CLSID, or None.
+
+        typelib is (typelibCLSID, lcid, major, minor)."""
+        key = _GuidBytes(clsid)
+        if key is None:
+            return None
+        data = self._data
+        base = self._classesOffset
+        size = _class.size
+        lo, hi = 0, self._numClasses
+        while lo < hi:
+            mid = (lo + hi) // 2
+            pos = base + mid * size
+            found = data[pos:pos + 16]
+            if found < key:
+                lo = mid + 1
+            elif found > key:
+                hi = mid
+            else:
+                return self._GetClass(mid)[1:]
+        return None
+
+    def Entries(self):
+        """Yields (clsid, typelib, kind, name) for every class."""
+        for i in range(self._numClasses):
+            yield self._GetClass(i)
+
+
+def Build(entries):
+    """Returns the bytes of an index for (clsid, typelib, kind, name) entries.
+
+    typelib is (typelibCLSID, lcid, major, minor).  Entries with invalid
+    CLSIDs are ignored, as are all but the last entry for each CLSID."""
+    strings = []
+    stringOffsets = {}
+    stringsSize = [0]
+
+    def AddString(s):
+        if s is None:
+            return NO_STRING
+        try:
+            return stringOffsets[s]
+        except KeyError:
+            pass
+        b = s.encode("utf-8")
+        ret = stringOffsets[s] = stringsSize[0]
+        strings.append(struct.pack("<H", len(b)) + b)
+        stringsSize[0] += 2 + len(b)
+        return ret
+
+    typelibs = []
+    typelibIndexes = {}
+    classes = {}
+    for clsid, typelib, kind, name in entries:
+        key = _GuidBytes(clsid)
+        if key is None:
+            continue
+        typelibIndex = typelibIndexes.get(typelib)
+        if typelibIndex is None:
+            tlbClsid, lcid, major, minor = typelib
+            tlbKey = _GuidBytes(tlbClsid)
+            if tlbKey is None:
+                continue
+            flags = 0
+            if not isinstance(major, int):
+                major = AddString(major)
+                flags |= _MAJOR_IS_STRING
+            if not isinstance(minor, int):
+                minor = AddString(minor)
+                flags |= _MINOR_IS_STRING
+            typelibIndex = typelibIndexes[typelib] = len(typelibs)
+            typelibs.append(_typelib.pack(tlbKey, lcid, flags, 0, major, minor))
+        classes[key] = _class.pack(key, typelibIndex, kind, AddString(name))
+
+    typelibsOffset = _header.size
+    classesOffset = typelibsOffset + len(typelibs) * _typelib.size
+    stringsOffset = classesOffset + len(classes) * _class.size
+    header = _header.pack(MAGIC, VERSION, len(typelibs), len(classes),
+                          typelibsOffset, classesOffset, stringsOffset)
+    return b"".join([header] + typelibs +
+                    [classes[k] for k in sorted(classes)] + strings)
+
+
+def Open(filename):
+    """Opens an index file, memory mapping it."""
+    f = open(filename, "rb")
+    try:
+        size = os.fstat(f.fileno()).st_size
+        if size == 0:
+            raise error("The index is empty")
+        mapping = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    finally:
+        f.close()
+    try:
+        return Index(mapping, mapping)
+    except:
+        mapping.close()
+        raise
+
+
+def _Generations(names):
+    ret = []
+    for name in names:
+        match = _index_file_re.match(name)
+        if match:
+            ret.append((int(match.group(1)), name))
+    ret.sort()
+    return ret
+
+
+def FindIndexName(names):
+    """Returns the latest index file among a list of file names, or None."""
+    generations = _Generations(names)
+    if generations:
+        return generations[-1][1]
+    return None
+
+
+def Save(dirname, entries):
+    """Writes a new generation of the index in a directory.
+
+    Returns the name of the new file."""
+    data = Build(entries)
+    generations = _Generations(os.listdir(dirname))
+    generation = generations[-1][0] if generations else 0
+    temp = os.path.join(dirname, "dicts.%d.temp" % (os.getpid(),))
+    f = open(temp, "wb")
+    try:
+        f.write(data)
+    finally:
+        f.close()
+    for attempt in range(10):
+        generation += 1
+        name = os.path.join(dirname, "dicts.%d.idx" % (generation,))
+        if os.path.exists(name):
+            continue
+        try:
+            os.rename(temp, name)
+            break
+        except os.error:
+            # Another process just wrote the same generation.
+            pass
+    else:
+        os.unlink(temp)
+        raise error("Could not find a free name for the index")
+    # Delete older generations - this fails for any still mapped by a
+    # process (on Windows), which are left for a later save to remove.
+    for old_generation, old_name in generations:
+        try:
+            os.unlink(os.path.join(dirname, old_name))
+        except os.error:
+            pass
+    return name
@@ -20,14 +20,39 @@ import time
 import pythoncom
 
 from . import build
+from . import tlbsnapshot
 
 error = "makepy.error"
-makepy_version = "0.5.01"  # Written to generated file.
+makepy_version = "0.5.02"  # Written to generated file.
 
 GEN_FULL = "full"
 GEN_DEMAND_BASE = "demand(base)"
 GEN_DEMAND_CHILD = "demand(child)"
 
+# The snapshot of the last library generated from, as ((guid, lcid, major,
+# minor), snapshot), so generating the children of a library one at a time
+# (see makepy.GenerateChildFromTypeLibSpec) reads the library just once.
+# Only one is kept, and makepy.GenerateFromTypeLibSpec drops it when done.
+lastSnapshot = None
+
+
+def SnapshotTypeLib(typelib):
+    global lastSnapshot
+    la = typelib.GetLibAttr()
+    key = str(la[0]), la[1], la[3], la[4]
+    if lastSnapshot is not None and lastSnapshot[0] == key:
+        return lastSnapshot[1]
+    ret = tlbsnapshot.SnapshotTypeLib(typelib)
+    lastSnapshot = key, ret
+    return ret
+
+
+def FlushSnapshotCache():
+    """Forgets the snapshot taken, so a rebuilt library is read again."""
+    global lastSnapshot
+    lastSnapshot = None
+
+
 # This map is used purely for the users benefit -it shows the
 # raw, underlying type of Alias/Enums, etc.  The COM implementation
 # does not use this map at runtime - all Alias/Enum have already
@@ -835,6 +860,11 @@ class Generator:
         self.bHaveWrittenDispatchBaseClass = 0
         self.bHaveWrittenCoClassBaseClass = 0
         self.bHaveWrittenEventBaseClass = 0
+        # Read the whole library up front with pythoncom.ExtractTypeLib -
+        # far faster than walking it a member at a time.
+        if hasattr(pythoncom, "ExtractTypeLib") and \
+                not isinstance(typelib, tlbsnapshot.TypeLib):
+            typelib = SnapshotTypeLib(typelib)
         self.typelib = typelib
         self.sourceFilename = sourceFilename
         self.bBuildHidden = bBuildHidden
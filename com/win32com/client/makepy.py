@@ -287,6 +287,8 @@ def GenerateFromTypeLibSpec(
 
     bToGenDir = (file is None)
 
+    # The library may have been rebuilt since its children were generated.
+    genpy.FlushSnapshotCache()
     for typelib, info in typelibs:
         gen = genpy.Generator(
             typelib,
@@ -333,6 +335,7 @@ def GenerateFromTypeLibSpec(
             gencache.AddModuleToCache(
                 info.clsid, info.lcid, info.major, info.minor)
 
+    genpy.FlushSnapshotCache()
     progress.Close()
 
 
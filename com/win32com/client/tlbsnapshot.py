@@ -0,0 +1,395 @@
+"""Snapshots of type libraries, for makepy to generate code from.
+
+genpy walks a type library through hundreds of thousands of small calls.
+pythoncom.ExtractTypeLib instead reads everything genpy needs in one native
+call.  It returns plain Python values, which the TypeLib and TypeInfo classes
+here present with the PyITypeLib and PyITypeInfo methods genpy uses.
+
+Snapshots can be pickled (see Save and Load) and used again later without
+the type library.  This module only needs the standard library, so a saved
+snapshot can also be inspected, or tested, on machines without COM.
+
+A snapshot (format version 1) is a dictionary:
+  version -- FORMAT_VERSION.
+  libattr -- the TLIBATTR tuple, with the IID as a string.
+  doc -- the library's documentation tuple.
+  count -- the number of types in the library.
+  types -- a list of types.  The first 'count' are the library's own types,
+           in order.  After them come other types those refer to.
+
+Each type is a dictionary:
+  attr -- the TYPEATTR tuple, with the IID as a string.
+  doc -- the (name, docstring, helpContext, helpFile) tuple, or None.
+  funcs -- a tuple with a (FUNCDESC tuple, names, doc) tuple per function.
+           names and doc are None if they could not be read.
+  vars -- the same for each VARDESC.
+  impl -- a dict of {index: (href, implTypeFlags)} for the implemented
+          types.  The interface of a dual dispinterface has index -1.
+  refs -- a dict of {href: index into types} for the types referred to.
+  badrefs -- a dict of {href: hresult} for referred types which could not
+             be loaded.
+
+funcs, vars and impl are None for types from other libraries which are only
+referred to as argument or result types, as only their attributes are needed.
+"""
+
+import pickle
+
+try:
+    from pywintypes import IID, com_error
+except ImportError:
+    # No COM - IIDs stay as strings.
+    def IID(s):
+        return s
+
+    class com_error(Exception):
+        def __init__(self, *args):
+            Exception.__init__(self, *args)
+            self.hresult = args[0]
+
+FORMAT_VERSION = 1
+
+TYPE_E_ELEMENTNOTFOUND = -2147319765
+
+_attr_names = (
+    "iid", "lcid", "memidConstructor", "memidDestructor", "cbSizeInstance",
+    "typekind", "cFuncs", "cVars", "cImplTypes", "cbSizeVft", "cbAlignment",
+    "wTypeFlags", "wMajorVerNum", "wMinorVerNum", "tdescAlias", "idldescType")
+_funcdesc_names = (
+    "memid", "scodeArray", "args", "funckind", "invkind", "callconv",
+    "cParamsOpt", "oVft", "rettype", "wFuncFlags")
+_vardesc_names = ("memid", "value", "elemdescVar", "wVarFlags", "varkind")
+
+
+class _Desc(object):
+    """A description which, like the pythoncom objects, can be used either
+    as a tuple or by attribute name."""
+    __slots__ = ()
+
+    def __init__(self, values):
+        for name, value in zip(self.__slots__, values):
+            setattr(self, name, value)
+
+    def __len__(self):
+        return len(self.__slots__)
+
+    def __getitem__(self, index):
+        return getattr(self, self.__slots__[index])
+
+    def __iter__(self):
+        for name in self.__slots__:
+            yield getattr(self, name)
+
+    def __repr__(self):
+        return "%s(%r)" % (self.__class__.__name__, tuple(self))
+
+
+class TYPEATTR(_Desc):
+    __slots__ = _attr_names
+
+
+class FUNCDESC(_Desc):
+    __slots__ = _funcdesc_names
+
+
+class VARDESC(_Desc):
+    __slots__ = _vardesc_names
+
+
+def _NotFound():
+    return com_error(TYPE_E_ELEMENTNOTFOUND, "Element not found.", None, None)
+
+
+class TypeInfo:
+    """A type from a snapshot, with the methods of a PyITypeInfo."""
+
+    def __init__(self, typelib, index):
+        self._typelib = typelib
+        self._index = index
+        self._type = typelib.data["types"][index]
+        self._members = None
+
+    def __repr__(self):
+        return "<TypeInfo %s from snapshot of %s>" % (
+            self._type["attr"][0], self._typelib.data["doc"][0])
+
+    def _GetMember(self, memid):
+        # memid -> (names, doc), built on first use.
+        if self._members is None:
+            members = {}
+            for desc, names, doc in self._GetList("funcs") + self._GetList("vars"):
+                members.setdefault(desc[0], (names, doc))
+            self._members = members
+        return self._members.get(memid, (None, None))
+
+    def _GetList(self, key):
+        ret = self._type[key]
+        if ret is None:
+            raise ValueError(
+                "The snapshot has no %s for %s" % (key, self._type["doc"]))
+        return ret
+
+    def GetContainingTypeLib(self):
+        # Types from other libraries only keep their own attributes.
+        if self._index >= self._typelib.data["count"]:
+            raise _NotFound()
+        return self._typelib, self._index
+
+    def GetTypeAttr(self):
+        attr = TYPEATTR(self._type["attr"])
+        attr.iid = IID(attr.iid)
+        return attr
+
+    def GetDocumentation(self, memid):
+        if memid == -1:
+            doc = self._type["doc"]
+        else:
+            doc = self._GetMember(memid)[1]
+        if doc is None:
+            raise _NotFound()
+        return doc
+
+    def GetNames(self, memid):
+        names = self._GetMember(memid)[0]
+        if names is None:
+            raise _NotFound()
+        return names
+
+    def GetFuncDesc(self, index):
+        funcs = self._GetList("funcs")
+        if not 0 <= index < len(funcs):
+            raise _NotFound()
+        # genpy updates the descriptions, so each call returns a new one.
+        return FUNCDESC(funcs[index][0])
+
+    def GetVarDesc(self, index):
+        vars = self._GetList("vars")
+        if not 0 <= index < len(vars):
+            raise _NotFound()
+        return VARDESC(vars[index][0])
+
+    def GetImplTypeFlags(self, index):
+        try:
+            return self._GetList("impl")[index][1]
+        except KeyError:
+            raise _NotFound()
+
+    def GetRefTypeOfImplType(self, index):
+        try:
+            return self._GetList("impl")[index][0]
+        except KeyError:
+            raise _NotFound()
+
+    def GetRefTypeInfo(self, href):
+        index = self._type["refs"].get(href)
+        if index is not None:
+            return self._typelib._GetTypeInfo(index)
+        hr = self._type["badrefs"].get(href)
+        if hr is not None:
+            raise com_error(hr, None, None, None)
+        raise _NotFound()
+
+
+class TypeLib:
+    """A snapshot of a type library, with the methods of a PyITypeLib."""
+
+    def __init__(self, data):
+        if data.get("version") != FORMAT_VERSION:
+            raise ValueError(
+                "Type library snapshot version %r is not supported" %
+                (data.get("version"),))
+        self.data = data
+        self._infos = {}
+
+    def __repr__(self):
+        return "<TypeLib snapshot of %s>" % (self.data["doc"][0],)
+
+    def _GetTypeInfo(self, index):
+        try:
+            return self._infos[index]
+        except KeyError:
+            ret = self._infos[index] = TypeInfo(self, index)
+            return ret
+
+    def _CheckIndex(self, index):
+        if not 0 <= index < self.data["count"]:
+            raise _NotFound()
+
+    def GetLibAttr(self):
+        la = self.data["libattr"]
+        return (IID(la[0]),) + tuple(la[1:])
+
+    def GetDocumentation(self, index):
+        if index == -1:
+            return self.data["doc"]
+        self._CheckIndex(index)
+        doc = self.data["types"][index]["doc"]
+        if doc is None:
+            raise _NotFound()
+        return doc
+
+    def GetTypeInfoCount(self):
+        return self.data["count"]
+
+    def GetTypeInfo(self, index):
+        self._CheckIndex(index)
+        return self._GetTypeInfo(index)
+
+    def GetTypeInfoType(self, index):
+        self._CheckIndex(index)
+        return self.data["types"][index]["attr"][5]
+
+
+def _GetUserDefinedHref(tdesc):
+    # The href of the user defined type at the bottom of a TYPEDESC
+    # (see build._ResolveType), or None.
+    VT_PTR, VT_SAFEARRAY, VT_CARRAY, VT_USERDEFINED = 26, 27, 28, 29
+    while isinstance(tdesc, tuple):
+        vt, sub = tdesc
+        if vt in (VT_PTR, VT_SAFEARRAY):
+            tdesc = sub
+        elif vt == VT_CARRAY:
+            tdesc = sub[0]
+        elif vt == VT_USERDEFINED:
+            return sub
+        else:
+            break
+    return None
+
+
+class _Extractor:
+    # A Python version of pythoncom.ExtractTypeLib.  See TypeLibExtract.cpp -
+    # this follows it step by step.
+
+    def __init__(self, typelib):
+        self.libattr = typelib.GetLibAttr()
+        self.types = []
+        self.infos = []
+        self.keys = {}
+        self.queue = []
+
+    def _Call(self, func, *args):
+        try:
+            return func(*args)
+        except com_error:
+            return None
+
+    def FindOrAddType(self, info, full):
+        try:
+            lib, index = info.GetContainingTypeLib()
+            la = lib.GetLibAttr()
+        except com_error:
+            key = id(info)
+        else:
+            own = self.libattr
+            if (la[0], la[1], la[3], la[4]) == (own[0], own[1], own[3], own[4]):
+                key = index
+            else:
+                key = (str(la[0]), la[1], la[3], la[4], index)
+        ret = self.keys.get(key)
+        if ret is None:
+            ret = self.keys[key] = len(self.types)
+            self.infos.append(info)
+            self.types.append(None)
+        elif not full:
+            return ret
+        self.queue.append((ret, full))
+        return ret
+
+    def AddRef(self, info, entry, href, full):
+        if href is None or (not full and href in entry["refs"]):
+            return
+        try:
+            ref = info.GetRefTypeInfo(href)
+        except com_error as details:
+            entry["badrefs"][href] = details.hresult
+        else:
+            entry["refs"][href] = self.FindOrAddType(ref, full)
+
+    def Describe(self, info):
+        attr = tuple(info.GetTypeAttr())
+        attr = (str(attr[0]),) + attr[1:]
+        entry = {"attr": attr, "doc": self._Call(info.GetDocumentation, -1),
+                 "funcs": None, "vars": None, "impl": None,
+                 "refs": {}, "badrefs": {}}
+        if attr[5] == 6:  # TKIND_ALIAS
+            self.AddRef(info, entry, _GetUserDefinedHref(attr[14]), False)
+        return entry
+
+    def Expand(self, info, entry):
+        attr = entry["attr"]
+        funcs = []
+        for i in range(attr[6]):
+            desc = tuple(info.GetFuncDesc(i))
+            funcs.append((desc, self._Call(info.GetNames, desc[0]),
+                          self._Call(info.GetDocumentation, desc[0])))
+            self.AddRef(info, entry, _GetUserDefinedHref(desc[8][0]), False)
+            for arg in desc[2]:
+                self.AddRef(info, entry, _GetUserDefinedHref(arg[0]), False)
+        entry["funcs"] = tuple(funcs)
+        vars = []
+        for i in range(attr[7]):
+            desc = tuple(info.GetVarDesc(i))
+            vars.append((desc, self._Call(info.GetNames, desc[0]),
+                         self._Call(info.GetDocumentation, desc[0])))
+            self.AddRef(info, entry, _GetUserDefinedHref(desc[2][0]), False)
+        entry["vars"] = tuple(vars)
+        impl = entry["impl"] = {}
+        # TKIND_DISPATCH and TYPEFLAG_FDUAL
+        first = -1 if attr[5] == 4 and attr[11] & 0x40 else 0
+        for i in range(first, attr[8]):
+            href = info.GetRefTypeOfImplType(i)
+            impl[i] = href, info.GetImplTypeFlags(i) if i >= 0 else 0
+            self.AddRef(info, entry, href, True)
+
+    def Extract(self, typelib):
+        count = typelib.GetTypeInfoCount()
+        for i in range(count):
+            self.FindOrAddType(typelib.GetTypeInfo(i), True)
+        pos = 0
+        while pos < len(self.queue):
+            index, full = self.queue[pos]
+            pos += 1
+            info = self.infos[index]
+            entry = self.types[index]
+            if entry is None:
+                entry = self.types[index] = self.Describe(info)
+            if full and entry["funcs"] is None:
+                self.Expand(info, entry)
+        la = self.libattr
+        return {"version": FORMAT_VERSION,
+                "libattr": (str(la[0]),) + tuple(la[1:]),
+                "doc": typelib.GetDocumentation(-1),
+                "count": count,
+                "types": self.types}
+
+
+def ExtractTypeLib(typelib):
+    """Returns a snapshot of a PyITypeLib, using Python rather than
+    pythoncom.ExtractTypeLib."""
+    return _Extractor(typelib).Extract(typelib)
+
+
+def SnapshotTypeLib(typelib):
+    """Returns a TypeLib for a snapshot of a PyITypeLib."""
+    import pythoncom
+    extract = getattr(pythoncom, "ExtractTypeLib", ExtractTypeLib)
+    return TypeLib(extract(typelib))
+
+
+def Save(typelib, filename):
+    """Saves the snapshot in a TypeLib to a file."""
+    f = open(filename, "wb")
+    try:
+        pickle.dump(typelib.data, f, 2)
+    finally:
+        f.close()
+
+
+def Load(filename):
+    """Returns a TypeLib for a snapshot saved by Save."""
+    f = open(filename, "rb")
+    try:
+        return TypeLib(pickle.load(f))
+    finally:
+        f.close()
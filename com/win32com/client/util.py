@@ -92,10 +92,17 @@ class EnumVARIANT(Enumerator):
 
 
 class Iterator:
+    """An iterator over a COM enumerator, as used by __iter__ on Dispatch objects.
+
+    Items are fetched from the enumerator in batches of up to maxBatch
+    (see PyIEnumVARIANT.Iter); set maxBatch to 1 to fetch them one at a time.
+    """
+    maxBatch = 64
 
     def __init__(self, enum, resultCLSID=None):
         self.resultCLSID = resultCLSID
-        self._iter_ = iter(enum.QueryInterface(pythoncom.IID_IEnumVARIANT))
+        self._iter_ = enum.QueryInterface(
+            pythoncom.IID_IEnumVARIANT).Iter(self.maxBatch)
 
     def __iter__(self):
         return self
@@ -474,6 +474,12 @@ class DesignatedWrapPolicy(MappedWrapPolicy):
 
        _Evaluate -- Dunno what this means, except the host has called Invoke with dispid==DISPID_EVALUATE!
                     See the COM documentation for details.
+
+       The methods are looked up once, when the object is wrapped, and
+       called directly by the COM framework (see _dispid_to_callable_)
+       unless _invokeex_ or one of the other invoke handlers is replaced.
+       Assigning a different method to the object after it is wrapped
+       will not be seen by COM clients.
     """
 
     def _wrap_(self, ob):
@@ -561,6 +567,25 @@ class DesignatedWrapPolicy(MappedWrapPolicy):
                 next_dispid = self._allocnextdispid(next_dispid)
             self._dispid_to_func_[dispid] = name
         self._typeinfos_ = None  # load these on demand.
+        self._dispid_to_callable_ = self._build_dispid_to_callable_()
+
+    def _build_dispid_to_callable_(self):
+        # The COM gateway calls the methods in this map directly, rather
+        # than via _Invoke_/_InvokeEx_ and _invokeex_ below.  This is only
+        # valid while nothing has replaced that default handling.
+        for name, cls in (("_Invoke_", BasicWrapPolicy),
+                          ("_invoke_", BasicWrapPolicy),
+                          ("_InvokeEx_", BasicWrapPolicy),
+                          ("_invokeex_", DesignatedWrapPolicy)):
+            method = getattr(self, name)
+            if getattr(method, "__func__", None) is not cls.__dict__[name]:
+                return None
+        ret = {}
+        for dispid, funcname in self._dispid_to_func_.items():
+            func = getattr(self._obj_, funcname, None)
+            if func is not None and callable(func):
+                ret[dispid] = func
+        return ret
 
     def _build_typeinfos_(self):
         # Can only ever be one for now.
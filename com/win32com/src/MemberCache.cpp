@@ -0,0 +1,281 @@
+// MemberCache.cpp - a process wide cache of member lookups, keyed by type.
+//
+// win32com.client.dynamic resolves attribute names by binding them against
+// the object's ITypeComp.  The result depends only on the type, so rather
+// than having every CDispatch repeat that work, the results are stored here
+// in one table per (IID, LCID) which all objects of that type share.
+//
+// The cache is bounded - once it holds more than the maximum number of
+// entries the tables are emptied, and once there are too many types the
+// tables are discarded entirely.  All state is only touched with the GIL
+// held, which is what makes it safe to share between threads.
+// @doc
+#include "stdafx.h"
+#include "PythonCOM.h"
+
+// The default maximum number of names cached over all types.
+#define PYCOM_MEMBER_CACHE_DEFAULT_MAX 8192
+// The maximum number of types before all tables are discarded.
+#define PYCOM_MEMBER_CACHE_MAX_TYPES 1024
+
+struct PyMemberCache {
+	PyObject_HEAD
+	PyObject *obIID;
+	LCID lcid;
+	// name -> cached value.  NULL once the table is discarded.
+	PyObject *members;
+};
+
+static PyObject *g_obMemberCaches = NULL; // (iid, lcid) -> PyMemberCache
+static Py_ssize_t g_memberCacheMax = PYCOM_MEMBER_CACHE_DEFAULT_MAX;
+static Py_ssize_t g_memberCacheEntries = 0;
+static unsigned long g_memberCacheHits = 0;
+static unsigned long g_memberCacheMisses = 0;
+static unsigned long g_memberCacheEvictions = 0;
+
+// Empties all tables.  If bDiscard, the tables are also removed from the
+// registry, so objects still holding them no longer cache anything.
+static void FlushMemberCaches(BOOL bDiscard)
+{
+	PyObject *caches = g_obMemberCaches;
+	if (caches == NULL)
+		return;
+	// Update our state before releasing anything.
+	if (bDiscard)
+		g_obMemberCaches = NULL;
+	g_memberCacheEntries = 0;
+	PyObject *key, *value;
+	Py_ssize_t pos = 0;
+	while (PyDict_Next(caches, &pos, &key, &value)) {
+		PyMemberCache *cache = (PyMemberCache *)value;
+		if (cache->members == NULL)
+			continue;
+		g_memberCacheEvictions += (unsigned long)PyDict_Size(cache->members);
+		if (bDiscard)
+			Py_CLEAR(cache->members);
+		else
+			PyDict_Clear(cache->members);
+	}
+	if (bDiscard)
+		Py_DECREF(caches);
+}
+
+static void PyMemberCache_dealloc(PyObject *self)
+{
+	PyMemberCache *cache = (PyMemberCache *)self;
+	Py_XDECREF(cache->obIID);
+	Py_XDECREF(cache->members);
+	PyObject_Del(self);
+}
+
+// @pymethod object|PyMemberCache|Lookup|Returns the value cached for a name.
+static PyObject *PyMemberCache_Lookup(PyObject *self, PyObject *args)
+{
+	PyMemberCache *cache = (PyMemberCache *)self;
+	PyObject *name, *def = Py_None;
+	// @pyparm string|name||The name to look up.
+	// @pyparm object|default|None|The value to return if the name is not cached.
+	if (!PyArg_ParseTuple(args, "O|O:Lookup", &name, &def))
+		return NULL;
+	PyObject *ret = cache->members ? PyDict_GetItem(cache->members, name) : NULL;
+	if (ret == NULL) {
+		if (PyErr_Occurred())
+			return NULL;
+		g_memberCacheMisses++;
+		ret = def;
+	} else
+		g_memberCacheHits++;
+	Py_INCREF(ret);
+	return ret;
+}
+
+// @pymethod |PyMemberCache|Add|Caches a value for a name.
+static PyObject *PyMemberCache_Add(PyObject *self, PyObject *args)
+{
+	PyMemberCache *cache = (PyMemberCache *)self;
+	PyObject *name, *value;
+	// @pyparm string|name||The name.
+	// @pyparm object|value||The value to cache.  This should not refer to
+	// any particular object, as it is shared by all objects of the type.
+	if (!PyArg_ParseTuple(args, "OO:Add", &name, &value))
+		return NULL;
+	// @comm The value is silently dropped if the cache is disabled or this
+	// table has been discarded.
+	if (cache->members != NULL && g_memberCacheMax > 0) {
+		BOOL bNew = PyDict_GetItem(cache->members, name) == NULL;
+		if (bNew) {
+			if (PyErr_Occurred())
+				return NULL;
+			if (g_memberCacheEntries >= g_memberCacheMax)
+				FlushMemberCaches(FALSE);
+		}
+		if (PyDict_SetItem(cache->members, name, value) != 0)
+			return NULL;
+		// Only a new name adds an entry - replacing a value doesn't.
+		if (bNew)
+			g_memberCacheEntries++;
+	}
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+// @object PyMemberCache|The cached member lookups for one type, as returned
+// by <om pythoncom.GetMemberCache>.
+static struct PyMethodDef PyMemberCache_methods[] = {
+	{"Lookup", PyMemberCache_Lookup, 1}, // @pymeth Lookup|Returns the value cached for a name.
+	{"Add",    PyMemberCache_Add, 1}, // @pymeth Add|Caches a value for a name.
+	{NULL}
+};
+
+#define OFF(e) offsetof(PyMemberCache, e)
+static struct PyMemberDef PyMemberCache_members[] = {
+	{"iid",  T_OBJECT, OFF(obIID), READONLY}, // @prop <o PyIID>|iid|The IID of the type.
+	{"lcid", T_ULONG,  OFF(lcid), READONLY}, // @prop int|lcid|The locale of the type.
+	{NULL}
+};
+#undef OFF
+
+PyTypeObject PyMemberCacheType =
+{
+	PYWIN_OBJECT_HEAD
+	"PyMemberCache",
+	sizeof(PyMemberCache),
+	0,
+	PyMemberCache_dealloc,	/* tp_dealloc */
+	0,						/* tp_print */
+	0,						/* tp_getattr */
+	0,						/* tp_setattr */
+	0,						/* tp_compare */
+	0,						/* tp_repr */
+	0,						/* tp_as_number */
+	0,						/* tp_as_sequence */
+	0,						/* tp_as_mapping */
+	0,						/* tp_hash */
+	0,						/* tp_call */
+	0,						/* tp_str */
+	PyObject_GenericGetAttr,	/* tp_getattro */
+	0,						/* tp_setattro */
+	0,						/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,		/* tp_flags */
+	0,						/* tp_doc */
+	0,						/* tp_traverse */
+	0,						/* tp_clear */
+	0,						/* tp_richcompare */
+	0,						/* tp_weaklistoffset */
+	0,						/* tp_iter */
+	0,						/* tp_iternext */
+	PyMemberCache_methods,	/* tp_methods */
+	PyMemberCache_members,	/* tp_members */
+};
+
+// @pymethod <o PyMemberCache>|pythoncom|GetMemberCache|Returns the member cache shared by all objects of a type.
+PyObject *pythoncom_GetMemberCache(PyObject *self, PyObject *args)
+{
+	PyObject *obIID;
+	LCID lcid;
+	IID iid;
+	// @pyparm <o PyIID>|iid||The IID of the type, as returned in its TYPEATTR.
+	// @pyparm int|lcid||The locale of the type, as returned in its TYPEATTR.
+	if (!PyArg_ParseTuple(args, "Ok:GetMemberCache", &obIID, &lcid))
+		return NULL;
+	if (!PyWinObject_AsIID(obIID, &iid))
+		return NULL;
+	// Types without a GUID can't be told apart, so they get no cache.
+	if (IsEqualGUID(iid, GUID_NULL)) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+	if (g_obMemberCaches == NULL) {
+		g_obMemberCaches = PyDict_New();
+		if (g_obMemberCaches == NULL)
+			return NULL;
+	}
+	PyObject *key = Py_BuildValue("Nk", PyWinObject_FromIID(iid), lcid);
+	if (key == NULL)
+		return NULL;
+	PyObject *ret = PyDict_GetItem(g_obMemberCaches, key);
+	if (ret != NULL) {
+		Py_DECREF(key);
+		Py_INCREF(ret);
+		return ret;
+	}
+	if (PyDict_Size(g_obMemberCaches) >= PYCOM_MEMBER_CACHE_MAX_TYPES) {
+		FlushMemberCaches(TRUE);
+		g_obMemberCaches = PyDict_New();
+		if (g_obMemberCaches == NULL) {
+			Py_DECREF(key);
+			return NULL;
+		}
+	}
+	PyMemberCache *cache = PyObject_New(PyMemberCache, &PyMemberCacheType);
+	if (cache == NULL) {
+		Py_DECREF(key);
+		return NULL;
+	}
+	cache->obIID = PyTuple_GET_ITEM(key, 0);
+	Py_INCREF(cache->obIID);
+	cache->lcid = lcid;
+	cache->members = PyDict_New();
+	if (cache->members == NULL || PyDict_SetItem(g_obMemberCaches, key, (PyObject *)cache) != 0) {
+		Py_DECREF(key);
+		Py_DECREF(cache);
+		return NULL;
+	}
+	Py_DECREF(key);
+	return (PyObject *)cache;
+	// @rdesc The cache for the type, or None if iid is IID_NULL.
+	// @comm The cache is used by win32com.client.dynamic to share the results
+	// of binding names between all objects of the same type.
+}
+
+// @pymethod dict|pythoncom|GetMemberCacheStats|Returns statistics about the member cache.
+PyObject *pythoncom_GetMemberCacheStats(PyObject *self, PyObject *args)
+{
+	if (!PyArg_ParseTuple(args, ":GetMemberCacheStats"))
+		return NULL;
+	// @rdesc The result is a dictionary with the following keys.
+	// @flagh Key|Description
+	// @flag hits|The number of lookups which found a value.
+	// @flag misses|The number of lookups which did not.
+	// @flag entries|The number of names currently cached.
+	// @flag types|The number of types with a cache.
+	// @flag evictions|The number of names dropped because the cache was full.
+	// @flag max_entries|The maximum number of names cached.
+	return Py_BuildValue("{s:k,s:k,s:n,s:n,s:k,s:n}",
+		"hits", g_memberCacheHits,
+		"misses", g_memberCacheMisses,
+		"entries", g_memberCacheEntries,
+		"types", g_obMemberCaches ? PyDict_Size(g_obMemberCaches) : (Py_ssize_t)0,
+		"evictions", g_memberCacheEvictions,
+		"max_entries", g_memberCacheMax);
+}
+
+// @pymethod int|pythoncom|SetMemberCacheSize|Sets the maximum number of names held by the member cache.
+PyObject *pythoncom_SetMemberCacheSize(PyObject *self, PyObject *args)
+{
+	Py_ssize_t size;
+	// @pyparm int|size||The new maximum.  Zero disables the cache.
+	if (!PyArg_ParseTuple(args, "n:SetMemberCacheSize", &size))
+		return NULL;
+	if (size < 0) {
+		PyErr_SetString(PyExc_ValueError, "The size can not be negative");
+		return NULL;
+	}
+	Py_ssize_t old = g_memberCacheMax;
+	g_memberCacheMax = size;
+	if (g_memberCacheEntries > size)
+		FlushMemberCaches(FALSE);
+	// @rdesc The previous maximum.
+	return PyInt_FromSsize_t(old);
+}
+
+// @pymethod |pythoncom|ClearMemberCache|Empties the member cache and resets its statistics.
+PyObject *pythoncom_ClearMemberCache(PyObject *self, PyObject *args)
+{
+	if (!PyArg_ParseTuple(args, ":ClearMemberCache"))
+		return NULL;
+	FlushMemberCaches(FALSE);
+	g_memberCacheHits = g_memberCacheMisses = g_memberCacheEvictions = 0;
+	Py_INCREF(Py_None);
+	return Py_None;
+}
@@ -34,6 +34,24 @@ LONG _PyCom_GetGatewayCount(void)
 	return cGateways;
 }
 
+// The GetIDsOfNames cache.  Late-bound clients resolve a name before almost
+// every call, so each gateway remembers the DISPIDs its policy returned for
+// single names, and looks them up without entering Python.
+#define PYCOM_NAME_CACHE_BUCKETS 32
+// The maximum number of names cached by one gateway.
+#define PYCOM_NAME_CACHE_MAX 256
+
+struct PyGatewayNameCacheEntry {
+	PyGatewayNameCacheEntry *next;
+	ULONG hash;
+	LCID lcid;
+	DISPID dispid;
+	OLECHAR name[1]; // Allocated to the length of the name.
+};
+
+static LONG g_nameCacheHits = 0;
+static LONG g_nameCacheMisses = 0;
+
 // Helper function to handle the IDispatch results
 static HRESULT GetIDispatchErrorResult(PyObject *logProvider, EXCEPINFO *pexcepinfo)
 {
@@ -92,6 +110,11 @@ PyGatewayBase::PyGatewayBase(PyObject *instance)
 	m_cRef = 1;
 	m_pPyObject = instance;
 	Py_XINCREF(instance); // instance should never be NULL - but whats an X between friends!
+	m_obDispidToCallable = NULL;
+	InitializeCriticalSection(&m_csNameCache);
+	m_ppNameCache = NULL;
+	m_cNameCache = 0;
+	m_nameCacheHits = m_nameCacheMisses = 0;
 
 	PyCom_DLLAddRef();
 
@@ -112,15 +135,111 @@ PyGatewayBase::~PyGatewayBase()
 		{
 			CEnterLeavePython celp;
 			Py_DECREF(m_pPyObject);
+			Py_XDECREF(m_obDispidToCallable);
 		}
 	}
 	if (m_pBaseObject)
 	{
 		m_pBaseObject->Release();
 	}
+	InvalidateNameCache();
+	DeleteCriticalSection(&m_csNameCache);
 	PyCom_DLLReleaseRef();
 }
 
+// Finds a name in a chain of the name cache.  Names are compared case
+// insensitively, as OLE requires of GetIDsOfNames.
+static PyGatewayNameCacheEntry *FindCachedName(PyGatewayNameCacheEntry *entry, OLECHAR *name, ULONG hash, LCID lcid)
+{
+	for (; entry != NULL; entry = entry->next) {
+		if (entry->hash == hash && entry->lcid == lcid &&
+		    CompareStringW(lcid, NORM_IGNORECASE, entry->name, -1, name, -1) == CSTR_EQUAL)
+			break;
+	}
+	return entry;
+}
+
+// Looks for a name resolved by an earlier call to GetIDsOfNames.
+BOOL PyGatewayBase::LookupCachedName(OLECHAR *name, LCID lcid, DISPID *pdispid)
+{
+	PyGatewayNameCacheEntry *entry = NULL;
+	ULONG hash = LHashValOfName(lcid, name);
+	EnterCriticalSection(&m_csNameCache);
+	if (m_ppNameCache) {
+		entry = FindCachedName(m_ppNameCache[hash % PYCOM_NAME_CACHE_BUCKETS], name, hash, lcid);
+		if (entry)
+			*pdispid = entry->dispid;
+	}
+	LeaveCriticalSection(&m_csNameCache);
+	if (entry) {
+		InterlockedIncrement(&m_nameCacheHits);
+		InterlockedIncrement(&g_nameCacheHits);
+	} else {
+		InterlockedIncrement(&m_nameCacheMisses);
+		InterlockedIncrement(&g_nameCacheMisses);
+	}
+	return entry != NULL;
+}
+
+void PyGatewayBase::AddCachedName(OLECHAR *name, LCID lcid, DISPID dispid)
+{
+	ULONG hash = LHashValOfName(lcid, name);
+	size_t cch = wcslen(name);
+	PyGatewayNameCacheEntry *entry = (PyGatewayNameCacheEntry *)malloc(sizeof(PyGatewayNameCacheEntry) + cch * sizeof(OLECHAR));
+	if (entry == NULL)
+		return;
+	entry->hash = hash;
+	entry->lcid = lcid;
+	entry->dispid = dispid;
+	memcpy(entry->name, name, (cch + 1) * sizeof(OLECHAR));
+
+	EnterCriticalSection(&m_csNameCache);
+	if (m_ppNameCache == NULL)
+		m_ppNameCache = (PyGatewayNameCacheEntry **)calloc(PYCOM_NAME_CACHE_BUCKETS, sizeof(PyGatewayNameCacheEntry *));
+	// Another thread may have resolved the same name.
+	if (m_ppNameCache != NULL && m_cNameCache < PYCOM_NAME_CACHE_MAX &&
+	    FindCachedName(m_ppNameCache[hash % PYCOM_NAME_CACHE_BUCKETS], name, hash, lcid) == NULL) {
+		PyGatewayNameCacheEntry **pHead = m_ppNameCache + (hash % PYCOM_NAME_CACHE_BUCKETS);
+		entry->next = *pHead;
+		*pHead = entry;
+		m_cNameCache++;
+		entry = NULL;
+	}
+	LeaveCriticalSection(&m_csNameCache);
+	free(entry);
+}
+
+// Forgets all names resolved by GetIDsOfNames, so the next lookup of each
+// goes to the policy again.
+void PyGatewayBase::InvalidateNameCache(void)
+{
+	EnterCriticalSection(&m_csNameCache);
+	PyGatewayNameCacheEntry **buckets = m_ppNameCache;
+	m_ppNameCache = NULL;
+	m_cNameCache = 0;
+	LeaveCriticalSection(&m_csNameCache);
+	if (buckets == NULL)
+		return;
+	for (int i = 0; i < PYCOM_NAME_CACHE_BUCKETS; i++) {
+		PyGatewayNameCacheEntry *entry = buckets[i];
+		while (entry != NULL) {
+			PyGatewayNameCacheEntry *next = entry->next;
+			free(entry);
+			entry = next;
+		}
+	}
+	free(buckets);
+}
+
+void PyGatewayBase::GetNameCacheStats(LONG *pHits, LONG *pMisses, UINT *pEntries)
+{
+	EnterCriticalSection(&m_csNameCache);
+	*pHits = m_nameCacheHits;
+	*pMisses = m_nameCacheMisses;
+	*pEntries = m_cNameCache;
+	LeaveCriticalSection(&m_csNameCache);
+}
+
 STDMETHODIMP PyGatewayBase::QueryInterface(
 	REFIID iid,
 	void ** ppv
@@ -394,6 +513,10 @@ STDMETHODIMP PyGatewayBase::GetIDsOfNames(
 	PyObject *argList;
 	PyObject *py_lcid;
 
+	// Names with argument names are never cached, so always go to the policy.
+	if (cNames == 1 && rgszNames[0] != NULL && LookupCachedName(rgszNames[0], lcid, rgdispid))
+		return S_OK;
+
 	PY_GATEWAY_METHOD;
 	hr = getids_setup(cNames, rgszNames, lcid, &argList, &py_lcid);
 	if ( SUCCEEDED(hr) )
@@ -405,6 +528,8 @@ STDMETHODIMP PyGatewayBase::GetIDsOfNames(
 		Py_DECREF(py_lcid);
 
 		hr = getids_finish(result, cNames, rgdispid);
+		if (hr == S_OK && cNames == 1 && rgszNames[0] != NULL)
+			AddCachedName(rgszNames[0], lcid, rgdispid[0]);
 	}
 	return hr;
 }
@@ -722,6 +847,104 @@ done:
 	return hr;
 }
 
+// The number of args converted on the stack when calling directly.
+#define PYCOM_DIRECT_SMALL_ARGS 8
+
+// A policy may provide a _dispid_to_callable_ dictionary, mapping the
+// dispids of its methods to the Python objects to call.  Simple method
+// calls for those dispids are made directly, rather than building the
+// arguments for _Invoke_/_InvokeEx_ and having the policy look them up.
+// Returns a new reference, or NULL (with no Python error) if the call
+// must go via the policy.
+PyObject *PyGatewayBase::GetDirectCallable(DISPID dispid, WORD wFlags, DISPPARAMS *params)
+{
+	// Only methods with positional args qualify.
+	if (!(wFlags & DISPATCH_METHOD) || params->cNamedArgs != 0)
+		return NULL;
+	if (m_obDispidToCallable == NULL) {
+		PyObject *ob = PyObject_GetAttrString(m_pPyObject, "_dispid_to_callable_");
+		if (ob == NULL || !PyDict_Check(ob)) {
+			PyErr_Clear();
+			Py_XDECREF(ob);
+			ob = Py_None;
+			Py_INCREF(ob);
+		}
+		// The getattr may have let another thread in first.
+		if (m_obDispidToCallable == NULL)
+			m_obDispidToCallable = ob;
+		else
+			Py_DECREF(ob);
+	}
+	if (m_obDispidToCallable == Py_None)
+		return NULL;
+	PyObject *obDispid = PyInt_FromLong(dispid);
+	if (obDispid == NULL) {
+		PyErr_Clear();
+		return NULL;
+	}
+	PyObject *ret = PyDict_GetItem(m_obDispidToCallable, obDispid);
+	Py_DECREF(obDispid);
+	Py_XINCREF(ret);
+	return ret;
+}
+
+// Calls 'callable' with the positional args in 'params'.  A failure to
+// convert the args is handled as for invoke_setup, otherwise *ppResult is
+// the result of the call (NULL with a Python exception on failure).
+static HRESULT invoke_direct(PyObject *callable, DISPPARAMS *params, PyObject **ppResult)
+{
+	HRESULT hr = S_OK;
+	UINT cArgs = params->cArgs;
+	UINT i;
+	*ppResult = NULL;
+#if (PY_VERSION_HEX >= 0x03090000)
+	UINT nDone = 0;
+	PyObject *smallArgs[PYCOM_DIRECT_SMALL_ARGS];
+	PyObject **args = smallArgs;
+	if (cArgs > PYCOM_DIRECT_SMALL_ARGS) {
+		args = (PyObject **)PyMem_Malloc(cArgs * sizeof(PyObject *));
+		if (args == NULL)
+			return E_OUTOFMEMORY;
+	}
+	// positional args are in reverse order.
+	for (i = 0; i < cArgs; i++) {
+		args[i] = PyCom_PyObjectFromVariant(params->rgvarg + cArgs - i - 1);
+		if (args[i] == NULL) {
+			hr = E_OUTOFMEMORY;
+			goto done;
+		}
+		nDone++;
+	}
+	*ppResult = PyObject_Vectorcall(callable, args, cArgs, NULL);
+done:
+	for (i = 0; i < nDone; i++)
+		Py_DECREF(args[i]);
+	if (args != smallArgs)
+		PyMem_Free(args);
+#else
+	PyObject *argList = PyTuple_New(cArgs);
+	if (argList == NULL)
+		return E_OUTOFMEMORY;
+	// positional args are in reverse order.
+	for (i = 0; i < cArgs; i++) {
+		PyObject *ob = PyCom_PyObjectFromVariant(params->rgvarg + cArgs - i - 1);
+		if (ob == NULL) {
+			hr = E_OUTOFMEMORY;
+			break;
+		}
+		PyTuple_SET_ITEM(argList, i, ob);
+	}
+	if (SUCCEEDED(hr))
+		*ppResult = PyObject_Call(callable, argList, NULL);
+	Py_DECREF(argList);
+#endif
+	if (FAILED(hr)) {
+		PyCom_LoggerException(NULL, "Failed to setup call into Python gateway");
+		PyErr_Clear();
+	}
+	return hr;
+}
+
 STDMETHODIMP PyGatewayBase::Invoke(
 	DISPID dispid,
 	REFIID riid,
@@ -743,6 +966,19 @@ STDMETHODIMP PyGatewayBase::Invoke(
 		V_VT(pVarResult) = VT_EMPTY;
 
 	PY_GATEWAY_METHOD;
+	PyObject *callable = GetDirectCallable(dispid, wFlags, params);
+	if ( callable )
+	{
+		PyObject *result;
+		hr = invoke_direct(callable, params, &result);
+		Py_DECREF(callable);
+		if ( FAILED(hr) )
+			return hr;
+		if ( result==NULL )
+			return GetIDispatchErrorResult(m_pPyObject, pexcepinfo);
+		// The result is just the real result, as for _InvokeEx_.
+		return invoke_finish(m_pPyObject, result, pVarResult, puArgErr, pexcepinfo, IID_IDispatch, params, false);
+	}
 	PyObject *argList;
 	PyObject *py_lcid;
 	hr = invoke_setup(params, lcid, &argList, &py_lcid);
@@ -806,6 +1042,18 @@ STDMETHODIMP PyGatewayBase::InvokeEx(DISPID id, LCID lcid, WORD wFlags, DISPPARA
 		V_VT(pVarResult) = VT_EMPTY;
 
 	PY_GATEWAY_METHOD;
+	PyObject *callable = GetDirectCallable(id, wFlags, params);
+	if ( callable )
+	{
+		PyObject *result;
+		hr = invoke_direct(callable, params, &result);
+		Py_DECREF(callable);
+		if ( FAILED(hr) )
+			return hr;
+		if ( result==NULL )
+			return GetIDispatchErrorResult(m_pPyObject, pexcepinfo);
+		return invoke_finish(m_pPyObject, result, pVarResult, NULL, pexcepinfo, IID_IDispatchEx, params, false);
+	}
 	PyObject *obISP = PyCom_PyObjectFromIUnknown(pspCaller, IID_IServiceProvider, TRUE);
 	if (obISP==NULL)
 		return GetIDispatchErrorResult(m_pPyObject, pexcepinfo);
@@ -850,6 +1098,7 @@ STDMETHODIMP PyGatewayBase::DeleteMemberByName(BSTR bstr, DWORD grfdex)
 											   "Ol", obName, grfdex);
 	Py_DECREF(obName);
 	Py_XDECREF(result);
+	InvalidateNameCache();
 	return PyCom_SetCOMErrorFromPyException(IID_IDispatchEx);
 }
 
@@ -864,6 +1113,7 @@ STDMETHODIMP PyGatewayBase::DeleteMemberByDispID(DISPID id)
 											   "_DeleteMemberByDispID_",
 											   "l", id);
 	Py_XDECREF(result);
+	InvalidateNameCache();
 	return PyCom_SetCOMErrorFromPyException(IID_IDispatchEx);
 }
 
@@ -1041,3 +1291,74 @@ STDMETHODIMP PyGatewayBase::Unwrap(
 	return S_OK;
 }
 
+
+// Returns a reference to the gateway behind a PyIUnknown, or NULL with
+// an exception set if it is not a Python gateway.
+static PyGatewayBase *GatewayFromPyObject(PyObject *ob)
+{
+	if ( !PyIBase::is_object(ob, &PyIUnknown::type) ) {
+		PyErr_SetString(PyExc_ValueError, "argument is not a COM object");
+		return NULL;
+	}
+	HRESULT hr;
+	IInternalUnwrapPythonObject *pUnwrapper;
+	if (S_OK!=(hr=((PyIUnknown *)ob)->m_obj->QueryInterface(IID_IInternalUnwrapPythonObject, (void **)&pUnwrapper))) {
+		PyErr_Format(PyExc_ValueError, "argument is not a Python gateway (0x%x)", hr);
+		return NULL;
+	}
+	return static_cast<PyGatewayBase *>(pUnwrapper);
+}
+
+// @pymethod |pythoncom|InvalidateGatewayNameCache|Forgets the names a gateway has resolved via GetIDsOfNames.
+PyObject *pythoncom_InvalidateGatewayNameCache(PyObject *self, PyObject *args)
+{
+	PyObject *ob;
+	// @pyparm <o PyIUnknown>|ob||A gateway object, as returned by <om pythoncom.WrapObject>.
+	if (!PyArg_ParseTuple(args, "O:InvalidateGatewayNameCache", &ob))
+		return NULL;
+	PyGatewayBase *gateway = GatewayFromPyObject(ob);
+	if (gateway == NULL)
+		return NULL;
+	gateway->InvalidateNameCache();
+	gateway->Release();
+	Py_INCREF(Py_None);
+	return Py_None;
+	// @comm Each gateway remembers the DISPID returned by its policy's
+	// _GetIDsOfNames_ for each single name it is asked for, and answers
+	// later requests for the same name (in any case) without calling the
+	// policy.  A policy whose names can map to different DISPIDs over the
+	// lifetime of the object must call this when they change.
+	// <nl>The cache is invalidated automatically by DeleteMemberByName and
+	// DeleteMemberByDispID.
+}
+
+// @pymethod dict|pythoncom|GetGatewayNameCacheStats|Returns statistics about the GetIDsOfNames cache.
+PyObject *pythoncom_GetGatewayNameCacheStats(PyObject *self, PyObject *args)
+{
+	PyObject *ob = Py_None;
+	// @pyparm <o PyIUnknown>|ob|None|A gateway object.  If None, the totals
+	// for all gateways are returned.
+	if (!PyArg_ParseTuple(args, "|O:GetGatewayNameCacheStats", &ob))
+		return NULL;
+	// @rdesc The result is a dictionary with the following keys.
+	// @flagh Key|Description
+	// @flag hits|The number of names found in the cache.
+	// @flag misses|The number of lookups passed to the policy.
+	// @flag entries|The number of names cached by the gateway (only
+	// present when a gateway is given).
+	if (ob == Py_None)
+		return Py_BuildValue("{s:l,s:l}",
+			"hits", g_nameCacheHits,
+			"misses", g_nameCacheMisses);
+	PyGatewayBase *gateway = GatewayFromPyObject(ob);
+	if (gateway == NULL)
+		return NULL;
+	LONG hits, misses;
+	UINT entries;
+	gateway->GetNameCacheStats(&hits, &misses, &entries);
+	gateway->Release();
+	return Py_BuildValue("{s:l,s:l,s:I}",
+		"hits", hits,
+		"misses", misses,
+		"entries", entries);
+}
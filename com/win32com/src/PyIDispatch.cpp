@@ -288,51 +288,33 @@ PyObject * PyIDispatch::Invoke(PyObject *self, PyObject *args)
 	return result;
 }
 
-// @pymethod object|PyIDispatch|InvokeTypes|Invokes a DISPID, using the passed arguments and type descriptions.
-PyObject * PyIDispatch::InvokeTypes(PyObject *self, PyObject *args)
+// The number of arguments InvokeTypes and compiled signatures convert
+// without allocating any memory for the helpers or the VARIANTARGs.
+#define PYCOM_INVOKE_SMALL_ARGS 8
+
+// Invokes 'dispid' once the type information for the result and each of the
+// argTypesLen arguments has been set in the helpers.  The Python arguments are
+// args[firstArg:], and there may be fewer of them than argTypesLen.
+static PyObject *InvokeWithHelpers(PyObject *self, DISPID dispid, LCID lcid, UINT wFlags,
+                                   PythonOleArgHelper &resultArgHelper,
+                                   PythonOleArgHelper *ArgHelpers, UINT argTypesLen,
+                                   PyObject *args, Py_ssize_t firstArg)
 {
-	/* InvokeType(dispid, lcid, wflags, ELEMDESC resultType, ELEMDESC[] argTypes, arg1, arg2...) */
-	PyErr_Clear();
-	int argc = PyObject_Length(args);
-	if ( argc == -1 )
-		return NULL;
-	if ( argc < 5 )
-		return PyErr_Format(PyExc_TypeError, "not enough arguments (at least 5 needed)");
-
-	// @pyparm int|dispid||The dispid to use.  Please see <om PyIDispatch.Invoke>.
-	DISPID dispid = PyInt_AsLong(PyTuple_GET_ITEM(args, 0));
-	// @pyparm int|lcid||The locale ID.  Please see <om PyIDispatch.Invoke>.
-	LCID lcid = PyInt_AsLong(PyTuple_GET_ITEM(args, 1));
-	// @pyparm int|wFlags||Flags for the call.  Please see <om PyIDispatch.Invoke>.
-	UINT wFlags = PyInt_AsLong(PyTuple_GET_ITEM(args, 2));
-	// @pyparm tuple|resultTypeDesc||A tuple describing the type of the
-	// result.  See the comments for more information.
-	PyObject *resultElemDesc = PyTuple_GET_ITEM(args, 3);
-	// @pyparm  (tuple, ...)|typeDescs||A sequence of tuples describing
-	// the types of the parameters for the function.  See the comments
-	// for more information.
-	PyObject *argsElemDescArray = PyTuple_GET_ITEM(args, 4);
-	// @pyparm object, ...|args||The args to the function.
-	if ( PyErr_Occurred() )
-		return NULL;
-	int numArgs;
-	int argTypesLen = PyObject_Length(argsElemDescArray);
-	if (!PyTuple_Check(argsElemDescArray) || argTypesLen<argc-5)
-		return PyErr_Format(PyExc_TypeError, "The array of argument types must be a tuple whose size is <= to the number of arguments.");
+	Py_ssize_t argc = PyTuple_GET_SIZE(args) - firstArg;
 	// See how many _real_ entries - count until end or
 	// first param marked as Missing.
-	for (numArgs = 0;numArgs<argc-5; numArgs++) {
-		if (PyTuple_GET_ITEM(args, numArgs+5)->ob_type==&PyOleMissingType) {
+	Py_ssize_t numArgs;
+	for (numArgs = 0;numArgs<argc; numArgs++) {
+		if (PyTuple_GET_ITEM(args, numArgs+firstArg)->ob_type==&PyOleMissingType) {
 			break;
 		}
 	}
 
 	// these will all be cleared before returning
-	PythonOleArgHelper *ArgHelpers = NULL;
 	PyObject *result = NULL;
 	DISPID dispidNamed = DISPID_PROPERTYPUT;
 	DISPPARAMS dispparams = { NULL, NULL, 0, 0 };
-	PythonOleArgHelper resultArgHelper;
+	VARIANTARG smallArgs[PYCOM_INVOKE_SMALL_ARGS];
 
 	// This gets confusing.  If we have typeinfo for a byref arg, but the
 	// arg is not specified by the user, then we _do_ present the arg to
@@ -343,32 +325,26 @@ PyObject * PyIDispatch::InvokeTypes(PyObject *self, PyObject *args)
 
 	// If we have type info for an arg but not specified by the user, we will still process
 	// the arg fully.
-	// Note numArgs can not be > argTypesLen (as checked above)
+	// Note numArgs can not be > argTypesLen (as checked by the callers)
 	UINT numArgArray = 0;
 	UINT i;
-
-	if (argTypesLen>0) {
-		ArgHelpers = new PythonOleArgHelper[argTypesLen]; // new may! except.
-		if (ArgHelpers==NULL) {
-			PyErr_SetString(PyExc_MemoryError, "Allocating ArgHelpers array");
-			return NULL;
-		}
-		for ( i = 0; i < (UINT)argTypesLen; i++ ) {
-			if (!ArgHelpers[i].ParseTypeInformation(PyTuple_GET_ITEM(argsElemDescArray,i)))
-				goto error;
-			// We ignore "in" params specified as "Missing", but
-			// for byref (ie, "IsOut") args we still must process it.
-			if (i<(UINT)numArgs || ArgHelpers[i].m_bIsOut)
-				numArgArray++;
-		}
+	for ( i = 0; i < argTypesLen; i++ ) {
+		// We ignore "in" params specified as "Missing", but
+		// for byref (ie, "IsOut") args we still must process it.
+		if (i<(UINT)numArgs || ArgHelpers[i].m_bIsOut)
+			numArgArray++;
 	}
 
 	dispparams.cArgs = numArgArray;
 	if ( dispparams.cArgs ) {
-		dispparams.rgvarg = new VARIANTARG[dispparams.cArgs];
-		if (dispparams.rgvarg==NULL) {
-			PyErr_SetString(PyExc_MemoryError, "Allocating dispparams.rgvarg array");
-			goto error;
+		if (dispparams.cArgs <= PYCOM_INVOKE_SMALL_ARGS)
+			dispparams.rgvarg = smallArgs;
+		else {
+			dispparams.rgvarg = new VARIANTARG[dispparams.cArgs];
+			if (dispparams.rgvarg==NULL) {
+				PyErr_SetString(PyExc_MemoryError, "Allocating dispparams.rgvarg array");
+				return NULL;
+			}
 		}
 
 		for ( i = dispparams.cArgs; i--; )
@@ -379,8 +355,10 @@ PyObject * PyIDispatch::InvokeTypes(PyObject *self, PyObject *args)
 			// arg-helpers in normal order.
 			UINT offset = dispparams.cArgs - i - 1;
 			// See if the user actually specified this arg.
-			PyObject *arg = i>=(UINT)numArgs ? Py_None : PyTuple_GET_ITEM(args, i+5);
-			if ( !ArgHelpers[i].MakeObjToVariant(arg, &dispparams.rgvarg[offset], PyTuple_GET_ITEM(argsElemDescArray,i)) )
+			PyObject *arg = i>=(UINT)numArgs ? Py_None : PyTuple_GET_ITEM(args, i+firstArg);
+			// The VARIANTs are released via ClearVariant below.
+			ArgHelpers[i].m_bPoolTemporaries = TRUE;
+			if ( !ArgHelpers[i].MakeObjToVariant(arg, &dispparams.rgvarg[offset]) )
 				goto error;
 		}
 	}
@@ -392,11 +370,6 @@ PyObject * PyIDispatch::InvokeTypes(PyObject *self, PyObject *args)
 		dispparams.cNamedArgs = 1;
 	}
 
-	if (!resultArgHelper.ParseTypeInformation(resultElemDesc)) {
-		PyCom_BuildInternalPyException("The return type information could not be parsed");
-		goto error;
-	}
-
 	BOOL bResultWanted;
 	bResultWanted = (resultArgHelper.m_reqdType != VT_VOID && resultArgHelper.m_reqdType != VT_EMPTY);
 
@@ -416,7 +389,7 @@ PyObject * PyIDispatch::InvokeTypes(PyObject *self, PyObject *args)
 	UINT nArgErr;
 	IDispatch *pMyDispatch;
 
-	pMyDispatch = GetI(self);
+	pMyDispatch = PyIDispatch::GetI(self);
 	if (pMyDispatch==NULL) goto error;
 	nArgErr = (UINT)-1;  // initialize to invalid arg
 	{
@@ -467,10 +440,71 @@ PyObject * PyIDispatch::InvokeTypes(PyObject *self, PyObject *args)
 	if ( dispparams.rgvarg )
 	{
 		for ( i = dispparams.cArgs; i--; )
-			VariantClear(&dispparams.rgvarg[i]);
-		delete [] dispparams.rgvarg;
+			ArgHelpers[i].ClearVariant(&dispparams.rgvarg[dispparams.cArgs - i - 1]);
+		if (dispparams.rgvarg != smallArgs)
+			delete [] dispparams.rgvarg;
 	}
-	delete [] ArgHelpers;
+	return result;
+}
+
+// @pymethod object|PyIDispatch|InvokeTypes|Invokes a DISPID, using the passed arguments and type descriptions.
+PyObject * PyIDispatch::InvokeTypes(PyObject *self, PyObject *args)
+{
+	/* InvokeType(dispid, lcid, wflags, ELEMDESC resultType, ELEMDESC[] argTypes, arg1, arg2...) */
+	PyErr_Clear();
+	int argc = PyObject_Length(args);
+	if ( argc == -1 )
+		return NULL;
+	if ( argc < 5 )
+		return PyErr_Format(PyExc_TypeError, "not enough arguments (at least 5 needed)");
+
+	// @pyparm int|dispid||The dispid to use.  Please see <om PyIDispatch.Invoke>.
+	DISPID dispid = PyInt_AsLong(PyTuple_GET_ITEM(args, 0));
+	// @pyparm int|lcid||The locale ID.  Please see <om PyIDispatch.Invoke>.
+	LCID lcid = PyInt_AsLong(PyTuple_GET_ITEM(args, 1));
+	// @pyparm int|wFlags||Flags for the call.  Please see <om PyIDispatch.Invoke>.
+	UINT wFlags = PyInt_AsLong(PyTuple_GET_ITEM(args, 2));
+	// @pyparm tuple|resultTypeDesc||A tuple describing the type of the
+	// result.  See the comments for more information.
+	PyObject *resultElemDesc = PyTuple_GET_ITEM(args, 3);
+	// @pyparm  (tuple, ...)|typeDescs||A sequence of tuples describing
+	// the types of the parameters for the function.  See the comments
+	// for more information.
+	PyObject *argsElemDescArray = PyTuple_GET_ITEM(args, 4);
+	// @pyparm object, ...|args||The args to the function.
+	if ( PyErr_Occurred() )
+		return NULL;
+	int argTypesLen = PyObject_Length(argsElemDescArray);
+	if (!PyTuple_Check(argsElemDescArray) || argTypesLen<argc-5)
+		return PyErr_Format(PyExc_TypeError, "The array of argument types must be a tuple whose size is <= to the number of arguments.");
+
+	// Most calls have only a few args, so avoid the heap for those.
+	PythonOleArgHelper smallHelpers[PYCOM_INVOKE_SMALL_ARGS];
+	PythonOleArgHelper *ArgHelpers = smallHelpers;
+	PythonOleArgHelper resultArgHelper;
+	PyObject *result = NULL;
+	UINT i;
+
+	if (argTypesLen>PYCOM_INVOKE_SMALL_ARGS) {
+		ArgHelpers = new PythonOleArgHelper[argTypesLen]; // new may! except.
+		if (ArgHelpers==NULL) {
+			PyErr_SetString(PyExc_MemoryError, "Allocating ArgHelpers array");
+			return NULL;
+		}
+	}
+	for ( i = 0; i < (UINT)argTypesLen; i++ ) {
+		if (!ArgHelpers[i].ParseTypeInformation(PyTuple_GET_ITEM(argsElemDescArray,i)))
+			goto done;
+	}
+	if (!resultArgHelper.ParseTypeInformation(resultElemDesc)) {
+		PyCom_BuildInternalPyException("The return type information could not be parsed");
+		goto done;
+	}
+	result = InvokeWithHelpers(self, dispid, lcid, wFlags, resultArgHelper,
+	                           ArgHelpers, argTypesLen, args, 5);
+done:
+	if (ArgHelpers != smallHelpers)
+		delete [] ArgHelpers;
 	return result;
 // @comm The Microsoft documentation for IDispatch should be used for all 
 // params except 'resultTypeDesc' and 'typeDescs'. 'resultTypeDesc' describes 
@@ -494,6 +528,179 @@ PyObject * PyIDispatch::InvokeTypes(PyObject *self, PyObject *args)
 // params - ColumnWidth is a float, and RulerStule is an int.|
 }
 
+////////////////////////////////////////////////////////////////////////
+//
+// Compiled InvokeTypes signatures.  makepy generated code calls the same
+// few signatures over and over, so the type descriptions are unpacked once
+// here rather than on every call through InvokeTypes.
+struct PyInvokeTypesArgDesc {
+	VARTYPE vt;
+	DWORD flags;
+};
+
+struct PyInvokeTypesSignature {
+	PyObject_HEAD
+	DISPID dispid;
+	LCID lcid;
+	UINT wFlags;
+	PyInvokeTypesArgDesc result;
+	UINT numArgTypes;
+	PyInvokeTypesArgDesc *argTypes;
+};
+
+// Unpacks a (type_id, flags, ...) tuple, as taken by InvokeTypes.
+static BOOL ParseInvokeTypesArgDesc(PyObject *ob, PyInvokeTypesArgDesc *pDesc)
+{
+	if (!PyTuple_Check(ob) || PyTuple_GET_SIZE(ob) < 2) {
+		PyErr_SetString(PyExc_TypeError, "A type description must be a tuple of (type_id, flags)");
+		return FALSE;
+	}
+	pDesc->vt = (VARTYPE)PyInt_AsLong(PyTuple_GET_ITEM(ob, 0));
+	pDesc->flags = (DWORD)PyInt_AsLong(PyTuple_GET_ITEM(ob, 1));
+	return !PyErr_Occurred();
+}
+
+static void PyInvokeTypesSignature_dealloc(PyObject *self)
+{
+	PyMem_Free(((PyInvokeTypesSignature *)self)->argTypes);
+	PyObject_Del(self);
+}
+
+static PyObject *PyInvokeTypesSignature_call(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyInvokeTypesSignature *sig = (PyInvokeTypesSignature *)self;
+	if (kwargs && PyDict_Size(kwargs)) {
+		PyErr_SetString(PyExc_TypeError, "Compiled InvokeTypes signatures do not take keyword arguments");
+		return NULL;
+	}
+	Py_ssize_t argc = PyTuple_GET_SIZE(args);
+	PyObject *obDispatch = argc ? PyTuple_GET_ITEM(args, 0) : NULL;
+	if (obDispatch == NULL || !PyIBase::is_object(obDispatch, &PyIDispatch::type)) {
+		PyErr_SetString(PyExc_TypeError, "The first argument must be a PyIDispatch object");
+		return NULL;
+	}
+	if ((size_t)(argc-1) > sig->numArgTypes)
+		return PyErr_Format(PyExc_TypeError, "Too many arguments (at most %u can be passed)", sig->numArgTypes);
+
+	PythonOleArgHelper smallHelpers[PYCOM_INVOKE_SMALL_ARGS];
+	PythonOleArgHelper *ArgHelpers = smallHelpers;
+	PythonOleArgHelper resultArgHelper;
+	if (sig->numArgTypes>PYCOM_INVOKE_SMALL_ARGS) {
+		ArgHelpers = new PythonOleArgHelper[sig->numArgTypes];
+		if (ArgHelpers==NULL) {
+			PyErr_SetString(PyExc_MemoryError, "Allocating ArgHelpers array");
+			return NULL;
+		}
+	}
+	for (UINT i = 0; i < sig->numArgTypes; i++)
+		ArgHelpers[i].SetTypeInformation(sig->argTypes[i].vt, sig->argTypes[i].flags);
+	resultArgHelper.SetTypeInformation(sig->result.vt, sig->result.flags);
+
+	PyObject *result = InvokeWithHelpers(obDispatch, sig->dispid, sig->lcid, sig->wFlags,
+	                                     resultArgHelper, ArgHelpers, sig->numArgTypes, args, 1);
+	if (ArgHelpers != smallHelpers)
+		delete [] ArgHelpers;
+	return result;
+}
+
+// @object PyInvokeTypesSignature|A compiled call signature, as returned
+// by <om pythoncom.CompileInvokeTypes>.
+// @comm The object is called with a <o PyIDispatch> followed by the arguments
+// for the function, and behaves exactly like <om PyIDispatch.InvokeTypes> given
+// the dispid, lcid, flags and type descriptions the signature was compiled with.
+// @ex makepy generated code uses it like|
+// class Cells(DispatchBaseClass):
+//     _sig_SetWidth = pythoncom.CompileInvokeTypes(202, LCID, 1, (24, 0), ((4, 1), (3, 1)),)
+//     def SetWidth(self, ColumnWidth=..., RulerStyle=...):
+//         return self._sig_SetWidth(self._oleobj_, ColumnWidth, RulerStyle)
+#define OFF(e) offsetof(PyInvokeTypesSignature, e)
+static struct PyMemberDef PyInvokeTypesSignature_members[] = {
+	{"dispid", T_LONG, OFF(dispid), READONLY}, // @prop int|dispid|The dispid invoked.
+	{"lcid",   T_ULONG, OFF(lcid), READONLY}, // @prop int|lcid|The locale ID used for the call.
+	{"flags",  T_UINT, OFF(wFlags), READONLY}, // @prop int|flags|The wFlags passed to Invoke.
+	{NULL}
+};
+#undef OFF
+
+PyTypeObject PyInvokeTypesSignatureType =
+{
+	PYWIN_OBJECT_HEAD
+	"PyInvokeTypesSignature",
+	sizeof(PyInvokeTypesSignature),
+	0,
+	PyInvokeTypesSignature_dealloc,	/* tp_dealloc */
+	0,						/* tp_print */
+	0,						/* tp_getattr */
+	0,						/* tp_setattr */
+	0,						/* tp_compare */
+	0,						/* tp_repr */
+	0,						/* tp_as_number */
+	0,						/* tp_as_sequence */
+	0,						/* tp_as_mapping */
+	0,						/* tp_hash */
+	PyInvokeTypesSignature_call,	/* tp_call */
+	0,						/* tp_str */
+	PyObject_GenericGetAttr,	/* tp_getattro */
+	0,						/* tp_setattro */
+	0,						/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,		/* tp_flags */
+	0,						/* tp_doc */
+	0,						/* tp_traverse */
+	0,						/* tp_clear */
+	0,						/* tp_richcompare */
+	0,						/* tp_weaklistoffset */
+	0,						/* tp_iter */
+	0,						/* tp_iternext */
+	0,						/* tp_methods */
+	PyInvokeTypesSignature_members,	/* tp_members */
+};
+
+// @pymethod <o PyInvokeTypesSignature>|pythoncom|CompileInvokeTypes|Compiles the
+// type descriptions for <om PyIDispatch.InvokeTypes> into a callable signature.
+PyObject *pythoncom_CompileInvokeTypes(PyObject *self, PyObject *args)
+{
+	DISPID dispid;
+	LCID lcid;
+	UINT wFlags;
+	PyObject *resultElemDesc, *argsElemDescArray;
+	// @pyparm int|dispid||The dispid to use.
+	// @pyparm int|lcid||The locale ID.
+	// @pyparm int|wFlags||Flags for the call.
+	// @pyparm tuple|resultTypeDesc||A tuple describing the type of the result.
+	// @pyparm (tuple, ...)|typeDescs||A tuple of tuples describing the types of the parameters.
+	// @comm The params are as for the first 5 params of <om PyIDispatch.InvokeTypes>.
+	if (!PyArg_ParseTuple(args, "lkIOO!:CompileInvokeTypes", &dispid, &lcid, &wFlags,
+	                      &resultElemDesc, &PyTuple_Type, &argsElemDescArray))
+		return NULL;
+	Py_ssize_t numArgTypes = PyTuple_GET_SIZE(argsElemDescArray);
+	PyInvokeTypesSignature *sig = PyObject_New(PyInvokeTypesSignature, &PyInvokeTypesSignatureType);
+	if (sig == NULL)
+		return NULL;
+	sig->dispid = dispid;
+	sig->lcid = lcid;
+	sig->wFlags = wFlags;
+	sig->numArgTypes = (UINT)numArgTypes;
+	sig->argTypes = NULL;
+	if (numArgTypes) {
+		sig->argTypes = (PyInvokeTypesArgDesc *)PyMem_Malloc(numArgTypes * sizeof(PyInvokeTypesArgDesc));
+		if (sig->argTypes == NULL) {
+			Py_DECREF(sig);
+			return PyErr_NoMemory();
+		}
+	}
+	for (Py_ssize_t i = 0; i < numArgTypes; i++) {
+		if (!ParseInvokeTypesArgDesc(PyTuple_GET_ITEM(argsElemDescArray, i), sig->argTypes + i)) {
+			Py_DECREF(sig);
+			return NULL;
+		}
+	}
+	if (!ParseInvokeTypesArgDesc(resultElemDesc, &sig->result)) {
+		Py_DECREF(sig);
+		return NULL;
+	}
+	return (PyObject *)sig;
+}
+
 // @pymethod <o PyITypeInfo>|PyIDispatch|GetTypeInfo|Get type information for the object.
 PyObject *PyIDispatch::GetTypeInfo(PyObject *self, PyObject *args)
 {
@@ -34,6 +34,329 @@ public:
 	long ref;
 };
 
+// The layout of a record type - the offset and type of each field, read
+// once from the type information and shared by all records of the type.
+// Fields holding plain data (numbers, dates and so on - anything with no
+// pointers to follow) are read and written directly in the record's buffer,
+// rather than looking the field up by name through IRecordInfo each time.
+struct PyRecordField {
+	ULONG offset;
+	VARTYPE vt;		// With enums and aliases resolved.
+	ULONG size;		// 0 if the field is not plain data.
+};
+
+struct PyRecordLayout {
+	PyObject_HEAD
+	IRecordInfo *pri;	// Keeps the key of g_obRecordLayouts alive.
+	ULONG cbRecord;
+	BOOL bAllPlain;
+	PyObject *names;	// Tuple of field names, in order.
+	PyObject *fieldIndexes;	// name -> index into fields, for fields of plain data.
+	PyRecordField *fields;
+	PyObject *weakreflist;	// g_obRecordLayouts only holds weak references.
+};
+
+static void PyRecordLayout_dealloc(PyObject *self)
+{
+	PyRecordLayout *layout = (PyRecordLayout *)self;
+	if (layout->weakreflist)
+		PyObject_ClearWeakRefs(self);
+	Py_XDECREF(layout->names);
+	Py_XDECREF(layout->fieldIndexes);
+	free(layout->fields);
+	if (layout->pri)
+		layout->pri->Release();
+	PyObject_Del(self);
+}
+
+PyTypeObject PyRecordLayoutType =
+{
+	PYWIN_OBJECT_HEAD
+	"com_record_layout",
+	sizeof(PyRecordLayout),
+	0,
+	PyRecordLayout_dealloc,	/* tp_dealloc */
+	0,						/* tp_print */
+	0,						/* tp_getattr */
+	0,						/* tp_setattr */
+	0,						/* tp_compare */
+	0,						/* tp_repr */
+	0,						/* tp_as_number */
+	0,						/* tp_as_sequence */
+	0,						/* tp_as_mapping */
+	0,						/* tp_hash */
+	0,						/* tp_call */
+	0,						/* tp_str */
+	0,						/* tp_getattro */
+	0,						/* tp_setattro */
+	0,						/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,		/* tp_flags */
+	0,						/* tp_doc */
+	0,						/* tp_traverse */
+	0,						/* tp_clear */
+	0,						/* tp_richcompare */
+	offsetof(PyRecordLayout, weakreflist),	/* tp_weaklistoffset */
+};
+
+// IRecordInfo address -> weak reference to its PyRecordLayout.  Only the
+// records of a type keep its layout (and so its IRecordInfo) alive.
+static PyObject *g_obRecordLayouts = NULL;
+// The maximum number of types before the layouts are discarded.
+#define PYCOM_MAX_RECORD_LAYOUTS 256
+
+// The size of a field of the given type if it is plain data, else 0.
+// Only types which can be held in a VARIANT are plain; others (such as
+// VT_HRESULT) are left to IRecordInfo.
+static ULONG PlainFieldSize(VARTYPE vt)
+{
+	switch (vt) {
+		case VT_I1: case VT_UI1:
+			return 1;
+		case VT_I2: case VT_UI2: case VT_BOOL:
+			return 2;
+		case VT_I4: case VT_UI4: case VT_INT: case VT_UINT:
+		case VT_R4: case VT_ERROR:
+			return 4;
+		case VT_I8: case VT_UI8: case VT_R8: case VT_CY: case VT_DATE:
+			return 8;
+	}
+	return 0;
+}
+
+// Resolves enums (which are stored as VT_I4) and aliases.
+static VARTYPE ResolveFieldType(ITypeInfo *pti, TYPEDESC *ptd)
+{
+	if (ptd->vt != VT_USERDEFINED)
+		return ptd->vt;
+	VARTYPE ret = VT_USERDEFINED;
+	ITypeInfo *ref = NULL;
+	if (SUCCEEDED(pti->GetRefTypeInfo(ptd->hreftype, &ref))) {
+		TYPEATTR *pta;
+		if (SUCCEEDED(ref->GetTypeAttr(&pta))) {
+			if (pta->typekind == TKIND_ENUM)
+				ret = VT_I4;
+			else if (pta->typekind == TKIND_ALIAS)
+				ret = ResolveFieldType(ref, &pta->tdescAlias);
+			ref->ReleaseTypeAttr(pta);
+		}
+		ref->Release();
+	}
+	return ret;
+}
+
+// Returns a new reference to the layout of a record type, or to None if
+// the type information is not available.
+static PyObject *BuildRecordLayout(IRecordInfo *pri)
+{
+	ITypeInfo *pti = NULL;
+	TYPEATTR *pta = NULL;
+	PyRecordLayout *layout = NULL;
+	PyObject *ret = NULL;
+	ULONG cb;
+	HRESULT hr;
+	{
+	PY_INTERFACE_PRECALL;
+	hr = pri->GetSize(&cb);
+	if (SUCCEEDED(hr))
+		hr = pri->GetTypeInfo(&pti);
+	if (SUCCEEDED(hr) && pti != NULL)
+		hr = pti->GetTypeAttr(&pta);
+	PY_INTERFACE_POSTCALL;
+	}
+	if (FAILED(hr) || pti == NULL || pta == NULL)
+		goto none;
+	layout = PyObject_New(PyRecordLayout, &PyRecordLayoutType);
+	if (layout == NULL)
+		goto done;
+	layout->weakreflist = NULL;
+	layout->pri = pri;
+	pri->AddRef();
+	layout->cbRecord = cb;
+	layout->bAllPlain = TRUE;
+	layout->names = PyTuple_New(pta->cVars);
+	layout->fieldIndexes = PyDict_New();
+	layout->fields = (PyRecordField *)calloc(pta->cVars ? pta->cVars : 1, sizeof(PyRecordField));
+	if (layout->names == NULL || layout->fieldIndexes == NULL)
+		goto done;
+	if (layout->fields == NULL) {
+		PyErr_NoMemory();
+		goto done;
+	}
+	for (UINT i = 0; i < pta->cVars; i++) {
+		PyRecordField *field = layout->fields + i;
+		VARDESC *pvd;
+		BSTR name = NULL;
+		UINT cNames = 0;
+		{
+		PY_INTERFACE_PRECALL;
+		hr = pti->GetVarDesc(i, &pvd);
+		if (SUCCEEDED(hr)) {
+			hr = pti->GetNames(pvd->memid, &name, 1, &cNames);
+			if (SUCCEEDED(hr) && cNames == 0)
+				hr = E_FAIL;
+			if (SUCCEEDED(hr)) {
+				field->offset = pvd->oInst;
+				field->vt = ResolveFieldType(pti, &pvd->elemdescVar.tdesc);
+				field->size = PlainFieldSize(field->vt);
+				if (pvd->varkind != VAR_PERINSTANCE || field->offset + field->size > cb)
+					field->size = 0;
+			}
+			pti->ReleaseVarDesc(pvd);
+		}
+		PY_INTERFACE_POSTCALL;
+		}
+		if (FAILED(hr))
+			goto none;
+		PyObject *obName = PyWinCoreString_FromString(name);
+		SysFreeString(name);
+		if (obName == NULL)
+			goto done;
+		PyTuple_SET_ITEM(layout->names, i, obName);
+		if (field->size == 0) {
+			layout->bAllPlain = FALSE;
+			continue;
+		}
+		// Methods take precedence over fields with the same name.
+		if (PyObject_HasAttr((PyObject *)&PyRecord::Type, obName))
+			continue;
+		PyObject *obIndex = PyInt_FromLong(i);
+		if (obIndex == NULL || PyDict_SetItem(layout->fieldIndexes, obName, obIndex) != 0) {
+			Py_XDECREF(obIndex);
+			goto done;
+		}
+		Py_DECREF(obIndex);
+	}
+	ret = (PyObject *)layout;
+	layout = NULL;
+	goto done;
+none:
+	ret = Py_None;
+	Py_INCREF(Py_None);
+done:
+	Py_XDECREF(layout);
+	if (pta)
+		pti->ReleaseTypeAttr(pta);
+	if (pti)
+		pti->Release();
+	return ret;
+}
+
+// Returns a new reference to the (cached) layout of a record type, or to
+// None.  Returns NULL with an exception set on failure.
+static PyObject *GetRecordLayout(IRecordInfo *pri)
+{
+	if (g_obRecordLayouts == NULL) {
+		g_obRecordLayouts = PyDict_New();
+		if (g_obRecordLayouts == NULL)
+			return NULL;
+	}
+	PyObject *key = PyLong_FromVoidPtr(pri);
+	if (key == NULL)
+		return NULL;
+	PyObject *ref = PyDict_GetItem(g_obRecordLayouts, key);
+	PyObject *ret = ref ? PyWeakref_GET_OBJECT(ref) : NULL;
+	if (ret != NULL && ret != Py_None) {
+		Py_DECREF(key);
+		Py_INCREF(ret);
+		return ret;
+	}
+	ret = BuildRecordLayout(pri);
+	// Types without a layout are not remembered, as the IRecordInfo (and
+	// so the key) may not outlive the record.
+	if (ret != NULL && ret != Py_None) {
+		// Records hold their own reference, so discarding the lot is safe.
+		if (PyDict_Size(g_obRecordLayouts) >= PYCOM_MAX_RECORD_LAYOUTS)
+			PyDict_Clear(g_obRecordLayouts);
+		ref = PyWeakref_NewRef(ret, NULL);
+		if (ref == NULL || PyDict_SetItem(g_obRecordLayouts, key, ref) != 0)
+			Py_CLEAR(ret);
+		Py_XDECREF(ref);
+	}
+	Py_DECREF(key);
+	return ret;
+}
+
+// Returns the layout of a record (a borrowed reference), or NULL if it has
+// none.  Never sets an exception - records without a layout just use the
+// slower IRecordInfo methods.
+static PyRecordLayout *PyRecord_GetLayout(PyRecord *pyrec)
+{
+	if (pyrec->layout == NULL) {
+		pyrec->layout = GetRecordLayout(pyrec->pri);
+		if (pyrec->layout == NULL) {
+			PyErr_Clear();
+			return NULL;
+		}
+	}
+	return pyrec->layout == Py_None ? NULL : (PyRecordLayout *)pyrec->layout;
+}
+
+// Returns the field of plain data with the given name, or NULL.
+static PyRecordField *PyRecord_FindPlainField(PyRecord *pyrec, PyObject *obname)
+{
+	PyRecordLayout *layout = PyRecord_GetLayout(pyrec);
+	if (layout == NULL)
+		return NULL;
+	PyObject *obIndex = PyDict_GetItem(layout->fieldIndexes, obname);
+	if (obIndex == NULL)
+		return NULL;
+	return layout->fields + PyInt_AS_LONG(obIndex);
+}
+
+static PyObject *PyRecordField_Get(PyRecordField *field, void *data)
+{
+	VARIANT v;
+	VariantInit(&v);
+	V_VT(&v) = field->vt;
+	// All the plain types live at the start of the VARIANT's union.
+	memcpy(&V_UI1(&v), (BYTE *)data + field->offset, field->size);
+	return PyCom_PyObjectFromVariant(&v);
+}
+
+static BOOL PyRecordField_Set(PyRecordField *field, void *data, PyObject *ob, IRecordInfo *pri)
+{
+	VARIANT v;
+	VariantInit(&v);
+	if (!PyCom_VariantFromPyObject(ob, &v))
+		return FALSE;
+	// The same conversion IRecordInfo::PutField makes.
+	HRESULT hr = VariantChangeType(&v, &v, 0, field->vt);
+	if (FAILED(hr)) {
+		VariantClear(&v);
+		PyCom_BuildPyException(hr, pri, IID_IRecordInfo);
+		return FALSE;
+	}
+	memcpy((BYTE *)data + field->offset, &V_UI1(&v), field->size);
+	VariantClear(&v);
+	return TRUE;
+}
+
+// Returns a new reference to a tuple of the names of a record's fields.
+static BSTR *_GetFieldNames(IRecordInfo *pri, ULONG *pnum);
+static void _FreeFieldNames(BSTR *strings, ULONG num_names);
+static PyObject *PyRecord_GetFieldNames(PyRecord *pyrec)
+{
+	PyRecordLayout *layout = PyRecord_GetLayout(pyrec);
+	if (layout != NULL) {
+		Py_INCREF(layout->names);
+		return layout->names;
+	}
+	ULONG num_names;
+	BSTR *strings = _GetFieldNames(pyrec->pri, &num_names);
+	if (strings == NULL)
+		return NULL;
+	PyObject *ret = PyTuple_New(num_names);
+	for (ULONG i = 0; i < num_names && ret != NULL; i++) {
+		PyObject *item = PyWinCoreString_FromString(strings[i]);
+		if (item == NULL)
+			Py_CLEAR(ret);
+		else
+			PyTuple_SET_ITEM(ret, i, item);
+	}
+	_FreeFieldNames(strings, num_names);
+	return ret;
+}
+
 BOOL PyRecord_Check(PyObject *ob) {return ((ob)->ob_type == &PyRecord::Type);}
 
 BOOL PyObject_AsVARIANTRecordInfo(PyObject *ob, VARIANT *pv)
@@ -55,7 +378,8 @@ BOOL PyObject_AsVARIANTRecordInfo(PyObject *ob, VARIANT *pv)
 
 PyObject *PyObject_FromSAFEARRAYRecordInfo(SAFEARRAY *psa)
 {
-	PyObject *ret = NULL, *ret_tuple = NULL;
+	PyObject *ret = NULL, *ret_tuple = NULL, *obLayout = NULL;
+	BOOL bAllPlain;
 	IRecordInfo *info = NULL;
 	BYTE *source_data = NULL, *this_dest_data = NULL;
 	long lbound, ubound, nelems, i;
@@ -76,16 +400,28 @@ PyObject *PyObject_FromSAFEARRAYRecordInfo(SAFEARRAY *psa)
 	owner = new PyRecordBuffer(nelems * cb_elem);
 	if (PyErr_Occurred()) goto exit;
 	owner->AddRef(); // unref'd at end - for successful failure cleanup
+	obLayout = GetRecordLayout(info);
+	if (obLayout==NULL) goto exit;
 	ret_tuple = PyTuple_New(nelems);
 	if (ret_tuple==NULL) goto exit;
 	this_dest_data = (BYTE *)owner->data;
+	// Records of plain data need no per-record initialization, so the lot
+	// can be copied at once.
+	bAllPlain = obLayout != Py_None && ((PyRecordLayout *)obLayout)->bAllPlain;
+	if (bAllPlain)
+		memcpy(this_dest_data, source_data, nelems * cb_elem);
 	for (i=0;i<nelems;i++) {
-		hr = info->RecordInit(this_dest_data);
-		if (FAILED(hr)) goto exit;
+		if (!bAllPlain) {
+			hr = info->RecordInit(this_dest_data);
+			if (FAILED(hr)) goto exit;
 
-		hr = info->RecordCopy(source_data, this_dest_data);
-		if (FAILED(hr)) goto exit;
-		PyTuple_SET_ITEM(ret_tuple, i, new PyRecord(info, this_dest_data, owner));
+			hr = info->RecordCopy(source_data, this_dest_data);
+			if (FAILED(hr)) goto exit;
+		}
+		PyRecord *rec = new PyRecord(info, this_dest_data, owner);
+		rec->layout = obLayout;
+		Py_INCREF(obLayout);
+		PyTuple_SET_ITEM(ret_tuple, i, rec);
 		this_dest_data += cb_elem;
 		source_data += cb_elem;
 	}
@@ -102,6 +438,7 @@ exit:
 	}
 	if (owner != NULL) owner->Release();
 	Py_XDECREF(ret_tuple);
+	Py_XDECREF(obLayout);
 	if (info) info->Release();
 	if (source_data!=NULL) SafeArrayUnaccessData(psa);
 	return ret;
@@ -191,6 +528,93 @@ PyObject *pythoncom_GetRecordFromTypeInfo(PyObject *self, PyObject *args)
 	return ret;
 }
 
+// @pymethod tuple|pythoncom|GetRecordLayout|Returns the layout of a record's fields
+PyObject *pythoncom_GetRecordLayout(PyObject *self, PyObject *args)
+{
+	PyObject *obrec;
+	// @pyparm <o PyRecord>|record||The record whose type is described.
+	if (!PyArg_ParseTuple(args, "O:GetRecordLayout", &obrec))
+		return NULL;
+	if (!PyRecord_Check(obrec)) {
+		PyErr_SetString(PyExc_TypeError, "Only com_record objects have a layout");
+		return NULL;
+	}
+	PyRecordLayout *layout = PyRecord_GetLayout((PyRecord *)obrec);
+	if (layout == NULL) {
+		PyErr_SetString(PyExc_ValueError, "The record has no type information");
+		return NULL;
+	}
+	Py_ssize_t num = PyTuple_GET_SIZE(layout->names);
+	PyObject *ret = PyTuple_New(num);
+	for (Py_ssize_t i = 0; i < num && ret != NULL; i++) {
+		PyRecordField *field = layout->fields + i;
+		PyObject *item = Py_BuildValue("Okik", PyTuple_GET_ITEM(layout->names, i),
+			field->offset, field->vt, field->size);
+		if (item == NULL)
+			Py_CLEAR(ret);
+		else
+			PyTuple_SET_ITEM(ret, i, item);
+	}
+	return ret;
+	// @rdesc The result is a tuple with an item for each field of the
+	// record, in order.  Each item is a tuple of (name, offset, vartype, size).
+	// size is zero for fields which are not plain data (eg, strings, objects
+	// or nested records) - these can only be accessed as attributes.
+	// @comm The layout is read from the record's type information once,
+	// and shared by all records of the type.
+}
+
+// @pymethod bytes|pythoncom|RecordsToBuffer|Copies the data of a sequence of records into a single buffer
+PyObject *pythoncom_RecordsToBuffer(PyObject *self, PyObject *args)
+{
+	PyObject *obrecs, *ret = NULL;
+	// @pyparm sequence|records||A sequence of <o PyRecord> objects of the same type.
+	if (!PyArg_ParseTuple(args, "O:RecordsToBuffer", &obrecs))
+		return NULL;
+	PyObject *seq = PySequence_Fast(obrecs, "records must be a sequence");
+	if (seq == NULL)
+		return NULL;
+	Py_ssize_t num = PySequence_Fast_GET_SIZE(seq);
+	PyRecord *first = NULL;
+	PyRecordLayout *layout = NULL;
+	BYTE *dest;
+	for (Py_ssize_t i = 0; i < num; i++) {
+		PyObject *ob = PySequence_Fast_GET_ITEM(seq, i);
+		if (!PyRecord_Check(ob)) {
+			PyErr_SetString(PyExc_TypeError, "Only com_record objects can be copied");
+			goto done;
+		}
+		PyRecord *rec = (PyRecord *)ob;
+		if (first == NULL) {
+			first = rec;
+			layout = PyRecord_GetLayout(rec);
+			if (layout == NULL || !layout->bAllPlain) {
+				PyErr_SetString(PyExc_TypeError, "Only records holding plain data can be copied");
+				goto done;
+			}
+		} else if (rec->pri != first->pri && !rec->pri->IsMatchingType(first->pri)) {
+			PyErr_SetString(PyExc_TypeError, "The records must all be of the same type");
+			goto done;
+		}
+	}
+	ret = PyString_FromStringAndSize(NULL, layout ? num * layout->cbRecord : 0);
+	if (ret == NULL)
+		goto done;
+	dest = (BYTE *)PyString_AS_STRING(ret);
+	for (Py_ssize_t i = 0; i < num; i++) {
+		memcpy(dest, ((PyRecord *)PySequence_Fast_GET_ITEM(seq, i))->pdata, layout->cbRecord);
+		dest += layout->cbRecord;
+	}
+done:
+	Py_DECREF(seq);
+	return ret;
+	// @comm The records must only hold plain data - numbers, dates, enums
+	// and so on, but no strings, objects or nested records.  The result
+	// holds the raw data of each record in turn, so, with the offsets and
+	// types from <om pythoncom.GetRecordLayout>, it can be used to build a
+	// structured array without touching each field of each record.
+}
+
 PyRecord::PyRecord(IRecordInfo *ri, PVOID data, PyRecordBuffer *owner)
 {
 	ob_type = &PyRecord::Type;
@@ -200,10 +624,12 @@ PyRecord::PyRecord(IRecordInfo *ri, PVOID data, PyRecordBuffer *owner)
 	pdata = data;
 	this->owner = owner;
 	owner->AddRef();
+	layout = NULL;
 };
 
 PyRecord::~PyRecord()
 {
+	Py_XDECREF(layout);
 	owner->Release();
 	pri->Release();
 }
@@ -378,12 +804,12 @@ void PyWinCoreString_ConcatAndDel(register PyObject **pv, register PyObject *w)
 
 PyObject *PyRecord::tp_repr(PyObject *self)
 {
-	ULONG i;
+	Py_ssize_t i;
 	PyRecord *pyrec = (PyRecord *)self;
-	ULONG num_names;
-	BSTR *strings = _GetFieldNames(pyrec->pri, &num_names);
-	if (strings==NULL)
+	PyObject *names = PyRecord_GetFieldNames(pyrec);
+	if (names==NULL)
 		return NULL;
+	Py_ssize_t num_names = PyTuple_GET_SIZE(names);
 	PyObject *obrepr=NULL, *obattrname;
 	BOOL bsuccess=FALSE;
 	PyObject *comma = PyWinCoreString_FromString(_T(", "));
@@ -394,9 +820,8 @@ PyObject *PyRecord::tp_repr(PyObject *self)
 	if (obrepr==NULL || comma==NULL || equals==NULL || closing_paren==NULL)
 		goto done;
 	for (i = 0; i < num_names && obrepr != NULL; i++) {
-		obattrname=PyWinCoreString_FromString(strings[i]);
-		if (obattrname==NULL)
-			goto done;
+		obattrname=PyTuple_GET_ITEM(names, i);
+		Py_INCREF(obattrname);
 		// must exit on error via loop_error from here...
 		PyObject *sub_object = NULL;
 		if (i > 0){
@@ -429,8 +854,7 @@ done:
 	Py_XDECREF(comma);
 	Py_XDECREF(equals);
 	Py_XDECREF(closing_paren);
-	if (strings)
-		_FreeFieldNames(strings, num_names);
+	Py_DECREF(names);
 	if (!bsuccess){
 		Py_XDECREF(obrepr);
 		obrepr=NULL;
@@ -446,32 +870,18 @@ PyObject *PyRecord::getattro(PyObject *self, PyObject *obname)
 	if (name==NULL)
 		return NULL;
 	if (strcmp(name, "__members__")==0) {
-		ULONG cnames = 0;
-		HRESULT hr = pyrec->pri->GetFieldNames(&cnames, NULL);
-		if (FAILED(hr))
-			return PyCom_BuildPyException(hr, pyrec->pri, IID_IRecordInfo);
-		BSTR *strs = (BSTR *)malloc(sizeof(BSTR) * cnames);
-		if (strs==NULL)
-			return PyErr_NoMemory();
-		hr = pyrec->pri->GetFieldNames(&cnames, strs);
-		if (FAILED(hr)) {
-			free(strs);
-			return PyCom_BuildPyException(hr, pyrec->pri, IID_IRecordInfo);
-		}
-		res = PyList_New(cnames);
-		for (ULONG i=0;i<cnames && res != NULL;i++) {
-			PyObject *item = PyWinCoreString_FromString(strs[i]);
-			SysFreeString(strs[i]);
-			if (item==NULL) {
-				Py_DECREF(res);
-				res = NULL;
-			} else
-				PyList_SET_ITEM(res, i, item); // ref count swallowed.
-		}
-		free(strs);
+		PyObject *names = PyRecord_GetFieldNames(pyrec);
+		if (names==NULL)
+			return NULL;
+		res = PySequence_List(names);
+		Py_DECREF(names);
 		return res;
 	}
 
+	PyRecordField *field = PyRecord_FindPlainField(pyrec, obname);
+	if (field != NULL)
+		return PyRecordField_Get(field, pyrec->pdata);
+
 	res = PyObject_GenericGetAttr(self, obname);
 	if (res != NULL)
 		return res;
@@ -560,6 +970,10 @@ int PyRecord::setattro(PyObject *self, PyObject *obname, PyObject *v)
 	VariantInit(&val);
 	PyRecord *pyrec = (PyRecord *)self;
 
+	PyRecordField *field = v ? PyRecord_FindPlainField(pyrec, obname) : NULL;
+	if (field != NULL)
+		return PyRecordField_Set(field, pyrec->pdata, v, pyrec->pri) ? 0 : -1;
+
 	if (!PyCom_VariantFromPyObject(v, &val))
 		return -1;
 
@@ -601,15 +1015,13 @@ PyObject *PyRecord::tp_richcompare(PyObject *self, PyObject *other, int op)
 	}
 	// Need to do a recursive compare, as some elements may be pointers
 	// (eg, strings, objects)
-	ULONG num_names;
-	BSTR *strings = _GetFieldNames(pyself->pri, &num_names);
-	if (strings==NULL) return NULL;
-	for (ULONG i=0;i<num_names;i++) {
+	PyObject *names = PyRecord_GetFieldNames(pyself);
+	if (names==NULL) return NULL;
+	for (Py_ssize_t i=0;i<PyTuple_GET_SIZE(names);i++) {
 		ret = 0;
 		PyObject *obattrname;
-		obattrname=PyWinCoreString_FromString(strings[i]);
-		if (obattrname==NULL)
-			goto done;
+		obattrname=PyTuple_GET_ITEM(names, i);
+		Py_INCREF(obattrname);
 		// There appear to be several problems here.  This will leave an exception hanging
 		//	if an attribute is not found, and should probably return False if other does not
 		//	have an attr that self does ???
@@ -641,7 +1053,7 @@ PyObject *PyRecord::tp_richcompare(PyObject *self, PyObject *other, int op)
 	}
 	ret = PyBool_FromLong(success);
 done:
-	_FreeFieldNames(strings, num_names);
+	Py_DECREF(names);
 	return ret;
 }
 
@@ -59,6 +59,25 @@ extern PyObject *pythoncom_CreateILockBytesOnHGlobal(PyObject *self, PyObject *a
 
 extern PyObject *pythoncom_GetRecordFromGuids(PyObject *self, PyObject *args);
 extern PyObject *pythoncom_GetRecordFromTypeInfo(PyObject *self, PyObject *args);
+extern PyObject *pythoncom_GetRecordLayout(PyObject *self, PyObject *args);
+extern PyObject *pythoncom_RecordsToBuffer(PyObject *self, PyObject *args);
+extern PyTypeObject PyRecordLayoutType;
+extern PyObject *pythoncom_SetSafeArrayAsBuffer(PyObject *self, PyObject *args);
+extern PyObject *pythoncom_CompileInvokeTypes(PyObject *self, PyObject *args);
+extern PyTypeObject PyInvokeTypesSignatureType;
+extern PyObject *pythoncom_GetMemberCache(PyObject *self, PyObject *args);
+extern PyObject *pythoncom_ExtractTypeLib(PyObject *self, PyObject *args);
+extern PyObject *pythoncom_GetMemberCacheStats(PyObject *self, PyObject *args);
+extern PyObject *pythoncom_SetMemberCacheSize(PyObject *self, PyObject *args);
+extern PyObject *pythoncom_ClearMemberCache(PyObject *self, PyObject *args);
+extern PyTypeObject PyMemberCacheType;
+extern PyTypeObject PyEnumVARIANTIteratorType;
+extern PyObject *pythoncom_GetArgAllocStats(PyObject *self, PyObject *args);
+extern PyObject *pythoncom_InvalidateGatewayNameCache(PyObject *self, PyObject *args);
+extern PyObject *pythoncom_GetGatewayNameCacheStats(PyObject *self, PyObject *args);
+#if (PY_VERSION_HEX >= 0x03000000)
+extern PyTypeObject PySafeArrayBufferType;
+#endif
 
 extern PyObject *Py_NewSTGMEDIUM(PyObject *self, PyObject *args);
 
@@ -1990,6 +2009,8 @@ static struct PyMethodDef pythoncom_methods[]=
 	{ "CoRevokeClassObject",pythoncom_CoRevokeClassObject, 1 },// @pymeth CoRevokeClassObject|Informs OLE that a class object, previously registered with the <om pythoncom.CoRegisterClassObject> method, is no longer available for use. 
 	{ "CoTreatAsClass",      pythoncom_CoTreatAsClass, 1}, // @pymeth CoTreatAsClass|Establishes or removes an emulation, in which objects of one class are treated as objects of a different class.
 	{ "CoWaitForMultipleHandles", pythoncom_CoWaitForMultipleHandles, 1}, // @pymeth CoWaitForMultipleHandles|Waits for specified handles to be signaled or for a specified timeout period to elapse.
+	{ "ClearMemberCache",    pythoncom_ClearMemberCache, 1},     // @pymeth ClearMemberCache|Empties the member cache and resets its statistics.
+	{ "CompileInvokeTypes",  pythoncom_CompileInvokeTypes, 1}, // @pymeth CompileInvokeTypes|Compiles the type descriptions for <om PyIDispatch.InvokeTypes> into a callable signature.
 	{ "Connect",             pythoncom_connect, 1 },			 // @pymeth Connect|Connects to a running instance of an OLE automation server.
 	{ "connect",             pythoncom_connect, 1 },
 	{ "CreateGuid",          pythoncom_createguid, 1 },          // @pymeth CreateGuid|Creates a new, unique GUIID.
@@ -2007,20 +2028,27 @@ static struct PyMethodDef pythoncom_methods[]=
 	{ "CreateILockBytesOnHGlobal",   pythoncom_CreateILockBytesOnHGlobal, 1 }, // @pymeth CreateILockBytesOnHGlobal|Creates an ILockBytes interface based on global memory
 
 	{ "EnableQuitMessage",   pythoncom_EnableQuitMessage, 1 }, // @pymeth EnableQuitMessage|Indicates the thread PythonCOM should post a WM_QUIT message to.
+	{ "ExtractTypeLib",      pythoncom_ExtractTypeLib, 1},       // @pymeth ExtractTypeLib|Reads all the information makepy needs from a type library.
 	{ "FUNCDESC",            Py_NewFUNCDESC, 1}, // @pymeth FUNCDESC|Returns a new <o FUNCDESC> object.
 #ifndef MS_WINCE
 	{ "GetActiveObject",     pythoncom_GetActiveObject, 1 },     // @pymeth GetActiveObject|Retrieves an object representing a running object registered with OLE
 	{ "GetClassFile",        pythoncom_GetClassFile, 1 },        // @pymeth GetClassFile|Supplies the CLSID associated with the given filename.
 #endif // MS_WINCE
+	{ "GetArgAllocStats",    pythoncom_GetArgAllocStats, 1},     // @pymeth GetArgAllocStats|Returns the number of temporaries allocated while converting arguments.
 	{ "GetFacilityString",   pythoncom_GetFacilityString, 1 },   // @pymeth GetFacilityString|Returns the facility string, given an OLE scode.
+	{ "GetGatewayNameCacheStats", pythoncom_GetGatewayNameCacheStats, 1}, // @pymeth GetGatewayNameCacheStats|Returns statistics about the GetIDsOfNames cache.
+	{ "GetMemberCache",      pythoncom_GetMemberCache, 1},       // @pymeth GetMemberCache|Returns the member cache shared by all objects of a type.
+	{ "GetMemberCacheStats", pythoncom_GetMemberCacheStats, 1},  // @pymeth GetMemberCacheStats|Returns statistics about the member cache.
 	{ "GetRecordFromGuids",  pythoncom_GetRecordFromGuids, 1},   // @pymeth GetRecordFromGuids|Creates a new record object from the given GUIDs
 	{ "GetRecordFromTypeInfo", pythoncom_GetRecordFromTypeInfo, 1},   // @pymeth GetRecordFromTypeInfo|Creates a <o PyRecord> object from a <o PyITypeInfo> interface
+	{ "GetRecordLayout",     pythoncom_GetRecordLayout, 1},      // @pymeth GetRecordLayout|Returns the layout of a record's fields
 #ifndef MS_WINCE
 	{ "GetRunningObjectTable", pythoncom_GetRunningObjectTable, 1 }, // @pymeth GetRunningObjectTable|Obtains a <o PyIRunningObjectTable> object.
 #endif // MS_WINCE
 	{ "GetScodeString",      pythoncom_GetScodeString, 1 },      // @pymeth GetScodeString|Returns the string for an OLE scode.
 	{ "GetScodeRangeString", pythoncom_GetScodeRangeString, 1 }, // @pymeth GetScodeRangeString|Returns the scode range string, given an OLE scode.
 	{ "GetSeverityString",   pythoncom_GetSeverityString, 1 },   // @pymeth GetSeverityString|Returns the severity string, given an OLE scode.
+	{ "InvalidateGatewayNameCache", pythoncom_InvalidateGatewayNameCache, 1}, // @pymeth InvalidateGatewayNameCache|Forgets the names a gateway has resolved via GetIDsOfNames.
 	{ "IsGatewayRegistered", pythoncom_IsGatewayRegistered, 1}, // @pymeth IsGatewayRegistered|Returns 1 if the given IID has a registered gateway object.
 	{ "LoadRegTypeLib",      pythoncom_loadregtypelib, 1 },		 // @pymeth LoadRegTypeLib|Loads a registered type library by CLSID
 	{ "LoadTypeLib",         pythoncom_loadtypelib, 1 },		 // @pymeth LoadTypeLib|Loads a type library by name
@@ -2050,6 +2078,7 @@ static struct PyMethodDef pythoncom_methods[]=
 #ifndef MS_WINCE
 	{ "QueryPathOfRegTypeLib",pythoncom_querypathofregtypelib, 1}, // @pymeth QueryPathOfRegTypeLib|Retrieves the path of a registered type library
 #endif // MS_WINCE
+	{ "RecordsToBuffer",     pythoncom_RecordsToBuffer, 1},      // @pymeth RecordsToBuffer|Copies the data of a sequence of records into a single buffer
 	{ "ReadClassStg",        pythoncom_ReadClassStg, 1}, // @pymeth ReadClassStg|Reads a CLSID from a storage object
 	{ "ReadClassStm",        pythoncom_ReadClassStm, 1}, // @pymeth ReadClassStm|Reads a CLSID from a <o PyIStream> object
 	{ "RegisterTypeLib",     pythoncom_registertypelib, 1}, // @pymeth RegisterTypeLib|Adds information about a type library to the system registry.
@@ -2061,6 +2090,8 @@ static struct PyMethodDef pythoncom_methods[]=
 	{ "RevokeDragDrop",      pythoncom_RevokeDragDrop, 1}, // @pymeth RevokeDragDrop|Revokes the specified window as the target of an OLE drag-and-drop operation.
 	{ "DoDragDrop",          pythoncom_DoDragDrop, 1}, // @pymeth DoDragDrop|Carries out an OLE drag and drop operation.
 #endif // MS_WINCE
+	{ "SetSafeArrayAsBuffer", pythoncom_SetSafeArrayAsBuffer, 1}, // @pymeth SetSafeArrayAsBuffer|Controls whether numeric SAFEARRAYs are returned as memoryview objects.
+	{ "SetMemberCacheSize",  pythoncom_SetMemberCacheSize, 1},   // @pymeth SetMemberCacheSize|Sets the maximum number of names held by the member cache.
 	{ "StgCreateDocfile",      pythoncom_StgCreateDocfile, 1 },       // @pymeth StgCreateDocfile|Creates a new compound file storage object using the OLE-provided compound file implementation for the <o PyIStorage> interface.
 	{ "StgCreateDocfileOnILockBytes",      pythoncom_StgCreateDocfileOnILockBytes, 1 }, // @pymeth StgCreateDocfileOnILockBytes|Creates a new compound file storage object using the OLE-provided compound file implementation for the <o PyIStorage> interface.
 #ifndef MS_WINCE
@@ -2190,8 +2221,16 @@ PYWIN_MODULE_INIT_FUNC(pythoncom)
 		PyType_Ready(&PySTGMEDIUM::Type) == -1 ||
 		PyType_Ready(&PyTYPEATTR::Type) == -1 ||
 		PyType_Ready(&PyVARDESC::Type) == -1 ||
-		PyType_Ready(&PyRecord::Type) == -1)
+		PyType_Ready(&PyRecord::Type) == -1 ||
+		PyType_Ready(&PyRecordLayoutType) == -1 ||
+		PyType_Ready(&PyInvokeTypesSignatureType) == -1 ||
+		PyType_Ready(&PyMemberCacheType) == -1 ||
+		PyType_Ready(&PyEnumVARIANTIteratorType) == -1)
+		PYWIN_MODULE_INIT_RETURN_ERROR;
+#if (PY_VERSION_HEX >= 0x03000000)
+	if (PyType_Ready(&PySafeArrayBufferType) == -1)
 		PYWIN_MODULE_INIT_RETURN_ERROR;
+#endif
 
 	// Setup our sub-modules
 	if (!initunivgw(dict))
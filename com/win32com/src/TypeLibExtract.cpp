@@ -0,0 +1,476 @@
+// TypeLibExtract.cpp - reads an entire type library in a single call.
+//
+// win32com.client.genpy builds its wrappers by walking a type library a member
+// at a time - GetFuncDesc, GetNames and GetDocumentation calls for every
+// function of every type, each made through the interpreter.  For the large
+// Office libraries that is hundreds of thousands of calls.
+// pythoncom.ExtractTypeLib makes the same walk in C++ and returns everything
+// genpy needs as tuples, dicts, ints and strings, which
+// win32com.client.tlbsnapshot then presents to genpy as the usual objects.
+//
+// Only plain Python values are returned (IIDs are returned as strings), so the
+// result can be pickled or cached and used again without the type library, or
+// Windows, being present.
+// @doc
+#include "stdafx.h"
+#include "PythonCOM.h"
+#include "PyComTypeObjects.h"
+
+// The version of the format returned - bumped whenever it changes, so cached
+// snapshots can be recognised as stale.
+#define PYCOM_TYPELIB_SNAPSHOT_VERSION 1
+
+struct TypeLibExtractor {
+	TLIBATTR *pLibAttr;	// The attributes of the library being extracted.
+	PyObject *types;	// A list of type dicts, or None for types not yet described.
+	PyObject *infos;	// A list of PyITypeInfo objects, parallel to types.
+	PyObject *keys;		// type key -> index into types.
+	PyObject *queue;	// A list of (index, bFull) to be processed.
+};
+
+// Returns the href of the user defined type at the bottom of a TYPEDESC.
+static BOOL GetUserDefinedHref(const TYPEDESC *td, HREFTYPE *pHref)
+{
+	for (;;) {
+		if (td->vt == VT_PTR || td->vt == VT_SAFEARRAY)
+			td = td->lptdesc;
+		else if (td->vt == VT_CARRAY)
+			td = &td->lpadesc->tdescElem;
+		else if (td->vt == VT_USERDEFINED) {
+			*pHref = td->hreftype;
+			return TRUE;
+		} else
+			return FALSE;
+	}
+}
+
+// As for PyITypeInfo::GetDocumentation, but returns None if the call fails.
+static PyObject *ExtractDocumentation(ITypeInfo *pti, MEMBERID id)
+{
+	BSTR name = NULL, docstring = NULL, helpfile = NULL;
+	unsigned long helpctx = 0;
+	PY_INTERFACE_PRECALL;
+	HRESULT hr = pti->GetDocumentation(id, &name, &docstring, &helpctx, &helpfile);
+	PY_INTERFACE_POSTCALL;
+	if (FAILED(hr)) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+	// See PyITypeInfo::GetDocumentation for why these are not treated as BSTRs.
+	PyObject *ret = Py_BuildValue("(NNiN)", MakeOLECHARToObj(name), MakeOLECHARToObj(docstring),
+		helpctx, MakeOLECHARToObj(helpfile));
+	SysFreeString(name);
+	SysFreeString(docstring);
+	SysFreeString(helpfile);
+	return ret;
+}
+
+// As for PyITypeInfo::GetNames, but returns None if the call fails.
+static PyObject *ExtractNames(ITypeInfo *pti, MEMBERID id)
+{
+	BSTR names[256];
+	unsigned len = 0;
+	PY_INTERFACE_PRECALL;
+	HRESULT hr = pti->GetNames(id, names, 256, &len);
+	PY_INTERFACE_POSTCALL;
+	if (FAILED(hr)) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+	PyObject *ret = PyTuple_New(len);
+	for (unsigned i = 0; i < len; i++) {
+		if (ret) {
+			PyObject *obName = MakeOLECHARToObj(names[i]);
+			if (obName)
+				PyTuple_SET_ITEM(ret, i, obName);
+			else
+				Py_CLEAR(ret);
+		}
+		SysFreeString(names[i]);
+	}
+	return ret;
+}
+
+// Returns the index of the type, adding it (to be described later) if it has
+// not been seen before, and queueing it to be expanded if bFull.  Returns -1
+// with an exception set on failure.
+static Py_ssize_t FindOrAddType(TypeLibExtractor *ext, ITypeInfo *pti, BOOL bFull)
+{
+	// Types are identified by their containing library and index, and the
+	// types of the library being extracted just by their index.
+	PyObject *key = NULL;
+	ITypeLib *pLib = NULL;
+	UINT index;
+	PY_INTERFACE_PRECALL;
+	HRESULT hr = pti->GetContainingTypeLib(&pLib, &index);
+	PY_INTERFACE_POSTCALL;
+	if (SUCCEEDED(hr)) {
+		TLIBATTR *pAttr;
+		PY_INTERFACE_PRECALL;
+		hr = pLib->GetLibAttr(&pAttr);
+		PY_INTERFACE_POSTCALL;
+		if (SUCCEEDED(hr)) {
+			TLIBATTR *pOwn = ext->pLibAttr;
+			if (IsEqualGUID(pAttr->guid, pOwn->guid) && pAttr->lcid == pOwn->lcid &&
+			    pAttr->wMajorVerNum == pOwn->wMajorVerNum && pAttr->wMinorVerNum == pOwn->wMinorVerNum)
+				key = PyInt_FromLong(index);
+			else
+				key = Py_BuildValue("NkiiI", PyWinCoreString_FromIID(pAttr->guid), pAttr->lcid,
+					pAttr->wMajorVerNum, pAttr->wMinorVerNum, index);
+			PY_INTERFACE_PRECALL;
+			pLib->ReleaseTLibAttr(pAttr);
+			PY_INTERFACE_POSTCALL;
+		}
+		PYCOM_RELEASE(pLib);
+	}
+	// A type not in any library - the PyITypeInfo held in infos keeps the
+	// address from being reused.
+	if (FAILED(hr))
+		key = PyLong_FromVoidPtr(pti);
+	if (key == NULL)
+		return -1;
+
+	Py_ssize_t ret;
+	PyObject *obIndex = PyDict_GetItem(ext->keys, key);
+	if (obIndex) {
+		ret = PyInt_AsSsize_t(obIndex);
+		// Expanding a type that is already expanded is a no-op.
+		if (!bFull) {
+			Py_DECREF(key);
+			return ret;
+		}
+	} else {
+		ret = PyList_GET_SIZE(ext->types);
+		PyObject *obInfo = PyCom_PyObjectFromIUnknown(pti, IID_ITypeInfo, TRUE);
+		if (obInfo == NULL || PyList_Append(ext->infos, obInfo) != 0 ||
+		    PyList_Append(ext->types, Py_None) != 0) {
+			Py_XDECREF(obInfo);
+			Py_DECREF(key);
+			return -1;
+		}
+		Py_DECREF(obInfo);
+		obIndex = PyInt_FromSsize_t(ret);
+		if (obIndex == NULL || PyDict_SetItem(ext->keys, key, obIndex) != 0) {
+			Py_XDECREF(obIndex);
+			Py_DECREF(key);
+			return -1;
+		}
+		Py_DECREF(obIndex);
+	}
+	Py_DECREF(key);
+	PyObject *item = Py_BuildValue("ni", ret, bFull);
+	if (item == NULL || PyList_Append(ext->queue, item) != 0)
+		ret = -1;
+	Py_XDECREF(item);
+	return ret;
+}
+
+// Records the type an href of a type refers to.  Failures to load the type are
+// recorded in the badrefs dict, to be raised when genpy asks for it.
+static BOOL AddRef(TypeLibExtractor *ext, ITypeInfo *pti, PyObject *entry, HREFTYPE href, BOOL bFull)
+{
+	PyObject *refs = PyDict_GetItemString(entry, "refs");
+	PyObject *obHref = PyInt_FromLong(href);
+	if (obHref == NULL)
+		return FALSE;
+	if (!bFull && PyDict_GetItem(refs, obHref)) {
+		Py_DECREF(obHref);
+		return TRUE;
+	}
+	ITypeInfo *pRef = NULL;
+	PY_INTERFACE_PRECALL;
+	HRESULT hr = pti->GetRefTypeInfo(href, &pRef);
+	PY_INTERFACE_POSTCALL;
+	BOOL ok;
+	if (FAILED(hr)) {
+		PyObject *obHr = PyInt_FromLong(hr);
+		ok = obHr && PyDict_SetItem(PyDict_GetItemString(entry, "badrefs"), obHref, obHr) == 0;
+		Py_XDECREF(obHr);
+	} else {
+		Py_ssize_t index = FindOrAddType(ext, pRef, bFull);
+		PYCOM_RELEASE(pRef);
+		PyObject *obIndex = index < 0 ? NULL : PyInt_FromSsize_t(index);
+		ok = obIndex && PyDict_SetItem(refs, obHref, obIndex) == 0;
+		Py_XDECREF(obIndex);
+	}
+	Py_DECREF(obHref);
+	return ok;
+}
+
+static BOOL AddTypeDescRef(TypeLibExtractor *ext, ITypeInfo *pti, PyObject *entry, const TYPEDESC *td)
+{
+	HREFTYPE href;
+	if (!GetUserDefinedHref(td, &href))
+		return TRUE;
+	return AddRef(ext, pti, entry, href, FALSE);
+}
+
+// Creates the dict for a type, with its attributes and documentation, and
+// records the type it is an alias for.
+static PyObject *DescribeType(TypeLibExtractor *ext, ITypeInfo *pti)
+{
+	TYPEATTR *attr;
+	PY_INTERFACE_PRECALL;
+	HRESULT hr = pti->GetTypeAttr(&attr);
+	PY_INTERFACE_POSTCALL;
+	if (FAILED(hr))
+		return PyCom_BuildPyException(hr, pti, IID_ITypeInfo);
+
+	PyObject *ret = NULL;
+	// The TYPEATTR as a tuple, with the IID as a string.
+	PyObject *obAttr = PyObject_FromTYPEATTR(attr);
+	PyObject *tupleAttr = obAttr ? PySequence_Tuple(obAttr) : NULL;
+	PyObject *obIID = PyWinCoreString_FromIID(attr->guid);
+	if (tupleAttr && obIID) {
+		PyObject *old = PyTuple_GET_ITEM(tupleAttr, 0);
+		PyTuple_SET_ITEM(tupleAttr, 0, obIID);
+		Py_DECREF(old);
+		obIID = NULL;
+		ret = Py_BuildValue("{s:O,s:N,s:O,s:O,s:O,s:N,s:N}",
+			"attr", tupleAttr,
+			"doc", ExtractDocumentation(pti, MEMBERID_NIL),
+			"funcs", Py_None,
+			"vars", Py_None,
+			"impl", Py_None,
+			"refs", PyDict_New(),
+			"badrefs", PyDict_New());
+	}
+	Py_XDECREF(obAttr);
+	Py_XDECREF(tupleAttr);
+	Py_XDECREF(obIID);
+	if (ret && attr->typekind == TKIND_ALIAS && !AddTypeDescRef(ext, pti, ret, &attr->tdescAlias))
+		Py_CLEAR(ret);
+	{
+	PY_INTERFACE_PRECALL;
+	pti->ReleaseTypeAttr(attr);
+	PY_INTERFACE_POSTCALL;
+	}
+	return ret;
+}
+
+// Fills in the functions, variables and implemented types of a type.
+static BOOL ExpandType(TypeLibExtractor *ext, ITypeInfo *pti, PyObject *entry)
+{
+	PyObject *attr = PyDict_GetItemString(entry, "attr");
+	int typekind = PyInt_AsLong(PyTuple_GET_ITEM(attr, 5));
+	int cFuncs = PyInt_AsLong(PyTuple_GET_ITEM(attr, 6));
+	int cVars = PyInt_AsLong(PyTuple_GET_ITEM(attr, 7));
+	int cImplTypes = PyInt_AsLong(PyTuple_GET_ITEM(attr, 8));
+	int typeFlags = PyInt_AsLong(PyTuple_GET_ITEM(attr, 11));
+	HRESULT hr;
+	int i;
+
+	PyObject *funcs = PyTuple_New(cFuncs);
+	if (funcs == NULL || PyDict_SetItemString(entry, "funcs", funcs) != 0) {
+		Py_XDECREF(funcs);
+		return FALSE;
+	}
+	Py_DECREF(funcs);
+	for (i = 0; i < cFuncs; i++) {
+		FUNCDESC *desc;
+		PY_INTERFACE_PRECALL;
+		hr = pti->GetFuncDesc(i, &desc);
+		PY_INTERFACE_POSTCALL;
+		if (FAILED(hr)) {
+			PyCom_BuildPyException(hr, pti, IID_ITypeInfo);
+			return FALSE;
+		}
+		PyObject *obDesc = PyObject_FromFUNCDESC(desc);
+		PyObject *item = NULL;
+		if (obDesc)
+			item = Py_BuildValue("NNN", PySequence_Tuple(obDesc),
+				ExtractNames(pti, desc->memid), ExtractDocumentation(pti, desc->memid));
+		Py_XDECREF(obDesc);
+		BOOL ok = item != NULL && AddTypeDescRef(ext, pti, entry, &desc->elemdescFunc.tdesc);
+		for (SHORT j = 0; ok && j < desc->cParams; j++)
+			ok = AddTypeDescRef(ext, pti, entry, &desc->lprgelemdescParam[j].tdesc);
+		{
+		PY_INTERFACE_PRECALL;
+		pti->ReleaseFuncDesc(desc);
+		PY_INTERFACE_POSTCALL;
+		}
+		if (item)
+			PyTuple_SET_ITEM(funcs, i, item);
+		if (!ok)
+			return FALSE;
+	}
+
+	PyObject *vars = PyTuple_New(cVars);
+	if (vars == NULL || PyDict_SetItemString(entry, "vars", vars) != 0) {
+		Py_XDECREF(vars);
+		return FALSE;
+	}
+	Py_DECREF(vars);
+	for (i = 0; i < cVars; i++) {
+		VARDESC *desc;
+		PY_INTERFACE_PRECALL;
+		hr = pti->GetVarDesc(i, &desc);
+		PY_INTERFACE_POSTCALL;
+		if (FAILED(hr)) {
+			PyCom_BuildPyException(hr, pti, IID_ITypeInfo);
+			return FALSE;
+		}
+		PyObject *obDesc = PyObject_FromVARDESC(desc);
+		PyObject *item = NULL;
+		if (obDesc)
+			item = Py_BuildValue("NNN", PySequence_Tuple(obDesc),
+				ExtractNames(pti, desc->memid), ExtractDocumentation(pti, desc->memid));
+		Py_XDECREF(obDesc);
+		BOOL ok = item != NULL && AddTypeDescRef(ext, pti, entry, &desc->elemdescVar.tdesc);
+		{
+		PY_INTERFACE_PRECALL;
+		pti->ReleaseVarDesc(desc);
+		PY_INTERFACE_POSTCALL;
+		}
+		if (item)
+			PyTuple_SET_ITEM(vars, i, item);
+		if (!ok)
+			return FALSE;
+	}
+
+	// index -> (href, flags).  The interface of a dual dispinterface is
+	// stored as index -1.
+	PyObject *impl = PyDict_New();
+	if (impl == NULL || PyDict_SetItemString(entry, "impl", impl) != 0) {
+		Py_XDECREF(impl);
+		return FALSE;
+	}
+	Py_DECREF(impl);
+	BOOL bDual = typekind == TKIND_DISPATCH && (typeFlags & TYPEFLAG_FDUAL);
+	for (i = bDual ? -1 : 0; i < cImplTypes; i++) {
+		HREFTYPE href;
+		int flags = 0;
+		PY_INTERFACE_PRECALL;
+		hr = pti->GetRefTypeOfImplType(i, &href);
+		if (SUCCEEDED(hr) && i >= 0)
+			hr = pti->GetImplTypeFlags(i, &flags);
+		PY_INTERFACE_POSTCALL;
+		if (FAILED(hr)) {
+			PyCom_BuildPyException(hr, pti, IID_ITypeInfo);
+			return FALSE;
+		}
+		PyObject *key = PyInt_FromLong(i);
+		PyObject *value = Py_BuildValue("ii", href, flags);
+		BOOL ok = key && value && PyDict_SetItem(impl, key, value) == 0;
+		Py_XDECREF(key);
+		Py_XDECREF(value);
+		if (!ok || !AddRef(ext, pti, entry, href, TRUE))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static PyObject *DoExtractTypeLib(TypeLibExtractor *ext, ITypeLib *pLib)
+{
+	UINT count;
+	UINT i;
+	PY_INTERFACE_PRECALL;
+	count = pLib->GetTypeInfoCount();
+	PY_INTERFACE_POSTCALL;
+	// The library's own types first, so their indexes match the library's.
+	for (i = 0; i < count; i++) {
+		ITypeInfo *pti;
+		PY_INTERFACE_PRECALL;
+		HRESULT hr = pLib->GetTypeInfo(i, &pti);
+		PY_INTERFACE_POSTCALL;
+		if (FAILED(hr))
+			return PyCom_BuildPyException(hr, pLib, IID_ITypeLib);
+		Py_ssize_t index = FindOrAddType(ext, pti, TRUE);
+		PYCOM_RELEASE(pti);
+		if (index < 0)
+			return NULL;
+		if (index != (Py_ssize_t)i) {
+			PyErr_SetString(PyExc_RuntimeError, "The type library returned a type it does not contain");
+			return NULL;
+		}
+	}
+	// Types are only expanded when genpy may need their members - all of the
+	// library's own types, and types they implement.  Other types referred to
+	// only need their attributes and documentation.
+	for (Py_ssize_t pos = 0; pos < PyList_GET_SIZE(ext->queue); pos++) {
+		Py_ssize_t index;
+		int bFull;
+		if (!PyArg_ParseTuple(PyList_GET_ITEM(ext->queue, pos), "ni", &index, &bFull))
+			return NULL;
+		ITypeInfo *pti = PyITypeInfo::GetI(PyList_GET_ITEM(ext->infos, index));
+		PyObject *entry = PyList_GET_ITEM(ext->types, index);
+		if (entry == Py_None) {
+			entry = DescribeType(ext, pti);
+			if (entry == NULL)
+				return NULL;
+			// steals the reference.
+			PyList_SetItem(ext->types, index, entry);
+		}
+		if (bFull && PyDict_GetItemString(entry, "funcs") == Py_None && !ExpandType(ext, pti, entry))
+			return NULL;
+	}
+
+	BSTR name, docstring, helpfile;
+	unsigned long helpctx;
+	PY_INTERFACE_PRECALL;
+	HRESULT hr = pLib->GetDocumentation(-1, &name, &docstring, &helpctx, &helpfile);
+	PY_INTERFACE_POSTCALL;
+	if (FAILED(hr))
+		return PyCom_BuildPyException(hr, pLib, IID_ITypeLib);
+	PyObject *obDoc = Py_BuildValue("(NNiN)", MakeOLECHARToObj(name), MakeOLECHARToObj(docstring),
+		helpctx, MakeOLECHARToObj(helpfile));
+	SysFreeString(name);
+	SysFreeString(docstring);
+	SysFreeString(helpfile);
+	if (obDoc == NULL)
+		return NULL;
+
+	TLIBATTR *la = ext->pLibAttr;
+	return Py_BuildValue("{s:i,s:(Niiiii),s:N,s:I,s:O}",
+		"version", PYCOM_TYPELIB_SNAPSHOT_VERSION,
+		"libattr", PyWinCoreString_FromIID(la->guid), la->lcid, la->syskind,
+			la->wMajorVerNum, la->wMinorVerNum, la->wLibFlags,
+		"doc", obDoc,
+		"count", count,
+		"types", ext->types);
+}
+
+// @pymethod dict|pythoncom|ExtractTypeLib|Reads all the information makepy needs from a type library.
+PyObject *pythoncom_ExtractTypeLib(PyObject *self, PyObject *args)
+{
+	PyObject *obTypeLib;
+	// @pyparm <o PyITypeLib>|typelib||The type library.
+	if (!PyArg_ParseTuple(args, "O:ExtractTypeLib", &obTypeLib))
+		return NULL;
+	ITypeLib *pLib;
+	if (!PyCom_InterfaceFromPyInstanceOrObject(obTypeLib, IID_ITypeLib, (void **)&pLib, FALSE))
+		return NULL;
+	TypeLibExtractor ext;
+	PyObject *ret = NULL;
+	PY_INTERFACE_PRECALL;
+	HRESULT hr = pLib->GetLibAttr(&ext.pLibAttr);
+	PY_INTERFACE_POSTCALL;
+	if (FAILED(hr)) {
+		PyCom_BuildPyException(hr, pLib, IID_ITypeLib);
+		PYCOM_RELEASE(pLib);
+		return NULL;
+	}
+	ext.types = PyList_New(0);
+	ext.infos = PyList_New(0);
+	ext.keys = PyDict_New();
+	ext.queue = PyList_New(0);
+	if (ext.types && ext.infos && ext.keys && ext.queue)
+		ret = DoExtractTypeLib(&ext, pLib);
+	Py_XDECREF(ext.types);
+	Py_XDECREF(ext.infos);
+	Py_XDECREF(ext.keys);
+	Py_XDECREF(ext.queue);
+	{
+	PY_INTERFACE_PRECALL;
+	pLib->ReleaseTLibAttr(ext.pLibAttr);
+	PY_INTERFACE_POSTCALL;
+	}
+	PYCOM_RELEASE(pLib);
+	return ret;
+	// @rdesc The result is a dictionary holding only plain Python values,
+	// so it can be pickled and reloaded later.  It is normally used via the
+	// win32com.client.tlbsnapshot module, which documents its format.
+	// @comm The library's own types are described in full, as are the types
+	// they implement.  Other types they refer to (for example, in another
+	// library) only have their attributes and documentation.
+}
@@ -2,6 +2,9 @@
 #include "PythonCOM.h"
 #include "PyIEnumVARIANT.h"
 
+// Next() calls for up to this many items use a buffer on the stack.
+#define PYCOM_ENUM_SMALL_FETCH 16
+
 PyIEnumVARIANT::PyIEnumVARIANT(IUnknown *pdisp):
 	PyIUnknown(pdisp)
 {
@@ -28,8 +31,14 @@ PyObject *PyIEnumVARIANT::Next(PyObject *self, PyObject *args)
 	IEnumVARIANT *pIEVARIANT = GetI(self);
 	if ( pIEVARIANT == NULL )
 		return NULL;
+	if ( celt < 0 ) {
+		PyErr_SetString(PyExc_ValueError, "The number of items can not be negative");
+		return NULL;
+	}
 
-	VARIANT *rgVar = new VARIANT[celt];
+	// Most calls are for a single item, so avoid the heap for those.
+	VARIANT varSmall[PYCOM_ENUM_SMALL_FETCH];
+	VARIANT *rgVar = celt <= PYCOM_ENUM_SMALL_FETCH ? varSmall : new VARIANT[celt];
 	if ( rgVar == NULL ) {
 		PyErr_SetString(PyExc_MemoryError, "allocating result VARIANTs");
 		return NULL;
@@ -45,7 +54,8 @@ PyObject *PyIEnumVARIANT::Next(PyObject *self, PyObject *args)
 	PY_INTERFACE_POSTCALL;
 	if ( FAILED(hr) )
 	{
-		delete [] rgVar;
+		if ( rgVar != varSmall )
+			delete [] rgVar;
 		return PyCom_BuildPyException(hr);
 	}
 
@@ -67,7 +77,8 @@ PyObject *PyIEnumVARIANT::Next(PyObject *self, PyObject *args)
 
 	for ( i = celtFetched; i--; )
 		VariantClear(&rgVar[i]);
-	delete [] rgVar;
+	if ( rgVar != varSmall )
+		delete [] rgVar;
 
 	return result;
 	// @rdesc The result is a tuple of Python objects converted from Variants,
@@ -136,6 +147,224 @@ PyObject *PyIEnumVARIANT::Clone(PyObject *self, PyObject *args)
 	return PyCom_PyObjectFromIUnknown(pClone, IID_IEnumVARIANT, FALSE);
 }
 
+// The defaults for PyIEnumVARIANT::Iter.
+#define PYCOM_ENUM_DEFAULT_MAX_BATCH 64
+#define PYCOM_ENUM_DEFAULT_LATENCY 10
+
+// An iterator over an IEnumVARIANT which fetches items in batches, sized
+// according to how long each call to Next takes.
+struct PyEnumVARIANTIterator {
+	PyObject_HEAD
+	PyObject *obEnum;	// The PyIEnumVARIANT.
+	VARIANT *rgVar;		// Reused for every call to Next.
+	PyObject **items;	// The converted items not yet returned.
+	ULONG cAlloc;		// The size of rgVar and items.
+	ULONG cItems;
+	ULONG iNext;
+	ULONG batch;		// The number of items to request next.
+	ULONG maxBatch;
+	long latency;		// In milliseconds.
+	BOOL bDone;
+	unsigned long calls;
+	unsigned long fetched;
+};
+
+static void PyEnumVARIANTIterator_dealloc(PyObject *self)
+{
+	PyEnumVARIANTIterator *it = (PyEnumVARIANTIterator *)self;
+	for ( ULONG i = it->iNext; i < it->cItems; i++ )
+		Py_DECREF(it->items[i]);
+	free(it->items);
+	free(it->rgVar);
+	Py_XDECREF(it->obEnum);
+	PyObject_Del(self);
+}
+
+// Fetches the next batch of up to celt items into it->items.  Returns FALSE
+// with an exception set on failure.
+static BOOL PyEnumVARIANTIterator_Fetch(PyEnumVARIANTIterator *it, ULONG celt)
+{
+	IEnumVARIANT *pIEVARIANT = PyIEnumVARIANT::GetI(it->obEnum);
+	if ( pIEVARIANT == NULL )
+		return FALSE;
+	if ( it->cAlloc < celt ) {
+		VARIANT *rgVar = (VARIANT *)realloc(it->rgVar, celt * sizeof(VARIANT));
+		if ( rgVar != NULL )
+			it->rgVar = rgVar;
+		PyObject **items = (PyObject **)realloc(it->items, celt * sizeof(PyObject *));
+		if ( items != NULL )
+			it->items = items;
+		if ( rgVar == NULL || items == NULL ) {
+			PyErr_SetString(PyExc_MemoryError, "allocating result VARIANTs");
+			return FALSE;
+		}
+		it->cAlloc = celt;
+	}
+	ULONG i, celtFetched = 0;
+	for ( i = 0; i < celt; i++ )
+		VariantInit(&it->rgVar[i]);
+
+	HRESULT hr;
+	LARGE_INTEGER start, end, freq;
+	PY_INTERFACE_PRECALL;
+	QueryPerformanceCounter(&start);
+	hr = pIEVARIANT->Next(celt, it->rgVar, &celtFetched);
+	QueryPerformanceCounter(&end);
+	PY_INTERFACE_POSTCALL;
+	it->calls++;
+	if ( FAILED(hr) ) {
+		if ( celt > 1 ) {
+			// Some enumerators only support fetching one item at a time, so
+			// try again for just one.  Later calls grow the batch as usual.
+			it->batch = 1;
+			return PyEnumVARIANTIterator_Fetch(it, 1);
+		}
+		PyCom_BuildPyException(hr);
+		return FALSE;
+	}
+	if ( celtFetched > celt )
+		celtFetched = celt;
+	it->fetched += celtFetched;
+	it->iNext = it->cItems = 0;
+	BOOL ok = TRUE;
+	for ( i = 0; i < celtFetched; i++ ) {
+		PyObject *ob = ok ? PyCom_PyObjectFromVariant(&it->rgVar[i]) : NULL;
+		if ( ob == NULL )
+			ok = FALSE;
+		else
+			it->items[it->cItems++] = ob;
+		VariantClear(&it->rgVar[i]);
+	}
+	if ( !ok ) {
+		for ( i = 0; i < it->cItems; i++ )
+			Py_DECREF(it->items[i]);
+		it->cItems = 0;
+		return FALSE;
+	}
+	// Fewer items than requested (which S_FALSE also says) is the end.
+	if ( hr == S_FALSE || celtFetched < celt ) {
+		it->bDone = TRUE;
+		return TRUE;
+	}
+	// Size the next request by how long this one took.
+	QueryPerformanceFrequency(&freq);
+	LONGLONG elapsed = (end.QuadPart - start.QuadPart) * 1000 / freq.QuadPart;
+	if ( elapsed > 2 * it->latency && it->batch > 1 )
+		it->batch /= 2;
+	else if ( celtFetched == celt && elapsed <= it->latency && it->batch < it->maxBatch )
+		it->batch = min(it->batch * 2, it->maxBatch);
+	return TRUE;
+}
+
+static PyObject *PyEnumVARIANTIterator_iternext(PyObject *self)
+{
+	PyEnumVARIANTIterator *it = (PyEnumVARIANTIterator *)self;
+	while ( it->iNext >= it->cItems ) {
+		if ( it->bDone || !PyEnumVARIANTIterator_Fetch(it, it->batch) )
+			return NULL; // StopIteration, or the error.
+	}
+	// The reference moves to our caller.
+	return it->items[it->iNext++];
+}
+
+static PyObject *PyEnumVARIANTIterator_iter(PyObject *self)
+{
+	Py_INCREF(self);
+	return self;
+}
+
+// @object PyEnumVARIANTIterator|An iterator over a <o PyIEnumVARIANT>, as
+// returned by <om PyIEnumVARIANT.Iter>.
+#define OFF(e) offsetof(PyEnumVARIANTIterator, e)
+static struct PyMemberDef PyEnumVARIANTIterator_members[] = {
+	{"batch",     T_ULONG, OFF(batch), READONLY},	// @prop int|batch|The number of items the next call to Next will request.
+	{"max_batch", T_ULONG, OFF(maxBatch), READONLY},	// @prop int|max_batch|The largest number of items requested.
+	{"calls",     T_ULONG, OFF(calls), READONLY},	// @prop int|calls|The number of calls made to Next.
+	{"fetched",   T_ULONG, OFF(fetched), READONLY},	// @prop int|fetched|The number of items fetched.
+	{NULL}
+};
+#undef OFF
+
+PyTypeObject PyEnumVARIANTIteratorType =
+{
+	PYWIN_OBJECT_HEAD
+	"PyEnumVARIANTIterator",
+	sizeof(PyEnumVARIANTIterator),
+	0,
+	PyEnumVARIANTIterator_dealloc,	/* tp_dealloc */
+	0,						/* tp_print */
+	0,						/* tp_getattr */
+	0,						/* tp_setattr */
+	0,						/* tp_compare */
+	0,						/* tp_repr */
+	0,						/* tp_as_number */
+	0,						/* tp_as_sequence */
+	0,						/* tp_as_mapping */
+	0,						/* tp_hash */
+	0,						/* tp_call */
+	0,						/* tp_str */
+	PyObject_GenericGetAttr,	/* tp_getattro */
+	0,						/* tp_setattro */
+	0,						/* tp_as_buffer */
+#if (PY_VERSION_HEX < 0x03000000)
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_ITER,	/* tp_flags */
+#else
+	Py_TPFLAGS_DEFAULT,		/* tp_flags */
+#endif
+	0,						/* tp_doc */
+	0,						/* tp_traverse */
+	0,						/* tp_clear */
+	0,						/* tp_richcompare */
+	0,						/* tp_weaklistoffset */
+	PyEnumVARIANTIterator_iter,		/* tp_iter */
+	PyEnumVARIANTIterator_iternext,	/* tp_iternext */
+	0,						/* tp_methods */
+	PyEnumVARIANTIterator_members,	/* tp_members */
+};
+
+// @pymethod <o PyEnumVARIANTIterator>|PyIEnumVARIANT|Iter|Returns an iterator which fetches items in batches.
+PyObject *PyIEnumVARIANT::Iter(PyObject *self, PyObject *args)
+{
+	long maxBatch = PYCOM_ENUM_DEFAULT_MAX_BATCH;
+	long latency = PYCOM_ENUM_DEFAULT_LATENCY;
+	// @pyparm int|maxBatch|64|The largest number of items to request in one call to Next.
+	// @pyparm int|latency|10|The time, in milliseconds, one call to Next should take.
+	if ( !PyArg_ParseTuple(args, "|ll:Iter", &maxBatch, &latency) )
+		return NULL;
+	if ( maxBatch < 1 || latency < 0 ) {
+		PyErr_SetString(PyExc_ValueError, "maxBatch must be at least 1 and latency can not be negative");
+		return NULL;
+	}
+	if ( GetI(self) == NULL )
+		return NULL;
+	PyEnumVARIANTIterator *it = PyObject_New(PyEnumVARIANTIterator, &PyEnumVARIANTIteratorType);
+	if ( it == NULL )
+		return NULL;
+	it->obEnum = self;
+	Py_INCREF(self);
+	it->rgVar = NULL;
+	it->items = NULL;
+	it->cAlloc = it->cItems = it->iNext = 0;
+	it->batch = 1;
+	it->maxBatch = maxBatch;
+	it->latency = latency;
+	it->bDone = FALSE;
+	it->calls = it->fetched = 0;
+	return (PyObject *)it;
+	// @comm Each call to Next on an out of process or cross apartment
+	// enumerator is a round trip, so fetching one item at a time is slow
+	// for large collections.  The iterator starts by asking for a single
+	// item, and doubles the number requested each time a call completes
+	// within latency milliseconds, up to maxBatch.  If a call takes more than
+	// twice that, the number is halved again.  If a call for several items
+	// fails, it is made again for one, and the batches grow again from there.
+	// Iteration ends at the first call which returns fewer items than it
+	// asked for.
+	// <nl>Items are fetched before they are needed, so if iteration is
+	// abandoned some items will have been consumed from the enumerator
+	// without being returned.
+}
+
 // @object PyIEnumVARIANT|A Python interface to IEnumVARIANT
 static struct PyMethodDef PyIEnumVARIANT_methods[] =
 {
@@ -143,6 +372,7 @@ static struct PyMethodDef PyIEnumVARIANT_methods[] =
 	{ "Skip", PyIEnumVARIANT::Skip, 1 },	// @pymeth Skip|Skips over the next specified elementes.
 	{ "Reset", PyIEnumVARIANT::Reset, 1 },	// @pymeth Reset|Resets the enumeration sequence to the beginning.
 	{ "Clone", PyIEnumVARIANT::Clone, 1 },	// @pymeth Clone|Creates another enumerator that contains the same enumeration state as the current one.
+	{ "Iter", PyIEnumVARIANT::Iter, 1 },	// @pymeth Iter|Returns an iterator which fetches items in batches.
 	{ NULL }
 };
 
@@ -16,6 +16,7 @@ public:
 	static PyObject *Skip(PyObject *self, PyObject *args);
 	static PyObject *Reset(PyObject *self, PyObject *args);
 	static PyObject *Clone(PyObject *self, PyObject *args);
+	static PyObject *Iter(PyObject *self, PyObject *args);
 
 protected:
 	PyIEnumVARIANT(IUnknown *pdisp);
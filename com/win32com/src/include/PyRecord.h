@@ -23,6 +23,9 @@ public:
 	IRecordInfo *pri;
 	void *pdata;
 	PyRecordBuffer *owner;
+	// The PyRecordLayout for the type (or None if it has none), or NULL
+	// until it is first needed.
+	PyObject *layout;
 };
 
 #endif // __PYRECORD_H__
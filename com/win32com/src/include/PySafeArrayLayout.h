@@ -0,0 +1,214 @@
+// PySafeArrayLayout.h - SAFEARRAY memory layout helpers.
+//
+// These helpers work purely on the SAFEARRAY descriptor fields (cDims,
+// cbElements, rgsabound) and raw memory - they never call the OLE
+// automation API.  This keeps the shape/stride arithmetic used by the bulk
+// SAFEARRAY <-> buffer conversions in oleargs.cpp usable (and testable)
+// against hand-built descriptors on any platform.
+//
+// Layout reminder: SAFEARRAY data is stored in column-major order (the
+// left-most index varies fastest), and the rgsabound array in the
+// descriptor is stored reversed - rgsabound[cDims-1] describes dimension 1.
+// Python-side shapes (and the nested tuples PythonCOM has always built)
+// are ordered from dimension 1 to dimension cDims.
+
+#ifndef __PYSAFEARRAYLAYOUT_H__
+#define __PYSAFEARRAYLAYOUT_H__
+
+#include <stddef.h>
+#include <string.h>
+
+#ifndef _WIN32
+// Just enough of wtypes.h/oaidl.h to use these helpers off Windows.
+typedef unsigned short VARTYPE;
+enum VARENUM {
+	VT_I2 = 2, VT_I4 = 3, VT_R4 = 4, VT_R8 = 5,
+	VT_I1 = 16, VT_UI1 = 17, VT_UI2 = 18, VT_UI4 = 19,
+	VT_I8 = 20, VT_UI8 = 21, VT_INT = 22, VT_UINT = 23,
+};
+typedef struct tagSAFEARRAYBOUND {
+	unsigned int cElements;
+	int lLbound;
+} SAFEARRAYBOUND;
+#endif
+
+// Maximum number of dimensions the buffer conversions will handle.  This
+// matches the limit Python itself places on buffer dimensions (PyBUF_MAX_NDIM).
+#define PYSAFEARRAY_MAX_NDIM 64
+
+// Returns the struct-module format character for a fixed size numeric
+// VARTYPE, and its size in *pItemSize.  Returns NULL for any type which
+// has no direct buffer representation (BSTR, VARIANT, DATE, BOOL, ...)
+inline const char *PySafeArrayLayout_GetFormat(VARTYPE vt, size_t *pItemSize)
+{
+	const char *format;
+	size_t itemsize;
+	switch (vt) {
+		case VT_I1:   format = "b"; itemsize = 1; break;
+		case VT_UI1:  format = "B"; itemsize = 1; break;
+		case VT_I2:   format = "h"; itemsize = 2; break;
+		case VT_UI2:  format = "H"; itemsize = 2; break;
+		case VT_I4:
+		case VT_INT:  format = "i"; itemsize = 4; break;
+		case VT_UI4:
+		case VT_UINT: format = "I"; itemsize = 4; break;
+		case VT_I8:   format = "q"; itemsize = 8; break;
+		case VT_UI8:  format = "Q"; itemsize = 8; break;
+		case VT_R4:   format = "f"; itemsize = 4; break;
+		case VT_R8:   format = "d"; itemsize = 8; break;
+		default:
+			return NULL;
+	}
+	if (pItemSize)
+		*pItemSize = itemsize;
+	return format;
+}
+
+// Describes the data area of a SAFEARRAY as a strided buffer.
+// rgsabound is in descriptor (reversed) order.  On return, shape[] and
+// strides[] (each with room for cDims entries) are in dimension 1..cDims
+// order, with byte strides describing the column-major layout, and
+// *pcbTotal is the size of the data area in bytes.
+// Returns false if cDims is out of range or the size overflows.
+inline bool PySafeArrayLayout_Describe(unsigned int cDims, const SAFEARRAYBOUND *rgsabound,
+                                       size_t cbElements, size_t *shape, size_t *strides,
+                                       size_t *pcbTotal)
+{
+	if (cDims == 0 || cDims > PYSAFEARRAY_MAX_NDIM || cbElements == 0)
+		return false;
+	size_t stride = cbElements;
+	bool empty = false;
+	for (unsigned int i = 0; i < cDims; i++) {
+		size_t n = rgsabound[cDims - 1 - i].cElements;
+		shape[i] = n;
+		strides[i] = stride;
+		if (n == 0)
+			empty = true;
+		else if (!empty) {
+			if (stride > ((size_t)-1) / n)
+				return false;
+			stride *= n;
+		}
+	}
+	*pcbTotal = empty ? 0 : stride;
+	return true;
+}
+
+// Classifies a struct-module format character as a signed ('i'),
+// unsigned ('u') or floating point ('f') number, or 0 for anything else.
+inline char PySafeArrayLayout_FormatKind(char code)
+{
+	switch (code) {
+		case 'b': case 'h': case 'i': case 'l': case 'q': case 'n':
+			return 'i';
+		case 'B': case 'H': case 'I': case 'L': case 'Q': case 'N':
+			return 'u';
+		case 'f': case 'd':
+			return 'f';
+	}
+	return 0;
+}
+
+// Returns true if a buffer with the given format (NULL meaning unsigned
+// bytes, as per the buffer protocol) and itemsize holds native (ie,
+// little-endian) numbers that can be copied as-is into a SAFEARRAY of vt.
+inline bool PySafeArrayLayout_FormatMatches(const char *format, size_t itemsize, VARTYPE vt)
+{
+	size_t vtItemSize;
+	const char *vtFormat = PySafeArrayLayout_GetFormat(vt, &vtItemSize);
+	if (vtFormat == NULL || vtItemSize != itemsize)
+		return false;
+	if (format == NULL)
+		format = "B";
+	if (*format == '@' || *format == '=' || *format == '<')
+		format++;
+	if (format[0] == '\0' || format[1] != '\0')
+		return false;
+	char kind = PySafeArrayLayout_FormatKind(format[0]);
+	return kind != 0 && kind == PySafeArrayLayout_FormatKind(vtFormat[0]);
+}
+
+// Returns true if an existing SAFEARRAY of vt, whose elements are
+// cbElements bytes, can be refilled straight from a buffer with the given
+// format and itemsize.  The array's own type must match the buffer - an
+// element of the same size isn't enough (a VT_I4 array must not be filled
+// with floats).
+inline bool PySafeArrayLayout_CanRefill(VARTYPE vt, size_t cbElements, const char *format, size_t itemsize)
+{
+	return cbElements == itemsize && PySafeArrayLayout_FormatMatches(format, itemsize, vt);
+}
+
+// Copies one run of n items, with the given source byte stride, to
+// contiguous memory.
+template <typename INDEX>
+inline char *PySafeArrayLayout_CopyRun(char *dest, const char *src, INDEX n, INDEX stride, size_t itemsize)
+{
+	if ((size_t)stride == itemsize) {
+		memcpy(dest, src, (size_t)n * itemsize);
+		return dest + (size_t)n * itemsize;
+	}
+	// Let the compiler inline the fixed size copies.
+	switch (itemsize) {
+		case 8:
+			for (INDEX i = 0; i < n; i++, src += stride, dest += 8) memcpy(dest, src, 8);
+			break;
+		case 4:
+			for (INDEX i = 0; i < n; i++, src += stride, dest += 4) memcpy(dest, src, 4);
+			break;
+		case 2:
+			for (INDEX i = 0; i < n; i++, src += stride, dest += 2) memcpy(dest, src, 2);
+			break;
+		default:
+			for (INDEX i = 0; i < n; i++, src += stride, dest += itemsize) memcpy(dest, src, itemsize);
+			break;
+	}
+	return dest;
+}
+
+// Copies an ndim array described by shape[] and (byte) srcStrides[], both
+// in dimension 1..ndim order, into the column-major data area of a
+// SAFEARRAY with the same shape.  For the usual C-ordered source this
+// performs the transposition; a source which is already column-major
+// contiguous (including any 1 dimensional contiguous buffer) is copied in
+// a single memcpy.
+template <typename INDEX>
+inline void PySafeArrayLayout_CopyToColumnMajor(void *dest, const void *src, unsigned int ndim,
+                                                const INDEX *shape, const INDEX *srcStrides,
+                                                size_t itemsize)
+{
+	if (ndim == 0 || ndim > PYSAFEARRAY_MAX_NDIM)
+		return;
+	size_t total = itemsize;
+	bool fortran = true;
+	for (unsigned int k = 0; k < ndim; k++) {
+		if (shape[k] <= 0)
+			return; // nothing to copy.
+		if (shape[k] > 1 && (size_t)srcStrides[k] != total)
+			fortran = false;
+		total *= (size_t)shape[k];
+	}
+	if (fortran) {
+		memcpy(dest, src, total);
+		return;
+	}
+	// Walk dimension 1 as the inner loop (it is contiguous in the
+	// destination), stepping the remaining dimensions like an odometer.
+	INDEX index[PYSAFEARRAY_MAX_NDIM] = {0};
+	char *d = (char *)dest;
+	const char *s = (const char *)src;
+	for (;;) {
+		d = PySafeArrayLayout_CopyRun(d, s, shape[0], srcStrides[0], itemsize);
+		unsigned int k;
+		for (k = 1; k < ndim; k++) {
+			s += srcStrides[k];
+			if (++index[k] < shape[k])
+				break;
+			s -= srcStrides[k] * shape[k];
+			index[k] = 0;
+		}
+		if (k == ndim)
+			break;
+	}
+}
+
+#endif // __PYSAFEARRAYLAYOUT_H__
@@ -709,6 +709,8 @@ public:
 	PythonOleArgHelper();
 	~PythonOleArgHelper();
 	BOOL ParseTypeInformation(PyObject *reqdObjectTuple);
+	// As for ParseTypeInformation, given the (type_id, flags) already unpacked.
+	void SetTypeInformation(VARTYPE vt, DWORD paramFlags);
 
 	// Using this call with reqdObject != NULL will check the existing 
 	// VT_ of the variant.  If not VT_EMPTY, then the result will be coerced to
@@ -716,12 +718,18 @@ public:
 	// uses the Python type to determine the variant type.
 	BOOL MakeObjToVariant(PyObject *obj, VARIANT *var, PyObject *reqdObjectTuple = NULL);
 	PyObject *MakeVariantToObj(VARIANT *var);
+	// Clears a VARIANT filled by MakeObjToVariant.  This must be used
+	// instead of VariantClear when m_bPoolTemporaries is set.
+	void ClearVariant(VARIANT *var);
 
 	VARTYPE m_reqdType;
 	BOOL m_bParsedTypeInfo;
 	BOOL m_bIsOut;
+	// If set, "in" strings are converted to BSTRs owned by this helper.
+	BOOL m_bPoolTemporaries;
 	POAH_CONVERT_DIRECTION m_convertDirection;
 	PyObject *m_pyVariant; // if non-null, a win32com.client.VARIANT
+	BSTR m_pooledBstr;
 	union {
 		void *m_pValueHolder;
 		short m_sBuf;
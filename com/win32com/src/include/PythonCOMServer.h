@@ -140,8 +140,24 @@ public:
 	// End of PYGATEWAY_MAKE_SUPPORT
 	PyObject * m_pPyObject;
 	PyGatewayBase *m_pBaseObject;
+
+	// The cache of names resolved by GetIDsOfNames.
+	void InvalidateNameCache(void);
+	void GetNameCacheStats(LONG *pHits, LONG *pMisses, UINT *pEntries);
 private:
 	LONG m_cRef;
+	// The policy's _dispid_to_callable_ map, fetched on first use.
+	PyObject *m_obDispidToCallable;
+	PyObject *GetDirectCallable(DISPID dispid, WORD wFlags, DISPPARAMS *params);
+	// Single names resolved by GetIDsOfNames - only used with m_csNameCache
+	// held, never the GIL.
+	CRITICAL_SECTION m_csNameCache;
+	struct PyGatewayNameCacheEntry **m_ppNameCache;
+	UINT m_cNameCache;
+	LONG m_nameCacheHits;
+	LONG m_nameCacheMisses;
+	BOOL LookupCachedName(OLECHAR *name, LCID lcid, DISPID *pdispid);
+	void AddCachedName(OLECHAR *name, LCID lcid, DISPID dispid);
 };
 
 #ifdef _MSC_VER
@@ -4,6 +4,7 @@
 
 #include "stdafx.h"
 #include "PythonCOM.h"
+#include "PySafeArrayLayout.h"
 
 extern PyObject *PyObject_FromRecordInfo(IRecordInfo *, void *, ULONG);
 extern PyObject *PyObject_FromSAFEARRAYRecordInfo(SAFEARRAY *psa);
@@ -695,6 +696,88 @@ static long PyCom_CalculatePyObjectDimension(PyObject *obItemCheck, long lDimens
 	return lReturnDimension;
 }
 
+#if (PY_VERSION_HEX >= 0x03000000)
+// Fast path for objects supporting the buffer interface whose items are
+// already in the native format for vt (eg, array.array('d') or a numpy
+// array for VT_R8) - the data is laid out in the SAFEARRAY with a single
+// bulk copy (transposing from C to column-major order as necessary),
+// without creating a Python object per element.
+// Returns 1 if the array was filled, 0 if the object is not suitable (in
+// which case no exception is set and the sequence code should be used),
+// or -1 with an exception set on failure.
+static int PyCom_SAFEARRAYFromBuffer(PyObject *obj, SAFEARRAY **ppSA, bool bAllocNewArray, VARENUM vt)
+{
+	if (!PyObject_CheckBuffer(obj) || PySafeArrayLayout_GetFormat(vt, NULL)==NULL)
+		return 0;
+	Py_buffer view;
+	if (PyObject_GetBuffer(obj, &view, PyBUF_RECORDS_RO) == -1) {
+		PyErr_Clear();
+		return 0;
+	}
+	if (view.ndim < 1 || view.ndim > PYSAFEARRAY_MAX_NDIM || view.suboffsets != NULL ||
+		!PySafeArrayLayout_FormatMatches(view.format, view.itemsize, vt)) {
+		PyBuffer_Release(&view);
+		return 0;
+	}
+	SAFEARRAYBOUND bounds[PYSAFEARRAY_MAX_NDIM];
+	for (int i = 0; i < view.ndim; i++) {
+		if (view.shape[i] > MAXLONG) {
+			PyBuffer_Release(&view);
+			PyErr_SetString(PyExc_ValueError, "The buffer is too large for a SAFEARRAY");
+			return -1;
+		}
+		bounds[i].lLbound = 0;
+		bounds[i].cElements = (ULONG)view.shape[i];
+	}
+	if (bAllocNewArray) {
+		*ppSA = SafeArrayCreate(vt, view.ndim, bounds);
+		if (*ppSA == NULL) {
+			PyBuffer_Release(&view);
+			PyErr_SetString(PyExc_MemoryError, "CreatingSafeArray");
+			return -1;
+		}
+	} else {
+		if (SafeArrayGetDim(*ppSA) != (unsigned)view.ndim) {
+			PyBuffer_Release(&view);
+			PyErr_SetString(PyExc_ValueError, "When refilling a safe array, the sequence must have the same number of dimensions as the existing array.");
+			return -1;
+		}
+		for (int i = 0; i < view.ndim; i++) {
+			LONG exist_lbound, exist_ubound;
+			SafeArrayGetLBound(*ppSA, i+1, &exist_lbound);
+			SafeArrayGetUBound(*ppSA, i+1, &exist_ubound);
+			if ((unsigned long)(exist_ubound - exist_lbound + 1) != bounds[i].cElements) {
+				PyBuffer_Release(&view);
+				PyErr_SetString(PyExc_ValueError, "When refilling a safe array, the sequences must be the same length as the existing array.");
+				return -1;
+			}
+		}
+		// An existing array of some other element type goes the slow way.
+		VARTYPE existingVT;
+		if (FAILED(SafeArrayGetVartype(*ppSA, &existingVT)) ||
+			!PySafeArrayLayout_CanRefill(existingVT, SafeArrayGetElemsize(*ppSA), view.format, view.itemsize)) {
+			PyBuffer_Release(&view);
+			return 0;
+		}
+	}
+	void *sa_buf;
+	HRESULT hr = SafeArrayAccessData(*ppSA, &sa_buf);
+	if (FAILED(hr)) {
+		PyBuffer_Release(&view);
+		if (bAllocNewArray) {
+			SafeArrayDestroy(*ppSA);
+			*ppSA = NULL;
+		}
+		PyCom_BuildPyException(hr);
+		return -1;
+	}
+	PySafeArrayLayout_CopyToColumnMajor(sa_buf, view.buf, view.ndim, view.shape, view.strides, view.itemsize);
+	SafeArrayUnaccessData(*ppSA);
+	PyBuffer_Release(&view);
+	return 1;
+}
+#endif // PY_VERSION_HEX >= 0x03000000
+
 static BOOL PyCom_SAFEARRAYFromPyObjectEx(PyObject *obj, SAFEARRAY **ppSA, bool bAllocNewArray, VARENUM vt)
 {
 	// NOTE: We make no attempt to validate or free any existing array if asked to allocate a new one!
@@ -709,6 +792,15 @@ static BOOL PyCom_SAFEARRAYFromPyObjectEx(PyObject *obj, SAFEARRAY **ppSA, bool
 		// Otherwise we leave it alone!
 		return TRUE;
 	}
+#if (PY_VERSION_HEX >= 0x03000000)
+	switch (PyCom_SAFEARRAYFromBuffer(obj, ppSA, bAllocNewArray, vt)) {
+		case 1:
+			return TRUE;
+		case -1:
+			return FALSE;
+		// default - fall through to the sequence code.
+	}
+#endif
 	LONG cDims = 0;
 	// Arbitrary-sized array dimensions contributed by Stefan Schukat Feb-2004
 	// Allow arbitrary sized sequences to be transported to a COM server
@@ -1024,6 +1116,155 @@ PyObject *PyCom_PyObjectFromSAFEARRAYBuildDimension(SAFEARRAY *psa, VARENUM vt,
 	return retTuple;
 }
 
+// When set, SAFEARRAYs of fixed size numeric types are returned as a
+// memoryview over a single copy of the data rather than nested tuples.
+static BOOL g_bSafeArrayAsBuffer = FALSE;
+
+#if (PY_VERSION_HEX >= 0x03000000)
+// An object owning a copy of a SAFEARRAY's data area, exporting it via the
+// buffer interface with the array's real shape.  SAFEARRAY data is
+// column-major, so multi-dimensional arrays are exported with Fortran
+// strides - buf[i, j] is the element at SAFEARRAY index [i][j].
+struct PySafeArrayBuffer {
+	PyObject_HEAD
+	const char *format;
+	Py_ssize_t itemsize;
+	Py_ssize_t len;
+	int ndim;
+	Py_ssize_t shape[PYSAFEARRAY_MAX_NDIM];
+	Py_ssize_t strides[PYSAFEARRAY_MAX_NDIM];
+	void *data;
+};
+
+static void PySafeArrayBuffer_dealloc(PyObject *self)
+{
+	PyMem_Free(((PySafeArrayBuffer *)self)->data);
+	PyObject_Del(self);
+}
+
+static int PySafeArrayBuffer_getbuffer(PyObject *self, Py_buffer *view, int flags)
+{
+	PySafeArrayBuffer *sab = (PySafeArrayBuffer *)self;
+	if (sab->ndim > 1) {
+		// We can only hand out the layout we have.
+		if ((flags & PyBUF_STRIDES) != PyBUF_STRIDES ||
+			(flags & PyBUF_C_CONTIGUOUS) == PyBUF_C_CONTIGUOUS) {
+			PyErr_SetString(PyExc_BufferError, "SAFEARRAY buffers with more than 1 dimension are column-major (Fortran) ordered");
+			return -1;
+		}
+	}
+	view->buf = sab->data;
+	view->obj = self;
+	Py_INCREF(self);
+	view->len = sab->len;
+	view->readonly = 0;
+	view->itemsize = sab->itemsize;
+	view->format = (flags & PyBUF_FORMAT) ? (char *)sab->format : NULL;
+	view->ndim = sab->ndim;
+	view->shape = (flags & PyBUF_ND) ? sab->shape : NULL;
+	view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? sab->strides : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+	return 0;
+}
+
+static PyBufferProcs PySafeArrayBuffer_as_buffer = {
+	PySafeArrayBuffer_getbuffer,
+	NULL,	// Nothing allocated in the Py_buffer struct
+};
+
+PyTypeObject PySafeArrayBufferType =
+{
+	PYWIN_OBJECT_HEAD
+	"PySafeArrayBuffer",
+	sizeof(PySafeArrayBuffer),
+	0,
+	PySafeArrayBuffer_dealloc,	/* tp_dealloc */
+	0,						/* tp_print */
+	0,						/* tp_getattr */
+	0,						/* tp_setattr */
+	0,						/* tp_compare */
+	0,						/* tp_repr */
+	0,						/* tp_as_number */
+	0,						/* tp_as_sequence */
+	0,						/* tp_as_mapping */
+	0,						/* tp_hash */
+	0,						/* tp_call */
+	0,						/* tp_str */
+	PyObject_GenericGetAttr,	/* tp_getattro */
+	0,						/* tp_setattro */
+	&PySafeArrayBuffer_as_buffer,	/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,		/* tp_flags */
+};
+
+/* Convert a SAFEARRAY of a fixed size numeric type to a memoryview
+   using a single copy of the entire data area.
+*/
+static PyObject *PyCom_PyObjectFromSAFEARRAYAsBuffer(SAFEARRAY *psa, const char *format, size_t itemsize)
+{
+	size_t shape[PYSAFEARRAY_MAX_NDIM], strides[PYSAFEARRAY_MAX_NDIM], cbTotal;
+	if (psa->cbElements != itemsize ||
+		!PySafeArrayLayout_Describe(psa->cDims, psa->rgsabound, itemsize, shape, strides, &cbTotal) ||
+		cbTotal > PY_SSIZE_T_MAX) {
+		PyErr_SetString(PyExc_ValueError, "The SAFEARRAY can not be represented as a buffer");
+		return NULL;
+	}
+	PySafeArrayBuffer *sab = PyObject_New(PySafeArrayBuffer, &PySafeArrayBufferType);
+	if (sab == NULL)
+		return NULL;
+	sab->format = format;
+	sab->itemsize = (Py_ssize_t)itemsize;
+	sab->len = (Py_ssize_t)cbTotal;
+	sab->ndim = psa->cDims;
+	for (int i = 0; i < sab->ndim; i++) {
+		sab->shape[i] = (Py_ssize_t)shape[i];
+		sab->strides[i] = (Py_ssize_t)strides[i];
+	}
+	// Always allocate something so an empty array still has a valid pointer.
+	sab->data = PyMem_Malloc(cbTotal ? cbTotal : 1);
+	if (sab->data == NULL) {
+		Py_DECREF(sab);
+		return PyErr_NoMemory();
+	}
+	if (cbTotal) {
+		void *sa_buf;
+		HRESULT hr = SafeArrayAccessData(psa, &sa_buf);
+		if (FAILED(hr)) {
+			Py_DECREF(sab);
+			return PyCom_BuildPyException(hr);
+		}
+		memcpy(sab->data, sa_buf, cbTotal);
+		SafeArrayUnaccessData(psa);
+	}
+	PyObject *ret = PyMemoryView_FromObject((PyObject *)sab);
+	Py_DECREF(sab);
+	return ret;
+}
+#endif // PY_VERSION_HEX >= 0x03000000
+
+// @pymethod bool|pythoncom|SetSafeArrayAsBuffer|Controls how SAFEARRAYs of numeric types are returned.
+// @rdesc The previous setting.
+PyObject *pythoncom_SetSafeArrayAsBuffer(PyObject *self, PyObject *args)
+{
+	int bEnable;
+	// @pyparm bool|enable||If True, SAFEARRAYs of fixed size numeric types
+	// (VT_I1, VT_UI1, VT_I2, VT_UI2, VT_I4, VT_UI4, VT_INT, VT_UINT, VT_I8, VT_UI8,
+	// VT_R4 and VT_R8) are returned as a memoryview object instead of a (nested) tuple.
+	if (!PyArg_ParseTuple(args, "i:SetSafeArrayAsBuffer", &bEnable))
+		return NULL;
+	BOOL bOld = g_bSafeArrayAsBuffer;
+	g_bSafeArrayAsBuffer = bEnable ? TRUE : FALSE;
+	return PyBool_FromLong(bOld);
+	// @comm The setting is process-wide.  The data is copied from the array
+	// in a single operation, and the memoryview has the format, shape and strides
+	// of the array - eg, a 2 dimensional VT_R8 array is returned with format 'd'
+	// and a shape of (dim1_size, dim2_size).
+	// <nl>As SAFEARRAYs are stored in column-major order, multi-dimensional
+	// arrays are exported with Fortran-ordered strides.  Use the tolist() method
+	// of the memoryview, or a library such as numpy, to work with these.
+	// <nl>This setting has no effect on Python 2.x.
+}
+
 /* Actual doer - Convert the specified safe array to a Python object - either a
    single tuple, or a tuples of tuples for each dimension
 */
@@ -1034,6 +1275,14 @@ PyObject *PyCom_PyObjectFromSAFEARRAY(SAFEARRAY *psa, VARENUM vt /* = VT_VARIANT
 		OleSetTypeError(_T("Internal error - unexpected argument - only simple VARIANTTYPE expected"));
 		return FALSE;
 	}
+#if (PY_VERSION_HEX >= 0x03000000)
+	if (g_bSafeArrayAsBuffer) {
+		size_t itemsize;
+		const char *format = PySafeArrayLayout_GetFormat(vt, &itemsize);
+		if (format != NULL)
+			return PyCom_PyObjectFromSAFEARRAYAsBuffer(psa, format, itemsize);
+	}
+#endif
 	UINT nDim = SafeArrayGetDim(psa);
 	LONG *pIndices = new LONG[nDim];
 	PyObject *result = PyCom_PyObjectFromSAFEARRAYBuildDimension(psa, vt, 1, nDim, pIndices);
@@ -1042,6 +1291,117 @@ PyObject *PyCom_PyObjectFromSAFEARRAY(SAFEARRAY *psa, VARENUM vt /* = VT_VARIANT
 }
 
 
+///////////////////////////////////////////////////////
+//
+// Pools for the temporaries the arg helpers allocate.  Calls made via
+// InvokeTypes convert short strings into BSTRs taken from a free list, and
+// BYREF VARIANTs are recycled rather than allocated for each call.  The
+// pools are only used with the GIL held, so need no other locking.
+//
+// The largest string (in characters) converted to a pooled BSTR.
+#define PYCOM_SMALL_BSTR_CHARS 64
+// The maximum number of free items kept in each pool.
+#define PYCOM_ARG_POOL_MAX 32
+
+static BSTR g_freeBstrs[PYCOM_ARG_POOL_MAX];
+static int g_cFreeBstrs = 0;
+static VARIANT *g_freeVariants[PYCOM_ARG_POOL_MAX];
+static int g_cFreeVariants = 0;
+
+static unsigned long g_bstrAllocs = 0;
+static unsigned long g_bstrPoolHits = 0;
+static unsigned long g_variantAllocs = 0;
+static unsigned long g_variantPoolHits = 0;
+
+// Returns a BSTR holding a unicode object of no more than
+// PYCOM_SMALL_BSTR_CHARS characters.  It must be freed with
+// FreePooledBstr, never SysFreeString.
+static BSTR AllocPooledBstr(PyObject *obj)
+{
+	BSTR ret;
+	if (g_cFreeBstrs) {
+		ret = g_freeBstrs[--g_cFreeBstrs];
+		g_bstrPoolHits++;
+	} else {
+		ret = SysAllocStringLen(NULL, PYCOM_SMALL_BSTR_CHARS);
+		if (ret == NULL) {
+			PyErr_SetString(PyExc_MemoryError, "Allocating BSTR");
+			return NULL;
+		}
+		g_bstrAllocs++;
+	}
+	int nchars = PyUnicode_GET_SIZE(obj);
+#if (PY_VERSION_HEX < 0x03020000)
+	if (PyUnicode_AsWideChar((PyUnicodeObject *)obj, ret, nchars)==-1) {
+#else
+	if (PyUnicode_AsWideChar(obj, ret, nchars)==-1) {
+#endif
+		g_freeBstrs[g_cFreeBstrs++] = ret;
+		return NULL;
+	}
+	ret[nchars] = 0;
+	// The length prefix is the byte count - set it to the length of this
+	// string, so SysStringLen() etc work as expected.
+	((DWORD *)ret)[-1] = nchars * sizeof(OLECHAR);
+	return ret;
+}
+
+static void FreePooledBstr(BSTR bstr)
+{
+	// Restore the length the string was allocated with.
+	((DWORD *)bstr)[-1] = PYCOM_SMALL_BSTR_CHARS * sizeof(OLECHAR);
+	if (g_cFreeBstrs < PYCOM_ARG_POOL_MAX)
+		g_freeBstrs[g_cFreeBstrs++] = bstr;
+	else
+		SysFreeString(bstr);
+}
+
+static VARIANT *AllocTempVariant(void)
+{
+	VARIANT *ret;
+	if (g_cFreeVariants) {
+		ret = g_freeVariants[--g_cFreeVariants];
+		g_variantPoolHits++;
+	} else {
+		ret = new VARIANT;
+		g_variantAllocs++;
+	}
+	return ret;
+}
+
+static void FreeTempVariant(VARIANT *var)
+{
+	if (g_cFreeVariants < PYCOM_ARG_POOL_MAX)
+		g_freeVariants[g_cFreeVariants++] = var;
+	else
+		delete var;
+}
+
+// @pymethod dict|pythoncom|GetArgAllocStats|Returns the number of temporaries allocated while converting arguments.
+PyObject *pythoncom_GetArgAllocStats(PyObject *self, PyObject *args)
+{
+	int bReset = FALSE;
+	// @pyparm bool|reset|False|If true, the counts are reset to zero after being read.
+	if (!PyArg_ParseTuple(args, "|i:GetArgAllocStats", &bReset))
+		return NULL;
+	// @rdesc The result is a dictionary with the following keys.
+	// @flagh Key|Description
+	// @flag bstr_allocs|The number of BSTRs allocated for string arguments.
+	// @flag bstr_pool_hits|The number of string arguments which reused a pooled BSTR.
+	// @flag variant_allocs|The number of VARIANTs allocated for BYREF VARIANT arguments.
+	// @flag variant_pool_hits|The number of BYREF VARIANT arguments which reused a pooled VARIANT.
+	PyObject *ret = Py_BuildValue("{s:k,s:k,s:k,s:k}",
+		"bstr_allocs", g_bstrAllocs,
+		"bstr_pool_hits", g_bstrPoolHits,
+		"variant_allocs", g_variantAllocs,
+		"variant_pool_hits", g_variantPoolHits);
+	if (ret && bReset)
+		g_bstrAllocs = g_bstrPoolHits = g_variantAllocs = g_variantPoolHits = 0;
+	return ret;
+	// @comm Only the conversions done for typed calls (ie, <om PyIDispatch.InvokeTypes>,
+	// as used by makepy generated code) are counted.
+}
+
 ///////////////////////////////////////////////////////
 //
 // Python arg helper class
@@ -1058,6 +1418,9 @@ PythonOleArgHelper::PythonOleArgHelper()
 PythonOleArgHelper::~PythonOleArgHelper() 
 {
 	Py_XDECREF(m_pyVariant);
+	// Only set if the VARIANT holding it was not passed to ClearVariant().
+	if (m_pooledBstr)
+		FreePooledBstr(m_pooledBstr);
 	// First check we actually have ownership of any buffers.
 	if (m_convertDirection==POAH_CONVERT_UNKNOWN || m_convertDirection==POAH_CONVERT_FROM_VARIANT)
 		return;
@@ -1091,10 +1454,12 @@ PythonOleArgHelper::~PythonOleArgHelper()
 				break;
 			case VT_VARIANT | VT_BYREF:
 				if (m_varBuf) {
+					{
 					PY_INTERFACE_PRECALL;
 					VariantClear(m_varBuf);
-					delete m_varBuf;
 					PY_INTERFACE_POSTCALL;
+					}
+					FreeTempVariant(m_varBuf);
 				}
 				break;
 			// default - take no action.
@@ -1102,6 +1467,18 @@ PythonOleArgHelper::~PythonOleArgHelper()
 	}
 }
 
+// Clears a VARIANT filled by MakeObjToVariant.  Pooled temporaries are
+// returned to their pool rather than freed.
+void PythonOleArgHelper::ClearVariant(VARIANT *var)
+{
+	if (m_pooledBstr && V_VT(var)==VT_BSTR && V_BSTR(var)==m_pooledBstr) {
+		FreePooledBstr(m_pooledBstr);
+		m_pooledBstr = NULL;
+		VariantInit(var);
+	} else
+		VariantClear(var);
+}
+
 BOOL PythonOleArgHelper::ParseTypeInformation(PyObject *reqdObjectTuple)
 {
 	if (m_bParsedTypeInfo) return TRUE;
@@ -1114,15 +1491,21 @@ BOOL PythonOleArgHelper::ParseTypeInformation(PyObject *reqdObjectTuple)
 	if (paramFlags==NULL) return FALSE;
 	DWORD pf = (DWORD)PyInt_AsLong(paramFlags);
 	if (PyErr_Occurred()) return FALSE;
+	SetTypeInformation(m_reqdType, pf);
+	return TRUE;
+}
+
+void PythonOleArgHelper::SetTypeInformation(VARTYPE vt, DWORD paramFlags)
+{
+	m_reqdType = vt;
 	// If we have _no_ param flags, use the BYREF-ness of the param
 	// to determine if we are possibly an out param.
 	// If we have any flags, assume they are all valid.
-	if (pf==0)
+	if (paramFlags==0)
 		m_bIsOut = (m_reqdType & VT_BYREF) != 0;
 	else
-		m_bIsOut = (pf & (PARAMFLAG_FOUT | PARAMFLAG_FRETVAL)) != 0;
+		m_bIsOut = (paramFlags & (PARAMFLAG_FOUT | PARAMFLAG_FRETVAL)) != 0;
 	m_bParsedTypeInfo = TRUE;
-	return TRUE;
 }
 
 #define BREAK_FALSE {rc=FALSE;break;}
@@ -1214,7 +1597,11 @@ BOOL PythonOleArgHelper::MakeObjToVariant(PyObject *obj, VARIANT *var, PyObject
 
 	case VT_VARIANT | VT_BYREF:
 		if (bCreateBuffers) {
-			m_varBuf = new VARIANT;
+			m_varBuf = AllocTempVariant();
+			if (m_varBuf==NULL) {
+				PyErr_SetString(PyExc_MemoryError, "Allocating VARIANT");
+				BREAK_FALSE
+			}
 			VariantInit(m_varBuf);
 			V_VARIANTREF(var) = m_varBuf;
 		} else
@@ -1229,15 +1616,24 @@ BOOL PythonOleArgHelper::MakeObjToVariant(PyObject *obj, VARIANT *var, PyObject
 		break;
 
 	case VT_BSTR:
-		if ( PyString_Check(obj) || PyUnicode_Check(obj) )
+		if ( m_bPoolTemporaries && !m_bIsOut && PyUnicode_Check(obj) &&
+		     PyUnicode_GET_SIZE(obj) <= PYCOM_SMALL_BSTR_CHARS )
+		{
+			assert(m_pooledBstr==NULL);
+			if ( (m_pooledBstr = AllocPooledBstr(obj))==NULL ) BREAK_FALSE
+			V_BSTR(var) = m_pooledBstr;
+		}
+		else if ( PyString_Check(obj) || PyUnicode_Check(obj) )
 		{
 			if ( !PyWinObject_AsBstr(obj, &V_BSTR(var)) ) BREAK_FALSE
+			g_bstrAllocs++;
 		}
 		else
 		{
 			// Use str(object) instead!
 			if ((obUse=PyObject_Str(obj))==NULL) BREAK_FALSE
 			if ( !PyWinObject_AsBstr(obUse, &V_BSTR(var)) ) BREAK_FALSE
+			g_bstrAllocs++;
 		}
 		break;
 	case VT_BSTR | VT_BYREF:
@@ -1248,6 +1644,8 @@ BOOL PythonOleArgHelper::MakeObjToVariant(PyObject *obj, VARIANT *var, PyObject
 
 		*V_BSTRREF(var) = NULL;
 		
+		// BYREF strings are never pooled, as the callee may free or
+		// replace them.
 		if (!VALID_BYREF_MISSING(obj)) {
 			if ( PyString_Check(obj) || PyUnicode_Check(obj) )
 			{
@@ -1259,6 +1657,7 @@ BOOL PythonOleArgHelper::MakeObjToVariant(PyObject *obj, VARIANT *var, PyObject
 				if ((obUse=PyObject_Str(obj))==NULL) BREAK_FALSE
 				if ( !PyWinObject_AsBstr(obUse, V_BSTRREF(var)) ) BREAK_FALSE
 			}
+			g_bstrAllocs++;
 		}
 		break;
 	case VT_I8:
@@ -0,0 +1,76 @@
+# Timings for the per-call overhead of makepy style calls.
+#
+# Compares PyIDispatch.InvokeTypes, which parses the type description
+# tuples on every call, with a signature compiled once via
+# pythoncom.CompileInvokeTypes (as used by makepy generated code).
+#
+# Uses the PyCOMTest server - see testPyComTest.py - if it is registered,
+# otherwise a trivial Python implemented IDispatch.
+import sys
+import timeit
+
+import pythoncom
+import win32com.server.util
+
+LCID = 0x0
+VT_I4 = pythoncom.VT_I4
+VT_BSTR = pythoncom.VT_BSTR
+IN = pythoncom.PARAMFLAG_FIN
+
+
+class MockServer:
+    _public_methods_ = ["GetSetLong", "Add3", "DoubleString"]
+
+    def GetSetLong(self, val):
+        return val
+
+    def Add3(self, a, b, c):
+        return a + b + c
+
+    def DoubleString(self, val):
+        return val * 2
+
+
+def get_server():
+    try:
+        from win32com.client.gencache import EnsureDispatch
+        return EnsureDispatch("PyCOMTest.PyCOMTest")._oleobj_, "PyCOMTest"
+    except pythoncom.com_error:
+        ob = win32com.server.util.wrap(MockServer())
+        return ob, "a Python IDispatch"
+
+
+def main(number=100000, repeat=3):
+    disp, desc = get_server()
+    print("Calling methods on %s, %d calls each" % (desc, number))
+    cases = [("GetSetLong", (VT_I4, 0), ((VT_I4, IN),), (1,)),
+             ("DoubleString", (VT_BSTR, 0), ((VT_BSTR, IN),), (u"hello",))]
+    if desc != "PyCOMTest":
+        cases.append(("Add3", (VT_I4, 0), ((VT_I4, IN),) * 3, (1, 2, 3)))
+
+    def best(func):
+        return min(timeit.repeat(func, number=number, repeat=repeat))
+
+    for name, retDesc, argsDesc, args in cases:
+        dispid = disp.GetIDsOfNames(name)
+        invoke = disp.InvokeTypes
+        sig = pythoncom.CompileInvokeTypes(dispid, LCID, 1, retDesc, argsDesc)
+        pythoncom.GetArgAllocStats(True)
+        t_invoke = best(
+            lambda: invoke(dispid, LCID, 1, retDesc, argsDesc, *args))
+        t_sig = best(lambda: sig(disp, *args))
+        allocs = pythoncom.GetArgAllocStats(True)
+        print("%s:" % name)
+        print("  InvokeTypes:          %.3f usec/call" %
+              (t_invoke * 1e6 / number))
+        print("  CompileInvokeTypes:   %.3f usec/call (%.2fx)" %
+              (t_sig * 1e6 / number, t_invoke / t_sig))
+        print("  BSTRs allocated:      %(bstr_allocs)d, reused %(bstr_pool_hits)d"
+              % allocs)
+
+
+if __name__ == '__main__':
+    num = 100000
+    if len(sys.argv) > 1:
+        num = int(sys.argv[1])
+    main(num)
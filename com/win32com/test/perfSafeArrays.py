@@ -0,0 +1,50 @@
+# Timings for passing large numeric SAFEARRAYs to and from a COM server.
+#
+# Compares the element-by-element sequence conversion with the bulk buffer
+# paths - passing an object which supports the buffer interface (eg,
+# array.array) for a SAFEARRAY(double) argument, and fetching arrays back
+# with pythoncom.SetSafeArrayAsBuffer() enabled.
+#
+# Uses the PyCOMTest server - see testPyComTest.py.
+import array
+import sys
+import timeit
+
+import pythoncom
+from win32com.client.gencache import EnsureDispatch
+
+
+def main(num_elts=1000000, repeat=3):
+    o = EnsureDispatch("PyCOMTest.PyCOMTest")
+    vals = [i * 0.5 for i in range(num_elts)]
+    buf = array.array('d', vals)
+
+    def best(func):
+        return min(timeit.repeat(func, number=1, repeat=repeat))
+
+    print("Passing %d doubles to SetDoubleSafeArray" % num_elts)
+    t_seq = best(lambda: o.SetDoubleSafeArray(vals))
+    t_buf = best(lambda: o.SetDoubleSafeArray(buf))
+    print("  list:         %.3f sec" % t_seq)
+    print("  array('d'):   %.3f sec (%.1fx)" % (t_buf, t_seq / t_buf))
+
+    print("Round-tripping %d doubles via ChangeDoubleSafeArray" % num_elts)
+    t_tuple = best(lambda: o.ChangeDoubleSafeArray(vals))
+    if sys.version_info > (3,):
+        old = pythoncom.SetSafeArrayAsBuffer(True)
+        try:
+            t_view = best(lambda: o.ChangeDoubleSafeArray(buf))
+        finally:
+            pythoncom.SetSafeArrayAsBuffer(old)
+        print("  list -> tuple:        %.3f sec" % t_tuple)
+        print("  array -> memoryview:  %.3f sec (%.1fx)" %
+              (t_view, t_tuple / t_view))
+    else:
+        print("  list -> tuple:        %.3f sec" % t_tuple)
+
+
+if __name__ == '__main__':
+    num = 1000000
+    if len(sys.argv) > 1:
+        num = int(sys.argv[1])
+    main(num)
@@ -111,5 +111,75 @@ class Tester(win32com.test.util.TestCase):
         dispexob = self.ob._oleobj_.QueryInterface(pythoncom.IID_IDispatchEx)
         DispExTest(dispexob)
 
+    def testDirectInvoke(self):
+        # Methods are called directly by the gateway, not via _Invoke_.
+        policy = pythoncom.UnwrapObject(self.ob._oleobj_)
+        self.assertEqual(sorted(policy._dispid_to_callable_.keys()),
+                         sorted(policy._dispid_to_func_.keys()))
+        calls = []
+        real_Invoke = policy._Invoke_
+
+        def _Invoke_(*args):
+            calls.append(args[0])
+            return real_Invoke(*args)
+        policy._Invoke_ = _Invoke_
+        dispob = self.ob._oleobj_
+        dispob.Invoke(10, 0, pythoncom.DISPATCH_METHOD, 0, 1)
+        dispob.Invoke(10, 0, pythoncom.DISPATCH_METHOD, 0, 2)
+        self.assertEqual(calls, [])
+        # Properties still go via the policy.
+        self.assertEqual(self.ob(), (1, 2))
+        self.assertEqual(calls, [pythoncom.DISPID_VALUE])
+        # Errors are reported just like they were via the policy.
+        try:
+            dispob.Invoke(11, 0, pythoncom.DISPATCH_METHOD, 0, 3)
+            self.fail("expected an exception")
+        except pythoncom.com_error as exc:
+            self.assertEqual(exc.hresult, winerror.DISP_E_EXCEPTION)
+        self.assertRaises(pythoncom.com_error, dispob.Invoke,
+                          10, 0, pythoncom.DISPATCH_METHOD, 0)
+        self.assertEqual(calls, [pythoncom.DISPID_VALUE])
+
+    def testNoDirectInvokeWithHandler(self):
+        # Objects providing their own _invokeex_ get every call.
+        class Handler(PythonSemanticClass):
+            def _invokeex_(self, dispid, lcid, wFlags, args, kwargs, sp):
+                return "handled"
+        ob = win32com.client.Dispatch(win32com.server.util.wrap(Handler()))
+        policy = pythoncom.UnwrapObject(ob._oleobj_)
+        self.assertEqual(policy._dispid_to_callable_, None)
+        self.assertEqual(
+            ob._oleobj_.Invoke(10, 0, pythoncom.DISPATCH_METHOD, 1, 1),
+            "handled")
+
+    def testGetIDsOfNamesCache(self):
+        dispob = self.ob._oleobj_
+        pythoncom.InvalidateGatewayNameCache(dispob)
+        before = pythoncom.GetGatewayNameCacheStats(dispob)
+        self.assertEqual(before["entries"], 0)
+        self.assertEqual(dispob.GetIDsOfNames("Add"), 10)
+        # Names are matched case insensitively.
+        self.assertEqual(dispob.GetIDsOfNames("ADD"), 10)
+        self.assertEqual(dispob.GetIDsOfNames("add"), 10)
+        stats = pythoncom.GetGatewayNameCacheStats(dispob)
+        self.assertEqual(stats["entries"], 1)
+        self.assertEqual(stats["hits"] - before["hits"], 2)
+        self.assertEqual(stats["misses"] - before["misses"], 1)
+        # Unknown names are not cached.
+        self.assertRaises(pythoncom.com_error, dispob.GetIDsOfNames, "Missing")
+        self.assertRaises(pythoncom.com_error, dispob.GetIDsOfNames, "Missing")
+        self.assertEqual(
+            pythoncom.GetGatewayNameCacheStats(dispob)["entries"], 1)
+        totals = pythoncom.GetGatewayNameCacheStats()
+        self.assertTrue(totals["hits"] >= stats["hits"])
+        # The policy is asked again once the cache is invalidated.
+        policy = pythoncom.UnwrapObject(dispob)
+        policy._name_to_dispid_["add"] = 11
+        self.assertEqual(dispob.GetIDsOfNames("Add"), 10)
+        pythoncom.InvalidateGatewayNameCache(dispob)
+        self.assertEqual(
+            pythoncom.GetGatewayNameCacheStats(dispob)["entries"], 0)
+        self.assertEqual(dispob.GetIDsOfNames("Add"), 11)
+
 if __name__ == '__main__':
     unittest.main()
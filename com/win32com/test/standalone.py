@@ -0,0 +1,20 @@
+"""Loads modules of win32com.client which only need the standard library
+straight from the source tree, so their tests can run without pythoncom.
+
+This is only used when win32com itself can't be imported - the tests are
+then being run as scripts, so this module is found next to them."""
+import os
+
+
+def LoadClientModule(name):
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        os.pardir, "client", name + ".py")
+    try:
+        import importlib.util
+    except ImportError:
+        import imp
+        return imp.load_source(name, path)
+    spec = importlib.util.spec_from_file_location(name, path)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
@@ -0,0 +1,121 @@
+# Tests for the gencache index (win32com.client.gencacheindex).
+import os
+import shutil
+import tempfile
+import unittest
+
+try:
+    from win32com.client import gencacheindex
+except ImportError:
+    # No COM - gencacheindex only needs the standard library.
+    from standalone import LoadClientModule
+    gencacheindex = LoadClientModule("gencacheindex")
+
+TLB1 = ("{00020430-0000-0000-C000-000000000046}", 0, 2, 0)
+TLB2 = ("{6B1A6D62-2A1E-4F7C-9C7B-0D3C5A2E0001}", 0x409, "1", "a")
+
+ENTRIES = [
+    ("{6B1A6D62-2A1E-4F7C-9C7B-0D3C5A2E0003}", TLB2,
+     gencacheindex.KIND_CLASS, "Widget"),
+    ("{6B1A6D62-2A1E-4F7C-9C7B-0D3C5A2E0002}", TLB2,
+     gencacheindex.KIND_VTABLE, "IWidget"),
+    ("{BEF6E003-A874-101A-8BBA-00AA00300CAB}", TLB1,
+     gencacheindex.KIND_PACKAGE, "Font"),
+    ("{00020400-0000-0000-C000-000000000046}", TLB1,
+     gencacheindex.KIND_UNKNOWN, None),
+]
+
+
+class TestIndex(unittest.TestCase):
+
+    def setUp(self):
+        self.index = gencacheindex.Index(gencacheindex.Build(ENTRIES))
+
+    def testLookup(self):
+        self.assertEqual(len(self.index), len(ENTRIES))
+        for clsid, typelib, kind, name in ENTRIES:
+            self.assertEqual(self.index.Lookup(clsid), (typelib, kind, name))
+        # Case doesn't matter.
+        clsid, typelib, kind, name = ENTRIES[0]
+        self.assertEqual(self.index.Lookup(clsid.lower()), (typelib, kind, name))
+
+    def testMissing(self):
+        self.assertEqual(self.index.Lookup("{00000000-0000-0000-0000-000000000000}"), None)
+        self.assertEqual(self.index.Lookup("not a clsid"), None)
+        empty = gencacheindex.Index(gencacheindex.Build([]))
+        self.assertEqual(empty.Lookup(ENTRIES[0][0]), None)
+
+    def testEntries(self):
+        got = sorted(self.index.Entries())
+        self.assertEqual(got, sorted(ENTRIES))
+
+    def testDuplicates(self):
+        clsid = ENTRIES[0][0]
+        index = gencacheindex.Index(gencacheindex.Build(
+            [(clsid, TLB1, gencacheindex.KIND_CLASS, "Old"),
+             (clsid.lower(), TLB2, gencacheindex.KIND_CLASS, "New")]))
+        self.assertEqual(len(index), 1)
+        self.assertEqual(index.Lookup(clsid), (TLB2, gencacheindex.KIND_CLASS, "New"))
+
+    def testBadData(self):
+        data = gencacheindex.Build(ENTRIES)
+        self.assertRaises(gencacheindex.error, gencacheindex.Index, b"")
+        self.assertRaises(gencacheindex.error, gencacheindex.Index, data[:40])
+        self.assertRaises(gencacheindex.error, gencacheindex.Index,
+                          b"X" + data[1:])
+        # Strings cut off at the end of the file.
+        self.assertRaises(gencacheindex.error, gencacheindex.Index, data[:-1])
+        # A class naming a string, or a type library, past the end.
+        header = gencacheindex._header.unpack_from(data, 0)
+        classesOffset = header[5]
+        for field, value in ((3, 1 << 20), (1, 99)):
+            entry = list(gencacheindex._class.unpack_from(data, classesOffset))
+            entry[field] = value
+            bad = data[:classesOffset] + gencacheindex._class.pack(*entry) + \
+                data[classesOffset + gencacheindex._class.size:]
+            self.assertRaises(gencacheindex.error, gencacheindex.Index, bad)
+
+
+class TestIndexFiles(unittest.TestCase):
+
+    def setUp(self):
+        self.dirname = tempfile.mkdtemp()
+
+    def tearDown(self):
+        shutil.rmtree(self.dirname)
+
+    def testSaveOpen(self):
+        name = gencacheindex.Save(self.dirname, ENTRIES)
+        self.assertEqual(os.path.basename(name), "dicts.1.idx")
+        index = gencacheindex.Open(name)
+        try:
+            self.assertEqual(sorted(index.Entries()), sorted(ENTRIES))
+        finally:
+            index.Close()
+
+    def testGenerations(self):
+        first = gencacheindex.Save(self.dirname, ENTRIES[:1])
+        # An index which is open is never overwritten.
+        index = gencacheindex.Open(first)
+        try:
+            second = gencacheindex.Save(self.dirname, ENTRIES)
+            self.assertNotEqual(first, second)
+            self.assertEqual(len(index), 1)
+        finally:
+            index.Close()
+        names = os.listdir(self.dirname)
+        self.assertEqual(gencacheindex.FindIndexName(names),
+                         os.path.basename(second))
+        third = gencacheindex.Save(self.dirname, ENTRIES)
+        # Older generations are removed once they are closed.
+        self.assertEqual(os.listdir(self.dirname), [os.path.basename(third)])
+
+    def testFindIndexName(self):
+        names = ["dicts.dat", "dicts.9.idx", "dicts.10.idx", "dicts.x.idx",
+                 "__init__.py"]
+        self.assertEqual(gencacheindex.FindIndexName(names), "dicts.10.idx")
+        self.assertEqual(gencacheindex.FindIndexName(["dicts.dat"]), None)
+
+
+if __name__ == '__main__':
+    unittest.main()
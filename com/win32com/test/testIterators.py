@@ -33,6 +33,12 @@ class _BaseTestCase(win32com.test.util.TestCase):
             got.append(v)
         self.assertEqual(got, self.expected_data)
 
+    def test_batched(self):
+        ob, i = self.iter_factory()
+        for maxBatch in (1, 2, 64):
+            i.Reset()
+            self.assertEqual(list(i.Iter(maxBatch)), self.expected_data)
+
     def _do_test_nonenum(self, object):
         try:
             for i in object:
@@ -128,6 +134,27 @@ class WrappedPythonCOMServerTestCase(_BaseTestCase):
         self.object = Dispatch(sv)
         self.iter_factory = factory
 
+    def test_batch_growth(self):
+        data = list(range(1000))
+        coll = win32com.server.util.NewCollection(data)
+        enum = Dispatch(coll)._NewEnum()._oleobj_
+        it = enum.Iter(32, 10000)
+        self.assertEqual(it.batch, 1)
+        self.assertEqual(it.max_batch, 32)
+        self.assertEqual(list(it), data)
+        self.assertEqual(it.fetched, len(data))
+        self.assertEqual(it.batch, 32)
+        # Batches of 1, 2, 4, 8 and 16, then 31 of (up to) 32.  The last
+        # comes up short, which ends the iteration without another call.
+        self.assertEqual(it.calls, 5 + 31)
+        # When the items fill the last batch exactly, one more call finds
+        # the end.
+        coll = win32com.server.util.NewCollection(data[:63])
+        it = Dispatch(coll)._NewEnum()._oleobj_.Iter(32, 10000)
+        self.assertEqual(list(it), data[:63])
+        self.assertEqual(it.calls, 5 + 1 + 1)
+        self.assertRaises(ValueError, enum.Iter, 0)
+
     def tearDown(self):
         self.object = None
 
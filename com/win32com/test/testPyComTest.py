@@ -7,6 +7,7 @@ import pythoncom
 import time
 import pywintypes
 import os
+import struct
 import winerror
 import win32com
 import win32com.client.connect
@@ -211,6 +212,34 @@ def TestCommon(o, is_generated):
     progress("Checking structs")
     r = o.GetStruct()
     assert r.int_value == 99 and str(r.str_value) == "Hello from C++"
+    layout = pythoncom.GetRecordLayout(r)
+    assert [f[0] for f in layout] == ["int_value", "str_value"], layout
+    # int_value is plain data, the BSTR is not.
+    assert layout[0][2:] == (pythoncom.VT_INT, 4), layout
+    assert layout[1][3] == 0, layout
+    r.int_value = 123
+    assert r.int_value == 123 and str(r.str_value) == "Hello from C++"
+    try:
+        pythoncom.RecordsToBuffer([r])
+        raise error("Records holding strings should not be copied")
+    except TypeError:
+        pass
+    recs = []
+    for i in range(3):
+        rec = win32com.client.Record("TestPlainStruct", o)
+        rec.int_value = i
+        rec.double_value = i + 0.5
+        recs.append(rec)
+    buf = pythoncom.RecordsToBuffer(recs)
+    layout = pythoncom.GetRecordLayout(recs[0])
+    assert [f[0] for f in layout] == ["int_value", "double_value"], layout
+    size = len(buf) // len(recs)
+    assert size * len(recs) == len(buf) and size >= 12, len(buf)
+    for i in range(len(recs)):
+        got = (struct.unpack_from("i", buf, i * size + layout[0][1])[0],
+               struct.unpack_from("d", buf, i * size + layout[1][1])[0])
+        assert got == (i, i + 0.5), got
+    assert len(pythoncom.RecordsToBuffer([])) == 0
     assert o.DoubleString("foo") == "foofoo"
 
     progress("Checking var args")
@@ -400,6 +429,28 @@ def TestDynamic():
     #    raise RuntimeError, o.paramProp(0)
 
 
+def TestDynamicMemberCache():
+    # Dynamic objects of the same type share the names bound via their
+    # typecomp.
+    import win32com.client.dynamic
+    o1 = win32com.client.dynamic.Dispatch("PyCOMTest.PyCOMTest")
+    o2 = win32com.client.dynamic.Dispatch("PyCOMTest.PyCOMTest")
+    if o1._membercache_ is not o2._membercache_:
+        raise error("Objects of the same type should share a member cache")
+    check_get_set(o1.GetSetLong, 1)
+    before = pythoncom.GetMemberCacheStats()
+    check_get_set(o2.GetSetLong, 2)
+    after = pythoncom.GetMemberCacheStats()
+    if after["hits"] != before["hits"] + 1:
+        raise error("GetSetLong was not found in the member cache: %r -> %r"
+                    % (before, after))
+    if "GetSetLong" not in o2._olerepr_.mapFuncs:
+        raise error("The cached member was not added to the object")
+    # Types without a GUID can't be told apart, so they don't share one.
+    if pythoncom.GetMemberCache(pythoncom.IID_NULL, 0) is not None:
+        raise error("Types with a null GUID should not have a member cache")
+
+
 def TestGenerated():
     # Create an instance of the server.
     from win32com.client.gencache import EnsureDispatch
@@ -444,6 +495,10 @@ def TestGenerated():
     TestApplyResult(o.GetSimpleSafeArray, (None,), tuple(range(10)))
     resultCheck = tuple(range(5)), tuple(range(10)), tuple(range(20))
     TestApplyResult(o.GetSafeArrays, (None, None, None), resultCheck)
+    TestSafeArrayAsBuffer(o)
+    TestSafeArrayFromBuffer(o)
+    TestCompiledInvokeTypes(o)
+    TestArgAllocPool(o)
 
     l = []
     TestApplyResult(o.SetIntSafeArray, (l,), len(l))
@@ -485,6 +540,90 @@ def TestGenerated():
     progress("Finished generated .py test.")
 
 
+def TestSafeArrayAsBuffer(o):
+    if sys.version_info < (3,):
+        return
+    old = pythoncom.SetSafeArrayAsBuffer(True)
+    try:
+        got = o.GetSimpleSafeArray(None)
+        if not isinstance(got, memoryview) or got.format != 'i':
+            raise error("Expected an 'i' memoryview - got %r" % (got,))
+        if got.shape != (10,) or got.tolist() != list(range(10)):
+            raise error("GetSimpleSafeArray buffer has wrong data - got %r"
+                        % (got.tolist(),))
+        vals = [1.1, 2.2, 3.3, 4.4]
+        got = o.ChangeDoubleSafeArray(vals)
+        if got.format != 'd' or got.tolist() != [v * 2 for v in vals]:
+            raise error("ChangeDoubleSafeArray buffer has wrong data - got %r"
+                        % (got.tolist(),))
+    finally:
+        pythoncom.SetSafeArrayAsBuffer(old)
+    # and back to tuples once turned off.
+    TestApplyResult(o.GetSimpleSafeArray, (None,), tuple(range(10)))
+
+
+def TestSafeArrayFromBuffer(o):
+    # Objects supporting the buffer interface with a matching item format
+    # are copied straight into the SAFEARRAY.
+    import array
+    vals = [1.1, 2.2, 3.3, 4.4]
+    TestApplyResult(o.SetDoubleSafeArray, (array.array('d', vals),), len(vals))
+    TestApplyResult(o.ChangeDoubleSafeArray, (array.array('d', vals),),
+                    tuple([v * 2 for v in vals]))
+    TestApplyResult(o.SetIntSafeArray, (array.array('i', range(6)),), 6)
+    if sys.version_info > (3,):
+        # A 2 dimensional buffer - only the first dimension is reported.
+        ints = memoryview(array.array('i', range(6))).cast('B').cast('i', (2, 3))
+        TestApplyResult(o.SetIntSafeArray, (ints,), 2)
+    # A buffer of the wrong type still works via the sequence code.
+    TestApplyResult(o.SetDoubleSafeArray, (array.array('i', range(6)),), 6)
+
+
+def TestCompiledInvokeTypes(o):
+    # makepy compiles the InvokeTypes arguments into a signature object.
+    sig = o._sig_GetSetLong
+    if sig.dispid != o._oleobj_.GetIDsOfNames("GetSetLong"):
+        raise error("The compiled signature has the wrong dispid - %r" %
+                    (sig.dispid,))
+    for val in (0, -1, 0x7fffffff):
+        got = sig(o._oleobj_, val)
+        expected = o._oleobj_.InvokeTypes(sig.dispid, sig.lcid, sig.flags,
+                                          (3, 0), ((3, 1),), val)
+        if got != expected or got != val:
+            raise error("Compiled GetSetLong returned %r, expected %r" %
+                        (got, expected))
+    sig = pythoncom.CompileInvokeTypes(sig.dispid, sig.lcid, sig.flags,
+                                       (3, 0), ((3, 1),))
+    TestApplyResult(lambda v: sig(o._oleobj_, v), (1,), 1)
+    check_get_set_raises(TypeError, lambda v: sig(o._oleobj_, v, v), 1)
+    check_get_set_raises(TypeError, lambda v: sig(o, v), 1)
+    check_get_set_raises(ValueError, lambda v: sig(o._oleobj_, v), "foo")
+
+
+def TestArgAllocPool(o):
+    # Short "in" strings passed via InvokeTypes use pooled BSTRs.
+    dispid = o._oleobj_.GetIDsOfNames("DoubleString")
+    invoke = o._oleobj_.InvokeTypes
+    for i in range(3):
+        TestApplyResult(lambda v: invoke(dispid, 0, 1, (8, 0), ((8, 1),), v),
+                        ("foo",), "foofoo")
+    stats = pythoncom.GetArgAllocStats(True)
+    if stats["bstr_pool_hits"] < 2:
+        raise error("Pooled BSTRs were not reused - %r" % (stats,))
+    # Long strings, and BYREF strings the server can replace, are allocated.
+    long_str = "x" * 1000
+    TestApplyResult(lambda v: invoke(dispid, 0, 1, (8, 0), ((8, 1),), v),
+                    (long_str,), long_str * 2)
+    TestApplyResult(o.DoubleInOutString, ("foo",), "foofoo")
+    stats = pythoncom.GetArgAllocStats()
+    if stats["bstr_allocs"] < 2 or stats["bstr_pool_hits"] != 0:
+        raise error("Unexpected allocation stats - %r" % (stats,))
+    # Pooled strings of different lengths must not leak into each other.
+    for v in ("a", "abcdefgh", "", "xyz"):
+        TestApplyResult(lambda v: invoke(dispid, 0, 1, (8, 0), ((8, 1),), v),
+                        (v,), v * 2)
+
+
 def TestEvents(o, handler):
     sessions = []
     handler._Init()
@@ -762,6 +901,9 @@ class Tester(win32com.test.util.TestCase):
     def testDynamic(self):
         TestDynamic()
 
+    def testDynamicMemberCache(self):
+        TestDynamicMemberCache()
+
     def testGenerated(self):
         TestGenerated()
 
@@ -0,0 +1,246 @@
+# Tests for win32com.client.tlbsnapshot and pythoncom.ExtractTypeLib.
+import os
+import tempfile
+import unittest
+
+try:
+    import pythoncom
+    from win32com.client import genpy, tlbsnapshot
+except ImportError:
+    # No COM - tlbsnapshot only needs the standard library, so the tests of
+    # snapshots themselves still run.
+    from standalone import LoadClientModule
+    pythoncom = genpy = None
+    tlbsnapshot = LoadClientModule("tlbsnapshot")
+
+TYPE_E_CANTLOADLIBRARY = -2147312566
+# The pythoncom constants used, so the snapshot tests don't need it.
+TKIND_ENUM, TKIND_INTERFACE, TKIND_DISPATCH, TKIND_COCLASS, TKIND_ALIAS = \
+    0, 3, 4, 5, 6
+TYPEFLAG_FDUAL = 0x40
+INVOKE_FUNC = 1
+VAR_CONST = 2
+IMPLTYPEFLAG_FDEFAULT = 1
+
+# A snapshot of a small library - an enum, a dual interface, an alias and a
+# coclass - referring to a couple of stdole types.
+FIXTURE = {
+    "version": 1,
+    "libattr": ("{6B1A6D62-2A1E-4F7C-9C7B-0D3C5A2E0001}", 0, 1, 1, 2, 8),
+    "doc": ("WidgetLib", "Widget Type Library", 0, None),
+    "count": 5,
+    "types": [
+        # 0 - enum Colors
+        {"attr": ("{00000000-0000-0000-0000-000000000000}", 0, -1, -1, 4, 0,
+                  0, 2, 0, 0, 4, 0, 0, 0, None, (0, 0)),
+         "doc": ("Colors", None, 0, None),
+         "funcs": (),
+         "vars": (((0, 0, (3, 0, None), 0, 2), ("Red",), ("Red", None, 0, None)),
+                  ((1, 1, (3, 0, None), 0, 2), ("Green",), ("Green", None, 0, None))),
+         "impl": {}, "refs": {}, "badrefs": {}},
+        # 1 - dual dispinterface IWidget
+        {"attr": ("{6B1A6D62-2A1E-4F7C-9C7B-0D3C5A2E0002}", 0, -1, -1, 4, 4,
+                  4, 0, 1, 28, 4, 0x1040, 0, 0, None, (0, 0)),
+         "doc": ("IWidget", "A widget", 0, None),
+         "funcs": (
+             ((0, (), (), 4, 2, 4, 0, 0, (8, 0, None), 0),
+              ("Name",), ("Name", "The name", 0, None)),
+             ((1, (), ((3, 1, None), ((29, 258), 1, None)), 4, 1, 4, 0, 0,
+               (24, 0, None), 0),
+              ("Resize", "width", "size"), ("Resize", None, 0, None)),
+             ((2, (), (), 4, 2, 4, 0, 0, ((26, (29, 514)), 0, None), 0),
+              ("Font",), ("Font", None, 0, None)),
+             ((3, (), (), 4, 2, 4, 0, 0, ((26, (29, 770)), 0, None), 0x40),
+              ("Broken",), None)),
+         "vars": (),
+         "impl": {-1: (1026, 0), 0: (1282, 0)},
+         "refs": {258: 3, 514: 5, 1026: 2, 1282: 6},
+         "badrefs": {770: TYPE_E_CANTLOADLIBRARY}},
+        # 2 - the vtable interface of IWidget
+        {"attr": ("{6B1A6D62-2A1E-4F7C-9C7B-0D3C5A2E0002}", 0, -1, -1, 4, 3,
+                  1, 0, 1, 32, 4, 0x1040, 0, 0, None, (0, 0)),
+         "doc": ("IWidget", "A widget", 0, None),
+         "funcs": (
+             ((0, (), (((26, 8), 10, None),), 1, 2, 4, 0, 28, (25, 0, None), 0),
+              ("Name", "pVal"), ("Name", "The name", 0, None)),),
+         "vars": (),
+         "impl": {0: (2, 0)},
+         "refs": {2: 6},
+         "badrefs": {}},
+        # 3 - alias WidgetSize = Colors
+        {"attr": ("{00000000-0000-0000-0000-000000000000}", 0, -1, -1, 4, 6,
+                  0, 0, 0, 0, 4, 0, 0, 0, (29, 3), (0, 0)),
+         "doc": ("WidgetSize", None, 0, None),
+         "funcs": (), "vars": (), "impl": {},
+         "refs": {3: 0}, "badrefs": {}},
+        # 4 - coclass Widget
+        {"attr": ("{6B1A6D62-2A1E-4F7C-9C7B-0D3C5A2E0003}", 0, -1, -1, 0, 5,
+                  0, 0, 1, 0, 4, 2, 0, 0, None, (0, 0)),
+         "doc": ("Widget", "Widget Class", 0, None),
+         "funcs": (), "vars": (),
+         "impl": {0: (4, 1)},
+         "refs": {4: 1}, "badrefs": {}},
+        # 5 - stdole.Font, only used as a result type
+        {"attr": ("{BEF6E003-A874-101A-8BBA-00AA00300CAB}", 0, -1, -1, 4, 4,
+                  0, 9, 1, 28, 4, 0x1000, 0, 0, None, (0, 0)),
+         "doc": ("Font", None, 0, None),
+         "funcs": None, "vars": None, "impl": None,
+         "refs": {}, "badrefs": {}},
+        # 6 - stdole.IDispatch, implemented by IWidget
+        {"attr": ("{00020400-0000-0000-C000-000000000046}", 0, -1, -1, 4, 3,
+                  0, 0, 0, 28, 4, 0, 0, 0, None, (0, 0)),
+         "doc": ("IDispatch", None, 0, None),
+         "funcs": (), "vars": (), "impl": {},
+         "refs": {}, "badrefs": {}},
+    ],
+}
+
+
+class TestSnapshotFixture(unittest.TestCase):
+
+    def setUp(self):
+        self.tlb = tlbsnapshot.TypeLib(FIXTURE)
+
+    def testLibrary(self):
+        tlb = self.tlb
+        self.assertEqual(tlb.GetTypeInfoCount(), 5)
+        la = tlb.GetLibAttr()
+        self.assertEqual(str(la[0]), FIXTURE["libattr"][0])
+        self.assertEqual(la[3:5], (1, 2))
+        self.assertEqual(tlb.GetDocumentation(-1)[0], "WidgetLib")
+        self.assertEqual(tlb.GetDocumentation(4)[0], "Widget")
+        self.assertEqual([tlb.GetTypeInfoType(i) for i in range(5)],
+                         [TKIND_ENUM, TKIND_DISPATCH,
+                          TKIND_INTERFACE, TKIND_ALIAS,
+                          TKIND_COCLASS])
+        # Only the library's own types are visible by index.
+        self.assertRaises(tlbsnapshot.com_error, tlb.GetTypeInfo, 5)
+
+    def testAttr(self):
+        attr = self.tlb.GetTypeInfo(1).GetTypeAttr()
+        self.assertEqual(len(attr), 16)
+        self.assertEqual(attr.typekind, TKIND_DISPATCH)
+        self.assertEqual(attr[5], attr.typekind)
+        self.assertEqual(attr.cFuncs, 4)
+        self.assertTrue(attr.wTypeFlags & TYPEFLAG_FDUAL)
+        self.assertEqual(attr.iid, tlbsnapshot.IID(FIXTURE["types"][1]["attr"][0]))
+
+    def testFuncDesc(self):
+        info = self.tlb.GetTypeInfo(1)
+        fd = info.GetFuncDesc(1)
+        self.assertEqual(fd.memid, 1)
+        self.assertEqual(fd.invkind, INVOKE_FUNC)
+        self.assertEqual(tuple(fd), FIXTURE["types"][1]["funcs"][1][0])
+        # genpy rewrites descriptions, which must not change the snapshot.
+        fd.rettype = (24, 0, None, None)
+        self.assertEqual(info.GetFuncDesc(1).rettype, (24, 0, None))
+        self.assertRaises(tlbsnapshot.com_error, info.GetFuncDesc, 4)
+
+    def testVarDesc(self):
+        info = self.tlb.GetTypeInfo(0)
+        vd = info.GetVarDesc(1)
+        self.assertEqual(vd.value, 1)
+        self.assertEqual(vd[4], VAR_CONST)
+        self.assertEqual(info.GetNames(vd.memid), ("Green",))
+
+    def testNamesAndDocs(self):
+        info = self.tlb.GetTypeInfo(1)
+        self.assertEqual(info.GetNames(1), ("Resize", "width", "size"))
+        self.assertEqual(info.GetDocumentation(0)[1], "The name")
+        self.assertEqual(info.GetDocumentation(-1)[0], "IWidget")
+        # Documentation which could not be read, and unknown members.
+        self.assertRaises(tlbsnapshot.com_error, info.GetDocumentation, 3)
+        self.assertRaises(tlbsnapshot.com_error, info.GetNames, 99)
+
+    def testRefs(self):
+        info = self.tlb.GetTypeInfo(1)
+        alias = info.GetRefTypeInfo(258)
+        self.assertEqual(alias.GetDocumentation(-1)[0], "WidgetSize")
+        self.assertTrue(alias is self.tlb.GetTypeInfo(3))
+        font = info.GetRefTypeInfo(514)
+        self.assertEqual(font.GetDocumentation(-1)[0], "Font")
+        self.assertEqual(font.GetTypeAttr().cVars, 9)
+        # Only the attributes of result types are kept.
+        self.assertRaises(ValueError, font.GetVarDesc, 0)
+        try:
+            info.GetRefTypeInfo(770)
+            self.fail("expected a com_error")
+        except tlbsnapshot.com_error as exc:
+            self.assertEqual(exc.hresult, TYPE_E_CANTLOADLIBRARY)
+
+    def testImplTypes(self):
+        info = self.tlb.GetTypeInfo(1)
+        vtbl = info.GetRefTypeInfo(info.GetRefTypeOfImplType(-1))
+        self.assertEqual(vtbl.GetTypeAttr().typekind, TKIND_INTERFACE)
+        coclass = self.tlb.GetTypeInfo(4)
+        self.assertEqual(coclass.GetImplTypeFlags(0), IMPLTYPEFLAG_FDEFAULT)
+        self.assertRaises(tlbsnapshot.com_error, coclass.GetImplTypeFlags, 1)
+
+    def testExtractSnapshot(self):
+        # Extracting from a snapshot gives the same snapshot.
+        self.assertEqual(tlbsnapshot.ExtractTypeLib(self.tlb), FIXTURE)
+
+    def testSaveLoad(self):
+        fd, fname = tempfile.mkstemp(".tlbsnap")
+        os.close(fd)
+        try:
+            tlbsnapshot.Save(self.tlb, fname)
+            self.assertEqual(tlbsnapshot.Load(fname).data, FIXTURE)
+        finally:
+            os.unlink(fname)
+
+    def testVersion(self):
+        data = dict(FIXTURE, version=0)
+        self.assertRaises(ValueError, tlbsnapshot.TypeLib, data)
+
+
+class _Writer:
+    encoding = "utf-8"
+
+    def __init__(self):
+        self.chunks = []
+
+    def write(self, s):
+        self.chunks.append(s)
+
+    def lines(self):
+        # Drop the time the file was generated.
+        return [l for l in "".join(self.chunks).splitlines()
+                if not l.startswith("# On ")]
+
+
+def _Generate(typelib):
+    gen = genpy.Generator(typelib, None, genpy.GeneratorProgress())
+    gen.typelib = typelib  # Don't snapshot live typelibs.
+    f = _Writer()
+    gen.generate(f)
+    return f.lines()
+
+
+@unittest.skipIf(pythoncom is None, "needs pythoncom")
+class TestExtractTypeLib(unittest.TestCase):
+
+    def setUp(self):
+        self.tlb = pythoncom.LoadTypeLib("stdole2.tlb")
+
+    def testNativeMatchesPython(self):
+        self.assertEqual(pythoncom.ExtractTypeLib(self.tlb),
+                         tlbsnapshot.ExtractTypeLib(self.tlb))
+
+    def testGenerateFromSnapshot(self):
+        snap = tlbsnapshot.SnapshotTypeLib(self.tlb)
+        self.assertEqual(_Generate(snap), _Generate(self.tlb))
+
+    def testSnapshotCache(self):
+        # Generators for the same library share a snapshot.
+        genpy.FlushSnapshotCache()
+        snap = genpy.Generator(self.tlb, None, genpy.GeneratorProgress()).typelib
+        self.assertTrue(genpy.SnapshotTypeLib(self.tlb) is snap)
+        genpy.FlushSnapshotCache()
+        self.assertTrue(genpy.lastSnapshot is None)
+        self.assertFalse(genpy.SnapshotTypeLib(self.tlb) is snap)
+        genpy.FlushSnapshotCache()
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -112,7 +112,8 @@ unittest_modules = [
           testStreams testWMI policySemantics testShell testROT
           testAXScript testxslt testDictionary testCollections
           testServers errorSemantics.test testvb testArrays
-          testClipboard testMarshal
+          testClipboard testMarshal testTypeLibSnapshot
+          testGenCacheIndex
         """.split(),
     # Level 2 tests.
     """testMSOffice.TestAll testMSOfficeEvents.test testAccess.test
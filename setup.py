@@ -840,6 +840,7 @@ win32_extensions.append(
                  depends=[
                      "win32/src/PerfMon/perfutil.h",
                      "win32/src/PerfMon/PyPerfMonControl.h",
+                     "win32/src/PerfMon/PerfMonLayout.h",
                  ],
                  ),
 )
@@ -872,6 +873,8 @@ for info in (
         ("win32file", "", None, 0x0500, """
               win32/src/win32file.i
               win32/src/win32file_comm.cpp
+              win32/src/win32file_bufferpool.cpp
+              win32/src/win32file_watcher.cpp
               """),
         ("win32event", "user32", None, None, "win32/src/win32event.i"),
         ("win32clipboard", "gdi32 user32 shell32", None,
@@ -1032,6 +1035,7 @@ pythoncom = WinExt_system32(
         """
                         %(win32com)s/dllmain.cpp            %(win32com)s/ErrorUtils.cpp
                         %(win32com)s/MiscTypes.cpp          %(win32com)s/oleargs.cpp
+                        %(win32com)s/MemberCache.cpp       %(win32com)s/TypeLibExtract.cpp
                         %(win32com)s/PyComHelpers.cpp       %(win32com)s/PyFactory.cpp
                         %(win32com)s/PyGatewayBase.cpp      %(win32com)s/PyIBase.cpp
                         %(win32com)s/PyIClassFactory.cpp    %(win32com)s/PyIDispatch.cpp
@@ -1095,6 +1099,7 @@ pythoncom = WinExt_system32(
                     %(win32com)s/include\PythonCOM.h        %(win32com)s/include\PythonCOMRegister.h
                     %(win32com)s/include\PythonCOMServer.h  %(win32com)s/include\stdafx.h
                     %(win32com)s/include\univgw_dataconv.h
+                    %(win32com)s/include/PySafeArrayLayout.h
                     %(win32com)s/include/PyICancelMethodCalls.h    %(win32com)s/include/PyIContext.h
                     %(win32com)s/include/PyIEnumContextProps.h     %(win32com)s/include/PyIClientSecurity.h
                     %(win32com)s/include/PyIServerSecurity.h
@@ -0,0 +1,74 @@
+# Compares inserting rows with cursor.executemany() a row at a time against
+# sending them in batches with arrays of parameters.
+#
+# Usage: odbc_executemany.py [connection string] [rows]
+# The connection string defaults to the TEST_ODBC_CONNECTION_STRING
+# environment variable, as used by the odbc tests.  Any driver will do, eg
+# a local SQLite file via the SQLite ODBC driver:
+#   "Driver={SQLite3 ODBC Driver};Database=c:\temp\bench.db"
+
+import array
+import os
+import sys
+import time
+
+import odbc
+
+table = "pywin32_executemany_bench"
+clock = getattr(time, "perf_counter", None) or time.clock
+
+
+def run(cur, rows, batchsize):
+    try:
+        cur.execute("drop table %s" % table)
+    except (odbc.error, odbc.progError):
+        pass
+    cur.execute("create table %s (id integer, name varchar(40), value float)"
+                % table)
+    cur.batchsize = batchsize
+    start = clock()
+    cur.executemany("insert into %s (id, name, value) values (?,?,?)" % table,
+                    rows)
+    end = clock()
+    cur.execute("select count(*) from %s" % table)
+    assert cur.fetchone()[0] == len(rows)
+    status = cur.paramstatus
+    if not isinstance(status, memoryview):
+        # Python 2 gives a string of unsigned shorts
+        status = array.array("H", status)
+    assert list(status) == [odbc.SQL_PARAM_SUCCESS] * len(rows)
+    return end - start
+
+
+def main():
+    if len(sys.argv) > 1:
+        conn_str = sys.argv[1]
+    else:
+        conn_str = os.environ.get("TEST_ODBC_CONNECTION_STRING")
+    if not conn_str:
+        print("Usage: %s connection_string [rows]" % sys.argv[0])
+        sys.exit(1)
+    count = int(sys.argv[2]) if len(sys.argv) > 2 else 20000
+    rows = [(i, "name %d" % i, i * 0.25) for i in range(count)]
+
+    conn = odbc.odbc(conn_str)
+    cur = conn.cursor()
+    try:
+        base = None
+        for batchsize in (1, 10, 100, 1000, 10000):
+            took = run(cur, rows, batchsize)
+            if base is None:
+                base = took
+            print("batchsize %5d: %8.3fs  %9.0f rows/s  %5.1fx"
+                  % (batchsize, took, count / took, base / took))
+    finally:
+        try:
+            cur.execute("drop table %s" % table)
+        except (odbc.error, odbc.progError):
+            pass
+        cur.close()
+        conn.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -17,6 +17,7 @@ MappingManager::MappingManager()
 	m_hMappedObject = NULL;
 	m_pMapBlock = NULL;
 	m_pControl = NULL;
+	m_dwSize = 0;
 }
 
 MappingManager::~MappingManager()
@@ -36,9 +37,11 @@ BOOL MappingManager::CheckStatus()
 	return TRUE;
 }
 
-BOOL MappingManager::Init(const TCHAR *szServiceName, const TCHAR *szMappingName /* = NULL */, const TCHAR *szEventSourceName /* = NULL */)
+BOOL MappingManager::Init(const TCHAR *szServiceName, const PyPerfLayout *pLayout, const TCHAR *szMappingName /* = NULL */, const TCHAR *szEventSourceName /* = NULL */)
 {
 	TCHAR szGlobalMapping[MAX_PATH+10] = _T("");
+	// Room for the control data, and the object laid out by the caller.
+	DWORD size = sizeof(MappingManagerControlData) + pLayout->totalSize;
 
 
 	if (szMappingName==NULL)
@@ -60,7 +63,7 @@ BOOL MappingManager::Init(const TCHAR *szServiceName, const TCHAR *szMappingName
 						NULL,
 						PAGE_READWRITE,
 						0,
-						4096,
+						size,
 						szGlobalMapping);
 	if (m_hMappedObject == NULL) {
 		PyWin_SetAPIError("CreateFileMapping");
@@ -79,15 +82,27 @@ BOOL MappingManager::Init(const TCHAR *szServiceName, const TCHAR *szMappingName
 		PyWin_SetAPIError("MapViewOfFile");
 		return FALSE;
 	}
+	// A mapping left open by an earlier process keeps its size.
+	MEMORY_BASIC_INFORMATION mbi;
+	if (VirtualQuery(m_pMapBlock, &mbi, sizeof(mbi))==0) {
+		PyWin_SetAPIError("VirtualQuery");
+		return FALSE;
+	}
+	if (mbi.RegionSize < size) {
+		PyErr_SetString(PyExc_ValueError, "The existing file mapping is too small for the performance data");
+		return FALSE;
+	}
+	m_dwSize = size;
 
 	m_pControl = (MappingManagerControlData *)m_pMapBlock;
 	m_pControl->ControlSize = sizeof(MappingManagerControlData);
 	m_pControl->TotalSize = sizeof(MappingManagerControlData);
 	_tcsncpy(m_pControl->ServiceName, szServiceName, MMCD_SERVICE_SIZE);
-	m_pControl->ServiceName[MMCD_SERVICE_SIZE]=_T('\0');
+	m_pControl->ServiceName[MMCD_SERVICE_SIZE-1]=_T('\0');
 
 	_tcsncpy(m_pControl->EventSourceName, szEventSourceName, MMCD_EVENTSOURCE_SIZE);
-	m_pControl->EventSourceName[MMCD_EVENTSOURCE_SIZE]=_T('\0');
+	m_pControl->EventSourceName[MMCD_EVENTSOURCE_SIZE-1]=_T('\0');
+	m_pControl->Layout = *pLayout;
 	m_pControl->supplierStatus = SupplierStatusRunning;
 	return TRUE;
 }
@@ -97,6 +112,10 @@ void *MappingManager::AllocChunk( DWORD numBytes )
 {
 	if (!CheckStatus())
 		return NULL;
+	if (numBytes > m_dwSize - m_pControl->TotalSize) {
+		PyErr_SetString(PyExc_RuntimeError, "The file mapping is too small");
+		return NULL;
+	}
 	void *result = ((BYTE *)m_pMapBlock) + (m_pControl->TotalSize);
 	m_pControl->TotalSize += numBytes;
 	return result;
@@ -115,6 +134,8 @@ PyObject *PerfmonMethod_NewPerfMonManager(PyObject *self, PyObject *args)
 	TCHAR *szServiceName = NULL;
 	MappingManager *m_pmm = NULL;
 	PyPerfMonManager *pPOT = NULL;
+	PyObject *obType = NULL;
+	PyPERF_OBJECT_TYPE *pPerfOb;
 
 	if (!PyArg_ParseTuple(args, "OO|OO:PerfMonManager", 
 			&obServiceName, // @pyparm <o PyUnicode>|serviceName||The name of the service for which data is being provided.
@@ -140,13 +161,24 @@ PyObject *PerfmonMethod_NewPerfMonManager(PyObject *self, PyObject *args)
 		PyErr_SetString(PyExc_MemoryError, "Allocating memory for MappingManager");
 		goto done;
 	}
-	if (!m_pmm->Init(szServiceName, szMappingName, szEventSourceName))
+	// The object type is laid out first, so the mapping can be sized for it.
+	if (PySequence_Length(obPerfObTypes) != 1) {
+		PyErr_SetString(PyExc_ValueError, "The sequence of PyPERF_OBJECT_TYPEs must have 1 item!");
+		goto done;
+	}
+	obType = PySequence_GetItem(obPerfObTypes, 0);
+	if (obType==NULL)
+		goto done;
+	if (!PyWinObject_AsPyPERF_OBJECT_TYPE(obType, &pPerfOb, FALSE) || !pPerfOb->InitLayout())
+		goto done;
+	if (!m_pmm->Init(szServiceName, pPerfOb->GetLayout(), szMappingName, szEventSourceName))
 		// Init has set Python error
 		goto done;
 
 	pPOT = new(PyPerfMonManager);
 	if (pPOT==NULL) {
 		PyErr_SetString(PyExc_MemoryError, "Allocating MappingManager or PERF_OBJECT_TYPE");
+		goto done;
 	}
 	if (!pPOT->Init( m_pmm, obPerfObTypes ))
 		goto done;
@@ -156,6 +188,7 @@ done:
 	if (szMappingName) PyWinObject_FreeTCHAR(szMappingName);
 	if (szServiceName) PyWinObject_FreeTCHAR(szServiceName);
 	if (szEventSourceName) PyWinObject_FreeTCHAR(szEventSourceName);
+	Py_XDECREF(obType);
 	if (ret==NULL) { // we have an error
 		if (m_pmm) delete m_pmm;
 		if (pPOT) delete pPOT;
@@ -280,7 +313,9 @@ BOOL PyPerfMonManager::Init( MappingManager *pmm, PyObject *obPerfObTypes)
 	ok = ok && PyWinObject_AsPyPERF_OBJECT_TYPE(obType, &pPerfOb, FALSE);
 	ok = ok && pPerfOb->InitMemoryLayout(pmm, this);
 	Py_DECREF(obType);
-	m_pmm = pmm;
+	// On failure, the caller still owns the mapping manager.
+	if (ok)
+		m_pmm = pmm;
 	m_obPerfObTypes = obPerfObTypes;
 	Py_INCREF(m_obPerfObTypes);
 	return ok;
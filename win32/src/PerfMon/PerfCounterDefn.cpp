@@ -27,64 +27,72 @@ BOOL PyWinObject_AsPyPERF_COUNTER_DEFINITION(PyObject *ob, PyPERF_COUNTER_DEFINI
 	return TRUE;
 }
 
-// @pymethod |PyPERF_COUNTER_DEFINITION|Increment|Increments the value of the performance counter
-PyObject *PyPERF_COUNTER_DEFINITION::Increment(PyObject *self, PyObject *args)
+// Shared by Increment, Decrement and Set.
+static PyObject *UpdateCounter(PyObject *self, PyObject *args, const char *fmt, LONGLONG sign, BOOL bSet)
 {
 	PyPERF_COUNTER_DEFINITION *This = (PyPERF_COUNTER_DEFINITION *)self;
-	int incrBy = 1;
-	if (!PyArg_ParseTuple(args, "|i:Increment", &incrBy))
+	LONGLONG val = 1;
+	PyObject *obInstance = Py_None;
+	if (!PyArg_ParseTuple(args, fmt, &val, &obInstance))
+		return NULL;
+	val *= sign;
+	if (!PyPerf_CheckCounterValue(This->GetCounterSize(), val))
+		return NULL;
+	void *pVal;
+	if (!This->GetCounterValue(obInstance, &pVal))
 		return NULL;
-
-	DWORD *pVal = (DWORD *)(This->m_pCounterValue);
 	if (pVal)
-		*pVal += incrBy;
+		PyPerf_UpdateCounter(pVal, This->GetCounterSize(), val, bSet);
 	Py_INCREF(Py_None);
 	return Py_None;
 }
 
+// @pymethod |PyPERF_COUNTER_DEFINITION|Increment|Increments the value of the performance counter
+PyObject *PyPERF_COUNTER_DEFINITION::Increment(PyObject *self, PyObject *args)
+{
+	// @pyparm long|incrBy|1|The amount to add to the counter.
+	// @pyparm int|instance|None|The id of the instance whose counter is incremented, as returned
+	// by <om PyPERF_OBJECT_TYPE.AddInstance>.  Must be None if the object type has no instances.
+	// @comm The counter is changed with an interlocked operation, so concurrent updates
+	// are never lost.
+	return UpdateCounter(self, args, "|LO:Increment", 1, FALSE);
+}
+
 // @pymethod |PyPERF_COUNTER_DEFINITION|Decrement|Decrements the value of the performance counter
 PyObject *PyPERF_COUNTER_DEFINITION::Decrement(PyObject *self, PyObject *args)
 {
-	PyPERF_COUNTER_DEFINITION *This = (PyPERF_COUNTER_DEFINITION *)self;
-	int incrBy = 1;
-	if (!PyArg_ParseTuple(args, "|i:Decrement", &incrBy))
-		return NULL;
-
-	DWORD *pVal = (DWORD *)(This->m_pCounterValue);
-	if (pVal)
-		*pVal -= incrBy;
-	Py_INCREF(Py_None);
-	return Py_None;
+	// @pyparm long|decrBy|1|The amount to subtract from the counter.
+	// @pyparm int|instance|None|The id of the instance whose counter is decremented.
+	return UpdateCounter(self, args, "|LO:Decrement", -1, FALSE);
 }
 
 // @pymethod |PyPERF_COUNTER_DEFINITION|Set|Sets the counter to a specific value
 PyObject *PyPERF_COUNTER_DEFINITION::Set(PyObject *self, PyObject *args)
 {
-	PyPERF_COUNTER_DEFINITION *This = (PyPERF_COUNTER_DEFINITION *)self;
-	int setTo;
-	if (!PyArg_ParseTuple(args, "i:Set", &setTo))
-		return NULL;
-
-	DWORD *pVal = (DWORD *)(This->m_pCounterValue);
-	if (pVal)
-		*pVal = setTo;
-	Py_INCREF(Py_None);
-	return Py_None;
+	// @pyparm long|value||The new value.
+	// @pyparm int|instance|None|The id of the instance whose counter is set.
+	return UpdateCounter(self, args, "L|O:Set", 1, TRUE);
 }
 
-// @pymethod |PyPERF_COUNTER_DEFINITION|Get|Gets the current value of the counter
+// @pymethod long|PyPERF_COUNTER_DEFINITION|Get|Gets the current value of the counter
 PyObject *PyPERF_COUNTER_DEFINITION::Get(PyObject *self, PyObject *args)
 {
 	PyPERF_COUNTER_DEFINITION *This = (PyPERF_COUNTER_DEFINITION *)self;
-	if (!PyArg_ParseTuple(args, ":Get"))
+	PyObject *obInstance = Py_None;
+	// @pyparm int|instance|None|The id of the instance whose counter is returned.
+	if (!PyArg_ParseTuple(args, "|O:Get", &obInstance))
 		return NULL;
-	if (!This->m_pCounterValue==NULL) {
+	void *pVal;
+	if (!This->GetCounterValue(obInstance, &pVal))
+		return NULL;
+	if (pVal==NULL) {
 		PyErr_SetString(PyExc_ValueError, "The counter does not exist in a counter block");
 		return NULL;
 	}
-
-	DWORD *pVal = (DWORD *)(This->m_pCounterValue);
-	return PyInt_FromLong(*pVal);
+	if (This->m_CounterSize==sizeof(LONGLONG))
+		return PyLong_FromLongLong(PyPerf_Load64(pVal));
+	// DWORD counters have always been returned signed.
+	return PyInt_FromLong((long)(int)PyPerf_Load32(pVal));
 }
 
 
@@ -93,6 +101,8 @@ PyObject *PyPERF_COUNTER_DEFINITION::Get(PyObject *self, PyObject *args)
 // if the counter does not appear in a block.  This is so the application can avoid
 // excessive tests for lack of performance monitor functionality.
 // However, the method <om PyPERF_COUNTER_DEFINITION.Get> will raise a ValueError exception in this case.
+// <nl>Counters whose CounterType has the PERF_SIZE_LARGE size (for example PERF_COUNTER_BULK_COUNT)
+// are 64 bits, all others are 32 bits.
 struct PyMethodDef PyPERF_COUNTER_DEFINITION::methods[] = {
 	{"Increment",      PyPERF_COUNTER_DEFINITION::Increment, 1}, 	// @pymeth Increment|Increments the value of the performance counter
 	{"Decrement",      PyPERF_COUNTER_DEFINITION::Decrement, 1}, 	// @pymeth Decrement|Decrements the value of the performance counter
@@ -167,7 +177,7 @@ PyPERF_COUNTER_DEFINITION::PyPERF_COUNTER_DEFINITION(DWORD counterNameTitleIndex
 	m_CounterHelpTitleIndex = counterNameTitleIndex;
 	m_CounterType = PERF_COUNTER_COUNTER;
 	m_CounterSize = sizeof(DWORD);
-	m_pCounterValue = NULL;
+	m_CounterOffset = 0;
 	m_obBufferOwner = NULL;
 }
 PyPERF_COUNTER_DEFINITION::~PyPERF_COUNTER_DEFINITION()
@@ -186,6 +196,7 @@ void PyPERF_COUNTER_DEFINITION::SetupBuffer()
 	m_pPCD->DefaultScale = m_DefaultScale;
 	m_pPCD->DetailLevel = m_DetailLevel;
 	m_pPCD->CounterType = m_CounterType;
+	m_CounterSize = GetCounterDataSize();
 	m_pPCD->CounterSize = m_CounterSize;
 	// CounterOffset is not known yet!
 }
@@ -198,13 +209,26 @@ void PyPERF_COUNTER_DEFINITION::AcceptBuffer( PyObject *obBufferOwner, void *pBu
 	m_pPCD = (PERF_COUNTER_DEFINITION *)pBuffer;
 }
 
-void PyPERF_COUNTER_DEFINITION::AcceptRawCounterBuffer( void *pBuffer, DWORD offset )
+void PyPERF_COUNTER_DEFINITION::AcceptCounterOffset( DWORD offset )
 {
 	if (m_pPCD==NULL) return;
 	m_pPCD->CounterOffset = offset;
-	m_pCounterValue = pBuffer;
-	// Initialise the buffer to zero.
-	memset( pBuffer, 0, m_CounterSize );
+	m_CounterOffset = offset;
+}
+
+// The value is found through the object type, so it is never used after the
+// mapping has been closed.
+BOOL PyPERF_COUNTER_DEFINITION::GetCounterValue(PyObject *obInstance, void **ppVal)
+{
+	*ppVal = NULL;
+	if (m_CounterOffset==0 || m_obBufferOwner==NULL)
+		return TRUE;
+	BYTE *pBlock;
+	if (!((PyPERF_OBJECT_TYPE *)m_obBufferOwner)->GetCounterBlock(obInstance, &pBlock))
+		return FALSE;
+	if (pBlock)
+		*ppVal = pBlock + m_CounterOffset;
+	return TRUE;
 }
 
 /*static*/ void PyPERF_COUNTER_DEFINITION::deallocFunc(PyObject *ob)
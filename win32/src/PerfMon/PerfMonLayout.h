@@ -0,0 +1,318 @@
+// PerfMonLayout.h - the layout of the performance data the perfmon module
+// shares with perfmondata.dll.
+//
+// The shared section holds a single object type.  It starts with the
+// PERF_OBJECT_TYPE and its PERF_COUNTER_DEFINITIONs, exactly as they are
+// returned to perflib.  An object without instances is followed by its
+// PERF_COUNTER_BLOCK.  An object with instances is instead followed by a
+// fixed number of instance slots - each a PERF_INSTANCE_DEFINITION, room for
+// the longest name allowed and a PERF_COUNTER_BLOCK - then an array with the
+// state of each slot.  The collector only copies the slots in use.
+//
+// Counter values are changed with atomic operations, and 64 bit values are
+// always 8 byte aligned, so perflib never sees a half written value (except
+// on 32 bit Windows, where the collector reads 64 bit values in two halves).
+// Slots are written and copied 8 bytes at a time with atomic operations too,
+// as the collector may copy a slot while it is being rewritten.
+//
+// The state of a slot is a generation number times 4, plus one of the
+// PYPERF_SLOT_ values.  Every change to a slot changes its state, so the
+// collector can tell when a slot was added, removed or reused while it was
+// being copied, and leave that instance out.
+//
+// Nothing here depends on Windows or Python, so the layout can be built and
+// tested on other platforms.
+
+#ifndef __PERFMONLAYOUT_H__
+#define __PERFMONLAYOUT_H__
+
+#include <string.h>
+
+// A UTF-16 code unit - the same size as a WCHAR.
+typedef unsigned short PyPerfUTF16;
+
+// The structures from winperf.h which are written here, with the same layout.
+struct PyPerfObjectType {
+	unsigned int TotalByteLength;
+	unsigned int DefinitionLength;
+	unsigned int HeaderLength;
+	unsigned int ObjectNameTitleIndex;
+	unsigned int ObjectNameTitle;
+	unsigned int ObjectHelpTitleIndex;
+	unsigned int ObjectHelpTitle;
+	unsigned int DetailLevel;
+	unsigned int NumCounters;
+	int DefaultCounter;
+	int NumInstances;
+	unsigned int CodePage;
+	long long PerfTime;
+	long long PerfFreq;
+};
+
+struct PyPerfInstanceDefinition {
+	unsigned int ByteLength;
+	unsigned int ParentObjectTitleIndex;
+	unsigned int ParentObjectInstance;
+	int UniqueID;
+	unsigned int NameOffset;
+	unsigned int NameLength;
+};
+
+#define PYPERF_OBJECT_TYPE_SIZE 64
+#define PYPERF_COUNTER_DEFINITION_SIZE 40
+#define PYPERF_INSTANCE_DEFINITION_SIZE 24
+#define PYPERF_COUNTER_BLOCK_SIZE 4
+#define PYPERF_NO_INSTANCES (-1)
+#define PYPERF_NO_UNIQUE_ID (-1)
+
+#define PYPERF_SLOT_FREE 0
+#define PYPERF_SLOT_WRITING 1
+#define PYPERF_SLOT_IN_USE 2
+#define PYPERF_SLOT_MASK 3
+
+// Instance ids are the slot number, and the generation of the slot when the
+// instance was added, so an id is never valid for a later instance.
+#define PYPERF_MAX_INSTANCES 0xFFFF
+#define PYPERF_INSTANCE_ID(slot, state) ((((unsigned long long)(state)) >> 2 << 16) | (slot))
+#define PYPERF_INSTANCE_SLOT(id) ((unsigned int)((id) & 0xFFFF))
+
+#define PYPERF_ALIGN(x, n) (((x) + (n) - 1) & ~((n) - 1))
+
+#if defined(_MSC_VER)
+// windows.h has already been included.
+#define PyPerf_Add32(p, v) InterlockedExchangeAdd((volatile LONG *)(p), (LONG)(v))
+#define PyPerf_Add64(p, v) InterlockedExchangeAdd64((volatile LONGLONG *)(p), (LONGLONG)(v))
+#define PyPerf_Store32(p, v) InterlockedExchange((volatile LONG *)(p), (LONG)(v))
+#define PyPerf_Store64(p, v) InterlockedExchange64((volatile LONGLONG *)(p), (LONGLONG)(v))
+#define PyPerf_StoreRelease64(p, v) PyPerf_Store64(p, v)
+#define PyPerf_CompareExchange32(p, old, v) \
+	((unsigned int)InterlockedCompareExchange((volatile LONG *)(p), (LONG)(v), (LONG)(old)) == (unsigned int)(old))
+#define PyPerf_Load32(p) (*(volatile unsigned int *)(p))
+#define PyPerf_Load64(p) (*(volatile long long *)(p))
+#define PyPerf_Fence() MemoryBarrier()
+#else
+#define PyPerf_Add32(p, v) __atomic_fetch_add((unsigned int *)(p), (unsigned int)(v), __ATOMIC_SEQ_CST)
+#define PyPerf_Add64(p, v) __atomic_fetch_add((long long *)(p), (long long)(v), __ATOMIC_SEQ_CST)
+#define PyPerf_Store32(p, v) __atomic_store_n((unsigned int *)(p), (unsigned int)(v), __ATOMIC_SEQ_CST)
+#define PyPerf_Store64(p, v) __atomic_store_n((long long *)(p), (long long)(v), __ATOMIC_SEQ_CST)
+#define PyPerf_StoreRelease64(p, v) __atomic_store_n((long long *)(p), (long long)(v), __ATOMIC_RELEASE)
+static inline int PyPerf_CompareExchange32(unsigned int *p, unsigned int old, unsigned int v)
+{
+	return __atomic_compare_exchange_n(p, &old, v, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#define PyPerf_Load32(p) __atomic_load_n((unsigned int *)(p), __ATOMIC_ACQUIRE)
+#define PyPerf_Load64(p) __atomic_load_n((long long *)(p), __ATOMIC_ACQUIRE)
+// Loads are acquires, so nothing needs to be added to keep a later load
+// after them.
+#define PyPerf_Fence() ((void)0)
+#endif
+
+// Where everything is, as offsets from the start of the object type.  A
+// copy is kept in the shared section for the collector.
+struct PyPerfLayout {
+	unsigned int numCounters;
+	unsigned int maxInstances;		// 0 for an object without instances
+	unsigned int maxNameChars;		// not counting the terminator
+	unsigned int definitionLength;	// the object type and counter definitions
+	unsigned int blockSize;			// a counter block, including its header
+	unsigned int instanceDefLength;	// an instance definition and its name
+	unsigned int slotSize;			// an instance definition, name and counter block
+	unsigned int blockOffset;		// the counter block, or the first slot
+	unsigned int statesOffset;		// the slot states
+	unsigned int totalSize;
+};
+
+// Lays out an object with counters of the given sizes (4 or 8 bytes),
+// filling in the offset of each counter in its counter block.  Returns 0 if
+// the object would be too large.
+static int PyPerfLayout_Init(PyPerfLayout *layout, const unsigned int *counterSizes, unsigned int numCounters,
+	unsigned int *counterOffsets, unsigned int maxInstances, unsigned int maxNameChars)
+{
+	const unsigned long long limit = 0x7FFFFFFF;
+	if (maxInstances > PYPERF_MAX_INSTANCES || maxNameChars > 0xFFFF ||
+	    numCounters > (limit - PYPERF_OBJECT_TYPE_SIZE) / PYPERF_COUNTER_DEFINITION_SIZE)
+		return 0;
+	memset(layout, 0, sizeof(*layout));
+	layout->numCounters = numCounters;
+	layout->maxInstances = maxInstances;
+	layout->maxNameChars = maxNameChars;
+	layout->definitionLength = PYPERF_OBJECT_TYPE_SIZE + numCounters * PYPERF_COUNTER_DEFINITION_SIZE;
+	// Each value is aligned on its own size, and the block (which always
+	// starts 8 byte aligned) is a multiple of 8 bytes.
+	unsigned long long offset = PYPERF_COUNTER_BLOCK_SIZE;
+	for (unsigned int i = 0; i < numCounters; i++) {
+		unsigned int size = counterSizes[i];
+		if (size != 4 && size != 8)
+			return 0;
+		offset = PYPERF_ALIGN(offset, size);
+		counterOffsets[i] = (unsigned int)offset;
+		offset += size;
+		if (offset > limit)
+			return 0;
+	}
+	layout->blockSize = (unsigned int)PYPERF_ALIGN(offset, 8);
+	layout->blockOffset = layout->definitionLength;
+	unsigned long long total;
+	if (maxInstances == 0) {
+		total = (unsigned long long)layout->definitionLength + layout->blockSize;
+		layout->statesOffset = (unsigned int)total;
+	} else {
+		layout->instanceDefLength = (unsigned int)PYPERF_ALIGN(
+			PYPERF_INSTANCE_DEFINITION_SIZE + (maxNameChars + 1) * sizeof(PyPerfUTF16), 8);
+		layout->slotSize = layout->instanceDefLength + layout->blockSize;
+		total = layout->definitionLength + (unsigned long long)maxInstances * layout->slotSize;
+		if (total > limit)
+			return 0;
+		layout->statesOffset = (unsigned int)total;
+		total = PYPERF_ALIGN(total + maxInstances * sizeof(unsigned int), 8);
+	}
+	if (total > limit)
+		return 0;
+	layout->totalSize = (unsigned int)total;
+	return 1;
+}
+
+static unsigned int *PyPerfLayout_States(const PyPerfLayout *layout, void *base)
+{
+	return (unsigned int *)((unsigned char *)base + layout->statesOffset);
+}
+
+static unsigned char *PyPerfLayout_Slot(const PyPerfLayout *layout, void *base, unsigned int slot)
+{
+	return (unsigned char *)base + layout->blockOffset + slot * layout->slotSize;
+}
+
+// Returns the counter block of an object without instances, or of the
+// instance with the given id.  Returns NULL if the id is not valid.
+// Nothing stops the instance being removed, and its slot reused, once the
+// block is returned - so callers must not remove an instance while its
+// counters may be being updated, or an update can land in the counters of
+// the slot's next instance.  (The perfmon module holds the GIL from looking
+// up a block until it has updated it.)
+static unsigned char *PyPerfLayout_CounterBlock(const PyPerfLayout *layout, void *base, unsigned long long id)
+{
+	if (layout->maxInstances == 0)
+		return (unsigned char *)base + layout->blockOffset;
+	unsigned int slot = PYPERF_INSTANCE_SLOT(id);
+	if (slot >= layout->maxInstances)
+		return NULL;
+	unsigned int state = PyPerf_Load32(PyPerfLayout_States(layout, base) + slot);
+	if ((state & PYPERF_SLOT_MASK) != PYPERF_SLOT_IN_USE || PYPERF_INSTANCE_ID(slot, state) != id)
+		return NULL;
+	return PyPerfLayout_Slot(layout, base, slot) + layout->instanceDefLength;
+}
+
+// Writes len bytes (a multiple of 8) 8 bytes at a time - the srcLen bytes
+// at src, then zeros.  These are release stores, so a collector which reads
+// any of them also sees the change to the slot's state made before them.
+static void PyPerfLayout_Store(unsigned char *dest, unsigned int len, const void *src, unsigned int srcLen)
+{
+	for (unsigned int i = 0; i < len; i += 8) {
+		long long value = 0;
+		if (i < srcLen)
+			memcpy(&value, (const unsigned char *)src + i, srcLen - i < 8 ? srcLen - i : 8);
+		PyPerf_StoreRelease64(dest + i, value);
+	}
+}
+
+// Writes an empty counter block.
+static void PyPerfLayout_InitBlock(const PyPerfLayout *layout, unsigned char *block)
+{
+	unsigned int byteLength = layout->blockSize;
+	PyPerfLayout_Store(block, layout->blockSize, &byteLength, sizeof(byteLength));
+}
+
+// Adds an instance with zeroed counters.  Returns 0 if there is no free slot
+// (or the name is too long), otherwise 1 with the instance's id in *pid.
+static int PyPerfLayout_AddInstance(const PyPerfLayout *layout, void *base, const PyPerfUTF16 *name,
+	unsigned int nameLen, int uniqueID, unsigned long long *pid)
+{
+	if (nameLen > layout->maxNameChars)
+		return 0;
+	unsigned int *states = PyPerfLayout_States(layout, base);
+	for (unsigned int slot = 0; slot < layout->maxInstances; slot++) {
+		unsigned int state = PyPerf_Load32(states + slot);
+		if ((state & PYPERF_SLOT_MASK) != PYPERF_SLOT_FREE ||
+		    !PyPerf_CompareExchange32(states + slot, state, state | PYPERF_SLOT_WRITING))
+			continue;
+		unsigned char *p = PyPerfLayout_Slot(layout, base, slot);
+		PyPerfInstanceDefinition def;
+		memset(&def, 0, sizeof(def));
+		def.ByteLength = layout->instanceDefLength;
+		def.UniqueID = uniqueID;
+		def.NameOffset = PYPERF_INSTANCE_DEFINITION_SIZE;
+		def.NameLength = (nameLen + 1) * sizeof(PyPerfUTF16);
+		PyPerfLayout_Store(p, PYPERF_INSTANCE_DEFINITION_SIZE, &def, sizeof(def));
+		// The rest of the room for the name is zeroed, which terminates it.
+		PyPerfLayout_Store(p + PYPERF_INSTANCE_DEFINITION_SIZE, layout->instanceDefLength - PYPERF_INSTANCE_DEFINITION_SIZE,
+			name, nameLen * sizeof(PyPerfUTF16));
+		PyPerfLayout_InitBlock(layout, p + layout->instanceDefLength);
+		// The next generation, in use.
+		state = (state & ~PYPERF_SLOT_MASK) + 4 + PYPERF_SLOT_IN_USE;
+		PyPerf_Store32(states + slot, state);
+		*pid = PYPERF_INSTANCE_ID(slot, state);
+		return 1;
+	}
+	return 0;
+}
+
+// Removes an instance.  Returns 0 if the id is not valid.
+static int PyPerfLayout_RemoveInstance(const PyPerfLayout *layout, void *base, unsigned long long id)
+{
+	if (layout->maxInstances == 0 || PyPerfLayout_CounterBlock(layout, base, id) == NULL)
+		return 0;
+	unsigned int slot = PYPERF_INSTANCE_SLOT(id);
+	unsigned int *states = PyPerfLayout_States(layout, base);
+	unsigned int state = PyPerf_Load32(states + slot);
+	return PyPerf_CompareExchange32(states + slot, state, (state & ~PYPERF_SLOT_MASK) + 4 + PYPERF_SLOT_FREE);
+}
+
+// Copies len bytes (a multiple of 8) of a counter block or slot 8 bytes at
+// a time, so no value is torn.
+static void PyPerfLayout_Copy(unsigned char *dest, const unsigned char *src, unsigned int len)
+{
+	for (unsigned int i = 0; i < len; i += 8)
+		*(long long *)(dest + i) = PyPerf_Load64(src + i);
+}
+
+// Copies the object, with the instances currently in use, into a buffer
+// for perflib.  Returns the number of bytes written, or 0 if the buffer
+// might be too small - *pneeded is set to the size needed.
+static unsigned int PyPerfLayout_Collect(const PyPerfLayout *layout, const void *base, void *dest,
+	unsigned int destSize, unsigned int *pneeded)
+{
+	const unsigned char *src = (const unsigned char *)base;
+	unsigned char *out = (unsigned char *)dest;
+	unsigned int needed = layout->maxInstances ? layout->statesOffset : layout->totalSize;
+	*pneeded = needed;
+	if (destSize < needed)
+		return 0;
+	memcpy(out, src, layout->definitionLength);
+	unsigned int size = layout->definitionLength;
+	int numInstances = PYPERF_NO_INSTANCES;
+	if (layout->maxInstances == 0) {
+		PyPerfLayout_Copy(out + size, src + layout->blockOffset, layout->blockSize);
+		size += layout->blockSize;
+	} else {
+		const unsigned int *states = (const unsigned int *)(src + layout->statesOffset);
+		numInstances = 0;
+		for (unsigned int slot = 0; slot < layout->maxInstances; slot++) {
+			unsigned int state = PyPerf_Load32(states + slot);
+			if ((state & PYPERF_SLOT_MASK) != PYPERF_SLOT_IN_USE)
+				continue;
+			const unsigned char *p = src + layout->blockOffset + slot * layout->slotSize;
+			PyPerfLayout_Copy(out + size, p, layout->slotSize);
+			PyPerf_Fence();
+			if (PyPerf_Load32(states + slot) != state)
+				continue;	// changed while it was copied - leave it out.
+			size += layout->slotSize;
+			numInstances++;
+		}
+	}
+	PyPerfObjectType *pot = (PyPerfObjectType *)out;
+	pot->TotalByteLength = size;
+	pot->NumInstances = numInstances;
+	return size;
+}
+
+#endif // __PERFMONLAYOUT_H__
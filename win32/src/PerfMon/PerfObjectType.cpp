@@ -25,16 +25,25 @@ BOOL PyWinObject_AsPyPERF_OBJECT_TYPE(PyObject *ob, PyPERF_OBJECT_TYPE **ppPyPER
 PyObject *PerfmonMethod_NewPERF_OBJECT_TYPE(PyObject *self, PyObject *args)
 {
 	PyObject *obCounters;
+	DWORD maxInstances = 0;
+	DWORD maxNameChars = 63;
 
-	if (!PyArg_ParseTuple(args, "O:ObjectType", &obCounters))
+	if (!PyArg_ParseTuple(args, "O|kk:ObjectType",
+			&obCounters, // @pyparm [<o PyPERF_COUNTER_DEFINITION>, ...]|counters||The counters of the object.
+			&maxInstances, // @pyparm int|MaxInstances|0|The most instances the object can have at once.  If 0,
+				// the object has no instances, and a single value for each counter.
+			&maxNameChars)) // @pyparm int|MaxInstanceNameLength|63|The longest instance name allowed, in characters.
 		return NULL;
+	// @comm Instances are added and removed with <om PyPERF_OBJECT_TYPE.AddInstance> and
+	// <om PyPERF_OBJECT_TYPE.RemoveInstance> once the object is in a <o PyPerfMonManager>.
+	// Room for MaxInstances instances is reserved in the shared memory up front.
 
 	PyPERF_OBJECT_TYPE *pPOT = new(PyPERF_OBJECT_TYPE);
 	if (pPOT==NULL) {
 		PyErr_SetString(PyExc_MemoryError, "Allocating MappingManager or PERF_OBJECT_TYPE");
 		return NULL;
 	}
-	if (!pPOT->InitPythonObjects( obCounters )) {
+	if (!pPOT->InitPythonObjects( obCounters, maxInstances, maxNameChars )) {
 		delete pPOT;
 		return NULL;
 	}
@@ -52,9 +61,171 @@ PyObject *PyPERF_OBJECT_TYPE::Close(PyObject *self, PyObject *args)
 	return Py_None;
 }
 
+// Returns the object in a mapping, or NULL with a ValueError if it is not in one.
+static PyPERF_OBJECT_TYPE *CheckMapped(PyObject *self)
+{
+	PyPERF_OBJECT_TYPE *This = (PyPERF_OBJECT_TYPE *)self;
+	if (This->GetPCD()==NULL) {
+		PyErr_SetString(PyExc_ValueError, "The object type is not in a performance monitor manager");
+		return NULL;
+	}
+	return This;
+}
+
+static BOOL AsInstanceId(PyObject *ob, ULONGLONG *pid)
+{
+	ULARGE_INTEGER id;
+	if (!PyWinObject_AsULARGE_INTEGER(ob, &id))
+		return FALSE;
+	*pid = id.QuadPart;
+	return TRUE;
+}
+
+// @pymethod int|PyPERF_OBJECT_TYPE|AddInstance|Adds an instance of the object, with all its counters zero.
+PyObject *PyPERF_OBJECT_TYPE::AddInstance(PyObject *self, PyObject *args)
+{
+	PyObject *obName;
+	// @pyparm <o PyUnicode>|name||The name of the instance.
+	if (!PyArg_ParseTuple(args, "O:AddInstance", &obName))
+		return NULL;
+	PyPERF_OBJECT_TYPE *This = CheckMapped(self);
+	if (This==NULL)
+		return NULL;
+	if (This->m_layout.maxInstances==0) {
+		PyErr_SetString(PyExc_ValueError, "The object type was created without instances");
+		return NULL;
+	}
+	WCHAR *szName;
+	DWORD nameLen;
+	if (!PyWinObject_AsWCHAR(obName, &szName, FALSE, &nameLen))
+		return NULL;
+	ULONGLONG id;
+	BOOL ok = FALSE;
+	if (nameLen > This->m_layout.maxNameChars)
+		PyErr_Format(PyExc_ValueError, "The instance name can be at most %d characters", This->m_layout.maxNameChars);
+	else if (!PyPerfLayout_AddInstance(&This->m_layout, This->m_pPOT, (const PyPerfUTF16 *)szName, nameLen, PYPERF_NO_UNIQUE_ID, &id))
+		PyErr_Format(PyExc_RuntimeError, "All %d instances of the object type are in use", This->m_layout.maxInstances);
+	else
+		ok = TRUE;
+	PyWinObject_FreeWCHAR(szName);
+	if (!ok)
+		return NULL;
+	// @rdesc The id of the instance, which is passed to the counter methods.  Ids are not reused
+	// when an instance is removed and another added.
+	return PyLong_FromUnsignedLongLong(id);
+}
+
+// @pymethod |PyPERF_OBJECT_TYPE|RemoveInstance|Removes an instance of the object.
+PyObject *PyPERF_OBJECT_TYPE::RemoveInstance(PyObject *self, PyObject *args)
+{
+	PyObject *obInstance;
+	ULONGLONG id;
+	// @pyparm int|instance||The id of the instance, as returned by <om PyPERF_OBJECT_TYPE.AddInstance>.
+	if (!PyArg_ParseTuple(args, "O:RemoveInstance", &obInstance))
+		return NULL;
+	if (!AsInstanceId(obInstance, &id))
+		return NULL;
+	PyPERF_OBJECT_TYPE *This = CheckMapped(self);
+	if (This==NULL)
+		return NULL;
+	if (!PyPerfLayout_RemoveInstance(&This->m_layout, This->m_pPOT, id)) {
+		PyErr_SetString(PyExc_ValueError, "The instance does not exist");
+		return NULL;
+	}
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+struct CounterUpdate {
+	DWORD offset;
+	DWORD size;
+	LONGLONG val;
+};
+
+// @pymethod |PyPERF_OBJECT_TYPE|UpdateCounters|Updates many counters of the object at once.
+PyObject *PyPERF_OBJECT_TYPE::UpdateCounters(PyObject *self, PyObject *args)
+{
+	PyPERF_OBJECT_TYPE *This = (PyPERF_OBJECT_TYPE *)self;
+	PyObject *obUpdates, *obInstance = Py_None;
+	BOOL bSet = FALSE;
+	if (!PyArg_ParseTuple(args, "O|Oi:UpdateCounters",
+			&obUpdates, // @pyparm [(counter, long), ...]|updates||The counters to change, and by how much.  Each
+				// counter is either a <o PyPERF_COUNTER_DEFINITION> of this object, or its index in the
+				// counters the object was created with.
+			&obInstance, // @pyparm int|instance|None|The id of the instance whose counters are changed.
+			&bSet)) // @pyparm bool|set|False|If True, the counters are set to the values, rather
+				// than the values being added to them.
+		return NULL;
+	// @comm Like the counter methods, this silently does nothing if the object is not
+	// in a <o PyPerfMonManager>.  Every update is checked before any counter is changed.
+	if (This->m_pPOT==NULL) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+	PyObject *obSeq = PySequence_Fast(obUpdates, "Updates must be a sequence of (counter, value) tuples");
+	if (obSeq==NULL)
+		return NULL;
+	PyObject *ret = NULL;
+	Py_ssize_t num = PySequence_Fast_GET_SIZE(obSeq);
+	CounterUpdate *updates = (CounterUpdate *)malloc((num ? num : 1) * sizeof(CounterUpdate));
+	if (updates==NULL) {
+		PyErr_NoMemory();
+		goto done;
+	}
+	for (Py_ssize_t i = 0; i < num; i++) {
+		PyObject *obUpdate = PySequence_Fast_GET_ITEM(obSeq, i);
+		PyObject *obCounter;
+		if (!PyTuple_Check(obUpdate)) {
+			PyErr_SetString(PyExc_TypeError, "Updates must be a sequence of (counter, value) tuples");
+			goto done;
+		}
+		if (!PyArg_ParseTuple(obUpdate, "OL:UpdateCounters", &obCounter, &updates[i].val))
+			goto done;
+		if (PyPERF_COUNTER_DEFINITION_Check(obCounter)) {
+			PyPERF_COUNTER_DEFINITION *pCounter = (PyPERF_COUNTER_DEFINITION *)obCounter;
+			if (pCounter->GetOwner()!=This || pCounter->GetCounterOffset()==0) {
+				PyErr_SetString(PyExc_ValueError, "The counter does not belong to this object type");
+				goto done;
+			}
+			updates[i].offset = pCounter->GetCounterOffset();
+			updates[i].size = pCounter->GetCounterSize();
+		} else {
+			long index = PyInt_AsLong(obCounter);
+			if (index==-1 && PyErr_Occurred())
+				goto done;
+			if (index < 0 || (DWORD)index >= This->m_layout.numCounters) {
+				PyErr_Format(PyExc_IndexError, "The object type has no counter %ld", index);
+				goto done;
+			}
+			updates[i].offset = This->m_pCounterOffsets[index];
+			updates[i].size = This->m_pCounterSizes[index];
+		}
+		if (!PyPerf_CheckCounterValue(updates[i].size, updates[i].val))
+			goto done;
+	}
+	// Only now, as converting the values may have run Python code.
+	BYTE *pBlock;
+	if (!This->GetCounterBlock(obInstance, &pBlock))
+		goto done;
+	if (pBlock) {
+		for (Py_ssize_t i = 0; i < num; i++)
+			PyPerf_UpdateCounter(pBlock + updates[i].offset, updates[i].size, updates[i].val, bSet);
+	}
+	Py_INCREF(Py_None);
+	ret = Py_None;
+done:
+	if (updates)
+		free(updates);
+	Py_DECREF(obSeq);
+	return ret;
+}
+
 // @object PyPERF_OBJECT_TYPE|A Python object, representing a PERF_OBJECT_TYPE structure
 struct PyMethodDef PyPERF_OBJECT_TYPE::methods[] = {
 	{"Close",          PyPERF_OBJECT_TYPE::Close, 1}, // @pymeth Close|Closes all counters.
+	{"AddInstance",    PyPERF_OBJECT_TYPE::AddInstance, 1}, // @pymeth AddInstance|Adds an instance of the object.
+	{"RemoveInstance", PyPERF_OBJECT_TYPE::RemoveInstance, 1}, // @pymeth RemoveInstance|Removes an instance of the object.
+	{"UpdateCounters", PyPERF_OBJECT_TYPE::UpdateCounters, 1}, // @pymeth UpdateCounters|Updates many counters of the object at once.
 	{NULL}
 };
 
@@ -108,6 +279,8 @@ PyTypeObject PyPERF_OBJECT_TYPE::type =
 	{"ObjectNameTitleIndex",  T_LONG,  OFF(m_ObjectNameTitleIndex)}, // @prop integer|ObjectNameTitleIndex|
 	{"ObjectHelpTitleIndex",  T_LONG,  OFF(m_ObjectHelpTitleIndex)}, // @prop integer|ObjectHelpTitleIndex|
 	{"DefaultCounterIndex",        T_LONG,  OFF(m_DefaultCounter)}, // @prop integer|DefaultCounterIndex|
+	{"MaxInstances",  T_ULONG,  OFF(m_MaxInstances), READONLY}, // @prop integer|MaxInstances|The most instances the object can have, or 0 if it has no instances.
+	{"MaxInstanceNameLength",  T_ULONG,  OFF(m_MaxInstanceNameLength), READONLY}, // @prop integer|MaxInstanceNameLength|The longest instance name allowed.
 	{NULL}
 };
 
@@ -121,11 +294,18 @@ PyPERF_OBJECT_TYPE::PyPERF_OBJECT_TYPE(void)
 	m_ObjectNameTitleIndex = 0;
 	m_ObjectHelpTitleIndex = 0;
 	m_DefaultCounter = 0;
+	m_MaxInstances = 0;
+	m_MaxInstanceNameLength = 0;
+	memset(&m_layout, 0, sizeof(m_layout));
+	m_pCounterOffsets = NULL;
+	m_pCounterSizes = NULL;
 }
 
 PyPERF_OBJECT_TYPE::~PyPERF_OBJECT_TYPE()
 {
 	Term();
+	free(m_pCounterOffsets);
+	free(m_pCounterSizes);
 }
 
 void PyPERF_OBJECT_TYPE::Term()
@@ -138,104 +318,142 @@ void PyPERF_OBJECT_TYPE::Term()
 }
 
 // Get the counter objects that Im gunna use.
-BOOL PyPERF_OBJECT_TYPE::InitPythonObjects( PyObject *obCounters )
+BOOL PyPERF_OBJECT_TYPE::InitPythonObjects( PyObject *obCounters, DWORD maxInstances, DWORD maxNameChars )
 {
-	m_obCounters = obCounters;
-	Py_XINCREF(obCounters);
+	if (maxInstances > PYPERF_MAX_INSTANCES) {
+		PyErr_Format(PyExc_ValueError, "An object type can have at most %d instances", PYPERF_MAX_INSTANCES);
+		return FALSE;
+	}
+	if (maxNameChars > 0xFFFF) {
+		PyErr_SetString(PyExc_ValueError, "MaxInstanceNameLength is too large");
+		return FALSE;
+	}
+	// A tuple, so the counters can't change between laying them out and
+	// allocating them.
+	m_obCounters = PySequence_Tuple(obCounters);
+	if (m_obCounters==NULL)
+		return FALSE;
+	m_MaxInstances = maxInstances;
+	m_MaxInstanceNameLength = maxNameChars;
+	return TRUE;
+}
+
+// Work out where everything goes, so the mapping can be created with the
+// right size.
+BOOL PyPERF_OBJECT_TYPE::InitLayout()
+{
+	if (m_obCounters==NULL) {
+		PyErr_SetString(PyExc_RuntimeError, "The object has not been initialised with any counters!");
+		return FALSE;
+	}
+	DWORD numCounters = (DWORD)PyTuple_GET_SIZE(m_obCounters);
+	free(m_pCounterOffsets);
+	free(m_pCounterSizes);
+	m_pCounterOffsets = (DWORD *)malloc((numCounters+1) * sizeof(DWORD));
+	m_pCounterSizes = (DWORD *)malloc((numCounters+1) * sizeof(DWORD));
+	if (m_pCounterOffsets==NULL || m_pCounterSizes==NULL) {
+		PyErr_NoMemory();
+		return FALSE;
+	}
+	for (DWORD i = 0;i<numCounters;i++) {
+		PyPERF_COUNTER_DEFINITION *pCounter;
+		if (!PyWinObject_AsPyPERF_COUNTER_DEFINITION(PyTuple_GET_ITEM(m_obCounters, i), &pCounter, FALSE))
+			return FALSE;
+		m_pCounterSizes[i] = pCounter->GetCounterDataSize();
+	}
+	if (!PyPerfLayout_Init(&m_layout, (const unsigned int *)m_pCounterSizes, numCounters,
+			(unsigned int *)m_pCounterOffsets, m_MaxInstances, m_MaxInstanceNameLength)) {
+		PyErr_SetString(PyExc_ValueError, "The object type is too large");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+BOOL PyPERF_OBJECT_TYPE::GetCounterBlock(PyObject *obInstance, BYTE **ppBlock)
+{
+	*ppBlock = NULL;
+	if (m_pPOT==NULL)
+		return TRUE;
+	if (m_layout.maxInstances==0) {
+		if (obInstance!=Py_None) {
+			PyErr_SetString(PyExc_ValueError, "The object type was created without instances");
+			return FALSE;
+		}
+		*ppBlock = (BYTE *)m_pPOT + m_layout.blockOffset;
+		return TRUE;
+	}
+	if (obInstance==Py_None) {
+		PyErr_SetString(PyExc_ValueError, "The object type has instances, so an instance must be given");
+		return FALSE;
+	}
+	ULONGLONG id;
+	if (!AsInstanceId(obInstance, &id))
+		return FALSE;
+	*ppBlock = PyPerfLayout_CounterBlock(&m_layout, m_pPOT, id);
+	if (*ppBlock==NULL) {
+		PyErr_SetString(PyExc_ValueError, "The instance does not exist");
+		return FALSE;
+	}
 	return TRUE;
 }
 
 // Init the memory layout of the win32 perfmon structures from the mapping manager.
+// InitLayout must have been called first.
 // Doesnt keep a reference to the mapping manager, but assumes it will stay alive
 // until Im term'd!
 // Also _removes_ the reference to the counters' and _adds_ a reference to
 // the PyPerMonManager object
 BOOL PyPERF_OBJECT_TYPE::InitMemoryLayout( MappingManager *pmm, PyPerfMonManager *obPerfMonManager)
 {
-	BOOL ok = FALSE;
-	PyObject *obCounter = NULL;
-	void *pBuffer;
+	BYTE *pData;
 	PyPERF_COUNTER_DEFINITION *pCounter;
-	DWORD thisCounterSize;
-	DWORD totalCounterSize;
-	DWORD counterOffset;
 	ULONG minDetail;
 	DWORD numCounters;
 	DWORD counterNum;
-	PERF_COUNTER_BLOCK *pPCB;
 	PyObject *obCounters = m_obCounters;
 
 	if (obCounters==NULL) {
 		PyErr_SetString(PyExc_RuntimeError, "The object has not been initialised with any counters!");
 		return FALSE;
 	}
+	numCounters = (DWORD)PyTuple_GET_SIZE(obCounters);
+	if (m_pCounterOffsets==NULL || m_layout.numCounters!=numCounters) {
+		PyErr_SetString(PyExc_RuntimeError, "The object has not been laid out!");
+		return FALSE;
+	}
+
+	// Allocate the PERF_OBJECT_TYPE, the counter definitions and the counter
+	// data in one go - see PerfMonLayout.h
+	pData = (BYTE *)pmm->AllocChunk(m_layout.totalSize);
+	if (pData==NULL)
+		return FALSE;
+	// The mapping may have been left behind by an earlier process.
+	memset(pData, 0, m_layout.totalSize);
 
 	m_obPerfMonManager = obPerfMonManager;
 	Py_INCREF(m_obPerfMonManager);
+	m_pPOT = (PERF_OBJECT_TYPE *)pData;
 
-	// First allocate the PERF_OBJECT_TYPE structure.
-	m_pPOT = (PERF_OBJECT_TYPE *)pmm->AllocChunk(sizeof(PERF_OBJECT_TYPE));
-	if (m_pPOT==NULL)
-		goto done;
-
-	numCounters = (DWORD)PySequence_Length(obCounters);
 	minDetail = (ULONG) -1;
 	for (counterNum = 0;counterNum<numCounters;counterNum++) {
-		// Cleanup from last time round the loop (done: cleans last loop!)
-		if (obCounter) {
-			Py_DECREF(obCounter);
-			obCounter = NULL;
-		}
-		obCounter = PySequence_GetItem(obCounters, counterNum);
-		if (obCounter==NULL)
-			goto done;
-
-		if (!PyWinObject_AsPyPERF_COUNTER_DEFINITION(obCounter, &pCounter, FALSE))
-			goto done;
+		// Checked by InitLayout.
+		pCounter = (PyPERF_COUNTER_DEFINITION *)PyTuple_GET_ITEM(obCounters, counterNum);
 		if ((ULONG)pCounter->GetDetailLevel() < minDetail) {
 			minDetail = pCounter->GetDetailLevel();
 		}
-		// Allocate memory for the counter object.
-		pBuffer = pmm->AllocChunk(sizeof(PERF_COUNTER_DEFINITION));
-		if (pBuffer==NULL)
-			goto done;
-		pCounter->AcceptBuffer(this, pBuffer);
+		pCounter->AcceptBuffer(this, pData + sizeof(PERF_OBJECT_TYPE) + counterNum * sizeof(PERF_COUNTER_DEFINITION));
 		pCounter->SetupBuffer();
+		pCounter->AcceptCounterOffset(m_pCounterOffsets[counterNum]);
 	}
-	// Now loop allocating the actual buffer for the raw counter data.
-	counterOffset = sizeof(DWORD);
-	totalCounterSize = sizeof(DWORD);
-	// Allocate 2 bytes which forms the header of the PERF_COUNTER_BLOCK
-	// structure.  Then each counter has its slot allocated.
-	pPCB = (PERF_COUNTER_BLOCK *)pmm->AllocChunk(sizeof(DWORD));
-	for (counterNum = 0;counterNum<numCounters;counterNum++) {
-		// Cleanup from last time round the loop (done: cleans last loop!)
-		if (obCounter) {
-			Py_DECREF(obCounter);
-			obCounter = NULL;
-		}
-		obCounter = PySequence_GetItem(obCounters, counterNum);
-		if (obCounter==NULL)
-			goto done;
+	// An object without instances has a single counter block.  The counter
+	// blocks of instances are written as they are added.
+	if (m_layout.maxInstances==0)
+		PyPerfLayout_InitBlock(&m_layout, pData + m_layout.blockOffset);
 
-		if (!PyWinObject_AsPyPERF_COUNTER_DEFINITION(obCounter, &pCounter, FALSE))
-			goto done;
-		// Allocate memory for the raw counter data object.
-		thisCounterSize = pCounter->GetCounterDataSize();
-		totalCounterSize += thisCounterSize;
-		pBuffer = pmm->AllocChunk(thisCounterSize);
-		if (pCounter==NULL)
-			goto done;
-		pCounter->AcceptRawCounterBuffer(pBuffer, counterOffset);
-		counterOffset += thisCounterSize;
-	}
-	pPCB->ByteLength = totalCounterSize;
-	// Now back-fill the PERF_OBJECT_TYPE buffer.
-	m_pPOT->TotalByteLength = sizeof(PERF_OBJECT_TYPE) + 
-							  (numCounters * sizeof(PERF_COUNTER_DEFINITION)) + 
-							  totalCounterSize;
-	m_pPOT->DefinitionLength = sizeof(PERF_OBJECT_TYPE) + 
-							  (numCounters * sizeof(PERF_COUNTER_DEFINITION));
+	// Now fill the PERF_OBJECT_TYPE buffer.  The collector sets the final
+	// TotalByteLength and NumInstances.
+	m_pPOT->TotalByteLength = m_layout.definitionLength + m_layout.blockSize;
+	m_pPOT->DefinitionLength = m_layout.definitionLength;
 	m_pPOT->HeaderLength = sizeof(PERF_OBJECT_TYPE);
 	m_pPOT->ObjectNameTitleIndex = m_ObjectNameTitleIndex;
 	m_pPOT->ObjectNameTitle = NULL;
@@ -244,18 +462,14 @@ BOOL PyPERF_OBJECT_TYPE::InitMemoryLayout( MappingManager *pmm, PyPerfMonManager
 	m_pPOT->DetailLevel = minDetail;
 	m_pPOT->NumCounters = numCounters;
 	m_pPOT->DefaultCounter = m_DefaultCounter;
-	m_pPOT->NumInstances = -1;
+	m_pPOT->NumInstances = m_layout.maxInstances ? 0 : PERF_NO_INSTANCES;
 	m_pPOT->CodePage = 0;
 	m_pPOT->PerfTime.QuadPart = 0;
 	m_pPOT->PerfFreq.QuadPart = 0;
 
 	Py_XDECREF(m_obCounters);
 	m_obCounters = NULL;
-	ok = TRUE;
-
-done:
-	Py_XDECREF(obCounter);
-	return ok;
+	return TRUE;
 }
 
 /*static*/ void PyPERF_OBJECT_TYPE::deallocFunc(PyObject *ob)
@@ -4,6 +4,8 @@
 // The perfmon data follows directly.  This data is _always_:
 // A PERF_OBJECT_TYPE
 // A number of PERF_COUNTER_DEFINITIONs
+// Either a PERF_COUNTER_BLOCK or the instance slots - see PerfMonLayout.h
+#include "PerfMonLayout.h"
 
 // dont manage these size better cos I cant be bothered!
 const int MMCD_SERVICE_SIZE = 25;
@@ -22,4 +24,9 @@ struct MappingManagerControlData
 	SupplierStatus supplierStatus;
 	WCHAR ServiceName[MMCD_SERVICE_SIZE]; // The name of the service or application.
 	WCHAR EventSourceName[MMCD_EVENTSOURCE_SIZE]; // Source Name that appears in Event Log for errors.
+	// Where everything is in the perfmon data.  This structure is a multiple
+	// of 8 bytes, so the perfmon data is 8 byte aligned.
+	PyPerfLayout Layout;
 };
+
+C_ASSERT(sizeof(MappingManagerControlData) % 8 == 0);
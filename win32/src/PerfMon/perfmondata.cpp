@@ -346,19 +346,24 @@ Arguments:   IN       LPWSTR   lpValueName
 			return ERROR_SUCCESS;
 		}
 	}
-    SpaceNeeded = pControlData->TotalSize - sizeof(*pControlData);
-    if ( *lpcbTotalBytes < SpaceNeeded ) {
+	//
+    // Copy the Object Type, counter definitions and the instances in use
+    //  to the caller's data buffer 
+	//
+	const PyPerfLayout *pLayout = &pControlData->Layout;
+	if (pControlData->TotalSize != sizeof(*pControlData) + pLayout->totalSize) {
+		// Not laid out yet.
+        *lpcbTotalBytes = (DWORD) 0;
+        *lpNumObjectTypes = (DWORD) 0;
+		return ERROR_SUCCESS;
+	}
+	unsigned int needed;
+	SpaceNeeded = PyPerfLayout_Collect(pLayout, pPOT, pPOTResult, *lpcbTotalBytes, &needed);
+    if ( SpaceNeeded == 0 ) {
 	    *lpcbTotalBytes = (DWORD) 0;
         *lpNumObjectTypes = (DWORD) 0;
 		return ERROR_MORE_DATA;
 	}
-	//
-    // Copy the Object Type and counter definitions
-    //  to the caller's data buffer 
-	//
-	memmove(pPOTResult,
-            pPOT,
-			SpaceNeeded);
 
 	// Update all the counter and help values with the new offset
 	pPOTResult->ObjectNameTitleIndex += dwModuleFirstCounter;
@@ -369,8 +374,6 @@ Arguments:   IN       LPWSTR   lpValueName
 		pPCD[i].CounterNameTitleIndex += dwModuleFirstCounter;
 		pPCD[i].CounterHelpTitleIndex += dwModuleFirstHelp;
 	}
-	// debug !!
-	PERF_COUNTER_BLOCK *pPerfCounterBlock = (PERF_COUNTER_BLOCK *)(((LPBYTE)pPOTResult)+(pPOT->NumCounters*sizeof(PERF_COUNTER_DEFINITION))+sizeof(PERF_OBJECT_TYPE));
 	*lppData = (LPBYTE)(*lppData)+SpaceNeeded;
 	// update arguments fore return    
     *lpNumObjectTypes = 1;
@@ -16,11 +16,12 @@ class MappingManager
 public:
 	MappingManager();
 	~MappingManager();
-	BOOL Init(const TCHAR *szServiceName, const TCHAR *mapName = NULL, const TCHAR *szEventSourceName = NULL);
+	BOOL Init(const TCHAR *szServiceName, const PyPerfLayout *pLayout, const TCHAR *mapName = NULL, const TCHAR *szEventSourceName = NULL);
 	BOOL CheckStatus();
 	void *AllocChunk(DWORD size);
 private:
 	DWORD *m_pBytesUsed; // Pointer to first few bytes in the mmapped file.
+	DWORD m_dwSize; // Size of the mapping.
 	HANDLE m_hMappedObject;
 	void *m_pMapBlock;
 	MappingManagerControlData *m_pControl;
@@ -57,12 +58,19 @@ public:
 
 	PERF_COUNTER_DEFINITION *GetPCD() {return m_pPCD;}
 
-	DWORD GetCounterDataSize() {return m_CounterSize;}
+	// 8 bytes for PERF_SIZE_LARGE counters, otherwise a DWORD.
+	DWORD GetCounterDataSize() {return (m_CounterType & 0x300)==PERF_SIZE_LARGE ? sizeof(LONGLONG) : sizeof(DWORD);}
 	DWORD GetDetailLevel() {return m_DetailLevel;}
 
 	void AcceptBuffer( PyObject *obOwner, void *buffer );
 	void SetupBuffer(void);
-	void AcceptRawCounterBuffer( void *pBuffer, DWORD offset );
+	void AcceptCounterOffset( DWORD offset );
+	// Returns FALSE (with a Python exception) if the instance is not valid.
+	// *ppVal is NULL if the counter is not in a counter block.
+	BOOL GetCounterValue(PyObject *obInstance, void **ppVal);
+	DWORD GetCounterOffset() {return m_CounterOffset;}
+	DWORD GetCounterSize() {return m_CounterSize;}
+	PyObject *GetOwner() {return m_obBufferOwner;}
 
 	/* Python support */
 	static void deallocFunc(PyObject *ob);
@@ -83,8 +91,8 @@ protected:
 	PERF_COUNTER_DEFINITION *m_pPCD;
 	// Reference kept to owner of the underlying buffer in the shared mem.
 	PyObject *m_obBufferOwner;
-	// The counter itself (ie, the raw integer!) - or NULL if not yet setup.
-	void *m_pCounterValue; 
+	// The offset of the counter in each counter block - or 0 if not yet setup.
+	DWORD m_CounterOffset;
 	DWORD m_DefaultScale;
 	DWORD m_DetailLevel;
 	DWORD m_CounterNameTitleIndex;
@@ -93,6 +101,34 @@ protected:
 	DWORD m_CounterSize;
 };
 
+// 32 bit counters take a C int, as they always have.  Returns FALSE (with an
+// OverflowError) if the value doesn't fit a counter of the given size.
+inline BOOL PyPerf_CheckCounterValue(DWORD size, LONGLONG val)
+{
+	if (size!=sizeof(LONGLONG) && (val < INT_MIN || val > INT_MAX)) {
+		PyErr_SetString(PyExc_OverflowError,
+			val < 0 ? "signed integer is less than minimum" : "signed integer is greater than maximum");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+// Changes a counter value in shared memory with an interlocked operation.
+inline void PyPerf_UpdateCounter(void *pVal, DWORD size, LONGLONG val, BOOL bSet)
+{
+	if (size==sizeof(LONGLONG)) {
+		if (bSet)
+			PyPerf_Store64(pVal, val);
+		else
+			PyPerf_Add64(pVal, val);
+	} else {
+		if (bSet)
+			PyPerf_Store32(pVal, val);
+		else
+			PyPerf_Add32(pVal, val);
+	}
+}
+
 #define PyPERF_COUNTER_DEFINITION_Check(ob)	((ob)->ob_type == &PyPERF_COUNTER_DEFINITION::type)
 BOOL PyWinObject_AsPyPERF_COUNTER_DEFINITION(PyObject *ob, PyPERF_COUNTER_DEFINITION **ppPERF_COUNTER_DEFINITION, BOOL bNoneOK /*= TRUE*/);
 
@@ -106,13 +142,21 @@ public:
 
 	PERF_OBJECT_TYPE *GetPCD() {return m_pPOT;}
 
-	BOOL InitPythonObjects( PyObject *obCounters );
+	BOOL InitPythonObjects( PyObject *obCounters, DWORD maxInstances, DWORD maxNameChars );
+	BOOL InitLayout();
+	const PyPerfLayout *GetLayout() {return &m_layout;}
 	BOOL InitMemoryLayout( MappingManager *mm, PyPerfMonManager *obPMM);
+	// Returns FALSE (with a Python exception) if the instance is not valid.
+	// *ppBlock is NULL if the object is not in a mapping.
+	BOOL GetCounterBlock(PyObject *obInstance, BYTE **ppBlock);
 	void Term();
 
 	/* Python support */
 	static void deallocFunc(PyObject *ob);
 	static PyObject *Close(PyObject *self, PyObject *args);
+	static PyObject *AddInstance(PyObject *self, PyObject *args);
+	static PyObject *RemoveInstance(PyObject *self, PyObject *args);
+	static PyObject *UpdateCounters(PyObject *self, PyObject *args);
 	static struct PyMemberDef members[];
 	static struct PyMethodDef methods[];
 	static PyTypeObject type;
@@ -122,8 +166,14 @@ protected:
 	DWORD m_ObjectNameTitleIndex;
 	DWORD m_ObjectHelpTitleIndex;
 	DWORD m_DefaultCounter;
+	DWORD m_MaxInstances;
+	DWORD m_MaxInstanceNameLength;
 	PyObject *m_obCounters;
 	PyObject *m_obPerfMonManager;
+	// Where the counters are, filled in by InitLayout.
+	PyPerfLayout m_layout;
+	DWORD *m_pCounterOffsets;
+	DWORD *m_pCounterSizes;
 };
 
 #define PyPERF_OBJECT_TYPE_Check(ob)	((ob)->ob_type == &PyPERF_OBJECT_TYPE::type)
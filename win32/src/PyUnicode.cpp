@@ -8,6 +8,60 @@
 #include "malloc.h"
 #include "tchar.h"
 #include "locale.h"
+#include "PyWinStringCache.h"
+
+// The cache used for strings returned by Windows and COM - disabled until
+// SetStringCacheSize is called.
+static PyWinStringCache g_stringCache = {NULL, 0, 0, 0, 0, 0};
+
+// @pymethod |pywintypes|SetStringCacheSize|Enables, resizes or disables the cache of short strings.
+PyObject *PyWin_SetStringCacheSize(PyObject *self, PyObject *args)
+{
+	Py_ssize_t slots;
+	unsigned int maxLength = 16;
+	// @pyparm int|slots||The number of strings the cache can hold (rounded up to
+	// a power of 2), or zero to disable the cache.
+	// @pyparm int|maxLength|16|The longest string, in characters, to cache.  The
+	// maximum is 32.
+	if (!PyArg_ParseTuple(args, "n|I:SetStringCacheSize", &slots, &maxLength))
+		return NULL;
+	if (slots < 0) {
+		PyErr_SetString(PyExc_ValueError, "The number of slots can not be negative");
+		return NULL;
+	}
+	if (!PyWinStringCache_Resize(&g_stringCache, slots, maxLength))
+		return NULL;
+	g_stringCache.hits = g_stringCache.misses = g_stringCache.evictions = 0;
+	Py_INCREF(Py_None);
+	return Py_None;
+	// @comm Many strings returned by COM objects and the Windows API (property
+	// and column names, field names of records, enum-like values etc) are
+	// short and repeated over and over.  With the cache enabled, each short
+	// string is converted once and the same Python object is returned each time
+	// the same characters are seen again.
+	// <nl>The cache is disabled by default.  Calling this function also resets
+	// the statistics returned by <om pywintypes.GetStringCacheStats>.
+}
+
+// @pymethod dict|pywintypes|GetStringCacheStats|Returns statistics about the cache of short strings.
+PyObject *PyWin_GetStringCacheStats(PyObject *self, PyObject *args)
+{
+	if (!PyArg_ParseTuple(args, ":GetStringCacheStats"))
+		return NULL;
+	// @rdesc The result is a dictionary with the following keys.
+	// @flagh Key|Description
+	// @flag hits|The number of strings returned from the cache.
+	// @flag misses|The number of short strings which were not in the cache.
+	// @flag evictions|The number of strings which replaced another in the cache.
+	// @flag slots|The size of the cache, or zero if it is disabled.
+	// @flag max_length|The longest string cached.
+	return Py_BuildValue("{s:k,s:k,s:k,s:n,s:I}",
+		"hits", g_stringCache.hits,
+		"misses", g_stringCache.misses,
+		"evictions", g_stringCache.evictions,
+		"slots", (Py_ssize_t)g_stringCache.numSlots,
+		"max_length", g_stringCache.maxChars);
+}
 
 // @object PyUnicode|A Python object, representing a Unicode string.
 // @comm pywin32 uses the builtin Python Unicode object
@@ -117,7 +171,7 @@ PyObject *PyWinCoreString_FromString(const WCHAR *str, Py_ssize_t len /*=(Py_ssi
 #if (PY_VERSION_HEX < 0x03000000)
 	return PyUnicode_EncodeMBCS(str, len, "ignore");
 #else
-	return PyUnicode_FromWideChar(str, len);
+	return PyWinStringCache_Get(&g_stringCache, (const PyWinUTF16 *)str, len);
 #endif
 }
 
@@ -170,7 +224,7 @@ PyObject *PyWinObject_FromOLECHAR(const OLECHAR * str, int numChars)
 		Py_INCREF(Py_None);
 		return Py_None;
 	}
-	return PyUnicode_FromWideChar((OLECHAR *)str, numChars);
+	return PyWinStringCache_Get(&g_stringCache, (const PyWinUTF16 *)str, numChars);
 }
 
 // No size info avail.
@@ -180,7 +234,7 @@ PyObject *PyWinObject_FromOLECHAR(const OLECHAR * str)
 		Py_INCREF(Py_None);
 		return Py_None;
 	}
-	return PyUnicode_FromWideChar( (OLECHAR *)str, wcslen(str) );
+	return PyWinStringCache_Get(&g_stringCache, (const PyWinUTF16 *)str, wcslen(str));
 }
 
 PyObject *PyWinObject_FromBstr(const BSTR bstr, BOOL takeOwnership /*=FALSE*/)
@@ -189,7 +243,7 @@ PyObject *PyWinObject_FromBstr(const BSTR bstr, BOOL takeOwnership /*=FALSE*/)
 		Py_INCREF(Py_None);
 		return Py_None;
 	}
-	PyObject *ret = PyUnicode_FromWideChar(bstr, SysStringLen(bstr));
+	PyObject *ret = PyWinStringCache_Get(&g_stringCache, (const PyWinUTF16 *)bstr, SysStringLen(bstr));
 	if (takeOwnership) SysFreeString(bstr);
 	return ret;
 }
@@ -0,0 +1,177 @@
+// PyWinEventLogRecord.h - parsing and filtering of the EVENTLOGRECORD
+// structures returned by ReadEventLog.
+//
+// A buffer of records is walked without converting anything to Python
+// objects: each record is checked (every offset and length must lie within
+// the record, and every string must be terminated within it) and its
+// variable length parts located, so a filter can look at the event ID, type
+// and source of each record before deciding whether it is wanted at all.
+//
+// Nothing here depends on Windows or Python, so the parser can be built and
+// tested on other platforms against captured buffers.
+
+#ifndef __PYWINEVENTLOGRECORD_H__
+#define __PYWINEVENTLOGRECORD_H__
+
+#include <stdlib.h>
+#include <string.h>
+
+// A UTF-16 code unit - the same size as a WCHAR.
+typedef unsigned short PyWinUTF16;
+
+// The fixed part of an EVENTLOGRECORD, with the same layout.
+struct PyWinEventLogHeader {
+	unsigned int Length;
+	unsigned int Reserved;
+	unsigned int RecordNumber;
+	unsigned int TimeGenerated;
+	unsigned int TimeWritten;
+	unsigned int EventID;
+	unsigned short EventType;
+	unsigned short NumStrings;
+	unsigned short EventCategory;
+	unsigned short ReservedFlags;
+	unsigned int ClosingRecordNumber;
+	unsigned int StringOffset;
+	unsigned int UserSidLength;
+	unsigned int UserSidOffset;
+	unsigned int DataLength;
+	unsigned int DataOffset;
+};
+
+#define PYWIN_EVENTLOG_HEADER_SIZE 56
+
+// A record whose parts have been located.  All pointers are into the
+// buffer parsed.
+struct PyWinEventLogRecordInfo {
+	PyWinEventLogHeader header;	// A copy, so it is always aligned.
+	const PyWinUTF16 *sourceName;
+	size_t sourceNameLen;
+	const PyWinUTF16 *computerName;
+	size_t computerNameLen;
+	// NumStrings consecutive null terminated strings, or NULL.
+	const PyWinUTF16 *strings;
+	const unsigned char *sid;	// NULL if there is no SID.
+	const unsigned char *data;
+};
+
+// Which records to keep.  Empty members match every record.
+struct PyWinEventLogFilter {
+	// Sorted.  A record matches if its EventID, or the low 16 bits of it
+	// (the code Event Viewer shows), is in the array.
+	const unsigned int *eventIDs;
+	size_t numEventIDs;
+	// A record matches if its EventType has any of these bits set.  As
+	// EVENTLOG_SUCCESS is 0, those records only match when the mask is 0.
+	unsigned int typeMask;
+	// Compared ignoring the case of ASCII letters.
+	const PyWinUTF16 *sourceName;
+	size_t sourceNameLen;
+};
+
+// Finds the end of the null terminated string starting at offset *pos of a
+// record of len bytes.  Returns 0 if it is not terminated in the record.
+static int PyWinEventLog_FindString(const unsigned char *rec, size_t len, size_t *pos,
+	const PyWinUTF16 **pstr, size_t *pnum)
+{
+	size_t start = *pos;
+	for (size_t i = start; i + 1 < len; i += 2) {
+		if (rec[i] == 0 && rec[i + 1] == 0) {
+			*pstr = (const PyWinUTF16 *)(rec + start);
+			*pnum = (i - start) / 2;
+			*pos = i + 2;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Parses the record at the start of a buffer of size bytes.  Returns the
+// length of the record, or 0 if the data is not a valid record.
+static size_t PyWinEventLog_ParseRecord(const unsigned char *buf, size_t size, PyWinEventLogRecordInfo *info)
+{
+	if (size < PYWIN_EVENTLOG_HEADER_SIZE)
+		return 0;
+	memcpy(&info->header, buf, PYWIN_EVENTLOG_HEADER_SIZE);
+	const PyWinEventLogHeader *h = &info->header;
+	size_t len = h->Length;
+	if (len < PYWIN_EVENTLOG_HEADER_SIZE || len > size)
+		return 0;
+	// The source and computer names follow the header.
+	size_t pos = PYWIN_EVENTLOG_HEADER_SIZE;
+	if (!PyWinEventLog_FindString(buf, len, &pos, &info->sourceName, &info->sourceNameLen) ||
+	    !PyWinEventLog_FindString(buf, len, &pos, &info->computerName, &info->computerNameLen))
+		return 0;
+	info->strings = NULL;
+	if (h->NumStrings) {
+		if (h->StringOffset < PYWIN_EVENTLOG_HEADER_SIZE || (h->StringOffset & 1))
+			return 0;
+		pos = h->StringOffset;
+		const PyWinUTF16 *str;
+		size_t num;
+		for (unsigned int i = 0; i < h->NumStrings; i++) {
+			if (!PyWinEventLog_FindString(buf, len, &pos, &str, &num))
+				return 0;
+			if (i == 0)
+				info->strings = str;
+		}
+	}
+	info->sid = NULL;
+	if (h->UserSidLength) {
+		// A SID is 8 bytes, plus 4 for each sub-authority.
+		if (h->UserSidOffset < PYWIN_EVENTLOG_HEADER_SIZE || h->UserSidOffset > len ||
+		    h->UserSidLength > len - h->UserSidOffset || h->UserSidLength < 8 ||
+		    8 + 4 * (size_t)buf[h->UserSidOffset + 1] > h->UserSidLength)
+			return 0;
+		info->sid = buf + h->UserSidOffset;
+	}
+	if (h->DataOffset > len || h->DataLength > len - h->DataOffset)
+		return 0;
+	info->data = buf + h->DataOffset;
+	return len;
+}
+
+static int PyWinEventLog_MatchID(const PyWinEventLogFilter *filter, unsigned int id)
+{
+	size_t lo = 0, hi = filter->numEventIDs;
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if (filter->eventIDs[mid] < id)
+			lo = mid + 1;
+		else if (filter->eventIDs[mid] > id)
+			hi = mid;
+		else
+			return 1;
+	}
+	return 0;
+}
+
+static PyWinUTF16 PyWinEventLog_FoldCase(PyWinUTF16 c)
+{
+	return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+}
+
+// Returns non-zero if a parsed record passes a filter.
+static int PyWinEventLog_Match(const PyWinEventLogFilter *filter, const PyWinEventLogRecordInfo *info)
+{
+	const PyWinEventLogHeader *h = &info->header;
+	if (filter->numEventIDs && !PyWinEventLog_MatchID(filter, h->EventID) &&
+	    !PyWinEventLog_MatchID(filter, h->EventID & 0xFFFF))
+		return 0;
+	if (filter->typeMask && !(h->EventType & filter->typeMask))
+		return 0;
+	if (filter->sourceName) {
+		if (filter->sourceNameLen != info->sourceNameLen)
+			return 0;
+		// The record's name may not be aligned.
+		const unsigned char *name = (const unsigned char *)info->sourceName;
+		for (size_t i = 0; i < info->sourceNameLen; i++) {
+			PyWinUTF16 c = (PyWinUTF16)(name[2 * i] | (name[2 * i + 1] << 8));
+			if (PyWinEventLog_FoldCase(c) != PyWinEventLog_FoldCase(filter->sourceName[i]))
+				return 0;
+		}
+	}
+	return 1;
+}
+
+#endif // __PYWINEVENTLOGRECORD_H__
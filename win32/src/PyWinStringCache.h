@@ -0,0 +1,155 @@
+// PyWinStringCache.h - conversion of UTF-16 strings to Python objects, with
+// an optional cache of the results.
+//
+// COM and the Win32 API return many short, highly repetitive strings - column
+// and field names, enum-like values and so on.  When the cache is enabled,
+// the Python object made for each short string is remembered, and converting
+// the same characters again returns that object rather than a new one.
+//
+// The cache is direct-mapped: a string is keyed by its length and a hash of
+// its UTF-16 data, which select a single slot, and storing a new string
+// evicts whatever was in the slot.  Each slot holds a copy of the characters,
+// so lookups never need to look inside the Python object.  The cache must
+// only be used with the GIL held.
+//
+// Nothing here depends on Windows, so the cache can be built and benchmarked
+// on other platforms by passing it PyWinUTF16 data directly.
+
+#ifndef __PYWINSTRINGCACHE_H__
+#define __PYWINSTRINGCACHE_H__
+
+#include <stdlib.h>
+#include <string.h>
+
+// A UTF-16 code unit - the same size as a WCHAR.
+typedef unsigned short PyWinUTF16;
+
+// The longest string (in UTF-16 code units) the cache can hold.
+#define PYWIN_STRING_CACHE_MAX_CHARS 32
+
+struct PyWinStringCacheSlot {
+	PyObject *str;		// NULL if the slot is empty.
+	unsigned int hash;
+	unsigned int len;
+	PyWinUTF16 chars[PYWIN_STRING_CACHE_MAX_CHARS];
+};
+
+struct PyWinStringCache {
+	PyWinStringCacheSlot *slots;	// NULL when the cache is disabled.
+	size_t numSlots;		// Always a power of 2.
+	unsigned int maxChars;	// Longer strings are never cached.
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+};
+
+// Converts UTF-16 data to a new Python unicode object.  Strings without
+// surrogates (ie, almost all of them) are copied straight into the new
+// object without any intermediate buffer.
+static PyObject *PyWinUTF16_Decode(const PyWinUTF16 *s, Py_ssize_t len)
+{
+#if (PY_VERSION_HEX >= 0x03030000)
+	PyWinUTF16 maxchar = 0;
+	Py_ssize_t i;
+	for (i = 0; i < len; i++) {
+		PyWinUTF16 c = s[i];
+		if (c >= 0xD800 && c <= 0xDFFF)
+			break;
+		if (c > maxchar)
+			maxchar = c;
+	}
+	if (i == len) {
+		PyObject *ret = PyUnicode_New(len, maxchar);
+		if (ret == NULL)
+			return NULL;
+		if (PyUnicode_KIND(ret) == PyUnicode_1BYTE_KIND) {
+			Py_UCS1 *dest = PyUnicode_1BYTE_DATA(ret);
+			for (i = 0; i < len; i++)
+				dest[i] = (Py_UCS1)s[i];
+		} else
+			memcpy(PyUnicode_2BYTE_DATA(ret), s, len * sizeof(PyWinUTF16));
+		return ret;
+	}
+#endif
+	// Surrogates - let Python combine the pairs.
+#ifdef _WIN32
+	return PyUnicode_FromWideChar((const wchar_t *)s, len);
+#else
+	int byteorder = -1; // little endian.
+	return PyUnicode_DecodeUTF16((const char *)s, len * sizeof(PyWinUTF16), "surrogatepass", &byteorder);
+#endif
+}
+
+static unsigned int PyWinUTF16_Hash(const PyWinUTF16 *s, Py_ssize_t len)
+{
+	// FNV-1a, a code unit at a time.
+	unsigned int hash = 2166136261U;
+	for (Py_ssize_t i = 0; i < len; i++) {
+		hash ^= s[i];
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+// Empties the cache, keeping its size.
+static void PyWinStringCache_Clear(PyWinStringCache *cache)
+{
+	for (size_t i = 0; i < cache->numSlots; i++)
+		Py_CLEAR(cache->slots[i].str);
+}
+
+// Sets the number of slots (rounded up to a power of 2) and the longest
+// string cached.  Zero slots disables the cache.  Returns 0 with an
+// exception set on failure, leaving the cache unchanged.
+static int PyWinStringCache_Resize(PyWinStringCache *cache, size_t numSlots, unsigned int maxChars)
+{
+	size_t size = 0;
+	PyWinStringCacheSlot *slots = NULL;
+	if (numSlots) {
+		for (size = 1; size < numSlots; size <<= 1)
+			;
+		slots = (PyWinStringCacheSlot *)calloc(size, sizeof(PyWinStringCacheSlot));
+		if (slots == NULL) {
+			PyErr_NoMemory();
+			return 0;
+		}
+	}
+	PyWinStringCache_Clear(cache);
+	free(cache->slots);
+	cache->slots = slots;
+	cache->numSlots = size;
+	cache->maxChars = maxChars > PYWIN_STRING_CACHE_MAX_CHARS ? PYWIN_STRING_CACHE_MAX_CHARS : maxChars;
+	return 1;
+}
+
+// Returns a new reference to a unicode object with the given characters,
+// from the cache if possible.
+static PyObject *PyWinStringCache_Get(PyWinStringCache *cache, const PyWinUTF16 *s, Py_ssize_t len)
+{
+	if (cache->slots == NULL || len > (Py_ssize_t)cache->maxChars)
+		return PyWinUTF16_Decode(s, len);
+	unsigned int hash = PyWinUTF16_Hash(s, len);
+	PyWinStringCacheSlot *slot = cache->slots + (hash & (cache->numSlots - 1));
+	if (slot->str && slot->hash == hash && slot->len == (unsigned int)len &&
+	    memcmp(slot->chars, s, len * sizeof(PyWinUTF16)) == 0) {
+		cache->hits++;
+		Py_INCREF(slot->str);
+		return slot->str;
+	}
+	cache->misses++;
+	PyObject *ret = PyWinUTF16_Decode(s, len);
+	if (ret == NULL)
+		return NULL;
+	PyObject *old = slot->str;
+	if (old)
+		cache->evictions++;
+	slot->str = ret;
+	Py_INCREF(ret);
+	slot->hash = hash;
+	slot->len = (unsigned int)len;
+	memcpy(slot->chars, s, len * sizeof(PyWinUTF16));
+	Py_XDECREF(old);
+	return ret;
+}
+
+#endif // __PYWINSTRINGCACHE_H__
@@ -21,6 +21,8 @@ PyObject * PyWinExc_ApiError = NULL;
 PyObject * PyWinExc_COMError = NULL;
 
 extern PyObject *PyWinMethod_NewHKEY(PyObject *self, PyObject *args);
+extern PyObject *PyWin_SetStringCacheSize(PyObject *self, PyObject *args);
+extern PyObject *PyWin_GetStringCacheStats(PyObject *self, PyObject *args);
 
 extern BOOL _PyWinDateTime_Init();
 extern BOOL _PyWinDateTime_PrepareModuleDict(PyObject *dict);
@@ -819,6 +821,8 @@ static struct PyMethodDef pywintypes_functions[] = {
 	{"_GetLockStats", _GetLockStats, 1},
 #endif /* TRACE_THREADSTATE */
 	{"WAVEFORMATEX",         PyWinMethod_NewWAVEFORMATEX, 1 },      // @pymeth WAVEFORMATEX|Creates a new <o PyWAVEFORMATEX> object.
+	{"SetStringCacheSize",   PyWin_SetStringCacheSize, 1 },  // @pymeth SetStringCacheSize|Enables, resizes or disables the cache of short strings.
+	{"GetStringCacheStats",  PyWin_GetStringCacheStats, 1 }, // @pymeth GetStringCacheStats|Returns statistics about the cache of short strings.
 	{NULL,			NULL}
 };
 
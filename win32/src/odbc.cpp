@@ -69,6 +69,7 @@ typedef struct _out
 {
 	struct _out *next;
 	SQLLEN rcode;
+	SQLLEN *rcodes;		/* one per row in the rowset - points at rcode for a single row */
 	void *bind_area;
 	CopyFcn copy_fcn;
 	bool bGetData;
@@ -97,6 +98,14 @@ typedef struct
 	PyObject *description;
 	PyObject *cursorError;
 	int n_columns;
+	long arraysize;
+	long batchsize;
+	PyObject *paramstatus;
+	SQLULEN rowset_bound;	/* rows the output bindings have room for */
+	SQLULEN rowset_size;	/* rows the driver returns per SQLFetch */
+	SQLULEN rows_fetched;	/* rows returned by the last SQLFetch */
+	SQLULEN row_index;		/* next of those rows to be processed */
+	SQLUSMALLINT *row_status;
 } cursorObject;
 
 static cursorObject *cursor(PyObject *o)
@@ -327,6 +336,12 @@ static int attemptReconnect(cursorObject *cur)
 			return 1;
 		}
 		cur->connect_id = cur->my_conx->connect_id;
+		/* Statement attributes don't carry over to the new handle, and
+		   any rows left from the old one are gone */
+		cur->rowset_size = cur->rowset_bound = 1;
+		free(cur->row_status);
+		cur->row_status = NULL;
+		cur->rows_fetched = cur->row_index = 0;
 		return 0;
 	}
 
@@ -434,6 +449,12 @@ static PyObject *odbcCursor(PyObject *self, PyObject *args)
 	cur->inputVars = 0;
 	cur->description = 0;
 	cur->max_width = 65536L;
+	cur->arraysize = 1;
+	cur->batchsize = 1000;
+	cur->paramstatus = NULL;
+	cur->rowset_bound = cur->rowset_size = 1;
+	cur->rows_fetched = cur->row_index = 0;
+	cur->row_status = NULL;
 	cur->my_conx = 0;
 	cur->hstmt=NULL;
 	cur->cursorError=odbcError;
@@ -491,6 +512,8 @@ static void deleteOutput(cursorObject *cur)
 	{
 		OutputBinding *next = ob->next;
 		free(ob->bind_area);
+		if (ob->rcodes != &ob->rcode)
+			free(ob->rcodes);
 		free(ob);
 		ob = next;
 	}
@@ -524,12 +547,14 @@ static void cursorDealloc(PyObject *self)
 		SQLFreeHandle(SQL_HANDLE_STMT, cur->hstmt);
 
 	deleteBinding(cur);
+	free(cur->row_status);
 	if (cur->my_conx)
 	{
 		Py_DECREF((PyObject*)cur->my_conx);
 	}
 	Py_XDECREF(cur->description);
 	Py_XDECREF(cur->cursorError);
+	Py_XDECREF(cur->paramstatus);
 	PyObject_Del(self);
 }
 
@@ -560,6 +585,7 @@ static BOOL bindOutputVar
 	OutputBinding *current = NULL;
 
 	ob->bGetData = bUseGet;
+	ob->rcodes = &ob->rcode;
 	ob->pos = pos;
 	ob->vtype = vtype;
 	ob->vsize = vsize;
@@ -619,7 +645,7 @@ static PyObject *stringCopy(const void *v, SQLLEN sz)
 
 static PyObject *longCopy(const void *v, SQLLEN sz)
 {
-	return PyInt_FromLong(*(unsigned long *)v);
+	return PyInt_FromLong(*(SQLINTEGER *)v);
 }
 
 static PyObject *doubleCopy(const void *v, SQLLEN sz)
@@ -629,6 +655,11 @@ static PyObject *doubleCopy(const void *v, SQLLEN sz)
 	return (d == floor(d)) ? PyLong_FromDouble(d) : PyFloat_FromDouble(d);
 }
 
+static PyObject *bigintCopy(const void *v, SQLLEN sz)
+{
+	return PyLong_FromLongLong(*(SQLBIGINT *)v);
+}
+
 static PyObject *dateCopy(const void *v, SQLLEN sz)
 {
 	const TIMESTAMP_STRUCT  *dt = (const TIMESTAMP_STRUCT *) v;
@@ -846,32 +877,16 @@ static int ibindNull(cursorObject*cur, int column)
 }
 
 
-static int ibindDate(cursorObject*cur, int column, PyObject *item) 
+/* Fills in a TIMESTAMP_STRUCT from a PyTime or datetime object */
+static BOOL asTimestamp(PyObject *item, TIMESTAMP_STRUCT *dt)
 {
-	/* Sql server apparently determines the precision and type of date based
-		on length of input, according to the character size required for column
-		storage.  This is completely bogus when passing a TIMESTAMP_STRUCT, whose
-		length is always 16.  This apparently causes Sql Server to treat it as a
-		SMALLDATETIME, and truncates seconds as well as fraction of second, and
-		also limits the range of acceptable dates.
-		Tell it we have enough room for 3 decimals, since this is all that
-		SYSTEMTIME affords, and all that Sql Server 2005 will accept.
-		Sql Server 2008 has a datetime2 with up to 7 decimals.
-		Might need to use SqlDescribeCol to get length and precision to support this.
-	*/
-	SQLLEN len = 23;	// length of character storage for yyyy-mm-dd hh:mm:ss.ddd
-	assert(len >= sizeof(TIMESTAMP_STRUCT));
-	InputBinding *ib = initInputBinding(cur, len);
-	if (!ib)
-		return 0;
-	TIMESTAMP_STRUCT *dt = (TIMESTAMP_STRUCT*) ib->bind_area ;
-	ZeroMemory(dt, len);
+	ZeroMemory(dt, sizeof(*dt));
 	// Accept either a PyTime or datetime object
 #ifndef NO_PYWINTYPES_TIME
 	if (PyWinTime_CHECK(item)){
 		SYSTEMTIME st;
 		if (!((PyTime *)item)->GetTime(&st))
-			return 0;
+			return FALSE;
 		dt->year = st.wYear;
 		dt->month = st.wMonth;
 		dt->day = st.wDay;
@@ -886,17 +901,17 @@ static int ibindDate(cursorObject*cur, int column, PyObject *item)
 		// Python 2.3 doesn't have C Api for datetime
 		TmpPyObject timeseq = PyObject_CallMethod(item, "timetuple", NULL);
 		if (timeseq==NULL)
-			return 0;
+			return FALSE;
 		timeseq=PySequence_Tuple(timeseq);
 		if (timeseq==NULL)
-			return 0;
+			return FALSE;
 		// Last 3 items are ignored.
 		PyObject *obwday, *obyday, *obdst;
 		if (!PyArg_ParseTuple(timeseq, "hhh|hhhOOO:TIMESTAMP_STRUCT",
 			&dt->year, &dt->month, &dt->day,
 			&dt->hour, &dt->minute, &dt->second,
 			&obwday, &obyday, &obdst))
-			return 0;
+			return FALSE;
 
 		TmpPyObject usec=PyObject_GetAttrString(item, "microsecond");
 		if (usec == NULL)
@@ -904,13 +919,37 @@ static int ibindDate(cursorObject*cur, int column, PyObject *item)
 		else{
 			dt->fraction=PyLong_AsUnsignedLong(usec);
 			if (dt->fraction == -1 && PyErr_Occurred())
-				return 0;
+				return FALSE;
 			// Convert to nanoseconds
 			dt->fraction *= 1000;
 		}
 #ifndef NO_PYWINTYPES_TIME
 	}
 #endif // NO_PYWINTYPES_TIME
+	return TRUE;
+}
+
+static int ibindDate(cursorObject*cur, int column, PyObject *item) 
+{
+	/* Sql server apparently determines the precision and type of date based
+		on length of input, according to the character size required for column
+		storage.  This is completely bogus when passing a TIMESTAMP_STRUCT, whose
+		length is always 16.  This apparently causes Sql Server to treat it as a
+		SMALLDATETIME, and truncates seconds as well as fraction of second, and
+		also limits the range of acceptable dates.
+		Tell it we have enough room for 3 decimals, since this is all that
+		SYSTEMTIME affords, and all that Sql Server 2005 will accept.
+		Sql Server 2008 has a datetime2 with up to 7 decimals.
+		Might need to use SqlDescribeCol to get length and precision to support this.
+	*/
+	SQLLEN len = 23;	// length of character storage for yyyy-mm-dd hh:mm:ss.ddd
+	assert(len >= sizeof(TIMESTAMP_STRUCT));
+	InputBinding *ib = initInputBinding(cur, len);
+	if (!ib)
+		return 0;
+	ZeroMemory(ib->bind_area, len);
+	if (!asTimestamp(item, (TIMESTAMP_STRUCT *)ib->bind_area))
+		return 0;
 
 	if (unsuccessful(SQLBindParameter(
 		cur->hstmt,
@@ -1255,7 +1294,7 @@ static BOOL bindOutput(cursorObject *cur)
 				cur,
 				longCopy,
 				SQL_C_LONG,
-				sizeof(unsigned long),
+				sizeof(SQLINTEGER),
 				pos,
 				false))
 				return FALSE;
@@ -1266,7 +1305,6 @@ static BOOL bindOutput(cursorObject *cur)
 		case SQL_FLOAT:
 		case SQL_DOUBLE:
 		case SQL_REAL:
-		case SQL_BIGINT:
 			if (!bindOutputVar(
 				cur,
 				doubleCopy,
@@ -1278,13 +1316,25 @@ static BOOL bindOutput(cursorObject *cur)
 			typeOf = DbiNumber;
 			prec = vsize;
 			break;
+		case SQL_BIGINT:
+			if (!bindOutputVar(
+				cur,
+				bigintCopy,
+				SQL_C_SBIGINT,
+				sizeof(SQLBIGINT),
+				pos,
+				false))
+				return FALSE;
+			typeOf = DbiNumber;
+			prec = vsize;
+			break;
 		case SQL_DATE:
 		case SQL_TIMESTAMP:
 			if (!bindOutputVar(
 				cur,
 				dateCopy,
 				SQL_C_TIMESTAMP,
-				vsize,
+				sizeof(TIMESTAMP_STRUCT),
 				pos,
 				false))
 				return FALSE;
@@ -1303,7 +1353,11 @@ static BOOL bindOutput(cursorObject *cur)
 			break;
 		case SQL_BINARY:
 		case SQL_VARBINARY:
-			if (!bindOutputVar(cur, rawCopy, SQL_C_BINARY, cur->max_width, pos, false))
+			/* Don't make every row of a block max_width bytes when the
+			   column is known to be smaller */
+			if (!bindOutputVar(cur, rawCopy, SQL_C_BINARY,
+				(vsize > 0 && vsize < (SQLULEN)cur->max_width) ? vsize : cur->max_width,
+				pos, false))
 				return FALSE;
 			typeOf = DbiRaw;
 			break;
@@ -1341,6 +1395,191 @@ static BOOL bindOutput(cursorObject *cur)
 }
 
 
+/* Rows are fetched from the driver a block at a time, into column-wise
+   arrays bound to each output column.  The block is sized from the number
+   of rows asked for and the cursor's arraysize, but is kept to at most
+   ROWSET_MAX_ROWS rows and ROWSET_MAX_BYTES of bound buffers.
+   If any column is read with SQLGetData (long/BLOB columns), many drivers
+   can't position within a block, so rows are fetched one at a time. */
+#define ROWSET_MAX_ROWS		4096
+#define ROWSET_MAX_BYTES	(16 * 1024 * 1024)
+
+/* Puts the statement back to fetching a single row, and forgets any
+   rows left over from a previous block. */
+static void resetRowset(cursorObject *cur)
+{
+	if (cur->rowset_size != 1)
+	{
+		SQLSetStmtAttr(cur->hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)1, 0);
+		cur->rowset_size = 1;
+	}
+	if (cur->row_status)
+	{
+		SQLSetStmtAttr(cur->hstmt, SQL_ATTR_ROW_STATUS_PTR, NULL, 0);
+		free(cur->row_status);
+		cur->row_status = NULL;
+	}
+	cur->rowset_bound = 1;
+	cur->rows_fetched = cur->row_index = 0;
+}
+
+/* Rebinds the output columns as arrays with room for n_rows rows, and asks
+   the driver to return that many per SQLFetch.  Must only be called when
+   all the rows of the previous block have been processed. */
+static BOOL bindRowset(cursorObject *cur, SQLULEN n_rows)
+{
+	OutputBinding *ob;
+	SQLUSMALLINT *status;
+	SQLULEN actual = 1;
+
+	/* The driver must never be left with a row count larger than any
+	   bound array, so drop back to a single row while rebinding. */
+	resetRowset(cur);
+	for (ob = cur->outputVars; ob; ob = ob->next)
+	{
+		void *area;
+		SQLLEN *rcodes;
+		if (ob->bGetData)
+			continue;
+		area = malloc(ob->vsize * n_rows);
+		rcodes = (SQLLEN *)malloc(n_rows * sizeof(SQLLEN));
+		if (area == NULL || rcodes == NULL)
+		{
+			free(area);
+			free(rcodes);
+			PyErr_NoMemory();
+			return FALSE;
+		}
+		if (unsuccessful(SQLBindCol(
+			cur->hstmt,
+			ob->pos,
+			ob->vtype,
+			area,
+			ob->vsize,
+			rcodes)))
+		{
+			free(area);
+			free(rcodes);
+			cursorError(cur, _T("BIND"));
+			return FALSE;
+		}
+		/* Only free the old buffers once the driver has let go of them */
+		free(ob->bind_area);
+		if (ob->rcodes != &ob->rcode)
+			free(ob->rcodes);
+		ob->bind_area = area;
+		ob->rcodes = rcodes;
+	}
+	cur->rowset_bound = n_rows;
+
+	status = (SQLUSMALLINT *)malloc(n_rows * sizeof(SQLUSMALLINT));
+	if (status == NULL)
+	{
+		PyErr_NoMemory();
+		return FALSE;
+	}
+	cur->row_status = status;
+	if (unsuccessful(SQLSetStmtAttr(cur->hstmt, SQL_ATTR_ROW_BIND_TYPE, (SQLPOINTER)SQL_BIND_BY_COLUMN, 0))
+		|| unsuccessful(SQLSetStmtAttr(cur->hstmt, SQL_ATTR_ROW_STATUS_PTR, status, 0))
+		|| unsuccessful(SQLSetStmtAttr(cur->hstmt, SQL_ATTR_ROWS_FETCHED_PTR, &cur->rows_fetched, 0))
+		|| unsuccessful(SQLSetStmtAttr(cur->hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)n_rows, 0))
+		/* A driver may substitute a smaller size (01S02) */
+		|| unsuccessful(SQLGetStmtAttr(cur->hstmt, SQL_ATTR_ROW_ARRAY_SIZE, &actual, 0, NULL))
+		|| actual < 1 || actual > n_rows)
+	{
+		/* Driver can't do block fetches - carry on a row at a time.  The
+		   status array may never be written, so stop using it. */
+		SQLSetStmtAttr(cur->hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)1, 0);
+		SQLSetStmtAttr(cur->hstmt, SQL_ATTR_ROW_STATUS_PTR, NULL, 0);
+		free(cur->row_status);
+		cur->row_status = NULL;
+		actual = 1;
+	}
+	cur->rowset_size = actual;
+	return TRUE;
+}
+
+/* Makes sure the bound arrays are big enough for the next block of rows,
+   when n_wanted more rows have been asked for. */
+static BOOL prepareRowset(cursorObject *cur, long n_wanted)
+{
+	OutputBinding *ob;
+	SQLULEN row_bytes = 0;
+	SQLULEN n_rows = n_wanted < ROWSET_MAX_ROWS ? n_wanted : ROWSET_MAX_ROWS;
+	if (cur->arraysize > 0 && (SQLULEN)cur->arraysize > n_rows)
+		n_rows = cur->arraysize;
+	for (ob = cur->outputVars; ob; ob = ob->next)
+	{
+		if (ob->bGetData)
+			return TRUE;
+		row_bytes += ob->vsize + sizeof(SQLLEN);
+	}
+	if (row_bytes && n_rows > ROWSET_MAX_BYTES / row_bytes)
+		n_rows = ROWSET_MAX_BYTES / row_bytes;
+	/* Never shrink - returning extra rows from the current block is
+	   cheaper than rebinding every time the caller changes its mind. */
+	if (n_rows <= cur->rowset_bound)
+		return TRUE;
+	return bindRowset(cur, n_rows);
+}
+
+/* A growable block of memory, used to build up columns for fetchcolumns,
+   and the parameter status for executemany */
+typedef struct
+{
+	char *data;
+	size_t len;
+	size_t size;
+} ColumnBuffer;
+
+static BOOL reserveColumnBuffer(ColumnBuffer *b, size_t extra)
+{
+	char *data;
+	size_t size;
+	if (b->len + extra <= b->size)
+		return TRUE;
+	size = b->size ? b->size : 1024;
+	while (size < b->len + extra)
+		size *= 2;
+	data = (char *)realloc(b->data, size);
+	if (data == NULL)
+	{
+		PyErr_NoMemory();
+		return FALSE;
+	}
+	b->data = data;
+	b->size = size;
+	return TRUE;
+}
+
+static BOOL appendColumnBuffer(ColumnBuffer *b, const void *p, size_t n)
+{
+	if (!reserveColumnBuffer(b, n))
+		return FALSE;
+	memcpy(b->data + b->len, p, n);
+	b->len += n;
+	return TRUE;
+}
+
+/* Makes a string from a column buffer, and on Python 3 wraps it in a
+   memoryview of the given format */
+static PyObject *columnBufferToPy(ColumnBuffer *b, const char *format)
+{
+	PyObject *ret = PyString_FromStringAndSize(b->data ? b->data : "", b->len);
+#if (PY_VERSION_HEX >= 0x03000000)
+	if (ret && format)
+	{
+		PyObject *view = PyMemoryView_FromObject(ret);
+		Py_DECREF(ret);
+		if (view == NULL)
+			return NULL;
+		ret = PyObject_CallMethod(view, "cast", "s", format);
+		Py_DECREF(view);
+	}
+#endif
+	return ret;
+}
+
 /* This lame function is here for backward compatibility with some
    very old ODBC drivers that got naively ported from Windows 3.1.
    So says: Chris Ingram [chris.ingram@synchrologic.com] */
@@ -1401,17 +1640,480 @@ static RETCODE sendSQLInputData
 	return rc;
 }
 
-/* @pymethod int|cursor|execute|Execute some SQL */
-static PyObject *odbcCurExec(PyObject *self, PyObject *args)
+/* Executes the prepared statement once, with one set of parameters.  The
+   statement stays prepared, so later batches can still use it. */
+static BOOL executeRow(cursorObject *cur, PyObject *inputvars, int n_columns, SQLLEN *n_rows)
+{
+	RETCODE rc;
+	SQLLEN t = 0;
+	if (!PySequence_Check(inputvars))
+	{
+		PyErr_SetString(odbcError, "expected sequence of sequences for bulk inserts");
+		return FALSE;
+	}
+	if (PySequence_Length(inputvars) != n_columns)
+	{
+		PyErr_Format(odbcError, "Found an insert row that didn't have %d columns", n_columns);
+		return FALSE;
+	}
+	if (!bindInput(cur, inputvars, n_columns))
+		return FALSE;
+	Py_BEGIN_ALLOW_THREADS
+	rc = SQLExecute(cur->hstmt);
+	Py_END_ALLOW_THREADS
+	/* move data here. */
+	if (rc == SQL_NEED_DATA)
+	{
+		rc = sendSQLInputData(cur);
+	}
+	if (unsuccessful(rc))
+	{
+		cursorError(cur, _T("EXEC"));
+		return FALSE;
+	}
+	/* Success! */
+	/* Note: multiple result sets aren't supported here, just bulk inserts... */
+	Py_BEGIN_ALLOW_THREADS
+	SQLRowCount(cur->hstmt, &t);
+	Py_END_ALLOW_THREADS
+	*n_rows += t;
+	deleteBinding(cur);
+	return TRUE;
+}
+
+/* Kinds of value which can be packed into a parameter array.  A column
+   holding a mixture of kinds that can't be combined is PARAM_MIXED. */
+enum {PARAM_NULL, PARAM_INT, PARAM_BIGINT, PARAM_FLOAT, PARAM_CHAR, PARAM_WCHAR,
+	PARAM_BINARY, PARAM_DATE, PARAM_MIXED};
+
+/* One parameter's values for a batch of parameter sets */
+typedef struct
+{
+	int kind;
+	SQLLEN max_len;		/* longest string or binary value, in characters or bytes */
+	SQLLEN width;		/* bytes per element of data */
+	char *data;
+	SQLLEN *ind;
+} ParamArray;
+
+static int paramKind(PyObject *item, SQLLEN *len)
+{
+	*len = 0;
+	if (item == Py_None)
+		return PARAM_NULL;
+	if (PyFloat_Check(item))
+		return PARAM_FLOAT;
+	if (PyLong_Check(item) || PyInt_Check(item))
+	{
+		PY_LONG_LONG v = PyLong_AsLongLong(item);
+		if (v == -1 && PyErr_Occurred())
+		{
+			/* Let the row at a time path report it */
+			PyErr_Clear();
+			return PARAM_MIXED;
+		}
+		return (v >= INT_MIN && v <= INT_MAX) ? PARAM_INT : PARAM_BIGINT;
+	}
+	if (PyString_Check(item))
+	{
+		*len = PyString_GET_SIZE(item);
+		return PARAM_CHAR;
+	}
+	if (PyUnicode_Check(item))
+	{
+		*len = PyUnicode_GetSize(item);
+		return PARAM_WCHAR;
+	}
+	if (PyWinTime_Check(item))
+		return PARAM_DATE;
+#if (PY_VERSION_HEX < 0x03000000)
+	if (PyBuffer_Check(item))
+#else
+	if (PyObject_CheckBuffer(item))
+#endif
+	{
+		void *buf;
+		DWORD buflen;
+		if (!PyWinObject_AsReadBuffer(item, &buf, &buflen))
+		{
+			PyErr_Clear();
+			return PARAM_MIXED;
+		}
+		*len = buflen;
+		return PARAM_BINARY;
+	}
+	/* Anything else is converted via str() a row at a time */
+	return PARAM_MIXED;
+}
+
+static int mergeParamKind(int a, int b)
+{
+	if (a == PARAM_NULL)
+		return b;
+	if (b == PARAM_NULL || a == b)
+		return a;
+	if ((a == PARAM_INT || a == PARAM_BIGINT) && (b == PARAM_INT || b == PARAM_BIGINT))
+		return PARAM_BIGINT;
+	if ((a == PARAM_FLOAT && (b == PARAM_INT || b == PARAM_BIGINT))
+		|| (b == PARAM_FLOAT && (a == PARAM_INT || a == PARAM_BIGINT)))
+		return PARAM_FLOAT;
+	return PARAM_MIXED;
+}
+
+/* Copies one value into its slot in a parameter array */
+static BOOL packParam(ParamArray *pa, PyObject *item, Py_ssize_t row)
+{
+	char *p = pa->data + row * pa->width;
+	SQLLEN len;
+	if (item == Py_None)
+	{
+		pa->ind[row] = SQL_NULL_DATA;
+		return TRUE;
+	}
+	switch (pa->kind)
+	{
+	case PARAM_INT:
+	{
+		SQLINTEGER v = (SQLINTEGER)PyLong_AsLong(item);
+		memcpy(p, &v, sizeof(v));
+		break;
+	}
+	case PARAM_BIGINT:
+	{
+		PY_LONG_LONG v = PyLong_AsLongLong(item);
+		memcpy(p, &v, sizeof(v));
+		break;
+	}
+	case PARAM_FLOAT:
+	{
+		double v = PyFloat_AsDouble(item);
+		memcpy(p, &v, sizeof(v));
+		break;
+	}
+	case PARAM_CHAR:
+		len = PyString_GET_SIZE(item);
+		memcpy(p, PyString_AS_STRING(item), len);
+		p[len] = 0;
+		pa->ind[row] = len;
+		return TRUE;
+	case PARAM_WCHAR:
+	{
+		WCHAR *wval;
+		DWORD wlen;
+		if (!PyWinObject_AsWCHAR(item, &wval, FALSE, &wlen))
+			return FALSE;
+		/* The array was sized from the length found by paramKind */
+		len = (SQLLEN)wlen < pa->max_len ? (SQLLEN)wlen : pa->max_len;
+		memcpy(p, wval, len * sizeof(WCHAR));
+		((WCHAR *)p)[len] = 0;
+		pa->ind[row] = len * sizeof(WCHAR);
+		PyWinObject_FreeWCHAR(wval);
+		return TRUE;
+	}
+	case PARAM_BINARY:
+	{
+		void *buf;
+		DWORD buflen;
+		if (!PyWinObject_AsReadBuffer(item, &buf, &buflen))
+			return FALSE;
+		memcpy(p, buf, buflen);
+		pa->ind[row] = buflen;
+		return TRUE;
+	}
+	case PARAM_DATE:
+		if (!asTimestamp(item, (TIMESTAMP_STRUCT *)p))
+			return FALSE;
+		break;
+	}
+	if (PyErr_Occurred())
+		return FALSE;
+	pa->ind[row] = pa->width;
+	return TRUE;
+}
+
+static BOOL bindParamArray(cursorObject *cur, ParamArray *pa, int column)
+{
+	SQLSMALLINT ctype, sqltype, digits = 0;
+	SQLULEN colsize = pa->max_len > 0 ? pa->max_len : 1;
+	switch (pa->kind)
+	{
+	case PARAM_INT:
+		ctype = SQL_C_LONG; sqltype = SQL_INTEGER; colsize = pa->width;
+		break;
+	case PARAM_BIGINT:
+		ctype = SQL_C_SBIGINT; sqltype = SQL_BIGINT; colsize = pa->width;
+		break;
+	case PARAM_FLOAT:
+		ctype = SQL_C_DOUBLE; sqltype = SQL_DOUBLE; colsize = 15;
+		break;
+	case PARAM_CHAR:
+		/* As for ibindString and ibindUnicode */
+		ctype = SQL_C_CHAR; sqltype = pa->max_len > 255 ? SQL_LONGVARCHAR : SQL_VARCHAR;
+		break;
+	case PARAM_WCHAR:
+		ctype = SQL_C_WCHAR; sqltype = pa->max_len >= 255 ? SQL_WLONGVARCHAR : SQL_WVARCHAR;
+		break;
+	case PARAM_BINARY:
+		ctype = SQL_C_BINARY; sqltype = SQL_LONGVARBINARY;
+		break;
+	case PARAM_DATE:
+		/* See ibindDate */
+		ctype = SQL_C_TIMESTAMP; sqltype = SQL_TIMESTAMP; colsize = 23; digits = 3;
+		break;
+	default:
+		/* A column of nothing but None, as for ibindNull */
+		ctype = SQL_C_CHAR; sqltype = SQL_CHAR; colsize = 0;
+		break;
+	}
+	if (unsuccessful(SQLBindParameter(
+		cur->hstmt,
+		column,
+		SQL_PARAM_INPUT,
+		ctype,
+		sqltype,
+		colsize,
+		digits,
+		pa->data,
+		pa->width,
+		pa->ind)))
+	{
+		cursorError(cur, _T("input-binding"));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Resets the statement after executing with arrays of parameters */
+static void resetParamArrays(cursorObject *cur)
+{
+	/* An error may have dropped the connection, and the statement with it */
+	if (!cur->my_conx->connected)
+		return;
+	SQLFreeStmt(cur->hstmt, SQL_RESET_PARAMS);
+	SQLSetStmtAttr(cur->hstmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)1, 0);
+	SQLSetStmtAttr(cur->hstmt, SQL_ATTR_PARAM_STATUS_PTR, NULL, 0);
+	SQLSetStmtAttr(cur->hstmt, SQL_ATTR_PARAMS_PROCESSED_PTR, NULL, 0);
+}
+
+#define EXEC_BATCH_ERROR		0
+#define EXEC_BATCH_OK			1
+#define EXEC_BATCH_UNPACKABLE	-1	/* the values can't be put in arrays */
+#define EXEC_BATCH_UNSUPPORTED	-2	/* the driver can't take arrays */
+
+/* Executes the prepared statement for rows [start, start+count), packing the
+   values into column-wise arrays so the driver gets them all in one call. */
+static int executeBatch(cursorObject *cur, PyObject *rows, Py_ssize_t start, Py_ssize_t count,
+	int n_columns, ColumnBuffer *statuses, SQLLEN *n_rows)
+{
+	PyObject **fast;
+	ParamArray *params;
+	SQLUSMALLINT *status = NULL;
+	SQLULEN processed = 0;
+	SQLLEN t = 0;
+	Py_ssize_t i;
+	int col, ret = EXEC_BATCH_ERROR;
+	RETCODE rc;
+	BOOL bound = FALSE;
+
+	fast = (PyObject **)calloc(count, sizeof(PyObject *));
+	params = (ParamArray *)calloc(n_columns, sizeof(ParamArray));
+	if (fast == NULL || params == NULL)
+	{
+		PyErr_NoMemory();
+		goto Cleanup;
+	}
+	/* Work out what each column holds */
+	for (i = 0; i < count; i++)
+	{
+		PyObject *row = PySequence_GetItem(rows, start + i);
+		if (row == NULL)
+			goto Cleanup;
+		if (!PySequence_Check(row) || PyString_Check(row) || PyUnicode_Check(row))
+		{
+			Py_DECREF(row);
+			PyErr_SetString(odbcError, "expected sequence of sequences for bulk inserts");
+			goto Cleanup;
+		}
+		fast[i] = PySequence_Fast(row, "expected sequence of sequences for bulk inserts");
+		Py_DECREF(row);
+		if (fast[i] == NULL)
+			goto Cleanup;
+		if (PySequence_Fast_GET_SIZE(fast[i]) != n_columns)
+		{
+			PyErr_Format(odbcError, "Found an insert row that didn't have %d columns", n_columns);
+			goto Cleanup;
+		}
+		for (col = 0; col < n_columns; col++)
+		{
+			SQLLEN len;
+			int kind = paramKind(PySequence_Fast_GET_ITEM(fast[i], col), &len);
+			params[col].kind = mergeParamKind(params[col].kind, kind);
+			if (params[col].kind == PARAM_MIXED)
+			{
+				ret = EXEC_BATCH_UNPACKABLE;
+				goto Cleanup;
+			}
+			if (len > params[col].max_len)
+				params[col].max_len = len;
+		}
+	}
+
+	for (col = 0; col < n_columns; col++)
+	{
+		ParamArray *pa = &params[col];
+		switch (pa->kind)
+		{
+		case PARAM_INT: pa->width = sizeof(SQLINTEGER); break;
+		case PARAM_BIGINT: pa->width = sizeof(PY_LONG_LONG); break;
+		case PARAM_FLOAT: pa->width = sizeof(double); break;
+		case PARAM_CHAR: pa->width = pa->max_len + 1; break;
+		case PARAM_WCHAR: pa->width = (pa->max_len + 1) * sizeof(WCHAR); break;
+		case PARAM_BINARY: pa->width = pa->max_len > 0 ? pa->max_len : 1; break;
+		case PARAM_DATE: pa->width = sizeof(TIMESTAMP_STRUCT); break;
+		default: pa->width = 1; break;
+		}
+		pa->data = (char *)malloc(pa->width * count);
+		pa->ind = (SQLLEN *)malloc(sizeof(SQLLEN) * count);
+		if (pa->data == NULL || pa->ind == NULL)
+		{
+			PyErr_NoMemory();
+			goto Cleanup;
+		}
+		for (i = 0; i < count; i++)
+			if (!packParam(pa, PySequence_Fast_GET_ITEM(fast[i], col), i))
+				goto Cleanup;
+	}
+
+	status = (SQLUSMALLINT *)malloc(sizeof(SQLUSMALLINT) * count);
+	if (status == NULL)
+	{
+		PyErr_NoMemory();
+		goto Cleanup;
+	}
+	for (i = 0; i < count; i++)
+		status[i] = SQL_PARAM_UNUSED;
+
+	/* Drop any bindings left by an earlier statement with more parameters */
+	SQLFreeStmt(cur->hstmt, SQL_RESET_PARAMS);
+	bound = TRUE;
+	if (unsuccessful(SQLSetStmtAttr(cur->hstmt, SQL_ATTR_PARAM_BIND_TYPE, (SQLPOINTER)SQL_PARAM_BIND_BY_COLUMN, 0))
+		|| unsuccessful(SQLSetStmtAttr(cur->hstmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)count, 0))
+		|| unsuccessful(SQLSetStmtAttr(cur->hstmt, SQL_ATTR_PARAM_STATUS_PTR, status, 0))
+		|| unsuccessful(SQLSetStmtAttr(cur->hstmt, SQL_ATTR_PARAMS_PROCESSED_PTR, &processed, 0)))
+	{
+		ret = EXEC_BATCH_UNSUPPORTED;
+		goto Cleanup;
+	}
+	for (col = 0; col < n_columns; col++)
+		if (!bindParamArray(cur, &params[col], col + 1))
+			goto Cleanup;
+
+	Py_BEGIN_ALLOW_THREADS
+	rc = SQLExecute(cur->hstmt);
+	Py_END_ALLOW_THREADS
+	if (!appendColumnBuffer(statuses, status, sizeof(SQLUSMALLINT) * count))
+		goto Cleanup;
+	if (unsuccessful(rc))
+	{
+		cursorError(cur, _T("EXEC"));
+		goto Cleanup;
+	}
+	/* With SQL_SUCCESS_WITH_INFO, some sets of parameters may have failed */
+	for (i = 0; i < count; i++)
+		if (status[i] == SQL_PARAM_ERROR)
+		{
+			cursorError(cur, _T("EXEC"));
+			goto Cleanup;
+		}
+	Py_BEGIN_ALLOW_THREADS
+	SQLRowCount(cur->hstmt, &t);
+	Py_END_ALLOW_THREADS
+	*n_rows += t;
+	ret = EXEC_BATCH_OK;
+
+Cleanup:
+	if (bound)
+		resetParamArrays(cur);
+	if (fast)
+		for (i = 0; i < count; i++)
+			Py_XDECREF(fast[i]);
+	if (params)
+		for (col = 0; col < n_columns; col++)
+		{
+			free(params[col].data);
+			free(params[col].ind);
+		}
+	free(fast);
+	free(params);
+	free(status);
+	return ret;
+}
+
+/* Executes the prepared statement once for each item of rows, and records
+   the status of each in cur->paramstatus.  With useArrays, they are sent in
+   batches of cur->batchsize as parameter arrays, otherwise a row at a time. */
+static BOOL executeRows(cursorObject *cur, PyObject *rows, int n_columns, BOOL useArrays, SQLLEN *n_rows)
+{
+	ColumnBuffer statuses = {NULL, 0, 0};
+	Py_ssize_t n_sets = PySequence_Length(rows);
+	Py_ssize_t start, batch = cur->batchsize > 0 ? cur->batchsize : 1;
+	useArrays = useArrays && batch > 1 && n_columns > 0;
+	BOOL ok = n_sets >= 0;
+	PyObject *type, *value, *traceback;
+
+	for (start = 0; ok && start < n_sets; start += batch)
+	{
+		Py_ssize_t i, count = (n_sets - start < batch) ? n_sets - start : batch;
+		int rv = EXEC_BATCH_UNPACKABLE;
+		if (useArrays)
+			rv = executeBatch(cur, rows, start, count, n_columns, &statuses, n_rows);
+		if (rv == EXEC_BATCH_UNSUPPORTED)
+			useArrays = FALSE;
+		if (rv == EXEC_BATCH_OK || rv == EXEC_BATCH_ERROR)
+		{
+			ok = rv == EXEC_BATCH_OK;
+			continue;
+		}
+		/* Fall back to executing a row at a time */
+		for (i = start; ok && i < start + count; i++)
+		{
+			SQLUSMALLINT status;
+			PyObject *inputvars = PySequence_GetItem(rows, i);
+			if (inputvars == NULL)
+			{
+				ok = FALSE;
+				break;
+			}
+			ok = executeRow(cur, inputvars, n_columns, n_rows);
+			Py_DECREF(inputvars);
+			status = ok ? SQL_PARAM_SUCCESS : SQL_PARAM_ERROR;
+			if (!appendColumnBuffer(&statuses, &status, sizeof(status)))
+				ok = FALSE;
+		}
+	}
+
+	/* Keep any exception while building the status */
+	PyErr_Fetch(&type, &value, &traceback);
+	Py_XDECREF(cur->paramstatus);
+	cur->paramstatus = columnBufferToPy(&statuses, "H");
+	if (cur->paramstatus == NULL)
+	{
+		if (type)
+			PyErr_Clear();
+		else
+			ok = FALSE;
+	}
+	if (type)
+		PyErr_Restore(type, value, traceback);
+	free(statuses.data);
+	return ok;
+}
+
+static PyObject *execute(cursorObject *cur, PyObject *obsql, PyObject *inputvars, PyObject *rows, BOOL useArrays)
 {
-	cursorObject *cur = cursor(self);
 	TCHAR *sql=NULL;
-	PyObject *obsql;
 	TCHAR *sqlbuf;
-	PyObject *inputvars = 0;
 	PyObject *rv = 0;
-	PyObject *rows = 0;
-	SQLLEN t;
 	int n_columns = 0;
 	SQLLEN n_rows = 0;
 
@@ -1420,36 +2122,13 @@ static PyObject *odbcCurExec(PyObject *self, PyObject *args)
 		return 0;
 	}
 
-	/* @pyparm string|sql||The SQL to execute */
-	/* @pyparm sequence|[var, ...]|[]|Input variables. */
-	/* If the first element is itself a sequence (other than a string)
-		the input will be interpreted as a sequence of sequences to be
-		used to execute the statement multiple times.
-	*/
-	if (!PyArg_ParseTuple(args, "O|O:execute", &obsql, &inputvars))
-	{
-		return NULL;
-	}
-
-	if (inputvars){
-		if (PyString_Check(inputvars) || PyUnicode_Check(inputvars) || !PySequence_Check(inputvars))
-			return PyErr_Format(odbcError, "Values must be a sequence, not %s", inputvars->ob_type->tp_name);
-		if (PySequence_Length(inputvars) > 0){
-			PyObject *temp = PySequence_GetItem(inputvars, 0);
-			if (temp==NULL)
-				return NULL;
-			/* Strings don't count as a list in this case. */
-			if (PySequence_Check(temp) && !PyString_Check(temp) && !PyUnicode_Check(temp)){
-				rows = inputvars;
-				inputvars = NULL;
-				}
-			Py_DECREF(temp);
-			}
-		}
 	if (!PyWinObject_AsTCHAR(obsql, &sql, FALSE))
 		return NULL;
 
 	deleteBinding(cur);
+	resetRowset(cur);
+	Py_XDECREF(cur->paramstatus);
+	cur->paramstatus = NULL;
 
 	if (cur->description)
 	{
@@ -1487,48 +2166,10 @@ static PyObject *odbcCurExec(PyObject *self, PyObject *args)
 
 	if (rows)
 	{
-		int i;
 		/* handle insert cases... */
-		for(i = 0; i < PySequence_Length(rows); i++)
+		if (!executeRows(cur, rows, n_columns, useArrays, &n_rows))
 		{
-			inputvars = PySequence_GetItem(rows, i);
-			if (!PySequence_Check(inputvars))
-			{
-				PyErr_SetString(odbcError, "expected sequence of sequences for bulk inserts");
-				goto Error;
-			}
-			if (PySequence_Length(inputvars) != n_columns)
-			{
-				PyErr_Format(odbcError, "Found an insert row that didn't have %d columns", n_columns);
-				goto Error;
-			}
-			if (!bindInput(cur, inputvars, n_columns))
-			{
-				goto Error;
-			}
-			Py_BEGIN_ALLOW_THREADS
-			rc = SQLExecDirect(cur->hstmt, (SQLTCHAR *)sqlbuf,
-							   SQL_NTS);
-			Py_END_ALLOW_THREADS
-			/* move data here. */
-			if (rc == SQL_NEED_DATA)
-			{
-				rc = sendSQLInputData(cur);
-			}
-			if (unsuccessful(rc))
-			{
-				cursorError(cur, _T("EXEC"));
-				goto Error;
-			}
-			/* Success! */
-			/* Note: multiple result sets aren't supported here, just bulk inserts... */
-			Py_BEGIN_ALLOW_THREADS
-			SQLRowCount(cur->hstmt, &t);
-			Py_END_ALLOW_THREADS
-			n_rows += t;
-			deleteBinding(cur);
-			Py_DECREF(inputvars);
-			inputvars = NULL;
+			goto Error;
 		}
 	}
 	else
@@ -1580,7 +2221,158 @@ Error:
 	goto Cleanup;
 }
 
-static PyObject *processOutput(cursorObject *cur)
+/* @pymethod int|cursor|execute|Execute some SQL */
+static PyObject *odbcCurExec(PyObject *self, PyObject *args)
+{
+	PyObject *obsql;
+	PyObject *inputvars = 0;
+	PyObject *rows = 0;
+
+	/* @pyparm string|sql||The SQL to execute */
+	/* @pyparm sequence|[var, ...]|[]|Input variables. */
+	/* If the first element is itself a sequence (other than a string)
+		the input will be interpreted as a sequence of sequences to be
+		used to execute the statement multiple times.
+	*/
+	/* @comm When given a sequence of sequences, the statement is executed once
+	   for each, a row at a time.  <om cursor.executemany> sends them in batches,
+	   which is much faster with many rows. */
+	if (!PyArg_ParseTuple(args, "O|O:execute", &obsql, &inputvars))
+	{
+		return NULL;
+	}
+
+	if (inputvars){
+		if (PyString_Check(inputvars) || PyUnicode_Check(inputvars) || !PySequence_Check(inputvars))
+			return PyErr_Format(odbcError, "Values must be a sequence, not %s", inputvars->ob_type->tp_name);
+		if (PySequence_Length(inputvars) > 0){
+			PyObject *temp = PySequence_GetItem(inputvars, 0);
+			if (temp==NULL)
+				return NULL;
+			/* Strings don't count as a list in this case. */
+			if (PySequence_Check(temp) && !PyString_Check(temp) && !PyUnicode_Check(temp)){
+				rows = inputvars;
+				inputvars = NULL;
+				}
+			Py_DECREF(temp);
+			}
+		}
+	return execute(cursor(self), obsql, inputvars, rows, FALSE);
+}
+
+/* @pymethod int|cursor|executemany|Execute some SQL once for each of a sequence of parameter sets */
+static PyObject *odbcCurExecMany(PyObject *self, PyObject *args)
+{
+	PyObject *obsql, *rows;
+	/* @pyparm string|sql||The SQL to execute */
+	/* @pyparm sequence|[[var, ...], ...]||A sequence of sequences of input variables */
+	if (!PyArg_ParseTuple(args, "OO:executemany", &obsql, &rows))
+		return NULL;
+	if (PyString_Check(rows) || PyUnicode_Check(rows) || !PySequence_Check(rows))
+		return PyErr_Format(odbcError, "Values must be a sequence, not %s", rows->ob_type->tp_name);
+	/* @comm The parameter sets are sent to the driver in batches of
+	   <o cursor>.batchsize, using arrays of parameters (SQL_ATTR_PARAMSET_SIZE)
+	   so each batch takes one call.  Each parameter is packed into an array of
+	   a single type, so all its values in a batch must be of the same kind (or
+	   None) - though ints and floats may be mixed.  A batch with any other
+	   mixture of types, values converted via str(), or a driver which doesn't
+	   support parameter arrays, executes a row at a time instead.
+	   <nl>Afterwards, <o cursor>.paramstatus holds the outcome for each set of
+	   parameters that was attempted, even if an exception was raised.  If any
+	   set of parameters fails, an exception is raised at the end of the batch
+	   containing it, and no later batches are executed.
+	   @rdesc The total number of rows affected, as reported by the driver. */
+	return execute(cursor(self), obsql, NULL, rows, TRUE);
+}
+
+/* Uses SQLGetData to read a whole blob (or long varchar) value for the
+   current row into ob->bind_area, growing it as needed.  On return,
+   ob->rcode is the length read or SQL_NULL_DATA. */
+static BOOL getLongData(cursorObject *cur, OutputBinding *ob)
+{
+	/* Loop until return code indicates all remaining data fit into buffer. */
+	RETCODE rc;
+	SQLLEN cbRead = 0;
+	ob->rcode = 0;
+	do
+	{
+		/* Increase buffer size by cursor chunk size on second and subsequent calls
+			If not for the SQL Anywhere 5.0 problem (driver version
+			5.05.041867), we could probably grow by 50% each time
+			or the remaining size (as determined by ob->rcode).
+			Regarding above note, caller can now use cursor.setoutputsize
+			to work around any such bug in a driver */
+		if (ob->rcode){
+			void *pTemp = ob->bind_area;
+			ob->vsize += cur->max_width;
+			/* Some BLOBs can be huge, be paranoid about allowing
+			   other threads to run. */
+			Py_BEGIN_ALLOW_THREADS
+			ob->bind_area = realloc (ob->bind_area, ob->vsize);
+			Py_END_ALLOW_THREADS
+			if (ob->bind_area == NULL){
+				PyErr_NoMemory();
+				ob->vsize -= cur->max_width;
+				ob->bind_area = pTemp;
+				return FALSE;
+				}
+		}
+
+		Py_BEGIN_ALLOW_THREADS
+		rc = SQLGetData(cur->hstmt,
+						ob->pos,
+						ob->vtype,
+						(char *)ob->bind_area + cbRead,
+						ob->vsize - cbRead,
+						&ob->rcode);
+		Py_END_ALLOW_THREADS
+		if (unsuccessful(rc))
+		{
+			cursorError(cur, _T("SQLGetData"));
+			return FALSE;
+		}
+		/* Return code can be a negative status code:
+			SQL_NO_TOTAL if length is not known, SQL_NULL_DATA if nothing to retreive
+			Otherwise will be total bytes remaining including current read.
+		*/
+		if (ob->rcode >= 0 && ob->rcode <= ob->vsize - cbRead)
+		{
+			/* If we get here, then this should be the last iteration through the loop. */
+			ob->rcode += cbRead;
+		}
+		else
+		{
+			cbRead = ob->vsize;
+			/* We want to ignore the intermediate
+				  NULL characters SQLGetData() gives us.
+				   (silly, silly) */
+			if (ob->vtype == SQL_C_CHAR)
+				cbRead--;
+			else if (ob->vtype == SQL_C_WCHAR)
+				/* Buffer is not guaranteed to be an exact multiple of sizeof(WCHAR),
+					leaving an extra byte and throwing the next get off by 1. */
+				cbRead -= sizeof(WCHAR) + ob->vsize%sizeof(WCHAR);
+		}
+
+	} while (rc == SQL_SUCCESS_WITH_INFO);
+	return TRUE;
+}
+
+/* The length of a value in a bound column.  A value too long for the
+   buffer reports its full length (or SQL_NO_TOTAL), but was truncated to
+   fit - which for a character column leaves room for its terminator. */
+static SQLLEN boundLength(const OutputBinding *ob, SQLLEN rcode)
+{
+	SQLLEN room = ob->vsize;
+	if (ob->vtype == SQL_C_CHAR)
+		room -= sizeof(char);
+	else if (ob->vtype == SQL_C_WCHAR)
+		room -= sizeof(WCHAR) + ob->vsize%sizeof(WCHAR);
+	return (rcode == SQL_NO_TOTAL || rcode > room) ? room : rcode;
+}
+
+/* Builds a tuple from one row of the current block */
+static PyObject *processOutput(cursorObject *cur, SQLULEN row_num)
 {
 	OutputBinding *ob = cur->outputVars;
 	int column = 0;
@@ -1591,79 +2383,16 @@ static PyObject *processOutput(cursorObject *cur)
 	while (ob) {
 		if (ob->bGetData)
 		{
-			/* Use SQLGetData to retrieve data for blob (or long varchar) type columns.
-				Loop until return code indicates all remaining data fit into buffer.
-			*/
-			RETCODE rc;
-			SQLLEN cbRead = 0;
-			ob->rcode = 0;
-			do
+			if (!getLongData(cur, ob))
 			{
-				/* Increase buffer size by cursor chunk size on second and subsequent calls
-					If not for the SQL Anywhere 5.0 problem (driver version
-					5.05.041867), we could probably grow by 50% each time
-					or the remaining size (as determined by ob->rcode).
-					Regarding above note, caller can now use cursor.setoutputsize
-					to work around any such bug in a driver */
-				if (ob->rcode){
-					void *pTemp = ob->bind_area;
-					ob->vsize += cur->max_width;
-					/* Some BLOBs can be huge, be paranoid about allowing
-					   other threads to run. */
-					Py_BEGIN_ALLOW_THREADS
-					ob->bind_area = realloc (ob->bind_area, ob->vsize);
-					Py_END_ALLOW_THREADS
-					if (ob->bind_area == NULL){
-						PyErr_NoMemory();
-						ob->vsize -= cur->max_width;
-						ob->bind_area = pTemp;
-						Py_DECREF(row);
-						return NULL;
-						}
-                }
-
-				Py_BEGIN_ALLOW_THREADS
-				rc = SQLGetData(cur->hstmt,
-								ob->pos,
-								ob->vtype,
-								(char *)ob->bind_area + cbRead,
-								ob->vsize - cbRead,
-								&ob->rcode);
-				Py_END_ALLOW_THREADS
-				if (unsuccessful(rc))
-				{
-					Py_DECREF(row);
-	 				cursorError(cur, _T("SQLGetData"));
-					return NULL;
-				}
-				/* Return code can be a negative status code:
-					SQL_NO_TOTAL if length is not known, SQL_NULL_DATA if nothing to retreive
-					Otherwise will be total bytes remaining including current read.
-				*/
-                if (ob->rcode >= 0 && ob->rcode <= ob->vsize - cbRead)
-                {
-					/* If we get here, then this should be the last iteration through the loop. */
-					ob->rcode += cbRead;
-                }
-                else
-                {
-					cbRead = ob->vsize;
-					/* We want to ignore the intermediate
-						  NULL characters SQLGetData() gives us.
-						   (silly, silly) */
-					if (ob->vtype == SQL_C_CHAR)
-						cbRead--;
-					else if (ob->vtype == SQL_C_WCHAR)
-						/* Buffer is not guaranteed to be an exact multiple of sizeof(WCHAR),
-							leaving an extra byte and throwing the next get off by 1. */
-						cbRead -= sizeof(WCHAR) + ob->vsize%sizeof(WCHAR);
-				}
-
-			} while (rc == SQL_SUCCESS_WITH_INFO); 
+				Py_DECREF(row);
+				return NULL;
+			}
 		}
 		
 		PyObject *v;
-		if (ob->rcode == SQL_NULL_DATA)
+		SQLLEN rcode = ob->rcodes[row_num];
+		if (rcode == SQL_NULL_DATA)
 		{
 			v = Py_None;
 			Py_INCREF(v);
@@ -1673,9 +2402,8 @@ static PyObject *processOutput(cursorObject *cur)
 			if (ob->bGetData == false)
 			{
 				v = ob->copy_fcn(
-					ob->bind_area,
-					(ob->rcode < cur->max_width) ?
-					ob->rcode : cur->max_width);
+					(char *)ob->bind_area + row_num * ob->vsize,
+					boundLength(ob, rcode));
 			}
 			else
 			{
@@ -1699,32 +2427,77 @@ static PyObject *processOutput(cursorObject *cur)
 
 
 
-static PyObject *fetchOne(cursorObject *cur)
+/* Makes sure there is an unprocessed row in the current block, fetching
+   another block from the driver when the current one is used up.
+   n_wanted is how many more rows the caller expects to ask for, and is
+   only a hint for sizing the block.
+   Returns 1 if a row is available, 0 at the end of the results, or -1 with
+   an exception set. */
+static int fetchBlock(cursorObject *cur, long n_wanted)
 {
-  RETCODE rc;
-  Py_BEGIN_ALLOW_THREADS
-  rc = SQLFetch(cur->hstmt);
-  Py_END_ALLOW_THREADS
-  if (rc == SQL_NO_DATA_FOUND)
-  {
-    Py_INCREF(Py_None);
-    return Py_None;
-  }
-  else if (unsuccessful(rc))
-  {
-    cursorError(cur, _T("FETCH"));
-    return 0;
-  }
-  return processOutput(cur);
+	RETCODE rc;
+	if (cur->row_index < cur->rows_fetched)
+		return 1;
+	if (!prepareRowset(cur, n_wanted))
+		return -1;
+	cur->rows_fetched = cur->row_index = 0;
+	Py_BEGIN_ALLOW_THREADS
+	rc = SQLFetch(cur->hstmt);
+	Py_END_ALLOW_THREADS
+	if (rc == SQL_NO_DATA_FOUND)
+	{
+		cur->rows_fetched = 0;
+		return 0;
+	}
+	else if (unsuccessful(rc))
+	{
+		cur->rows_fetched = 0;
+		cursorError(cur, _T("FETCH"));
+		return -1;
+	}
+	if (cur->rowset_size == 1)
+		cur->rows_fetched = 1;
+	return cur->rows_fetched > 0;
+}
+
+/* Raises an error if the driver couldn't fetch a row of the block */
+static BOOL checkRowStatus(cursorObject *cur, SQLULEN row)
+{
+	if (cur->row_status && cur->row_status[row] == SQL_ROW_ERROR)
+	{
+		cursorError(cur, _T("FETCH"));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Returns the next row as a tuple, or None at the end of the results */
+static PyObject *fetchOne(cursorObject *cur, long n_wanted)
+{
+	SQLULEN row;
+	switch (fetchBlock(cur, n_wanted))
+	{
+	case -1:
+		return NULL;
+	case 0:
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+	row = cur->row_index++;
+	if (!checkRowStatus(cur, row))
+		return NULL;
+	return processOutput(cur, row);
 }
 
 static PyObject *fetchN(cursorObject *cur, long n_rows)
 {
-	int row;
+	long row;
 	PyObject *list = PyList_New(0);
+	if (list == NULL)
+		return NULL;
 	for (row = 0; row < n_rows; row++)
 	{
-		PyObject *entry = fetchOne(cur);
+		PyObject *entry = fetchOne(cur, n_rows - row);
 		if (entry)
 		{
 			if (entry == Py_None)
@@ -1755,15 +2528,17 @@ static PyObject *fetchN(cursorObject *cur, long n_rows)
 /* @pymethod data|cursor|fetchone|Fetch one row of data */
 static PyObject *odbcCurFetchOne(PyObject *self, PyObject *args)
 {
-	return fetchOne(cursor(self));
+	return fetchOne(cursor(self), 1);
 }
 
 
 /* @pymethod [data, ...]|cursor|fetchmany|Fetch many rows of data */
+/* @comm Rows are retrieved from the driver in blocks - see <om cursor.fetchall>. */
 static PyObject *odbcCurFetchMany(PyObject *self, PyObject *args)
 {
-  long n_rows = 1;
+  long n_rows = cursor(self)->arraysize;
 
+  /* @pyparm int|size|arraysize|Number of rows to fetch, defaults to the cursor's arraysize attribute */
   if (!PyArg_ParseTuple(args, "|l", &n_rows))
   {
       return NULL;
@@ -1773,11 +2548,260 @@ static PyObject *odbcCurFetchMany(PyObject *self, PyObject *args)
 }
 
 /* @pymethod [data, ...]|cursor|fetchall|Fetch all rows of data */
+/* @comm Rows are retrieved from the driver in blocks of up to several thousand
+   (or arraysize, if larger) using column-wise array binding, limited so the
+   buffers for one block stay below 16MB.  If the result contains any long
+   text or binary columns, rows are fetched one at a time so these can be read
+   with SQLGetData. */
 static PyObject *odbcCurFetchAll(PyObject *self, PyObject *args)
 {
 	return fetchN(cursor(self), LONG_MAX);
 }
 
+/* A column being built up by fetchcolumns */
+typedef struct
+{
+	ColumnBuffer values;	/* a value per row, or an end offset per row for variable width columns */
+	ColumnBuffer data;		/* contents of variable width columns */
+	ColumnBuffer nulls;		/* a bit per row, set when the value is NULL */
+} ColumnBuilder;
+
+/* Appends UTF-16 text to the buffer, as UTF-8 */
+static BOOL appendColumnUTF8(ColumnBuffer *b, const WCHAR *s, size_t n)
+{
+	size_t i;
+	unsigned char *out;
+	/* A BMP character needs at most 3 bytes, and a surrogate pair 4 */
+	if (!reserveColumnBuffer(b, n * 3))
+		return FALSE;
+	out = (unsigned char *)b->data + b->len;
+	for (i = 0; i < n; i++)
+	{
+		unsigned long c = s[i];
+		if (c >= 0xD800 && c < 0xDC00 && i + 1 < n && s[i + 1] >= 0xDC00 && s[i + 1] < 0xE000)
+		{
+			c = 0x10000 + ((c - 0xD800) << 10) + (s[i + 1] - 0xDC00);
+			i++;
+		}
+		if (c < 0x80)
+			*out++ = (unsigned char)c;
+		else if (c < 0x800)
+		{
+			*out++ = (unsigned char)(0xC0 | (c >> 6));
+			*out++ = (unsigned char)(0x80 | (c & 0x3F));
+		}
+		else if (c < 0x10000)
+		{
+			*out++ = (unsigned char)(0xE0 | (c >> 12));
+			*out++ = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+			*out++ = (unsigned char)(0x80 | (c & 0x3F));
+		}
+		else
+		{
+			*out++ = (unsigned char)(0xF0 | (c >> 18));
+			*out++ = (unsigned char)(0x80 | ((c >> 12) & 0x3F));
+			*out++ = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+			*out++ = (unsigned char)(0x80 | (c & 0x3F));
+		}
+	}
+	b->len = (char *)out - b->data;
+	return TRUE;
+}
+
+/* Microseconds since 1970-01-01, in the proleptic Gregorian calendar */
+static PY_LONG_LONG timestampMicroseconds(const TIMESTAMP_STRUCT *dt)
+{
+	int y = dt->year - (dt->month <= 2);
+	int era = (y >= 0 ? y : y - 399) / 400;
+	int yoe = y - era * 400;
+	int doy = (153 * (dt->month > 2 ? dt->month - 3 : dt->month + 9) + 2) / 5 + dt->day - 1;
+	int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	PY_LONG_LONG days = (PY_LONG_LONG)era * 146097 + doe - 719468;
+	return (((days * 24 + dt->hour) * 60 + dt->minute) * 60 + dt->second) * 1000000
+		+ dt->fraction / 1000;
+}
+
+/* Columns bound as integers, floats or timestamps have one fixed size value
+   per row, anything else has variable length data */
+static bool isFixedWidth(short vtype)
+{
+	return vtype == SQL_C_LONG || vtype == SQL_C_SBIGINT || vtype == SQL_C_DOUBLE
+		|| vtype == SQL_C_TIMESTAMP;
+}
+
+/* Appends one value - p and len as returned by the driver - to a column */
+static BOOL appendColumnValue(ColumnBuilder *col, short vtype, const char *p, SQLLEN len, SQLULEN row)
+{
+	unsigned char zero = 0;
+	while (col->nulls.len <= row / 8)
+		if (!appendColumnBuffer(&col->nulls, &zero, 1))
+			return FALSE;
+	if (len == SQL_NULL_DATA)
+	{
+		col->nulls.data[row / 8] |= (char)(1 << (row % 8));
+		p = NULL;
+		len = 0;
+	}
+	if (isFixedWidth(vtype))
+	{
+		PY_LONG_LONG ival = 0;
+		double dval = 0;
+		if (vtype == SQL_C_DOUBLE)
+		{
+			if (p)
+				dval = *(double *)p;
+			return appendColumnBuffer(&col->values, &dval, sizeof(dval));
+		}
+		if (p && vtype == SQL_C_LONG)
+			ival = *(SQLINTEGER *)p;
+		else if (p && vtype == SQL_C_SBIGINT)
+			ival = *(SQLBIGINT *)p;
+		else if (p)
+			ival = timestampMicroseconds((const TIMESTAMP_STRUCT *)p);
+		return appendColumnBuffer(&col->values, &ival, sizeof(ival));
+	}
+	else
+	{
+		PY_LONG_LONG end;
+		if (vtype == SQL_C_WCHAR)
+		{
+			if (!appendColumnUTF8(&col->data, (const WCHAR *)p, len / sizeof(WCHAR)))
+				return FALSE;
+		}
+		else if (!appendColumnBuffer(&col->data, p, len))
+			return FALSE;
+		end = col->data.len;
+		return appendColumnBuffer(&col->values, &end, sizeof(end));
+	}
+}
+
+/* @pymethod [(values, nulls) or (offsets, data, nulls), ...]|cursor|fetchcolumns|Fetch rows of data as one buffer per column */
+static PyObject *odbcCurFetchColumns(PyObject *self, PyObject *args)
+{
+	cursorObject *cur = cursor(self);
+	long max_rows = LONG_MAX;
+	SQLULEN n_rows = 0;
+	ColumnBuilder *cols = NULL;
+	OutputBinding *ob;
+	PyObject *ret = NULL;
+	int col;
+
+	/* @pyparm int|size|all remaining|Maximum number of rows to fetch */
+	if (!PyArg_ParseTuple(args, "|l:fetchcolumns", &max_rows))
+		return NULL;
+	if (max_rows < 0)
+		max_rows = 0;
+	/* @comm Values are copied from the driver's buffers straight into one
+	   contiguous buffer per column, without creating a Python object for
+	   each value.  The result has an item for each column of the result set.
+	   <nl>Integer, float and date columns are returned as (values, nulls),
+	   where values has a 64 bit integer (format 'q') or a double (format 'd')
+	   for each row.  Dates are integer microseconds since 1970-01-01, as found
+	   in the database with no adjustment for time zones.
+	   <nl>All other columns are returned as (offsets, data, nulls).  The
+	   value for row i is data[offsets[i]:offsets[i+1]], and offsets has an
+	   entry for each row plus one.  Unicode text is encoded as UTF-8, while
+	   binary and other character columns are as returned by the driver.
+	   <nl>nulls is a bitmap with bit (i % 8) of byte (i // 8) set when the
+	   value in row i is NULL.  The value in values (or the length in data) for
+	   a NULL is 0.
+	   <nl>On Python 3, values and offsets are memoryviews of the appropriate
+	   format, and data and nulls are bytes.  On Python 2 all are strings, with
+	   values in native byte order.
+	   <nl>The number of rows fetched is len(values), or len(offsets) - 1.
+	   Once there are no rows left, every column is empty. */
+	if (cur->n_columns <= 0)
+	{
+		PyErr_SetString(cur->cursorError, "No results.  Did you call execute()?");
+		return NULL;
+	}
+	cols = (ColumnBuilder *)calloc(cur->n_columns, sizeof(ColumnBuilder));
+	if (cols == NULL)
+		return PyErr_NoMemory();
+	for (col = 0, ob = cur->outputVars; ob; ob = ob->next, col++)
+	{
+		PY_LONG_LONG start = 0;
+		if (!isFixedWidth(ob->vtype) && !appendColumnBuffer(&cols[col].values, &start, sizeof(start)))
+			goto Cleanup;
+	}
+
+	while (n_rows < (SQLULEN)max_rows)
+	{
+		SQLULEN first, count, i;
+		int got = fetchBlock(cur, (long)(max_rows - n_rows));
+		if (got < 0)
+			goto Cleanup;
+		if (got == 0)
+			break;
+		first = cur->row_index;
+		count = cur->rows_fetched - first;
+		if (count > (SQLULEN)max_rows - n_rows)
+			count = (SQLULEN)max_rows - n_rows;
+		for (i = first; i < first + count; i++)
+			if (!checkRowStatus(cur, i))
+				goto Cleanup;
+		for (col = 0, ob = cur->outputVars; ob; ob = ob->next, col++)
+		{
+			for (i = 0; i < count; i++)
+			{
+				const char *p;
+				SQLLEN len;
+				if (ob->bGetData)
+				{
+					/* Long columns force a block of 1 row */
+					if (!getLongData(cur, ob))
+						goto Cleanup;
+					p = (const char *)ob->bind_area;
+					len = ob->rcode;
+				}
+				else
+				{
+					p = (const char *)ob->bind_area + (first + i) * ob->vsize;
+					len = boundLength(ob, ob->rcodes[first + i]);
+				}
+				if (!appendColumnValue(&cols[col], ob->vtype, p, len, n_rows + i))
+					goto Cleanup;
+			}
+		}
+		cur->row_index += count;
+		n_rows += count;
+	}
+
+	ret = PyList_New(cur->n_columns);
+	if (ret == NULL)
+		goto Cleanup;
+	for (col = 0, ob = cur->outputVars; ob; ob = ob->next, col++)
+	{
+		PyObject *item;
+		if (isFixedWidth(ob->vtype))
+			item = Py_BuildValue("NN",
+				columnBufferToPy(&cols[col].values, ob->vtype == SQL_C_DOUBLE ? "d" : "q"),
+				columnBufferToPy(&cols[col].nulls, NULL));
+		else
+			item = Py_BuildValue("NNN",
+				columnBufferToPy(&cols[col].values, "q"),
+				columnBufferToPy(&cols[col].data, NULL),
+				columnBufferToPy(&cols[col].nulls, NULL));
+		if (item == NULL)
+		{
+			Py_DECREF(ret);
+			ret = NULL;
+			goto Cleanup;
+		}
+		PyList_SET_ITEM(ret, col, item);
+	}
+
+Cleanup:
+	for (col = 0; col < cur->n_columns; col++)
+	{
+		free(cols[col].values.data);
+		free(cols[col].data.data);
+		free(cols[col].nulls.data);
+	}
+	free(cols);
+	return ret;
+}
+
 /* @pymethod |cursor|setinputsizes| */
 static PyObject *odbcCurSetInputSizes(PyObject *self, PyObject *args)
 {
@@ -1800,9 +2824,11 @@ static PyObject *odbcCurSetOutputSize(PyObject *self, PyObject *args)
 static PyMethodDef cursorMethods[] = {
   { "close", odbcCurClose, 1} , /* @pymeth close|Closes the cursor */
   { "execute", odbcCurExec, 1} , /* @pymeth execute|Execute some SQL */
+  { "executemany", odbcCurExecMany, 1} , /* @pymeth executemany|Execute some SQL once for each of a sequence of parameter sets */
   { "fetchone", odbcCurFetchOne, 1} , /* @pymeth fetchone|Fetch one row of data */
   { "fetchmany", odbcCurFetchMany, 1} , /* @pymeth fetchmany|Fetch many rows of data */
   { "fetchall", odbcCurFetchAll, 1} , /* @pymeth fetchall|Fetch all the rows of data */
+  { "fetchcolumns", odbcCurFetchColumns, 1} , /* @pymeth fetchcolumns|Fetch rows of data as one buffer per column */
   { "setinputsizes", odbcCurSetInputSizes, 1} , /* @pymeth setinputsizes| */
   { "setoutputsize", odbcCurSetOutputSize, 1} ,/* @pymeth setoutputsize| */
   {0,     0}
@@ -1811,6 +2837,15 @@ static PyMethodDef cursorMethods[] = {
 static PyMemberDef cursorMembers[] = {
 	{"description", T_OBJECT, offsetof(cursorObject, description), READONLY},
 	{"error", T_OBJECT, offsetof(cursorObject, cursorError), READONLY},
+	/* @prop int|arraysize|Default number of rows returned by <om cursor.fetchmany>,
+	   and the minimum number of rows requested from the driver at a time. */
+	{"arraysize", T_LONG, offsetof(cursorObject, arraysize), 0},
+	/* @prop int|batchsize|Number of parameter sets sent to the driver at a time by <om cursor.executemany> */
+	{"batchsize", T_LONG, offsetof(cursorObject, batchsize), 0},
+	/* @prop memoryview|paramstatus|After <om cursor.executemany>, the status (one of the
+	   odbc.SQL_PARAM_* constants) of each set of parameters that was attempted.  On Python 3
+	   this is a memoryview of format 'H', on Python 2 a string of native unsigned shorts. */
+	{"paramstatus", T_OBJECT, offsetof(cursorObject, paramstatus), READONLY},
 	{NULL}
 };
 
@@ -2062,6 +3097,11 @@ PYWIN_MODULE_INIT_FUNC(odbc)
 	dbiErrors[4] = DbiDataError;
 	dbiErrors[5] = DbiInternalError;
 
+	ADD_CONSTANT(SQL_PARAM_SUCCESS);
+	ADD_CONSTANT(SQL_PARAM_SUCCESS_WITH_INFO);
+	ADD_CONSTANT(SQL_PARAM_ERROR);
+	ADD_CONSTANT(SQL_PARAM_UNUSED);
+	ADD_CONSTANT(SQL_PARAM_DIAG_UNAVAILABLE);
 	ADD_CONSTANT(SQL_FETCH_NEXT);
 	ADD_CONSTANT(SQL_FETCH_FIRST);
 	ADD_CONSTANT(SQL_FETCH_LAST);
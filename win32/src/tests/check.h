@@ -0,0 +1,58 @@
+// check.h - the assertion used by the tests in this directory.  Unlike
+// assert(), it is never compiled out.  There is also a random number
+// generator for the fuzz tests, and tests which embed Python get a check
+// that Close() can be called by two threads at once.
+
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fflush(stdout); \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			exit(1); \
+		} \
+	} while (0)
+
+// A simple LCG, so runs are repeatable everywhere.  Each test program has
+// its own sequence.
+static inline unsigned int Random(void)
+{
+	static unsigned int seed = 1;
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+#ifdef Py_PYTHON_H
+#include <pthread.h>
+
+static void *CallClose(void *ob)
+{
+	PyGILState_STATE state = PyGILState_Ensure();
+	PyObject *ret = PyObject_CallMethod((PyObject *)ob, "Close", NULL);
+	CHECK(ret == Py_None);
+	Py_DECREF(ret);
+	PyGILState_Release(state);
+	return NULL;
+}
+
+// Calls ob.Close() on another thread and this one at once, which must
+// both succeed.
+static inline void CloseTwice(PyObject *ob)
+{
+	pthread_t thread;
+	CHECK(pthread_create(&thread, NULL, CallClose, ob) == 0);
+	PyObject *ret = PyObject_CallMethod(ob, "Close", NULL);
+	CHECK(ret == Py_None);
+	Py_DECREF(ret);
+	Py_BEGIN_ALLOW_THREADS
+	pthread_join(thread, NULL);
+	Py_END_ALLOW_THREADS
+}
+#endif
+
+#endif // __CHECK_H__
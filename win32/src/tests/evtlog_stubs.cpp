@@ -0,0 +1,146 @@
+// evtlog_stubs.cpp - the fake event log.
+
+#include "evtlog_stubs.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+int FakeEvtLog_Total = 1000;
+int FakeEvtLog_Next = 0;
+int FakeEvtLog_Open = 0;
+int FakeEvtLog_Bookmark = -1;
+
+static int EventNumber(EVT_HANDLE h)
+{
+	return (int)((uintptr_t)h - FAKE_EVENT_BASE);
+}
+
+BOOL EvtNext(EVT_HANDLE resultSet, DWORD size, EVT_HANDLE *events, DWORD timeout, DWORD flags, DWORD *returned)
+{
+	DWORD n = 0;
+	for (; n < size; n++) {
+		int next = __atomic_load_n(&FakeEvtLog_Next, __ATOMIC_SEQ_CST);
+		if (next >= FakeEvtLog_Total)
+			break;
+		__atomic_store_n(&FakeEvtLog_Next, next + 1, __ATOMIC_SEQ_CST);
+		events[n] = (EVT_HANDLE)(uintptr_t)(FAKE_EVENT_BASE + next);
+		__atomic_add_fetch(&FakeEvtLog_Open, 1, __ATOMIC_SEQ_CST);
+	}
+	if (n == 0) {
+		SetLastError(ERROR_NO_MORE_ITEMS);
+		return FALSE;
+	}
+	*returned = n;
+	return TRUE;
+}
+
+BOOL EvtRender(EVT_HANDLE context, EVT_HANDLE fragment, DWORD flags, DWORD bufferSize, void *buffer,
+	DWORD *bufferUsed, DWORD *propertyCount)
+{
+	int n = EventNumber(fragment);
+	if (n == -1) {
+		SetLastError(ERROR_INVALID_DATA);
+		return FALSE;
+	}
+	if (flags == EvtRenderEventXml) {
+		char xml[64];
+		int len = snprintf(xml, sizeof(xml), "<Event>%d</Event>", n);
+		*bufferUsed = (len + 1) * sizeof(WCHAR);
+		*propertyCount = 0;
+		if (bufferSize < *bufferUsed) {
+			SetLastError(ERROR_INSUFFICIENT_BUFFER);
+			return FALSE;
+		}
+		for (int i = 0; i <= len; i++)
+			((WCHAR *)buffer)[i] = xml[i];
+		return TRUE;
+	}
+	int len = n == 500 ? 3000 : n % 37;
+	// The string's terminator, rounded up so the array is aligned.
+	int strSize = (len + 2) & ~1;
+	DWORD needed = 3 * sizeof(EVT_VARIANT) + strSize * sizeof(WCHAR) + 3 * sizeof(UINT32);
+	*bufferUsed = needed;
+	*propertyCount = 3;
+	if (bufferSize < needed) {
+		SetLastError(ERROR_INSUFFICIENT_BUFFER);
+		return FALSE;
+	}
+	EVT_VARIANT *vals = (EVT_VARIANT *)buffer;
+	WCHAR *str = (WCHAR *)(vals + 3);
+	for (int i = 0; i < len; i++)
+		str[i] = 'a' + i % 26;
+	str[len] = 0;
+	UINT32 *arr = (UINT32 *)(str + strSize);
+	for (int i = 0; i < 3; i++)
+		arr[i] = n + i;
+	vals[0].Type = EvtVarTypeUInt32;
+	vals[0].UInt32Val = n;
+	vals[0].Count = 0;
+	vals[1].Type = n % 10 == 3 ? EvtVarTypeNull : EvtVarTypeString;
+	vals[1].StringVal = str;
+	vals[1].Count = 0;
+	vals[2].Type = EvtVarTypeHexInt32 | EVT_VARIANT_TYPE_ARRAY;
+	vals[2].UInt32Arr = arr;
+	vals[2].Count = 3;
+	return TRUE;
+}
+
+BOOL EvtUpdateBookmark(EVT_HANDLE bookmark, EVT_HANDLE event)
+{
+	FakeEvtLog_Bookmark = EventNumber(event);
+	return TRUE;
+}
+
+// The subscription.  Its lock is held while the callback is called, so
+// EvtClose waits for that to return.
+struct FakeSubscription
+{
+	pthread_mutex_t m;
+	EVT_SUBSCRIBE_CALLBACK callback;
+	void *context;
+	bool closed;
+};
+static FakeSubscription subscription = {PTHREAD_MUTEX_INITIALIZER};
+
+EVT_HANDLE EvtSubscribe(EVT_HANDLE session, HANDLE signalEvent, LPCWSTR channelPath, LPCWSTR query,
+	EVT_HANDLE bookmark, void *context, EVT_SUBSCRIBE_CALLBACK callback, DWORD flags)
+{
+	pthread_mutex_lock(&subscription.m);
+	subscription.callback = callback;
+	subscription.context = context;
+	subscription.closed = false;
+	pthread_mutex_unlock(&subscription.m);
+	return &subscription;
+}
+
+void FakeEvtLog_Deliver(EVT_SUBSCRIBE_NOTIFY_ACTION action, EVT_HANDLE event)
+{
+	pthread_mutex_lock(&subscription.m);
+	if (!subscription.closed)
+		subscription.callback(action, subscription.context, event);
+	pthread_mutex_unlock(&subscription.m);
+}
+
+BOOL EvtClose(EVT_HANDLE h)
+{
+	if (h == &subscription) {
+		pthread_mutex_lock(&subscription.m);
+		if (subscription.closed) {
+			fprintf(stderr, "the subscription was closed twice\n");
+			abort();
+		}
+		subscription.closed = true;
+		pthread_mutex_unlock(&subscription.m);
+		usleep(10000);	// as if waiting for a callback, giving others a chance to close it too
+	}
+	else
+		__atomic_sub_fetch(&FakeEvtLog_Open, 1, __ATOMIC_SEQ_CST);
+	return TRUE;
+}
+
+// Not produced by the fake log.
+PyObject *PyWinObject_FromIID(const GUID &iid) {Py_RETURN_NONE;}
+PyObject *PyWinObject_FromTimeStamp(const LARGE_INTEGER &ts) {Py_RETURN_NONE;}
+PyObject *PyWinObject_FromSYSTEMTIME(const SYSTEMTIME &st) {Py_RETURN_NONE;}
+PyObject *PyWinObject_FromSID(PSID sid) {Py_RETURN_NONE;}
+PyObject *PyWinObject_FromEVT_HANDLE(HANDLE h, PyObject *context) {Py_RETURN_NONE;}
@@ -0,0 +1,110 @@
+// evtlog_stubs.h - the parts of winevt.h and pywintypes used by the native
+// parts of win32evtlog.i, with fake Evt* functions serving a made up log
+// (see evtlog_stubs.cpp).
+//
+// The code under test is cut out of win32evtlog.i by the Makefile, and
+// included after this header.
+
+#ifndef __EVTLOG_STUBS_H__
+#define __EVTLOG_STUBS_H__
+
+#include "win32_stubs.h"
+
+typedef HANDLE EVT_HANDLE;
+
+// winevt.h
+enum {
+	EvtVarTypeNull, EvtVarTypeString, EvtVarTypeAnsiString, EvtVarTypeSByte, EvtVarTypeByte,
+	EvtVarTypeInt16, EvtVarTypeUInt16, EvtVarTypeInt32, EvtVarTypeUInt32, EvtVarTypeInt64,
+	EvtVarTypeUInt64, EvtVarTypeSingle, EvtVarTypeDouble, EvtVarTypeBoolean, EvtVarTypeBinary,
+	EvtVarTypeGuid, EvtVarTypeSizeT, EvtVarTypeFileTime, EvtVarTypeSysTime, EvtVarTypeSid,
+	EvtVarTypeHexInt32, EvtVarTypeHexInt64, EvtVarTypeEvtHandle = 32, EvtVarTypeEvtXml = 35
+};
+#define EVT_VARIANT_TYPE_MASK 0x7f
+#define EVT_VARIANT_TYPE_ARRAY 128
+
+typedef struct {
+	union {
+		BOOL BooleanVal;
+		INT8 SByteVal;
+		INT16 Int16Val;
+		INT32 Int32Val;
+		INT64 Int64Val;
+		UINT8 ByteVal;
+		UINT16 UInt16Val;
+		UINT32 UInt32Val;
+		UINT64 UInt64Val;
+		float SingleVal;
+		double DoubleVal;
+		ULONGLONG FileTimeVal;
+		SYSTEMTIME *SysTimeVal;
+		GUID *GuidVal;
+		LPCWSTR StringVal;
+		const char *AnsiStringVal;
+		BYTE *BinaryVal;
+		PSID SidVal;
+		size_t SizeTVal;
+		BOOL *BooleanArr;
+		INT8 *SByteArr;
+		INT16 *Int16Arr;
+		INT32 *Int32Arr;
+		INT64 *Int64Arr;
+		UINT8 *ByteArr;
+		UINT16 *UInt16Arr;
+		UINT32 *UInt32Arr;
+		UINT64 *UInt64Arr;
+		float *SingleArr;
+		double *DoubleArr;
+		FILETIME *FileTimeArr;
+		SYSTEMTIME *SysTimeArr;
+		GUID *GuidArr;
+		LPWSTR *StringArr;
+		char **AnsiStringArr;
+		PSID *SidArr;
+		size_t *SizeTArr;
+		EVT_HANDLE EvtHandleVal;
+		LPCWSTR XmlVal;
+		LPCWSTR *XmlValArr;
+	};
+	DWORD Count;
+	DWORD Type;
+} EVT_VARIANT, *PEVT_VARIANT;
+
+enum { EvtRenderEventValues, EvtRenderEventXml, EvtRenderBookmark };
+
+typedef int EVT_SUBSCRIBE_NOTIFY_ACTION;
+enum { EvtSubscribeActionError, EvtSubscribeActionDeliver };
+typedef DWORD (CALLBACK *EVT_SUBSCRIBE_CALLBACK)(EVT_SUBSCRIBE_NOTIFY_ACTION action, void *context, EVT_HANDLE event);
+
+BOOL EvtNext(EVT_HANDLE resultSet, DWORD size, EVT_HANDLE *events, DWORD timeout, DWORD flags, DWORD *returned);
+BOOL EvtRender(EVT_HANDLE context, EVT_HANDLE fragment, DWORD flags, DWORD bufferSize, void *buffer,
+	DWORD *bufferUsed, DWORD *propertyCount);
+BOOL EvtUpdateBookmark(EVT_HANDLE bookmark, EVT_HANDLE event);
+EVT_HANDLE EvtSubscribe(EVT_HANDLE session, HANDLE signalEvent, LPCWSTR channelPath, LPCWSTR query,
+	EVT_HANDLE bookmark, void *context, EVT_SUBSCRIBE_CALLBACK callback, DWORD flags);
+BOOL EvtClose(EVT_HANDLE h);
+
+// pywintypes
+PyObject *PyWinObject_FromIID(const GUID &iid);
+PyObject *PyWinObject_FromTimeStamp(const LARGE_INTEGER &ts);
+PyObject *PyWinObject_FromSYSTEMTIME(const SYSTEMTIME &st);
+PyObject *PyWinObject_FromSID(PSID sid);
+PyObject *PyWinObject_FromEVT_HANDLE(HANDLE h, PyObject *context = NULL);
+
+// The fake log holds events 0 to FakeEvtLog_Total - 1, whose handles are
+// FAKE_EVENT_BASE plus their number.  Each renders as three values: the
+// event number, a string of up to 36 letters (None for the events ending in 3,
+// and 3000 letters for event 500), and an array of 3 numbers.  As XML, they
+// render as "<Event>number</Event>".  Event -1 can't be rendered.
+#define FAKE_EVENT_BASE 100000
+#define FAKE_EVENT(n) ((EVT_HANDLE)(uintptr_t)(FAKE_EVENT_BASE + (n)))
+extern int FakeEvtLog_Total;
+extern int FakeEvtLog_Next;			// The next event EvtNext returns.
+extern int FakeEvtLog_Open;			// Event handles not yet closed.
+extern int FakeEvtLog_Bookmark;		// The event last passed to EvtUpdateBookmark.
+
+// Calls the callback of the subscription EvtSubscribe last made, as the
+// event log service would (once EvtClose has returned, nothing is called).
+void FakeEvtLog_Deliver(EVT_SUBSCRIBE_NOTIFY_ACTION action, EVT_HANDLE event);
+
+#endif // __EVTLOG_STUBS_H__
@@ -0,0 +1,122 @@
+// pdh_stubs.cpp - the fake PDH counters.
+
+#include "pdh_stubs.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+int FakePdh_Tick = 0;
+PDH_STATUS FakePdh_CollectStatus = 0;
+int FakePdh_CollectDelay = 0;
+
+static int growingReads = 0;
+
+static PDH_STATUS WINAPI FakePdhCollectQueryData(HQUERY hQuery)
+{
+	int delay = __atomic_load_n(&FakePdh_CollectDelay, __ATOMIC_SEQ_CST);
+	if (delay)
+		usleep(delay * 1000);
+	PDH_STATUS status = __atomic_load_n(&FakePdh_CollectStatus, __ATOMIC_SEQ_CST);
+	if (status == 0)
+		__atomic_add_fetch(&FakePdh_Tick, 1, __ATOMIC_SEQ_CST);
+	return status;
+}
+
+// Returns the number of instances of a counter, or -1 if the handle is invalid.
+static int NumInstances(HCOUNTER hCounter, int tick)
+{
+	switch ((uintptr_t)hCounter) {
+	case 1:
+	case 3:
+		return tick % 5 == 0 ? 5 : 3;
+	case 2:
+		return 0;
+	case 4:
+		return __atomic_add_fetch(&growingReads, 1, __ATOMIC_SEQ_CST);
+	default:
+		return -1;
+	}
+}
+
+// Writes the name of instance i, returning its length.
+static size_t InstanceName(HCOUNTER hCounter, int i, WCHAR *out)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "%s%d", (uintptr_t)hCounter == 3 ? FAKE_PDH_LONG_NAME : "inst", i);
+	size_t len = strlen(name);
+	for (size_t j = 0; j <= len; j++)
+		out[j] = name[j];
+	return len;
+}
+
+// Returns the size of a buffer holding n items followed by their names.
+static DWORD ArraySize(HCOUNTER hCounter, int n, size_t itemSize)
+{
+	WCHAR name[64];
+	DWORD size = n * itemSize;
+	for (int i = 0; i < n; i++)
+		size += (InstanceName(hCounter, i, name) + 1) * sizeof(WCHAR);
+	return size;
+}
+
+static PDH_STATUS WINAPI FakePdhGetFormattedCounterArray(HCOUNTER hCounter, DWORD dwFormat,
+	LPDWORD lpdwBufferSize, LPDWORD lpdwItemCount, PPDH_FMT_COUNTERVALUE_ITEM ItemBuffer)
+{
+	int tick = __atomic_load_n(&FakePdh_Tick, __ATOMIC_SEQ_CST);
+	int n = NumInstances(hCounter, tick);
+	if (n < 0)
+		return PDH_INVALID_HANDLE;
+	DWORD size = ArraySize(hCounter, n, sizeof(PDH_FMT_COUNTERVALUE_ITEM));
+	if (*lpdwBufferSize < size) {
+		*lpdwBufferSize = size;
+		return PDH_MORE_DATA;
+	}
+	WCHAR *names = (WCHAR *)(ItemBuffer + n);
+	for (int i = 0; i < n; i++) {
+		ItemBuffer[i].szName = names;
+		names += InstanceName(hCounter, i, names) + 1;
+		PDH_FMT_COUNTERVALUE *value = &ItemBuffer[i].FmtValue;
+		value->CStatus = tick == 1 && i == 1 ? PDH_CSTATUS_INVALID_DATA : PDH_CSTATUS_VALID_DATA;
+		if (dwFormat & PDH_FMT_DOUBLE)
+			value->doubleValue = tick * 10 + i;
+		else if (dwFormat & PDH_FMT_LONG)
+			value->longValue = tick * 10 + i;
+		else
+			value->largeValue = tick * 10 + i;
+	}
+	*lpdwBufferSize = size;
+	*lpdwItemCount = n;
+	return ERROR_SUCCESS;
+}
+
+static PDH_STATUS WINAPI FakePdhGetRawCounterArray(HCOUNTER hCounter,
+	LPDWORD lpdwBufferSize, LPDWORD lpdwItemCount, PPDH_RAW_COUNTER_ITEM ItemBuffer)
+{
+	int n = NumInstances(hCounter, __atomic_load_n(&FakePdh_Tick, __ATOMIC_SEQ_CST));
+	if (n < 0)
+		return PDH_INVALID_HANDLE;
+	DWORD size = ArraySize(hCounter, n, sizeof(PDH_RAW_COUNTER_ITEM));
+	if (*lpdwBufferSize < size) {
+		*lpdwBufferSize = size;
+		return PDH_MORE_DATA;
+	}
+	WCHAR *names = (WCHAR *)(ItemBuffer + n);
+	for (int i = 0; i < n; i++) {
+		ItemBuffer[i].szName = names;
+		names += InstanceName(hCounter, i, names) + 1;
+		PDH_RAW_COUNTER *raw = &ItemBuffer[i].RawValue;
+		raw->CStatus = PDH_CSTATUS_VALID_DATA;
+		raw->TimeStamp.dwLowDateTime = 5;
+		raw->TimeStamp.dwHighDateTime = 1;
+		raw->FirstValue = -i;
+		raw->SecondValue = 1LL << 40;
+		raw->MultiCount = 1;
+	}
+	*lpdwBufferSize = size;
+	*lpdwItemCount = n;
+	return ERROR_SUCCESS;
+}
+
+FuncPdhCollectQueryData pPdhCollectQueryData = FakePdhCollectQueryData;
+FuncPdhGetFormattedCounterArray pPdhGetFormattedCounterArray = FakePdhGetFormattedCounterArray;
+FuncPdhGetRawCounterArray pPdhGetRawCounterArray = FakePdhGetRawCounterArray;
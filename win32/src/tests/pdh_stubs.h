@@ -0,0 +1,87 @@
+// pdh_stubs.h - the parts of pdh.h and pdhmsg.h used by the counter array
+// functions and the Sampler in win32pdhmodule.cpp, with fake PDH functions
+// serving made up counters (see pdh_stubs.cpp).
+//
+// The code under test is cut out of win32pdhmodule.cpp by the Makefile, and
+// included after this header.
+
+#ifndef __PDH_STUBS_H__
+#define __PDH_STUBS_H__
+
+#include "win32_stubs.h"
+
+// pdh.h
+typedef long PDH_STATUS;
+typedef HANDLE HQUERY;
+typedef HANDLE HCOUNTER;
+
+#define PDH_FMT_LONG 0x00000100
+#define PDH_FMT_DOUBLE 0x00000200
+#define PDH_FMT_LARGE 0x00000400
+#define PDH_FMT_NOSCALE 0x00001000
+
+typedef struct {
+	DWORD CStatus;
+	union {
+		long longValue;
+		double doubleValue;
+		LONGLONG largeValue;
+	};
+} PDH_FMT_COUNTERVALUE;
+
+typedef struct {
+	LPWSTR szName;
+	PDH_FMT_COUNTERVALUE FmtValue;
+} PDH_FMT_COUNTERVALUE_ITEM, *PPDH_FMT_COUNTERVALUE_ITEM;
+
+typedef struct {
+	DWORD CStatus;
+	FILETIME TimeStamp;
+	LONGLONG FirstValue;
+	LONGLONG SecondValue;
+	DWORD MultiCount;
+} PDH_RAW_COUNTER;
+
+typedef struct {
+	LPWSTR szName;
+	PDH_RAW_COUNTER RawValue;
+} PDH_RAW_COUNTER_ITEM, *PPDH_RAW_COUNTER_ITEM;
+
+// pdhmsg.h
+#define PDH_CSTATUS_VALID_DATA 0x00000000
+#define PDH_CSTATUS_NEW_DATA 0x00000001
+#define PDH_MORE_DATA ((PDH_STATUS)0x800007D2L)
+#define PDH_NO_DATA ((PDH_STATUS)0x800007D5L)
+#define PDH_CSTATUS_INVALID_DATA ((PDH_STATUS)0xC0000BBAL)
+#define PDH_MEMORY_ALLOCATION_FAILURE ((PDH_STATUS)0xC0000BBBL)
+#define PDH_INVALID_HANDLE ((PDH_STATUS)0xC0000BBCL)
+#define PDH_INSUFFICIENT_BUFFER ((PDH_STATUS)0xC0000BC2L)
+
+// The entry points, as win32pdhmodule.cpp loads them from pdh.dll.
+typedef PDH_STATUS (WINAPI *FuncPdhCollectQueryData)(HQUERY hQuery);
+typedef PDH_STATUS (WINAPI *FuncPdhGetFormattedCounterArray)(HCOUNTER hCounter, DWORD dwFormat,
+	LPDWORD lpdwBufferSize, LPDWORD lpdwItemCount, PPDH_FMT_COUNTERVALUE_ITEM ItemBuffer);
+typedef PDH_STATUS (WINAPI *FuncPdhGetRawCounterArray)(HCOUNTER hCounter,
+	LPDWORD lpdwBufferSize, LPDWORD lpdwItemCount, PPDH_RAW_COUNTER_ITEM ItemBuffer);
+extern FuncPdhCollectQueryData pPdhCollectQueryData;
+extern FuncPdhGetFormattedCounterArray pPdhGetFormattedCounterArray;
+extern FuncPdhGetRawCounterArray pPdhGetRawCounterArray;
+
+#define CHECK_PDH_PTR(ptr) if((ptr)==NULL) { PyErr_Format(PyExc_RuntimeError, "The pdh.dll entry point function %s could not be loaded.", #ptr); return NULL;}
+
+// The fake counters are identified by their handles:
+//   1  instances "inst0" to "inst2", or to "inst4" when the tick is a
+//      multiple of 5.  Instance i's value is tick * 10 + i, except that
+//      instance 1 has no data on tick 1.
+//   2  no instances.
+//   3  as 1, with names too long to be cached.
+//   4  one more instance each time it is read, so never fits the buffer.
+//   Any other handle is invalid.
+// Raw values are: status 0, time stamp 0x100000005, first value -i, second
+// value 1 << 40 and multi count 1.
+#define FAKE_PDH_LONG_NAME "an-instance-name-too-long-for-the-cache-"
+extern int FakePdh_Tick;				// Collections so far.
+extern PDH_STATUS FakePdh_CollectStatus;	// Returned by PdhCollectQueryData, if not 0.
+extern int FakePdh_CollectDelay;		// Milliseconds each collection takes.
+
+#endif // __PDH_STUBS_H__
@@ -0,0 +1,212 @@
+// Tests of PyDirWatchBatcher in win32file_notify.h: the coalescing rules,
+// rescans, readiness, and that cancelled events are reclaimed so a busy
+// but cancelling directory never overflows the batch.
+
+#include "../win32file_notify.h"
+#include "check.h"
+
+#include <string>
+#include <vector>
+
+typedef std::vector<unsigned short> Name;
+
+static Name NameOf(const char *s)
+{
+	Name ret;
+	while (*s)
+		ret.push_back((unsigned char)*s++);
+	return ret;
+}
+
+static void Add(PyDirWatchBatcher &b, int watchId, unsigned int action, const char *name,
+	unsigned long long now = 0)
+{
+	Name w = NameOf(name);
+	b.Add(watchId, action, w.empty() ? NULL : &w[0], w.size(), now);
+}
+
+// The live events, as "watch:action:name ..." (action in hex), after
+// checking the live count.
+static std::string Dump(PyDirWatchBatcher &b)
+{
+	std::string ret;
+	size_t live = 0;
+	for (size_t i = 0; i < b.NumEvents(); i++) {
+		const PyDirWatchEvent *ev = b.Event(i);
+		if (!ev->Live)
+			continue;
+		live++;
+		char prefix[32];
+		snprintf(prefix, sizeof(prefix), "%d:%x:", ev->WatchId, ev->Action);
+		ret += prefix;
+		const unsigned short *p = (const unsigned short *)b.Name(ev);
+		for (size_t k = 0; k < ev->NameLength; k++)
+			ret += (char)p[k];
+		ret += " ";
+	}
+	CHECK(live == b.NumLive());
+	return ret;
+}
+
+static void TestRules(void)
+{
+	PyDirWatchBatcher b;
+	b.Init(100, 1000, 1000);
+	CHECK(b.TimeUntilReady(0) == PyDirWatchBatcher::NOT_READY);
+	Add(b, 1, FILE_ACTION_ADDED, "a", 0);
+	Add(b, 1, FILE_ACTION_MODIFIED, "a", 10);	// merged into the add
+	Add(b, 1, FILE_ACTION_MODIFIED, "b", 20);
+	Add(b, 1, FILE_ACTION_MODIFIED, "b", 30);	// merged
+	Add(b, 2, FILE_ACTION_MODIFIED, "b", 40);	// another watch
+	Add(b, 1, FILE_ACTION_REMOVED, "a", 50);	// cancels the add
+	Add(b, 1, FILE_ACTION_REMOVED, "b", 60);	// replaces the modify
+	Add(b, 1, FILE_ACTION_REMOVED, "c", 60);
+	Add(b, 1, FILE_ACTION_ADDED, "c", 61);
+	Add(b, 1, FILE_ACTION_REMOVED, "c", 62);
+	Add(b, 1, FILE_ACTION_RENAMED_OLD_NAME, "d", 63);
+	Add(b, 1, FILE_ACTION_RENAMED_NEW_NAME, "e", 63);
+	Add(b, 1, FILE_ACTION_MODIFIED, "e", 64);	// renames are kept as-is
+	Add(b, 1, FILE_ACTION_MODIFIED, "e", 64);
+	CHECK(Dump(b) == "2:3:b 1:2:b 1:2:c 1:4:d 1:5:e 1:3:e ");
+
+	// Debounced, but only up to MaxDelay after the first event.
+	CHECK(b.TimeUntilReady(64) == 100);
+	CHECK(b.TimeUntilReady(164) == 0);
+	for (int i = 1; i < 20; i++)
+		Add(b, 1, FILE_ACTION_MODIFIED, "f", 64 + i * 50);
+	CHECK(b.TimeUntilReady(1000 - 1) == 1);
+	CHECK(b.TimeUntilReady(1000) == 0);
+
+	// A rescan replaces the watch's events, and absorbs later ones.
+	b.Rescan(2, 70);
+	Add(b, 2, FILE_ACTION_ADDED, "x", 71);
+	b.Rescan(2, 72);
+	CHECK(Dump(b) == "1:2:b 1:2:c 1:4:d 1:5:e 1:3:e 1:3:f 2:1000: ");
+	b.Stopped(1, 73);
+	CHECK(Dump(b) == "1:2:b 1:2:c 1:4:d 1:5:e 1:3:e 1:3:f 2:1000: 1:1001: ");
+
+	PyDirWatchBatcher taken;
+	b.MoveTo(&taken);
+	CHECK(b.NumLive() == 0 && b.NumEvents() == 0);
+	CHECK(taken.NumLive() == 8);
+	taken.Free();
+
+	// Forgetting a watch drops its events, and empties the batch when
+	// nothing else is left.
+	Add(b, 1, FILE_ACTION_ADDED, "a");
+	Add(b, 2, FILE_ACTION_ADDED, "a");
+	b.Forget(1);
+	CHECK(Dump(b) == "2:1:a ");
+	b.Forget(2);
+	CHECK(b.NumEvents() == 0 && b.TimeUntilReady(0) == PyDirWatchBatcher::NOT_READY);
+	b.Free();
+}
+
+static void TestAddBuffer(void)
+{
+	PyDirWatchBatcher b;
+	b.Init(100, 1000, 1000);
+	// One record named "a", then a next entry offset which is too small.
+	unsigned char buf[16] = {0};
+	unsigned int next = 4, action = FILE_ACTION_ADDED, nameBytes = 2;
+	memcpy(buf, &next, 4);
+	memcpy(buf + 4, &action, 4);
+	memcpy(buf + 8, &nameBytes, 4);
+	buf[12] = 'a';
+	b.AddBuffer(3, buf, sizeof(buf), 0);
+	CHECK(Dump(b) == "3:1000: ");
+	next = 0;
+	memcpy(buf, &next, 4);
+	b.AddBuffer(4, buf, sizeof(buf), 0);
+	CHECK(Dump(b) == "3:1000: 4:1:a ");
+	b.Free();
+}
+
+static void TestMaxEvents(void)
+{
+	PyDirWatchBatcher b;
+	b.Init(100, 1000, 10);
+	char name[16];
+	for (int i = 0; i < 20; i++) {
+		snprintf(name, sizeof(name), "f%d", i);
+		Add(b, i % 2 ? 1 : 3, FILE_ACTION_ADDED, name);
+	}
+	// The watch adding the event which doesn't fit gets a rescan.
+	std::string got = Dump(b);
+	CHECK(b.NumLive() <= 11);
+	CHECK(got.find("1:1000: ") != std::string::npos);
+	CHECK(got.find("3:1000: ") != std::string::npos);
+	b.Free();
+}
+
+static void TestReclaim(void)
+{
+	PyDirWatchBatcher b;
+	b.Init(100, 1000, 100);
+	Add(b, 1, FILE_ACTION_ADDED, "keep");
+	Add(b, 1, FILE_ACTION_ADDED, "x");
+	Add(b, 1, FILE_ACTION_RENAMED_OLD_NAME, "x");
+	// A temporary file created and deleted over and over.
+	for (int i = 0; i < 10000; i++) {
+		Add(b, 1, FILE_ACTION_ADDED, "tmp", i);
+		Add(b, 1, FILE_ACTION_REMOVED, "tmp", i);
+	}
+	CHECK(Dump(b) == "1:1:keep 1:1:x 1:4:x ");
+	CHECK(b.NumEvents() < 200);
+	// Compacting kept what was tracked: keep still merges and cancels...
+	Add(b, 1, FILE_ACTION_MODIFIED, "keep");
+	CHECK(b.NumLive() == 3);
+	// ...while x was renamed away, so removing it doesn't cancel the add.
+	Add(b, 1, FILE_ACTION_REMOVED, "x");
+	CHECK(b.NumLive() == 4);
+	Add(b, 1, FILE_ACTION_REMOVED, "keep");
+	CHECK(Dump(b) == "1:1:x 1:4:x 1:2:x ");
+	// Live events beyond MaxEvents still switch to a rescan.
+	char name[16];
+	for (int i = 0; i < 200; i++) {
+		snprintf(name, sizeof(name), "n%d", i);
+		Add(b, 2, FILE_ACTION_ADDED, name, 5);
+	}
+	std::string got = Dump(b);
+	CHECK(got.find("2:1000: ") == got.rfind("2:1000: "));
+	CHECK(got.find("2:1000: ") != std::string::npos);
+	b.Free();
+}
+
+static void TestRandom(void)
+{
+	PyDirWatchBatcher b;
+	b.Init(100, 1000, 500);
+	char name[16];
+	for (int i = 0; i < 300000; i++) {
+		snprintf(name, sizeof(name), "g%u", Random() % 700);
+		unsigned int r = Random() % 100;
+		if (r == 0)
+			b.Rescan(Random() % 5, i);
+		else if (r == 1)
+			b.Forget(Random() % 5);
+		else
+			Add(b, Random() % 5, 1 + Random() % 6, name, i);
+		if (i % 1000 == 0)
+			Dump(b);
+		if (i % 50000 == 0) {
+			PyDirWatchBatcher taken;
+			b.MoveTo(&taken);
+			taken.Free();
+		}
+	}
+	Dump(b);
+	CHECK(b.NumLive() <= 500 + 5);
+	b.Free();
+}
+
+int main(void)
+{
+	TestRules();
+	TestAddBuffer();
+	TestMaxEvents();
+	TestReclaim();
+	TestRandom();
+	printf("OK\n");
+	return 0;
+}
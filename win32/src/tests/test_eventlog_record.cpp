@@ -0,0 +1,205 @@
+// Tests of PyWinEventLogRecord.h, with the records test_win32evtlog.py
+// uses (see there for what they hold).
+//
+// * The three records parse, with the names, strings, SID and data expected.
+// * Filters match on event ID (with or without the severity bits), event
+//   type and source name, ignoring case.
+// * A record cut short anywhere, or whose string, SID or data offset or
+//   length points past its end, is rejected.
+// * A record with random header bytes overwritten is parsed or rejected
+//   without reading past its end - Parse() hands each one over in its own
+//   heap block, so ASan would see it.
+
+#include "../PyWinEventLogRecord.h"
+#include "check.h"
+
+#include <stddef.h>
+#include <vector>
+
+static const char RECORDS[] =
+	"a80000004c664c6501000000006d7c4d016d7c4d070000400400020003000000"
+	"00000000800000000c0000007400000002000000a00000005300650072007600"
+	"690063006500200043006f006e00740072006f006c0020004d0061006e006100"
+	"670065007200000048004f005300540000000000010100000000000512000000"
+	"530070006f006f006c00650072000000720075006e006e0069006e0067000000"
+	"01020000a80000007c0000004c664c6502000000006d7c4d016d7c4de8030000"
+	"0100010003000000000000006800000000000000680000000000000078000000"
+	"4100700070006c00690063006100740069006f006e0020004500720072006f00"
+	"7200000048004f0053005400000000006100700070002e006500780065000000"
+	"7c000000540000004c664c6503000000006d7c4d016d7c4d050000c002000000"
+	"030000000000000050000000000000005000000000000000500000004d007900"
+	"410070007000000048004f00530054000000000054000000";
+
+typedef std::vector<unsigned char> Buffer;
+
+static Buffer Unhex(const char *hex)
+{
+	Buffer ret;
+	for (; hex[0] && hex[1]; hex += 2) {
+		unsigned int byte;
+		CHECK(sscanf(hex, "%2x", &byte) == 1);
+		ret.push_back((unsigned char)byte);
+	}
+	return ret;
+}
+
+// Parses a heap copy of the first size bytes of b.
+static size_t Parse(const Buffer &b, size_t size, PyWinEventLogRecordInfo *info)
+{
+	unsigned char *copy = (unsigned char *)malloc(size ? size : 1);
+	CHECK(copy != NULL);
+	if (size)
+		memcpy(copy, &b[0], size);
+	size_t len = PyWinEventLog_ParseRecord(copy, size, info);
+	if (len) {
+		// Read everything found, for ASan.
+		unsigned int sum = 0;
+		for (size_t i = 0; i < info->sourceNameLen; i++)
+			sum += info->sourceName[i];
+		for (size_t i = 0; i < info->computerNameLen; i++)
+			sum += info->computerName[i];
+		if (info->sid)
+			for (size_t i = 0; i < info->header.UserSidLength; i++)
+				sum += info->sid[i];
+		for (size_t i = 0; i < info->header.DataLength; i++)
+			sum += info->data[i];
+		(void)sum;
+		CHECK(len <= size);
+	}
+	free(copy);
+	// The pointers are no longer valid.
+	info->sourceName = info->computerName = info->strings = NULL;
+	info->sid = info->data = NULL;
+	return len;
+}
+
+static bool SameName(const PyWinUTF16 *name, size_t len, const char *expected)
+{
+	if (len != strlen(expected))
+		return false;
+	for (size_t i = 0; i < len; i++)
+		if (name[i] != (unsigned char)expected[i])
+			return false;
+	return true;
+}
+
+static void TestParse(void)
+{
+	Buffer b = Unhex(RECORDS);
+	size_t offset = 0;
+	unsigned int numbers[3], numStrings[3];
+	int n = 0;
+	while (offset < b.size()) {
+		PyWinEventLogRecordInfo info;
+		size_t len = PyWinEventLog_ParseRecord(&b[offset], b.size() - offset, &info);
+		CHECK(len != 0 && n < 3);
+		CHECK(SameName(info.computerName, info.computerNameLen, "HOST"));
+		numbers[n] = info.header.RecordNumber;
+		numStrings[n] = info.header.NumStrings;
+		if (n == 0) {
+			CHECK(SameName(info.sourceName, info.sourceNameLen, "Service Control Manager"));
+			CHECK(SameName(info.strings, 7, "Spooler"));
+			CHECK(info.sid != NULL && info.header.UserSidLength == 12);
+			CHECK(info.header.DataLength == 2 && info.data[0] == 1 && info.data[1] == 2);
+		}
+		else
+			CHECK(info.sid == NULL);
+		offset += len;
+		n++;
+	}
+	CHECK(n == 3);
+	CHECK(numbers[0] == 1 && numbers[1] == 2 && numbers[2] == 3);
+	CHECK(numStrings[0] == 2 && numStrings[1] == 1 && numStrings[2] == 0);
+}
+
+static bool Matches(const PyWinEventLogFilter &filter, const Buffer &b)
+{
+	PyWinEventLogRecordInfo info;
+	CHECK(PyWinEventLog_ParseRecord(&b[0], b.size(), &info));
+	return PyWinEventLog_Match(&filter, &info) != 0;
+}
+
+static void TestFilter(void)
+{
+	Buffer b = Unhex(RECORDS);
+	PyWinEventLogFilter filter;
+	memset(&filter, 0, sizeof(filter));
+	CHECK(Matches(filter, b));
+
+	// The first record's EventID is 0x40000007.
+	unsigned int ids[] = {7, 1000};
+	filter.eventIDs = ids;
+	filter.numEventIDs = 2;
+	CHECK(Matches(filter, b));
+	filter.numEventIDs = 1;
+	ids[0] = 0x40000007;
+	CHECK(Matches(filter, b));
+	ids[0] = 8;
+	CHECK(!Matches(filter, b));
+	filter.numEventIDs = 0;
+
+	filter.typeMask = 4;	// EVENTLOG_INFORMATION_TYPE
+	CHECK(Matches(filter, b));
+	filter.typeMask = 1 | 2;
+	CHECK(!Matches(filter, b));
+	filter.typeMask = 0;
+
+	const char *name = "service control MANAGER";
+	PyWinUTF16 wide[32];
+	for (size_t i = 0; name[i]; i++)
+		wide[i] = name[i];
+	filter.sourceName = wide;
+	filter.sourceNameLen = strlen(name);
+	CHECK(Matches(filter, b));
+	filter.sourceNameLen--;
+	CHECK(!Matches(filter, b));
+}
+
+static void TestTruncated(void)
+{
+	Buffer b = Unhex(RECORDS);
+	PyWinEventLogRecordInfo info;
+	size_t length = Parse(b, b.size(), &info);
+	CHECK(length == 0xa8);
+	for (size_t size = 0; size < length; size++)
+		CHECK(Parse(b, size, &info) == 0);
+	// Offsets and lengths outside the record.
+	size_t fields[] = {
+		offsetof(PyWinEventLogHeader, StringOffset),
+		offsetof(PyWinEventLogHeader, UserSidLength),
+		offsetof(PyWinEventLogHeader, UserSidOffset),
+		offsetof(PyWinEventLogHeader, DataLength),
+		offsetof(PyWinEventLogHeader, DataOffset),
+	};
+	unsigned int values[] = {(unsigned int)length, (unsigned int)length + 4, 0xfffffffc};
+	for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+		for (size_t j = 0; j < sizeof(values) / sizeof(values[0]); j++) {
+			Buffer bad(b.begin(), b.begin() + length);
+			memcpy(&bad[fields[i]], &values[j], 4);
+			CHECK(Parse(bad, bad.size(), &info) == 0);
+		}
+}
+
+static void TestFuzz(void)
+{
+	Buffer records = Unhex(RECORDS);
+	PyWinEventLogRecordInfo info;
+	for (int i = 0; i < 200000; i++) {
+		// Corrupt a few bytes of one of the records.
+		size_t start = i % 3 == 0 ? 0 : i % 3 == 1 ? 0xa8 : 0xa8 + 0x7c;
+		Buffer b(records.begin() + start, records.end());
+		for (unsigned int n = 1 + Random() % 4; n > 0; n--)
+			b[Random() % 0x54] = (unsigned char)Random();
+		Parse(b, 1 + Random() % b.size(), &info);
+	}
+}
+
+int main(void)
+{
+	TestParse();
+	TestFilter();
+	TestTruncated();
+	TestFuzz();
+	printf("OK\n");
+	return 0;
+}
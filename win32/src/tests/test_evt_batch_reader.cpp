@@ -0,0 +1,137 @@
+// Tests of win32evtlog.EvtBatchReader against the fake event log in
+// evtlog_stubs.cpp, run with an embedded Python.
+//
+// * Every event is returned once, in order, with its values, however the
+//   batches and buffers are sized.
+// * The bookmark follows the batches returned.
+// * Every event is closed once the reader is gone, even if it was closed
+//   with batches still queued.
+// * Two threads closing the reader at once stop its thread once.
+
+#include "evtlog_stubs.h"
+#include "evtlog_reader.inc"
+#include "check.h"
+
+#include <unistd.h>
+
+static PyObject *NewReader(int batchSize, int prefetch, int bufferSize)
+{
+	PyObject *args = Py_BuildValue("(iiiiiii)", 1, 2, 3, batchSize, -1, prefetch, bufferSize);
+	CHECK(args != NULL);
+	PyObject *reader = PyEvtBatchReader_New(NULL, args, NULL);
+	Py_DECREF(args);
+	if (reader == NULL)
+		PyErr_Print();
+	CHECK(reader != NULL);
+	return reader;
+}
+
+static void CheckRow(PyObject *row, long n)
+{
+	CHECK(PyTuple_Check(row) && PyTuple_GET_SIZE(row) == 3);
+	CHECK(PyLong_AsLong(PyTuple_GET_ITEM(row, 0)) == n);
+	PyObject *str = PyTuple_GET_ITEM(row, 1);
+	if (n % 10 == 3)
+		CHECK(str == Py_None);
+	else
+		CHECK(PyUnicode_Check(str) && PyUnicode_GET_LENGTH(str) == (n == 500 ? 3000 : n % 37));
+	PyObject *arr = PyTuple_GET_ITEM(row, 2);
+	CHECK(PySequence_Check(arr) && PySequence_Size(arr) == 3);
+}
+
+static void TestReadAll(int batchSize, int prefetch, int bufferSize)
+{
+	printf("batches of %d, prefetch %d, %d byte buffers\n", batchSize, prefetch, bufferSize);
+	FakeEvtLog_Total = 1000;
+	FakeEvtLog_Next = 0;
+	FakeEvtLog_Bookmark = -1;
+	PyObject *reader = NewReader(batchSize, prefetch, bufferSize);
+	PyObject *first = PyObject_CallMethod(reader, "Next", "(i)", 5000);
+	CHECK(first != NULL && PyList_Check(first));
+	long n = 0;
+	for (; n < PyList_GET_SIZE(first); n++)
+		CheckRow(PyList_GET_ITEM(first, n), n);
+	Py_DECREF(first);
+	CHECK(n > 0 && n <= batchSize);
+	CHECK(FakeEvtLog_Bookmark == n - 1);
+	PyObject *iter = PyObject_GetIter(reader);
+	CHECK(iter != NULL);
+	PyObject *row;
+	while ((row = PyIter_Next(iter)) != NULL) {
+		CheckRow(row, n++);
+		Py_DECREF(row);
+	}
+	CHECK(!PyErr_Occurred());
+	Py_DECREF(iter);
+	CHECK(n == 1000);
+	CHECK(FakeEvtLog_Bookmark == 999);
+	PyObject *finished = PyObject_GetAttrString(reader, "Finished");
+	CHECK(finished == Py_True);
+	Py_DECREF(finished);
+	PyObject *last = PyObject_CallMethod(reader, "Next", "(i)", 0);
+	CHECK(last != NULL && PyList_GET_SIZE(last) == 0);
+	Py_DECREF(last);
+	Py_DECREF(reader);
+	CHECK(FakeEvtLog_Open == 0);
+}
+
+static void TestClose(void)
+{
+	printf("close with batches queued\n");
+	FakeEvtLog_Total = 5000;
+	FakeEvtLog_Next = 0;
+	PyObject *reader = NewReader(64, 3, 4096);
+	// Let the thread fill the queue.
+	usleep(100000);
+	PyObject *rows = PyObject_CallMethod(reader, "Next", NULL);
+	CHECK(rows != NULL && PyList_GET_SIZE(rows) > 0);
+	Py_DECREF(rows);
+	PyObject *ret = PyObject_CallMethod(reader, "Close", NULL);
+	CHECK(ret == Py_None);
+	Py_DECREF(ret);
+	CHECK(PyObject_CallMethod(reader, "Next", NULL) == NULL);
+	CHECK(PyErr_ExceptionMatches(PyExc_ValueError));
+	PyErr_Clear();
+	Py_DECREF(reader);
+	CHECK(FakeEvtLog_Open == 0);
+}
+
+static void TestCloseTwice(void)
+{
+	printf("close on two threads\n");
+	FakeEvtLog_Total = 5000;
+	FakeEvtLog_Next = 0;
+	PyObject *reader = NewReader(64, 3, 4096);
+	CloseTwice(reader);
+	Py_DECREF(reader);
+	CHECK(FakeEvtLog_Open == 0);
+}
+
+static void TestBadArgs(void)
+{
+	PyObject *args = Py_BuildValue("(iO)", 1, Py_None);
+	CHECK(PyEvtBatchReader_New(NULL, args, NULL) == NULL);
+	CHECK(PyErr_ExceptionMatches(PyExc_ValueError));
+	PyErr_Clear();
+	Py_DECREF(args);
+	args = Py_BuildValue("(iiii)", 1, 2, 3, 0);
+	CHECK(PyEvtBatchReader_New(NULL, args, NULL) == NULL);
+	CHECK(PyErr_ExceptionMatches(PyExc_ValueError));
+	PyErr_Clear();
+	Py_DECREF(args);
+}
+
+int main(void)
+{
+	Py_Initialize();
+	CHECK(PyType_Ready(&PyEvtBatchReader::type) == 0);
+	TestReadAll(64, 3, 4096);
+	TestReadAll(1, 1, 64);
+	TestReadAll(256, 2, 0x40000);
+	TestClose();
+	TestCloseTwice();
+	TestBadArgs();
+	Py_Finalize();
+	printf("OK\n");
+	return 0;
+}
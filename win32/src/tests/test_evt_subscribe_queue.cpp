@@ -0,0 +1,185 @@
+// Tests of win32evtlog.EvtSubscribeQueue against the fake event log in
+// evtlog_stubs.cpp, run with an embedded Python.
+//
+// * Events delivered by another thread are all returned, in order, when
+//   the callback waits for room - and counted as dropped when it doesn't.
+// * Errors are raised after the events queued before them.
+// * Closing the queue releases a callback waiting for room, and no more
+//   events are delivered once it returns.  Two threads closing it at once
+//   end the subscription once.
+
+#include "evtlog_stubs.h"
+#include "evtlog_reader.inc"
+#include "evtlog_queue.inc"
+#include "check.h"
+
+#include <pthread.h>
+
+static PyObject *NewQueue(const char *format, ...)
+{
+	va_list va;
+	va_start(va, format);
+	PyObject *kwargs = Py_VaBuildValue(format, va);
+	va_end(va);
+	PyObject *args = Py_BuildValue("(si)", "Application", 1);
+	CHECK(args != NULL && kwargs != NULL);
+	PyObject *queue = PyEvtSubscribeQueue(NULL, args, kwargs);
+	Py_DECREF(args);
+	Py_DECREF(kwargs);
+	if (queue == NULL)
+		PyErr_Print();
+	CHECK(queue != NULL);
+	return queue;
+}
+
+static long GetLong(PyObject *queue, const char *name)
+{
+	PyObject *value = PyObject_GetAttrString(queue, name);
+	CHECK(value != NULL);
+	long ret = PyLong_AsLong(value);
+	Py_DECREF(value);
+	return ret;
+}
+
+static void *Deliver(void *arg)
+{
+	long count = (long)arg;
+	for (long n = 0; n < count; n++)
+		FakeEvtLog_Deliver(EvtSubscribeActionDeliver, FAKE_EVENT(n));
+	return NULL;
+}
+
+static void TestWaitForRoom(void)
+{
+	printf("wait for room\n");
+	PyObject *queue = NewQueue("{s:i,s:i,s:i,s:i}", "Context", 5, "BatchSize", 8,
+		"MaxBatches", 4, "FullTimeout", -1);
+	const long count = 2000;
+	pthread_t thread;
+	CHECK(pthread_create(&thread, NULL, Deliver, (void *)count) == 0);
+	long n = 0;
+	while (n < count) {
+		PyObject *rows = PyObject_CallMethod(queue, "Get", "(i)", 5000);
+		CHECK(rows != NULL && rows != Py_None);
+		for (Py_ssize_t i = 0; i < PyList_GET_SIZE(rows); i++) {
+			PyObject *row = PyList_GET_ITEM(rows, i);
+			CHECK(PyTuple_GET_SIZE(row) == 3);
+			CHECK(PyLong_AsLong(PyTuple_GET_ITEM(row, 0)) == n++);
+		}
+		Py_DECREF(rows);
+	}
+	pthread_join(thread, NULL);
+	CHECK(n == count);
+	CHECK(GetLong(queue, "Dropped") == 0);
+	CHECK(GetLong(queue, "Queued") == 0);
+	Py_DECREF(queue);
+}
+
+static void TestXml(void)
+{
+	printf("xml\n");
+	PyObject *queue = NewQueue("{s:i}", "BatchSize", 2);
+	Deliver((void *)5);
+	CHECK(GetLong(queue, "Queued") == 5);
+	PyObject *events = PyObject_CallMethod(queue, "Get", "(i)", 0);
+	CHECK(events != NULL && PyList_GET_SIZE(events) == 5);
+	for (Py_ssize_t i = 0; i < 5; i++) {
+		PyObject *expected = PyUnicode_FromFormat("<Event>%zd</Event>", i);
+		CHECK(PyUnicode_Compare(PyList_GET_ITEM(events, i), expected) == 0);
+		Py_DECREF(expected);
+	}
+	Py_DECREF(events);
+	Py_DECREF(queue);
+}
+
+static void TestDropped(void)
+{
+	printf("dropped, and errors\n");
+	PyObject *queue = NewQueue("{s:i,s:i,s:i}", "Context", 5, "BatchSize", 8, "MaxBatches", 4);
+	Deliver((void *)100);
+	CHECK(GetLong(queue, "Queued") == 32);
+	CHECK(GetLong(queue, "Dropped") == 100 - 32);
+	// An error from the service is raised after the events before it.
+	FakeEvtLog_Deliver(EvtSubscribeActionError, (EVT_HANDLE)(ULONG_PTR)15);
+	PyObject *rows = PyObject_CallMethod(queue, "Get", "(i)", 0);
+	CHECK(rows != NULL && PyList_GET_SIZE(rows) == 32);
+	Py_DECREF(rows);
+	CHECK(PyObject_CallMethod(queue, "Get", "(i)", 0) == NULL);
+	CHECK(PyErr_ExceptionMatches(PyExc_OSError));
+	PyErr_Clear();
+	rows = PyObject_CallMethod(queue, "Get", "(i)", 0);
+	CHECK(rows == Py_None);
+	Py_DECREF(rows);
+	// As is one rendering an event.
+	Deliver((void *)3);
+	FakeEvtLog_Deliver(EvtSubscribeActionDeliver, FAKE_EVENT(-1));
+	CHECK(GetLong(queue, "Dropped") == 100 - 32 + 1);
+	rows = PyObject_CallMethod(queue, "Get", "(i)", 0);
+	CHECK(rows != NULL && PyList_GET_SIZE(rows) == 3);
+	Py_DECREF(rows);
+	CHECK(PyObject_CallMethod(queue, "Get", "(i)", 0) == NULL);
+	CHECK(PyErr_ExceptionMatches(PyExc_OSError));
+	PyErr_Clear();
+	Py_DECREF(queue);
+}
+
+static void TestClose(void)
+{
+	printf("close with a callback waiting\n");
+	PyObject *queue = NewQueue("{s:i,s:i,s:i,s:i}", "Context", 5, "BatchSize", 8,
+		"MaxBatches", 1, "FullTimeout", -1);
+	pthread_t thread;
+	CHECK(pthread_create(&thread, NULL, Deliver, (void *)100) == 0);
+	while (GetLong(queue, "Queued") < 8)
+		;
+	PyObject *ret = PyObject_CallMethod(queue, "Close", NULL);
+	CHECK(ret == Py_None);
+	Py_DECREF(ret);
+	// Events delivered while closing are dropped, but none once it returns.
+	long dropped = GetLong(queue, "Dropped");
+	pthread_join(thread, NULL);
+	CHECK(GetLong(queue, "Dropped") == dropped);
+	CHECK(dropped <= 100 - 8);
+	CHECK(PyObject_CallMethod(queue, "Get", "(i)", 0) == NULL);
+	CHECK(PyErr_ExceptionMatches(PyExc_ValueError));
+	PyErr_Clear();
+	Py_DECREF(queue);
+}
+
+static void TestCloseTwice(void)
+{
+	printf("close on two threads\n");
+	PyObject *queue = NewQueue("{s:i,s:i,s:i,s:i}", "Context", 5, "BatchSize", 8,
+		"MaxBatches", 1, "FullTimeout", -1);
+	pthread_t thread;
+	CHECK(pthread_create(&thread, NULL, Deliver, (void *)100) == 0);
+	CloseTwice(queue);
+	pthread_join(thread, NULL);
+	Py_DECREF(queue);
+}
+
+static void TestBadArgs(void)
+{
+	PyObject *args = Py_BuildValue("(si)", "Application", 1);
+	PyObject *kwargs = Py_BuildValue("{s:i}", "MaxBatches", 0);
+	CHECK(PyEvtSubscribeQueue(NULL, args, kwargs) == NULL);
+	CHECK(PyErr_ExceptionMatches(PyExc_ValueError));
+	PyErr_Clear();
+	Py_DECREF(args);
+	Py_DECREF(kwargs);
+}
+
+int main(void)
+{
+	Py_Initialize();
+	CHECK(PyType_Ready(&PyEvtSubscriptionQueue::type) == 0);
+	TestWaitForRoom();
+	TestXml();
+	TestDropped();
+	TestClose();
+	TestCloseTwice();
+	TestBadArgs();
+	Py_Finalize();
+	printf("OK\n");
+	return 0;
+}
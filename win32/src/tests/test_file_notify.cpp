@@ -0,0 +1,198 @@
+// Tests of PyFileNotifyParser and PyFileNotifyCoalescer in
+// win32file_notify.h.
+//
+// * Well formed buffers are decoded record by record.
+// * Every truncation and corruption of a buffer is either decoded or
+//   rejected, without reading outside it (which ASan checks - each buffer
+//   is copied to a heap block of exactly its size).
+
+#include "../win32file_notify.h"
+#include "check.h"
+
+#include <string>
+#include <vector>
+
+typedef std::vector<unsigned char> Buffer;
+
+// Appends a FILE_NOTIFY_INFORMATION record for an ASCII name.
+static void AddRecord(Buffer &b, unsigned int action, const char *name, bool last = false)
+{
+	size_t start = b.size();
+	unsigned int nameBytes = (unsigned int)strlen(name) * 2;
+	size_t size = PYFILENOTIFY_HEADER_SIZE + nameBytes;
+	size_t padded = (size + 3) & ~(size_t)3;
+	unsigned int next = last ? 0 : (unsigned int)padded;
+	b.resize(start + (last ? size : padded));
+	memcpy(&b[start], &next, 4);
+	memcpy(&b[start + 4], &action, 4);
+	memcpy(&b[start + 8], &nameBytes, 4);
+	for (size_t i = 0; name[i]; i++) {
+		b[start + PYFILENOTIFY_HEADER_SIZE + 2 * i] = name[i];
+		b[start + PYFILENOTIFY_HEADER_SIZE + 2 * i + 1] = 0;
+	}
+}
+
+static std::string NameOf(const PyFileNotifyRecord &rec)
+{
+	std::string ret;
+	const unsigned char *p = (const unsigned char *)rec.FileName;
+	for (size_t i = 0; i < rec.FileNameLength; i++)
+		ret += (char)p[2 * i];
+	return ret;
+}
+
+// Parses a heap copy of the buffer, returning "action:name ..." for each
+// record kept (all of them without a coalescer), and the parser's result.
+static std::string Parse(const Buffer &b, int *result, bool coalesce = false)
+{
+	unsigned char *copy = (unsigned char *)malloc(b.size() ? b.size() : 1);
+	CHECK(copy != NULL);
+	if (b.size())
+		memcpy(copy, &b[0], b.size());
+	PyFileNotifyParser parser;
+	PyFileNotifyCoalescer coalescer;
+	PyFileNotifyRecord rec;
+	std::string ret;
+	int rc, count = 0;
+	parser.Init(copy, b.size());
+	coalescer.Init();
+	while ((rc = parser.Next(&rec)) == 1) {
+		// Each record starts at least one header further on.
+		CHECK(++count <= (int)(b.size() / PYFILENOTIFY_HEADER_SIZE));
+		if (coalesce && !coalescer.Keep(rec))
+			continue;
+		char action[16];
+		snprintf(action, sizeof(action), "%u:", rec.Action);
+		ret += action + NameOf(rec) + " ";
+	}
+	// The end, or the error, is sticky.
+	CHECK(parser.Next(&rec) == rc);
+	CHECK((rc == -1) == (parser.error != NULL));
+	coalescer.Free();
+	free(copy);
+	*result = rc;
+	return ret;
+}
+
+static void TestParse(void)
+{
+	Buffer b;
+	AddRecord(b, FILE_ACTION_ADDED, "new.txt");
+	AddRecord(b, FILE_ACTION_RENAMED_OLD_NAME, "a");
+	AddRecord(b, FILE_ACTION_RENAMED_NEW_NAME, "sub\\b", true);
+	int rc;
+	CHECK(Parse(b, &rc) == "1:new.txt 4:a 5:sub\\b ");
+	CHECK(rc == 0);
+
+	// An overflowed buffer has no records.
+	CHECK(Parse(Buffer(), &rc) == "" && rc == 0);
+	CHECK(Parse(Buffer(PYFILENOTIFY_HEADER_SIZE - 1), &rc) == "" && rc == 0);
+
+	// An empty name.
+	b.clear();
+	AddRecord(b, FILE_ACTION_MODIFIED, "", true);
+	CHECK(Parse(b, &rc) == "3: " && rc == 0);
+}
+
+// Sets a header field of the record at offset.
+static void SetField(Buffer &b, size_t offset, int field, unsigned int value)
+{
+	memcpy(&b[offset + field * 4], &value, 4);
+}
+
+static void TestMalformed(void)
+{
+	Buffer good;
+	AddRecord(good, FILE_ACTION_ADDED, "one");
+	AddRecord(good, FILE_ACTION_ADDED, "two", true);
+	size_t second = PYFILENOTIFY_HEADER_SIZE + 8;
+	int rc;
+
+	// A name longer than the buffer.
+	Buffer b = good;
+	SetField(b, 0, 2, 0x7ffffff0);
+	CHECK(Parse(b, &rc) == "" && rc == -1);
+
+	// A next entry offset inside the current record, unaligned, or past
+	// the end of the buffer.
+	unsigned int badNext[] = {4, 8, (unsigned int)second - 2, (unsigned int)second + 1,
+		(unsigned int)good.size(), 0xfffffffc};
+	for (size_t i = 0; i < sizeof(badNext) / sizeof(badNext[0]); i++) {
+		b = good;
+		SetField(b, 0, 0, badNext[i]);
+		CHECK(Parse(b, &rc) == "" && rc == -1);
+	}
+
+	// Every truncation is either rejected, or yields only whole records.
+	for (size_t size = 0; size < good.size(); size++) {
+		b.assign(good.begin(), good.begin() + size);
+		std::string got = Parse(b, &rc);
+		if (size < PYFILENOTIFY_HEADER_SIZE)
+			CHECK(got == "" && rc == 0);
+		else
+			CHECK(rc == -1 && (got == "" || got == "1:one "));
+	}
+}
+
+static void TestCoalesce(void)
+{
+	Buffer b;
+	AddRecord(b, FILE_ACTION_MODIFIED, "a");
+	AddRecord(b, FILE_ACTION_MODIFIED, "b");
+	AddRecord(b, FILE_ACTION_MODIFIED, "a");
+	AddRecord(b, FILE_ACTION_MODIFIED, "A");
+	AddRecord(b, FILE_ACTION_RENAMED_OLD_NAME, "a");
+	AddRecord(b, FILE_ACTION_MODIFIED, "a");
+	AddRecord(b, FILE_ACTION_MODIFIED, "a");
+	AddRecord(b, FILE_ACTION_MODIFIED, "b", true);
+	int rc;
+	CHECK(Parse(b, &rc, true) == "3:a 3:b 3:A 4:a 3:a " && rc == 0);
+
+	// Enough names to grow the table a few times.
+	b.clear();
+	char name[32];
+	for (int i = 0; i < 3000; i++) {
+		snprintf(name, sizeof(name), "dir\\file%d.obj", i % 500);
+		AddRecord(b, FILE_ACTION_MODIFIED, name, i == 2999);
+	}
+	std::string got = Parse(b, &rc, true);
+	CHECK(rc == 0);
+	int kept = 0;
+	for (size_t i = 0; i < got.size(); i++)
+		kept += got[i] == ' ';
+	CHECK(kept == 500);
+}
+
+static void TestFuzz(void)
+{
+	Buffer good;
+	AddRecord(good, FILE_ACTION_MODIFIED, "a");
+	AddRecord(good, FILE_ACTION_MODIFIED, "bb");
+	AddRecord(good, FILE_ACTION_MODIFIED, "a");
+	AddRecord(good, FILE_ACTION_RENAMED_OLD_NAME, "a");
+	AddRecord(good, FILE_ACTION_RENAMED_NEW_NAME, "ccc", true);
+	int rc;
+	for (int i = 0; i < 100000; i++) {
+		// Corrupt a few bytes of a good buffer, and maybe truncate it.
+		Buffer b = good;
+		for (unsigned int n = Random() % 4; n > 0; n--)
+			b[Random() % b.size()] = (unsigned char)Random();
+		b.resize(Random() % (b.size() + 1));
+		Parse(b, &rc, true);
+		// And mostly small values, which make plausible offsets.
+		b.resize(Random() % 128);
+		for (size_t j = 0; j < b.size(); j++)
+			b[j] = Random() % 4 == 0 ? Random() % 40 : 0;
+		Parse(b, &rc, true);
+	}
+}
+
+int main(void)
+{
+	TestParse();
+	TestMalformed();
+	TestCoalesce();
+	TestFuzz();
+	printf("OK\n");
+	return 0;
+}
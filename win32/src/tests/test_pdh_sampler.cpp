@@ -0,0 +1,354 @@
+// Tests of the counter array functions and the Sampler in win32pdhmodule.cpp
+// against the fake counters in pdh_stubs.cpp, run with an embedded Python.
+//
+// * Every instance's name and value is returned, in each format, with None
+//   for values which aren't valid, and the buffer is grown as needed - but
+//   not forever, for instances which never stop changing.
+// * Instance names are shared between snapshots, through the cache or by
+//   reusing the sampler's last tuple of names.
+// * The sampler keeps the last Depth snapshots, counting the rest as
+//   dropped, and closing it releases a thread waiting in Get.  Two threads
+//   closing it at once stop its thread once.
+
+#include "pdh_stubs.h"
+#include "../PyWinStringCache.h"
+#include "pdh_sampler.inc"
+#include "check.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+static PyObject *Call(PyObject *(*func)(PyObject *, PyObject *, PyObject *), PyObject *args, PyObject *kwargs)
+{
+	CHECK(args != NULL);
+	PyObject *ret = func(NULL, args, kwargs);
+	Py_DECREF(args);
+	Py_XDECREF(kwargs);
+	return ret;
+}
+
+static PyObject *FormattedArray(long counter, DWORD format)
+{
+	PyObject *args = Py_BuildValue("(lk)", counter, format);
+	CHECK(args != NULL);
+	PyObject *ret = PyGetFormattedCounterArray(NULL, args);
+	Py_DECREF(args);
+	return ret;
+}
+
+static void CheckRaises(PyObject *ret, PyObject *exc)
+{
+	CHECK(ret == NULL);
+	CHECK(PyErr_ExceptionMatches(exc));
+	PyErr_Clear();
+}
+
+// Checks a counter's (names, values) against the fake counter 1 or 3 on a tick.
+static void CheckCounter(PyObject *item, long counter, long tick, DWORD format)
+{
+	CHECK(PyTuple_Check(item) && PyTuple_GET_SIZE(item) == 2);
+	PyObject *names = PyTuple_GET_ITEM(item, 0), *values = PyTuple_GET_ITEM(item, 1);
+	Py_ssize_t n = tick % 5 == 0 ? 5 : 3;
+	CHECK(PyTuple_GET_SIZE(names) == n && PyTuple_GET_SIZE(values) == n);
+	for (Py_ssize_t i = 0; i < n; i++) {
+		PyObject *expected = PyUnicode_FromFormat("%s%zd", counter == 3 ? FAKE_PDH_LONG_NAME : "inst", i);
+		CHECK(PyUnicode_Compare(PyTuple_GET_ITEM(names, i), expected) == 0);
+		Py_DECREF(expected);
+		PyObject *value = PyTuple_GET_ITEM(values, i);
+		if (tick == 1 && i == 1)
+			CHECK(value == Py_None);
+		else if (format & PDH_FMT_DOUBLE)
+			CHECK(PyFloat_Check(value) && PyFloat_AS_DOUBLE(value) == tick * 10 + i);
+		else
+			CHECK(PyLong_Check(value) && PyLong_AsLong(value) == tick * 10 + i);
+	}
+}
+
+static void TestFormattedArray(void)
+{
+	printf("formatted counter arrays\n");
+	const DWORD formats[] = {PDH_FMT_DOUBLE, PDH_FMT_LONG, PDH_FMT_LARGE | PDH_FMT_NOSCALE};
+	for (int tick = 0; tick < 3; tick++) {
+		FakePdh_Tick = tick;
+		for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+			PyObject *list = FormattedArray(1, formats[f]);
+			CHECK(list != NULL && PyList_Check(list));
+			// The same as a snapshot's names and values, zipped together.
+			Py_ssize_t n = PyList_GET_SIZE(list);
+			PyObject *item = Py_BuildValue("(NN)", PyTuple_New(n), PyTuple_New(n));
+			for (Py_ssize_t i = 0; i < n; i++) {
+				PyObject *pair = PyList_GET_ITEM(list, i);
+				CHECK(PyTuple_GET_SIZE(pair) == 2);
+				for (int j = 0; j < 2; j++) {
+					PyObject *ob = PyTuple_GET_ITEM(pair, j);
+					Py_INCREF(ob);
+					PyTuple_SET_ITEM(PyTuple_GET_ITEM(item, j), i, ob);
+				}
+			}
+			CheckCounter(item, 1, tick, formats[f]);
+			Py_DECREF(item);
+			Py_DECREF(list);
+		}
+	}
+	PyObject *list = FormattedArray(2, PDH_FMT_DOUBLE);
+	CHECK(list != NULL && PyList_GET_SIZE(list) == 0);
+	Py_DECREF(list);
+	CheckRaises(FormattedArray(99, PDH_FMT_DOUBLE), PyExc_OSError);
+	CheckRaises(FormattedArray(4, PDH_FMT_DOUBLE), PyExc_OSError);
+	CheckRaises(FormattedArray(1, PDH_FMT_NOSCALE), PyExc_ValueError);
+}
+
+static void TestRawArray(void)
+{
+	printf("raw counter arrays\n");
+	FakePdh_Tick = 5;
+	PyObject *args = Py_BuildValue("(l)", 3L);
+	PyObject *list = PyGetRawCounterArray(NULL, args);
+	CHECK(list != NULL && PyList_GET_SIZE(list) == 5);
+	for (Py_ssize_t i = 0; i < 5; i++) {
+		PyObject *expected = Py_BuildValue("(NkKLLk)", PyUnicode_FromFormat("%s%zd", FAKE_PDH_LONG_NAME, i),
+			0UL, 0x100000005ULL, (long long)-i, 1LL << 40, 1UL);
+		CHECK(PyObject_RichCompareBool(PyList_GET_ITEM(list, i), expected, Py_EQ) == 1);
+		Py_DECREF(expected);
+	}
+	Py_DECREF(list);
+	Py_DECREF(args);
+	args = Py_BuildValue("(l)", 99L);
+	CheckRaises(PyGetRawCounterArray(NULL, args), PyExc_OSError);
+	Py_DECREF(args);
+}
+
+static void TestSnapshot(void)
+{
+	printf("snapshots\n");
+	FakePdh_Tick = 0;
+	PyObject *first = Call(PyCollectQuerySnapshot, Py_BuildValue("(i[iiii])", 0, 1, 2, 3, 99), NULL);
+	PyObject *second = Call(PyCollectQuerySnapshot, Py_BuildValue("(i[iiii])", 0, 1, 2, 3, 99),
+		Py_BuildValue("{s:k}", "Format", (DWORD)PDH_FMT_LONG));
+	CHECK(first != NULL && second != NULL);
+	CHECK(PyList_GET_SIZE(first) == 4 && PyList_GET_SIZE(second) == 4);
+	CheckCounter(PyList_GET_ITEM(first, 0), 1, 1, PDH_FMT_DOUBLE);
+	CheckCounter(PyList_GET_ITEM(second, 0), 1, 2, PDH_FMT_LONG);
+	CheckCounter(PyList_GET_ITEM(first, 2), 3, 1, PDH_FMT_DOUBLE);
+	PyObject *empty = PyList_GET_ITEM(first, 1);
+	CHECK(PyTuple_GET_SIZE(PyTuple_GET_ITEM(empty, 0)) == 0 && PyTuple_GET_SIZE(PyTuple_GET_ITEM(empty, 1)) == 0);
+	CHECK(PyList_GET_ITEM(first, 3) == Py_None);
+	// Short names come from the cache, long ones are new each time.
+	for (Py_ssize_t i = 0; i < 3; i++) {
+		CHECK(PyTuple_GET_ITEM(PyTuple_GET_ITEM(PyList_GET_ITEM(first, 0), 0), i)
+			== PyTuple_GET_ITEM(PyTuple_GET_ITEM(PyList_GET_ITEM(second, 0), 0), i));
+		CHECK(PyTuple_GET_ITEM(PyTuple_GET_ITEM(PyList_GET_ITEM(first, 2), 0), i)
+			!= PyTuple_GET_ITEM(PyTuple_GET_ITEM(PyList_GET_ITEM(second, 2), 0), i));
+	}
+	Py_DECREF(first);
+	Py_DECREF(second);
+
+	FakePdh_CollectStatus = PDH_NO_DATA;
+	CheckRaises(Call(PyCollectQuerySnapshot, Py_BuildValue("(i[i])", 0, 1), NULL), PyExc_OSError);
+	FakePdh_CollectStatus = 0;
+	CheckRaises(Call(PyCollectQuerySnapshot, Py_BuildValue("(ii)", 0, 1), NULL), PyExc_TypeError);
+	CheckRaises(Call(PyCollectQuerySnapshot, Py_BuildValue("(i[i]k)", 0, 1, 0UL), NULL), PyExc_ValueError);
+}
+
+static PyObject *NewSampler(PyObject *counters, const char *format, ...)
+{
+	va_list va;
+	va_start(va, format);
+	PyObject *kwargs = Py_VaBuildValue(format, va);
+	va_end(va);
+	PyObject *sampler = Call(PyNewSampler, Py_BuildValue("(iN)", 0, counters), kwargs);
+	if (sampler == NULL)
+		PyErr_Print();
+	CHECK(sampler != NULL);
+	return sampler;
+}
+
+static long GetLong(PyObject *ob, const char *name)
+{
+	PyObject *value = PyObject_GetAttrString(ob, name);
+	CHECK(value != NULL);
+	long ret = PyLong_AsLong(value);
+	Py_DECREF(value);
+	return ret;
+}
+
+static void Sleep(int ms)
+{
+	Py_BEGIN_ALLOW_THREADS
+	usleep(ms * 1000);
+	Py_END_ALLOW_THREADS
+}
+
+// Checks a list of snapshots of counters 1, 2 and 3, returning the tick of the last.
+static long CheckSnapshots(PyObject *snapshots, long lastTick)
+{
+	CHECK(snapshots != NULL && PyList_Check(snapshots) && PyList_GET_SIZE(snapshots) > 0);
+	unsigned long long lastTime = 0;
+	for (Py_ssize_t s = 0; s < PyList_GET_SIZE(snapshots); s++) {
+		PyObject *snapshot = PyList_GET_ITEM(snapshots, s);
+		CHECK(PyTuple_GET_SIZE(snapshot) == 2);
+		unsigned long long time = PyLong_AsUnsignedLongLong(PyTuple_GET_ITEM(snapshot, 0));
+		CHECK(time >= lastTime);
+		lastTime = time;
+		PyObject *counters = PyTuple_GET_ITEM(snapshot, 1);
+		CHECK(PyList_GET_SIZE(counters) == 3);
+		// The tick is in the first value, as no collections fail.
+		PyObject *values = PyTuple_GET_ITEM(PyList_GET_ITEM(counters, 0), 1);
+		long tick = (long)PyFloat_AsDouble(PyTuple_GET_ITEM(values, 0)) / 10;
+		CHECK(tick > lastTick);
+		lastTick = tick;
+		CheckCounter(PyList_GET_ITEM(counters, 0), 1, tick, PDH_FMT_DOUBLE);
+		CheckCounter(PyList_GET_ITEM(counters, 2), 3, tick, PDH_FMT_DOUBLE);
+	}
+	return lastTick;
+}
+
+// Waits for snapshots, returning whether the last had no counters.
+static bool LastSnapshotFailed(PyObject *sampler)
+{
+	PyObject *snapshots = PyObject_CallMethod(sampler, "Get", "(i)", 1000);
+	CHECK(snapshots != NULL && PyList_Check(snapshots));
+	PyObject *last = PyList_GET_ITEM(snapshots, PyList_GET_SIZE(snapshots) - 1);
+	bool failed = PyTuple_GET_ITEM(last, 1) == Py_None;
+	Py_DECREF(snapshots);
+	return failed;
+}
+
+static void TestSampler(void)
+{
+	printf("sampler\n");
+	FakePdh_Tick = 1;
+	PyObject *sampler = NewSampler(Py_BuildValue("[iii]", 1, 2, 3), "{s:i,s:i}", "Interval", 5, "Depth", 4);
+	Sleep(200);
+	CHECK(GetLong(sampler, "Queued") == 4);
+	CHECK(GetLong(sampler, "Dropped") > 0);
+	PyObject *snapshots = PyObject_CallMethod(sampler, "Get", "(i)", 0);
+	CHECK(PyList_GET_SIZE(snapshots) == 4);
+	long tick = CheckSnapshots(snapshots, 0);
+	Py_DECREF(snapshots);
+	// Names the same as in the last snapshot returned are the same tuple.
+	PyObject *lastNames = NULL;
+	int reused = 0;
+	for (int i = 0; i < 20; i++) {
+		snapshots = PyObject_CallMethod(sampler, "Get", "(i)", 1000);
+		tick = CheckSnapshots(snapshots, tick);
+		for (Py_ssize_t s = 0; s < PyList_GET_SIZE(snapshots); s++) {
+			PyObject *counters = PyTuple_GET_ITEM(PyList_GET_ITEM(snapshots, s), 1);
+			PyObject *names = PyTuple_GET_ITEM(PyList_GET_ITEM(counters, 0), 0);
+			if (lastNames && PyObject_RichCompareBool(names, lastNames, Py_EQ)) {
+				CHECK(names == lastNames);
+				reused++;
+			}
+			Py_XDECREF(lastNames);
+			lastNames = names;
+			Py_INCREF(lastNames);
+		}
+		Py_DECREF(snapshots);
+	}
+	CHECK(reused > 0);
+	Py_DECREF(lastNames);
+	// A collection which fails gives a snapshot without counters, and the
+	// sampler carries on.
+	__atomic_store_n(&FakePdh_CollectStatus, PDH_NO_DATA, __ATOMIC_SEQ_CST);
+	while (!LastSnapshotFailed(sampler))
+		;
+	__atomic_store_n(&FakePdh_CollectStatus, 0, __ATOMIC_SEQ_CST);
+	while (LastSnapshotFailed(sampler))
+		;
+
+	PyObject *ret = PyObject_CallMethod(sampler, "Close", NULL);
+	CHECK(ret == Py_None);
+	Py_DECREF(ret);
+	CheckRaises(PyObject_CallMethod(sampler, "Get", "(i)", 0), PyExc_ValueError);
+	long dropped = GetLong(sampler, "Dropped");
+	Sleep(20);
+	CHECK(GetLong(sampler, "Dropped") == dropped);
+	Py_DECREF(sampler);
+}
+
+static void *WaitInGet(void *arg)
+{
+	PyGILState_STATE state = PyGILState_Ensure();
+	PyObject *ret = PyObject_CallMethod((PyObject *)arg, "Get", NULL);
+	CheckRaises(ret, PyExc_ValueError);
+	PyGILState_Release(state);
+	return NULL;
+}
+
+static void TestCloseWhileWaiting(void)
+{
+	printf("close with a thread waiting\n");
+	PyObject *sampler = NewSampler(Py_BuildValue("[i]", 1), "{s:i}", "Interval", 100000);
+	// The first snapshot is taken straight away, and the next not for a long time.
+	PyObject *snapshots = PyObject_CallMethod(sampler, "Get", NULL);
+	CHECK(snapshots != NULL && PyList_GET_SIZE(snapshots) == 1);
+	Py_DECREF(snapshots);
+	pthread_t thread;
+	CHECK(pthread_create(&thread, NULL, WaitInGet, sampler) == 0);
+	Sleep(50);
+	PyObject *ret = PyObject_CallMethod(sampler, "Close", NULL);
+	CHECK(ret == Py_None);
+	Py_DECREF(ret);
+	Py_BEGIN_ALLOW_THREADS
+	pthread_join(thread, NULL);
+	Py_END_ALLOW_THREADS
+	Py_DECREF(sampler);
+}
+
+static void TestCloseTwice(void)
+{
+	printf("close on two threads\n");
+	// Each collection takes a while, so the sampler's thread is slow to stop.
+	FakePdh_CollectDelay = 20;
+	PyObject *sampler = NewSampler(Py_BuildValue("[i]", 1), "{s:i}", "Interval", 1);
+	Sleep(10);
+	CloseTwice(sampler);
+	CheckRaises(PyObject_CallMethod(sampler, "Get", "(i)", 0), PyExc_ValueError);
+	Py_DECREF(sampler);
+	FakePdh_CollectDelay = 0;
+}
+
+static void TestSamplerLifetime(void)
+{
+	printf("sampler lifetime\n");
+	// Destroyed without being closed, while collecting.
+	FakePdh_CollectDelay = 20;
+	PyObject *sampler = NewSampler(Py_BuildValue("[ii]", 1, 99), "{s:i}", "Interval", 1);
+	Sleep(10);
+	Py_DECREF(sampler);
+	FakePdh_CollectDelay = 0;
+	// No counters, and only the latest snapshot kept.
+	sampler = NewSampler(PyList_New(0), "{s:i,s:i}", "Interval", 5, "Depth", 1);
+	Sleep(50);
+	PyObject *snapshots = PyObject_CallMethod(sampler, "Get", NULL);
+	CHECK(snapshots != NULL && PyList_GET_SIZE(snapshots) == 1);
+	CHECK(PyList_GET_SIZE(PyTuple_GET_ITEM(PyList_GET_ITEM(snapshots, 0), 1)) == 0);
+	Py_DECREF(snapshots);
+	CHECK(GetLong(sampler, "Dropped") > 0);
+	Py_DECREF(sampler);
+
+	PyObject *args = Py_BuildValue("(i[i])", 0, 1);
+	CheckRaises(Call(PyNewSampler, args, Py_BuildValue("{s:i}", "Interval", 0)), PyExc_ValueError);
+	args = Py_BuildValue("(i[i])", 0, 1);
+	CheckRaises(Call(PyNewSampler, args, Py_BuildValue("{s:i}", "Depth", 0)), PyExc_ValueError);
+	args = Py_BuildValue("(i[i])", 0, 1);
+	CheckRaises(Call(PyNewSampler, args, Py_BuildValue("{s:i}", "Format", 0)), PyExc_ValueError);
+}
+
+int main(void)
+{
+	Py_Initialize();
+	CHECK(PyType_Ready(&PyPdhSampler::type) == 0);
+	CHECK(PyWinStringCache_Resize(&instanceNameCache, 1024, PYWIN_STRING_CACHE_MAX_CHARS));
+	TestFormattedArray();
+	TestRawArray();
+	TestSnapshot();
+	TestSampler();
+	TestCloseWhileWaiting();
+	TestCloseTwice();
+	TestSamplerLifetime();
+	PyWinStringCache_Clear(&instanceNameCache);
+	Py_Finalize();
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,279 @@
+// Tests of the perfmon shared section layout in PerfMon/PerfMonLayout.h.
+//
+// * Counters are aligned on their size, and objects too large for a
+//   mapping are refused.
+// * Instance ids are never valid for a later instance in the same slot, and
+//   reused slots start with zeroed counters.
+// * Writer threads adding, updating and removing instances race a collector:
+//   every snapshot collected is well formed, no update is lost, and an
+//   instance changed while it was copied is left out rather than torn.
+
+#include "../PerfMon/PerfMonLayout.h"
+#include "check.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <vector>
+
+static std::vector<PyPerfUTF16> NameOf(const char *s)
+{
+	std::vector<PyPerfUTF16> ret;
+	while (*s)
+		ret.push_back((unsigned char)*s++);
+	return ret;
+}
+
+// Memory for the shared section, 8 byte aligned as a mapping is.
+struct Section
+{
+	std::vector<long long> mem;
+	Section(const PyPerfLayout &layout) : mem(layout.totalSize / 8 + 1) {}
+	void *Base() {return &mem[0];}
+};
+
+static unsigned long long AddInstance(const PyPerfLayout &layout, Section &section, const char *name)
+{
+	std::vector<PyPerfUTF16> w = NameOf(name);
+	unsigned long long id;
+	CHECK(PyPerfLayout_AddInstance(&layout, section.Base(), w.empty() ? NULL : &w[0],
+		(unsigned int)w.size(), PYPERF_NO_UNIQUE_ID, &id));
+	return id;
+}
+
+static unsigned int Value32(const unsigned char *block, unsigned int offset)
+{
+	return PyPerf_Load32(block + offset);
+}
+
+static long long Value64(const unsigned char *block, unsigned int offset)
+{
+	return PyPerf_Load64(block + offset);
+}
+
+static void TestInit(void)
+{
+	printf("layout\n");
+	unsigned int sizes[] = {4, 8, 4}, offsets[3];
+	PyPerfLayout layout;
+	CHECK(PyPerfLayout_Init(&layout, sizes, 3, offsets, 0, 0));
+	CHECK(offsets[0] == 4 && offsets[1] == 8 && offsets[2] == 16);
+	CHECK(layout.definitionLength == PYPERF_OBJECT_TYPE_SIZE + 3 * PYPERF_COUNTER_DEFINITION_SIZE);
+	CHECK(layout.blockSize == 24);
+	CHECK(layout.blockOffset == layout.definitionLength && layout.blockOffset % 8 == 0);
+	CHECK(layout.totalSize == layout.definitionLength + 24);
+
+	CHECK(PyPerfLayout_Init(&layout, sizes, 3, offsets, 8, 16));
+	CHECK(layout.instanceDefLength == 64);	// 24 + 17 characters, rounded up
+	CHECK(layout.slotSize == 64 + 24);
+	CHECK(layout.statesOffset == layout.definitionLength + 8 * layout.slotSize);
+	CHECK(layout.totalSize == layout.statesOffset + 8 * 4);
+
+	unsigned int bad[] = {4, 2};
+	CHECK(!PyPerfLayout_Init(&layout, bad, 2, offsets, 0, 0));
+	CHECK(!PyPerfLayout_Init(&layout, sizes, 3, offsets, PYPERF_MAX_INSTANCES + 1, 16));
+	CHECK(!PyPerfLayout_Init(&layout, sizes, 3, offsets, 0x8000, 0xFFFF));
+	CHECK(PyPerfLayout_Init(&layout, sizes, 3, offsets, PYPERF_MAX_INSTANCES, 0));
+}
+
+// Checks a collected object is well formed, returning its instances as
+// "name=value0,value1 ...".
+static std::string Parse(const PyPerfLayout &layout, const unsigned char *data, unsigned int size,
+	const unsigned int *offsets)
+{
+	const PyPerfObjectType *pot = (const PyPerfObjectType *)data;
+	CHECK(pot->TotalByteLength == size);
+	std::string ret;
+	unsigned int pos = layout.definitionLength;
+	if (layout.maxInstances == 0) {
+		CHECK(pot->NumInstances == PYPERF_NO_INSTANCES);
+		CHECK(*(const unsigned int *)(data + pos) == layout.blockSize);
+		CHECK(pos + layout.blockSize == size);
+		return ret;
+	}
+	CHECK(pot->NumInstances >= 0 && (unsigned int)pot->NumInstances <= layout.maxInstances);
+	for (int i = 0; i < pot->NumInstances; i++) {
+		const PyPerfInstanceDefinition *def = (const PyPerfInstanceDefinition *)(data + pos);
+		CHECK(def->ByteLength == layout.instanceDefLength);
+		CHECK(def->NameOffset == PYPERF_INSTANCE_DEFINITION_SIZE);
+		unsigned int nameChars = def->NameLength / sizeof(PyPerfUTF16);
+		CHECK(nameChars >= 1 && nameChars <= layout.maxNameChars + 1);
+		const PyPerfUTF16 *name = (const PyPerfUTF16 *)(data + pos + def->NameOffset);
+		CHECK(name[nameChars - 1] == 0);
+		for (unsigned int k = 0; k < nameChars - 1; k++)
+			ret += (char)name[k];
+		const unsigned char *block = data + pos + def->ByteLength;
+		CHECK(*(const unsigned int *)block == layout.blockSize);
+		char values[64];
+		snprintf(values, sizeof(values), "=%u,%lld ", *(const unsigned int *)(block + offsets[0]),
+			*(const long long *)(block + offsets[1]));
+		ret += values;
+		pos += layout.slotSize;
+	}
+	CHECK(pos == size);
+	return ret;
+}
+
+static std::string Collect(const PyPerfLayout &layout, Section &section, const unsigned int *offsets)
+{
+	std::vector<unsigned char> out(layout.totalSize);
+	unsigned int needed;
+	CHECK(PyPerfLayout_Collect(&layout, section.Base(), &out[0], 10, &needed) == 0);
+	CHECK(needed <= out.size());
+	unsigned int size = PyPerfLayout_Collect(&layout, section.Base(), &out[0], needed, &needed);
+	CHECK(size != 0);
+	return Parse(layout, &out[0], size, offsets);
+}
+
+static void TestNoInstances(void)
+{
+	printf("no instances\n");
+	unsigned int sizes[] = {4, 8}, offsets[2];
+	PyPerfLayout layout;
+	CHECK(PyPerfLayout_Init(&layout, sizes, 2, offsets, 0, 0));
+	Section section(layout);
+	unsigned char *block = PyPerfLayout_CounterBlock(&layout, section.Base(), 0);
+	PyPerfLayout_InitBlock(&layout, block);
+	CHECK(PyPerfLayout_CounterBlock(&layout, section.Base(), 12345) == block);
+	PyPerf_Add32(block + offsets[0], -1);
+	PyPerf_Add64(block + offsets[1], 1LL << 40);
+	CHECK((int)Value32(block, offsets[0]) == -1 && Value64(block, offsets[1]) == 1LL << 40);
+	unsigned long long id;
+	CHECK(!PyPerfLayout_AddInstance(&layout, section.Base(), NULL, 0, PYPERF_NO_UNIQUE_ID, &id));
+	CHECK(!PyPerfLayout_RemoveInstance(&layout, section.Base(), 0));
+	CHECK(Collect(layout, section, offsets) == "");
+}
+
+static void TestInstances(void)
+{
+	printf("instances\n");
+	unsigned int sizes[] = {4, 8}, offsets[2];
+	PyPerfLayout layout;
+	CHECK(PyPerfLayout_Init(&layout, sizes, 2, offsets, 3, 8));
+	Section section(layout);
+	void *base = section.Base();
+	CHECK(Collect(layout, section, offsets) == "");
+	unsigned long long a = AddInstance(layout, section, "first");
+	unsigned long long b = AddInstance(layout, section, "second");
+	unsigned long long c = AddInstance(layout, section, "");
+	unsigned long long id;
+	std::vector<PyPerfUTF16> name = NameOf("more");
+	CHECK(!PyPerfLayout_AddInstance(&layout, base, &name[0], 4, PYPERF_NO_UNIQUE_ID, &id));
+	CHECK(PyPerfLayout_RemoveInstance(&layout, base, c));
+	name = NameOf("too-long!");
+	CHECK(!PyPerfLayout_AddInstance(&layout, base, &name[0], 9, PYPERF_NO_UNIQUE_ID, &id));
+	c = AddInstance(layout, section, "12345678");
+
+	PyPerf_Add32(PyPerfLayout_CounterBlock(&layout, base, a) + offsets[0], 3);
+	PyPerf_Store64(PyPerfLayout_CounterBlock(&layout, base, b) + offsets[1], -7);
+	CHECK(Collect(layout, section, offsets) == "first=3,0 second=0,-7 12345678=0,0 ");
+
+	// A removed instance's id is never valid again, even once its slot is reused.
+	CHECK(PyPerfLayout_RemoveInstance(&layout, base, a));
+	CHECK(!PyPerfLayout_RemoveInstance(&layout, base, a));
+	CHECK(PyPerfLayout_CounterBlock(&layout, base, a) == NULL);
+	unsigned long long d = AddInstance(layout, section, "fourth");
+	CHECK(d != a && PYPERF_INSTANCE_SLOT(d) == PYPERF_INSTANCE_SLOT(a));
+	CHECK(PyPerfLayout_CounterBlock(&layout, base, a) == NULL);
+	CHECK(Value32(PyPerfLayout_CounterBlock(&layout, base, d), offsets[0]) == 0);
+	CHECK(Collect(layout, section, offsets) == "fourth=0,0 second=0,-7 12345678=0,0 ");
+	CHECK(PyPerfLayout_CounterBlock(&layout, base, PYPERF_INSTANCE_ID(7, 4)) == NULL);
+}
+
+const int WRITERS = 4;
+const int ITERATIONS = 10000;
+const int UPDATES = 4;		// of each instance added
+
+struct Shared
+{
+	PyPerfLayout layout;
+	unsigned int offsets[2];
+	Section *section;
+	unsigned long long total;	// the id of the instance every writer updates
+	int done;
+};
+
+// Adds an instance, updates it and removes it again, and counts it in the
+// total instance.
+static void *Writer(void *arg)
+{
+	Shared *shared = (Shared *)arg;
+	const PyPerfLayout *layout = &shared->layout;
+	void *base = shared->section->Base();
+	unsigned char *total = PyPerfLayout_CounterBlock(layout, base, shared->total);
+	CHECK(total != NULL);
+	for (int i = 0; i < ITERATIONS; i++) {
+		PyPerfUTF16 name[] = {'w', 'r', 'i', 't', 'e', 'r'};
+		unsigned long long id;
+		if (PyPerfLayout_AddInstance(layout, base, name, 6, PYPERF_NO_UNIQUE_ID, &id)) {
+			unsigned char *block = PyPerfLayout_CounterBlock(layout, base, id);
+			CHECK(block != NULL);
+			for (int k = 0; k < UPDATES; k++) {
+				PyPerf_Add32(block + shared->offsets[0], 1);
+				PyPerf_Add64(block + shared->offsets[1], 5);
+				sched_yield();
+			}
+			CHECK(PyPerfLayout_RemoveInstance(layout, base, id));
+			CHECK(PyPerfLayout_CounterBlock(layout, base, id) == NULL);
+		}
+		PyPerf_Add32(total + shared->offsets[0], 1);
+		PyPerf_Add64(total + shared->offsets[1], 1LL << 33);
+	}
+	__atomic_add_fetch(&shared->done, 1, __ATOMIC_SEQ_CST);
+	return NULL;
+}
+
+static void TestThreads(void)
+{
+	printf("threads\n");
+	Shared shared;
+	unsigned int sizes[] = {4, 8};
+	// Fewer slots than writers, so adding sometimes fails.
+	CHECK(PyPerfLayout_Init(&shared.layout, sizes, 2, shared.offsets, WRITERS - 1, 8));
+	Section section(shared.layout);
+	shared.section = &section;
+	shared.total = AddInstance(shared.layout, section, "total");
+	shared.done = 0;
+	pthread_t threads[WRITERS];
+	for (int i = 0; i < WRITERS; i++)
+		CHECK(pthread_create(&threads[i], NULL, Writer, &shared) == 0);
+	long collections = 0, seen = 0;
+	unsigned int lastCount = 0;
+	long long lastSum = 0;
+	while (__atomic_load_n(&shared.done, __ATOMIC_SEQ_CST) < WRITERS) {
+		std::string got = Collect(shared.layout, section, shared.offsets);
+		// The total is always there, and only goes up.
+		unsigned int count;
+		long long sum;
+		CHECK(sscanf(got.c_str(), "total=%u,%lld", &count, &sum) == 2);
+		CHECK(count >= lastCount && sum >= lastSum && sum % (1LL << 33) == 0);
+		lastCount = count;
+		lastSum = sum;
+		// A writer's instance is seen between updates, never torn.
+		for (size_t pos = got.find("writer="); pos != std::string::npos; pos = got.find("writer=", pos + 1)) {
+			unsigned int n;
+			long long bytes;
+			CHECK(sscanf(got.c_str() + pos, "writer=%u,%lld", &n, &bytes) == 2);
+			CHECK(n <= UPDATES && bytes <= 5 * UPDATES && bytes % 5 == 0);
+			seen++;
+		}
+		collections++;
+	}
+	for (int i = 0; i < WRITERS; i++)
+		pthread_join(threads[i], NULL);
+	printf("  %ld collections, %ld writer instances seen\n", collections, seen);
+	char expected[64];
+	snprintf(expected, sizeof(expected), "total=%u,%lld ", WRITERS * ITERATIONS,
+		(long long)WRITERS * ITERATIONS << 33);
+	CHECK(Collect(shared.layout, section, shared.offsets) == expected);
+}
+
+int main(void)
+{
+	TestInit();
+	TestNoInstances();
+	TestInstances();
+	TestThreads();
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,250 @@
+// Tests of the SAFEARRAY layout helpers in
+// com/win32com/src/include/PySafeArrayLayout.h, against hand built
+// descriptors.
+//
+// * Each fixed size numeric VARTYPE has its struct format, and no other
+//   type has one.
+// * A descriptor's reversed bounds describe a column-major buffer, up to 64
+//   dimensions, and sizes which overflow are rejected.
+// * C ordered, Fortran ordered, strided and reversed sources are all copied
+//   into column-major order, without touching memory outside either buffer
+//   (which ASan checks - each is a heap block of exactly its size).
+// * Buffer formats only match the VARTYPE of the same kind and size, and an
+//   existing array is only refilled from a buffer matching its own VARTYPE.
+
+#include "../../../com/win32com/src/include/PySafeArrayLayout.h"
+#include "check.h"
+
+#include <stddef.h>
+#include <vector>
+
+static void TestGetFormat(void)
+{
+	static const struct {
+		VARTYPE vt;
+		const char *format;
+		size_t itemsize;
+	} formats[] = {
+		{VT_I1, "b", 1}, {VT_UI1, "B", 1}, {VT_I2, "h", 2}, {VT_UI2, "H", 2},
+		{VT_I4, "i", 4}, {VT_INT, "i", 4}, {VT_UI4, "I", 4}, {VT_UINT, "I", 4},
+		{VT_I8, "q", 8}, {VT_UI8, "Q", 8}, {VT_R4, "f", 4}, {VT_R8, "d", 8},
+	};
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+		size_t itemsize = 0;
+		const char *format = PySafeArrayLayout_GetFormat(formats[i].vt, &itemsize);
+		CHECK(format != NULL && strcmp(format, formats[i].format) == 0);
+		CHECK(itemsize == formats[i].itemsize);
+		CHECK(PySafeArrayLayout_GetFormat(formats[i].vt, NULL) == format);
+	}
+	// VT_EMPTY, VT_CY, VT_DATE, VT_BSTR, VT_BOOL and VT_VARIANT.
+	static const VARTYPE others[] = {0, 6, 7, 8, 11, 12};
+	for (size_t i = 0; i < sizeof(others) / sizeof(others[0]); i++) {
+		size_t itemsize = 99;
+		CHECK(PySafeArrayLayout_GetFormat(others[i], &itemsize) == NULL);
+		CHECK(itemsize == 99);
+	}
+}
+
+// Describes an array with the given dimensions (in dimension 1..n order),
+// reversing them into a descriptor's order first.
+static bool Describe(const std::vector<unsigned int> &dims, size_t cbElements,
+	size_t *shape, size_t *strides, size_t *pcbTotal)
+{
+	std::vector<SAFEARRAYBOUND> bounds(dims.size() ? dims.size() : 1);
+	for (size_t i = 0; i < dims.size(); i++) {
+		bounds[dims.size() - 1 - i].cElements = dims[i];
+		bounds[dims.size() - 1 - i].lLbound = (int)i - 1;
+	}
+	return PySafeArrayLayout_Describe((unsigned int)dims.size(), &bounds[0], cbElements, shape, strides, pcbTotal);
+}
+
+static void TestDescribe(void)
+{
+	size_t shape[PYSAFEARRAY_MAX_NDIM + 1], strides[PYSAFEARRAY_MAX_NDIM + 1], total;
+
+	std::vector<unsigned int> dims(1, 5);
+	CHECK(Describe(dims, 8, shape, strides, &total));
+	CHECK(shape[0] == 5 && strides[0] == 8 && total == 40);
+
+	// Dimension 1 varies fastest.
+	dims.assign(3, 0);
+	dims[0] = 2;
+	dims[1] = 3;
+	dims[2] = 4;
+	CHECK(Describe(dims, 4, shape, strides, &total));
+	CHECK(shape[0] == 2 && shape[1] == 3 && shape[2] == 4);
+	CHECK(strides[0] == 4 && strides[1] == 8 && strides[2] == 24);
+	CHECK(total == 96);
+
+	// An empty dimension empties the array, but the shape is kept.
+	dims[1] = 0;
+	CHECK(Describe(dims, 4, shape, strides, &total));
+	CHECK(shape[1] == 0 && shape[2] == 4 && total == 0);
+
+	// 64 dimensions, but no more.
+	dims.assign(PYSAFEARRAY_MAX_NDIM, 1);
+	dims[0] = dims[31] = dims[63] = 2;
+	CHECK(Describe(dims, 2, shape, strides, &total));
+	CHECK(total == 16 && strides[31] == 4 && strides[32] == 8 && strides[63] == 8);
+	dims.push_back(1);
+	CHECK(!Describe(dims, 2, shape, strides, &total));
+	CHECK(!Describe(std::vector<unsigned int>(), 2, shape, strides, &total));
+	CHECK(!Describe(std::vector<unsigned int>(1, 1), 0, shape, strides, &total));
+
+	// A size which doesn't fit a size_t.
+	dims.assign(PYSAFEARRAY_MAX_NDIM, 2);
+	CHECK(!Describe(dims, 1, shape, strides, &total));
+	dims.assign(3, 0x10000);
+	CHECK(sizeof(size_t) == 4 ? !Describe(dims, 1, shape, strides, &total) :
+		Describe(dims, 1, shape, strides, &total) && total == (size_t)1 << 48);
+	dims.assign(4, 0x10000);
+	CHECK(!Describe(dims, 1, shape, strides, &total));
+}
+
+// Copies a source of n ints (value i at index i), laid out with the given
+// shape and element strides, and checks that the result is the column-major
+// order of the values at each index.
+static void CheckCopy(const std::vector<ptrdiff_t> &shape, const std::vector<ptrdiff_t> &strides,
+	size_t n, ptrdiff_t start = 0)
+{
+	size_t count = 1;
+	for (size_t k = 0; k < shape.size(); k++)
+		count *= shape[k];
+	int *src = (int *)malloc((n ? n : 1) * sizeof(int));
+	int *dest = (int *)malloc((count ? count : 1) * sizeof(int));
+	CHECK(src != NULL && dest != NULL);
+	for (size_t i = 0; i < n; i++)
+		src[i] = (int)i;
+	std::vector<ptrdiff_t> byteStrides(strides.size());
+	for (size_t k = 0; k < strides.size(); k++)
+		byteStrides[k] = strides[k] * (ptrdiff_t)sizeof(int);
+	PySafeArrayLayout_CopyToColumnMajor(dest, src + start, (unsigned int)shape.size(), &shape[0],
+		&byteStrides[0], sizeof(int));
+	std::vector<ptrdiff_t> index(shape.size(), 0);
+	for (size_t i = 0; i < count; i++) {
+		ptrdiff_t offset = start;
+		for (size_t k = 0; k < shape.size(); k++)
+			offset += index[k] * strides[k];
+		CHECK(dest[i] == (int)offset);
+		for (size_t k = 0; k < shape.size() && ++index[k] == shape[k]; k++)
+			index[k] = 0;
+	}
+	free(src);
+	free(dest);
+}
+
+static void TestCopy(void)
+{
+	std::vector<ptrdiff_t> shape, strides;
+
+	// A 1 dimensional buffer, contiguous, strided, and reversed.
+	shape.assign(1, 7);
+	strides.assign(1, 1);
+	CheckCopy(shape, strides, 7);
+	strides[0] = 3;
+	CheckCopy(shape, strides, 19);
+	strides[0] = -1;
+	CheckCopy(shape, strides, 7, 6);
+
+	// A C ordered 3x4 array is transposed.
+	shape.assign(2, 3);
+	shape[1] = 4;
+	strides.assign(2, 4);
+	strides[1] = 1;
+	CheckCopy(shape, strides, 12);
+	// And a Fortran ordered one copied as it is.
+	strides[0] = 1;
+	strides[1] = 3;
+	CheckCopy(shape, strides, 12);
+	// Every other column of a 3x8 array.
+	strides[0] = 8;
+	strides[1] = 2;
+	CheckCopy(shape, strides, 24);
+
+	// A C ordered 2x3x4x5 array.
+	shape.resize(4);
+	strides.resize(4);
+	for (int k = 0; k < 4; k++)
+		shape[k] = k + 2;
+	strides[3] = 1;
+	for (int k = 2; k >= 0; k--)
+		strides[k] = strides[k + 1] * shape[k + 1];
+	CheckCopy(shape, strides, 120);
+
+	// An empty array copies nothing.
+	shape[2] = 0;
+	CheckCopy(shape, strides, 0);
+
+	// 64 dimensions, C ordered, of which 3 have 2 elements.
+	shape.assign(PYSAFEARRAY_MAX_NDIM, 1);
+	shape[0] = shape[31] = shape[63] = 2;
+	strides.assign(PYSAFEARRAY_MAX_NDIM, 1);
+	for (int k = PYSAFEARRAY_MAX_NDIM - 2; k >= 0; k--)
+		strides[k] = strides[k + 1] * shape[k + 1];
+	CheckCopy(shape, strides, 8);
+
+	// More dimensions than that are left alone.
+	shape.push_back(1);
+	strides.push_back(1);
+	int src[8] = {1, 2, 3, 4, 5, 6, 7, 8}, dest[8] = {0};
+	PySafeArrayLayout_CopyToColumnMajor(dest, src, (unsigned int)shape.size(), &shape[0], &strides[0], sizeof(int));
+	for (int i = 0; i < 8; i++)
+		CHECK(dest[i] == 0);
+}
+
+static void TestFormatMatches(void)
+{
+	CHECK(PySafeArrayLayout_FormatMatches("d", 8, VT_R8));
+	CHECK(PySafeArrayLayout_FormatMatches("<d", 8, VT_R8));
+	CHECK(PySafeArrayLayout_FormatMatches("=d", 8, VT_R8));
+	CHECK(PySafeArrayLayout_FormatMatches("@d", 8, VT_R8));
+	CHECK(!PySafeArrayLayout_FormatMatches(">d", 8, VT_R8));
+	CHECK(!PySafeArrayLayout_FormatMatches("!d", 8, VT_R8));
+	CHECK(!PySafeArrayLayout_FormatMatches("dd", 8, VT_R8));
+	CHECK(!PySafeArrayLayout_FormatMatches("", 8, VT_R8));
+	// The same size, but a different kind of number.
+	CHECK(!PySafeArrayLayout_FormatMatches("f", 4, VT_I4));
+	CHECK(!PySafeArrayLayout_FormatMatches("i", 4, VT_R4));
+	CHECK(!PySafeArrayLayout_FormatMatches("I", 4, VT_I4));
+	CHECK(!PySafeArrayLayout_FormatMatches("q", 8, VT_R8));
+	// The same kind, but a different size.
+	CHECK(!PySafeArrayLayout_FormatMatches("f", 4, VT_R8));
+	CHECK(!PySafeArrayLayout_FormatMatches("i", 4, VT_I8));
+	// Any code of the right kind and size will do, so a native long matches
+	// VT_I4 or VT_I8 as the platform has it.
+	CHECK(PySafeArrayLayout_FormatMatches("l", 4, VT_I4));
+	CHECK(PySafeArrayLayout_FormatMatches("l", 8, VT_I8));
+	CHECK(PySafeArrayLayout_FormatMatches("N", 8, VT_UI8));
+	CHECK(PySafeArrayLayout_FormatMatches("i", 4, VT_INT));
+	// A NULL format is unsigned bytes.
+	CHECK(PySafeArrayLayout_FormatMatches(NULL, 1, VT_UI1));
+	CHECK(!PySafeArrayLayout_FormatMatches(NULL, 1, VT_I1));
+	// No format matches a type with no buffer representation (VT_BSTR).
+	CHECK(!PySafeArrayLayout_FormatMatches("B", 1, 8));
+}
+
+static void TestCanRefill(void)
+{
+	CHECK(PySafeArrayLayout_CanRefill(VT_R4, 4, "f", 4));
+	CHECK(PySafeArrayLayout_CanRefill(VT_I4, 4, "i", 4));
+	CHECK(PySafeArrayLayout_CanRefill(VT_INT, 4, "<i", 4));
+	// Elements of the same size, but of another type.
+	CHECK(!PySafeArrayLayout_CanRefill(VT_I4, 4, "f", 4));
+	CHECK(!PySafeArrayLayout_CanRefill(VT_R8, 8, "q", 8));
+	CHECK(!PySafeArrayLayout_CanRefill(VT_UI2, 2, "h", 2));
+	// An array whose elements aren't the size its type says.
+	CHECK(!PySafeArrayLayout_CanRefill(VT_R4, 8, "f", 4));
+	// An array of a type with no buffer representation (VT_VARIANT).
+	CHECK(!PySafeArrayLayout_CanRefill(12, 16, "d", 8));
+}
+
+int main(void)
+{
+	TestGetFormat();
+	TestDescribe();
+	TestCopy();
+	TestFormatMatches();
+	TestCanRefill();
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,96 @@
+// Tests of PyWinStringCache.h, against an embedded Python.
+//
+// * Every conversion, cached or not, equals Python's own UTF-16 decoding,
+//   including for lone and paired surrogates.
+// * Repeated strings come from the cache, and the cache holds the only
+//   other references to its strings, which are all released on resize.
+
+#include <Python.h>
+#include "../PyWinStringCache.h"
+#include "check.h"
+
+// Checks the string returned against Python's own decoding of the data,
+// returning the new reference.
+static PyObject *Get(PyWinStringCache *cache, const PyWinUTF16 *s, Py_ssize_t len)
+{
+	PyObject *got = PyWinStringCache_Get(cache, s, len);
+	int byteorder = -1;
+	PyObject *expected = PyUnicode_DecodeUTF16((const char *)s, len * sizeof(PyWinUTF16), "surrogatepass", &byteorder);
+	CHECK(got != NULL && expected != NULL);
+	CHECK(PyUnicode_Compare(got, expected) == 0);
+	Py_DECREF(expected);
+	return got;
+}
+
+static void TestDecode(void)
+{
+	PyWinUTF16 ascii[] = {'a', 'b', 0, 'c'};
+	PyWinUTF16 latin1[] = {0xe9, 'x'};
+	PyWinUTF16 bmp[] = {0x4e2d, 0x6587};
+	PyWinUTF16 pair[] = {0xd83d, 0xde00, 'z'};
+	PyWinUTF16 lone[] = {0xdc00, 'q'};
+	PyWinUTF16 *strings[] = {ascii, latin1, bmp, pair, lone, ascii};
+	Py_ssize_t lengths[] = {4, 2, 2, 3, 2, 0};
+	PyWinStringCache cache = {0};
+	// Uncached, then cached (with collisions) and uncached again.
+	size_t slots[] = {0, 4, 1024, 0};
+	for (size_t i = 0; i < sizeof(slots) / sizeof(slots[0]); i++) {
+		CHECK(PyWinStringCache_Resize(&cache, slots[i], PYWIN_STRING_CACHE_MAX_CHARS));
+		for (int repeat = 0; repeat < 3; repeat++)
+			for (size_t j = 0; j < sizeof(strings) / sizeof(strings[0]); j++)
+				Py_DECREF(Get(&cache, strings[j], lengths[j]));
+	}
+	// The pair is combined into one character.
+	PyObject *combined = Get(&cache, pair, 3);
+	CHECK(PyUnicode_GET_LENGTH(combined) == 2);
+	Py_DECREF(combined);
+	CHECK(PyWinStringCache_Resize(&cache, 0, 0));
+}
+
+static void TestCache(void)
+{
+	PyWinStringCache cache = {0};
+	CHECK(PyWinStringCache_Resize(&cache, 1000, 8));
+	CHECK(cache.numSlots == 1024);
+	PyWinUTF16 name[] = {'N', 'a', 'm', 'e'};
+	PyObject *a = Get(&cache, name, 4);
+	PyObject *b = Get(&cache, name, 4);
+	CHECK(a == b);
+	CHECK(cache.hits == 1 && cache.misses == 1);
+	// The caller's two references and the cache's.
+	CHECK(Py_REFCNT(a) == 3);
+
+	// Too long to be cached.
+	PyWinUTF16 longName[9] = {'L', 'o', 'n', 'g'};
+	PyObject *c = Get(&cache, longName, 9);
+	PyObject *d = Get(&cache, longName, 9);
+	CHECK(c != d);
+	CHECK(cache.hits == 1 && cache.misses == 1);
+	Py_DECREF(c);
+	Py_DECREF(d);
+
+	// Fill a one slot cache with different strings.
+	CHECK(PyWinStringCache_Resize(&cache, 1, 8));
+	CHECK(Py_REFCNT(a) == 2);
+	PyWinUTF16 other[] = {'N', 'a', 'm', 'f'};
+	Py_DECREF(Get(&cache, name, 4));
+	Py_DECREF(Get(&cache, other, 4));
+	Py_DECREF(Get(&cache, name, 4));
+	CHECK(cache.evictions == 2);
+
+	CHECK(PyWinStringCache_Resize(&cache, 0, 0));
+	CHECK(cache.slots == NULL);
+	CHECK(Py_REFCNT(a) == 2);
+	Py_DECREF(a);
+	Py_DECREF(b);
+}
+
+int main(void)
+{
+	Py_Initialize();
+	TestDecode();
+	TestCache();
+	Py_Finalize();
+	printf("OK\n");
+	return 0;
+}
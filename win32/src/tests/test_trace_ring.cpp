@@ -0,0 +1,273 @@
+// Stress tests of win32trace_ring.h, run in POSIX shared memory.
+//
+// * Writer threads, and forked writer processes, race a reader: every
+//   record must be either delivered, in order for each writer, or counted
+//   as dropped.
+// * A writer which dies after claiming a record - before or after it
+//   advances head - must not stop the others, and its record is skipped
+//   once the reader sees the process has gone.
+
+#include "../win32trace_ring.h"
+#include "check.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Small, so the ring wraps often and fills up sometimes.
+const unsigned int RING_SIZE = 16384;
+const int MAX_WRITERS = 128;
+
+// A ring in memory shared with any processes forked afterwards.
+struct SharedRing : PyTraceRing
+{
+	SharedRing()
+	{
+		void *mem = mmap(NULL, MappingSize(RING_SIZE), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		CHECK(mem != MAP_FAILED);
+		CHECK(Init(mem, RING_SIZE) == NULL);
+	}
+	~SharedRing()
+	{
+		munmap(header, MappingSize(RING_SIZE));
+	}
+};
+
+// Each record's text starts with the writer's count of records written.
+struct Received
+{
+	long long last[MAX_WRITERS];
+	long long count;
+};
+
+static bool CheckRecord(void *context, const PyTraceRecord *rec, const char *text, unsigned int length)
+{
+	Received *got = (Received *)context;
+	long long n;
+	CHECK(length >= sizeof(n) && rec->tid < MAX_WRITERS);
+	memcpy(&n, text, sizeof(n));
+	CHECK(length == sizeof(n) + n % 50);
+	for (unsigned int i = sizeof(n); i < length; i++)
+		CHECK(text[i] == (char)(n + i));
+	CHECK(n > got->last[rec->tid]);
+	got->last[rec->tid] = n;
+	got->count++;
+	return true;
+}
+
+static void WriteRecords(PyTraceRing *ring, unsigned int writer, long long count)
+{
+	for (long long n = 0; n < count; n++) {
+		char text[sizeof(n) + 50];
+		unsigned int length = (unsigned int)(sizeof(n) + n % 50);
+		memcpy(text, &n, sizeof(n));
+		for (unsigned int i = sizeof(n); i < length; i++)
+			text[i] = (char)(n + i);
+		ring->Write(text, length, getpid(), writer, n);
+		// Give the reader a chance to keep up.
+		if (n % 16 == 0)
+			sched_yield();
+	}
+}
+
+struct WriterArgs
+{
+	PyTraceRing *ring;
+	unsigned int writer;
+	long long count;
+	volatile int *done;
+};
+
+static void *WriterThread(void *arg)
+{
+	WriterArgs *args = (WriterArgs *)arg;
+	WriteRecords(args->ring, args->writer, args->count);
+	__atomic_add_fetch(args->done, 1, __ATOMIC_SEQ_CST);
+	return NULL;
+}
+
+static void CheckAllAccounted(PyTraceRing *ring, Received *got, long long total)
+{
+	PyTraceRingStats stats;
+	ring->GetStats(&stats);
+	printf("  received %lld, dropped %lld of %lld\n", got->count, stats.droppedRecords, total);
+	CHECK(got->count + stats.droppedRecords == total);
+	CHECK(stats.pending == 0);
+}
+
+static void TestThreads(void)
+{
+	printf("threads\n");
+	const int writers = 4;
+	const long long count = 100000;
+	SharedRing shared;
+	PyTraceRing *ring = &shared;
+	Received got;
+	memset(&got, 0xff, sizeof(got.last));
+	got.count = 0;
+	volatile int done = 0;
+	pthread_t threads[writers];
+	WriterArgs args[writers];
+	for (int i = 0; i < writers; i++) {
+		args[i].ring = ring;
+		args[i].writer = i;
+		args[i].count = count;
+		args[i].done = &done;
+		CHECK(pthread_create(&threads[i], NULL, WriterThread, &args[i]) == 0);
+	}
+	while (__atomic_load_n(&done, __ATOMIC_SEQ_CST) < writers)
+		ring->Drain(ring->Head(), CheckRecord, &got);
+	for (int i = 0; i < writers; i++)
+		pthread_join(threads[i], NULL);
+	ring->Drain(ring->Head(), CheckRecord, &got);
+	CheckAllAccounted(ring, &got, writers * count);
+}
+
+static void TestProcesses(void)
+{
+	printf("processes\n");
+	const int writers = 4;
+	const long long count = 100000;
+	SharedRing shared;
+	PyTraceRing *ring = &shared;
+	Received got;
+	memset(&got, 0xff, sizeof(got.last));
+	got.count = 0;
+	pid_t pids[writers];
+	fflush(stdout);
+	for (int i = 0; i < writers; i++) {
+		pids[i] = fork();
+		CHECK(pids[i] >= 0);
+		if (pids[i] == 0) {
+			WriteRecords(ring, i, count);
+			_exit(0);
+		}
+	}
+	int running = writers;
+	while (running) {
+		ring->Drain(ring->Head(), CheckRecord, &got);
+		int status;
+		while (waitpid(-1, &status, WNOHANG) > 0) {
+			CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+			running--;
+		}
+	}
+	ring->Drain(ring->Head(), CheckRecord, &got);
+	CheckAllAccounted(ring, &got, writers * count);
+}
+
+static bool ProcessGone(unsigned int pid)
+{
+	return kill((pid_t)pid, 0) == -1 && errno == ESRCH;
+}
+
+// Forks a process which claims a record and is killed before finishing it.
+// With advanceHead false, it dies between claiming the record and
+// advancing head past it.
+static void KillDuringWrite(PyTraceRing *ring, bool advanceHead)
+{
+	int ready[2];
+	CHECK(pipe(ready) == 0);
+	fflush(stdout);
+	pid_t pid = fork();
+	CHECK(pid >= 0);
+	if (pid == 0) {
+		if (advanceHead) {
+			PyTraceInt64 pos;
+			CHECK(ring->Claim(PyTraceRing::RecordSize(8), getpid(), &pos) != 0);
+		}
+		else {
+			PyTraceInt64 head = ring->Head();
+			CHECK(PyTraceAtomic_CAS64(&ring->RecordAt(head)->state, head,
+				PyTraceRecord::MakeState(PYTRACE_STATE_CLAIMED, PyTraceRing::RecordSize(8), getpid())));
+			CHECK(ring->Head() == head);
+		}
+		CHECK(write(ready[1], "x", 1) == 1);
+		pause();
+		_exit(0);
+	}
+	char c;
+	CHECK(read(ready[0], &c, 1) == 1);
+	kill(pid, SIGKILL);
+	CHECK(waitpid(pid, NULL, 0) == pid);
+	close(ready[0]);
+	close(ready[1]);
+}
+
+static void TestDeadWriter(bool advanceHead)
+{
+	printf("dead writer, %s head advanced\n", advanceHead ? "with" : "without");
+	SharedRing shared;
+	PyTraceRing *ring = &shared;
+	Received got;
+	memset(&got, 0xff, sizeof(got.last));
+	got.count = 0;
+	WriteRecords(ring, 0, 3);
+	KillDuringWrite(ring, advanceHead);
+	// Other writers carry on.
+	WriteRecords(ring, 1, 3);
+	PyTraceRingStats stats;
+	ring->GetStats(&stats);
+	CHECK(stats.droppedRecords == 0);
+	// Without an owner check, the reader waits for the record forever.
+	CHECK(ring->Drain(ring->Head(), CheckRecord, &got) == 3);
+	CHECK(ring->Drain(ring->Head(), CheckRecord, &got) == 0);
+	// It is only skipped when it was already unfinished at the last drain.
+	CHECK(ring->Drain(ring->Head(), CheckRecord, &got, ProcessGone) == 3);
+	ring->GetStats(&stats);
+	CHECK(stats.droppedRecords == 1);
+	CHECK(stats.pending == 0);
+	// And the ring still works, all the way round.
+	for (int i = 0; i < 100; i++) {
+		WriteRecords(ring, 2 + i, 10);
+		ring->Drain(ring->Head(), CheckRecord, &got);
+	}
+	CheckAllAccounted(ring, &got, 3 + 3 + 1000 + 1);
+}
+
+static bool NeverGone(unsigned int pid)
+{
+	return false;
+}
+
+static void TestSlowWriter(void)
+{
+	printf("slow writer\n");
+	SharedRing shared;
+	PyTraceRing *ring = &shared;
+	Received got;
+	memset(&got, 0xff, sizeof(got.last));
+	got.count = 0;
+	PyTraceInt64 pos;
+	PyTraceInt64 claimed = ring->Claim(PyTraceRing::RecordSize(8), getpid(), &pos);
+	CHECK(claimed != 0);
+	WriteRecords(ring, 1, 3);
+	// A live writer is waited for, however long it takes.
+	for (int i = 0; i < 3; i++)
+		CHECK(ring->Drain(ring->Head(), CheckRecord, &got, NeverGone) == 0);
+	CHECK(ring->Drain(ring->Head(), CheckRecord, &got, ProcessGone) == 0);
+	long long n = 0;
+	PyTraceRecord *rec = ring->RecordAt(pos);
+	rec->tid = 0;
+	memcpy((char *)rec + PYTRACE_RECORD_HEADER_SIZE, &n, sizeof(n));
+	CHECK(PyTraceAtomic_CAS64(&rec->state, claimed,
+		PyTraceRecord::MakeState(PYTRACE_STATE_COMMITTED, PyTraceRing::RecordSize(8), 8)));
+	CHECK(ring->Drain(ring->Head(), CheckRecord, &got, ProcessGone) == 4);
+	CheckAllAccounted(ring, &got, 4);
+}
+
+int main(void)
+{
+	TestThreads();
+	TestProcesses();
+	TestDeadWriter(true);
+	TestDeadWriter(false);
+	TestSlowWriter();
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,235 @@
+// win32_stubs.cpp - the functions in win32_stubs.h.
+
+#include "win32_stubs.h"
+
+#include <pthread.h>
+#include <time.h>
+
+static __thread DWORD lastError;
+
+DWORD GetLastError(void)
+{
+	return lastError;
+}
+
+void SetLastError(DWORD err)
+{
+	lastError = err;
+}
+
+DWORD GetTickCount(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (DWORD)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+// Seconds between 1601 and 1970.
+#define EPOCH_DIFFERENCE 11644473600LL
+
+void GetSystemTimeAsFileTime(FILETIME *ft)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ULONGLONG t = (ts.tv_sec + EPOCH_DIFFERENCE) * 10000000ULL + ts.tv_nsec / 100;
+	ft->dwLowDateTime = (DWORD)(t & 0xFFFFFFFF);
+	ft->dwHighDateTime = (DWORD)(t >> 32);
+}
+
+void InitializeCriticalSection(CRITICAL_SECTION *cs)
+{
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_t *m = new pthread_mutex_t;
+	pthread_mutex_init(m, &attr);
+	pthread_mutexattr_destroy(&attr);
+	cs->impl = m;
+}
+
+void DeleteCriticalSection(CRITICAL_SECTION *cs)
+{
+	pthread_mutex_t *m = (pthread_mutex_t *)cs->impl;
+	pthread_mutex_destroy(m);
+	delete m;
+}
+
+void EnterCriticalSection(CRITICAL_SECTION *cs)
+{
+	pthread_mutex_lock((pthread_mutex_t *)cs->impl);
+}
+
+void LeaveCriticalSection(CRITICAL_SECTION *cs)
+{
+	pthread_mutex_unlock((pthread_mutex_t *)cs->impl);
+}
+
+// An event or a thread.
+struct FakeHandle
+{
+	bool isThread;
+	pthread_t thread;
+	unsigned (__stdcall *start)(void *);
+	void *arg;
+	pthread_mutex_t m;
+	pthread_cond_t c;
+	bool set, manualReset;
+};
+
+HANDLE CreateEvent(void *attrs, BOOL manualReset, BOOL initialState, const char *name)
+{
+	FakeHandle *h = new FakeHandle();
+	pthread_mutex_init(&h->m, NULL);
+	pthread_cond_init(&h->c, NULL);
+	h->set = initialState != FALSE;
+	h->manualReset = manualReset != FALSE;
+	return h;
+}
+
+BOOL SetEvent(HANDLE handle)
+{
+	FakeHandle *h = (FakeHandle *)handle;
+	pthread_mutex_lock(&h->m);
+	h->set = true;
+	pthread_cond_broadcast(&h->c);
+	pthread_mutex_unlock(&h->m);
+	return TRUE;
+}
+
+BOOL ResetEvent(HANDLE handle)
+{
+	FakeHandle *h = (FakeHandle *)handle;
+	pthread_mutex_lock(&h->m);
+	h->set = false;
+	pthread_mutex_unlock(&h->m);
+	return TRUE;
+}
+
+static void *ThreadStart(void *arg)
+{
+	FakeHandle *h = (FakeHandle *)arg;
+	h->start(h->arg);
+	return NULL;
+}
+
+uintptr_t _beginthreadex(void *security, unsigned stackSize, unsigned (__stdcall *start)(void *),
+	void *arg, unsigned flags, unsigned *threadId)
+{
+	FakeHandle *h = new FakeHandle();
+	h->isThread = true;
+	h->start = start;
+	h->arg = arg;
+	if (pthread_create(&h->thread, NULL, ThreadStart, h) != 0) {
+		delete h;
+		return 0;
+	}
+	return (uintptr_t)h;
+}
+
+DWORD WaitForSingleObject(HANDLE handle, DWORD timeout)
+{
+	FakeHandle *h = (FakeHandle *)handle;
+	if (h->isThread) {
+		// Only ever waited for once, without a timeout.
+		pthread_join(h->thread, NULL);
+		return WAIT_OBJECT_0;
+	}
+	struct timespec until;
+	clock_gettime(CLOCK_REALTIME, &until);
+	if (timeout == INFINITE)
+		until.tv_sec += 100000;
+	else {
+		until.tv_sec += timeout / 1000;
+		until.tv_nsec += (timeout % 1000) * 1000000;
+		if (until.tv_nsec >= 1000000000) {
+			until.tv_sec++;
+			until.tv_nsec -= 1000000000;
+		}
+	}
+	pthread_mutex_lock(&h->m);
+	int rc = 0;
+	while (!h->set && rc == 0)
+		rc = pthread_cond_timedwait(&h->c, &h->m, &until);
+	DWORD ret = h->set ? WAIT_OBJECT_0 : WAIT_TIMEOUT;
+	if (h->set && !h->manualReset)
+		h->set = false;
+	pthread_mutex_unlock(&h->m);
+	return ret;
+}
+
+BOOL CloseHandle(HANDLE handle)
+{
+	FakeHandle *h = (FakeHandle *)handle;
+	if (!h->isThread) {
+		pthread_mutex_destroy(&h->m);
+		pthread_cond_destroy(&h->c);
+	}
+	delete h;
+	return TRUE;
+}
+
+size_t wcslen(const WCHAR *s)
+{
+	size_t len = 0;
+	while (s[len])
+		len++;
+	return len;
+}
+
+PyObject *PyWin_SetAPIError(char *fnName, long err)
+{
+	PyErr_Format(PyExc_OSError, "%s failed: %ld", fnName, err);
+	return NULL;
+}
+
+BOOL PyWinObject_AsHANDLE(PyObject *ob, HANDLE *ph)
+{
+	*ph = ob == Py_None ? NULL : PyLong_AsVoidPtr(ob);
+	return !PyErr_Occurred();
+}
+
+PyObject *PyWinLong_FromHANDLE(HANDLE h)
+{
+	return PyLong_FromVoidPtr(h);
+}
+
+BOOL PyWinObject_AsWCHAR(PyObject *ob, WCHAR **pResult, BOOL bNoneOK, DWORD *pResultLen)
+{
+	*pResult = NULL;
+	if (ob == Py_None) {
+		if (!bNoneOK)
+			PyErr_SetString(PyExc_TypeError, "None is not a valid string in this context");
+		return bNoneOK;
+	}
+	PyObject *encoded = PyUnicode_AsEncodedString(ob, "utf-16-le", NULL);
+	if (encoded == NULL)
+		return FALSE;
+	Py_ssize_t size = PyBytes_GET_SIZE(encoded);
+	*pResult = (WCHAR *)malloc(size + sizeof(WCHAR));
+	memcpy(*pResult, PyBytes_AS_STRING(encoded), size);
+	(*pResult)[size / sizeof(WCHAR)] = 0;
+	if (pResultLen)
+		*pResultLen = (DWORD)(size / sizeof(WCHAR));
+	Py_DECREF(encoded);
+	return TRUE;
+}
+
+void PyWinObject_FreeWCHAR(WCHAR *str)
+{
+	free(str);
+}
+
+PyObject *PyWinObject_FromWCHAR(const WCHAR *str)
+{
+	return PyUnicode_FromKindAndData(PyUnicode_2BYTE_KIND, str, wcslen(str));
+}
+
+PyObject *PyWinCoreString_FromString(const char *str)
+{
+	return PyUnicode_FromString(str);
+}
+
+PyObject *PyWinObject_FromFILETIME(const FILETIME &ft)
+{
+	return PyLong_FromUnsignedLongLong(((ULONGLONG)ft.dwHighDateTime << 32) | ft.dwLowDateTime);
+}
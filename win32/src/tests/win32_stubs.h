@@ -0,0 +1,103 @@
+// win32_stubs.h - just enough of the Windows and pywintypes APIs to build
+// native parts of the extension modules on other platforms, implemented on
+// pthreads in win32_stubs.cpp.  The stubs of each module's own API build
+// on these.
+
+#ifndef __WIN32_STUBS_H__
+#define __WIN32_STUBS_H__
+
+#include <Python.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef int BOOL;
+typedef unsigned long DWORD;	// As the "k" format units expect.
+typedef DWORD *LPDWORD;
+typedef unsigned char BYTE;
+typedef void *HANDLE;
+typedef void *PSID;
+typedef unsigned short WCHAR;
+typedef WCHAR *LPWSTR;
+typedef const WCHAR *LPCWSTR;
+typedef signed char INT8;
+typedef unsigned char UINT8;
+typedef short INT16;
+typedef unsigned short UINT16;
+typedef int INT32;
+typedef unsigned int UINT32;
+typedef long long INT64;
+typedef unsigned long long UINT64;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef uintptr_t ULONG_PTR;
+typedef struct { DWORD dwLowDateTime, dwHighDateTime; } FILETIME;
+typedef struct { short w[8]; } SYSTEMTIME;
+typedef struct { unsigned char b[16]; } GUID;
+typedef struct { long long QuadPart; } LARGE_INTEGER;
+// The parts are 32 bits, as on Windows, unlike DWORD here.
+typedef union { struct { UINT32 LowPart, HighPart; }; ULONGLONG QuadPart; } ULARGE_INTEGER;
+typedef struct { void *impl; } CRITICAL_SECTION;
+
+#define TRUE 1
+#define FALSE 0
+#define INFINITE 0xFFFFFFFF
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258
+#define WAIT_FAILED 0xFFFFFFFF
+#define ERROR_SUCCESS 0
+#define ERROR_NOT_ENOUGH_MEMORY 8
+#define ERROR_INVALID_DATA 13
+#define ERROR_OUTOFMEMORY 14
+#define ERROR_INSUFFICIENT_BUFFER 122
+#define ERROR_NO_MORE_ITEMS 259
+#define CALLBACK
+#define WINAPI
+#define __stdcall
+
+void InitializeCriticalSection(CRITICAL_SECTION *cs);
+void DeleteCriticalSection(CRITICAL_SECTION *cs);
+void EnterCriticalSection(CRITICAL_SECTION *cs);
+void LeaveCriticalSection(CRITICAL_SECTION *cs);
+HANDLE CreateEvent(void *attrs, BOOL manualReset, BOOL initialState, const char *name);
+BOOL SetEvent(HANDLE h);
+BOOL ResetEvent(HANDLE h);
+DWORD WaitForSingleObject(HANDLE h, DWORD timeout);
+BOOL CloseHandle(HANDLE h);
+uintptr_t _beginthreadex(void *security, unsigned stackSize, unsigned (__stdcall *start)(void *),
+	void *arg, unsigned flags, unsigned *threadId);
+DWORD GetTickCount(void);
+void GetSystemTimeAsFileTime(FILETIME *ft);
+DWORD GetLastError(void);
+void SetLastError(DWORD err);
+
+// WCHAR is 2 bytes, as on Windows, so isn't wchar_t.
+size_t wcslen(const WCHAR *s);
+
+// pywintypes
+#define PYWIN_OBJECT_HEAD PyVarObject_HEAD_INIT(NULL, 0)
+#define PyInt_FromLong PyLong_FromLong
+#define PyInt_FromSsize_t PyLong_FromSsize_t
+#define PyString_FromStringAndSize PyBytes_FromStringAndSize
+
+PyObject *PyWin_SetAPIError(char *fnName, long err = 0);
+BOOL PyWinObject_AsHANDLE(PyObject *ob, HANDLE *ph);
+PyObject *PyWinLong_FromHANDLE(HANDLE h);
+BOOL PyWinObject_AsWCHAR(PyObject *ob, WCHAR **pResult, BOOL bNoneOK = FALSE, DWORD *pResultLen = NULL);
+void PyWinObject_FreeWCHAR(WCHAR *str);
+
+class TmpWCHAR
+{
+public:
+	WCHAR *tmp;
+	TmpWCHAR() {tmp = NULL;}
+	~TmpWCHAR() {PyWinObject_FreeWCHAR(tmp);}
+	WCHAR **operator&() {return &tmp;}
+	operator WCHAR *() {return tmp;}
+};
+PyObject *PyWinObject_FromWCHAR(const WCHAR *str);
+PyObject *PyWinCoreString_FromString(const char *str);
+// The time as an int, in 100 nanosecond units, rather than a PyTime.
+PyObject *PyWinObject_FromFILETIME(const FILETIME &ft);
+
+#endif // __WIN32_STUBS_H__
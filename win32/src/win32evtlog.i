@@ -14,6 +14,8 @@
 #undef PyHANDLE
 #include "PyWinObjects.h"
 #include "WinEvt.h"
+#include "PyWinEventLogRecord.h"
+#include <process.h>
 
 // @object PyEVTLOG_HANDLE|Object representing a handle to the windows event log.
 //   Identical to <o PyHANDLE>, but calls CloseEventLog() on destruction
@@ -102,41 +104,238 @@ typedef HANDLE PyEVTLOG_HANDLE;
 
 %{
 
-// @object PyEventLogRecord|An object containing the data in an EVENTLOGRECORD.
-class PyEventLogRecord : public PyObject
+// The buffer records were read into - many records may point here!
+class PyEventLogBuffer
 {
 public:
-	PyEventLogRecord(EVENTLOGRECORD *pEvt);
-	~PyEventLogRecord(void);
+	PyEventLogBuffer(DWORD size)
+	{
+		data = (BYTE *)malloc(size);
+		this->size = data ? size : 0;
+		ref = 1;
+	}
+	~PyEventLogBuffer()
+	{
+		free(data);
+	}
+	void AddRef() {
+		ref++;
+	}
+	void Release() {
+		if (--ref==0)
+			delete this;
+	}
+	BYTE *data;
+	DWORD size;
+	long ref;
+};
+
+// The buffer ReadEventLog last used, which is reused once no records refer
+// to it.  Only touched with the GIL held.
+static PyEventLogBuffer *g_readBuffer = NULL;
+
+// Returns a buffer of at least size bytes, which the caller must pass to
+// ReleaseReadBuffer.
+static PyEventLogBuffer *GetReadBuffer(DWORD size)
+{
+	PyEventLogBuffer *ret = g_readBuffer;
+	g_readBuffer = NULL;
+	if (ret != NULL) {
+		if (ret->ref == 1 && ret->size >= size)
+			return ret;
+		ret->Release();
+	}
+	ret = new PyEventLogBuffer(size);
+	if (ret == NULL || ret->data == NULL) {
+		delete ret;
+		PyErr_SetString(PyExc_MemoryError, "Allocating event log buffer");
+		return NULL;
+	}
+	return ret;
+}
+
+static void ReleaseReadBuffer(PyEventLogBuffer *buf)
+{
+	if (g_readBuffer == NULL)
+		g_readBuffer = buf;
+	else
+		buf->Release();
+}
+
+// @object PyEventLogFilter|Selects the event log records to return, before
+//	any Python objects are created for them.
+// @comm Created by <om win32evtlog.EventLogFilter>, and passed to
+//	<om win32evtlog.ReadEventLog> or <om win32evtlog.ParseEventLogRecords>.
+class PyEventLogFilter : public PyObject
+{
+public:
+	PyEventLogFilter();
+	~PyEventLogFilter(void);
 
 	static void deallocFunc(PyObject *ob);
-	static struct PyMemberDef members[];
 
-protected:
-	DWORD Reserved;
-	DWORD RecordNumber;
-	PyObject *TimeGenerated;
-	PyObject * TimeWritten;
-	DWORD EventID;
-	WORD EventType;
-	PyObject *SourceName;
-	PyObject *StringInserts;
-	WORD EventCategory;
-	WORD ReservedFlags;
-	DWORD ClosingRecordNumber;
-	PyObject *Sids;
-	PyObject *Data;
-	PyObject *ComputerName;
+	PyWinEventLogFilter filter;
+	unsigned int *eventIDs;
+	WCHAR *sourceName;
+};
+
+PyTypeObject PyEventLogFilterType =
+{
+	PYWIN_OBJECT_HEAD
+	"PyEventLogFilter",
+	sizeof(PyEventLogFilter),
+	0,
+	PyEventLogFilter::deallocFunc,		/* tp_dealloc */
+	0,						/* tp_print */
+	0,						/* tp_getattr */
+	0,						/* tp_setattr */
+	0,						/* tp_compare */
+	0,						/* tp_repr */
+	0,						/* tp_as_number */
+	0,						/* tp_as_sequence */
+	0,						/* tp_as_mapping */
+	0,						/* tp_hash */
+	0,						/* tp_call */
+	0,						/* tp_str */
+	PyObject_GenericGetAttr,	/* tp_getattro */
+	0,						/* tp_setattro */
+	0,						/*tp_as_buffer*/
+	Py_TPFLAGS_DEFAULT,		/* tp_flags */
 };
 
-/*
-PyObject *PyWinMethod_NewEventLogRecord(PyObject *self, PyObject *args)
+PyEventLogFilter::PyEventLogFilter()
+{
+	ob_type = &PyEventLogFilterType;
+	_Py_NewReference(this);
+	memset(&filter, 0, sizeof(filter));
+	eventIDs = NULL;
+	sourceName = NULL;
+}
+
+PyEventLogFilter::~PyEventLogFilter(void)
 {
-	if (!PyArg_ParseTuple(args, ":EventLogRecord"))
+	free(eventIDs);
+	PyWinObject_FreeWCHAR(sourceName);
+}
+
+/*static*/ void PyEventLogFilter::deallocFunc(PyObject *ob)
+{
+	delete (PyEventLogFilter *)ob;
+}
+
+static int CompareEventIDs(const void *a, const void *b)
+{
+	unsigned int ia = *(const unsigned int *)a, ib = *(const unsigned int *)b;
+	return ia < ib ? -1 : ia > ib ? 1 : 0;
+}
+
+// @pyswig <o PyEventLogFilter>|EventLogFilter|Creates a filter for event log records.
+// @comm A record is kept only if it passes every test given.
+PyObject *PyEventLogFilter_New(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *keywords[] = {"EventIDs", "EventTypes", "SourceName", NULL};
+	PyObject *obIDs = Py_None, *obSourceName = Py_None;
+	DWORD typeMask = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OkO:EventLogFilter", keywords,
+		&obIDs,			// @pyparm [int,...]|EventIDs|None|Event IDs to keep.  An ID matches either the
+						//	full EventID of a record, or its low 16 bits (as shown by Event Viewer).
+		&typeMask,		// @pyparm int|EventTypes|0|A mask of the EVENTLOG_*_TYPE and EVENTLOG_AUDIT_* values to keep.
+						//	As EVENTLOG_SUCCESS is 0, those records are only kept if the mask is 0.
+		&obSourceName))	// @pyparm <o PyUnicode>|SourceName|None|The source to keep.  ASCII letters are compared
+						//	ignoring case.
+		return NULL;
+	PyEventLogFilter *ret = new PyEventLogFilter();
+	if (ret == NULL)
+		return PyErr_NoMemory();
+	if (obIDs != Py_None) {
+		PyObject *seq = PySequence_Fast(obIDs, "EventIDs must be a sequence of integers");
+		if (seq == NULL) {
+			Py_DECREF(ret);
+			return NULL;
+		}
+		Py_ssize_t num = PySequence_Fast_GET_SIZE(seq);
+		ret->eventIDs = (unsigned int *)malloc((num ? num : 1) * sizeof(unsigned int));
+		if (ret->eventIDs == NULL) {
+			Py_DECREF(seq);
+			Py_DECREF(ret);
+			return PyErr_NoMemory();
+		}
+		for (Py_ssize_t i = 0; i < num; i++) {
+			// Allow the negative values EventLogRecord.EventID can have.
+			unsigned long id = PyLong_AsUnsignedLongMask(PySequence_Fast_GET_ITEM(seq, i));
+			if (id == (unsigned long)-1 && PyErr_Occurred()) {
+				Py_DECREF(seq);
+				Py_DECREF(ret);
+				return NULL;
+			}
+			ret->eventIDs[i] = (unsigned int)id;
+		}
+		Py_DECREF(seq);
+		if (num == 0) {
+			PyErr_SetString(PyExc_ValueError, "EventIDs must not be empty");
+			Py_DECREF(ret);
+			return NULL;
+		}
+		qsort(ret->eventIDs, num, sizeof(unsigned int), CompareEventIDs);
+		ret->filter.eventIDs = ret->eventIDs;
+		ret->filter.numEventIDs = num;
+	}
+	ret->filter.typeMask = typeMask;
+	DWORD len = 0;
+	if (!PyWinObject_AsWCHAR(obSourceName, &ret->sourceName, TRUE, &len)) {
+		Py_DECREF(ret);
 		return NULL;
-	return new PyEventLogRecord();
+	}
+	ret->filter.sourceName = (const PyWinUTF16 *)ret->sourceName;
+	ret->filter.sourceNameLen = len;
+	return ret;
+}
+
+PyCFunction pfnPyEventLogFilter_New = (PyCFunction)PyEventLogFilter_New;
+
+static BOOL PyWinObject_AsEventLogFilter(PyObject *ob, PyWinEventLogFilter **ppfilter)
+{
+	if (ob == Py_None) {
+		*ppfilter = NULL;
+		return TRUE;
+	}
+	if (ob->ob_type != &PyEventLogFilterType) {
+		PyErr_SetString(PyExc_TypeError, "Filter must be a PyEventLogFilter object (see EventLogFilter)");
+		return FALSE;
+	}
+	*ppfilter = &((PyEventLogFilter *)ob)->filter;
+	return TRUE;
 }
-*/
+
+// The fields of PyEventLogRecord, each converted on first use.
+enum {
+	ELR_RESERVED, ELR_RECORDNUMBER, ELR_TIMEGENERATED, ELR_TIMEWRITTEN,
+	ELR_EVENTID, ELR_EVENTTYPE, ELR_EVENTCATEGORY, ELR_RESERVEDFLAGS,
+	ELR_CLOSINGRECORDNUMBER, ELR_SOURCENAME, ELR_STRINGINSERTS, ELR_SID,
+	ELR_DATA, ELR_COMPUTERNAME, ELR_NUM_FIELDS
+};
+
+// @object PyEventLogRecord|An object containing the data in an EVENTLOGRECORD.
+// @comm The record refers to the buffer it was read into, and only creates
+//	the object for each attribute when it is first used.  Attributes may be
+//	assigned to.
+class PyEventLogRecord : public PyObject
+{
+public:
+	PyEventLogRecord(PyEventLogBuffer *buffer, const PyWinEventLogRecordInfo *info);
+	~PyEventLogRecord(void);
+
+	static void deallocFunc(PyObject *ob);
+	static PyObject *getField(PyObject *self, void *closure);
+	static int setField(PyObject *self, PyObject *v, void *closure);
+	static PyGetSetDef getset[];
+
+protected:
+	PyObject *MakeField(int field);
+	PyEventLogBuffer *buffer;
+	PyWinEventLogRecordInfo info;
+	PyObject *fields[ELR_NUM_FIELDS];
+};
 
 PyTypeObject PyEventLogRecordType =
 {
@@ -168,8 +367,8 @@ PyTypeObject PyEventLogRecordType =
 	0,						/* tp_iter */
 	0,						/* tp_iternext */
 	0,						/* tp_methods */
-	PyEventLogRecord::members,	/* tp_members */
-	0,						/* tp_getset */
+	0,						/* tp_members */
+	PyEventLogRecord::getset,	/* tp_getset */
 	0,						/* tp_base */
 	0,						/* tp_dict */
 	0,						/* tp_descr_get */
@@ -180,168 +379,286 @@ PyTypeObject PyEventLogRecordType =
 	0,						/* tp_new */
 };
 
-#define OFF(e) offsetof(PyEventLogRecord, e)
-
-/*static*/ struct PyMemberDef PyEventLogRecord::members[] = {
-	{"Reserved",           T_INT,     OFF(Reserved)}, // @prop integer|Reserved|
-	{"RecordNumber",       T_INT,	  OFF(RecordNumber)}, // @prop integer|RecordNumber|
-	{"TimeGenerated",      T_OBJECT,  OFF(TimeGenerated)}, // @prop <o PyTime>|TimeGenerated|
-	{"TimeWritten",        T_OBJECT,  OFF(TimeWritten)}, // @prop <o PyTime>|TimeWritten|
-	{"EventID",            T_INT,	  OFF(EventID)}, // @prop integer|EventID|
-	{"EventType",          T_SHORT,	  OFF(EventType)}, // @prop integer|EventType|
-	{"EventCategory",      T_SHORT,   OFF(EventCategory)}, // @prop integer|EventCategory|
-	{"ReservedFlags",      T_SHORT,   OFF(ReservedFlags)}, // @prop integer|ReservedFlags|
-	{"ClosingRecordNumber",T_INT,     OFF(ClosingRecordNumber)}, // @prop integer|ClosingRecordNumber|
-	{"SourceName",         T_OBJECT,  OFF(SourceName)}, // @prop <o PyUnicode>|SourceName|
-	{"StringInserts",      T_OBJECT,  OFF(StringInserts)}, // @prop (<o PyUnicode>,...)|StringInserts|
-	{"Sid",                T_OBJECT,  OFF(Sids)}, // @prop <o PySID>|Sid|
-	{"Data",               T_OBJECT,  OFF(Data)}, // @prop string|Data|
-	{"ComputerName",       T_OBJECT,  OFF(ComputerName)}, // @prop <o PyUnicode>|ComputerName|
+#define ELR_FIELD(name, field) {name, PyEventLogRecord::getField, PyEventLogRecord::setField, NULL, (void *)field}
+
+/*static*/ PyGetSetDef PyEventLogRecord::getset[] = {
+	ELR_FIELD("Reserved", ELR_RESERVED), // @prop integer|Reserved|
+	ELR_FIELD("RecordNumber", ELR_RECORDNUMBER), // @prop integer|RecordNumber|
+	ELR_FIELD("TimeGenerated", ELR_TIMEGENERATED), // @prop <o PyTime>|TimeGenerated|
+	ELR_FIELD("TimeWritten", ELR_TIMEWRITTEN), // @prop <o PyTime>|TimeWritten|
+	ELR_FIELD("EventID", ELR_EVENTID), // @prop integer|EventID|
+	ELR_FIELD("EventType", ELR_EVENTTYPE), // @prop integer|EventType|
+	ELR_FIELD("EventCategory", ELR_EVENTCATEGORY), // @prop integer|EventCategory|
+	ELR_FIELD("ReservedFlags", ELR_RESERVEDFLAGS), // @prop integer|ReservedFlags|
+	ELR_FIELD("ClosingRecordNumber", ELR_CLOSINGRECORDNUMBER), // @prop integer|ClosingRecordNumber|
+	ELR_FIELD("SourceName", ELR_SOURCENAME), // @prop <o PyUnicode>|SourceName|
+	ELR_FIELD("StringInserts", ELR_STRINGINSERTS), // @prop (<o PyUnicode>,...)|StringInserts|
+	ELR_FIELD("Sid", ELR_SID), // @prop <o PySID>|Sid|
+	ELR_FIELD("Data", ELR_DATA), // @prop string|Data|
+	ELR_FIELD("ComputerName", ELR_COMPUTERNAME), // @prop <o PyUnicode>|ComputerName|
 	{NULL}
 };
 
-PyEventLogRecord::PyEventLogRecord(EVENTLOGRECORD *pEvt)
+PyEventLogRecord::PyEventLogRecord(PyEventLogBuffer *buffer, const PyWinEventLogRecordInfo *info)
 {
 	ob_type = &PyEventLogRecordType;
 	_Py_NewReference(this);
-	Reserved = RecordNumber = EventID = ClosingRecordNumber = 0;
-	TimeWritten = TimeGenerated = SourceName = ComputerName = StringInserts = Sids = Data = NULL;
-	EventType = EventCategory = ReservedFlags = 0;
-	if (pEvt==NULL) // Empty one.
-		return;
+	this->buffer = buffer;
+	buffer->AddRef();
+	this->info = *info;
+	for (int i = 0; i < ELR_NUM_FIELDS; i++)
+		fields[i] = NULL;
+}
 
-	Reserved = pEvt->Reserved;
-	RecordNumber = pEvt->RecordNumber;
-	EventID = pEvt->EventID;
-	EventType = pEvt->EventType;
-	EventCategory = pEvt->EventCategory;
-	ReservedFlags = pEvt->ReservedFlags;
-	ClosingRecordNumber = pEvt->ClosingRecordNumber;
+PyEventLogRecord::~PyEventLogRecord(void)
+{
+	for (int i = 0; i < ELR_NUM_FIELDS; i++)
+		Py_XDECREF(fields[i]);
+	buffer->Release();
+}
 
-	if (pEvt->NumStrings==0) {
-		StringInserts = Py_None;
-		Py_INCREF(Py_None);
-	} else {
-		StringInserts = PyTuple_New(pEvt->NumStrings);
-		if (StringInserts) {
-			WCHAR *stringOffset = (WCHAR *) (((BYTE *)pEvt) + pEvt->StringOffset);
-			for (DWORD stringNo = 0;stringNo<pEvt->NumStrings;stringNo++) {
-				PyTuple_SET_ITEM( StringInserts, (int)stringNo, PyWinObject_FromWCHAR(stringOffset));
-				stringOffset = stringOffset + (wcslen(stringOffset)) + 1;
+/*static*/ void PyEventLogRecord::deallocFunc(PyObject *ob)
+{
+	delete (PyEventLogRecord *)ob;
+}
+
+// Creates the object for a field (the types are as they have always been,
+// so eg EventID is signed).
+PyObject *PyEventLogRecord::MakeField(int field)
+{
+	const PyWinEventLogHeader *h = &info.header;
+	switch (field) {
+		case ELR_RESERVED:
+			return PyInt_FromLong((int)h->Reserved);
+		case ELR_RECORDNUMBER:
+			return PyInt_FromLong((int)h->RecordNumber);
+		case ELR_TIMEGENERATED:
+			return PyWinTimeObject_Fromtime_t((time_t)h->TimeGenerated);
+		case ELR_TIMEWRITTEN:
+			return PyWinTimeObject_Fromtime_t((time_t)h->TimeWritten);
+		case ELR_EVENTID:
+			return PyInt_FromLong((int)h->EventID);
+		case ELR_EVENTTYPE:
+			return PyInt_FromLong((short)h->EventType);
+		case ELR_EVENTCATEGORY:
+			return PyInt_FromLong((short)h->EventCategory);
+		case ELR_RESERVEDFLAGS:
+			return PyInt_FromLong((short)h->ReservedFlags);
+		case ELR_CLOSINGRECORDNUMBER:
+			return PyInt_FromLong((int)h->ClosingRecordNumber);
+		case ELR_SOURCENAME:
+			return PyWinObject_FromWCHAR((const WCHAR *)info.sourceName, (int)info.sourceNameLen);
+		case ELR_COMPUTERNAME:
+			return PyWinObject_FromWCHAR((const WCHAR *)info.computerName, (int)info.computerNameLen);
+		case ELR_STRINGINSERTS: {
+			if (h->NumStrings == 0) {
+				Py_INCREF(Py_None);
+				return Py_None;
 			}
+			PyObject *ret = PyTuple_New(h->NumStrings);
+			const WCHAR *str = (const WCHAR *)info.strings;
+			for (DWORD i = 0; i < h->NumStrings && ret != NULL; i++) {
+				// All checked to be terminated by the parser.
+				int len = (int)wcslen(str);
+				PyObject *item = PyWinObject_FromWCHAR(str, len);
+				if (item == NULL)
+					Py_CLEAR(ret);
+				else
+					PyTuple_SET_ITEM(ret, i, item);
+				str += len + 1;
+			}
+			return ret;
 		}
+		case ELR_SID:
+			if (info.sid == NULL) {
+				Py_INCREF(Py_None);
+				return Py_None;
+			}
+			return PyWinObject_FromSID((PSID)info.sid);
+		case ELR_DATA:
+			return PyString_FromStringAndSize((const char *)info.data, h->DataLength);
 	}
-
-	TimeGenerated = PyWinTimeObject_Fromtime_t((time_t)pEvt->TimeGenerated);
-	TimeWritten = PyWinTimeObject_Fromtime_t((time_t)pEvt->TimeWritten);
-
-	if (pEvt->UserSidLength==0) {
-		Sids = Py_None; // No SID in this record.
-		Py_INCREF(Sids);
-	} else {
-		Sids = PyWinObject_FromSID( (PSID)(((BYTE *)pEvt) + pEvt->UserSidOffset));
-	}
-
-	Data = PyString_FromStringAndSize(((char *)pEvt)+pEvt->DataOffset, pEvt->DataLength);
-
-	WCHAR *szSourceName = (WCHAR *)(((BYTE *)pEvt) + sizeof(EVENTLOGRECORD));
-	SourceName = PyWinObject_FromWCHAR(szSourceName);
-
-	ComputerName = PyWinObject_FromWCHAR(szSourceName + wcslen(szSourceName) + 1);
+	PyErr_SetString(PyExc_SystemError, "Unknown EventLogRecord field");
+	return NULL;
 }
 
-PyEventLogRecord::~PyEventLogRecord(void)
+/*static*/ PyObject *PyEventLogRecord::getField(PyObject *self, void *closure)
 {
-	Py_XDECREF(TimeWritten);
-	Py_XDECREF(TimeGenerated);
-	Py_XDECREF(SourceName);
-	Py_XDECREF(StringInserts);
-	Py_XDECREF(Sids);
-	Py_XDECREF(Data);
-	Py_XDECREF(ComputerName);
+	PyEventLogRecord *rec = (PyEventLogRecord *)self;
+	int field = (int)(Py_ssize_t)closure;
+	if (rec->fields[field] == NULL) {
+		rec->fields[field] = rec->MakeField(field);
+		if (rec->fields[field] == NULL)
+			return NULL;
+	}
+	Py_INCREF(rec->fields[field]);
+	return rec->fields[field];
 }
 
-/*static*/ void PyEventLogRecord::deallocFunc(PyObject *ob)
+/*static*/ int PyEventLogRecord::setField(PyObject *self, PyObject *v, void *closure)
 {
-	delete (PyEventLogRecord *)ob;
+	if (v == NULL) {
+		PyErr_SetString(PyExc_AttributeError, "EventLogRecord attributes can not be deleted");
+		return -1;
+	}
+	PyEventLogRecord *rec = (PyEventLogRecord *)self;
+	int field = (int)(Py_ssize_t)closure;
+	// Integer fields take what the T_INT and T_SHORT members they replace
+	// did - an integer, truncated (with a warning) to the C type.
+	BOOL isInt = field == ELR_RESERVED || field == ELR_RECORDNUMBER
+		|| field == ELR_EVENTID || field == ELR_CLOSINGRECORDNUMBER;
+	BOOL isShort = field == ELR_EVENTTYPE || field == ELR_EVENTCATEGORY
+		|| field == ELR_RESERVEDFLAGS;
+	if (isInt || isShort) {
+		long val = PyInt_AsLong(v);
+		if (val == -1 && PyErr_Occurred())
+			return -1;
+		long truncated = isShort ? (short)val : (int)val;
+		if (truncated != val && PyErr_WarnEx(PyExc_RuntimeWarning,
+				isShort ? "Truncation of value to short" : "Truncation of value to int", 1) < 0)
+			return -1;
+		v = PyInt_FromLong(truncated);
+		if (v == NULL)
+			return -1;
+	}
+	else
+		Py_INCREF(v);
+	Py_XDECREF(rec->fields[field]);
+	rec->fields[field] = v;
+	return 0;
 }
 
-PyObject *MakeEventLogObject( BYTE *buf, DWORD numBytes )
+// Appends a record object for every record in a buffer which passes the
+// filter (if any).
+static BOOL AppendEventLogRecords(PyObject *list, PyEventLogBuffer *buffer, BYTE *buf, DWORD numBytes, PyWinEventLogFilter *filter)
 {
-	PyObject *ret = PyList_New(0);
-	if (ret==NULL) return NULL;
-	while (numBytes>0) {
-		EVENTLOGRECORD *pEvt = (EVENTLOGRECORD *)buf;
-		PyObject *subItem = new PyEventLogRecord(pEvt);
+	DWORD offset = 0;
+	while (offset < numBytes) {
+		PyWinEventLogRecordInfo info;
+		size_t len = PyWinEventLog_ParseRecord(buf + offset, numBytes - offset, &info);
+		if (len == 0) {
+			PyErr_Format(PyExc_ValueError, "The data at offset %lu is not a valid EVENTLOGRECORD", offset);
+			return FALSE;
+		}
+		offset += (DWORD)len;
+		if (filter && !PyWinEventLog_Match(filter, &info))
+			continue;
+		PyObject *subItem = new PyEventLogRecord(buffer, &info);
 		if (subItem==NULL) {
-			Py_DECREF(ret);
 			PyErr_SetString(PyExc_MemoryError, "Allocating EventLogRecord object");
-			return NULL;
+			return FALSE;
 		}
-		PyList_Append(ret, subItem);
+		int rc = PyList_Append(list, subItem);
 		Py_DECREF(subItem);
-		buf = buf + pEvt->Length;
-		numBytes -= pEvt->Length;
+		if (rc != 0)
+			return FALSE;
 	}
-	return ret;
+	return TRUE;
 }
 
-PyObject *_MyReadEventLog(HANDLE hEventLog, DWORD dwReadFlags, DWORD dwRecordOffset, DWORD nNumberOfBytesToRead)
+PyObject *_MyReadEventLog(HANDLE hEventLog, DWORD dwReadFlags, DWORD dwRecordOffset, DWORD nNumberOfBytesToRead, PyWinEventLogFilter *filter)
 {
-	DWORD needed = nNumberOfBytesToRead, read;
-	BYTE *buf;
+	PyObject *ret = PyList_New(0);
+	if (ret==NULL) return NULL;
+	DWORD size = nNumberOfBytesToRead, needed, read;
 	BOOL ok;
 	while (1) {
-		buf = (BYTE *)malloc(needed);
+		PyEventLogBuffer *buf = GetReadBuffer(size);
 		if (buf==NULL) {
-			PyErr_SetString(PyExc_MemoryError, "Allocating initial buffer");
+			Py_DECREF(ret);
 			return NULL;
 		}
 		Py_BEGIN_ALLOW_THREADS
-		ok = ReadEventLogW(hEventLog, dwReadFlags, dwRecordOffset, buf, needed, &read, &needed);
+		ok = ReadEventLogW(hEventLog, dwReadFlags, dwRecordOffset, buf->data, size, &read, &needed);
 		Py_END_ALLOW_THREADS
 		if (!ok) {
 			DWORD err = GetLastError();
-			if (err==ERROR_HANDLE_EOF) {
-				read = 0;// pretend everything is OK...
-				break;
-			}
+			ReleaseReadBuffer(buf);
+			if (err==ERROR_HANDLE_EOF)
+				break; // pretend everything is OK...
 			else if (err==ERROR_INSUFFICIENT_BUFFER) {
-				free(buf);
+				size = needed;
 				continue; // try again.
 			} else {
-				free(buf);
+				Py_DECREF(ret);
 				return PyWin_SetAPIError("ReadEventLog");
 			}
 		}
-		else
+		// Convert the records.
+		ok = AppendEventLogRecords(ret, buf, buf->data, read, filter);
+		ReleaseReadBuffer(buf);
+		if (!ok) {
+			Py_DECREF(ret);
+			return NULL;
+		}
+		// If the filter dropped every record, read on - an empty list
+		// means the end of the log.  A seek read would only return the
+		// same records again.
+		if (filter==NULL || PyList_GET_SIZE(ret) > 0 || read==0 || (dwReadFlags & EVENTLOG_SEEK_READ))
 			break;
 	}
-	// Convert the object.
-	PyObject *ret = MakeEventLogObject(buf, read);
-	free(buf);
 	return ret;
 }
 
 #define EVTLOG_READ_BUF_LEN_MAX 0x7ffff
 #define EVTLOG_READ_BUF_LEN_DEFAULT 0x1000
 
-// @pyswig [object,...]|ReadEventLog|Reads some event log records.
+// @pyswig [<o PyEventLogRecord>,...]|ReadEventLog|Reads some event log records.
 // @rdesc If there are no event log records available, then an empty list is returned.
+// @comm The buffer records are read into is reused by later calls once no
+//	records from it are still alive, and each record only converts the
+//	fields which are used.
 PyObject *MyReadEventLog(PyObject *self, PyObject *args) {
     HANDLE hEventLog = INVALID_HANDLE_VALUE;
     DWORD dwReadFlags, dwRecordOffset, nNumberOfBytesToRead = EVTLOG_READ_BUF_LEN_DEFAULT;
-    if (!PyArg_ParseTuple(args, "O&kk|k:ReadEventLog",
+    PyObject *obFilter = Py_None;
+    PyWinEventLogFilter *filter;
+    if (!PyArg_ParseTuple(args, "O&kk|kO:ReadEventLog",
         PyWinObject_AsHANDLE, &hEventLog,  // @pyparm <o Py_HANDLE>|Handle||Handle to a an opened event log (see <om win32evtlog.OpenEventLog>)
         &dwReadFlags,                      // @pyparm int|Flags||Reading flags
         &dwRecordOffset,                   // @pyparm int|Offset||Record offset to read (in SEEK mode).
-        &nNumberOfBytesToRead))            // @pyparm int|Size|4096|Output buffer size.
+        &nNumberOfBytesToRead,             // @pyparm int|Size|4096|Output buffer size.
+        &obFilter))                        // @pyparm <o PyEventLogFilter>|Filter|None|Only records passing this filter are returned.
+                                           //	Unless reading in SEEK mode, more records are read until at least one passes.
+        return NULL;
+    if (!PyWinObject_AsEventLogFilter(obFilter, &filter))
         return NULL;
     if (nNumberOfBytesToRead == 0)
         nNumberOfBytesToRead = EVTLOG_READ_BUF_LEN_DEFAULT;
     if (nNumberOfBytesToRead > EVTLOG_READ_BUF_LEN_MAX)
         nNumberOfBytesToRead = EVTLOG_READ_BUF_LEN_MAX;
-    return _MyReadEventLog(hEventLog, dwReadFlags, dwRecordOffset, nNumberOfBytesToRead);
+    return _MyReadEventLog(hEventLog, dwReadFlags, dwRecordOffset, nNumberOfBytesToRead, filter);
+}
+
+// @pyswig [<o PyEventLogRecord>,...]|ParseEventLogRecords|Creates record objects from a buffer of EVENTLOGRECORD structures.
+// @comm The buffer is in the format ReadEventLog fills in.  Every record is
+//	checked before it is used, and ValueError is raised for invalid data.
+PyObject *MyParseEventLogRecords(PyObject *self, PyObject *args)
+{
+	PyObject *obData, *obFilter = Py_None;
+	void *data;
+	DWORD size;
+	PyWinEventLogFilter *filter;
+	if (!PyArg_ParseTuple(args, "O|O:ParseEventLogRecords",
+		&obData,		// @pyparm buffer|Data||The records.
+		&obFilter))		// @pyparm <o PyEventLogFilter>|Filter|None|Only records passing this filter are returned.
+		return NULL;
+	if (!PyWinObject_AsEventLogFilter(obFilter, &filter))
+		return NULL;
+	if (!PyWinObject_AsReadBuffer(obData, &data, &size))
+		return NULL;
+	// The records refer to a copy of the data.
+	PyEventLogBuffer *buf = new PyEventLogBuffer(size ? size : 1);
+	if (buf == NULL || buf->data == NULL) {
+		delete buf;
+		return PyErr_NoMemory();
+	}
+	memcpy(buf->data, data, size);
+	PyObject *ret = PyList_New(0);
+	if (ret != NULL && !AppendEventLogRecords(ret, buf, buf->data, size, filter))
+		Py_CLEAR(ret);
+	buf->Release();
+	return ret;
 }
 
 PyObject * MyReportEvent( HANDLE hEventLog,
@@ -475,6 +792,8 @@ RegisterEventSourceW (
     );
 
 %native (ReadEventLog) MyReadEventLog;
+%native (ParseEventLogRecords) MyParseEventLogRecords;
+%native (EventLogFilter) pfnPyEventLogFilter_New;
 
 // @pyswig |ReportEvent|Reports an event
 %name (ReportEvent) PyObject *MyReportEvent (
@@ -824,26 +1143,35 @@ static PyObject *PyEvtSeek(PyObject *self, PyObject *args, PyObject *kwargs)
 }
 PyCFunction pfnPyEvtSeek = (PyCFunction) PyEvtSeek;
 
-// @pyswig str|EvtRender|Formats an event into XML text
+static PyObject *PyWinObject_FromEVT_VARIANTValues(PEVT_VARIANT vals, DWORD count);
+
+// @pyswig object|EvtRender|Formats an event into XML text, or renders values from it
 // @comm Accepts keyword args
-// @comm Rendering event values (Flags=EvtRenderEventValues) is not currently supported
+// @rdesc Returns the XML text of the event or bookmark, or a tuple of the values
+//	selected by the Context when Flags is EvtRenderEventValues.
 static PyObject *PyEvtRender(PyObject *self, PyObject *args, PyObject *kwargs)
 {
-	static char *keywords[]={"Event", "Flags", NULL};
-	EVT_HANDLE event;
+	static char *keywords[]={"Event", "Flags", "Context", NULL};
+	EVT_HANDLE event, context=NULL;
 	void *buf=NULL;
 	DWORD flags, bufsize=2048, bufneeded, propcount;
 	PyObject *ret=NULL;
 	
-	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&k:EvtRender", keywords,
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&k|O&:EvtRender", keywords,
 		PyWinObject_AsHANDLE, &event,	// @pyparm <o PyEVT_HANDLE>|Event||Handle to an event or bookmark
-		&flags))	// @pyparm int|Flags||EvtRenderEventXml or EvtRenderBookmark indicating type of handle
+		&flags,		// @pyparm int|Flags||EvtRenderEventXml or EvtRenderBookmark indicating type of handle,
+					//	or EvtRenderEventValues to render the values selected by Context
+		PyWinObject_AsHANDLE, &context))	// @pyparm <o PyEVT_HANDLE>|Context|None|A render context created by
+					//	<om win32evtlog.EvtCreateRenderContext>, only used with EvtRenderEventValues
 		return NULL;
 	if (flags==EvtRenderEventValues){
-		// Requires yet another type of VARIANT
-		PyErr_Format(PyExc_NotImplementedError,"Rendering values is not yet supported");
-		return NULL;
+		if (context==NULL){
+			PyErr_SetString(PyExc_ValueError, "A Context is required to render values");
+			return NULL;
+			}
 		}
+	else
+		context=NULL;
 	BOOL bsuccess;
 	while(1){
 		if (buf)
@@ -855,10 +1183,13 @@ static PyObject *PyEvtRender(PyObject *self, PyObject *args, PyObject *kwargs)
 			}
 
 		Py_BEGIN_ALLOW_THREADS
-		bsuccess = EvtRender(NULL, event, flags, bufsize, buf, &bufneeded, &propcount);
+		bsuccess = EvtRender(context, event, flags, bufsize, buf, &bufneeded, &propcount);
 		Py_END_ALLOW_THREADS
 		if (bsuccess){
-			ret=PyWinObject_FromWCHAR((WCHAR *)buf);
+			if (flags==EvtRenderEventValues)
+				ret=PyWinObject_FromEVT_VARIANTValues((PEVT_VARIANT)buf, propcount);
+			else
+				ret=PyWinObject_FromWCHAR((WCHAR *)buf);
 			break;
 			}
 		DWORD err=GetLastError();
@@ -874,6 +1205,34 @@ static PyObject *PyEvtRender(PyObject *self, PyObject *args, PyObject *kwargs)
 }
 PyCFunction pfnPyEvtRender = (PyCFunction) PyEvtRender;
 
+// @pyswig <o PyEVT_HANDLE>|EvtCreateRenderContext|Creates a context that selects the values
+//	<om win32evtlog.EvtRender> and <om win32evtlog.EvtBatchReader> render from events
+// @comm Accepts keyword args
+static PyObject *PyEvtCreateRenderContext(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *keywords[]={"ValuePaths", "Flags", NULL};
+	PyObject *obpaths=Py_None;
+	DWORD flags=EvtRenderContextValues, count=0;
+	LPWSTR *paths=NULL;
+	EVT_HANDLE ret;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|Ok:EvtCreateRenderContext", keywords,
+		&obpaths,	// @pyparm [str,...]|ValuePaths|None|XPath expressions selecting the values to render,
+					//	eg "Event/System/EventID".  Only used with EvtRenderContextValues.
+		&flags))	// @pyparm int|Flags|EvtRenderContextValues|EvtRenderContextValues, EvtRenderContextSystem
+					//	or EvtRenderContextUser
+		return NULL;
+	if (!PyWinObject_AsWCHARArray(obpaths, &paths, &count, TRUE))
+		return NULL;
+	Py_BEGIN_ALLOW_THREADS
+	ret = EvtCreateRenderContext(count, (LPCWSTR *)paths, flags);
+	Py_END_ALLOW_THREADS
+	PyWinObject_FreeWCHARArray(paths, count);
+	if (ret == NULL)
+		return PyWin_SetAPIError("EvtCreateRenderContext");
+	return PyWinObject_FromEVT_HANDLE(ret);
+}
+PyCFunction pfnPyEvtCreateRenderContext = (PyCFunction) PyEvtCreateRenderContext;
+
 
 DWORD CALLBACK PyEvtSubscribe_callback(
 	EVT_SUBSCRIBE_NOTIFY_ACTION action,
@@ -922,6 +1281,8 @@ DWORD CALLBACK PyEvtSubscribe_callback(
 //	If an event handle is passed in, a pull subscription is created.  The event handle will be
 //	signalled when events are available, and the subscription handle can be
 //	passed to <om win32evtlog.EvtNext> to obtain the events.
+// @comm The callback is called with the GIL held for every event.  Where events may
+//	arrive quickly, <om win32evtlog.EvtSubscribeQueue> queues them without entering Python.
 
 static PyObject *PyEvtSubscribe(PyObject *self, PyObject *args, PyObject *kwargs)
 {
@@ -1010,11 +1371,96 @@ static PyObject *PyEvtUpdateBookmark(PyObject *self, PyObject *args, PyObject *k
 }
 PyCFunction pfnPyEvtUpdateBookmark = (PyCFunction) PyEvtUpdateBookmark;
 
-PyObject *PyWinObject_FromEVT_VARIANT(PEVT_VARIANT val)
+// Gets item i of an EVT_VARIANT array as a variant of its own.
+static BOOL GetEVT_VARIANTItem(PEVT_VARIANT val, DWORD i, PEVT_VARIANT item)
+{
+	memset(item, 0, sizeof(*item));
+	item->Type = val->Type & EVT_VARIANT_TYPE_MASK;
+	switch (item->Type){
+		case EvtVarTypeString:
+			item->StringVal = val->StringArr[i];
+			break;
+		case EvtVarTypeAnsiString:
+			item->AnsiStringVal = val->AnsiStringArr[i];
+			break;
+		case EvtVarTypeSByte:
+			item->SByteVal = val->SByteArr[i];
+			break;
+		case EvtVarTypeByte:
+			item->ByteVal = val->ByteArr[i];
+			break;
+		case EvtVarTypeInt16:
+			item->Int16Val = val->Int16Arr[i];
+			break;
+		case EvtVarTypeUInt16:
+			item->UInt16Val = val->UInt16Arr[i];
+			break;
+		case EvtVarTypeInt32:
+			item->Int32Val = val->Int32Arr[i];
+			break;
+		case EvtVarTypeUInt32:
+		case EvtVarTypeHexInt32:
+			item->UInt32Val = val->UInt32Arr[i];
+			break;
+		case EvtVarTypeInt64:
+			item->Int64Val = val->Int64Arr[i];
+			break;
+		case EvtVarTypeUInt64:
+		case EvtVarTypeHexInt64:
+			item->UInt64Val = val->UInt64Arr[i];
+			break;
+		case EvtVarTypeSingle:
+			item->SingleVal = val->SingleArr[i];
+			break;
+		case EvtVarTypeDouble:
+			item->DoubleVal = val->DoubleArr[i];
+			break;
+		case EvtVarTypeBoolean:
+			item->BooleanVal = val->BooleanArr[i];
+			break;
+		case EvtVarTypeGuid:
+			item->GuidVal = val->GuidArr + i;
+			break;
+		case EvtVarTypeSizeT:
+			item->SizeTVal = val->SizeTArr[i];
+			break;
+		case EvtVarTypeFileTime:
+			item->FileTimeVal = ((ULONGLONG)val->FileTimeArr[i].dwHighDateTime << 32) | val->FileTimeArr[i].dwLowDateTime;
+			break;
+		case EvtVarTypeSysTime:
+			item->SysTimeVal = val->SysTimeArr + i;
+			break;
+		case EvtVarTypeSid:
+			item->SidVal = val->SidArr[i];
+			break;
+		case EvtVarTypeEvtXml:
+			item->XmlVal = val->XmlValArr[i];
+			break;
+		default:
+			PyErr_Format(PyExc_NotImplementedError, "EVT_VARIANT arrays of type %d not supported yet", item->Type);
+			return FALSE;
+		}
+	return TRUE;
+}
+
+// Returns the value of an EVT_VARIANT, without its type.  Arrays are
+// returned as tuples.
+static PyObject *PyWinObject_FromEVT_VARIANTValue(PEVT_VARIANT val)
 {
 	if (val->Type & EVT_VARIANT_TYPE_ARRAY){
-		PyErr_SetString(PyExc_NotImplementedError, "EVT_VARIANT arrays not supported yet");
-		return NULL;
+		PyObject *ret = PyTuple_New(val->Count);
+		for (DWORD i = 0; ret && i < val->Count; i++){
+			EVT_VARIANT item;
+			PyObject *obitem = NULL;
+			if (GetEVT_VARIANTItem(val, i, &item))
+				obitem = PyWinObject_FromEVT_VARIANTValue(&item);
+			if (obitem == NULL){
+				Py_DECREF(ret);
+				return NULL;
+				}
+			PyTuple_SET_ITEM(ret, i, obitem);
+			}
+		return ret;
 		}
 	DWORD val_type = val->Type & EVT_VARIANT_TYPE_MASK;
 	PyObject *obval = NULL;
@@ -1045,12 +1491,14 @@ PyObject *PyWinObject_FromEVT_VARIANT(PEVT_VARIANT val)
 			obval = PyLong_FromLong(val->Int32Val);
 			break;
 		case EvtVarTypeUInt32:
+		case EvtVarTypeHexInt32:
 			obval = PyLong_FromUnsignedLong(val->UInt32Val);
 			break;
 		case EvtVarTypeInt64:
 			obval = PyLong_FromLongLong(val->Int64Val);
 			break;
 		case EvtVarTypeUInt64:
+		case EvtVarTypeHexInt64:
 			obval = PyLong_FromUnsignedLongLong(val->UInt64Val);
 			break;
 		case EvtVarTypeSingle:
@@ -1085,8 +1533,6 @@ PyObject *PyWinObject_FromEVT_VARIANT(PEVT_VARIANT val)
 		case EvtVarTypeSid:
 			obval = PyWinObject_FromSID(val->SidVal);
 			break;
-		// case EvtVarTypeHexInt32:
-		// case EvtVarTypeHexInt64:
 		case EvtVarTypeEvtHandle:
 			obval = PyWinObject_FromEVT_HANDLE(val->EvtHandleVal);
 			break;
@@ -1096,34 +1542,1105 @@ PyObject *PyWinObject_FromEVT_VARIANT(PEVT_VARIANT val)
 		default:
 			PyErr_Format(PyExc_NotImplementedError, "EVT_VARIANT_TYPE %d not supported yet", val_type);
 		}
+	return obval;
+}
+
+PyObject *PyWinObject_FromEVT_VARIANT(PEVT_VARIANT val)
+{
+	PyObject *obval = PyWinObject_FromEVT_VARIANTValue(val);
 	if (obval == NULL)
 		return NULL;
 	return Py_BuildValue("Nk", obval, val->Type);
 }
 
-// @pyswig (object, int)|EvtGetChannelConfigProperty|Retreives channel configuration information
-// @comm Accepts keyword args
-// @comm Returns the value and type of value (EvtVarType*)
-static PyObject *PyEvtGetChannelConfigProperty(PyObject *self, PyObject *args, PyObject *kwargs)
+// Returns a tuple of the values rendered from an event.
+static PyObject *PyWinObject_FromEVT_VARIANTValues(PEVT_VARIANT vals, DWORD count)
 {
-	static char *keywords[]={"ChannelConfig", "PropertyId", "Flags", NULL};
-	EVT_HANDLE config_handle;
-	EVT_CHANNEL_CONFIG_PROPERTY_ID prop_id;
-	DWORD flags = 0;
-	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&i|k:EvtGetChannelConfigProperty", keywords,
-		PyWinObject_AsHANDLE, &config_handle,	// @pyparm <o PyEVT_HANDLE>|ChannelConfig||Config handle as returned by <om win32evtlog.EvtOpenChannelConfig>
-		&prop_id,	// @pyparm int|PropertyId||Property to retreive, one of EvtChannel* constants
-		&flags))	// @pyparm int|Flags|0|Reserved, use only 0
+	PyObject *ret = PyTuple_New(count);
+	for (DWORD i = 0; ret && i < count; i++){
+		PyObject *obval = PyWinObject_FromEVT_VARIANTValue(vals + i);
+		if (obval == NULL){
+			Py_DECREF(ret);
+			return NULL;
+			}
+		PyTuple_SET_ITEM(ret, i, obval);
+		}
+	return ret;
+}
+
+// A batch of events rendered by a PyEvtBatchReader's thread, or by the
+// callback of an EvtSubscribeQueue subscription.  The values of each event
+// are rendered straight into buf, and contain pointers into it, so the
+// buffer is never moved once an event is in it.
+struct PyEvtBatch
+{
+	BYTE *buf;
+	DWORD bufSize;
+	DWORD used;
+	DWORD *offsets;		// where the values of each event start in buf
+	DWORD count;
+	DWORD maxEvents;
+	DWORD propCount;	// the number of values rendered for each event
+	EVT_HANDLE last;	// the last event, kept open to move the bookmark to
+	PyEvtBatch *next;
+};
+
+static PyEvtBatch *NewEvtBatch(DWORD bufSize, DWORD maxEvents)
+{
+	PyEvtBatch *batch = (PyEvtBatch *)malloc(sizeof(PyEvtBatch));
+	if (batch == NULL)
+		return NULL;
+	memset(batch, 0, sizeof(PyEvtBatch));
+	batch->buf = (BYTE *)malloc(bufSize);
+	batch->offsets = (DWORD *)malloc(maxEvents * sizeof(DWORD));
+	if (batch->buf == NULL || batch->offsets == NULL){
+		free(batch->buf);
+		free(batch->offsets);
+		free(batch);
 		return NULL;
+		}
+	batch->bufSize = bufSize;
+	batch->maxEvents = maxEvents;
+	return batch;
+}
 
-	PEVT_VARIANT val = NULL;
-	DWORD buf_size=0, buf_needed, err;
-	Py_BEGIN_ALLOW_THREADS
-	EvtGetChannelConfigProperty(config_handle, prop_id, flags, buf_size, val, &buf_needed);
-	Py_END_ALLOW_THREADS
-	err = GetLastError();
-	if (err != ERROR_INSUFFICIENT_BUFFER)
-		return PyWin_SetAPIError("EvtGetChannelConfigProperty", err);
+// Renders an event onto the end of a batch, as values selected by context
+// (flags is EvtRenderEventValues) or as XML (flags is EvtRenderEventXml).
+// Returns FALSE if it could not be rendered (*perr is set), or the batch is
+// full (*perr is 0).
+static BOOL RenderEvtBatch(PyEvtBatch *batch, EVT_HANDLE context, DWORD flags, EVT_HANDLE event, DWORD *perr)
+{
+	if (batch->count == batch->maxEvents){
+		*perr = 0;
+		return FALSE;
+		}
+	for (;;){
+		DWORD offset = batch->used, needed = 0, propCount = 0;
+		if (EvtRender(context, event, flags, batch->bufSize - offset,
+			batch->buf + offset, &needed, &propCount)){
+			// A failed attempt may have set it before the buffer was replaced.
+			*perr = 0;
+			batch->offsets[batch->count++] = offset;
+			batch->propCount = propCount;
+			// Keep the next event's values aligned.
+			batch->used = (offset + needed + 7) & ~7;
+			if (batch->used > batch->bufSize)
+				batch->used = batch->bufSize;
+			return TRUE;
+			}
+		*perr = GetLastError();
+		if (*perr != ERROR_INSUFFICIENT_BUFFER)
+			return FALSE;
+		if (batch->count){
+			*perr = 0;
+			return FALSE;
+			}
+		// A single event too big for the buffer - nothing points into it yet,
+		// so it can be replaced by a bigger one.
+		BYTE *buf = (BYTE *)malloc(needed);
+		if (buf == NULL){
+			*perr = ERROR_OUTOFMEMORY;
+			return FALSE;
+			}
+		free(batch->buf);
+		batch->buf = buf;
+		batch->bufSize = needed;
+		}
+}
+
+// Empties a batch so it can be filled again.
+static void ResetEvtBatch(PyEvtBatch *batch)
+{
+	if (batch->last)
+		EvtClose(batch->last);
+	batch->last = NULL;
+	batch->used = batch->count = batch->propCount = 0;
+}
+
+static void FreeEvtBatches(PyEvtBatch *batch)
+{
+	while (batch){
+		PyEvtBatch *next = batch->next;
+		ResetEvtBatch(batch);
+		free(batch->buf);
+		free(batch->offsets);
+		free(batch);
+		batch = next;
+		}
+}
+
+// @object PyEvtBatchReader|Reads the values of events from a query in batches,
+//	created by <om win32evtlog.EvtBatchReader>
+// @comm A native thread calls <om win32evtlog.EvtNext> for up to BatchSize events
+//	at a time, and renders the values selected by the render context from each
+//	of them into a reusable buffer, while Python is busy with earlier batches.
+//	Python objects are only created for the values once a batch is returned.
+// @comm The reader can be iterated, giving a tuple of values for each event.
+//	Values which are not present in an event are None.
+class PyEvtBatchReader : public PyObject
+{
+public:
+	PyEvtBatchReader(void);
+	~PyEvtBatchReader();
+	BOOL Init(DWORD batchSize, DWORD timeout, DWORD prefetch, DWORD bufferSize);
+	void Close(void);
+	PyObject *NextRows(DWORD timeout);
+
+	/* Python support */
+	static void deallocFunc(PyObject *ob);
+	static PyObject *iternextFunc(PyObject *self);
+	static PyObject *Next(PyObject *self, PyObject *args, PyObject *kwargs);
+	static PyObject *PyClose(PyObject *self, PyObject *args);
+	static PyObject *get_finished(PyObject *self, void *unused);
+	static struct PyMethodDef methods[];
+	static struct PyGetSetDef getset[];
+	static PyTypeObject type;
+
+	// The handles used are owned by these objects.
+	PyObject *m_obquery, *m_obcontext, *m_obbookmark;
+	EVT_HANDLE m_query, m_context, m_bookmark;
+
+protected:
+	static unsigned __stdcall ThreadProc(void *param);
+	void Run(void);
+	PyObject *TakeBatch(PyEvtBatch *batch);
+
+	DWORD m_batchSize;
+	DWORD m_timeout;
+	HANDLE m_thread;
+	HANDLE m_ready;				// manual reset, set while a batch is queued or the thread has stopped
+	HANDLE m_space;				// manual reset, set while a batch is free to fill or the reader is closing
+	CRITICAL_SECTION m_cs;		// guards everything below
+	BOOL m_csInitialized;
+	BOOL m_closing;
+	BOOL m_stopped;				// the thread has rendered everything it will
+	DWORD m_error;				// why the thread stopped, if not at the end of the results
+	const char *m_errorFunc;
+	PyEvtBatch *m_free;
+	PyEvtBatch *m_queued;
+	PyEvtBatch **m_queuedTail;
+	// Only used with the GIL held - the rest of the batch being iterated.
+	PyObject *m_rows;
+	Py_ssize_t m_row;
+};
+
+// @pyswig <o PyEvtBatchReader>|EvtBatchReader|Reads the values of events from a query in batches,
+//	on a native thread
+// @comm Accepts keyword args
+// @comm The handles passed in must not be closed while the reader is in use.
+static PyObject *PyEvtBatchReader_New(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *keywords[]={"ResultSet", "Context", "Bookmark", "BatchSize", "Timeout",
+		"Prefetch", "BufferSize", NULL};
+	PyObject *obquery, *obcontext, *obbookmark=Py_None;
+	EVT_HANDLE query, context, bookmark=NULL;
+	DWORD batchSize=256, timeout=INFINITE, prefetch=2, bufferSize=0x40000;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|Okkkk:EvtBatchReader", keywords,
+		&obquery,		// @pyparm <o PyEVT_HANDLE>|ResultSet||Handle to a query, as returned by <om win32evtlog.EvtQuery>
+		&obcontext,		// @pyparm <o PyEVT_HANDLE>|Context||A render context selecting the values to return,
+						//	as returned by <om win32evtlog.EvtCreateRenderContext>
+		&obbookmark,	// @pyparm <o PyEVT_HANDLE>|Bookmark|None|A bookmark which is moved to the last event of
+						//	each batch as the batch is returned
+		&batchSize,		// @pyparm int|BatchSize|256|Maximum number of events requested from <om win32evtlog.EvtNext> at once
+		&timeout,		// @pyparm int|Timeout|-1|Passed to <om win32evtlog.EvtNext>, -1 for infinite
+		&prefetch,		// @pyparm int|Prefetch|2|Number of batches the thread may render ahead of Python
+		&bufferSize))	// @pyparm int|BufferSize|262144|Size of the buffer each batch is rendered into.  A batch
+						//	holds fewer than BatchSize events if their values don't fit.
+		return NULL;
+	if (!PyWinObject_AsHANDLE(obquery, &query) ||
+		!PyWinObject_AsHANDLE(obcontext, &context) ||
+		!PyWinObject_AsHANDLE(obbookmark, &bookmark))
+		return NULL;
+	if (context == NULL){
+		PyErr_SetString(PyExc_ValueError, "A Context is required to render values");
+		return NULL;
+		}
+	if (batchSize == 0 || prefetch == 0){
+		PyErr_SetString(PyExc_ValueError, "BatchSize and Prefetch must be greater than 0");
+		return NULL;
+		}
+	PyEvtBatchReader *ret = new PyEvtBatchReader();
+	if (ret == NULL)
+		return PyErr_NoMemory();
+	ret->m_obquery = obquery;
+	ret->m_obcontext = obcontext;
+	ret->m_obbookmark = obbookmark;
+	Py_INCREF(obquery);
+	Py_INCREF(obcontext);
+	Py_INCREF(obbookmark);
+	ret->m_query = query;
+	ret->m_context = context;
+	ret->m_bookmark = bookmark;
+	if (!ret->Init(batchSize, timeout, prefetch, bufferSize)){
+		Py_DECREF(ret);
+		return NULL;
+		}
+	return ret;
+}
+PyCFunction pfnPyEvtBatchReader_New = (PyCFunction) PyEvtBatchReader_New;
+
+PyEvtBatchReader::PyEvtBatchReader(void)
+{
+	ob_type = &type;
+	_Py_NewReference(this);
+	m_obquery = m_obcontext = m_obbookmark = NULL;
+	m_query = m_context = m_bookmark = NULL;
+	m_batchSize = m_timeout = 0;
+	m_thread = m_ready = m_space = NULL;
+	m_csInitialized = FALSE;
+	m_closing = m_stopped = FALSE;
+	m_error = 0;
+	m_errorFunc = NULL;
+	m_free = m_queued = NULL;
+	m_queuedTail = &m_queued;
+	m_rows = NULL;
+	m_row = 0;
+}
+
+PyEvtBatchReader::~PyEvtBatchReader()
+{
+	Close();
+	FreeEvtBatches(m_free);
+	FreeEvtBatches(m_queued);
+	if (m_ready)
+		CloseHandle(m_ready);
+	if (m_space)
+		CloseHandle(m_space);
+	if (m_csInitialized)
+		DeleteCriticalSection(&m_cs);
+	Py_XDECREF(m_rows);
+	Py_XDECREF(m_obquery);
+	Py_XDECREF(m_obcontext);
+	Py_XDECREF(m_obbookmark);
+}
+
+BOOL PyEvtBatchReader::Init(DWORD batchSize, DWORD timeout, DWORD prefetch, DWORD bufferSize)
+{
+	InitializeCriticalSection(&m_cs);
+	m_csInitialized = TRUE;
+	m_batchSize = batchSize;
+	m_timeout = timeout;
+	for (DWORD i = 0; i < prefetch; i++){
+		PyEvtBatch *batch = NewEvtBatch(bufferSize, batchSize);
+		if (batch == NULL){
+			PyErr_NoMemory();
+			return FALSE;
+			}
+		batch->next = m_free;
+		m_free = batch;
+		}
+	m_ready = CreateEvent(NULL, TRUE, FALSE, NULL);
+	m_space = CreateEvent(NULL, TRUE, TRUE, NULL);
+	if (m_ready == NULL || m_space == NULL){
+		PyWin_SetAPIError("CreateEvent");
+		return FALSE;
+		}
+	m_thread = (HANDLE)_beginthreadex(NULL, 0, ThreadProc, this, 0, NULL);
+	if (m_thread == NULL){
+		PyErr_SetFromErrno(PyExc_RuntimeError);
+		return FALSE;
+		}
+	return TRUE;
+}
+
+// Stops the thread, once any EvtNext call it is making returns.
+void PyEvtBatchReader::Close(void)
+{
+	if (!m_csInitialized)
+		return;
+	// Only the first caller gets the thread, and waits for it.
+	EnterCriticalSection(&m_cs);
+	HANDLE thread = m_thread;
+	m_thread = NULL;
+	if (thread == NULL){
+		LeaveCriticalSection(&m_cs);
+		return;
+		}
+	m_closing = TRUE;
+	SetEvent(m_space);
+	LeaveCriticalSection(&m_cs);
+	Py_BEGIN_ALLOW_THREADS
+	WaitForSingleObject(thread, INFINITE);
+	Py_END_ALLOW_THREADS
+	CloseHandle(thread);
+	SetEvent(m_ready);	// wake anyone still waiting for a batch
+}
+
+unsigned __stdcall PyEvtBatchReader::ThreadProc(void *param)
+{
+	((PyEvtBatchReader *)param)->Run();
+	return 0;
+}
+
+void PyEvtBatchReader::Run(void)
+{
+	EVT_HANDLE *events = (EVT_HANDLE *)malloc(m_batchSize * sizeof(EVT_HANDLE));
+	DWORD numEvents = 0, pos = 0, err = 0;
+	const char *errorFunc = NULL;
+	if (events == NULL){
+		err = ERROR_OUTOFMEMORY;
+		errorFunc = "EvtBatchReader";
+		}
+	while (err == 0){
+		EnterCriticalSection(&m_cs);
+		while (!m_closing && m_free == NULL){
+			ResetEvent(m_space);
+			LeaveCriticalSection(&m_cs);
+			WaitForSingleObject(m_space, INFINITE);
+			EnterCriticalSection(&m_cs);
+			}
+		PyEvtBatch *batch = m_closing ? NULL : m_free;
+		if (batch)
+			m_free = batch->next;
+		LeaveCriticalSection(&m_cs);
+		if (batch == NULL)
+			break;
+
+		// A batch never spans two calls to EvtNext, so is handed over as
+		// soon as the events from one call have been rendered.
+		if (pos == numEvents){
+			pos = numEvents = 0;
+			if (!EvtNext(m_query, m_batchSize, events, m_timeout, 0, &numEvents)){
+				err = GetLastError();
+				errorFunc = "EvtNext";
+				numEvents = 0;
+				}
+			}
+		while (pos < numEvents){
+			if (!RenderEvtBatch(batch, m_context, EvtRenderEventValues, events[pos], &err)){
+				if (err)
+					errorFunc = "EvtRender";
+				break;
+				}
+			if (batch->last)
+				EvtClose(batch->last);
+			batch->last = events[pos++];
+			}
+
+		EnterCriticalSection(&m_cs);
+		if (batch->count){
+			batch->next = NULL;
+			*m_queuedTail = batch;
+			m_queuedTail = &batch->next;
+			SetEvent(m_ready);
+			}
+		else{
+			batch->next = m_free;
+			m_free = batch;
+			}
+		LeaveCriticalSection(&m_cs);
+		}
+
+	while (pos < numEvents)
+		EvtClose(events[pos++]);
+	free(events);
+	EnterCriticalSection(&m_cs);
+	m_stopped = TRUE;
+	if (err != ERROR_NO_MORE_ITEMS){
+		m_error = err;
+		m_errorFunc = errorFunc;
+		}
+	SetEvent(m_ready);
+	LeaveCriticalSection(&m_cs);
+}
+
+// Converts a batch to a list of rows, moves the bookmark past it, and gives
+// it back to the thread to fill again.
+PyObject *PyEvtBatchReader::TakeBatch(PyEvtBatch *batch)
+{
+	PyObject *ret = PyList_New(batch->count);
+	for (DWORD i = 0; ret && i < batch->count; i++){
+		PyObject *row = PyWinObject_FromEVT_VARIANTValues((PEVT_VARIANT)(batch->buf + batch->offsets[i]),
+			batch->propCount);
+		if (row == NULL){
+			Py_DECREF(ret);
+			ret = NULL;
+			break;
+			}
+		PyList_SET_ITEM(ret, i, row);
+		}
+	// The GIL is kept, so threads sharing the reader move the bookmark in order.
+	if (ret && m_bookmark && !EvtUpdateBookmark(m_bookmark, batch->last)){
+		PyWin_SetAPIError("EvtUpdateBookmark");
+		Py_DECREF(ret);
+		ret = NULL;
+		}
+	EnterCriticalSection(&m_cs);
+	ResetEvtBatch(batch);
+	batch->next = m_free;
+	m_free = batch;
+	SetEvent(m_space);
+	LeaveCriticalSection(&m_cs);
+	return ret;
+}
+
+// Waits for the next batch.  Returns a list of rows, an empty list once all
+// the events have been returned, or None if the timeout expired first.
+PyObject *PyEvtBatchReader::NextRows(DWORD timeout)
+{
+	// Finish the batch being iterated first.
+	if (m_rows){
+		PyObject *ret = PyList_GetSlice(m_rows, m_row, PyList_GET_SIZE(m_rows));
+		Py_CLEAR(m_rows);
+		if (ret == NULL || PyList_GET_SIZE(ret))
+			return ret;
+		Py_DECREF(ret);
+		}
+	DWORD start = GetTickCount();
+	for (;;){
+		EnterCriticalSection(&m_cs);
+		PyEvtBatch *batch = m_closing ? NULL : m_queued;
+		if (batch){
+			m_queued = batch->next;
+			if (m_queued == NULL)
+				m_queuedTail = &m_queued;
+			}
+		BOOL stopped = m_stopped && m_queued == NULL;
+		DWORD err = m_error;
+		const char *errorFunc = m_errorFunc;
+		// The thread sets the event (with the lock held) as it queues a batch.
+		if (m_queued == NULL && !m_stopped)
+			ResetEvent(m_ready);
+		BOOL closing = m_closing;
+		LeaveCriticalSection(&m_cs);
+		if (closing){
+			PyErr_SetString(PyExc_ValueError, "The EvtBatchReader has been closed");
+			return NULL;
+			}
+		if (batch)
+			return TakeBatch(batch);
+		if (stopped){
+			if (err)
+				return PyWin_SetAPIError((char *)errorFunc, err);
+			return PyList_New(0);
+			}
+		DWORD wait = timeout;
+		if (timeout != INFINITE){
+			DWORD elapsed = GetTickCount() - start;
+			if (elapsed >= timeout){
+				Py_INCREF(Py_None);
+				return Py_None;
+				}
+			wait = timeout - elapsed;
+			}
+		DWORD rc;
+		Py_BEGIN_ALLOW_THREADS
+		rc = WaitForSingleObject(m_ready, wait);
+		Py_END_ALLOW_THREADS
+		if (rc == WAIT_FAILED)
+			return PyWin_SetAPIError("WaitForSingleObject");
+		}
+}
+
+// @pymethod [(object,...),...]|PyEvtBatchReader|Next|Waits for the next batch of events
+// @rdesc Returns a list with a tuple of values for each event, an empty list once
+//	all the events have been returned, or None if the timeout expired first.
+//	If the reader is being iterated, the rest of the current batch is returned.
+// @comm Accepts keyword args
+PyObject *PyEvtBatchReader::Next(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *keywords[]={"Timeout", NULL};
+	DWORD timeout = INFINITE;
+	// @pyparm int|Timeout|-1|Milliseconds to wait for a batch, -1 for infinite
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|k:Next", keywords, &timeout))
+		return NULL;
+	return ((PyEvtBatchReader *)self)->NextRows(timeout);
+}
+
+PyObject *PyEvtBatchReader::iternextFunc(PyObject *self)
+{
+	PyEvtBatchReader *reader = (PyEvtBatchReader *)self;
+	while (reader->m_rows == NULL || reader->m_row >= PyList_GET_SIZE(reader->m_rows)){
+		PyObject *rows = reader->NextRows(INFINITE);
+		if (rows == NULL)
+			return NULL;
+		if (PyList_GET_SIZE(rows) == 0){
+			Py_DECREF(rows);
+			return NULL;	// StopIteration
+			}
+		reader->m_rows = rows;
+		reader->m_row = 0;
+		}
+	PyObject *ret = PyList_GET_ITEM(reader->m_rows, reader->m_row++);
+	Py_INCREF(ret);
+	return ret;
+}
+
+// @pymethod |PyEvtBatchReader|Close|Stops reading events
+// @comm This is done automatically when the object is destroyed.  Events already
+//	rendered but not returned are discarded, and the bookmark is not moved past them.
+PyObject *PyEvtBatchReader::PyClose(PyObject *self, PyObject *args)
+{
+	if (!PyArg_ParseTuple(args, ":Close"))
+		return NULL;
+	((PyEvtBatchReader *)self)->Close();
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+PyObject *PyEvtBatchReader::get_finished(PyObject *self, void *unused)
+{
+	PyEvtBatchReader *reader = (PyEvtBatchReader *)self;
+	EnterCriticalSection(&reader->m_cs);
+	BOOL finished = reader->m_stopped && reader->m_queued == NULL;
+	LeaveCriticalSection(&reader->m_cs);
+	if (reader->m_rows && reader->m_row < PyList_GET_SIZE(reader->m_rows))
+		finished = FALSE;
+	return PyBool_FromLong(finished);
+}
+
+/*static*/ void PyEvtBatchReader::deallocFunc(PyObject *ob)
+{
+	delete (PyEvtBatchReader *)ob;
+}
+
+/*static*/ struct PyMethodDef PyEvtBatchReader::methods[] = {
+	{"Next", (PyCFunction)PyEvtBatchReader::Next, METH_VARARGS | METH_KEYWORDS},	// @pymeth Next|Waits for the next batch of events
+	{"Close", PyEvtBatchReader::PyClose, METH_VARARGS},	// @pymeth Close|Stops reading events
+	{NULL}
+};
+
+/*static*/ struct PyGetSetDef PyEvtBatchReader::getset[] = {
+	// @prop bool|Finished|True once every event has been returned, or reading failed
+	{"Finished", PyEvtBatchReader::get_finished, NULL, "True once every event has been returned"},
+	{NULL}
+};
+
+PyTypeObject PyEvtBatchReader::type =
+{
+	PYWIN_OBJECT_HEAD
+	"PyEvtBatchReader",
+	sizeof(PyEvtBatchReader),
+	0,
+	PyEvtBatchReader::deallocFunc,	/* tp_dealloc */
+	0,						/* tp_print */
+	0,						/* tp_getattr */
+	0,						/* tp_setattr */
+	0,						/* tp_compare */
+	0,						/* tp_repr */
+	0,						/* tp_as_number */
+	0,						/* tp_as_sequence */
+	0,						/* tp_as_mapping */
+	0,						/* tp_hash */
+	0,						/* tp_call */
+	0,						/* tp_str */
+	PyObject_GenericGetAttr,	/* tp_getattro */
+	0,						/* tp_setattro */
+	0,						/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,		/* tp_flags */
+	"Reads the values of events from a query in batches",	/* tp_doc */
+	0,						/* tp_traverse */
+	0,						/* tp_clear */
+	0,						/* tp_richcompare */
+	0,						/* tp_weaklistoffset */
+	PyObject_SelfIter,		/* tp_iter */
+	PyEvtBatchReader::iternextFunc,	/* tp_iternext */
+	PyEvtBatchReader::methods,	/* tp_methods */
+	0,						/* tp_members */
+	PyEvtBatchReader::getset,	/* tp_getset */
+	0,						/* tp_base */
+	0,						/* tp_dict */
+	0,						/* tp_descr_get */
+	0,						/* tp_descr_set */
+	0,						/* tp_dictoffset */
+	0,						/* tp_init */
+	0,						/* tp_alloc */
+	0,						/* tp_new */
+};
+
+// @object PyEvtSubscriptionQueue|A subscription whose events are queued natively,
+//	created by <om win32evtlog.EvtSubscribeQueue>
+// @comm The subscription's callback never enters Python.  It renders each event
+//	into a bounded queue of reusable buffers - as the values selected by a render
+//	context, or as XML - and signals <o PyEvtSubscriptionQueue>.Handle.  Python
+//	takes everything queued at once with <om PyEvtSubscriptionQueue.Get>.
+// @comm When the queue is full, the callback waits up to FullTimeout milliseconds
+//	for Python to make room, which holds back further delivery by the event log
+//	service.  After that the event is dropped and counted in Dropped.
+class PyEvtSubscriptionQueue : public PyObject
+{
+public:
+	PyEvtSubscriptionQueue(void);
+	~PyEvtSubscriptionQueue();
+	BOOL Init(DWORD batchSize, DWORD maxBatches, DWORD bufferSize, DWORD fullTimeout);
+	void Close(void);
+	void Deliver(EVT_SUBSCRIBE_NOTIFY_ACTION action, EVT_HANDLE event);
+
+	/* Python support */
+	static void deallocFunc(PyObject *ob);
+	static PyObject *Get(PyObject *self, PyObject *args, PyObject *kwargs);
+	static PyObject *PyClose(PyObject *self, PyObject *args);
+	static PyObject *get_handle(PyObject *self, void *unused);
+	static PyObject *get_dropped(PyObject *self, void *unused);
+	static PyObject *get_queued(PyObject *self, void *unused);
+	static struct PyMethodDef methods[];
+	static struct PyGetSetDef getset[];
+	static PyTypeObject type;
+
+	PyObject *m_obcontext;		// owns m_context, if there is one
+	EVT_HANDLE m_context;
+	EVT_HANDLE m_subscription;	// taken by Close() with m_cs held
+
+protected:
+	void QueueFilling(void);
+
+	HANDLE m_ready;				// manual reset, set while events are queued or an error is pending
+	HANDLE m_space;				// manual reset, set when a batch is freed or the queue is closing
+	DWORD m_fullTimeout;
+	CRITICAL_SECTION m_cs;		// guards everything below - never held while in Python or rendering
+	BOOL m_csInitialized;
+	BOOL m_closing;
+	PyEvtBatch *m_free;
+	PyEvtBatch *m_filling;		// the batch events are being added to
+	PyEvtBatch *m_queued;		// full batches, oldest first
+	PyEvtBatch **m_queuedTail;
+	DWORD m_count;				// events in m_queued and m_filling
+	unsigned PY_LONG_LONG m_dropped;
+	DWORD m_error;				// from an EvtSubscribeActionError, or rendering
+};
+
+DWORD CALLBACK PyEvtSubscriptionQueue_callback(
+	EVT_SUBSCRIBE_NOTIFY_ACTION action,
+	void *context,
+	EVT_HANDLE event)
+{
+	((PyEvtSubscriptionQueue *)context)->Deliver(action, event);
+	return 0;
+}
+
+// @pyswig <o PyEvtSubscriptionQueue>|EvtSubscribeQueue|Subscribes to events, queueing them
+//	natively until Python asks for them
+// @comm Accepts keyword args
+// @comm Unlike <om win32evtlog.EvtSubscribe> with a Callback, Python is not entered for
+//	each event.  Wait for the Handle of the returned object to be signalled (or just call
+//	<om PyEvtSubscriptionQueue.Get>) to receive the events in batches.
+static PyObject *PyEvtSubscribeQueue(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *keywords[]={"ChannelPath", "Flags", "Query", "Session", "Bookmark", "Context",
+		"BatchSize", "MaxBatches", "BufferSize", "FullTimeout", NULL};
+	EVT_HANDLE session=NULL, bookmark=NULL, context=NULL, ret;
+	TmpWCHAR path, query;
+	PyObject *obpath, *obquery=Py_None, *obcontext=Py_None;
+	DWORD flags, batchSize=256, maxBatches=16, bufferSize=0x40000, fullTimeout=0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Ok|OO&O&Okkkk:EvtSubscribeQueue", keywords,
+		&obpath,	// @pyparm str|ChannelPath||Name of an event log channel
+		&flags,		// @pyparm int|Flags||Combination of EvtSubscribe* flags determining how subscription is initiated
+		&obquery,	// @pyparm str|Query|None|XML query used to select specific events, use None or '*' for all events
+		PyWinObject_AsHANDLE, &session,		// @pyparm <o PyEVT_HANDLE>|Session|None|Handle to a session on another machine, or None for local
+		PyWinObject_AsHANDLE, &bookmark,	// @pyparm <o PyEVT_HANDLE>|Bookmark|None|If Flags contains EvtSubscribeStartAfterBookmark, used as starting point
+		&obcontext,		// @pyparm <o PyEVT_HANDLE>|Context|None|A render context from <om win32evtlog.EvtCreateRenderContext>
+						//	selecting the values to queue for each event.  If None, the XML of each event is queued.
+		&batchSize,		// @pyparm int|BatchSize|256|Maximum number of events in each buffer
+		&maxBatches,	// @pyparm int|MaxBatches|16|Number of buffers, which bounds the events queued
+		&bufferSize,	// @pyparm int|BufferSize|262144|Size of each buffer
+		&fullTimeout))	// @pyparm int|FullTimeout|0|Milliseconds the callback waits for room when the queue is
+						//	full, before dropping the event.  -1 waits indefinitely.
+		return NULL;
+	if (!PyWinObject_AsHANDLE(obcontext, &context))
+		return NULL;
+	if (batchSize == 0 || maxBatches == 0){
+		PyErr_SetString(PyExc_ValueError, "BatchSize and MaxBatches must be greater than 0");
+		return NULL;
+		}
+	if (!PyWinObject_AsWCHAR(obpath, &path, FALSE))
+		return NULL;
+	if (!PyWinObject_AsWCHAR(obquery, &query, TRUE))
+		return NULL;
+	PyEvtSubscriptionQueue *queue = new PyEvtSubscriptionQueue();
+	if (queue == NULL)
+		return PyErr_NoMemory();
+	queue->m_obcontext = obcontext;
+	Py_INCREF(obcontext);
+	queue->m_context = context;
+	if (!queue->Init(batchSize, maxBatches, bufferSize, fullTimeout)){
+		Py_DECREF(queue);
+		return NULL;
+		}
+	Py_BEGIN_ALLOW_THREADS
+	ret = EvtSubscribe(session, NULL, path, query, bookmark,
+		(void *)queue, PyEvtSubscriptionQueue_callback, flags);
+	Py_END_ALLOW_THREADS
+	if (ret == NULL){
+		PyWin_SetAPIError("EvtSubscribe");
+		Py_DECREF(queue);
+		return NULL;
+		}
+	queue->m_subscription = ret;
+	return queue;
+}
+PyCFunction pfnPyEvtSubscribeQueue = (PyCFunction) PyEvtSubscribeQueue;
+
+PyEvtSubscriptionQueue::PyEvtSubscriptionQueue(void)
+{
+	ob_type = &type;
+	_Py_NewReference(this);
+	m_obcontext = NULL;
+	m_context = m_subscription = NULL;
+	m_ready = m_space = NULL;
+	m_fullTimeout = 0;
+	m_csInitialized = FALSE;
+	m_closing = FALSE;
+	m_free = m_filling = m_queued = NULL;
+	m_queuedTail = &m_queued;
+	m_count = 0;
+	m_dropped = 0;
+	m_error = 0;
+}
+
+PyEvtSubscriptionQueue::~PyEvtSubscriptionQueue()
+{
+	Close();
+	FreeEvtBatches(m_free);
+	FreeEvtBatches(m_filling);
+	FreeEvtBatches(m_queued);
+	if (m_ready)
+		CloseHandle(m_ready);
+	if (m_space)
+		CloseHandle(m_space);
+	if (m_csInitialized)
+		DeleteCriticalSection(&m_cs);
+	Py_XDECREF(m_obcontext);
+}
+
+BOOL PyEvtSubscriptionQueue::Init(DWORD batchSize, DWORD maxBatches, DWORD bufferSize, DWORD fullTimeout)
+{
+	InitializeCriticalSection(&m_cs);
+	m_csInitialized = TRUE;
+	m_fullTimeout = fullTimeout;
+	for (DWORD i = 0; i < maxBatches; i++){
+		PyEvtBatch *batch = NewEvtBatch(bufferSize, batchSize);
+		if (batch == NULL){
+			PyErr_NoMemory();
+			return FALSE;
+			}
+		batch->next = m_free;
+		m_free = batch;
+		}
+	m_ready = CreateEvent(NULL, TRUE, FALSE, NULL);
+	m_space = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (m_ready == NULL || m_space == NULL){
+		PyWin_SetAPIError("CreateEvent");
+		return FALSE;
+		}
+	return TRUE;
+}
+
+// Ends the subscription.  EvtClose waits for a callback in progress, and no
+// more are made once it returns.
+void PyEvtSubscriptionQueue::Close(void)
+{
+	if (!m_csInitialized)
+		return;
+	// Only the first caller gets the subscription, and closes it.
+	EnterCriticalSection(&m_cs);
+	EVT_HANDLE subscription = m_subscription;
+	m_subscription = NULL;
+	if (subscription == NULL){
+		LeaveCriticalSection(&m_cs);
+		return;
+		}
+	m_closing = TRUE;
+	SetEvent(m_space);	// release a callback waiting for room
+	LeaveCriticalSection(&m_cs);
+	Py_BEGIN_ALLOW_THREADS
+	EvtClose(subscription);
+	Py_END_ALLOW_THREADS
+	SetEvent(m_ready);	// wake anyone still waiting in Get()
+}
+
+// Must be called with the lock held.
+void PyEvtSubscriptionQueue::QueueFilling(void)
+{
+	m_filling->next = NULL;
+	*m_queuedTail = m_filling;
+	m_queuedTail = &m_filling->next;
+	m_filling = NULL;
+}
+
+// Called by the subscription for each event, on a thread of its own.
+void PyEvtSubscriptionQueue::Deliver(EVT_SUBSCRIBE_NOTIFY_ACTION action, EVT_HANDLE event)
+{
+	EnterCriticalSection(&m_cs);
+	if (action != EvtSubscribeActionDeliver){
+		// The "event" is an error code.
+		m_error = (DWORD)(ULONG_PTR)event;
+		SetEvent(m_ready);
+		LeaveCriticalSection(&m_cs);
+		return;
+		}
+	DWORD start = GetTickCount();
+	for (;;){
+		if (m_closing){
+			m_dropped++;
+			break;
+			}
+		if (m_filling == NULL && m_free != NULL){
+			m_filling = m_free;
+			m_free = m_free->next;
+			m_filling->next = NULL;
+			}
+		if (m_filling != NULL){
+			// Render without the lock, so Get() and the properties aren't held
+			// up by EvtRender.  The subscription delivers one event at a time,
+			// so nothing else adds to the batch while it is taken out of
+			// m_filling (where Get() would queue it).
+			PyEvtBatch *batch = m_filling;
+			m_filling = NULL;
+			m_count -= batch->count;
+			LeaveCriticalSection(&m_cs);
+			DWORD err;
+			BOOL rendered = RenderEvtBatch(batch, m_context,
+				m_context ? EvtRenderEventValues : EvtRenderEventXml, event, &err);
+			EnterCriticalSection(&m_cs);
+			m_filling = batch;
+			m_count += batch->count;
+			if (rendered){
+				SetEvent(m_ready);
+				break;
+				}
+			if (err){
+				m_error = err;
+				m_dropped++;
+				SetEvent(m_ready);
+				break;
+				}
+			// The batch is full - start another.
+			QueueFilling();
+			continue;
+			}
+		// The queue is full - wait for Python to take some of it.
+		DWORD wait = INFINITE;
+		if (m_fullTimeout != INFINITE){
+			DWORD elapsed = GetTickCount() - start;
+			if (elapsed >= m_fullTimeout){
+				m_dropped++;
+				break;
+				}
+			wait = m_fullTimeout - elapsed;
+			}
+		ResetEvent(m_space);
+		LeaveCriticalSection(&m_cs);
+		WaitForSingleObject(m_space, wait);
+		EnterCriticalSection(&m_cs);
+		}
+	LeaveCriticalSection(&m_cs);
+}
+
+// @pymethod [object,...]|PyEvtSubscriptionQueue|Get|Waits for events, and returns all those queued
+// @rdesc Returns a list with an item for each event - a tuple of the values selected
+//	by the Context, or the XML of the event if there is no Context - or None if the
+//	timeout expired first.
+// @comm If the subscription reported an error (or an event could not be rendered),
+//	it is raised once all the events queued before it have been returned.
+// @comm Accepts keyword args
+PyObject *PyEvtSubscriptionQueue::Get(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyEvtSubscriptionQueue *queue = (PyEvtSubscriptionQueue *)self;
+	static char *keywords[]={"Timeout", NULL};
+	DWORD timeout = INFINITE;
+	// @pyparm int|Timeout|-1|Milliseconds to wait for an event, -1 for infinite
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|k:Get", keywords, &timeout))
+		return NULL;
+	DWORD start = GetTickCount(), count = 0, err = 0;
+	PyEvtBatch *batches = NULL;
+	for (;;){
+		EnterCriticalSection(&queue->m_cs);
+		BOOL closing = queue->m_closing;
+		if (!closing){
+			if (queue->m_filling && queue->m_filling->count)
+				queue->QueueFilling();
+			batches = queue->m_queued;
+			count = queue->m_count;
+			queue->m_queued = NULL;
+			queue->m_queuedTail = &queue->m_queued;
+			queue->m_count = 0;
+			if (batches == NULL){
+				err = queue->m_error;
+				queue->m_error = 0;
+				}
+			// The callback sets the event (with the lock held) as it queues an event.
+			if (queue->m_error == 0)
+				ResetEvent(queue->m_ready);
+			}
+		LeaveCriticalSection(&queue->m_cs);
+		if (closing){
+			PyErr_SetString(PyExc_ValueError, "The subscription has been closed");
+			return NULL;
+			}
+		if (batches)
+			break;
+		if (err)
+			return PyWin_SetAPIError("EvtSubscribe", err);
+		DWORD wait = timeout;
+		if (timeout != INFINITE){
+			DWORD elapsed = GetTickCount() - start;
+			if (elapsed >= timeout){
+				Py_INCREF(Py_None);
+				return Py_None;
+				}
+			wait = timeout - elapsed;
+			}
+		DWORD rc;
+		Py_BEGIN_ALLOW_THREADS
+		rc = WaitForSingleObject(queue->m_ready, wait);
+		Py_END_ALLOW_THREADS
+		if (rc == WAIT_FAILED)
+			return PyWin_SetAPIError("WaitForSingleObject");
+	}
+
+	PyObject *ret = PyList_New(count);
+	DWORD n = 0;
+	for (PyEvtBatch *batch = batches; ret && batch; batch = batch->next)
+		for (DWORD i = 0; i < batch->count; i++){
+			BYTE *data = batch->buf + batch->offsets[i];
+			PyObject *item;
+			if (queue->m_context)
+				item = PyWinObject_FromEVT_VARIANTValues((PEVT_VARIANT)data, batch->propCount);
+			else
+				item = PyWinObject_FromWCHAR((WCHAR *)data);
+			if (item == NULL){
+				Py_DECREF(ret);
+				ret = NULL;
+				break;
+				}
+			PyList_SET_ITEM(ret, n++, item);
+			}
+	// Hand the buffers back to the callback.
+	EnterCriticalSection(&queue->m_cs);
+	while (batches){
+		PyEvtBatch *next = batches->next;
+		ResetEvtBatch(batches);
+		batches->next = queue->m_free;
+		queue->m_free = batches;
+		batches = next;
+		}
+	SetEvent(queue->m_space);
+	LeaveCriticalSection(&queue->m_cs);
+	return ret;
+}
+
+// @pymethod |PyEvtSubscriptionQueue|Close|Ends the subscription
+// @comm This is done automatically when the object is destroyed.  Events still
+//	queued are discarded.
+PyObject *PyEvtSubscriptionQueue::PyClose(PyObject *self, PyObject *args)
+{
+	if (!PyArg_ParseTuple(args, ":Close"))
+		return NULL;
+	((PyEvtSubscriptionQueue *)self)->Close();
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+PyObject *PyEvtSubscriptionQueue::get_handle(PyObject *self, void *unused)
+{
+	return PyWinLong_FromHANDLE(((PyEvtSubscriptionQueue *)self)->m_ready);
+}
+
+PyObject *PyEvtSubscriptionQueue::get_dropped(PyObject *self, void *unused)
+{
+	PyEvtSubscriptionQueue *queue = (PyEvtSubscriptionQueue *)self;
+	EnterCriticalSection(&queue->m_cs);
+	unsigned PY_LONG_LONG dropped = queue->m_dropped;
+	LeaveCriticalSection(&queue->m_cs);
+	return PyLong_FromUnsignedLongLong(dropped);
+}
+
+PyObject *PyEvtSubscriptionQueue::get_queued(PyObject *self, void *unused)
+{
+	PyEvtSubscriptionQueue *queue = (PyEvtSubscriptionQueue *)self;
+	EnterCriticalSection(&queue->m_cs);
+	DWORD count = queue->m_count;
+	LeaveCriticalSection(&queue->m_cs);
+	return PyLong_FromUnsignedLong(count);
+}
+
+/*static*/ void PyEvtSubscriptionQueue::deallocFunc(PyObject *ob)
+{
+	delete (PyEvtSubscriptionQueue *)ob;
+}
+
+/*static*/ struct PyMethodDef PyEvtSubscriptionQueue::methods[] = {
+	{"Get", (PyCFunction)PyEvtSubscriptionQueue::Get, METH_VARARGS | METH_KEYWORDS},	// @pymeth Get|Waits for events, and returns all those queued
+	{"Close", PyEvtSubscriptionQueue::PyClose, METH_VARARGS},	// @pymeth Close|Ends the subscription
+	{NULL}
+};
+
+/*static*/ struct PyGetSetDef PyEvtSubscriptionQueue::getset[] = {
+	// @prop int|Handle|An event handle which is signalled while events are queued, for use
+	//	with the win32event wait functions.  The handle is owned by the queue, so must not be closed.
+	{"Handle", PyEvtSubscriptionQueue::get_handle, NULL, "An event which is signalled while events are queued"},
+	// @prop int|Dropped|The number of events dropped because the queue was full or they could not be rendered
+	{"Dropped", PyEvtSubscriptionQueue::get_dropped, NULL, "The number of events dropped"},
+	// @prop int|Queued|The number of events waiting to be returned by <om PyEvtSubscriptionQueue.Get>
+	{"Queued", PyEvtSubscriptionQueue::get_queued, NULL, "The number of events queued"},
+	{NULL}
+};
+
+PyTypeObject PyEvtSubscriptionQueue::type =
+{
+	PYWIN_OBJECT_HEAD
+	"PyEvtSubscriptionQueue",
+	sizeof(PyEvtSubscriptionQueue),
+	0,
+	PyEvtSubscriptionQueue::deallocFunc,	/* tp_dealloc */
+	0,						/* tp_print */
+	0,						/* tp_getattr */
+	0,						/* tp_setattr */
+	0,						/* tp_compare */
+	0,						/* tp_repr */
+	0,						/* tp_as_number */
+	0,						/* tp_as_sequence */
+	0,						/* tp_as_mapping */
+	0,						/* tp_hash */
+	0,						/* tp_call */
+	0,						/* tp_str */
+	PyObject_GenericGetAttr,	/* tp_getattro */
+	0,						/* tp_setattro */
+	0,						/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,		/* tp_flags */
+	"A subscription whose events are queued natively",	/* tp_doc */
+	0,						/* tp_traverse */
+	0,						/* tp_clear */
+	0,						/* tp_richcompare */
+	0,						/* tp_weaklistoffset */
+	0,						/* tp_iter */
+	0,						/* tp_iternext */
+	PyEvtSubscriptionQueue::methods,	/* tp_methods */
+	0,						/* tp_members */
+	PyEvtSubscriptionQueue::getset,	/* tp_getset */
+	0,						/* tp_base */
+	0,						/* tp_dict */
+	0,						/* tp_descr_get */
+	0,						/* tp_descr_set */
+	0,						/* tp_dictoffset */
+	0,						/* tp_init */
+	0,						/* tp_alloc */
+	0,						/* tp_new */
+};
+
+// @pyswig (object, int)|EvtGetChannelConfigProperty|Retreives channel configuration information
+// @comm Accepts keyword args
+// @comm Returns the value and type of value (EvtVarType*)
+static PyObject *PyEvtGetChannelConfigProperty(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *keywords[]={"ChannelConfig", "PropertyId", "Flags", NULL};
+	EVT_HANDLE config_handle;
+	EVT_CHANNEL_CONFIG_PROPERTY_ID prop_id;
+	DWORD flags = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&i|k:EvtGetChannelConfigProperty", keywords,
+		PyWinObject_AsHANDLE, &config_handle,	// @pyparm <o PyEVT_HANDLE>|ChannelConfig||Config handle as returned by <om win32evtlog.EvtOpenChannelConfig>
+		&prop_id,	// @pyparm int|PropertyId||Property to retreive, one of EvtChannel* constants
+		&flags))	// @pyparm int|Flags|0|Reserved, use only 0
+		return NULL;
+
+	PEVT_VARIANT val = NULL;
+	DWORD buf_size=0, buf_needed, err;
+	Py_BEGIN_ALLOW_THREADS
+	EvtGetChannelConfigProperty(config_handle, prop_id, flags, buf_size, val, &buf_needed);
+	Py_END_ALLOW_THREADS
+	err = GetLastError();
+	if (err != ERROR_INSUFFICIENT_BUFFER)
+		return PyWin_SetAPIError("EvtGetChannelConfigProperty", err);
 	val = (PEVT_VARIANT)malloc(buf_needed);
 	if (val == NULL)
 		return PyErr_Format(PyExc_MemoryError, "Unable to allocate %d bytes", buf_needed);
@@ -1613,7 +3130,10 @@ PyCFunction pfnPyEvtGetObjectArrayProperty = (PyCFunction) PyEvtGetObjectArrayPr
 %native (EvtNext) pfnPyEvtNext;
 %native (EvtSeek) pfnPyEvtSeek;
 %native (EvtRender) pfnPyEvtRender;
+%native (EvtCreateRenderContext) pfnPyEvtCreateRenderContext;
+%native (EvtBatchReader) pfnPyEvtBatchReader_New;
 %native (EvtSubscribe) pfnPyEvtSubscribe;
+%native (EvtSubscribeQueue) pfnPyEvtSubscribeQueue;
 %native (EvtCreateBookmark) pfnPyEvtCreateBookmark;
 %native (EvtUpdateBookmark) pfnPyEvtUpdateBookmark;
 %native (EvtGetChannelConfigProperty) pfnPyEvtGetChannelConfigProperty;
@@ -1633,8 +3153,14 @@ PyCFunction pfnPyEvtGetObjectArrayProperty = (PyCFunction) PyEvtGetObjectArrayPr
 
 
 %init %{
+    if (PyType_Ready(&PyEventLogRecordType) == -1 ||
+        PyType_Ready(&PyEventLogFilterType) == -1 ||
+        PyType_Ready(&PyEvtBatchReader::type) == -1 ||
+        PyType_Ready(&PyEvtSubscriptionQueue::type) == -1)
+        PYWIN_MODULE_INIT_RETURN_ERROR;
     for (PyMethodDef *pmd = win32evtlogMethods;pmd->ml_name;pmd++)
         if   ((strcmp(pmd->ml_name, "EvtOpenChannelEnum")==0)
+			||(strcmp(pmd->ml_name, "EventLogFilter")==0)
 			||(strcmp(pmd->ml_name, "EvtNextChannelPath")==0) 
 			||(strcmp(pmd->ml_name, "EvtOpenLog")==0)
 			||(strcmp(pmd->ml_name, "EvtClearLog")==0)
@@ -1645,7 +3171,10 @@ PyCFunction pfnPyEvtGetObjectArrayProperty = (PyCFunction) PyEvtGetObjectArrayPr
 			||(strcmp(pmd->ml_name, "EvtNext")==0)
 			||(strcmp(pmd->ml_name, "EvtSeek")==0)
 			||(strcmp(pmd->ml_name, "EvtRender")==0)
+			||(strcmp(pmd->ml_name, "EvtCreateRenderContext")==0)
+			||(strcmp(pmd->ml_name, "EvtBatchReader")==0)
 			||(strcmp(pmd->ml_name, "EvtSubscribe")==0)
+			||(strcmp(pmd->ml_name, "EvtSubscribeQueue")==0)
 			||(strcmp(pmd->ml_name, "EvtCreateBookmark")==0)
 			||(strcmp(pmd->ml_name, "EvtUpdateBookmark")==0)
 			||(strcmp(pmd->ml_name, "EvtGetChannelConfigProperty")==0)
@@ -1696,6 +3225,11 @@ PyCFunction pfnPyEvtGetObjectArrayProperty = (PyCFunction) PyEvtGetObjectArrayPr
 #define EvtRenderEventXml EvtRenderEventXml
 #define EvtRenderBookmark EvtRenderBookmark
 
+// EVT_RENDER_CONTEXT_FLAGS used with EvtCreateRenderContext
+#define EvtRenderContextValues EvtRenderContextValues
+#define EvtRenderContextSystem EvtRenderContextSystem
+#define EvtRenderContextUser EvtRenderContextUser
+
 // EvtSubscribe flags
 #define EvtSubscribeToFutureEvents EvtSubscribeToFutureEvents
 #define EvtSubscribeStartAtOldestRecord EvtSubscribeStartAtOldestRecord
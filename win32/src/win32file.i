@@ -49,6 +49,9 @@
 
 #define NEED_PYWINOBJECTS_H
 #include "win32file_comm.h"
+#include "win32file_bufferpool.h"
+#include "win32file_notify.h"
+#include "win32file_watcher.h"
 %}
 
 %include "typemaps.i"
@@ -882,6 +885,7 @@ PyObject *MyAllocateReadBuffer(PyObject *self, PyObject *args)
 %}
 
 %native(AllocateReadBuffer) MyAllocateReadBuffer;
+%native(BufferPool) PyWinMethod_NewBufferPool;
 #endif
 
 %{
@@ -916,6 +920,7 @@ PyObject *MyReadFile(PyObject *self, PyObject *args)
 		return NULL;
 
 	// @comm in a multi-threaded overlapped environment, it is likely to be necessary to pre-allocate the read buffer using the <om win32file.AllocateReadBuffer> method, otherwise the I/O operation may complete before you can assign to the resulting buffer.
+	// @comm When many reads are in flight, buffers from a <om win32file.BufferPool> avoid allocating a new buffer for each operation.
 	if (obOverlapped!=Py_None){
 #ifdef MS_WINCE
 		PyErr_SetString(PyExc_NotImplementedError,"Overlapped operation is not supported on this platform");
@@ -1219,6 +1224,137 @@ static PyObject *myGetQueuedCompletionStatus(PyObject *self, PyObject *args)
 	return rc;
 }
 
+// OVERLAPPED_ENTRY is only declared by the SDK when targetting Vista, and
+// we still build for earlier versions - so declare a compatible version.
+typedef struct {
+	ULONG_PTR lpCompletionKey;
+	LPOVERLAPPED lpOverlapped;
+	ULONG_PTR Internal;	// NTSTATUS of the completed operation.
+	DWORD dwNumberOfBytesTransferred;
+} PYOVERLAPPED_ENTRY;
+typedef BOOL (WINAPI *GetQueuedCompletionStatusExfunc)(HANDLE, PYOVERLAPPED_ENTRY *, ULONG, PULONG, DWORD, BOOL);
+static GetQueuedCompletionStatusExfunc pfnGetQueuedCompletionStatusEx = NULL;
+typedef ULONG (WINAPI *RtlNtStatusToDosErrorfunc)(LONG);
+static RtlNtStatusToDosErrorfunc pfnRtlNtStatusToDosError = NULL;
+
+// Number of entries GetQueuedCompletionStatusEx can fetch without
+// allocating memory.
+#define GQCSEX_STACK_ENTRIES 64
+
+// @pyswig [(int, int, int, <o PyOVERLAPPED>), ...]|GetQueuedCompletionStatusEx|Dequeues multiple I/O completion packets from a completion port in one call.
+// @comm Requires Vista or later.
+// <nl>Each item in the result list is a tuple of (rc, numberOfBytesTransferred, completionKey, overlapped),
+// exactly as returned by <om win32file.GetQueuedCompletionStatus>, with rc being 0 for a
+// packet whose I/O succeeded, or the win32 error code otherwise.
+// <nl>If no packets are available before the timeout expires (or an alertable
+// wait was interrupted by an APC) an empty list is returned; any other failure
+// raises an exception.
+// <nl>The GIL is released once for the entire wait, so servers which would
+// otherwise make one <om win32file.GetQueuedCompletionStatus> call per
+// packet can process completions in batches.
+static PyObject *myGetQueuedCompletionStatusEx(PyObject *self, PyObject *args)
+{
+	if (pfnGetQueuedCompletionStatusEx==NULL)
+		return PyErr_Format(PyExc_NotImplementedError,"GetQueuedCompletionStatusEx is not available on this platform");
+	PyObject *obHandle;
+	ULONG maxEntries;
+	DWORD timeout;
+	BOOL alertable = FALSE;
+	// @pyparm <o PyHANDLE>|hPort||The handle to the completion port.
+	// @pyparm int|maxEntries||The maximum number of packets to dequeue.
+	// @pyparm int|timeOut||Timeout in milli-seconds.
+	// @pyparm bool|alertable|False|If True, the wait returns early to run queued APCs.
+	if (!PyArg_ParseTuple(args, "Okl|i:GetQueuedCompletionStatusEx", &obHandle, &maxEntries, &timeout, &alertable))
+		return NULL;
+	if (maxEntries == 0)
+		return PyErr_Format(PyExc_ValueError, "maxEntries must be at least 1");
+	HANDLE handle;
+	if (!PyWinObject_AsHANDLE(obHandle, &handle))
+		return NULL;
+	PYOVERLAPPED_ENTRY stack_entries[GQCSEX_STACK_ENTRIES];
+	PYOVERLAPPED_ENTRY *entries = stack_entries;
+	if (maxEntries > GQCSEX_STACK_ENTRIES) {
+		entries = (PYOVERLAPPED_ENTRY *)malloc(maxEntries * sizeof(PYOVERLAPPED_ENTRY));
+		if (entries == NULL)
+			return PyErr_NoMemory();
+	}
+	ULONG numRemoved = 0;
+	DWORD err = 0;
+	BOOL ok, bFailed = FALSE;
+	PyObject *exc_type = NULL, *exc_value = NULL, *exc_tb = NULL;
+	Py_BEGIN_ALLOW_THREADS
+	ok = (*pfnGetQueuedCompletionStatusEx)(handle, entries, maxEntries, &numRemoved, timeout, alertable);
+	if (!ok)
+		err = GetLastError();
+	Py_END_ALLOW_THREADS
+	PyObject *ret = NULL;
+	if (!ok) {
+		numRemoved = 0;
+		if (err == WAIT_TIMEOUT || err == WAIT_IO_COMPLETION)
+			ret = PyList_New(0);
+		else
+			PyWin_SetAPIError("GetQueuedCompletionStatusEx", err);
+		goto done;
+	}
+	ret = PyList_New(numRemoved);
+	if (ret == NULL) {
+		PyErr_Fetch(&exc_type, &exc_value, &exc_tb);
+		bFailed = TRUE;
+	}
+	// Every dequeued OVERLAPPED must have its reference recovered (and the
+	// artificial reference added when it was queued consumed), even if
+	// converting an earlier entry failed, so we always walk the entire set.
+	for (ULONG i = 0; i < numRemoved; i++) {
+		PYOVERLAPPED_ENTRY *pe = entries + i;
+		PyObject *obOverlapped = PyWinObject_FromQueuedOVERLAPPED(pe->lpOverlapped);
+		if (obOverlapped == NULL) {
+			if (!bFailed) {
+				PyErr_Fetch(&exc_type, &exc_value, &exc_tb);
+				bFailed = TRUE;
+			}
+			continue;
+		}
+		if (ret == NULL) {
+			Py_DECREF(obOverlapped);
+			continue;
+		}
+		DWORD rc = 0;
+		if (pe->Internal != 0)
+			rc = pfnRtlNtStatusToDosError ? (*pfnRtlNtStatusToDosError)((LONG)pe->Internal) : (DWORD)pe->Internal;
+		PyObject *item = PyTuple_New(4);
+		PyObject *obrc = PyLong_FromUnsignedLong(rc);
+		PyObject *obbytes = PyLong_FromUnsignedLong(pe->dwNumberOfBytesTransferred);
+		PyObject *obkey = PyWinObject_FromULONG_PTR(pe->lpCompletionKey);
+		if (item == NULL || obrc == NULL || obbytes == NULL || obkey == NULL) {
+			Py_XDECREF(item);
+			Py_XDECREF(obrc);
+			Py_XDECREF(obbytes);
+			Py_XDECREF(obkey);
+			Py_DECREF(obOverlapped);
+			if (!bFailed) {
+				PyErr_Fetch(&exc_type, &exc_value, &exc_tb);
+				bFailed = TRUE;
+			}
+			continue;
+		}
+		PyTuple_SET_ITEM(item, 0, obrc);
+		PyTuple_SET_ITEM(item, 1, obbytes);
+		PyTuple_SET_ITEM(item, 2, obkey);
+		PyTuple_SET_ITEM(item, 3, obOverlapped);
+		PyList_SET_ITEM(ret, i, item);
+	}
+	if (bFailed) {
+		// The list may have NULL entries, which is OK for a dealloc.
+		Py_XDECREF(ret);
+		ret = NULL;
+		PyErr_Restore(exc_type, exc_value, exc_tb);
+	}
+done:
+	if (entries != stack_entries)
+		free(entries);
+	return ret;
+}
+
 // @pyswig None|PostQueuedCompletionStatus|lets you post an I/O completion packet to an I/O completion port. The I/O completion packet will satisfy an outstanding call to the GetQueuedCompletionStatus function.
 PyObject *myPostQueuedCompletionStatus(PyObject *self, PyObject *args)
 {
@@ -1258,6 +1394,7 @@ PyObject *myPostQueuedCompletionStatus(PyObject *self, PyObject *args)
 
 %native (GetQueuedCompletionStatus) myGetQueuedCompletionStatus;
 %native (PostQueuedCompletionStatus) myPostQueuedCompletionStatus;
+%native (GetQueuedCompletionStatusEx) myGetQueuedCompletionStatusEx;
 #endif // MS_WINCE
 
 %native(ReadFile) MyReadFile;
@@ -1396,43 +1533,149 @@ static PyObject *MyQueryDosDevice(PyObject *self, PyObject *args)
 %}
 
 %{
+static PyObject *PyObject_FromFileNotifyRecord(const PyFileNotifyRecord *rec)
+{
+	PyObject *fname = PyWinObject_FromOLECHAR((const OLECHAR *)rec->FileName, (int)rec->FileNameLength);
+	if (!fname)
+		return NULL;
+	return Py_BuildValue("iN", rec->Action, fname);
+}
+
 static PyObject *PyObject_FromFILE_NOTIFY_INFORMATION(void *buffer, DWORD nbytes)
 {
-	FILE_NOTIFY_INFORMATION *p = (FILE_NOTIFY_INFORMATION *)buffer;
 	PyObject *ret = PyList_New(0);
-	// comparing against the sizeof(FILE_NOTIFY_INFORMATION) fails when
-	// the filename is exactly 1 byte!  Not clear the best way to
-	// check this, but this works for now - is it at least the size of
-	// the *head* of the struct.
-	if (nbytes < sizeof DWORD*3+2)
-		return ret;
-	DWORD nbytes_read = 0;
-	while (1) {
-		PyObject *fname = PyWinObject_FromOLECHAR(p->FileName, p->FileNameLength/sizeof WCHAR);
-		if (!fname) {
-			Py_DECREF(ret);
-			return NULL;
-		}
-		PyObject *ob = Py_BuildValue("iN", p->Action, fname);
-		if (ob==NULL) {
+	if (ret==NULL)
+		return NULL;
+	PyFileNotifyParser parser;
+	PyFileNotifyRecord rec;
+	int rc;
+	parser.Init(buffer, nbytes);
+	while ((rc = parser.Next(&rec)) == 1) {
+		PyObject *ob = PyObject_FromFileNotifyRecord(&rec);
+		if (ob==NULL || PyList_Append(ret, ob) == -1) {
+			Py_XDECREF(ob);
 			Py_DECREF(ret);
 			return NULL;
 		}
-		PyList_Append(ret, ob);
 		Py_DECREF(ob);
-		if (p->NextEntryOffset==0)
+	}
+	if (rc == -1) {
+		PyErr_Format(PyExc_RuntimeError, "internal error decoding - %s", parser.error);
+		Py_DECREF(ret);
+		return NULL;
+	}
+	return ret;
+}
+
+// The iterator returned by FileNotifyIterator.
+typedef struct {
+	PyObject_HEAD
+	PyObject *obbuf;
+#if (PY_VERSION_HEX >= 0x03000000)
+	Py_buffer view;		// stops the buffer being resized under us
+#endif
+	PyFileNotifyParser parser;
+	BOOL coalesce;
+	PyFileNotifyCoalescer coalescer;
+	PyObject *result;	// (action, filename) tuple reused when nobody else holds it
+} FileNotifyIterator;
+
+static void
+fni_dealloc(FileNotifyIterator *it)
+{
+#if (PY_VERSION_HEX >= 0x03000000)
+	if (it->obbuf)
+		PyBuffer_Release(&it->view);
+#endif
+	Py_XDECREF(it->obbuf);
+	Py_XDECREF(it->result);
+	it->coalescer.Free();
+	PyObject_Del(it);
+}
+
+static PyObject *
+fni_iternext(PyObject *iterator)
+{
+	FileNotifyIterator *it = (FileNotifyIterator *)iterator;
+	PyFileNotifyRecord rec;
+	int rc;
+	while ((rc = it->parser.Next(&rec)) == 1) {
+		if (!it->coalesce || it->coalescer.Keep(rec))
 			break;
-		p = (FILE_NOTIFY_INFORMATION *)(((BYTE *)p) + p->NextEntryOffset);
-		nbytes_read += p->NextEntryOffset;
-		if (nbytes_read > nbytes) {
-			PyErr_SetString(PyExc_RuntimeError, "internal error decoding - running off end of buffer before seeing end-of-buffer marker");
-			Py_DECREF(ret);
+	}
+	if (rc == 0)
+		return NULL;	// StopIteration
+	if (rc == -1)
+		return PyErr_Format(PyExc_RuntimeError, "internal error decoding - %s", it->parser.error);
+
+	PyObject *fname = PyWinObject_FromOLECHAR((const OLECHAR *)rec.FileName, (int)rec.FileNameLength);
+	if (fname==NULL)
+		return NULL;
+	PyObject *action = PyInt_FromLong(rec.Action);
+	if (action==NULL) {
+		Py_DECREF(fname);
+		return NULL;
+	}
+	PyObject *ret = it->result;
+	if (ret && Py_REFCNT(ret) == 1) {
+		// Nobody kept the last result - fill it in again.
+		Py_INCREF(ret);
+		Py_DECREF(PyTuple_GET_ITEM(ret, 0));
+		Py_DECREF(PyTuple_GET_ITEM(ret, 1));
+	} else {
+		ret = PyTuple_New(2);
+		if (ret==NULL) {
+			Py_DECREF(action);
+			Py_DECREF(fname);
 			return NULL;
 		}
-	 }
-	 return ret;
+		Py_XDECREF(it->result);
+		Py_INCREF(ret);
+		it->result = ret;
+	}
+	PyTuple_SET_ITEM(ret, 0, action);
+	PyTuple_SET_ITEM(ret, 1, fname);
+	return ret;
 }
 
+PyTypeObject FileNotifyIterator_Type = {
+	PYWIN_OBJECT_HEAD
+	"FileNotifyIterator",			/* tp_name */
+	sizeof(FileNotifyIterator),		/* tp_basicsize */
+	0,					/* tp_itemsize */
+	/* methods */
+	(destructor)fni_dealloc, 		/* tp_dealloc */
+	0,					/* tp_print */
+	0,					/* tp_getattr */
+	0,					/* tp_setattr */
+	0,					/* tp_compare */
+	0,					/* tp_repr */
+	0,					/* tp_as_number */
+	0,					/* tp_as_sequence */
+	0,					/* tp_as_mapping */
+	0,					/* tp_hash */
+	0,					/* tp_call */
+	0,					/* tp_str */
+	PyObject_GenericGetAttr,		/* tp_getattro */
+	0,					/* tp_setattro */
+	0,					/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT, /* tp_flags */
+	0,					/* tp_doc */
+	0,					/* tp_traverse */
+	0,					/* tp_clear */
+	0,					/* tp_richcompare */
+	0,					/* tp_weaklistoffset */
+	PyObject_SelfIter,	/* tp_iter */
+	(iternextfunc)fni_iternext,		/* tp_iternext */
+	0,					/* tp_methods */
+	0,					/* tp_members */
+	0,					/* tp_getset */
+	0,					/* tp_base */
+	0,					/* tp_dict */
+	0,					/* tp_descr_get */
+	0,					/* tp_descr_set */
+};
+
 // @pyswig |ReadDirectoryChangesW|retrieves information describing the changes occurring within a directory.
 static PyObject *PyReadDirectoryChangesW(PyObject *self, PyObject *args)
 {
@@ -1507,7 +1750,7 @@ static PyObject *PyReadDirectoryChangesW(PyObject *self, PyObject *args)
     // @rdesc If a buffer size is passed, the result is a list of (action, filename)
     // @rdesc If a buffer is passed, the result is None - you must use the overlapped
     // object to determine when the information is available and how much is valid.
-    // The buffer can then be passed to <om win32file.FILE_NOTIFY_INFORMATION>
+    // The buffer can then be passed to <om win32file.FILE_NOTIFY_INFORMATION> or <om win32file.FileNotifyIterator>
     // @comm The FILE_NOTIFY_INFORMATION structure used by this function
     // is variable length, depending on the length of the filename.
     // The size of the buffer must be at least 6 bytes long + the length
@@ -1540,9 +1783,83 @@ PyObject *PyFILE_NOTIFY_INFORMATION(PyObject *self, PyObject *args)
 	return PyObject_FromFILE_NOTIFY_INFORMATION((void *)buf, size);
 }
 
+// @pyswig iterator|FileNotifyIterator|Returns an iterator over the (action, filename)
+// records in a buffer filled by <om win32file.ReadDirectoryChangesW>.
+// Similar to <om win32file.FILE_NOTIFY_INFORMATION>, but decodes each record only
+// as it is requested, and avoids building the list.
+// @comm Accepts keyword args.
+// @comm The iterator keeps a reference to the buffer, but the buffer's contents
+// must not be changed (eg, by issuing another ReadDirectoryChangesW into it)
+// until iteration is complete.
+// @comm The result tuple is reused for the next record if no reference to it
+// was kept, so use the values (eg, via tuple unpacking in the for statement)
+// rather than holding on to the tuple itself if that matters.
+// @comm If Coalesce is True, a FILE_ACTION_MODIFIED record is skipped if the
+// same path was already reported as modified earlier in the buffer, with no
+// other action for that path in between.  Names are compared exactly.
+static PyObject *py_FileNotifyIterator(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *obbuf;
+	DWORD size = (DWORD)-1;
+	BOOL coalesce = FALSE;
+	static char *keywords[]={"Buffer", "Size", "Coalesce", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ki:FileNotifyIterator", keywords,
+		&obbuf,		// @pyparm buffer|Buffer||The buffer to decode.
+		&size,		// @pyparm int|Size|-1|The number of valid bytes in the buffer, as
+					// returned by <om win32file.GetOverlappedResult>.  -1 means the whole buffer.
+		&coalesce))	// @pyparm bool|Coalesce|False|Collapse repeated modifications of the same path.
+		return NULL;
+
+	FileNotifyIterator *it = PyObject_New(FileNotifyIterator, &FileNotifyIterator_Type);
+	if (it == NULL)
+		return NULL;
+	it->obbuf = NULL;
+	it->result = NULL;
+	it->coalesce = coalesce;
+	it->coalescer.Init();
+
+	void *buf;
+	DWORD bufSize;
+#if (PY_VERSION_HEX >= 0x03000000)
+	if (PyObject_GetBuffer(obbuf, &it->view, PyBUF_SIMPLE) == -1) {
+		Py_DECREF(it);
+		return NULL;
+	}
+	buf = it->view.buf;
+	bufSize = it->view.len > MAXDWORD ? MAXDWORD : (DWORD)it->view.len;
+#else
+	if (!PyWinObject_AsReadBuffer(obbuf, &buf, &bufSize, FALSE)) {
+		Py_DECREF(it);
+		return NULL;
+	}
+#endif
+	Py_INCREF(obbuf);
+	it->obbuf = obbuf;
+	if (size == (DWORD)-1)
+		size = bufSize;
+	else if (size > bufSize) {
+		Py_DECREF(it);
+		return PyErr_Format(PyExc_ValueError, "buffer is only %d bytes long, but %d bytes were requested",
+		                    bufSize, size);
+	}
+	it->parser.Init(buf, size);
+	return (PyObject *)it;
+}
+PyCFunction pfnpy_FileNotifyIterator=(PyCFunction)py_FileNotifyIterator;
+
 %}
 %native(ReadDirectoryChangesW) PyReadDirectoryChangesW;
 %native(FILE_NOTIFY_INFORMATION) PyFILE_NOTIFY_INFORMATION;
+%native(FileNotifyIterator) pfnpy_FileNotifyIterator;
+%{
+PyCFunction pfnPyWinMethod_NewDirectoryWatcher=(PyCFunction)PyWinMethod_NewDirectoryWatcher;
+%}
+%native(DirectoryWatcher) pfnPyWinMethod_NewDirectoryWatcher;
+
+#define DIRECTORY_WATCHER_RESCAN PYDIRWATCH_RESCAN
+// Action reported by a <o PyDirectoryWatcher> when changes to a directory were lost and it should be rescanned.
+#define DIRECTORY_WATCHER_STOPPED PYDIRWATCH_STOPPED
+// Action reported by a <o PyDirectoryWatcher> when a directory can no longer be watched.
 
 // ReadFileEx
 // SearchPath	
@@ -5980,9 +6297,16 @@ PyCFunction pfnpy_OpenFileById=(PyCFunction)py_OpenFileById;
 %init %{
 
 	if (PyType_Ready(&FindFileIterator_Type) == -1
+		||PyType_Ready(&FileNotifyIterator_Type) == -1
 		||PyType_Ready(&PyDCB::type) == -1
-		||PyType_Ready(&PyCOMSTAT::type) == -1)
+		||PyType_Ready(&PyCOMSTAT::type) == -1
+		||PyType_Ready(&PyDirectoryWatcher::type) == -1)
 		PYWIN_MODULE_INIT_RETURN_ERROR;
+#if (PY_VERSION_HEX >= 0x03000000)
+	if (PyType_Ready(&PyBufferPool::type) == -1
+		||PyType_Ready(&PyBufferPoolChunk::type) == -1)
+		PYWIN_MODULE_INIT_RETURN_ERROR;
+#endif
 
 	if (PyDict_SetItemString(d, "error", PyWinExc_ApiError) == -1)
 		PYWIN_MODULE_INIT_RETURN_ERROR;
@@ -6007,6 +6331,8 @@ PyCFunction pfnpy_OpenFileById=(PyCFunction)py_OpenFileById;
 			||(strcmp(pmd->ml_name, "RemoveDirectory")==0)
 			||(strcmp(pmd->ml_name, "FindFilesW")==0)
 			||(strcmp(pmd->ml_name, "FindFilesIterator")==0)
+			||(strcmp(pmd->ml_name, "FileNotifyIterator")==0)
+			||(strcmp(pmd->ml_name, "DirectoryWatcher")==0)
 			||(strcmp(pmd->ml_name, "FindStreams")==0)
 			||(strcmp(pmd->ml_name, "FindFileNames")==0)
 			||(strcmp(pmd->ml_name, "GetFinalPathNameByHandle")==0)
@@ -6099,8 +6425,13 @@ PyCFunction pfnpy_OpenFileById=(PyCFunction)py_OpenFileById;
 		pfnWow64RevertWow64FsRedirection=(Wow64RevertWow64FsRedirectionfunc)GetProcAddress(hmodule, "Wow64RevertWow64FsRedirection");
 		pfnReOpenFile=(ReOpenFilefunc)GetProcAddress(hmodule, "ReOpenFile");
 		pfnOpenFileById=(OpenFileByIdfunc)GetProcAddress(hmodule, "OpenFileById");
+		pfnGetQueuedCompletionStatusEx=(GetQueuedCompletionStatusExfunc)GetProcAddress(hmodule, "GetQueuedCompletionStatusEx");
 		}
 
+	hmodule=GetModuleHandle(TEXT("ntdll.dll"));
+	if (hmodule)
+		pfnRtlNtStatusToDosError=(RtlNtStatusToDosErrorfunc)GetProcAddress(hmodule, "RtlNtStatusToDosError");
+
 	hmodule=GetModuleHandle(TEXT("sfc.dll"));
 	if (hmodule==NULL)
 		hmodule=LoadLibrary(TEXT("sfc.dll"));
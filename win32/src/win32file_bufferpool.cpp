@@ -0,0 +1,283 @@
+// A pool of reusable, page-aligned buffers for overlapped IO.
+//
+// @doc
+
+#include "PyWinTypes.h"
+#include "PyWinObjects.h"
+#include "win32file_bufferpool.h"
+
+#if (PY_VERSION_HEX >= 0x03000000)
+
+// @pymethod <o PyBufferPool>|win32file|BufferPool|Creates a pool of reusable buffers for overlapped IO
+// @comm Each call to <om PyBufferPool.get> returns a writable memoryview over
+// one chunk of the pool, which can be passed as the buffer to <om win32file.ReadFile>,
+// <om win32file.WriteFile>, <om win32file.WSARecv> and <om win32file.WSASend>.
+// When the memoryview (and any slices made from it) are released, the chunk
+// is returned to the pool for reuse.
+// <nl>The chunks are carved from a single block of memory allocated with
+// VirtualAlloc, and each begins on a page boundary.
+// <nl>As with <om win32file.AllocateReadBuffer>, you must keep a reference to the
+// memoryview until any overlapped operation using it has completed.
+PyObject *PyWinMethod_NewBufferPool(PyObject *self, PyObject *args)
+{
+	DWORD chunkSize, count;
+	// @pyparm int|chunk_size||The size of each buffer, in bytes.  Chunks are spaced at page
+	//	boundaries, so this is best a multiple of the system page size.
+	// @pyparm int|count||The number of buffers to preallocate.
+	if (!PyArg_ParseTuple(args, "kk:BufferPool", &chunkSize, &count))
+		return NULL;
+	if (chunkSize==0 || count==0)
+		return PyErr_Format(PyExc_ValueError, "chunk_size and count must both be greater than zero");
+	PyBufferPool *ret = new PyBufferPool();
+	if (ret==NULL)
+		return PyErr_NoMemory();
+	if (!ret->Init(chunkSize, count)){
+		Py_DECREF(ret);
+		return NULL;
+		}
+	return ret;
+}
+
+// @object PyBufferPool|A pool of page-aligned buffers, created by <om win32file.BufferPool>
+PyBufferPool::PyBufferPool(void)
+{
+	ob_type = &type;
+	_Py_NewReference(this);
+	m_chunkSize = m_stride = m_count = m_numFree = 0;
+	m_slab = NULL;
+	m_freeList = NULL;
+	m_hits = m_misses = 0;
+	m_outstanding = 0;
+}
+
+PyBufferPool::~PyBufferPool(void)
+{
+	// Every chunk holds a reference to the pool, so none can be outstanding here.
+	if (m_slab)
+		VirtualFree(m_slab, 0, MEM_RELEASE);
+	if (m_freeList)
+		free(m_freeList);
+}
+
+BOOL PyBufferPool::Init(DWORD chunkSize, DWORD count)
+{
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	DWORD pageSize = si.dwPageSize;
+	unsigned PY_LONG_LONG stride = ((unsigned PY_LONG_LONG)chunkSize + pageSize - 1) / pageSize * pageSize;
+	unsigned PY_LONG_LONG total = stride * count;
+	if (stride > MAXDWORD || total > (size_t)-1){
+		PyErr_SetString(PyExc_ValueError, "The buffer pool is too large");
+		return FALSE;
+		}
+	m_freeList = (DWORD *)malloc(count * sizeof(DWORD));
+	if (m_freeList==NULL){
+		PyErr_NoMemory();
+		return FALSE;
+		}
+	m_slab = (BYTE *)VirtualAlloc(NULL, (SIZE_T)total, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if (m_slab==NULL){
+		PyWin_SetAPIError("VirtualAlloc");
+		return FALSE;
+		}
+	m_chunkSize = chunkSize;
+	m_stride = (DWORD)stride;
+	m_count = count;
+	// Hand out chunks from the start of the slab first.
+	for (DWORD i = 0; i < count; i++)
+		m_freeList[i] = count - 1 - i;
+	m_numFree = count;
+	return TRUE;
+}
+
+PyObject *PyBufferPool::GetChunk(void)
+{
+	BYTE *p;
+	BOOL fromSlab = m_numFree > 0;
+	if (fromSlab)
+		p = m_slab + (SIZE_T)m_freeList[m_numFree-1] * m_stride;
+	else{
+		// Pool is exhausted - fall back to a private page-aligned allocation
+		// which is freed, rather than pooled, when released.
+		p = (BYTE *)VirtualAlloc(NULL, m_stride, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+		if (p==NULL)
+			return PyWin_SetAPIError("VirtualAlloc");
+		}
+	PyBufferPoolChunk *chunk = new PyBufferPoolChunk(this, p, m_chunkSize);
+	if (chunk==NULL){
+		if (!fromSlab)
+			VirtualFree(p, 0, MEM_RELEASE);
+		return PyErr_NoMemory();
+		}
+	// From here on, the chunk's destructor gives the memory back.
+	if (fromSlab){
+		m_numFree--;
+		m_hits++;
+		}
+	else
+		m_misses++;
+	m_outstanding++;
+	PyObject *ret = PyMemoryView_FromObject(chunk);
+	Py_DECREF(chunk);
+	return ret;
+}
+
+void PyBufferPool::ReleaseChunk(BYTE *p)
+{
+	m_outstanding--;
+	if (p >= m_slab && p < m_slab + (SIZE_T)m_stride * m_count)
+		m_freeList[m_numFree++] = (DWORD)((p - m_slab) / m_stride);
+	else
+		VirtualFree(p, 0, MEM_RELEASE);
+}
+
+// @pymethod memoryview|PyBufferPool|get|Returns a writable buffer from the pool
+// @rdesc The result is a memoryview of chunk_size bytes.  If no chunk is free,
+// a new buffer is allocated outside the pool (and counted in the misses attribute).
+// @comm The chunk goes back to the pool when the memoryview is released, either by
+// the last reference to it going away, or explicitly via its release() method or a
+// with statement.  The contents of a recycled chunk are not cleared.
+PyObject *PyBufferPool::get(PyObject *self, PyObject *args)
+{
+	if (!PyArg_ParseTuple(args, ":get"))
+		return NULL;
+	return ((PyBufferPool *)self)->GetChunk();
+}
+
+/*static*/ void PyBufferPool::deallocFunc(PyObject *ob)
+{
+	delete (PyBufferPool *)ob;
+}
+
+#define OFF(e) offsetof(PyBufferPool, e)
+
+/*static*/ struct PyMemberDef PyBufferPool::members[] = {
+	{"chunk_size", T_ULONG, OFF(m_chunkSize), READONLY},	// @prop int|chunk_size|The size of each buffer
+	{"count", T_ULONG, OFF(m_count), READONLY},				// @prop int|count|The number of buffers in the pool
+	{"available", T_ULONG, OFF(m_numFree), READONLY},		// @prop int|available|The number of buffers currently free in the pool
+	{"hits", T_ULONGLONG, OFF(m_hits), READONLY},			// @prop int|hits|The number of requests satisfied from the pool
+	{"misses", T_ULONGLONG, OFF(m_misses), READONLY},		// @prop int|misses|The number of requests which found the pool empty and allocated a new buffer
+	{"outstanding", T_ULONG, OFF(m_outstanding), READONLY},	// @prop int|outstanding|The number of buffers (pooled or not) currently in use
+	{NULL}
+};
+
+/*static*/ struct PyMethodDef PyBufferPool::methods[] = {
+	{"get", PyBufferPool::get, METH_VARARGS},	// @pymeth get|Returns a writable buffer from the pool
+	{NULL}
+};
+
+PyTypeObject PyBufferPool::type =
+{
+	PYWIN_OBJECT_HEAD
+	"PyBufferPool",
+	sizeof(PyBufferPool),
+	0,
+	PyBufferPool::deallocFunc,	/* tp_dealloc */
+	0,						/* tp_print */
+	0,						/* tp_getattr */
+	0,						/* tp_setattr */
+	0,						/* tp_compare */
+	0,						/* tp_repr */
+	0,						/* tp_as_number */
+	0,						/* tp_as_sequence */
+	0,						/* tp_as_mapping */
+	0,						/* tp_hash */
+	0,						/* tp_call */
+	0,						/* tp_str */
+	PyObject_GenericGetAttr,	/* tp_getattro */
+	0,						/* tp_setattro */
+	0,						/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,		/* tp_flags */
+	"A pool of page-aligned buffers for overlapped IO",	/* tp_doc */
+	0,						/* tp_traverse */
+	0,						/* tp_clear */
+	0,						/* tp_richcompare */
+	0,						/* tp_weaklistoffset */
+	0,						/* tp_iter */
+	0,						/* tp_iternext */
+	PyBufferPool::methods,	/* tp_methods */
+	PyBufferPool::members,	/* tp_members */
+	0,						/* tp_getset */
+	0,						/* tp_base */
+	0,						/* tp_dict */
+	0,						/* tp_descr_get */
+	0,						/* tp_descr_set */
+	0,						/* tp_dictoffset */
+	0,						/* tp_init */
+	0,						/* tp_alloc */
+	0,						/* tp_new */
+};
+
+////////////////////////////////////////////////////////////////
+//
+// A single chunk of a buffer pool.
+//
+////////////////////////////////////////////////////////////////
+PyBufferPoolChunk::PyBufferPoolChunk(PyBufferPool *pool, BYTE *p, DWORD size)
+{
+	ob_type = &type;
+	_Py_NewReference(this);
+	Py_INCREF(pool);
+	m_pool = pool;
+	m_data = p;
+	m_size = size;
+}
+
+PyBufferPoolChunk::~PyBufferPoolChunk(void)
+{
+	m_pool->ReleaseChunk(m_data);
+	Py_DECREF(m_pool);
+}
+
+/*static*/ int PyBufferPoolChunk::getbuffer(PyObject *self, Py_buffer *view, int flags)
+{
+	PyBufferPoolChunk *chunk = (PyBufferPoolChunk *)self;
+	return PyBuffer_FillInfo(view, self, chunk->m_data, chunk->m_size, 0, flags);
+}
+
+/*static*/ void PyBufferPoolChunk::deallocFunc(PyObject *ob)
+{
+	delete (PyBufferPoolChunk *)ob;
+}
+
+/*static*/ PyBufferProcs PyBufferPoolChunk::buffer_procs = {
+	PyBufferPoolChunk::getbuffer,	/* bf_getbuffer */
+	0,								/* bf_releasebuffer */
+};
+
+PyTypeObject PyBufferPoolChunk::type =
+{
+	PYWIN_OBJECT_HEAD
+	"PyBufferPoolChunk",
+	sizeof(PyBufferPoolChunk),
+	0,
+	PyBufferPoolChunk::deallocFunc,	/* tp_dealloc */
+	0,						/* tp_print */
+	0,						/* tp_getattr */
+	0,						/* tp_setattr */
+	0,						/* tp_compare */
+	0,						/* tp_repr */
+	0,						/* tp_as_number */
+	0,						/* tp_as_sequence */
+	0,						/* tp_as_mapping */
+	0,						/* tp_hash */
+	0,						/* tp_call */
+	0,						/* tp_str */
+	PyObject_GenericGetAttr,	/* tp_getattro */
+	0,						/* tp_setattro */
+	&PyBufferPoolChunk::buffer_procs,	/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,		/* tp_flags */
+	"A buffer belonging to a PyBufferPool",	/* tp_doc */
+};
+
+#else // PY_VERSION_HEX
+
+// Python 2's memoryview doesn't support the old buffer interface used by the
+// IO functions, so there's nothing useful the pool could hand out.
+PyObject *PyWinMethod_NewBufferPool(PyObject *self, PyObject *args)
+{
+	PyErr_SetString(PyExc_NotImplementedError, "BufferPool requires Python 3");
+	return NULL;
+}
+
+#endif // PY_VERSION_HEX
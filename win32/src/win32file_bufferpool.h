@@ -0,0 +1,65 @@
+// A pool of reusable, page-aligned buffers for overlapped IO.
+//
+// The buffers handed out by the pool are exposed to Python as memoryview
+// objects, so they can be passed anywhere win32file accepts a buffer
+// (ReadFile, WriteFile, WSARecv, WSASend, ...).  When the memoryview (and
+// any slices taken from it) are released, the chunk returns to the pool.
+
+extern PyObject *PyWinMethod_NewBufferPool(PyObject *self, PyObject *args);
+
+#if (PY_VERSION_HEX >= 0x03000000)
+
+class PyBufferPool : public PyObject
+{
+public:
+	PyBufferPool(void);
+	~PyBufferPool();
+	BOOL Init(DWORD chunkSize, DWORD count);
+
+	// Returns a new memoryview over a free chunk (or over a freshly
+	// allocated one if the pool is exhausted).
+	PyObject *GetChunk(void);
+	// Called when the last reference to a chunk goes away.
+	void ReleaseChunk(BYTE *p);
+
+	/* Python support */
+	static void deallocFunc(PyObject *ob);
+	static PyObject *get(PyObject *self, PyObject *args);
+	static struct PyMemberDef members[];
+	static struct PyMethodDef methods[];
+	static PyTypeObject type;
+
+protected:
+	DWORD m_chunkSize;	// size of each chunk as seen by Python
+	DWORD m_stride;		// m_chunkSize rounded up to a page
+	DWORD m_count;		// number of chunks in the slab
+	BYTE *m_slab;
+	DWORD *m_freeList;	// stack of free chunk indexes into the slab
+	DWORD m_numFree;
+	unsigned PY_LONG_LONG m_hits;
+	unsigned PY_LONG_LONG m_misses;
+	DWORD m_outstanding;
+};
+
+#define PyBufferPool_Check(x) ((x)->ob_type==&PyBufferPool::type)
+
+// The object exporting a single chunk's memory - never seen directly by
+// Python code, only via the memoryview wrapping it.
+class PyBufferPoolChunk : public PyObject
+{
+public:
+	PyBufferPoolChunk(PyBufferPool *pool, BYTE *p, DWORD size);
+	~PyBufferPoolChunk();
+
+	static void deallocFunc(PyObject *ob);
+	static int getbuffer(PyObject *self, Py_buffer *view, int flags);
+	static PyBufferProcs buffer_procs;
+	static PyTypeObject type;
+
+protected:
+	PyBufferPool *m_pool;
+	BYTE *m_data;
+	DWORD m_size;
+};
+
+#endif // PY_VERSION_HEX
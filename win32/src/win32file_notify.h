@@ -0,0 +1,596 @@
+// win32file_notify.h - decoding of ReadDirectoryChangesW result buffers.
+//
+// The parser works on the raw bytes of a buffer of FILE_NOTIFY_INFORMATION
+// records, reading each header field with memcpy rather than through the
+// struct, and validating every offset against the number of bytes
+// supplied.  It neither allocates nor calls the Windows or Python APIs, so
+// it can be fed arbitrary (eg, fuzzed or synthetic) buffers on any
+// platform.
+//
+// The coalescer is used to drop repeated FILE_ACTION_MODIFIED records for
+// the same path within one buffer.  It only keeps pointers into the buffer
+// being decoded, so the buffer must outlive it.
+//
+// The batcher collects the records from many buffers (and many watched
+// directories) into one coalesced batch, for the DirectoryWatcher.  It owns
+// copies of the names, and is told the time by its caller rather than
+// reading a clock, so recorded traces can be replayed through it.
+//
+// Like the other structs here, all are plain data with explicit Init
+// methods so they can be embedded in Python objects.
+
+#ifndef __WIN32FILE_NOTIFY_H__
+#define __WIN32FILE_NOTIFY_H__
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef FILE_ACTION_MODIFIED
+#define FILE_ACTION_ADDED 0x00000001
+#define FILE_ACTION_REMOVED 0x00000002
+#define FILE_ACTION_MODIFIED 0x00000003
+#define FILE_ACTION_RENAMED_OLD_NAME 0x00000004
+#define FILE_ACTION_RENAMED_NEW_NAME 0x00000005
+#endif
+
+// Pseudo actions reported by the batcher.  RESCAN means events for the
+// directory were lost (eg, the notification buffer overflowed) and the
+// caller should rescan it; STOPPED means the directory can no longer be
+// watched (eg, it was deleted).  Both have an empty name.
+#define PYDIRWATCH_RESCAN 0x1000
+#define PYDIRWATCH_STOPPED 0x1001
+
+// NextEntryOffset, Action and FileNameLength.
+#define PYFILENOTIFY_HEADER_SIZE 12
+
+struct PyFileNotifyRecord
+{
+	unsigned int Action;
+	const void *FileName;		// UTF-16 characters, not terminated.
+	size_t FileNameLength;		// In characters, not bytes.
+};
+
+struct PyFileNotifyParser
+{
+	const unsigned char *buf;
+	size_t nbytes;
+	size_t offset;
+	bool done;
+	const char *error;
+
+	void Init(const void *buffer, size_t size)
+	{
+		buf = (const unsigned char *)buffer;
+		nbytes = size;
+		offset = 0;
+		// A buffer too small for even one record header (including the
+		// empty buffer returned when the system's buffer overflowed)
+		// holds no records.
+		done = size < PYFILENOTIFY_HEADER_SIZE;
+		error = NULL;
+	}
+
+	// Returns 1 and fills *rec with the next record, 0 at the end of the
+	// buffer, or -1 if the buffer is malformed (with the reason in error).
+	// Once the end or an error is reached, it is returned from every
+	// subsequent call.
+	int Next(PyFileNotifyRecord *rec)
+	{
+		if (error)
+			return -1;
+		if (done)
+			return 0;
+		// offset is always a validated record start here, so the header fits.
+		unsigned int next, action, nameLength;
+		const unsigned char *p = buf + offset;
+		memcpy(&next, p, 4);
+		memcpy(&action, p + 4, 4);
+		memcpy(&nameLength, p + 8, 4);
+		size_t avail = nbytes - offset;
+		if (nameLength > avail - PYFILENOTIFY_HEADER_SIZE)
+			return Fail("filename runs off the end of the buffer");
+		if (next == 0)
+			done = true;
+		else {
+			if (next < PYFILENOTIFY_HEADER_SIZE + (size_t)nameLength || next % 4 != 0)
+				return Fail("invalid offset to next entry");
+			if (next > avail - PYFILENOTIFY_HEADER_SIZE)
+				return Fail("running off end of buffer before seeing end-of-buffer marker");
+			offset += next;
+		}
+		rec->Action = action;
+		rec->FileName = p + PYFILENOTIFY_HEADER_SIZE;
+		rec->FileNameLength = nameLength / 2;
+		return 1;
+	}
+
+	int Fail(const char *why)
+	{
+		error = why;
+		return -1;
+	}
+};
+
+// Tracks the paths which have had a FILE_ACTION_MODIFIED record reported
+// since the last other action for the same path.  Names are compared
+// exactly (ie, case-sensitively), so differently cased names for the same
+// file are never merged.
+struct PyFileNotifyCoalescer
+{
+	struct Entry {
+		const void *name;	// NULL for an empty slot
+		size_t nbytes;
+		size_t hash;
+		bool modified;
+	};
+	Entry *table;
+	size_t capacity;	// always a power of 2 (or 0)
+	size_t used;
+
+	void Init()
+	{
+		table = NULL;
+		capacity = used = 0;
+	}
+
+	void Free()
+	{
+		free(table);
+		Init();
+	}
+
+	// Returns false if the record repeats a modification already reported.
+	// If memory runs out, records are simply kept.
+	bool Keep(const PyFileNotifyRecord &rec)
+	{
+		size_t nbytes = rec.FileNameLength * 2;
+		size_t hash = Hash(rec.FileName, nbytes);
+		Entry *e = Find(rec.FileName, nbytes, hash);
+		if (rec.Action != FILE_ACTION_MODIFIED) {
+			if (e && e->name)
+				e->modified = false;
+			return true;
+		}
+		if (e && e->name) {
+			if (e->modified)
+				return false;
+			e->modified = true;
+			return true;
+		}
+		if ((used + 1) * 2 > capacity) {
+			if (!Grow())
+				return true;
+			e = Find(rec.FileName, nbytes, hash);
+		}
+		e->name = rec.FileName;
+		e->nbytes = nbytes;
+		e->hash = hash;
+		e->modified = true;
+		used++;
+		return true;
+	}
+
+	static size_t Hash(const void *p, size_t n)
+	{
+		// FNV-1a
+		const unsigned char *s = (const unsigned char *)p;
+		size_t h = (size_t)2166136261U;
+		for (size_t i = 0; i < n; i++)
+			h = (h ^ s[i]) * (size_t)16777619U;
+		return h;
+	}
+
+	// Returns the entry for the name, or the empty slot where it belongs
+	// (NULL if the table hasn't been allocated).
+	Entry *Find(const void *name, size_t nbytes, size_t hash)
+	{
+		if (capacity == 0)
+			return NULL;
+		size_t mask = capacity - 1;
+		for (size_t i = hash & mask;; i = (i + 1) & mask) {
+			Entry *e = table + i;
+			if (e->name == NULL)
+				return e;
+			if (e->hash == hash && e->nbytes == nbytes && memcmp(e->name, name, nbytes) == 0)
+				return e;
+		}
+	}
+
+	bool Grow()
+	{
+		size_t newCapacity = capacity ? capacity * 2 : 64;
+		Entry *newTable = (Entry *)calloc(newCapacity, sizeof(Entry));
+		if (newTable == NULL)
+			return false;
+		for (size_t i = 0; i < capacity; i++) {
+			Entry *e = table + i;
+			if (e->name == NULL)
+				continue;
+			size_t j = e->hash & (newCapacity - 1);
+			while (newTable[j].name)
+				j = (j + 1) & (newCapacity - 1);
+			newTable[j] = *e;
+		}
+		free(table);
+		table = newTable;
+		capacity = newCapacity;
+		return true;
+	}
+};
+
+struct PyDirWatchEvent
+{
+	int WatchId;
+	unsigned int Action;
+	size_t NameOffset;	// In bytes, into the batcher's name storage.
+	size_t NameLength;	// In characters.
+	bool Live;			// false once cancelled out by a later event.
+};
+
+// Collects events into a batch, applying these rules per (watch, path):
+// * MODIFIED after ADDED or MODIFIED is dropped.
+// * REMOVED after ADDED cancels both; REMOVED after MODIFIED drops the
+//   MODIFIED.
+// * Renames are always kept, and forget what was seen for the name.
+// * Anything else (eg, stream events) is kept as-is.
+// Once a watch needs a rescan, its earlier events in the batch are dropped
+// and so are later ones - the rescan covers them.  If MaxEvents live events
+// are pending, the watch adding the event is switched to a rescan.  Events
+// which have been cancelled out are reclaimed as the batch grows, and the
+// batch is emptied when none are left live.
+//
+// A batch is ready once no event has arrived for Debounce ticks, or
+// MaxDelay ticks after its first event, whichever comes first.
+struct PyDirWatchBatcher
+{
+	unsigned long Debounce;
+	unsigned long MaxDelay;
+	size_t MaxEvents;
+
+	PyDirWatchEvent *events;
+	size_t numEvents, eventsCapacity;
+	size_t numLive;
+	unsigned char *names;
+	size_t namesSize, namesCapacity;
+	unsigned long long firstTime, lastTime;
+
+	// Maps (watch, name) to the index of the last tracked event for it.
+	struct Slot {
+		bool used;
+		int watchId;
+		size_t nameOffset;
+		size_t nameBytes;	// NO_NAME for a watch's rescan marker.
+		size_t hash;
+		size_t index;		// NO_EVENT if nothing is tracked.
+	};
+	Slot *slots;
+	size_t slotsCapacity, slotsUsed;
+
+	enum { NOT_READY = -1 };
+	static const size_t NO_NAME = (size_t)-1;
+	static const size_t NO_EVENT = (size_t)-1;
+
+	void Init(unsigned long debounce, unsigned long maxDelay, size_t maxEvents)
+	{
+		Debounce = debounce;
+		MaxDelay = maxDelay;
+		MaxEvents = maxEvents;
+		events = NULL;
+		numEvents = eventsCapacity = numLive = 0;
+		names = NULL;
+		namesSize = namesCapacity = 0;
+		firstTime = lastTime = 0;
+		slots = NULL;
+		slotsCapacity = slotsUsed = 0;
+	}
+
+	void Free()
+	{
+		free(events);
+		free(names);
+		free(slots);
+		Init(Debounce, MaxDelay, MaxEvents);
+	}
+
+	// Hands the current batch over to *dest (which must not hold one),
+	// leaving this batcher empty.
+	void MoveTo(PyDirWatchBatcher *dest)
+	{
+		*dest = *this;
+		Init(Debounce, MaxDelay, MaxEvents);
+	}
+
+	size_t NumLive() {return numLive;}
+	size_t NumEvents() {return numEvents;}
+	const PyDirWatchEvent *Event(size_t i) {return events + i;}
+	const void *Name(const PyDirWatchEvent *ev) {return names + ev->NameOffset;}
+
+	// Returns the number of ticks until the batch is ready, 0 if it is
+	// ready now, or NOT_READY if there is nothing to deliver.
+	long TimeUntilReady(unsigned long long now)
+	{
+		if (numLive == 0)
+			return NOT_READY;
+		unsigned long long due = lastTime + Debounce;
+		if (firstTime + MaxDelay < due)
+			due = firstTime + MaxDelay;
+		if (now >= due)
+			return 0;
+		unsigned long long wait = due - now;
+		return wait > 0x7fffffff ? 0x7fffffff : (long)wait;
+	}
+
+	// Adds every record from a ReadDirectoryChangesW buffer.  A malformed
+	// buffer is treated as lost events.
+	void AddBuffer(int watchId, const void *buf, size_t nbytes, unsigned long long now)
+	{
+		PyFileNotifyParser parser;
+		PyFileNotifyRecord rec;
+		int rc;
+		parser.Init(buf, nbytes);
+		while ((rc = parser.Next(&rec)) == 1)
+			Add(watchId, rec.Action, rec.FileName, rec.FileNameLength, now);
+		if (rc == -1)
+			Rescan(watchId, now);
+	}
+
+	void Add(int watchId, unsigned int action, const void *name, size_t nameLength, unsigned long long now)
+	{
+		lastTime = now;
+		if (FindLive(watchId, NULL, NO_NAME, Hash(watchId, NULL, NO_NAME)))
+			return;	// a rescan is already pending.
+		size_t nameBytes = nameLength * 2;
+		size_t hash = Hash(watchId, name, nameBytes);
+		switch (action) {
+			case FILE_ACTION_ADDED:
+			case FILE_ACTION_REMOVED:
+			case FILE_ACTION_MODIFIED: {
+				PyDirWatchEvent *prev = FindLive(watchId, name, nameBytes, hash);
+				if (prev) {
+					unsigned int prevAction = prev->Action;
+					if (action == FILE_ACTION_MODIFIED &&
+					    (prevAction == FILE_ACTION_ADDED || prevAction == FILE_ACTION_MODIFIED))
+						return;
+					if (action == FILE_ACTION_REMOVED && prevAction == FILE_ACTION_ADDED) {
+						Kill(prev);
+						return;
+					}
+					if (action == FILE_ACTION_REMOVED && prevAction == FILE_ACTION_MODIFIED)
+						Kill(prev);
+				}
+				size_t index = Append(watchId, action, name, nameLength, now, false);
+				if (index != NO_EVENT && !Track(watchId, events[index].NameOffset, nameBytes, hash, index))
+					Rescan(watchId, now);
+				break;
+			}
+			case FILE_ACTION_RENAMED_OLD_NAME:
+			case FILE_ACTION_RENAMED_NEW_NAME: {
+				Slot *slot = FindSlot(watchId, name, nameBytes, hash);
+				if (slot && slot->used)
+					slot->index = NO_EVENT;
+				Append(watchId, action, name, nameLength, now, false);
+				break;
+			}
+			default:
+				Append(watchId, action, name, nameLength, now, false);
+				break;
+		}
+	}
+
+	// Drops the watch's events and reports a rescan for it instead.
+	void Rescan(int watchId, unsigned long long now)
+	{
+		lastTime = now;
+		size_t hash = Hash(watchId, NULL, NO_NAME);
+		if (FindLive(watchId, NULL, NO_NAME, hash))
+			return;
+		Forget(watchId);
+		size_t index = Append(watchId, PYDIRWATCH_RESCAN, NULL, 0, now, true);
+		if (index != NO_EVENT)
+			Track(watchId, 0, NO_NAME, hash, index);
+	}
+
+	// Reports that the watch has stopped, keeping its earlier events.
+	void Stopped(int watchId, unsigned long long now)
+	{
+		lastTime = now;
+		Append(watchId, PYDIRWATCH_STOPPED, NULL, 0, now, true);
+	}
+
+	// Drops all the watch's events (eg, when it is removed by the caller).
+	void Forget(int watchId)
+	{
+		for (size_t i = 0; i < numEvents; i++)
+			if (events[i].WatchId == watchId && events[i].Live)
+				Kill(events + i);
+	}
+
+	void Kill(PyDirWatchEvent *ev)
+	{
+		ev->Live = false;
+		if (--numLive == 0)
+			Clear();
+	}
+
+	// Empties the batch, keeping the memory allocated.
+	void Clear()
+	{
+		numEvents = namesSize = 0;
+		if (slotsCapacity)
+			memset(slots, 0, slotsCapacity * sizeof(Slot));
+		slotsUsed = 0;
+	}
+
+	// Removes the events which have been cancelled out, then rebuilds the
+	// slots from the live events as Add would have tracked them.
+	void Compact()
+	{
+		size_t n = 0, nameEnd = 0;
+		for (size_t i = 0; i < numEvents; i++) {
+			if (!events[i].Live)
+				continue;
+			PyDirWatchEvent ev = events[i];
+			size_t nameBytes = ev.NameLength * 2;
+			// Live names only ever move towards the start.
+			memmove(names + nameEnd, names + ev.NameOffset, nameBytes);
+			ev.NameOffset = nameEnd;
+			nameEnd += nameBytes;
+			events[n++] = ev;
+		}
+		numEvents = n;
+		namesSize = nameEnd;
+		if (slotsCapacity)
+			memset(slots, 0, slotsCapacity * sizeof(Slot));
+		slotsUsed = 0;
+		for (size_t i = 0; i < numEvents; i++) {
+			PyDirWatchEvent *ev = events + i;
+			size_t nameBytes = ev->NameLength * 2;
+			switch (ev->Action) {
+				case FILE_ACTION_ADDED:
+				case FILE_ACTION_REMOVED:
+				case FILE_ACTION_MODIFIED:
+					Track(ev->WatchId, ev->NameOffset, nameBytes,
+					      Hash(ev->WatchId, names + ev->NameOffset, nameBytes), i);
+					break;
+				case PYDIRWATCH_RESCAN:
+					Track(ev->WatchId, 0, NO_NAME, Hash(ev->WatchId, NULL, NO_NAME), i);
+					break;
+				case FILE_ACTION_RENAMED_OLD_NAME:
+				case FILE_ACTION_RENAMED_NEW_NAME: {
+					Slot *slot = FindSlot(ev->WatchId, names + ev->NameOffset, nameBytes,
+					                      Hash(ev->WatchId, names + ev->NameOffset, nameBytes));
+					if (slot && slot->used)
+						slot->index = NO_EVENT;
+					break;
+				}
+			}
+		}
+	}
+
+	// Returns the new event's index, or NO_EVENT if it couldn't be added
+	// (in which case a rescan has been reported, if possible).
+	size_t Append(int watchId, unsigned int action, const void *name, size_t nameLength,
+	              unsigned long long now, bool force)
+	{
+		if (!force && numLive >= MaxEvents) {
+			Rescan(watchId, now);
+			return NO_EVENT;
+		}
+		// Reclaim cancelled events once they are at least half the batch.
+		if (numEvents >= MaxEvents && (numEvents - numLive) * 2 >= numEvents)
+			Compact();
+		size_t nameBytes = nameLength * 2;
+		if (numEvents == eventsCapacity && !Reserve((void **)&events, &eventsCapacity, numEvents + 1, sizeof(PyDirWatchEvent)))
+			return NO_EVENT;
+		if (namesSize + nameBytes > namesCapacity && !Reserve((void **)&names, &namesCapacity, namesSize + nameBytes, 1))
+			return NO_EVENT;
+		PyDirWatchEvent *ev = events + numEvents;
+		ev->WatchId = watchId;
+		ev->Action = action;
+		ev->NameOffset = namesSize;
+		ev->NameLength = nameLength;
+		ev->Live = true;
+		if (nameBytes)
+			memcpy(names + namesSize, name, nameBytes);
+		namesSize += nameBytes;
+		if (numLive == 0)
+			firstTime = now;
+		numLive++;
+		return numEvents++;
+	}
+
+	static bool Reserve(void **p, size_t *capacity, size_t needed, size_t itemSize)
+	{
+		size_t newCapacity = *capacity ? *capacity : 64;
+		while (newCapacity < needed)
+			newCapacity *= 2;
+		void *n = realloc(*p, newCapacity * itemSize);
+		if (n == NULL)
+			return false;
+		*p = n;
+		*capacity = newCapacity;
+		return true;
+	}
+
+	static size_t Hash(int watchId, const void *name, size_t nameBytes)
+	{
+		size_t h = PyFileNotifyCoalescer::Hash(&watchId, sizeof(watchId));
+		if (nameBytes != NO_NAME) {
+			const unsigned char *s = (const unsigned char *)name;
+			for (size_t i = 0; i < nameBytes; i++)
+				h = (h ^ s[i]) * (size_t)16777619U;
+		}
+		return h;
+	}
+
+	// Returns the slot for the key, or the empty slot where it belongs
+	// (NULL if there are no slots yet).  name is either a caller's pointer
+	// or, when re-inserting, ignored in favour of the stored offset.
+	Slot *FindSlot(int watchId, const void *name, size_t nameBytes, size_t hash)
+	{
+		if (slotsCapacity == 0)
+			return NULL;
+		size_t mask = slotsCapacity - 1;
+		for (size_t i = hash & mask;; i = (i + 1) & mask) {
+			Slot *s = slots + i;
+			if (!s->used)
+				return s;
+			if (s->hash == hash && s->watchId == watchId && s->nameBytes == nameBytes &&
+			    (nameBytes == NO_NAME || memcmp(names + s->nameOffset, name, nameBytes) == 0))
+				return s;
+		}
+	}
+
+	PyDirWatchEvent *FindLive(int watchId, const void *name, size_t nameBytes, size_t hash)
+	{
+		Slot *s = FindSlot(watchId, name, nameBytes, hash);
+		if (s == NULL || !s->used || s->index == NO_EVENT || !events[s->index].Live)
+			return NULL;
+		return events + s->index;
+	}
+
+	bool Track(int watchId, size_t nameOffset, size_t nameBytes, size_t hash, size_t index)
+	{
+		Slot *s = FindSlot(watchId, names + nameOffset, nameBytes, hash);
+		if (s && s->used) {
+			s->index = index;
+			return true;
+		}
+		if ((slotsUsed + 1) * 2 > slotsCapacity) {
+			if (!GrowSlots())
+				return false;
+			s = FindSlot(watchId, names + nameOffset, nameBytes, hash);
+		}
+		s->used = true;
+		s->watchId = watchId;
+		s->nameOffset = nameOffset;
+		s->nameBytes = nameBytes;
+		s->hash = hash;
+		s->index = index;
+		slotsUsed++;
+		return true;
+	}
+
+	bool GrowSlots()
+	{
+		size_t newCapacity = slotsCapacity ? slotsCapacity * 2 : 64;
+		Slot *newSlots = (Slot *)calloc(newCapacity, sizeof(Slot));
+		if (newSlots == NULL)
+			return false;
+		for (size_t i = 0; i < slotsCapacity; i++) {
+			if (!slots[i].used)
+				continue;
+			size_t j = slots[i].hash & (newCapacity - 1);
+			while (newSlots[j].used)
+				j = (j + 1) & (newCapacity - 1);
+			newSlots[j] = slots[i];
+		}
+		free(slots);
+		slots = newSlots;
+		slotsCapacity = newCapacity;
+		return true;
+	}
+};
+
+#endif // __WIN32FILE_NOTIFY_H__
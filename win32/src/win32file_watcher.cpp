@@ -0,0 +1,514 @@
+// A directory watcher which services any number of directories from one
+// IO completion port and a single native thread.
+//
+// @doc
+
+#include "PyWinTypes.h"
+#include "PyWinObjects.h"
+#include "win32file_notify.h"
+#include "win32file_watcher.h"
+#include <process.h>
+
+#define DEFAULT_WATCH_FILTER (FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE)
+
+// One watched directory.  Owned by the watcher's list; only freed once no
+// read is outstanding on it.
+struct PyDirWatch
+{
+	OVERLAPPED overlapped;
+	HANDLE hDir;
+	int id;
+	BOOL bWatchSubtree;
+	DWORD filter;
+	BOOL pending;		// a ReadDirectoryChangesW is outstanding
+	BOOL removed;		// handle closed - free when the read completes
+	BYTE *buf;
+	PyDirWatch *next;
+};
+
+static void FreeDirWatch(PyDirWatch *watch)
+{
+	if (watch->hDir)
+		CloseHandle(watch->hDir);
+	free(watch->buf);
+	free(watch);
+}
+
+// @pymethod <o PyDirectoryWatcher>|win32file|DirectoryWatcher|Creates an object which watches many directories for changes
+// @comm All the directories are serviced by one IO completion port and a single
+// native thread, which re-issues <om win32file.ReadDirectoryChangesW> as each read
+// completes.  Changes are coalesced into batches which are only handed to Python,
+// via <om PyDirectoryWatcher.get>, once the directories have been quiet for the
+// Debounce interval (or MaxDelay has passed since the first change in the batch).
+// <nl>Within a batch, repeated modifications of a path are reported once, a
+// modification after the file was added is not reported, and a file which is
+// added then removed is not reported at all.
+// @comm Accepts keyword args.
+PyObject *PyWinMethod_NewDirectoryWatcher(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	DWORD debounce = 100, maxDelay = 1000, maxEvents = 100000, bufferSize = 65536;
+	static char *keywords[] = {"Debounce", "MaxDelay", "MaxEvents", "BufferSize", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|kkkk:DirectoryWatcher", keywords,
+		&debounce,		// @pyparm int|Debounce|100|Milliseconds without any change before a batch is ready.
+		&maxDelay,		// @pyparm int|MaxDelay|1000|Maximum milliseconds between the first change in a batch and the batch being ready.
+		&maxEvents,		// @pyparm int|MaxEvents|100000|Maximum number of changes held in a batch.  Beyond this, directories
+						// which report more changes are marked as needing a rescan.
+		&bufferSize))	// @pyparm int|BufferSize|65536|Size of the buffer used for each directory.  Note
+						// that network shares fail with buffers larger than 64k.
+		return NULL;
+	if (bufferSize < sizeof(FILE_NOTIFY_INFORMATION) || bufferSize % sizeof(DWORD) != 0)
+		return PyErr_Format(PyExc_ValueError, "BufferSize must be a multiple of 4 of at least %d bytes",
+		                    (int)sizeof(FILE_NOTIFY_INFORMATION));
+	PyDirectoryWatcher *ret = new PyDirectoryWatcher();
+	if (ret==NULL)
+		return PyErr_NoMemory();
+	if (!ret->Init(debounce, maxDelay, maxEvents, bufferSize)){
+		Py_DECREF(ret);
+		return NULL;
+		}
+	return ret;
+}
+
+// @object PyDirectoryWatcher|Watches directories for changes, created by <om win32file.DirectoryWatcher>
+// @comm Each item in a batch is a tuple of (id, action, filename), where id is
+// the value returned by <om PyDirectoryWatcher.add> and action is one of the
+// FILE_ACTION_* values, or one of:
+// @flagh Action|Meaning
+// @flag DIRECTORY_WATCHER_RESCAN|Changes to the directory were lost (eg, the
+//	buffer overflowed), so it should be rescanned.  Other changes for the
+//	directory in the same batch are not reported.  filename is None.
+// @flag DIRECTORY_WATCHER_STOPPED|The directory can no longer be watched (eg, it
+//	was deleted), and has been removed from the watcher.  filename is None.
+PyDirectoryWatcher::PyDirectoryWatcher(void)
+{
+	ob_type = &type;
+	_Py_NewReference(this);
+	m_port = m_thread = m_ready = NULL;
+	m_csInitialized = FALSE;
+	m_closing = FALSE;
+	m_watches = NULL;
+	m_nextId = 1;
+	m_bufferSize = 0;
+	m_lastTick = 0;
+	m_tickBase = 0;
+	m_batcher.Init(0, 0, 0);
+}
+
+PyDirectoryWatcher::~PyDirectoryWatcher(void)
+{
+	Close();
+	m_batcher.Free();
+	if (m_port)
+		CloseHandle(m_port);
+	if (m_ready)
+		CloseHandle(m_ready);
+	if (m_csInitialized)
+		DeleteCriticalSection(&m_cs);
+}
+
+BOOL PyDirectoryWatcher::Init(DWORD debounce, DWORD maxDelay, DWORD maxEvents, DWORD bufferSize)
+{
+	InitializeCriticalSection(&m_cs);
+	m_csInitialized = TRUE;
+	m_bufferSize = bufferSize;
+	m_batcher.Init(debounce, maxDelay, maxEvents);
+	m_lastTick = GetTickCount();
+	m_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+	if (m_port==NULL){
+		PyWin_SetAPIError("CreateIoCompletionPort");
+		return FALSE;
+		}
+	m_ready = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (m_ready==NULL){
+		PyWin_SetAPIError("CreateEvent");
+		return FALSE;
+		}
+	m_thread = (HANDLE)_beginthreadex(NULL, 0, ThreadProc, this, 0, NULL);
+	if (m_thread==NULL){
+		PyErr_SetFromErrno(PyExc_RuntimeError);
+		return FALSE;
+		}
+	return TRUE;
+}
+
+// Stops watching all directories and waits for the thread to finish.
+void PyDirectoryWatcher::Close(void)
+{
+	if (!m_csInitialized)
+		return;
+	// Only the first caller gets the thread, and waits for it.
+	EnterCriticalSection(&m_cs);
+	HANDLE thread = m_thread;
+	m_thread = NULL;
+	if (thread==NULL){
+		LeaveCriticalSection(&m_cs);
+		return;
+		}
+	m_closing = TRUE;
+	PyDirWatch *watch = m_watches;
+	while (watch){
+		PyDirWatch *next = watch->next;
+		watch->removed = TRUE;
+		if (watch->hDir){
+			CloseHandle(watch->hDir);
+			watch->hDir = NULL;
+			}
+		if (!watch->pending){
+			Unlink(watch);
+			FreeDirWatch(watch);
+			}
+		watch = next;
+		}
+	LeaveCriticalSection(&m_cs);
+	// The thread exits once the closed handles' reads have completed.
+	PostQueuedCompletionStatus(m_port, 0, 0, NULL);
+	Py_BEGIN_ALLOW_THREADS
+	WaitForSingleObject(thread, INFINITE);
+	Py_END_ALLOW_THREADS
+	CloseHandle(thread);
+	SetEvent(m_ready);	// wake anyone still waiting in get()
+}
+
+BOOL PyDirectoryWatcher::CheckOpen(void)
+{
+	if (m_closing){
+		PyErr_SetString(PyExc_ValueError, "The DirectoryWatcher has been closed");
+		return FALSE;
+		}
+	return TRUE;
+}
+
+// Must be called with the lock held.
+unsigned PY_LONG_LONG PyDirectoryWatcher::Now(void)
+{
+	DWORD tick = GetTickCount();
+	if (tick < m_lastTick)
+		m_tickBase += (unsigned PY_LONG_LONG)1 << 32;
+	m_lastTick = tick;
+	return m_tickBase + tick;
+}
+
+// Must be called with the lock held.
+BOOL PyDirectoryWatcher::Arm(PyDirWatch *watch)
+{
+	memset(&watch->overlapped, 0, sizeof(watch->overlapped));
+	watch->pending = ReadDirectoryChangesW(watch->hDir, watch->buf, m_bufferSize,
+		watch->bWatchSubtree, watch->filter, NULL, &watch->overlapped, NULL);
+	return watch->pending;
+}
+
+// Must be called with the lock held.
+void PyDirectoryWatcher::Unlink(PyDirWatch *watch)
+{
+	PyDirWatch **pp = &m_watches;
+	while (*pp && *pp != watch)
+		pp = &(*pp)->next;
+	if (*pp)
+		*pp = watch->next;
+}
+
+unsigned __stdcall PyDirectoryWatcher::ThreadProc(void *param)
+{
+	((PyDirectoryWatcher *)param)->Run();
+	return 0;
+}
+
+void PyDirectoryWatcher::Run(void)
+{
+	for (;;){
+		DWORD timeout = INFINITE;
+		EnterCriticalSection(&m_cs);
+		if (m_closing && m_watches==NULL){
+			LeaveCriticalSection(&m_cs);
+			break;
+			}
+		long wait = m_batcher.TimeUntilReady(Now());
+		if (wait==0)
+			SetEvent(m_ready);
+		else if (wait > 0)
+			timeout = (DWORD)wait;
+		LeaveCriticalSection(&m_cs);
+
+		DWORD bytes = 0;
+		ULONG_PTR key;
+		OVERLAPPED *pOverlapped = NULL;
+		BOOL ok = GetQueuedCompletionStatus(m_port, &bytes, &key, &pOverlapped, timeout);
+		DWORD err = ok ? 0 : GetLastError();
+		if (pOverlapped==NULL){
+			if (!ok && err!=WAIT_TIMEOUT)
+				break;	// the port itself failed - nothing more we can do.
+			continue;	// time to check the batch, or a wake-up from Close.
+			}
+
+		PyDirWatch *watch = CONTAINING_RECORD(pOverlapped, PyDirWatch, overlapped);
+		EnterCriticalSection(&m_cs);
+		watch->pending = FALSE;
+		unsigned PY_LONG_LONG now = Now();
+		BOOL stop = FALSE;
+		if (watch->removed)
+			;
+		else if ((!ok && err==ERROR_NOTIFY_ENUM_DIR) || (ok && bytes==0)){
+			// The system's buffer overflowed.
+			m_batcher.Rescan(watch->id, now);
+			stop = !Arm(watch);
+			}
+		else if (!ok && err==ERROR_OPERATION_ABORTED){
+			// On XP, IO is cancelled when the thread which issued it (ie,
+			// the one which called add()) exits - just issue it again.
+			stop = !Arm(watch);
+			}
+		else if (!ok)
+			stop = TRUE;
+		else{
+			m_batcher.AddBuffer(watch->id, watch->buf, bytes, now);
+			stop = !Arm(watch);
+			}
+		if (stop)
+			m_batcher.Stopped(watch->id, now);
+		if (stop || watch->removed){
+			Unlink(watch);
+			FreeDirWatch(watch);
+			}
+		LeaveCriticalSection(&m_cs);
+	}
+}
+
+// @pymethod int|PyDirectoryWatcher|add|Starts watching a directory
+// @rdesc Returns an integer id which identifies the directory in the batches
+// returned by <om PyDirectoryWatcher.get>.
+// @comm Accepts keyword args.
+PyObject *PyDirectoryWatcher::add(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyDirectoryWatcher *watcher = (PyDirectoryWatcher *)self;
+	PyObject *obpath;
+	BOOL bWatchSubtree = TRUE;
+	DWORD filter = DEFAULT_WATCH_FILTER;
+	static char *keywords[] = {"Path", "WatchSubtree", "Filter", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ik:add", keywords,
+		&obpath,			// @pyparm <o PyUnicode>|Path||The directory to watch.
+		&bWatchSubtree,		// @pyparm bool|WatchSubtree|True|Whether to watch the whole tree below the directory.
+		&filter))			// @pyparm int|Filter|FILE_NOTIFY_CHANGE_FILE_NAME\|FILE_NOTIFY_CHANGE_DIR_NAME\|FILE_NOTIFY_CHANGE_LAST_WRITE|Combination of
+							// FILE_NOTIFY_CHANGE_* flags specifying the changes to report.
+		return NULL;
+	if (!watcher->CheckOpen())
+		return NULL;
+	WCHAR *path;
+	if (!PyWinObject_AsWCHAR(obpath, &path, FALSE))
+		return NULL;
+	HANDLE hDir;
+	Py_BEGIN_ALLOW_THREADS
+	hDir = CreateFileW(path, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+	Py_END_ALLOW_THREADS
+	PyWinObject_FreeWCHAR(path);
+	if (hDir==INVALID_HANDLE_VALUE)
+		return PyWin_SetAPIError("CreateFile");
+
+	PyDirWatch *watch = (PyDirWatch *)malloc(sizeof(PyDirWatch));
+	if (watch==NULL){
+		CloseHandle(hDir);
+		return PyErr_NoMemory();
+		}
+	memset(watch, 0, sizeof(PyDirWatch));
+	watch->hDir = hDir;
+	watch->bWatchSubtree = bWatchSubtree;
+	watch->filter = filter;
+	watch->buf = (BYTE *)malloc(watcher->m_bufferSize);
+	if (watch->buf==NULL){
+		FreeDirWatch(watch);
+		return PyErr_NoMemory();
+		}
+	if (CreateIoCompletionPort(hDir, watcher->m_port, 0, 0)==NULL){
+		PyWin_SetAPIError("CreateIoCompletionPort");
+		FreeDirWatch(watch);
+		return NULL;
+		}
+
+	EnterCriticalSection(&watcher->m_cs);
+	watch->id = watcher->m_nextId++;
+	if (!watcher->Arm(watch)){
+		DWORD err = GetLastError();
+		LeaveCriticalSection(&watcher->m_cs);
+		FreeDirWatch(watch);
+		return PyWin_SetAPIError("ReadDirectoryChangesW", err);
+		}
+	watch->next = watcher->m_watches;
+	watcher->m_watches = watch;
+	LeaveCriticalSection(&watcher->m_cs);
+	return PyInt_FromLong(watch->id);
+}
+
+// @pymethod |PyDirectoryWatcher|remove|Stops watching a directory
+// @comm Any changes for the directory not yet returned by <om PyDirectoryWatcher.get> are discarded.
+PyObject *PyDirectoryWatcher::remove(PyObject *self, PyObject *args)
+{
+	PyDirectoryWatcher *watcher = (PyDirectoryWatcher *)self;
+	int id;
+	// @pyparm int|id||The id returned by <om PyDirectoryWatcher.add>
+	if (!PyArg_ParseTuple(args, "i:remove", &id))
+		return NULL;
+	if (!watcher->CheckOpen())
+		return NULL;
+	EnterCriticalSection(&watcher->m_cs);
+	PyDirWatch *watch = watcher->m_watches;
+	while (watch && (watch->id != id || watch->removed))
+		watch = watch->next;
+	if (watch){
+		watch->removed = TRUE;
+		CloseHandle(watch->hDir);	// completes the outstanding read.
+		watch->hDir = NULL;
+		if (!watch->pending){
+			watcher->Unlink(watch);
+			FreeDirWatch(watch);
+			}
+		watcher->m_batcher.Forget(id);
+		}
+	LeaveCriticalSection(&watcher->m_cs);
+	if (watch==NULL)
+		return PyErr_Format(PyExc_ValueError, "No directory is being watched with id %d", id);
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+// @pymethod [(int, int, <o PyUnicode>), ...]|PyDirectoryWatcher|get|Waits for a batch of changes
+// @rdesc Returns a list of (id, action, filename) tuples, or None if the
+// timeout expired first.  Filenames are relative to the watched directory.
+PyObject *PyDirectoryWatcher::get(PyObject *self, PyObject *args)
+{
+	PyDirectoryWatcher *watcher = (PyDirectoryWatcher *)self;
+	DWORD timeout = INFINITE;
+	// @pyparm int|timeout|INFINITE|Milliseconds to wait for a batch to be ready.
+	if (!PyArg_ParseTuple(args, "|k:get", &timeout))
+		return NULL;
+	DWORD start = GetTickCount();
+	PyDirWatchBatcher batch;
+	for (;;){
+		if (!watcher->CheckOpen())
+			return NULL;
+		EnterCriticalSection(&watcher->m_cs);
+		BOOL ready = watcher->m_batcher.TimeUntilReady(watcher->Now())==0;
+		if (ready)
+			watcher->m_batcher.MoveTo(&batch);
+		// The thread sets the event (with the lock held) when it sees a batch is ready.
+		ResetEvent(watcher->m_ready);
+		LeaveCriticalSection(&watcher->m_cs);
+		if (ready)
+			break;
+		DWORD wait = timeout;
+		if (timeout != INFINITE){
+			DWORD elapsed = GetTickCount() - start;
+			if (elapsed >= timeout){
+				Py_INCREF(Py_None);
+				return Py_None;
+				}
+			wait = timeout - elapsed;
+			}
+		DWORD rc;
+		Py_BEGIN_ALLOW_THREADS
+		rc = WaitForSingleObject(watcher->m_ready, wait);
+		Py_END_ALLOW_THREADS
+		if (rc==WAIT_FAILED)
+			return PyWin_SetAPIError("WaitForSingleObject");
+	}
+
+	PyObject *ret = PyList_New(batch.NumLive());
+	Py_ssize_t i = 0;
+	for (size_t n = 0; ret && n < batch.NumEvents(); n++){
+		const PyDirWatchEvent *ev = batch.Event(n);
+		if (!ev->Live)
+			continue;
+		PyObject *item;
+		if (ev->Action==PYDIRWATCH_RESCAN || ev->Action==PYDIRWATCH_STOPPED)
+			item = Py_BuildValue("iiO", ev->WatchId, ev->Action, Py_None);
+		else
+			item = Py_BuildValue("iiN", ev->WatchId, ev->Action,
+				PyWinObject_FromOLECHAR((const OLECHAR *)batch.Name(ev), (int)ev->NameLength));
+		if (item==NULL){
+			Py_DECREF(ret);
+			ret = NULL;
+			break;
+			}
+		PyList_SET_ITEM(ret, i++, item);
+	}
+	batch.Free();
+	return ret;
+}
+
+// @pymethod |PyDirectoryWatcher|close|Stops watching all directories
+// @comm This is done automatically when the object is destroyed.  Any thread
+// waiting in <om PyDirectoryWatcher.get> raises ValueError.
+PyObject *PyDirectoryWatcher::close(PyObject *self, PyObject *args)
+{
+	if (!PyArg_ParseTuple(args, ":close"))
+		return NULL;
+	((PyDirectoryWatcher *)self)->Close();
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+PyObject *PyDirectoryWatcher::get_handle(PyObject *self, void *unused)
+{
+	return PyWinLong_FromHANDLE(((PyDirectoryWatcher *)self)->m_ready);
+}
+
+/*static*/ void PyDirectoryWatcher::deallocFunc(PyObject *ob)
+{
+	delete (PyDirectoryWatcher *)ob;
+}
+
+/*static*/ struct PyMethodDef PyDirectoryWatcher::methods[] = {
+	{"add", (PyCFunction)PyDirectoryWatcher::add, METH_VARARGS | METH_KEYWORDS},	// @pymeth add|Starts watching a directory
+	{"remove", PyDirectoryWatcher::remove, METH_VARARGS},	// @pymeth remove|Stops watching a directory
+	{"get", PyDirectoryWatcher::get, METH_VARARGS},			// @pymeth get|Waits for a batch of changes
+	{"close", PyDirectoryWatcher::close, METH_VARARGS},		// @pymeth close|Stops watching all directories
+	{NULL}
+};
+
+/*static*/ struct PyGetSetDef PyDirectoryWatcher::getset[] = {
+	// @prop int|handle|An event handle which is signalled while a batch is ready, for
+	// use with the win32event wait functions.  The handle is owned by the watcher, so must not be closed.
+	{"handle", PyDirectoryWatcher::get_handle, NULL, "An event which is signalled while a batch is ready"},
+	{NULL}
+};
+
+PyTypeObject PyDirectoryWatcher::type =
+{
+	PYWIN_OBJECT_HEAD
+	"PyDirectoryWatcher",
+	sizeof(PyDirectoryWatcher),
+	0,
+	PyDirectoryWatcher::deallocFunc,	/* tp_dealloc */
+	0,						/* tp_print */
+	0,						/* tp_getattr */
+	0,						/* tp_setattr */
+	0,						/* tp_compare */
+	0,						/* tp_repr */
+	0,						/* tp_as_number */
+	0,						/* tp_as_sequence */
+	0,						/* tp_as_mapping */
+	0,						/* tp_hash */
+	0,						/* tp_call */
+	0,						/* tp_str */
+	PyObject_GenericGetAttr,	/* tp_getattro */
+	0,						/* tp_setattro */
+	0,						/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,		/* tp_flags */
+	"Watches directories for changes",	/* tp_doc */
+	0,						/* tp_traverse */
+	0,						/* tp_clear */
+	0,						/* tp_richcompare */
+	0,						/* tp_weaklistoffset */
+	0,						/* tp_iter */
+	0,						/* tp_iternext */
+	PyDirectoryWatcher::methods,	/* tp_methods */
+	0,						/* tp_members */
+	PyDirectoryWatcher::getset,	/* tp_getset */
+	0,						/* tp_base */
+	0,						/* tp_dict */
+	0,						/* tp_descr_get */
+	0,						/* tp_descr_set */
+	0,						/* tp_dictoffset */
+	0,						/* tp_init */
+	0,						/* tp_alloc */
+	0,						/* tp_new */
+};
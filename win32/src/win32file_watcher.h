@@ -0,0 +1,54 @@
+// A directory watcher which services any number of directories from one
+// IO completion port and a single native thread.
+//
+// The native thread re-issues ReadDirectoryChangesW as each read completes
+// and feeds the results into a PyDirWatchBatcher (see win32file_notify.h).
+// Python is only involved when it asks for a batch which is ready.
+
+extern PyObject *PyWinMethod_NewDirectoryWatcher(PyObject *self, PyObject *args, PyObject *kwargs);
+
+struct PyDirWatch;
+
+class PyDirectoryWatcher : public PyObject
+{
+public:
+	PyDirectoryWatcher(void);
+	~PyDirectoryWatcher();
+	BOOL Init(DWORD debounce, DWORD maxDelay, DWORD maxEvents, DWORD bufferSize);
+	void Close(void);
+
+	/* Python support */
+	static void deallocFunc(PyObject *ob);
+	static PyObject *add(PyObject *self, PyObject *args, PyObject *kwargs);
+	static PyObject *remove(PyObject *self, PyObject *args);
+	static PyObject *get(PyObject *self, PyObject *args);
+	static PyObject *close(PyObject *self, PyObject *args);
+	static PyObject *get_handle(PyObject *self, void *unused);
+	static struct PyMethodDef methods[];
+	static struct PyGetSetDef getset[];
+	static PyTypeObject type;
+
+protected:
+	static unsigned __stdcall ThreadProc(void *param);
+	void Run(void);
+	BOOL Arm(PyDirWatch *watch);
+	void Unlink(PyDirWatch *watch);
+	void Signal(void);
+	unsigned PY_LONG_LONG Now(void);
+	BOOL CheckOpen(void);
+
+	HANDLE m_port;
+	HANDLE m_thread;
+	HANDLE m_ready;				// manual reset, set while a batch is ready
+	CRITICAL_SECTION m_cs;		// guards everything below
+	BOOL m_csInitialized;
+	BOOL m_closing;
+	PyDirWatch *m_watches;
+	int m_nextId;
+	DWORD m_bufferSize;
+	DWORD m_lastTick;
+	unsigned PY_LONG_LONG m_tickBase;
+	PyDirWatchBatcher m_batcher;
+};
+
+#define PyDirectoryWatcher_Check(x) ((x)->ob_type==&PyDirectoryWatcher::type)
@@ -14,6 +14,8 @@ generates Windows .hlp files.
 #include "PyWinTypes.h"
 #include "pdh.h"
 #include "pdhmsg.h"
+#include "PyWinStringCache.h"
+#include <process.h>
 
 /*
 According to MSDN, Pdh calls are thread safe, although there was a bug
@@ -157,6 +159,21 @@ typedef PDH_STATUS (WINAPI *FuncPdhLookupPerfNameByIndex) (
   LPDWORD pcchBuffer
 );
 
+typedef PDH_STATUS (WINAPI *FuncPdhGetFormattedCounterArray) (
+  HCOUNTER hCounter,
+  DWORD dwFormat,
+  LPDWORD lpdwBufferSize,
+  LPDWORD lpdwItemCount,
+  PPDH_FMT_COUNTERVALUE_ITEM ItemBuffer
+);
+
+typedef PDH_STATUS (WINAPI *FuncPdhGetRawCounterArray) (
+  HCOUNTER hCounter,
+  LPDWORD lpdwBufferSize,
+  LPDWORD lpdwItemCount,
+  PPDH_RAW_COUNTER_ITEM ItemBuffer
+);
+
 #define CHECK_PDH_PTR(ptr) if((ptr)==NULL) { PyErr_Format(PyExc_RuntimeError, "The pdh.dll entry point function %s could not be loaded.", #ptr); return NULL;}
 
 // The function pointers
@@ -181,6 +198,8 @@ FuncPdhBrowseCounters pPdhBrowseCounters = NULL;
 FuncPdhConnectMachine pPdhConnectMachine = NULL;
 FuncPdhLookupPerfIndexByName pPdhLookupPerfIndexByName = NULL;
 FuncPdhLookupPerfNameByIndex pPdhLookupPerfNameByIndex = NULL;
+FuncPdhGetFormattedCounterArray pPdhGetFormattedCounterArray = NULL;
+FuncPdhGetRawCounterArray pPdhGetRawCounterArray = NULL;
 
 // TCHAR that frees itself
 class TmpTCHAR
@@ -237,6 +256,8 @@ BOOL LoadPointers()
 	pPdhConnectMachine = (FuncPdhConnectMachine)GetProcAddress(handle, "PdhConnectMachine" A_OR_W);
 	pPdhLookupPerfNameByIndex = (FuncPdhLookupPerfNameByIndex)GetProcAddress(handle, "PdhLookupPerfNameByIndex" A_OR_W);
 	pPdhLookupPerfIndexByName = (FuncPdhLookupPerfIndexByName)GetProcAddress(handle, "PdhLookupPerfIndexByName" A_OR_W);
+	pPdhGetFormattedCounterArray = (FuncPdhGetFormattedCounterArray)GetProcAddress(handle, "PdhGetFormattedCounterArray" A_OR_W);
+	pPdhGetRawCounterArray = (FuncPdhGetRawCounterArray)GetProcAddress(handle, "PdhGetRawCounterArray" A_OR_W);
 
 	// Pdh error codes are in 2 different ranges
 	PyWin_RegisterErrorMessageModule(PDH_CSTATUS_NO_MACHINE, PDH_CANNOT_SET_DEFAULT_REALTIME_DATASOURCE, handle);
@@ -254,6 +275,27 @@ BOOL CheckCounterStatusOK( DWORD status )
 	return FALSE;
 }
 
+PyObject *PyWinObject_FromPDH_FMT_COUNTERVALUE(const PDH_FMT_COUNTERVALUE *value, DWORD format)
+{
+	if (format & PDH_FMT_DOUBLE)
+		return PyFloat_FromDouble(value->doubleValue);
+	if (format & PDH_FMT_LONG)
+		return PyInt_FromLong(value->longValue);
+	if (format & PDH_FMT_LARGE)
+		return PyLong_FromLongLong(value->largeValue);
+	PyErr_SetString(PyExc_ValueError, "Dont know how to convert the result");
+	return NULL;
+}
+
+// Checks up front that values in a format can be converted.
+BOOL CheckFormatOK( DWORD format )
+{
+	if (format & (PDH_FMT_DOUBLE | PDH_FMT_LONG | PDH_FMT_LARGE))
+		return TRUE;
+	PyErr_SetString(PyExc_ValueError, "The format must include one of PDH_FMT_DOUBLE, PDH_FMT_LONG or PDH_FMT_LARGE");
+	return FALSE;
+}
+
 // @pymethod tuple|win32pdh|EnumObjectItems|Enumerates an object's items
 static PyObject *PyEnumObjectItems(PyObject *self, PyObject *args)
 {
@@ -728,17 +770,7 @@ static PyObject *PyGetFormattedCounterValue(PyObject *self, PyObject *args)
 	if (!CheckCounterStatusOK(result.CStatus))
 		return NULL;
 
-	PyObject *rc;
-	if (format & PDH_FMT_DOUBLE)
-		rc = PyFloat_FromDouble(result.doubleValue);
-	else if (format & PDH_FMT_LONG)
-		rc = PyInt_FromLong(result.longValue);
-	else if (format & PDH_FMT_LARGE)
-		rc = PyLong_FromLongLong(result.largeValue);
-	else {
-		PyErr_SetString(PyExc_ValueError, "Dont know how to convert the result");
-		rc = NULL;
-	}
+	PyObject *rc = PyWinObject_FromPDH_FMT_COUNTERVALUE(&result, format);
 	PyObject *realrc = Py_BuildValue("iO", type, rc);
 	Py_XDECREF(rc);
 	return realrc;
@@ -766,6 +798,378 @@ static PyObject *PyCollectQueryData(PyObject *self, PyObject *args)
 	return Py_None;
 }
 
+// The items returned by PdhGetFormattedCounterArray for one counter.  The
+// buffer holds the items followed by the instance names they point to, and
+// is kept to be reused by the next call.
+struct PdhCounterArray
+{
+	BYTE *buf;
+	DWORD bufSize;
+	DWORD count;
+	PDH_STATUS status;
+};
+
+// Fills a counter array with the counter's current values, growing its
+// buffer as needed.  Called without the GIL.
+static PDH_STATUS FillCounterArray(PdhCounterArray *arr, HCOUNTER hCounter, DWORD format)
+{
+	// Instances can come and go between calls, so the size needed may
+	// already have changed by the time the buffer is grown.
+	for (int tries = 0; tries < 4; tries++){
+		DWORD size = arr->bufSize, count = 0;
+		arr->status = (*pPdhGetFormattedCounterArray)(hCounter, format, &size, &count,
+			(PPDH_FMT_COUNTERVALUE_ITEM)arr->buf);
+		arr->count = arr->status==ERROR_SUCCESS ? count : 0;
+		if (arr->status != PDH_MORE_DATA && arr->status != PDH_INSUFFICIENT_BUFFER)
+			break;
+		if (size <= arr->bufSize)
+			size = arr->bufSize * 2;
+		BYTE *buf = (BYTE *)realloc(arr->buf, size);
+		if (buf==NULL){
+			arr->status = PDH_MEMORY_ALLOCATION_FAILURE;
+			break;
+			}
+		arr->buf = buf;
+		arr->bufSize = size;
+		}
+	return arr->status;
+}
+
+static void FreeCounterArrays(PdhCounterArray *arrs, DWORD num)
+{
+	if (arrs==NULL)
+		return;
+	for (DWORD i=0; i<num; i++)
+		free(arrs[i].buf);
+	free(arrs);
+}
+
+// Instance names are repeated in every snapshot, so the objects made for
+// them are shared through a cache.  Only used with the GIL held.
+static PyWinStringCache instanceNameCache = {NULL, 0, 0, 0, 0, 0};
+
+// The names of the instances last returned for a counter.
+struct PdhInstanceNames
+{
+	PyObject *names;	// a tuple
+	WCHAR *chars;		// the same names, each null terminated
+	size_t numChars;
+};
+
+static void FreeInstanceNames(PdhInstanceNames *names)
+{
+	Py_XDECREF(names->names);
+	free(names->chars);
+	names->names = NULL;
+	names->chars = NULL;
+	names->numChars = 0;
+}
+
+// Returns a tuple of the instance names in a counter array.  If prev is
+// not NULL and the names are the same as last time, the same tuple is
+// returned.
+static PyObject *PyWinObject_FromCounterArrayNames(const PdhCounterArray *arr, PdhInstanceNames *prev)
+{
+	// The module is always built as unicode.
+	const PDH_FMT_COUNTERVALUE_ITEM *items = (const PDH_FMT_COUNTERVALUE_ITEM *)arr->buf;
+	if (arr->count==0)
+		return PyTuple_New(0);
+	size_t numChars = 0;
+	DWORD i;
+	for (i=0; i<arr->count; i++)
+		numChars += wcslen(items[i].szName) + 1;
+	if (prev && prev->names && PyTuple_GET_SIZE(prev->names)==(Py_ssize_t)arr->count
+	    && prev->numChars==numChars){
+		const WCHAR *p = prev->chars;
+		for (i=0; i<arr->count; i++){
+			size_t len = wcslen(items[i].szName) + 1;
+			if (memcmp(p, items[i].szName, len * sizeof(WCHAR)) != 0)
+				break;
+			p += len;
+			}
+		if (i==arr->count){
+			Py_INCREF(prev->names);
+			return prev->names;
+			}
+		}
+	PyObject *ret = PyTuple_New(arr->count);
+	if (ret==NULL)
+		return NULL;
+	for (i=0; i<arr->count; i++){
+		PyObject *name = PyWinStringCache_Get(&instanceNameCache, (const PyWinUTF16 *)items[i].szName,
+			wcslen(items[i].szName));
+		if (name==NULL){
+			Py_DECREF(ret);
+			return NULL;
+			}
+		PyTuple_SET_ITEM(ret, i, name);
+		}
+	if (prev){
+		// Not being able to remember the names is not an error.
+		WCHAR *chars = (WCHAR *)malloc(numChars * sizeof(WCHAR));
+		if (chars){
+			WCHAR *p = chars;
+			for (i=0; i<arr->count; i++){
+				size_t len = wcslen(items[i].szName) + 1;
+				memcpy(p, items[i].szName, len * sizeof(WCHAR));
+				p += len;
+				}
+			FreeInstanceNames(prev);
+			prev->chars = chars;
+			prev->numChars = numChars;
+			prev->names = ret;
+			Py_INCREF(ret);
+			}
+		}
+	return ret;
+}
+
+// Returns a tuple of the values in a counter array.  Values whose status
+// is not valid are None.
+static PyObject *PyWinObject_FromCounterArrayValues(const PdhCounterArray *arr, DWORD format)
+{
+	const PDH_FMT_COUNTERVALUE_ITEM *items = (const PDH_FMT_COUNTERVALUE_ITEM *)arr->buf;
+	PyObject *ret = PyTuple_New(arr->count);
+	if (ret==NULL)
+		return NULL;
+	for (DWORD i=0; i<arr->count; i++){
+		PyObject *value;
+		if (items[i].FmtValue.CStatus==PDH_CSTATUS_VALID_DATA || items[i].FmtValue.CStatus==PDH_CSTATUS_NEW_DATA)
+			value = PyWinObject_FromPDH_FMT_COUNTERVALUE(&items[i].FmtValue, format);
+		else{
+			Py_INCREF(Py_None);
+			value = Py_None;
+			}
+		if (value==NULL){
+			Py_DECREF(ret);
+			return NULL;
+			}
+		PyTuple_SET_ITEM(ret, i, value);
+		}
+	return ret;
+}
+
+// Returns (names, values) for a counter array, or None if the counter could
+// not be read.
+static PyObject *PyWinObject_FromCounterArray(const PdhCounterArray *arr, DWORD format, PdhInstanceNames *prev)
+{
+	if (arr->status != ERROR_SUCCESS){
+		Py_INCREF(Py_None);
+		return Py_None;
+		}
+	PyObject *names = PyWinObject_FromCounterArrayNames(arr, prev);
+	if (names==NULL)
+		return NULL;
+	return Py_BuildValue("NN", names, PyWinObject_FromCounterArrayValues(arr, format));
+}
+
+// Collects a query, then reads every counter's array.  Called without the GIL.
+static PDH_STATUS CollectCounterArrays(HQUERY hQuery, const HCOUNTER *counters, DWORD numCounters,
+	DWORD format, PdhCounterArray *arrs)
+{
+	PDH_STATUS pdhStatus = (*pPdhCollectQueryData)(hQuery);
+	for (DWORD i=0; i<numCounters; i++){
+		if (pdhStatus==ERROR_SUCCESS)
+			FillCounterArray(&arrs[i], counters[i], format);
+		else{
+			arrs[i].status = pdhStatus;
+			arrs[i].count = 0;
+			}
+		}
+	return pdhStatus;
+}
+
+// Converts a sequence of counter handles into an array, which the caller must free.
+static BOOL PyWinObject_AsCounterHandles(PyObject *obCounters, HCOUNTER **pcounters, DWORD *pnum)
+{
+	PyObject *seq = PySequence_Fast(obCounters, "Counters must be a sequence of counter handles");
+	if (seq==NULL)
+		return FALSE;
+	DWORD num = (DWORD)PySequence_Fast_GET_SIZE(seq);
+	HCOUNTER *counters = (HCOUNTER *)malloc((num ? num : 1) * sizeof(HCOUNTER));
+	if (counters==NULL){
+		Py_DECREF(seq);
+		PyErr_NoMemory();
+		return FALSE;
+		}
+	for (DWORD i=0; i<num; i++){
+		if (!PyWinObject_AsHANDLE(PySequence_Fast_GET_ITEM(seq, i), &counters[i])){
+			free(counters);
+			Py_DECREF(seq);
+			return FALSE;
+			}
+		}
+	Py_DECREF(seq);
+	*pcounters = counters;
+	*pnum = num;
+	return TRUE;
+}
+
+// @pymethod [(str, object), ...]|win32pdh|GetFormattedCounterArray|Retrieves the formatted values of every instance of a counter
+// @rdesc Returns a list of (instanceName, value) tuples.  The value of an
+// instance whose data is not valid is None.
+// @comm The counter is usually one with a wildcard instance, eg
+// "\Process(*)\% Processor Time".  The names of the instances are not unique -
+// several processes may have the same name.
+static PyObject *PyGetFormattedCounterArray(PyObject *self, PyObject *args)
+{
+	HCOUNTER handle;
+	PyObject *obhandle;
+	DWORD format;
+	if (!PyArg_ParseTuple(args, "Ok:GetFormattedCounterArray",
+			&obhandle, // @pyparm int|handle||Handle to the counter
+			&format)) // @pyparm int|format||Format of result.  Can be PDH_FMT_DOUBLE, PDH_FMT_LARGE, PDH_FMT_LONG and or'd with PDH_FMT_NOSCALE, PDH_FMT_1000
+		return NULL;
+	if (!PyWinObject_AsHANDLE(obhandle, &handle))
+		return NULL;
+	if (!CheckFormatOK(format))
+		return NULL;
+	CHECK_PDH_PTR(pPdhGetFormattedCounterArray);
+	PdhCounterArray arr = {NULL, 0, 0, ERROR_SUCCESS};
+	Py_BEGIN_ALLOW_THREADS
+	FillCounterArray(&arr, handle, format);
+	Py_END_ALLOW_THREADS
+	if (arr.status != ERROR_SUCCESS){
+		free(arr.buf);
+		return PyWin_SetAPIError("GetFormattedCounterArray", arr.status);
+		}
+	PyObject *names = PyWinObject_FromCounterArrayNames(&arr, NULL);
+	PyObject *values = names ? PyWinObject_FromCounterArrayValues(&arr, format) : NULL;
+	PyObject *ret = values ? PyList_New(arr.count) : NULL;
+	for (DWORD i=0; ret && i<arr.count; i++){
+		PyObject *item = PyTuple_Pack(2, PyTuple_GET_ITEM(names, i), PyTuple_GET_ITEM(values, i));
+		if (item==NULL){
+			Py_DECREF(ret);
+			ret = NULL;
+			break;
+			}
+		PyList_SET_ITEM(ret, i, item);
+		}
+	Py_XDECREF(names);
+	Py_XDECREF(values);
+	free(arr.buf);
+	return ret;
+}
+
+// @pymethod [(str, int, int, int, int, int), ...]|win32pdh|GetRawCounterArray|Retrieves the raw values of every instance of a counter
+// @rdesc Returns a list of (instanceName, status, timeStamp, firstValue,
+// secondValue, multiCount) tuples, one for each instance.  timeStamp is
+// in 100 nanosecond units, as in a FILETIME.
+static PyObject *PyGetRawCounterArray(PyObject *self, PyObject *args)
+{
+	HCOUNTER handle;
+	PyObject *obhandle;
+	if (!PyArg_ParseTuple(args, "O:GetRawCounterArray",
+			&obhandle)) // @pyparm int|handle||Handle to the counter
+		return NULL;
+	if (!PyWinObject_AsHANDLE(obhandle, &handle))
+		return NULL;
+	CHECK_PDH_PTR(pPdhGetRawCounterArray);
+	BYTE *buf = NULL;
+	DWORD bufSize = 0, count = 0;
+	PDH_STATUS pdhStatus;
+	Py_BEGIN_ALLOW_THREADS
+	for (int tries = 0; tries < 4; tries++){
+		DWORD size = bufSize;
+		pdhStatus = (*pPdhGetRawCounterArray)(handle, &size, &count, (PPDH_RAW_COUNTER_ITEM)buf);
+		if (pdhStatus != PDH_MORE_DATA && pdhStatus != PDH_INSUFFICIENT_BUFFER)
+			break;
+		if (size <= bufSize)
+			size = bufSize * 2;
+		BYTE *newbuf = (BYTE *)realloc(buf, size);
+		if (newbuf==NULL){
+			pdhStatus = PDH_MEMORY_ALLOCATION_FAILURE;
+			break;
+			}
+		buf = newbuf;
+		bufSize = size;
+		}
+	Py_END_ALLOW_THREADS
+	if (pdhStatus != ERROR_SUCCESS){
+		free(buf);
+		return PyWin_SetAPIError("GetRawCounterArray", pdhStatus);
+		}
+	const PDH_RAW_COUNTER_ITEM *items = (const PDH_RAW_COUNTER_ITEM *)buf;
+	PyObject *ret = PyList_New(count);
+	for (DWORD i=0; ret && i<count; i++){
+		const PDH_RAW_COUNTER *raw = &items[i].RawValue;
+		ULARGE_INTEGER timeStamp;
+		timeStamp.LowPart = raw->TimeStamp.dwLowDateTime;
+		timeStamp.HighPart = raw->TimeStamp.dwHighDateTime;
+		PyObject *item = Py_BuildValue("NkKLLk",
+			PyWinStringCache_Get(&instanceNameCache, (const PyWinUTF16 *)items[i].szName, wcslen(items[i].szName)),
+			raw->CStatus, timeStamp.QuadPart, raw->FirstValue, raw->SecondValue, raw->MultiCount);
+		if (item==NULL){
+			Py_DECREF(ret);
+			ret = NULL;
+			break;
+			}
+		PyList_SET_ITEM(ret, i, item);
+		}
+	free(buf);
+	return ret;
+}
+
+// @pymethod [(tuple, tuple), ...]|win32pdh|CollectQuerySnapshot|Collects a query and returns the values of all its counters at once
+// @rdesc Returns a list with an item for each counter.  Each item is a tuple of
+// (instanceNames, values), where both are tuples with an entry for each
+// instance of the counter, as returned by <om win32pdh.GetFormattedCounterArray>.
+// The item is None if the counter could not be read.
+// @comm This is equivalent to calling <om win32pdh.CollectQueryData>, then
+// <om win32pdh.GetFormattedCounterArray> for each counter, but the collection
+// and all the reads are done in a single call, without the GIL.
+// <nl>The same string objects are reused for instance names which are repeated
+// from one snapshot to the next.
+// <nl>To collect snapshots at regular intervals, see <om win32pdh.Sampler>.
+static PyObject *PyCollectQuerySnapshot(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	HQUERY hQuery;
+	PyObject *obhQuery, *obCounters;
+	DWORD format = PDH_FMT_DOUBLE;
+	static char *keywords[] = {"Query", "Counters", "Format", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|k:CollectQuerySnapshot", keywords,
+			&obhQuery, // @pyparm int|Query||Handle to an open query.
+			&obCounters, // @pyparm [int, ...]|Counters||Handles of counters in the query.
+			&format)) // @pyparm int|Format|PDH_FMT_DOUBLE|Format of the values, as for <om win32pdh.GetFormattedCounterValue>
+		return NULL;
+	if (!PyWinObject_AsHANDLE(obhQuery, &hQuery))
+		return NULL;
+	if (!CheckFormatOK(format))
+		return NULL;
+	CHECK_PDH_PTR(pPdhCollectQueryData);
+	CHECK_PDH_PTR(pPdhGetFormattedCounterArray);
+	HCOUNTER *counters;
+	DWORD numCounters;
+	if (!PyWinObject_AsCounterHandles(obCounters, &counters, &numCounters))
+		return NULL;
+	PdhCounterArray *arrs = (PdhCounterArray *)calloc(numCounters ? numCounters : 1, sizeof(PdhCounterArray));
+	if (arrs==NULL){
+		free(counters);
+		return PyErr_NoMemory();
+		}
+	PDH_STATUS pdhStatus;
+	Py_BEGIN_ALLOW_THREADS
+	pdhStatus = CollectCounterArrays(hQuery, counters, numCounters, format, arrs);
+	Py_END_ALLOW_THREADS
+	PyObject *ret = NULL;
+	if (pdhStatus != ERROR_SUCCESS)
+		PyWin_SetAPIError("CollectQueryData", pdhStatus);
+	else
+		ret = PyList_New(numCounters);
+	for (DWORD i=0; ret && i<numCounters; i++){
+		PyObject *item = PyWinObject_FromCounterArray(&arrs[i], format, NULL);
+		if (item==NULL){
+			Py_DECREF(ret);
+			ret = NULL;
+			break;
+			}
+		PyList_SET_ITEM(ret, i, item);
+		}
+	FreeCounterArrays(arrs, numCounters);
+	free(counters);
+	return ret;
+}
+
 // @pymethod int|win32pdh|ValidatePath|Validates that the specified counter is present on the machine specified in the counter path.
 static PyObject *PyValidatePath(PyObject *self, PyObject *args)
 {
@@ -1225,6 +1629,509 @@ static PyObject *PyLookupPerfNameByIndex(PyObject *self, PyObject *args)
 	return ret;
 }
 
+// One snapshot of the counters collected by a sampler.
+struct PdhSample
+{
+	FILETIME time;
+	PDH_STATUS status;			// of PdhCollectQueryData
+	PdhCounterArray *arrays;	// one for each counter
+	PdhSample *next;			// in the sampler's free list
+};
+
+// A native thread which collects a query at regular intervals, keeping the
+// most recent snapshots until Python asks for them.
+class PyPdhSampler : public PyObject
+{
+public:
+	PyPdhSampler(void);
+	~PyPdhSampler();
+	BOOL Init(HQUERY hQuery, HCOUNTER *counters, DWORD numCounters, DWORD interval, DWORD format, DWORD depth);
+	void Close(void);
+
+	/* Python support */
+	static void deallocFunc(PyObject *ob);
+	static PyObject *get(PyObject *self, PyObject *args);
+	static PyObject *close(PyObject *self, PyObject *args);
+	static PyObject *get_dropped(PyObject *self, void *unused);
+	static PyObject *get_queued(PyObject *self, void *unused);
+	static PyObject *get_handle(PyObject *self, void *unused);
+	static struct PyMethodDef methods[];
+	static struct PyGetSetDef getset[];
+	static PyTypeObject type;
+
+protected:
+	static unsigned __stdcall ThreadProc(void *param);
+	void Run(void);
+	PdhSample *NewSample(void);
+	void FreeSample(PdhSample *sample);
+	PyObject *SampleToPy(PdhSample *sample);
+	BOOL CheckOpen(void);
+
+	HQUERY m_query;
+	HCOUNTER *m_counters;
+	DWORD m_numCounters;
+	DWORD m_interval;
+	DWORD m_format;
+	HANDLE m_thread;			// taken by Close() with m_cs held
+	HANDLE m_stop;				// manual reset, set to stop the thread
+	HANDLE m_ready;				// manual reset, set while a snapshot is queued
+	CRITICAL_SECTION m_cs;		// guards everything below
+	BOOL m_csInitialized;
+	BOOL m_closed;
+	PdhSample **m_queue;		// a ring of m_depth snapshots, oldest first
+	DWORD m_depth;
+	DWORD m_head;
+	DWORD m_count;
+	PdhSample *m_free;
+	DWORD m_dropped;
+	DWORD m_error;
+	// The names last returned for each counter.  Only used with the GIL held.
+	PdhInstanceNames *m_names;
+};
+
+// @pymethod <o PyPdhSampler>|win32pdh|Sampler|Creates an object which collects a query at regular intervals
+// @comm A native thread collects the query every Interval milliseconds, and
+// reads the values of every instance of each counter, as <om win32pdh.CollectQuerySnapshot>
+// does.  The snapshots are kept until they are retrieved with <om PyPdhSampler.Get>,
+// so Python can read them at its own pace.  If Depth snapshots are waiting,
+// the oldest is discarded to make room for a new one.
+// <nl>The sampler does not own the query, which must stay open until the
+// sampler is closed.  Nothing else should collect the query while the sampler
+// is running, as counters which are rates are calculated from the difference
+// between the last two collections.
+// @comm Accepts keyword args.
+static PyObject *PyNewSampler(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	HQUERY hQuery;
+	PyObject *obhQuery, *obCounters;
+	DWORD interval = 1000, format = PDH_FMT_DOUBLE, depth = 16;
+	static char *keywords[] = {"Query", "Counters", "Interval", "Format", "Depth", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|kkk:Sampler", keywords,
+			&obhQuery, // @pyparm int|Query||Handle to an open query.
+			&obCounters, // @pyparm [int, ...]|Counters||Handles of counters in the query.
+			&interval, // @pyparm int|Interval|1000|Milliseconds between snapshots.
+			&format, // @pyparm int|Format|PDH_FMT_DOUBLE|Format of the values, as for <om win32pdh.GetFormattedCounterValue>
+			&depth)) // @pyparm int|Depth|16|The number of snapshots kept.
+		return NULL;
+	if (!PyWinObject_AsHANDLE(obhQuery, &hQuery))
+		return NULL;
+	if (!CheckFormatOK(format))
+		return NULL;
+	if (interval==0 || depth==0){
+		PyErr_SetString(PyExc_ValueError, "Interval and Depth must be greater than 0");
+		return NULL;
+		}
+	CHECK_PDH_PTR(pPdhCollectQueryData);
+	CHECK_PDH_PTR(pPdhGetFormattedCounterArray);
+	HCOUNTER *counters;
+	DWORD numCounters;
+	if (!PyWinObject_AsCounterHandles(obCounters, &counters, &numCounters))
+		return NULL;
+	PyPdhSampler *ret = new PyPdhSampler();
+	if (ret==NULL){
+		free(counters);
+		return PyErr_NoMemory();
+		}
+	// The sampler owns the counters from here on.
+	if (!ret->Init(hQuery, counters, numCounters, interval, format, depth)){
+		Py_DECREF(ret);
+		return NULL;
+		}
+	return ret;
+}
+
+// @object PyPdhSampler|Collects a query at regular intervals, created by <om win32pdh.Sampler>
+// @comm Each snapshot is a tuple of (time, counters), where time is a <o PyTime>
+// (in UTC) and counters is a list with an item for each counter, as
+// returned by <om win32pdh.CollectQuerySnapshot>.  counters is None if the
+// query could not be collected.
+// <nl>When the instance names of a counter are the same as in the last
+// snapshot returned, the same tuple of names is returned.
+PyPdhSampler::PyPdhSampler(void)
+{
+	ob_type = &type;
+	_Py_NewReference(this);
+	m_query = NULL;
+	m_counters = NULL;
+	m_numCounters = m_interval = m_format = 0;
+	m_thread = m_stop = m_ready = NULL;
+	m_csInitialized = FALSE;
+	m_closed = FALSE;
+	m_queue = NULL;
+	m_depth = m_head = m_count = 0;
+	m_free = NULL;
+	m_dropped = 0;
+	m_error = 0;
+	m_names = NULL;
+}
+
+PyPdhSampler::~PyPdhSampler(void)
+{
+	Close();
+	for (DWORD i=0; i<m_count; i++)
+		FreeSample(m_queue[(m_head + i) % m_depth]);
+	while (m_free){
+		PdhSample *next = m_free->next;
+		FreeSample(m_free);
+		m_free = next;
+		}
+	free(m_queue);
+	if (m_names){
+		for (DWORD i=0; i<m_numCounters; i++)
+			FreeInstanceNames(&m_names[i]);
+		free(m_names);
+		}
+	free(m_counters);
+	if (m_stop)
+		CloseHandle(m_stop);
+	if (m_ready)
+		CloseHandle(m_ready);
+	if (m_csInitialized)
+		DeleteCriticalSection(&m_cs);
+}
+
+BOOL PyPdhSampler::Init(HQUERY hQuery, HCOUNTER *counters, DWORD numCounters, DWORD interval, DWORD format, DWORD depth)
+{
+	InitializeCriticalSection(&m_cs);
+	m_csInitialized = TRUE;
+	m_query = hQuery;
+	m_counters = counters;
+	m_numCounters = numCounters;
+	m_interval = interval;
+	m_format = format;
+	m_depth = depth;
+	m_queue = (PdhSample **)calloc(depth, sizeof(PdhSample *));
+	m_names = (PdhInstanceNames *)calloc(numCounters ? numCounters : 1, sizeof(PdhInstanceNames));
+	if (m_queue==NULL || m_names==NULL){
+		PyErr_NoMemory();
+		return FALSE;
+		}
+	m_stop = CreateEvent(NULL, TRUE, FALSE, NULL);
+	m_ready = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (m_stop==NULL || m_ready==NULL){
+		PyWin_SetAPIError("CreateEvent");
+		return FALSE;
+		}
+	m_thread = (HANDLE)_beginthreadex(NULL, 0, ThreadProc, this, 0, NULL);
+	if (m_thread==NULL){
+		PyErr_SetFromErrno(PyExc_RuntimeError);
+		return FALSE;
+		}
+	return TRUE;
+}
+
+// Stops the thread and waits for it to finish.
+void PyPdhSampler::Close(void)
+{
+	if (!m_csInitialized)
+		return;
+	// Only the first caller gets the thread, and waits for it.
+	EnterCriticalSection(&m_cs);
+	HANDLE thread = m_thread;
+	m_thread = NULL;
+	if (thread==NULL){
+		LeaveCriticalSection(&m_cs);
+		return;
+		}
+	m_closed = TRUE;
+	LeaveCriticalSection(&m_cs);
+	SetEvent(m_stop);
+	Py_BEGIN_ALLOW_THREADS
+	WaitForSingleObject(thread, INFINITE);
+	Py_END_ALLOW_THREADS
+	CloseHandle(thread);
+	SetEvent(m_ready);	// wake anyone still waiting in Get()
+}
+
+// Must be called with the lock held.
+BOOL PyPdhSampler::CheckOpen(void)
+{
+	if (m_closed){
+		PyErr_SetString(PyExc_ValueError, "The Sampler has been closed");
+		return FALSE;
+		}
+	return TRUE;
+}
+
+// Called without the GIL.
+PdhSample *PyPdhSampler::NewSample(void)
+{
+	PdhSample *sample = (PdhSample *)calloc(1, sizeof(PdhSample));
+	if (sample==NULL)
+		return NULL;
+	sample->arrays = (PdhCounterArray *)calloc(m_numCounters ? m_numCounters : 1, sizeof(PdhCounterArray));
+	if (sample->arrays==NULL){
+		free(sample);
+		return NULL;
+		}
+	return sample;
+}
+
+void PyPdhSampler::FreeSample(PdhSample *sample)
+{
+	FreeCounterArrays(sample->arrays, m_numCounters);
+	free(sample);
+}
+
+unsigned __stdcall PyPdhSampler::ThreadProc(void *param)
+{
+	((PyPdhSampler *)param)->Run();
+	return 0;
+}
+
+void PyPdhSampler::Run(void)
+{
+	DWORD due = GetTickCount();
+	for (;;){
+		long wait = (long)(due - GetTickCount());
+		if (wait < 0){
+			// Collecting took longer than the interval - don't try to catch up.
+			due -= wait;
+			wait = 0;
+			}
+		if (WaitForSingleObject(m_stop, (DWORD)wait) != WAIT_TIMEOUT)
+			break;
+		due += m_interval;
+
+		// Snapshots are filled without the lock, so Get() never waits for a
+		// collection.  Buffers are reused from snapshots already returned.
+		EnterCriticalSection(&m_cs);
+		PdhSample *sample = m_free;
+		if (sample)
+			m_free = sample->next;
+		LeaveCriticalSection(&m_cs);
+		if (sample==NULL)
+			sample = NewSample();
+		if (sample==NULL){
+			EnterCriticalSection(&m_cs);
+			m_error = ERROR_NOT_ENOUGH_MEMORY;
+			SetEvent(m_ready);
+			LeaveCriticalSection(&m_cs);
+			break;
+			}
+		GetSystemTimeAsFileTime(&sample->time);
+		sample->status = CollectCounterArrays(m_query, m_counters, m_numCounters, m_format, sample->arrays);
+
+		EnterCriticalSection(&m_cs);
+		if (m_count==m_depth){
+			PdhSample *oldest = m_queue[m_head];
+			m_head = (m_head + 1) % m_depth;
+			m_count--;
+			oldest->next = m_free;
+			m_free = oldest;
+			m_dropped++;
+			}
+		m_queue[(m_head + m_count) % m_depth] = sample;
+		m_count++;
+		SetEvent(m_ready);
+		LeaveCriticalSection(&m_cs);
+	}
+}
+
+PyObject *PyPdhSampler::SampleToPy(PdhSample *sample)
+{
+	PyObject *counters;
+	if (sample->status != ERROR_SUCCESS){
+		Py_INCREF(Py_None);
+		counters = Py_None;
+		}
+	else{
+		counters = PyList_New(m_numCounters);
+		for (DWORD i=0; counters && i<m_numCounters; i++){
+			PyObject *item = PyWinObject_FromCounterArray(&sample->arrays[i], m_format, &m_names[i]);
+			if (item==NULL){
+				Py_DECREF(counters);
+				counters = NULL;
+				break;
+				}
+			PyList_SET_ITEM(counters, i, item);
+			}
+		if (counters==NULL)
+			return NULL;
+		}
+	return Py_BuildValue("NN", PyWinObject_FromFILETIME(sample->time), counters);
+}
+
+// @pymethod [(<o PyTime>, list), ...]|PyPdhSampler|Get|Waits for snapshots
+// @rdesc Returns a list of all the snapshots collected since the last call,
+// oldest first, or None if the timeout expired before there were any.
+// @comm If the thread stops because of an error, the error is raised once
+// the snapshots collected before it have been returned.
+PyObject *PyPdhSampler::get(PyObject *self, PyObject *args)
+{
+	PyPdhSampler *sampler = (PyPdhSampler *)self;
+	DWORD timeout = INFINITE;
+	// @pyparm int|Timeout|INFINITE|Milliseconds to wait for a snapshot.
+	if (!PyArg_ParseTuple(args, "|k:Get", &timeout))
+		return NULL;
+	PdhSample **taken = (PdhSample **)malloc(sampler->m_depth * sizeof(PdhSample *));
+	if (taken==NULL)
+		return PyErr_NoMemory();
+	DWORD start = GetTickCount();
+	DWORD numTaken, err;
+	for (;;){
+		// Take the queued snapshots, so the thread can carry on while they are converted.
+		EnterCriticalSection(&sampler->m_cs);
+		if (!sampler->CheckOpen()){
+			LeaveCriticalSection(&sampler->m_cs);
+			free(taken);
+			return NULL;
+			}
+		numTaken = sampler->m_count;
+		for (DWORD i=0; i<numTaken; i++)
+			taken[i] = sampler->m_queue[(sampler->m_head + i) % sampler->m_depth];
+		sampler->m_head = sampler->m_count = 0;
+		err = sampler->m_error;
+		// The thread sets the event (with the lock held) when it queues a snapshot.
+		if (err==0)
+			ResetEvent(sampler->m_ready);
+		LeaveCriticalSection(&sampler->m_cs);
+		if (numTaken || err)
+			break;
+		DWORD wait = timeout;
+		if (timeout != INFINITE){
+			DWORD elapsed = GetTickCount() - start;
+			if (elapsed >= timeout){
+				free(taken);
+				Py_INCREF(Py_None);
+				return Py_None;
+				}
+			wait = timeout - elapsed;
+			}
+		DWORD rc;
+		Py_BEGIN_ALLOW_THREADS
+		rc = WaitForSingleObject(sampler->m_ready, wait);
+		Py_END_ALLOW_THREADS
+		if (rc==WAIT_FAILED){
+			free(taken);
+			return PyWin_SetAPIError("WaitForSingleObject");
+			}
+	}
+
+	PyObject *ret;
+	if (numTaken==0)
+		ret = PyWin_SetAPIError("Sampler", err);
+	else
+		ret = PyList_New(numTaken);
+	for (DWORD i=0; ret && i<numTaken; i++){
+		PyObject *item = sampler->SampleToPy(taken[i]);
+		if (item==NULL){
+			Py_DECREF(ret);
+			ret = NULL;
+			break;
+			}
+		PyList_SET_ITEM(ret, i, item);
+		}
+	// Give the buffers back to be reused.
+	EnterCriticalSection(&sampler->m_cs);
+	for (DWORD i=0; i<numTaken; i++){
+		taken[i]->next = sampler->m_free;
+		sampler->m_free = taken[i];
+		}
+	LeaveCriticalSection(&sampler->m_cs);
+	free(taken);
+	return ret;
+}
+
+// @pymethod |PyPdhSampler|Close|Stops collecting the query
+// @comm This is done automatically when the object is destroyed.  Any thread
+// waiting in <om PyPdhSampler.Get> raises ValueError.
+PyObject *PyPdhSampler::close(PyObject *self, PyObject *args)
+{
+	if (!PyArg_ParseTuple(args, ":Close"))
+		return NULL;
+	((PyPdhSampler *)self)->Close();
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+PyObject *PyPdhSampler::get_dropped(PyObject *self, void *unused)
+{
+	PyPdhSampler *sampler = (PyPdhSampler *)self;
+	EnterCriticalSection(&sampler->m_cs);
+	DWORD dropped = sampler->m_dropped;
+	LeaveCriticalSection(&sampler->m_cs);
+	return PyLong_FromUnsignedLong(dropped);
+}
+
+PyObject *PyPdhSampler::get_queued(PyObject *self, void *unused)
+{
+	PyPdhSampler *sampler = (PyPdhSampler *)self;
+	EnterCriticalSection(&sampler->m_cs);
+	DWORD queued = sampler->m_count;
+	LeaveCriticalSection(&sampler->m_cs);
+	return PyLong_FromUnsignedLong(queued);
+}
+
+PyObject *PyPdhSampler::get_handle(PyObject *self, void *unused)
+{
+	return PyWinLong_FromHANDLE(((PyPdhSampler *)self)->m_ready);
+}
+
+/*static*/ void PyPdhSampler::deallocFunc(PyObject *ob)
+{
+	delete (PyPdhSampler *)ob;
+}
+
+/*static*/ struct PyMethodDef PyPdhSampler::methods[] = {
+	{"Get", PyPdhSampler::get, METH_VARARGS},		// @pymeth Get|Waits for snapshots
+	{"Close", PyPdhSampler::close, METH_VARARGS},	// @pymeth Close|Stops collecting the query
+	{NULL}
+};
+
+/*static*/ struct PyGetSetDef PyPdhSampler::getset[] = {
+	// @prop int|Dropped|The number of snapshots discarded because Depth snapshots were already waiting.
+	{"Dropped", PyPdhSampler::get_dropped, NULL, "The number of snapshots discarded because the queue was full"},
+	// @prop int|Queued|The number of snapshots waiting to be returned by <om PyPdhSampler.Get>.
+	{"Queued", PyPdhSampler::get_queued, NULL, "The number of snapshots waiting"},
+	// @prop int|Handle|An event handle which is signalled while a snapshot is waiting, for
+	// use with the win32event wait functions.  The handle is owned by the sampler, so must not be closed.
+	{"Handle", PyPdhSampler::get_handle, NULL, "An event which is signalled while a snapshot is waiting"},
+	{NULL}
+};
+
+PyTypeObject PyPdhSampler::type =
+{
+	PYWIN_OBJECT_HEAD
+	"PyPdhSampler",
+	sizeof(PyPdhSampler),
+	0,
+	PyPdhSampler::deallocFunc,	/* tp_dealloc */
+	0,						/* tp_print */
+	0,						/* tp_getattr */
+	0,						/* tp_setattr */
+	0,						/* tp_compare */
+	0,						/* tp_repr */
+	0,						/* tp_as_number */
+	0,						/* tp_as_sequence */
+	0,						/* tp_as_mapping */
+	0,						/* tp_hash */
+	0,						/* tp_call */
+	0,						/* tp_str */
+	PyObject_GenericGetAttr,	/* tp_getattro */
+	0,						/* tp_setattro */
+	0,						/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,		/* tp_flags */
+	"Collects a query at regular intervals",	/* tp_doc */
+	0,						/* tp_traverse */
+	0,						/* tp_clear */
+	0,						/* tp_richcompare */
+	0,						/* tp_weaklistoffset */
+	0,						/* tp_iter */
+	0,						/* tp_iternext */
+	PyPdhSampler::methods,	/* tp_methods */
+	0,						/* tp_members */
+	PyPdhSampler::getset,	/* tp_getset */
+	0,						/* tp_base */
+	0,						/* tp_dict */
+	0,						/* tp_descr_get */
+	0,						/* tp_descr_set */
+	0,						/* tp_dictoffset */
+	0,						/* tp_init */
+	0,						/* tp_alloc */
+	0,						/* tp_new */
+};
+
 /* List of functions exported by this module */
 // @module win32pdh|A module, encapsulating the Windows Performance Data Helpers API
 static struct PyMethodDef win32pdh_functions[] = {
@@ -1239,6 +2146,10 @@ static struct PyMethodDef win32pdh_functions[] = {
 	{"GetCounterInfo",           PyGetCounterInfo,       1}, // @pymeth GetCounterInfo|Retrieves information about a counter, such as data size, counter type, path, and user-supplied data values.
 	{"GetFormattedCounterValue", PyGetFormattedCounterValue,      1}, // @pymeth GetFormattedCounterValue|Retrieves a formatted counter value
 	{"CollectQueryData",         PyCollectQueryData,     1}, // @pymeth CollectQueryData|Collects the current raw data value for all counters in the specified query and updates the status code of each counter.
+	{"GetFormattedCounterArray", PyGetFormattedCounterArray, 1}, // @pymeth GetFormattedCounterArray|Retrieves the formatted values of every instance of a counter
+	{"GetRawCounterArray",       PyGetRawCounterArray,   1}, // @pymeth GetRawCounterArray|Retrieves the raw values of every instance of a counter
+	{"CollectQuerySnapshot",     (PyCFunction)PyCollectQuerySnapshot, METH_VARARGS|METH_KEYWORDS}, // @pymeth CollectQuerySnapshot|Collects a query and returns the values of all its counters at once
+	{"Sampler",                  (PyCFunction)PyNewSampler, METH_VARARGS|METH_KEYWORDS}, // @pymeth Sampler|Creates an object which collects a query at regular intervals
 	{"ValidatePath",             PyValidatePath,     1}, // @pymeth ValidatePath|Validates that the specified counter is present on the machine specified in the counter path.
 	{"ExpandCounterPath",        PyExpandCounterPath,     1}, // @pymeth ExpandCounterPath|Examines the specified machine (or local machine if none is specified) for counters and instances of counters that match the wild card strings in the counter path.
 	{"ParseCounterPath",         PyParseCounterPath,      1}, // @pymeth ParseCounterPath|Parses the elements of the counter path.
@@ -1264,6 +2175,9 @@ PYWIN_MODULE_INIT_FUNC(win32pdh)
 	win32pdh_counter_error = PyErr_NewException("win32pdh.counter_status_error", NULL, NULL);
 	PyDict_SetItemString(dict, "counter_status_error", win32pdh_counter_error);
 	LoadPointers(); // Setting an error in this function will cause Python to spew.
+	if (PyType_Ready(&PyPdhSampler::type) == -1
+		|| !PyWinStringCache_Resize(&instanceNameCache, 1024, PYWIN_STRING_CACHE_MAX_CHARS))
+		PYWIN_MODULE_INIT_RETURN_ERROR;
   
 	ADD_CONSTANT(PDH_VERSION);
  
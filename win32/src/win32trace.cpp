@@ -9,38 +9,41 @@ It is assumed there may be many current clients sending output to the
 tracer, but only one process reading it.  [Violating this will not cause a
 crash, just cause only one of the processes to see a given piece of text.]
 
-The implementation is very simple, because of the above assumptions.
-
-* There is a mem-mapped file, with the first word being an integer, and the
-rest being string data.  The integer is the current length of the string.
-* A write operation appends data to the buffer, and updates the length.
-* A read operation reads the entire buffer, and resets the length to zero.
-  (Thus, there is no way to read only chunks of the data)
-* A single mutex protects the entire structure.  While the mutex is held, there
-  can at worst be a strcpy, malloc, and integer change, so this should be reasonable.
-
-Currently, the memmapped file is allocated in the system swap space, and only 64k of
-data is allocated.  If this buffer fills before a server gets to read it, the _entire_
-output is discarded, and the text written to the new, empty buffer.
-
-However, the most we will write at a time is "buffer_size/2" bytes, then we
-will have a short, optimized sleep between chunks.
-
-See - I told you the implementation was simple :-)
+The implementation:
+
+* There is a mem-mapped file, allocated in the system swap space, holding a
+  ring of records (see win32trace_ring.h).  Each write appends one record
+  (or several, for huge writes) stamped with a sequence number, the process
+  and thread ids and the time.
+* Writers never lock or wait.  They reserve space in the ring with an atomic
+  operation, and if the reader has fallen so far behind that the ring is
+  full, the text is dropped and counted - see GetStats.
+* A read operation takes all the records written so far, and frees their
+  space.  The mutex is only used to keep readers from draining the ring
+  at the same time; writers never touch it.
+* A writer which exits (or is killed) part way through a record can't
+  hold up the others; the reader skips the record once it sees the
+  process has gone.
+* Each write sets an event, which blockingread (or anyone using GetHandle)
+  can wait on.
 
 */
 
 #include "PyWinTypes.h"
 #include "PyWinObjects.h"
+#include "win32trace_ring.h"
 
 
 
-
-const unsigned long BUFFER_SIZE = 0x20000; // Includes size integer.
-const TCHAR *MAP_OBJECT_NAME = _T("Global\\PythonTraceOutputMapping");
+const unsigned int RING_SIZE = 0x100000; // Must be a power of 2.
+const unsigned long MAP_SIZE = (unsigned long)PyTraceRing::MappingSize(RING_SIZE);
+// The name changed with the layout, so older versions of the module never
+// see the ring.  The old name is only used to warn that an older version is
+// tracing (or reading) in parallel.
+const TCHAR *MAP_OBJECT_NAME = _T("Global\\PythonTraceOutputRing");
+const TCHAR *OLD_MAP_OBJECT_NAME = _T("Global\\PythonTraceOutputMapping");
 const TCHAR *MUTEX_OBJECT_NAME = _T("Global\\PythonTraceOutputMutex");
 const TCHAR *EVENT_OBJECT_NAME = _T("Global\\PythonTraceOutputEvent");
-const TCHAR *EVENT_EMPTY_OBJECT_NAME = _T("Global\\PythonTraceOutputEmptyEvent");
 
 // Global\\ etc goodness:
 // On NT4/9x, 'Global\\' is not understood and will fail.
@@ -83,13 +86,18 @@ char *TRACEOBJECT_NAME = "__win32traceObject__";
 HANDLE hMutex = NULL;
 // An auto-reset event so a reader knows when data is avail without polling.
 HANDLE hEvent = NULL;
-// An auto-reset event so writing large data can know when the buffer has
-// been read.
-HANDLE hEventEmpty = NULL;
 
 SECURITY_ATTRIBUTES  sa;       // Security attributes.
 PSECURITY_DESCRIPTOR pSD = NULL;      // Pointer to SD.
 
+// Where ReadData copies records to.  With headers, each record's text is
+// preceded by its (possibly unaligned) PyTraceRecord.
+struct TraceReadBuffer {
+    char *data;
+    size_t len;
+    size_t size; // bytes allocated at data
+    bool withHeaders;
+};
 
 class PyTraceObject : public PyObject {
     // do not put virtual
@@ -98,6 +106,13 @@ class PyTraceObject : public PyObject {
     HANDLE hMapFileWrite; // The handle to the write side of the mem-mapped file
     void *pMapBaseRead;
     void *pMapBaseWrite;
+    PyTraceRing ringRead;
+    PyTraceRing ringWrite;
+    // Kept between reads so the reader doesn't allocate a buffer the size
+    // of everything pending every time.  It only grows, so is never more
+    // than the ring (plus record headers).
+    char *readBuf;
+    size_t readBufSize;
 public:
     void Initialize();
     BOOL OpenReadMap();
@@ -105,12 +120,16 @@ public:
     BOOL OpenWriteMap();
     BOOL CloseWriteMap();
     BOOL WriteData(const char *data, unsigned len);
-    BOOL ReadData(char **ppResult, int *retSize, int waitMilliseconds);
+    BOOL ReadData(TraceReadBuffer *buf, int waitMilliseconds, bool withHeaders = false);
+    void DoneReading(TraceReadBuffer *buf);
+    void FreeReadBuffer();
+    BOOL GetStats(PyTraceRingStats *stats);
     int fSoftSpace;
 }; // PyTraceObject
 
 static void PyTraceObject_dealloc(PyObject* self)
 {
+    static_cast<PyTraceObject*>(self)->FreeReadBuffer();
     PyObject_Del(self);
 }
 
@@ -135,17 +154,16 @@ static PyObject *PyTraceObject_read(PyObject *self, PyObject *args)
 {
     if (!PyArg_ParseTuple(args, ":read"))
         return NULL;
-    int len;
-    char *data;
-    BOOL ok = static_cast<PyTraceObject*>(self)->ReadData(&data, &len, 0);
-    if (!ok)
+    PyTraceObject *pThis = static_cast<PyTraceObject*>(self);
+    TraceReadBuffer buf;
+    if (!pThis->ReadData(&buf, 0))
         return NULL;
 #if (PY_VERSION_HEX < 0x03000000)
-    PyObject *result = PyString_FromStringAndSize(data, len);
+    PyObject *result = PyString_FromStringAndSize(buf.data, buf.len);
 #else
-    PyObject *result = PyUnicode_DecodeLatin1(data, len, "replace");
+    PyObject *result = PyUnicode_DecodeLatin1(buf.data, buf.len, "replace");
 #endif
-    free(data);
+    pThis->DoneReading(&buf);
     return result;
 }
 
@@ -154,17 +172,56 @@ static PyObject *PyTraceObject_blockingread(PyObject *self, PyObject *args)
     int milliSeconds = INFINITE;
     if (!PyArg_ParseTuple(args, "|i:blockingread", &milliSeconds))
         return NULL;
-    int len;
-    char *data;
-    BOOL ok = static_cast<PyTraceObject*>(self)->ReadData(&data, &len, milliSeconds);
-    if (!ok)
+    PyTraceObject *pThis = static_cast<PyTraceObject*>(self);
+    TraceReadBuffer buf;
+    if (!pThis->ReadData(&buf, milliSeconds))
         return NULL;
 #if (PY_VERSION_HEX < 0x03000000)
-    PyObject *result = PyString_FromStringAndSize(data, len);
+    PyObject *result = PyString_FromStringAndSize(buf.data, buf.len);
 #else
-    PyObject *result = PyUnicode_DecodeLatin1(data, len, "replace");
+    PyObject *result = PyUnicode_DecodeLatin1(buf.data, buf.len, "replace");
 #endif
-    free(data);
+    pThis->DoneReading(&buf);
+    return result;
+}
+
+// Returns a list of (sequence, pid, tid, time, text) tuples for the
+// records written since the last read.
+static PyObject *PyTraceObject_readrecords(PyObject *self, PyObject *args)
+{
+    int milliSeconds = 0;
+    if (!PyArg_ParseTuple(args, "|i:readrecords", &milliSeconds))
+        return NULL;
+    PyTraceObject *pThis = static_cast<PyTraceObject*>(self);
+    TraceReadBuffer buf;
+    if (!pThis->ReadData(&buf, milliSeconds, true))
+        return NULL;
+    PyObject *result = PyList_New(0);
+    const char *p = buf.data;
+    while (result && p < buf.data + buf.len) {
+        PyTraceRecord rec;
+        memcpy(&rec, p, PYTRACE_RECORD_HEADER_SIZE);
+        p += PYTRACE_RECORD_HEADER_SIZE;
+        unsigned int length = PyTraceRecord::StateLow(rec.state);
+        FILETIME ft;
+        ft.dwLowDateTime = (DWORD)rec.time;
+        ft.dwHighDateTime = (DWORD)(rec.time >> 32);
+#if (PY_VERSION_HEX < 0x03000000)
+        PyObject *text = PyString_FromStringAndSize(p, length);
+#else
+        PyObject *text = PyUnicode_DecodeLatin1(p, length, "replace");
+#endif
+        p += length;
+        PyObject *item = NULL;
+        if (text)
+            item = Py_BuildValue("LkkNN", rec.sequence, (unsigned long)rec.pid, (unsigned long)rec.tid,
+                                 PyWinObject_FromFILETIME(ft), text);
+        if (item == NULL || PyList_Append(result, item) == -1) {
+            Py_CLEAR(result);
+        }
+        Py_XDECREF(item);
+    }
+    pThis->DoneReading(&buf);
     return result;
 }
 
@@ -185,6 +242,7 @@ static PyObject* PyTraceObject_isatty(PyObject *self, PyObject *args)
 static PyMethodDef PyTraceObject_methods[] = {
     {"blockingread", PyTraceObject_blockingread, METH_VARARGS}, // @pymeth blockingread
     {"read",    PyTraceObject_read, METH_VARARGS }, // @pymeth read|    
+    {"readrecords", PyTraceObject_readrecords, METH_VARARGS }, // @pymeth readrecords|
     {"write",   PyTraceObject_write, METH_VARARGS }, // @pymeth write|
     {"flush",   PyTraceObject_flush, METH_VARARGS }, // @pymeth flush|Does nothing, but included to better emulate file semantics.
     {"isatty",  PyTraceObject_isatty, METH_VARARGS}, // @pymeth isatty | returns false
@@ -255,29 +313,53 @@ static PyObject *ReturnError(char *msg, char *fnName = NULL)
     return NULL;
 }
 
-BOOL DoOpenMap(HANDLE *pHandle, VOID **ppPtr)
+BOOL DoOpenMap(HANDLE *pHandle, VOID **ppPtr, PyTraceRing *pRing)
 {
     if (*pHandle || *ppPtr) {
 	ReturnError("DoOpenMap, already open");
 	return FALSE;
     }
     Py_BEGIN_ALLOW_THREADS
-    *pHandle = CreateFileMapping((HANDLE)-1, &sa, PAGE_READWRITE, 0, BUFFER_SIZE, FixupObjectName(MAP_OBJECT_NAME));
+    *pHandle = CreateFileMapping((HANDLE)-1, &sa, PAGE_READWRITE, 0, MAP_SIZE, FixupObjectName(MAP_OBJECT_NAME));
     Py_END_ALLOW_THREADS
     if (*pHandle==NULL) {
         PyWin_SetAPIError("CreateFileMapping");
         return FALSE;
     }
     Py_BEGIN_ALLOW_THREADS
-    *ppPtr = MapViewOfFile(*pHandle, FILE_MAP_ALL_ACCESS, 0, 0, BUFFER_SIZE);
+    *ppPtr = MapViewOfFile(*pHandle, FILE_MAP_ALL_ACCESS, 0, 0, MAP_SIZE);
     Py_END_ALLOW_THREADS
     if (*ppPtr==NULL) {
         // not allowed to access the interpreter inside
         // Py_BEGIN_ALLOW_THREADS block
         PyWin_SetAPIError("MapViewOfFile");
         CloseHandle(*pHandle);
+        *pHandle = NULL;
+        return FALSE;
+    }
+    const char *why = pRing->Init(*ppPtr, RING_SIZE);
+    if (why) {
+        UnmapViewOfFile(*ppPtr);
+        *ppPtr = NULL;
+        CloseHandle(*pHandle);
+        *pHandle = NULL;
+        ReturnError((char *)why, "DoOpenMap");
         return FALSE;
     }
+    // Processes using an older version of the module share a mapping under
+    // the old name, and can't see this one (nor we theirs) - say so rather
+    // than their output (or our readers) silently going missing.
+    HANDLE hOld = OpenFileMapping(FILE_MAP_READ, FALSE, FixupObjectName(OLD_MAP_OBJECT_NAME));
+    if (hOld) {
+        CloseHandle(hOld);
+        if (PyErr_Warn(PyExc_RuntimeWarning, "An older version of win32trace is in use - it does not share its trace output with this version") == -1) {
+            UnmapViewOfFile(*ppPtr);
+            *ppPtr = NULL;
+            CloseHandle(*pHandle);
+            *pHandle = NULL;
+            return FALSE;
+        }
+    }
     return TRUE;
 }
 
@@ -327,6 +409,8 @@ void PyTraceObject::Initialize()
     hMapFileWrite = NULL;
     pMapBaseRead = NULL;
     pMapBaseWrite = NULL;
+    readBuf = NULL;
+    readBufSize = 0;
 	fSoftSpace = 0;
 }
 
@@ -337,44 +421,73 @@ BOOL PyTraceObject::WriteData(const char *data, unsigned len)
         ReturnError("The module has not been setup for writing");
         return FALSE;
     }
-    BOOL rc = TRUE;
-    Py_BEGIN_ALLOW_THREADS
-    const char *data_this = data;
+    // Nothing here can block, so there's no point releasing the GIL.
+    DWORD pid = GetCurrentProcessId();
+    DWORD tid = GetCurrentThreadId();
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    PyTraceInt64 now = ((PyTraceInt64)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    // Text which doesn't fit is counted by the ring, and not an error.
+    unsigned maxText = ringWrite.MaxText();
     while (len) {
-        unsigned len_this = min(len, BUFFER_SIZE/2);
-        BOOL ok = GetMyMutex();
-        if (ok) {
-            // must use types with identical size on win32 and win64
-            unsigned long *pLen = (unsigned long *)pMapBaseWrite;
-            unsigned long sizeLeft = (BUFFER_SIZE-sizeof(unsigned long)) - *pLen;
-            // If less than double we need left, wait for it to empty, or .1 sec.
-            if (sizeLeft < len_this * 2) {
-                ReleaseMyMutex();
-                SetEvent(hEvent);
-                WaitForSingleObject(hEventEmpty, 100);
-                ok = GetMyMutex();
-            }
-        }
-        if (ok) {
-            unsigned long *pLen = (unsigned long *)pMapBaseWrite;
-            char *buffer = (char *)(((unsigned long *)pMapBaseWrite)+1);
-
-            unsigned long sizeLeft = (BUFFER_SIZE-sizeof(unsigned long)) - *pLen;
-            if (sizeLeft<len_this)
-                *pLen = 0;
-            memcpy(buffer+(*pLen), data_this, len_this);
-            *pLen += len_this;
-            rc = ReleaseMyMutex();
-            SetEvent(hEvent);
-            data_this += len_this;
-            len -= len_this;
-        }
+        unsigned len_this = min(len, maxText);
+        ringWrite.Write(data, len_this, pid, tid, now);
+        data += len_this;
+        len -= len_this;
     }
-    Py_END_ALLOW_THREADS
-    return rc;
+    SetEvent(hEvent);
+    return TRUE;
 }
 
-BOOL PyTraceObject::ReadData(char **ppResult, int *retSize, int waitMilliseconds) 
+static bool CopyTraceRecord(void *context, const PyTraceRecord *rec, const char *text, unsigned int length)
+{
+    TraceReadBuffer *buf = (TraceReadBuffer *)context;
+    if (buf->withHeaders) {
+        memcpy(buf->data + buf->len, rec, PYTRACE_RECORD_HEADER_SIZE);
+        buf->len += PYTRACE_RECORD_HEADER_SIZE;
+    }
+    memcpy(buf->data + buf->len, text, length);
+    buf->len += length;
+    return true;
+}
+
+// Whether a process which began writing a record has exited, so the
+// record will never be finished.  If we can't tell (eg, the process
+// belongs to someone else) it is assumed to still be running.
+static bool TraceWriterGone(unsigned int pid)
+{
+    HANDLE hProcess = OpenProcess(SYNCHRONIZE, FALSE, pid);
+    if (hProcess == NULL)
+        return GetLastError() == ERROR_INVALID_PARAMETER;
+    bool gone = WaitForSingleObject(hProcess, 0) == WAIT_OBJECT_0;
+    CloseHandle(hProcess);
+    return gone;
+}
+
+// The buffer ReadData filled is handed back here once the caller is done
+// with it.  Until then the object has no buffer of its own, so a read made
+// meanwhile (eg, from another thread) allocates a new one rather than
+// overwriting this one.  The larger of the two is kept.
+void PyTraceObject::DoneReading(TraceReadBuffer *buf)
+{
+    if (buf->size > readBufSize) {
+        free(readBuf);
+        readBuf = buf->data;
+        readBufSize = buf->size;
+    } else
+        free(buf->data);
+    buf->data = NULL;
+    buf->size = 0;
+}
+
+void PyTraceObject::FreeReadBuffer()
+{
+    free(readBuf);
+    readBuf = NULL;
+    readBufSize = 0;
+}
+
+BOOL PyTraceObject::ReadData(TraceReadBuffer *buf, int waitMilliseconds, bool withHeaders)
 {
     if (pMapBaseRead == NULL) {
         ReturnError("The module has not been setup for reading");
@@ -391,44 +504,62 @@ BOOL PyTraceObject::ReadData(char **ppResult, int *retSize, int waitMilliseconds
         }
     }
     BOOL rc = FALSE;
-    char *result = NULL;
+    buf->data = readBuf;
+    buf->len = 0;
+    buf->size = readBufSize;
+    buf->withHeaders = withHeaders;
+    readBuf = NULL;
+    readBufSize = 0;
     Py_BEGIN_ALLOW_THREADS
+    // The mutex only keeps other readers out - writers carry on regardless.
     if (GetMyMutex()) {
-        // must use sizes that are identical on win32 and win64
-	unsigned long*pLen = (unsigned long *)pMapBaseRead;
-	char *buffer = (char *)(((unsigned long *)pMapBaseRead)+1);
-
-	result = (char *)malloc(*pLen + 1);
-	if (result) {
-	    memcpy(result, buffer, *pLen);
-	    result[*pLen] = '\0';
-	    *retSize = *pLen;
-	    *pLen = 0;
+	// Records (with their headers) are never smaller than their text, so
+	// everything reserved so far fits.
+	PyTraceInt64 end = ringRead.Head();
+	size_t needed = (size_t)ringRead.Available(end) + 1;
+	if (needed > buf->size) {
+	    // The old contents aren't wanted, so there's no point in realloc.
+	    free(buf->data);
+	    buf->data = (char *)malloc(needed);
+	    buf->size = buf->data ? needed : 0;
+	}
+	if (buf->data) {
+	    ringRead.Drain(end, CopyTraceRecord, buf, TraceWriterGone);
+	    buf->data[buf->len] = '\0';
 	}
 	rc = ReleaseMyMutex();
-	SetEvent(hEventEmpty); // in case anyone wants to optimize waiting.
     }
     Py_END_ALLOW_THREADS
-    if (!rc && result) {
-	free(result);
-    }
-    if (rc && result==NULL) {
+    if (rc && buf->data==NULL) {
         PyErr_SetString(PyExc_MemoryError, "Allocating buffer for trace data");
         rc = FALSE;
     }
-    if (rc)
-        *ppResult = result;
+    if (!rc)
+        DoneReading(buf);
     return rc;
 }
 
+BOOL PyTraceObject::GetStats(PyTraceRingStats *stats)
+{
+    if (pMapBaseRead)
+        ringRead.GetStats(stats);
+    else if (pMapBaseWrite)
+        ringWrite.GetStats(stats);
+    else {
+        ReturnError("The module has not been setup for reading or writing");
+        return FALSE;
+    }
+    return TRUE;
+}
+
 BOOL PyTraceObject::OpenReadMap()
 {
-    return DoOpenMap( &hMapFileRead, &pMapBaseRead);
+    return DoOpenMap( &hMapFileRead, &pMapBaseRead, &ringRead);
 }
 
 BOOL PyTraceObject::OpenWriteMap()
 {
-    return DoOpenMap( &hMapFileWrite, &pMapBaseWrite);;
+    return DoOpenMap( &hMapFileWrite, &pMapBaseWrite, &ringWrite);
 }
 
 
@@ -560,6 +691,44 @@ static PyObject* win32trace_blockingread(PyObject*, PyObject* args)
     return result;    
 }    
 
+static PyObject* win32trace_readrecords(PyObject*, PyObject* args)
+{
+    PyObject* traceObject = PySys_GetObject(TRACEOBJECT_NAME);
+    if (traceObject == NULL) {
+        return ReturnError("The module has not been setup for reading");
+    }
+    PyObject* method = PyObject_GetAttrString(traceObject, "readrecords");
+    if (method == NULL) {
+        return NULL;
+    }
+    PyObject* result = PyObject_CallObject(method, args);
+    Py_DECREF(method);
+    return result;
+}
+
+// Writers never wait for the reader, so output produced faster than it is
+// read gets dropped - these counters (shared by every process using the
+// buffer) say how much.  'sequence' is the number of records written, which
+// is also the sequence number of the latest one.
+static PyObject *win32trace_GetStats(PyObject *self, PyObject *args)
+{
+    if (!PyArg_ParseTuple(args, ":GetStats"))
+        return NULL;
+    PyObject* traceObject = PySys_GetObject(TRACEOBJECT_NAME);
+    if (traceObject == NULL) {
+        return ReturnError("The module has not been setup for reading or writing");
+    }
+    PyTraceRingStats stats;
+    if (!static_cast<PyTraceObject*>(traceObject)->GetStats(&stats))
+        return NULL;
+    return Py_BuildValue("{s:k,s:L,s:L,s:L,s:L}",
+                         "size", (unsigned long)stats.size,
+                         "pending", stats.pending,
+                         "sequence", stats.sequence,
+                         "dropped_bytes", stats.droppedBytes,
+                         "dropped_records", stats.droppedRecords);
+}
+
 static PyObject *win32trace_setprint(PyObject *self, PyObject *args)
 {
     PyObject* traceObject = PySys_GetObject(TRACEOBJECT_NAME);
@@ -607,6 +776,8 @@ static struct PyMethodDef win32trace_functions[] = {
     {"write",             win32trace_write, 1 }, // @pymeth write|
     {"blockingread",      win32trace_blockingread, 1 }, // @pymeth blockingread|
     {"read",              win32trace_read, 1 }, // @pymeth read|
+    {"readrecords",       win32trace_readrecords, 1 }, // @pymeth readrecords|Returns (sequence, pid, tid, time, text) for each write since the last read, optionally waiting for the given number of milliseconds first.
+    {"GetStats",          win32trace_GetStats, 1 }, // @pymeth GetStats|Returns counters for the shared trace buffer, including the amount of output dropped.
     {"setprint",          win32trace_setprint, 1 }, // @pymeth setprint|
     {"flush",             win32trace_flush, 1 }, // @pymeth flush|Does nothing, but included to better emulate file semantics.
     {NULL,			NULL}
@@ -654,14 +825,14 @@ PYWIN_MODULE_INIT_FUNC(win32trace)
         // local - use_global_namespace is still FALSE now, so that is the 
         // name we get.
         HANDLE h = CreateFileMapping((HANDLE)-1, &sa, PAGE_READWRITE, 0, 
-                                     BUFFER_SIZE, 
+                                     MAP_SIZE, 
                                      FixupObjectName(MAP_OBJECT_NAME));
         if (GetLastError() != ERROR_ALREADY_EXISTS) {
             // no local one exists - see if we can create it globally - if
             // we can, we go global, else we stick with local.
             use_global_namespace = TRUE;
             HANDLE h2 = CreateFileMapping((HANDLE)-1, &sa, PAGE_READWRITE,
-                                          0, BUFFER_SIZE,
+                                          0, MAP_SIZE,
                                           FixupObjectName(MAP_OBJECT_NAME));
             use_global_namespace = h2 != NULL;
             if (h2)
@@ -684,11 +855,5 @@ PYWIN_MODULE_INIT_FUNC(win32trace)
         PyWin_SetAPIError("CreateEvent");
         PYWIN_MODULE_INIT_RETURN_ERROR;
     }
-    assert (hEventEmpty==NULL);
-    hEventEmpty = CreateEvent(&sa, FALSE, FALSE, FixupObjectName(EVENT_EMPTY_OBJECT_NAME));
-    if (hEventEmpty==NULL) {
-        PyWin_SetAPIError("CreateEvent");
-        PYWIN_MODULE_INIT_RETURN_ERROR;
-    }
     PYWIN_MODULE_INIT_RETURN_SUCCESS;
 }
@@ -0,0 +1,418 @@
+// win32trace_ring.h - the shared memory ring used by win32trace.
+//
+// Any number of writers, in any number of processes, append records to the
+// ring and a single reader drains them.  Neither side takes a lock:
+//
+// * The ring has two ever-increasing byte positions, head and tail.  A
+//   writer claims the record at head by a compare-and-swap on its first
+//   word (its state), which records the record's size and the writer's
+//   process id, and then advances head past it.  It fills in the record
+//   and commits it by setting the state again.  If the space between head
+//   and tail is too small, the record is dropped (never waited for) and the
+//   dropped counters are incremented instead.
+// * A writer which finds head at a claimed record advances head for it, so
+//   a writer dying between the two steps doesn't stop the others.
+// * The reader consumes committed records from tail, marks the space they
+//   took as free and then advances tail.  It stops at the first record
+//   which is claimed but not yet committed, and picks it up on the next
+//   drain - unless the record's writer has since exited (as the reader's
+//   owner function decides), when it is skipped and counted as dropped.
+// * Every free word holds the position at which it can next be claimed, so
+//   a writer working from a stale head can never claim a record which
+//   isn't at head.
+// * A record which won't fit before the end of the buffer is preceded by a
+//   padding record filling the rest of it, so records are never split.
+//
+// Each record is stamped with a sequence number and the writer's process
+// id, thread id and time, all supplied by the caller.  The code uses no
+// Windows or Python APIs, so the same ring can be run in POSIX shared
+// memory (eg, to stress test it on other platforms).
+//
+// The layout only uses fixed size types, so 32 and 64 bit processes can
+// share a ring.
+
+#ifndef __WIN32TRACE_RING_H__
+#define __WIN32TRACE_RING_H__
+
+#include <stddef.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+typedef __int64 PyTraceInt64;
+#else
+typedef long long PyTraceInt64;
+#endif
+
+#define PYTRACE_RING_MAGIC 0x52545950	// 'PYTR'
+#define PYTRACE_RING_INITIALIZING 0x3f3f3f3f
+#define PYTRACE_RING_VERSION 2
+// Offset of the first record from the start of the mapping.
+#define PYTRACE_RING_HEADER_SIZE 256
+// The record header and payloads are kept 8 byte aligned.
+#define PYTRACE_RECORD_HEADER_SIZE 32
+#define PYTRACE_RECORD_ALIGN 8
+// The length of a padding record.
+#define PYTRACE_RECORD_PAD 0xffffffff
+
+// A record's state is one of
+// * free: the position at which it can next be claimed.
+// * claimed: PYTRACE_STATE_CLAIMED, the record's size / 8 in bits 32-60
+//   and the writer's process id in the low 32 bits.
+// * committed: PYTRACE_STATE_COMMITTED, the size / 8 in bits 32-60 and the
+//   length of the text (or PYTRACE_RECORD_PAD) in the low 32 bits.
+#define PYTRACE_STATE_CLAIMED ((PyTraceInt64)1 << 61)
+#define PYTRACE_STATE_COMMITTED ((PyTraceInt64)1 << 62)
+#define PYTRACE_STATE_FLAGS (PYTRACE_STATE_CLAIMED | PYTRACE_STATE_COMMITTED)
+
+// Atomic operations on the shared memory.  Loads have acquire and stores
+// release semantics; the read-modify-write operations are full barriers.
+#ifdef _MSC_VER
+inline PyTraceInt64 PyTraceAtomic_Load64(volatile PyTraceInt64 *p)
+{
+	return _InterlockedCompareExchange64(p, 0, 0);
+}
+
+inline bool PyTraceAtomic_CAS64(volatile PyTraceInt64 *p, PyTraceInt64 oldval, PyTraceInt64 newval)
+{
+	return _InterlockedCompareExchange64(p, newval, oldval) == oldval;
+}
+
+inline unsigned int PyTraceAtomic_Load32(volatile unsigned int *p)
+{
+	return (unsigned int)_InterlockedCompareExchange((volatile long *)p, 0, 0);
+}
+
+inline void PyTraceAtomic_Store32(volatile unsigned int *p, unsigned int val)
+{
+	_InterlockedExchange((volatile long *)p, (long)val);
+}
+
+inline bool PyTraceAtomic_CAS32(volatile unsigned int *p, unsigned int oldval, unsigned int newval)
+{
+	return (unsigned int)_InterlockedCompareExchange((volatile long *)p, (long)newval, (long)oldval) == oldval;
+}
+
+// A store with no ordering, for words which other threads only read
+// racily - and discard if torn, as it may be on 32 bit x86.
+inline void PyTraceAtomic_SetRacy64(volatile PyTraceInt64 *p, PyTraceInt64 val)
+{
+	*p = val;
+}
+#else
+inline PyTraceInt64 PyTraceAtomic_Load64(volatile PyTraceInt64 *p)
+{
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+inline bool PyTraceAtomic_CAS64(volatile PyTraceInt64 *p, PyTraceInt64 oldval, PyTraceInt64 newval)
+{
+	return __atomic_compare_exchange_n(p, &oldval, newval, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+inline unsigned int PyTraceAtomic_Load32(volatile unsigned int *p)
+{
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+inline void PyTraceAtomic_Store32(volatile unsigned int *p, unsigned int val)
+{
+	__atomic_store_n(p, val, __ATOMIC_RELEASE);
+}
+
+inline bool PyTraceAtomic_CAS32(volatile unsigned int *p, unsigned int oldval, unsigned int newval)
+{
+	return __atomic_compare_exchange_n(p, &oldval, newval, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+inline void PyTraceAtomic_SetRacy64(volatile PyTraceInt64 *p, PyTraceInt64 val)
+{
+	__atomic_store_n(p, val, __ATOMIC_RELAXED);
+}
+#endif
+
+// 32 bit x86 has no plain 64 bit store or add, so both are built on
+// compare-and-swap.
+inline void PyTraceAtomic_Store64(volatile PyTraceInt64 *p, PyTraceInt64 val)
+{
+	PyTraceInt64 old = PyTraceAtomic_Load64(p);
+	while (!PyTraceAtomic_CAS64(p, old, val))
+		old = PyTraceAtomic_Load64(p);
+}
+
+inline PyTraceInt64 PyTraceAtomic_Add64(volatile PyTraceInt64 *p, PyTraceInt64 val)
+{
+	PyTraceInt64 old = PyTraceAtomic_Load64(p);
+	while (!PyTraceAtomic_CAS64(p, old, old + val))
+		old = PyTraceAtomic_Load64(p);
+	return old + val;
+}
+
+// The start of the mapping.  The cursors each get their own cache line.
+struct PyTraceRingHeader
+{
+	volatile unsigned int magic;
+	unsigned int version;
+	unsigned int size;			// bytes of record space, a power of 2
+	unsigned int reserved;
+	char pad0[48];
+	volatile PyTraceInt64 head;	// 64: next position to reserve
+	char pad1[56];
+	volatile PyTraceInt64 tail;	// 128: next position to read
+	char pad2[56];
+	volatile PyTraceInt64 sequence;		// 192: records written
+	volatile PyTraceInt64 droppedBytes;	// bytes of text which didn't fit
+	volatile PyTraceInt64 droppedRecords;
+};
+
+struct PyTraceRecord
+{
+	volatile PyTraceInt64 state;	// see PYTRACE_STATE_CLAIMED
+	PyTraceInt64 sequence;
+	unsigned int pid;
+	unsigned int tid;
+	PyTraceInt64 time;
+
+	static PyTraceInt64 MakeState(PyTraceInt64 flag, unsigned int size, unsigned int low)
+	{
+		return flag | ((PyTraceInt64)(size / PYTRACE_RECORD_ALIGN) << 32) | low;
+	}
+	// The size of the whole record, including padding, once claimed.
+	static unsigned int StateSize(PyTraceInt64 state)
+	{
+		return (unsigned int)((state & ~PYTRACE_STATE_FLAGS) >> 32) * PYTRACE_RECORD_ALIGN;
+	}
+	// The length of the text once committed, or the writer's process id
+	// while claimed.
+	static unsigned int StateLow(PyTraceInt64 state)
+	{
+		return (unsigned int)state;
+	}
+};
+
+struct PyTraceRingStats
+{
+	unsigned int size;
+	PyTraceInt64 pending;		// bytes reserved but not yet read
+	PyTraceInt64 sequence;
+	PyTraceInt64 droppedBytes;
+	PyTraceInt64 droppedRecords;
+};
+
+// Called by Drain for each record, with its text.  Returning false stops
+// the drain and leaves the record in the ring.
+typedef bool (*PyTraceRecordFunc)(void *context, const PyTraceRecord *rec, const char *text, unsigned int length);
+
+// Called by Drain with the process id of a writer whose record has been
+// left unfinished since the previous drain.  Returns true if the process
+// has exited, so the record will never be committed.
+typedef bool (*PyTraceOwnerGoneFunc)(unsigned int pid);
+
+struct PyTraceRing
+{
+	PyTraceRingHeader *header;
+	char *records;
+	unsigned int size;
+	PyTraceInt64 stalled;	// the unfinished record the last drain stopped at, or -1
+
+	// Bytes needed for a mapping holding a ring of the given size.
+	static size_t MappingSize(unsigned int size)
+	{
+		return PYTRACE_RING_HEADER_SIZE + (size_t)size;
+	}
+
+	// Attaches to a ring in zero-filled (or previously attached) memory of
+	// MappingSize(size) bytes, formatting it if nobody has yet.  Returns
+	// NULL, or the reason the memory doesn't hold a usable ring.
+	const char *Init(void *base, unsigned int ringSize)
+	{
+		header = (PyTraceRingHeader *)base;
+		records = (char *)base + PYTRACE_RING_HEADER_SIZE;
+		size = ringSize;
+		stalled = -1;
+		if (size == 0 || (size & (size - 1)) != 0 || size % PYTRACE_RECORD_ALIGN != 0)
+			return "The trace buffer size must be a power of 2";
+		if (PyTraceAtomic_CAS32(&header->magic, 0, PYTRACE_RING_INITIALIZING)) {
+			Free(-(PyTraceInt64)size, 0);
+			header->version = PYTRACE_RING_VERSION;
+			header->size = size;
+			PyTraceAtomic_Store64(&header->head, 0);
+			PyTraceAtomic_Store64(&header->tail, 0);
+			PyTraceAtomic_Store64(&header->sequence, 0);
+			PyTraceAtomic_Store64(&header->droppedBytes, 0);
+			PyTraceAtomic_Store64(&header->droppedRecords, 0);
+			PyTraceAtomic_Store32(&header->magic, PYTRACE_RING_MAGIC);
+		}
+		else {
+			// Another process is formatting it - this takes microseconds.
+			while (PyTraceAtomic_Load32(&header->magic) == PYTRACE_RING_INITIALIZING)
+				;
+		}
+		if (PyTraceAtomic_Load32(&header->magic) != PYTRACE_RING_MAGIC
+			|| header->version != PYTRACE_RING_VERSION || header->size != size)
+			return "The trace buffer was created by an incompatible version of win32trace";
+		return NULL;
+	}
+
+	// The longest text which can be written as one record.  Longer text
+	// must be split by the caller.
+	unsigned int MaxText()
+	{
+		return size / 4 - PYTRACE_RECORD_HEADER_SIZE;
+	}
+
+	static unsigned int RecordSize(unsigned int length)
+	{
+		return (PYTRACE_RECORD_HEADER_SIZE + length + PYTRACE_RECORD_ALIGN - 1) & ~(PYTRACE_RECORD_ALIGN - 1);
+	}
+
+	PyTraceRecord *RecordAt(PyTraceInt64 pos)
+	{
+		return (PyTraceRecord *)(records + (size_t)(pos & (size - 1)));
+	}
+
+	// Marks the space from pos to end as free, with each word holding the
+	// position it can next be claimed at - one pass of the ring on.  Init
+	// frees the pass before the first.
+	void Free(PyTraceInt64 pos, PyTraceInt64 end)
+	{
+		for (; pos < end; pos += PYTRACE_RECORD_ALIGN)
+			PyTraceAtomic_SetRacy64((volatile PyTraceInt64 *)RecordAt(pos), pos + size);
+	}
+
+	// Claims the record at head - or if need bytes won't fit before the end
+	// of the buffer, a padding record up to it - and advances head past it.
+	// Returns the claimed state, or 0 if the ring is full.
+	PyTraceInt64 Claim(unsigned int need, unsigned int pid, PyTraceInt64 *ppos)
+	{
+		for (;;) {
+			PyTraceInt64 pos = PyTraceAtomic_Load64(&header->head);
+			PyTraceInt64 tail = PyTraceAtomic_Load64(&header->tail);
+			unsigned int toEnd = size - (unsigned int)(pos & (size - 1));
+			unsigned int claimSize = need > toEnd ? toEnd : need;
+			// tail may be stale, but only ever makes the ring look fuller.
+			// Once this passes, the record at pos has been freed (unless
+			// head has moved on).
+			if (pos + (need > toEnd ? toEnd + need : need) - tail > size)
+				return 0;
+			PyTraceRecord *rec = RecordAt(pos);
+			PyTraceInt64 cur = PyTraceAtomic_Load64(&rec->state);
+			if (cur != pos) {
+				// Either head has moved on, or another writer has claimed
+				// the record but not yet advanced head past it.
+				if (cur & PYTRACE_STATE_FLAGS)
+					PyTraceAtomic_CAS64(&header->head, pos, pos + PyTraceRecord::StateSize(cur));
+				continue;
+			}
+			PyTraceInt64 state = PyTraceRecord::MakeState(PYTRACE_STATE_CLAIMED, claimSize, pid);
+			if (!PyTraceAtomic_CAS64(&rec->state, pos, state))
+				continue;
+			// Another writer has done this if it fails.
+			PyTraceAtomic_CAS64(&header->head, pos, pos + claimSize);
+			*ppos = pos;
+			return state;
+		}
+	}
+
+	// Appends one record.  Returns false if it was dropped because the
+	// ring is full (or the text is longer than MaxText).
+	bool Write(const void *text, unsigned int length, unsigned int pid, unsigned int tid, PyTraceInt64 time)
+	{
+		if (length > MaxText())
+			return Drop(length);
+		unsigned int need = RecordSize(length);
+		PyTraceInt64 pos, claimed;
+		for (;;) {
+			claimed = Claim(need, pid, &pos);
+			if (claimed == 0)
+				return Drop(length);
+			unsigned int claimSize = PyTraceRecord::StateSize(claimed);
+			if (claimSize == need)
+				break;
+			// Pad out the rest of the buffer, and try again at its start.
+			PyTraceAtomic_CAS64(&RecordAt(pos)->state, claimed,
+				PyTraceRecord::MakeState(PYTRACE_STATE_COMMITTED, claimSize, PYTRACE_RECORD_PAD));
+		}
+		PyTraceRecord *rec = RecordAt(pos);
+		rec->sequence = PyTraceAtomic_Add64(&header->sequence, 1);
+		rec->pid = pid;
+		rec->tid = tid;
+		rec->time = time;
+		memcpy((char *)rec + PYTRACE_RECORD_HEADER_SIZE, text, length);
+		// This only fails if the reader decided the process had exited.
+		if (!PyTraceAtomic_CAS64(&rec->state, claimed,
+			PyTraceRecord::MakeState(PYTRACE_STATE_COMMITTED, need, length)))
+			return Drop(length);
+		return true;
+	}
+
+	bool Drop(unsigned int length)
+	{
+		PyTraceAtomic_Add64(&header->droppedBytes, length);
+		PyTraceAtomic_Add64(&header->droppedRecords, 1);
+		return false;
+	}
+
+	// The position after the last reserved record.  Records before it may
+	// still be being written.
+	PyTraceInt64 Head()
+	{
+		return PyTraceAtomic_Load64(&header->head);
+	}
+
+	// An upper bound on the bytes of text a Drain to end can deliver.
+	PyTraceInt64 Available(PyTraceInt64 end)
+	{
+		return end - PyTraceAtomic_Load64(&header->tail);
+	}
+
+	// Hands fn the committed records from tail up to end (a value of Head)
+	// in order, and frees their space.  Only one thread at a time may
+	// drain a ring.  Returns the number of records consumed.
+	// A record which is still unfinished at the next drain is skipped (and
+	// counted as dropped) if ownerGone says its writer has exited.
+	size_t Drain(PyTraceInt64 end, PyTraceRecordFunc fn, void *context, PyTraceOwnerGoneFunc ownerGone = NULL)
+	{
+		PyTraceInt64 pos = PyTraceAtomic_Load64(&header->tail);
+		size_t count = 0;
+		while (pos < end) {
+			PyTraceRecord *rec = RecordAt(pos);
+			PyTraceInt64 state = PyTraceAtomic_Load64(&rec->state);
+			if (!(state & PYTRACE_STATE_COMMITTED)) {
+				if (!(state & PYTRACE_STATE_CLAIMED) || pos != stalled || ownerGone == NULL
+					|| !ownerGone(PyTraceRecord::StateLow(state))) {
+					stalled = pos;
+					break;		// still being written
+				}
+				// Its text (if any) can't be known, so only the record is
+				// counted.
+				if (PyTraceAtomic_CAS64(&rec->state, state, PyTraceRecord::MakeState(PYTRACE_STATE_COMMITTED,
+					PyTraceRecord::StateSize(state), PYTRACE_RECORD_PAD)))
+					Drop(0);
+				continue;
+			}
+			unsigned int recSize = PyTraceRecord::StateSize(state);
+			unsigned int length = PyTraceRecord::StateLow(state);
+			if (length != PYTRACE_RECORD_PAD) {
+				if (!fn(context, rec, (const char *)rec + PYTRACE_RECORD_HEADER_SIZE, length))
+					break;
+				count++;
+			}
+			Free(pos, pos + recSize);
+			pos += recSize;
+		}
+		PyTraceAtomic_Store64(&header->tail, pos);
+		return count;
+	}
+
+	void GetStats(PyTraceRingStats *stats)
+	{
+		stats->size = size;
+		stats->pending = PyTraceAtomic_Load64(&header->head) - PyTraceAtomic_Load64(&header->tail);
+		stats->sequence = PyTraceAtomic_Load64(&header->sequence);
+		stats->droppedBytes = PyTraceAtomic_Load64(&header->droppedBytes);
+		stats->droppedRecords = PyTraceAtomic_Load64(&header->droppedRecords);
+	}
+};
+
+#endif // __WIN32TRACE_RING_H__
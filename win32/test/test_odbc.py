@@ -216,5 +216,169 @@ class TestStuff(unittest.TestCase):
                 self.tablename), 0)
         self.assertEqual(len(self.cur.fetchone()[1]), 0)
 
+    def _insert_many(self, count):
+        rows = [["user%d" % i, "name %d" % i, i, i + 0.5]
+                for i in range(count)]
+        self.cur.execute(
+            "insert into %s (userid, username, intfield, floatfield) "
+            "values (?,?,?,?)" % self.tablename, rows)
+        return [tuple(row) for row in rows]
+
+    def testArraysize(self):
+        self.assertEqual(self.cur.arraysize, 1)
+        self.cur.arraysize = 50
+        self.assertEqual(self.cur.arraysize, 50)
+
+    def testFetchBlocks(self):
+        expected = self._insert_many(300)
+        for arraysize in (1, 7, 1000):
+            self.cur.arraysize = arraysize
+            self.cur.execute(
+                "select userid, username, intfield, floatfield from %s "
+                "order by intfield" % self.tablename)
+            # Mix the fetch methods so rows left over from a block are
+            # handed out by the next call.
+            got = [self.cur.fetchone()]
+            got.extend(self.cur.fetchmany())
+            got.extend(self.cur.fetchmany(10))
+            got.append(self.cur.fetchone())
+            got.extend(self.cur.fetchall())
+            self.assertEqual(got, expected)
+            self.assertEqual(self.cur.fetchone(), None)
+            self.assertEqual(self.cur.fetchall(), [])
+
+    def testFetchBlocksNulls(self):
+        self.cur.execute(
+            "insert into %s (userid, intfield) values (?,?)" % self.tablename,
+            [["a", 1], ["b", None], ["c", 3]])
+        self.cur.arraysize = 100
+        self.cur.execute(
+            "select userid, intfield, username from %s order by userid"
+            % self.tablename)
+        self.assertEqual(self.cur.fetchall(),
+                         [("a", 1, None), ("b", None, None), ("c", 3, None)])
+
+    def testFetchLongColumns(self):
+        # Long columns are read with SQLGetData, a row at a time.
+        self.cur.execute(
+            "insert into %s (userid, longtextfield) values (?,?)"
+            % self.tablename,
+            [["user%d" % i, "abc" * ((i + 1) * 1000)] for i in range(20)])
+        self.cur.arraysize = 100
+        self.cur.execute(
+            "select userid, longtextfield from %s order by userid"
+            % self.tablename)
+        rows = self.cur.fetchall()
+        self.assertEqual(len(rows), 20)
+        for userid, text in rows:
+            self.assertEqual(text, "abc" * ((int(userid[4:]) + 1) * 1000))
+
+    def testFetchColumns(self):
+        import datetime
+        import struct
+        self.cur.execute(
+            "insert into %s (userid, username, intfield, floatfield, datefield) "
+            "values (?,?,?,?,?)" % self.tablename,
+            [["a", "\xe0b", 1, 1.5, datetime.datetime(1970, 1, 2, 0, 0, 1)],
+             ["b", None, None, None, None],
+             ["c", "", -3, 2.25, datetime.datetime(1969, 12, 31)]])
+        self.cur.execute(
+            "select userid, username, intfield, floatfield, datefield "
+            "from %s order by userid" % self.tablename)
+        first = self.cur.fetchcolumns(2)
+        rest = self.cur.fetchcolumns()
+        (uoffsets, udata, unulls), (noffsets, ndata, nnulls), \
+            (ints, inulls), (floats, fnulls), (dates, dnulls) = first
+
+        def tolist(values, fmt):
+            # Python 2 returns plain strings
+            if isinstance(values, memoryview):
+                return values.tolist()
+            return list(struct.unpack("%d%s" % (len(values) // 8, fmt), values))
+
+        self.assertEqual(tolist(uoffsets, "q"), [0, 1, 2])
+        self.assertEqual(bytes(udata), str2bytes("ab"))
+        self.assertEqual(tolist(noffsets, "q"), [0, 3, 3])
+        self.assertEqual(bytes(ndata), "\xe0b".encode("utf-8"))
+        self.assertEqual(tolist(ints, "q"), [1, 0])
+        self.assertEqual(tolist(floats, "d"), [1.5, 0.0])
+        self.assertEqual(tolist(dates, "q"), [86401000000, 0])
+        for nulls in (unulls, nnulls, inulls, fnulls, dnulls):
+            self.assertEqual(len(nulls), 1)
+        self.assertEqual(bytearray(unulls)[0], 0)
+        self.assertEqual(bytearray(inulls)[0], 2)
+        self.assertEqual(bytearray(nnulls)[0], 2)
+
+        (uoffsets, udata, unulls), (noffsets, ndata, nnulls), \
+            (ints, inulls), (floats, fnulls), (dates, dnulls) = rest
+        self.assertEqual(bytes(udata), str2bytes("c"))
+        self.assertEqual(tolist(noffsets, "q"), [0, 0])
+        self.assertEqual(bytearray(nnulls)[0], 0)
+        self.assertEqual(tolist(ints, "q"), [-3])
+        self.assertEqual(tolist(floats, "d"), [2.25])
+        self.assertEqual(tolist(dates, "q"), [-86400000000])
+        # Nothing left
+        for column in self.cur.fetchcolumns():
+            self.assertEqual(len(column[0]), 1 if len(column) == 3 else 0)
+
+    def _paramstatus(self):
+        import array
+        status = self.cur.paramstatus
+        if isinstance(status, memoryview):
+            return status.tolist()
+        return array.array("H", status).tolist()
+
+    def testExecuteMany(self):
+        import datetime
+        self.assertEqual(self.cur.batchsize, 1000)
+        self.assertEqual(self.cur.paramstatus, None)
+        when = datetime.datetime(2001, 2, 3, 4, 5, 6)
+        rows = [["user%d" % i, None if i % 3 else "name %d" % i, i,
+                 i if i % 2 else i + 0.5, when]
+                for i in range(25)]
+        for batchsize in (1, 10, 1000):
+            self.cur.execute("delete from %s" % self.tablename)
+            self.cur.batchsize = batchsize
+            self.assertEqual(self.cur.executemany(
+                "insert into %s (userid, username, intfield, floatfield, datefield) "
+                "values (?,?,?,?,?)" % self.tablename, rows), 25)
+            self.assertEqual(self._paramstatus(), [odbc.SQL_PARAM_SUCCESS] * 25)
+            self.cur.execute(
+                "select userid, username, intfield, floatfield, datefield "
+                "from %s order by intfield" % self.tablename)
+            got = self.cur.fetchall()
+            self.assertEqual([row[:4] for row in got],
+                             [tuple(row[:4]) for row in rows])
+            for row in got:
+                self.assertEqual(row[4].timetuple()[:6], when.timetuple()[:6])
+
+    def testExecuteManyMixedTypes(self):
+        # A column holding different kinds of value is sent a row at a time.
+        self.cur.batchsize = 10
+        self.cur.executemany(
+            "insert into %s (userid, username) values (?,?)" % self.tablename,
+            [["a", "x"], ["b", str2bytes("y")], ["c", None]])
+        self.assertEqual(self._paramstatus(), [odbc.SQL_PARAM_SUCCESS] * 3)
+        self.cur.execute("select userid from %s order by userid" % self.tablename)
+        self.assertEqual(self.cur.fetchall(), [("a",), ("b",), ("c",)])
+
+    def testExecuteManyMixedBatches(self):
+        # A batch sent a row at a time must leave the statement prepared for
+        # the array batches after it.
+        self.cur.batchsize = 2
+        self.cur.executemany(
+            "insert into %s (userid, username) values (?,?)" % self.tablename,
+            [["a", "x"], ["b", str2bytes("y")], ["c", "z"], ["d", "w"]])
+        self.assertEqual(self._paramstatus(), [odbc.SQL_PARAM_SUCCESS] * 4)
+        self.cur.execute("select userid from %s order by userid" % self.tablename)
+        self.assertEqual(self.cur.fetchall(), [("a",), ("b",), ("c",), ("d",)])
+
+    def testExecuteManyErrors(self):
+        sql = "insert into %s (userid, intfield) values (?,?)" % self.tablename
+        self.assertRaises(odbc.error, self.cur.executemany, sql, "ab")
+        self.assertRaises(odbc.error, self.cur.executemany, sql, [["a", 1], ["b"]])
+        self.assertEqual(self.cur.executemany(sql, []), 0)
+        self.assertEqual(self._paramstatus(), [])
+
 if __name__ == '__main__':
     unittest.main()
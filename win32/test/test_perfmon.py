@@ -0,0 +1,148 @@
+import threading
+import unittest
+
+import perfmon
+import pywintypes
+import winerror
+from pywin32_testutil import TestSkipped
+
+PERF_COUNTER_BULK_COUNT = 0x10410500
+
+
+def MakeManager(objectType):
+    try:
+        return perfmon.PerfMonManager("pywin32_test_perfmon", [objectType])
+    except pywintypes.error as exc:
+        # Creating a "Global\\" mapping needs SeCreateGlobalPrivilege.
+        if exc.winerror != winerror.ERROR_ACCESS_DENIED:
+            raise
+        raise TestSkipped(exc)
+
+
+class TestCounters(unittest.TestCase):
+
+    def setUp(self):
+        self.count = perfmon.CounterDefinition(2)
+        self.bytes = perfmon.CounterDefinition(4)
+        self.bytes.CounterType = PERF_COUNTER_BULK_COUNT
+        self.objectType = perfmon.ObjectType([self.count, self.bytes])
+        self.manager = None
+
+    def tearDown(self):
+        if self.manager is not None:
+            self.manager.Close()
+
+    def testNotInManager(self):
+        # The "set" methods silently do nothing.
+        self.count.Increment()
+        self.objectType.UpdateCounters([(0, 1)])
+        self.assertRaises(ValueError, self.count.Get)
+        self.assertRaises(ValueError, self.objectType.AddInstance, "x")
+
+    def testCounters(self):
+        self.manager = MakeManager(self.objectType)
+        self.count.Increment()
+        self.count.Increment(4)
+        self.count.Decrement()
+        self.assertEqual(self.count.Get(), 4)
+        self.bytes.Set(1 << 40)
+        self.bytes.Increment()
+        self.assertEqual(self.bytes.Get(), (1 << 40) + 1)
+        self.assertRaises(ValueError, self.count.Increment, 1, 0)
+
+    def testNegative(self):
+        # 32 bit counters read back signed, as they always have.
+        self.manager = MakeManager(self.objectType)
+        self.count.Decrement()
+        self.assertEqual(self.count.Get(), -1)
+        self.bytes.Decrement(2)
+        self.assertEqual(self.bytes.Get(), -2)
+
+    def testOverflow(self):
+        # 32 bit counters take an int, as they always have.
+        self.manager = MakeManager(self.objectType)
+        self.assertRaises(OverflowError, self.count.Set, 1 << 31)
+        self.assertRaises(OverflowError, self.count.Increment, 1 << 32)
+        self.assertRaises(OverflowError, self.count.Decrement, -(1 << 31))
+        self.assertRaises(OverflowError, self.objectType.UpdateCounters,
+                          [(1, 1), (0, 1 << 31)])
+        self.assertEqual((self.count.Get(), self.bytes.Get()), (0, 0))
+        self.count.Set(-(1 << 31))
+        self.assertEqual(self.count.Get(), -(1 << 31))
+        self.bytes.Set(1 << 40)
+
+    def testUpdateCounters(self):
+        self.manager = MakeManager(self.objectType)
+        self.objectType.UpdateCounters([(self.count, 2), (1, 10)])
+        self.objectType.UpdateCounters([(0, 7)], None, True)
+        self.assertEqual((self.count.Get(), self.bytes.Get()), (7, 10))
+        # Nothing is changed if any update is bad.
+        self.assertRaises(IndexError, self.objectType.UpdateCounters,
+                          [(0, 1), (2, 1)])
+        other = perfmon.CounterDefinition(6)
+        self.assertRaises(ValueError, self.objectType.UpdateCounters,
+                          [(0, 1), (other, 1)])
+        self.assertRaises(TypeError, self.objectType.UpdateCounters, [0])
+        self.assertEqual(self.count.Get(), 7)
+
+    def testThreads(self):
+        self.manager = MakeManager(self.objectType)
+
+        def work():
+            for i in range(10000):
+                self.count.Increment()
+                self.objectType.UpdateCounters([(1, 2)])
+        threads = [threading.Thread(target=work) for i in range(4)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        self.assertEqual((self.count.Get(), self.bytes.Get()), (40000, 80000))
+
+    def testClosed(self):
+        self.manager = MakeManager(self.objectType)
+        self.count.Increment()
+        self.manager.Close()
+        self.manager = None
+        # The counters no longer refer to the mapping.
+        self.count.Increment()
+        self.assertRaises(ValueError, self.count.Get)
+
+
+class TestInstances(unittest.TestCase):
+
+    def setUp(self):
+        self.count = perfmon.CounterDefinition(2)
+        self.objectType = perfmon.ObjectType([self.count], 2, 8)
+        self.manager = MakeManager(self.objectType)
+
+    def tearDown(self):
+        self.manager.Close()
+
+    def testInstances(self):
+        self.assertEqual(self.objectType.MaxInstances, 2)
+        first = self.objectType.AddInstance("first")
+        second = self.objectType.AddInstance("second")
+        self.count.Increment(3, first)
+        self.objectType.UpdateCounters([(self.count, 5)], second)
+        self.assertEqual(self.count.Get(first), 3)
+        self.assertEqual(self.count.Get(second), 5)
+        # An instance must be given.
+        self.assertRaises(ValueError, self.count.Increment)
+        self.assertRaises(RuntimeError, self.objectType.AddInstance, "third")
+        self.assertRaises(ValueError, self.objectType.AddInstance, "much too long")
+
+    def testRemove(self):
+        first = self.objectType.AddInstance("first")
+        self.count.Increment(1, first)
+        self.objectType.RemoveInstance(first)
+        self.assertRaises(ValueError, self.objectType.RemoveInstance, first)
+        self.assertRaises(ValueError, self.count.Get, first)
+        # The slot is reused, with a new id and zeroed counters.
+        again = self.objectType.AddInstance("first")
+        self.assertNotEqual(again, first)
+        self.assertEqual(self.count.Get(again), 0)
+
+
+if __name__ == '__main__':
+    unittest.main()
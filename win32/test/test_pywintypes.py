@@ -109,5 +109,34 @@ class TestCase(unittest.TestCase):
         d = dict(item=iid)
         self.assertEqual(d['item'], iid)
 
+    def testStringCache(self):
+        import win32api
+        expand = win32api.ExpandEnvironmentStrings
+        pywintypes.SetStringCacheSize(64, 16)
+        try:
+            stats = pywintypes.GetStringCacheStats()
+            self.assertEqual((stats["slots"], stats["max_length"]), (64, 16))
+            self.assertEqual(stats["hits"], 0)
+            a = expand("hello")
+            b = expand("hello")
+            self.assertEqual(a, "hello")
+            self.assertEqual(b, "hello")
+            long_str = "x" * 17
+            self.assertEqual(expand(long_str), long_str)
+            if sys.version_info > (3, 0):
+                # (win32api only uses the wide APIs on py3k)
+                self.assertTrue(a is b)
+                stats = pywintypes.GetStringCacheStats()
+                self.assertTrue(stats["hits"] >= 1)
+                # Long strings are never cached.
+                self.assertFalse(expand(long_str) is expand(long_str))
+            self.assertEqual(expand(u"\xe9t\xe9 \u65e5\u672c"),
+                             u"\xe9t\xe9 \u65e5\u672c")
+        finally:
+            pywintypes.SetStringCacheSize(0)
+        self.assertEqual(pywintypes.GetStringCacheStats()["slots"], 0)
+        self.assertEqual(expand("hello"), "hello")
+        self.assertRaises(ValueError, pywintypes.SetStringCacheSize, -1)
+
 if __name__ == '__main__':
     unittest.main()
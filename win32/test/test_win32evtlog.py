@@ -0,0 +1,280 @@
+import binascii
+import struct
+import time
+import unittest
+
+import win32evtlog
+import win32security
+
+# Three records, as ReadEventLog returns them:
+#  1 - "Service Control Manager", EventID 0x40000007, information, with 2
+#      string inserts, the SID S-1-5-18 and 2 bytes of data.
+#  2 - "Application Error", EventID 1000, error, with 1 string insert.
+#  3 - "MyApp", EventID 0xC0000005, warning, with nothing else.
+RECORDS = binascii.unhexlify(
+    "a80000004c664c6501000000006d7c4d016d7c4d070000400400020003000000"
+    "00000000800000000c0000007400000002000000a00000005300650072007600"
+    "690063006500200043006f006e00740072006f006c0020004d0061006e006100"
+    "670065007200000048004f005300540000000000010100000000000512000000"
+    "530070006f006f006c00650072000000720075006e006e0069006e0067000000"
+    "01020000a80000007c0000004c664c6502000000006d7c4d016d7c4de8030000"
+    "0100010003000000000000006800000000000000680000000000000078000000"
+    "4100700070006c00690063006100740069006f006e0020004500720072006f00"
+    "7200000048004f0053005400000000006100700070002e006500780065000000"
+    "7c000000540000004c664c6503000000006d7c4d016d7c4d050000c002000000"
+    "030000000000000050000000000000005000000000000000500000004d007900"
+    "410070007000000048004f00530054000000000054000000")
+
+
+class TestParseRecords(unittest.TestCase):
+
+    def testParse(self):
+        recs = win32evtlog.ParseEventLogRecords(RECORDS)
+        self.assertEqual([r.RecordNumber for r in recs], [1, 2, 3])
+        r = recs[0]
+        self.assertEqual(r.SourceName, "Service Control Manager")
+        self.assertEqual(r.ComputerName, "HOST")
+        self.assertEqual(r.EventID, 0x40000007)
+        self.assertEqual(r.EventType, win32evtlog.EVENTLOG_INFORMATION_TYPE)
+        self.assertEqual(r.EventCategory, 3)
+        self.assertEqual(r.StringInserts, ("Spooler", "running"))
+        self.assertEqual(win32security.ConvertSidToStringSid(r.Sid), "S-1-5-18")
+        self.assertEqual(r.Data, b"\x01\x02")
+        self.assertEqual(int(r.TimeWritten) - int(r.TimeGenerated), 1)
+        r = recs[1]
+        self.assertEqual(r.StringInserts, ("app.exe",))
+        self.assertEqual(r.Sid, None)
+        r = recs[2]
+        self.assertEqual(r.StringInserts, None)
+        self.assertEqual(r.Data, b"")
+        # EventID has always been signed.
+        self.assertEqual(r.EventID & 0xFFFFFFFF, 0xC0000005)
+
+    def testAssign(self):
+        r = win32evtlog.ParseEventLogRecords(RECORDS)[0]
+        r.SourceName = "Other"
+        self.assertEqual(r.SourceName, "Other")
+        self.assertRaises(AttributeError, delattr, r, "SourceName")
+        r.EventID = 1000
+        self.assertEqual(r.EventID, 1000)
+        self.assertRaises(TypeError, setattr, r, "EventID", "x")
+        self.assertRaises(TypeError, setattr, r, "EventType", None)
+        self.assertEqual(r.EventID, 1000)
+
+    def testRecordsOutliveBuffer(self):
+        data = bytearray(RECORDS)
+        recs = win32evtlog.ParseEventLogRecords(data)
+        data[:] = b"\0" * len(data)
+        self.assertEqual(recs[1].SourceName, "Application Error")
+
+    def testInvalid(self):
+        # Every truncation of a record is rejected.
+        length = struct.unpack_from("<I", RECORDS)[0]
+        for size in range(1, length):
+            self.assertRaises(ValueError, win32evtlog.ParseEventLogRecords,
+                              RECORDS[:size])
+        # As are offsets outside the record.
+        for field in (11, 13, 15):  # StringOffset, UserSidOffset, DataOffset
+            offset = struct.calcsize("<6I4H") + (field - 10) * 4
+            bad = bytearray(RECORDS[:length])
+            struct.pack_into("<I", bad, offset, length + 4)
+            self.assertRaises(ValueError, win32evtlog.ParseEventLogRecords, bad)
+        self.assertEqual(win32evtlog.ParseEventLogRecords(b""), [])
+
+
+class TestFilter(unittest.TestCase):
+
+    def check(self, expected, **kw):
+        f = win32evtlog.EventLogFilter(**kw)
+        recs = win32evtlog.ParseEventLogRecords(RECORDS, f)
+        self.assertEqual([r.RecordNumber for r in recs], expected)
+
+    def testEventIDs(self):
+        self.check([2], EventIDs=[1000])
+        # The low 16 bits of an EventID match too, as do negative values.
+        self.check([1, 3], EventIDs=[7, -1073741819])
+        self.assertRaises(ValueError, win32evtlog.EventLogFilter, EventIDs=[])
+
+    def testEventTypes(self):
+        self.check([2, 3], EventTypes=win32evtlog.EVENTLOG_ERROR_TYPE |
+                   win32evtlog.EVENTLOG_WARNING_TYPE)
+
+    def testSourceName(self):
+        self.check([3], SourceName="myapp")
+        self.check([], SourceName="MyAp")
+
+    def testCombined(self):
+        self.check([2], EventTypes=win32evtlog.EVENTLOG_ERROR_TYPE,
+                   SourceName="Application Error", EventIDs=[1000, 7])
+        self.check([], EventTypes=win32evtlog.EVENTLOG_WARNING_TYPE,
+                   EventIDs=[1000])
+
+    def testBadFilter(self):
+        self.assertRaises(TypeError, win32evtlog.ParseEventLogRecords,
+                          RECORDS, "filter")
+
+
+class TestReadEventLog(unittest.TestCase):
+
+    def testRead(self):
+        h = win32evtlog.OpenEventLog(None, "Application")
+        try:
+            flags = win32evtlog.EVENTLOG_BACKWARDS_READ | \
+                win32evtlog.EVENTLOG_SEQUENTIAL_READ
+            recs = win32evtlog.ReadEventLog(h, flags, 0)
+            for r in recs:
+                self.assertTrue(isinstance(r.SourceName, str) or
+                                isinstance(r.SourceName, type(u"")))
+        finally:
+            win32evtlog.CloseEventLog(h)
+
+    def testReadFiltered(self):
+        h = win32evtlog.OpenEventLog(None, "Application")
+        try:
+            flags = win32evtlog.EVENTLOG_BACKWARDS_READ | \
+                win32evtlog.EVENTLOG_SEQUENTIAL_READ
+            f = win32evtlog.EventLogFilter(
+                EventTypes=win32evtlog.EVENTLOG_ERROR_TYPE)
+            while True:
+                recs = win32evtlog.ReadEventLog(h, flags, 0, 0, f)
+                if not recs:
+                    break
+                for r in recs:
+                    self.assertEqual(r.EventType, win32evtlog.EVENTLOG_ERROR_TYPE)
+        finally:
+            win32evtlog.CloseEventLog(h)
+
+
+class TestBatchReader(unittest.TestCase):
+    paths = ["Event/System/EventRecordID", "Event/System/Provider/@Name",
+             "Event/System/EventID"]
+
+    def setUp(self):
+        self.context = win32evtlog.EvtCreateRenderContext(self.paths)
+
+    def _Query(self):
+        return win32evtlog.EvtQuery("Application",
+                                    win32evtlog.EvtQueryChannelPath |
+                                    win32evtlog.EvtQueryForwardDirection)
+
+    def _RenderAll(self):
+        # The values rendered one event at a time.
+        query = self._Query()
+        ret = []
+        while True:
+            events = win32evtlog.EvtNext(query, 100)
+            if not events:
+                break
+            for event in events:
+                ret.append(win32evtlog.EvtRender(
+                    event, win32evtlog.EvtRenderEventValues, self.context))
+        return ret
+
+    def testMatchesEvtRender(self):
+        expected = self._RenderAll()
+        # Small batches and buffers, so events spill into following batches.
+        reader = win32evtlog.EvtBatchReader(self._Query(), self.context,
+                                            BatchSize=7, BufferSize=256)
+        rows = list(reader)
+        # Events may be logged between the two queries.
+        self.assertEqual(rows[:len(expected)], expected)
+        self.assertTrue(reader.Finished)
+        self.assertEqual(reader.Next(), [])
+        for row in rows:
+            self.assertEqual(len(row), len(self.paths))
+
+    def testBookmark(self):
+        bookmark = win32evtlog.EvtCreateBookmark()
+        reader = win32evtlog.EvtBatchReader(self._Query(), self.context,
+                                            bookmark, BatchSize=10)
+        rows = reader.Next()
+        if not rows:
+            return
+        # The bookmark is moved past every event returned.
+        xml = win32evtlog.EvtRender(bookmark, win32evtlog.EvtRenderBookmark)
+        self.assertTrue("RecordId='%d'" % (rows[-1][0],) in xml, xml)
+        reader.Close()
+        self.assertRaises(ValueError, reader.Next)
+
+    def testBadArgs(self):
+        self.assertRaises(ValueError, win32evtlog.EvtBatchReader,
+                          self._Query(), None)
+        self.assertRaises(ValueError, win32evtlog.EvtBatchReader,
+                          self._Query(), self.context, BatchSize=0)
+
+
+class TestSubscribeQueue(unittest.TestCase):
+    paths = ["Event/System/EventRecordID", "Event/System/Provider/@Name"]
+    source = "PyWin32 test"
+
+    def _ReportEvents(self, count=3):
+        h = win32evtlog.RegisterEventSource(None, self.source)
+        try:
+            for i in range(count):
+                win32evtlog.ReportEvent(h, win32evtlog.EVENTLOG_INFORMATION_TYPE,
+                                        0, 1, None, ["test %d" % (i,)], None)
+        finally:
+            win32evtlog.DeregisterEventSource(h)
+
+    def _Subscribe(self, flags=win32evtlog.EvtSubscribeStartAtOldestRecord, **kw):
+        return win32evtlog.EvtSubscribeQueue("Application", flags, **kw)
+
+    def _SubscribeOwn(self, **kw):
+        # Only the events this test reports, so nothing else in the log can
+        # fill the queue - and if it is full anyway, wait rather than drop.
+        query = "*[System/Provider[@Name='%s']]" % (self.source,)
+        queue = self._Subscribe(win32evtlog.EvtSubscribeToFutureEvents,
+                                Query=query, FullTimeout=-1, **kw)
+        self._ReportEvents()
+        return queue
+
+    def _GetAll(self, queue):
+        ret = []
+        while True:
+            got = queue.Get(Timeout=2000)
+            if got is None:
+                return ret
+            ret.extend(got)
+
+    def testXml(self):
+        queue = self._SubscribeOwn()
+        try:
+            events = self._GetAll(queue)
+        finally:
+            queue.Close()
+        self.assertEqual(len(events), 3)
+        for xml in events:
+            self.assertTrue(xml.startswith("<Event "), xml)
+        self.assertEqual(queue.Dropped, 0)
+
+    def testValues(self):
+        context = win32evtlog.EvtCreateRenderContext(self.paths)
+        queue = self._SubscribeOwn(Context=context, BatchSize=2)
+        try:
+            rows = self._GetAll(queue)
+        finally:
+            queue.Close()
+        ids = [row[0] for row in rows]
+        self.assertEqual(len(ids), 3)
+        self.assertEqual(ids, sorted(ids))
+        self.assertEqual([row[1] for row in rows], [self.source] * 3)
+        self.assertEqual(queue.Dropped, 0)
+
+    def testDropped(self):
+        # Room for one event, and nothing is taken until the others arrive.
+        self._ReportEvents()
+        queue = self._Subscribe(BatchSize=1, MaxBatches=1)
+        try:
+            deadline = time.time() + 10
+            while queue.Dropped < 2 and time.time() < deadline:
+                time.sleep(0.1)
+            self.assertTrue(queue.Dropped >= 2)
+            self.assertEqual(queue.Queued, 1)
+            self.assertEqual(len(queue.Get(0)), 1)
+        finally:
+            queue.Close()
+        self.assertRaises(ValueError, queue.Get, 0)
+
+
+if __name__ == '__main__':
+    unittest.main()
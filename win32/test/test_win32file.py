@@ -3,6 +3,7 @@ import os
 import random
 import shutil
 import socket
+import sys
 import tempfile
 import threading
 import time
@@ -17,6 +18,7 @@ import win32file
 import win32pipe
 import win32timezone
 import winerror
+import winnt
 from pywin32_testutil import str2bytes, TestSkipped, testmain
 
 try:
@@ -44,6 +46,77 @@ class TestReadBuffer(unittest.TestCase):
         self.assertEqual(buffer[0:2], val)
 
 
+class TestBufferPool(unittest.TestCase):
+
+    def setUp(self):
+        if sys.version_info < (3,):
+            raise TestSkipped("BufferPool requires Python 3")
+
+    def testCounters(self):
+        pool = win32file.BufferPool(100, 2)
+        self.assertEqual(pool.chunk_size, 100)
+        self.assertEqual(pool.count, 2)
+        self.assertEqual(pool.available, 2)
+        a = pool.get()
+        b = pool.get()
+        self.assertEqual(len(a), 100)
+        self.assertFalse(a.readonly)
+        self.assertEqual((pool.hits, pool.misses, pool.outstanding), (2, 0, 2))
+        # pool is empty - this one is allocated outside it.
+        c = pool.get()
+        self.assertEqual((pool.hits, pool.misses, pool.outstanding), (2, 1, 3))
+        self.assertEqual(pool.available, 0)
+        a.release()
+        self.assertEqual(pool.available, 1)
+        del b
+        c.release()
+        self.assertEqual(pool.available, 2)
+        self.assertEqual(pool.outstanding, 0)
+        # and reused.
+        with pool.get() as d:
+            self.assertEqual(pool.hits, 3)
+        self.assertEqual(pool.outstanding, 0)
+
+    def testSliceKeepsChunk(self):
+        pool = win32file.BufferPool(16, 1)
+        view = pool.get()
+        part = view[:4]
+        del view
+        self.assertEqual(pool.outstanding, 1)
+        part[:] = str2bytes("abcd")
+        del part
+        self.assertEqual(pool.outstanding, 0)
+
+    def testReadWrite(self):
+        testName = os.path.join(win32api.GetTempPath(), "win32filetest.dat")
+        pool = win32file.BufferPool(4096, 4)
+        data = str2bytes("hello") * 100
+        h = win32file.CreateFile(testName, win32file.GENERIC_WRITE | win32file.GENERIC_READ,
+                                 0, None, win32file.CREATE_ALWAYS, win32file.FILE_FLAG_OVERLAPPED, None)
+        try:
+            overlapped = pywintypes.OVERLAPPED()
+            overlapped.hEvent = win32event.CreateEvent(None, 0, 0, None)
+            buf = pool.get()
+            buf[:len(data)] = data
+            win32file.WriteFile(h, buf[:len(data)], overlapped)
+            self.assertEqual(win32file.GetOverlappedResult(h, overlapped, True), len(data))
+            buf.release()
+
+            overlapped = pywintypes.OVERLAPPED()
+            overlapped.hEvent = win32event.CreateEvent(None, 0, 0, None)
+            buf = pool.get()
+            hr, got = win32file.ReadFile(h, buf, overlapped)
+            self.assertTrue(got is buf)
+            nbytes = win32file.GetOverlappedResult(h, overlapped, True)
+            self.assertEqual(bytes(buf[:nbytes]), data)
+            buf.release()
+        finally:
+            h.Close()
+            os.unlink(testName)
+        self.assertEqual(pool.outstanding, 0)
+        self.assertEqual(pool.misses, 0)
+
+
 class TestSimpleOps(unittest.TestCase):
 
     def testSimpleFiles(self):
@@ -362,6 +435,46 @@ class TestOverlapped(unittest.TestCase):
         self.assertEqual(errCode, 0)
         self.assertTrue(isinstance(overlapped.object, Foo))
 
+    def testCompletionPortsQueuedEx(self):
+        class Foo:
+            pass
+        io_req_port = win32file.CreateIoCompletionPort(-1, None, 0, 0)
+        try:
+            # nothing queued yet - should timeout with an empty list.
+            self.assertEqual(
+                win32file.GetQueuedCompletionStatusEx(io_req_port, 16, 0), [])
+        except NotImplementedError:
+            raise TestSkipped("GetQueuedCompletionStatusEx needs Vista")
+        overlappeds = []
+        for i in range(5):
+            overlapped = pywintypes.OVERLAPPED()
+            overlapped.object = Foo()
+            overlappeds.append(overlapped)
+            win32file.PostQueuedCompletionStatus(io_req_port, i, 99 + i,
+                                                 overlapped)
+        # and one without an overlapped.
+        win32file.PostQueuedCompletionStatus(io_req_port, 5, 104)
+        got = win32file.GetQueuedCompletionStatusEx(
+            io_req_port, 4, win32event.INFINITE)
+        got += win32file.GetQueuedCompletionStatusEx(
+            io_req_port, 16, win32event.INFINITE)
+        self.assertEqual(len(got), 6)
+        for i, (errCode, nbytes, key, overlapped) in enumerate(got):
+            self.assertEqual(errCode, 0)
+            self.assertEqual(nbytes, i)
+            self.assertEqual(key, 99 + i)
+            if i < 5:
+                self.assertTrue(overlapped is overlappeds[i])
+                self.assertTrue(isinstance(overlapped.object, Foo))
+            else:
+                self.assertTrue(overlapped is None)
+        # The artificial references taken when posting must all be released,
+        # leaving them with the same refcount as one never queued.
+        del got
+        overlappeds.append(pywintypes.OVERLAPPED())
+        refs = [sys.getrefcount(o) for o in overlappeds]
+        self.assertEqual(refs, [refs[-1]] * len(refs))
+
     def _IOCPServerThread(self, handle, port, drop_overlapped_reference):
         overlapped = pywintypes.OVERLAPPED()
         win32pipe.ConnectNamedPipe(handle, overlapped)
@@ -705,6 +818,134 @@ class TestDirectoryChanges(unittest.TestCase):
         self.assertEqual(changes, [(1, "x")])
 
 
+class TestDirectoryWatcher(unittest.TestCase):
+
+    def setUp(self):
+        self.dirs = [tempfile.mkdtemp("-test-directory-watcher-%d" % i)
+                     for i in range(2)]
+        self.watcher = win32file.DirectoryWatcher(Debounce=200)
+
+    def tearDown(self):
+        self.watcher.close()
+        for d in self.dirs:
+            shutil.rmtree(d, True)
+
+    def _get_all(self):
+        # Batches may be split if the test machine is slow - collect until quiet.
+        result = []
+        while True:
+            batch = self.watcher.get(1000)
+            if batch is None:
+                return result
+            result.extend(batch)
+
+    def testBatch(self):
+        ids = [self.watcher.add(d) for d in self.dirs]
+        time.sleep(0.1)
+        for d in self.dirs:
+            fname = os.path.join(d, "test_file")
+            f = open(fname, "w")
+            for i in range(5):
+                f.write("x")
+                f.flush()
+                os.fsync(f.fileno())
+            f.close()
+        # created and removed before the batch was delivered.
+        transient = os.path.join(self.dirs[0], "transient")
+        open(transient, "w").close()
+        os.remove(transient)
+        changes = self._get_all()
+        for id in ids:
+            mine = [c[1:] for c in changes if c[0] == id]
+            self.assertEqual(mine, [(winnt.FILE_ACTION_ADDED, "test_file")])
+
+    def testRemove(self):
+        id = self.watcher.add(self.dirs[0])
+        self.watcher.remove(id)
+        self.assertRaises(ValueError, self.watcher.remove, id)
+        open(os.path.join(self.dirs[0], "test_file"), "w").close()
+        self.assertEqual(self.watcher.get(200), None)
+
+    def testHandle(self):
+        self.watcher.add(self.dirs[0])
+        rc = win32event.WaitForSingleObject(self.watcher.handle, 0)
+        self.assertEqual(rc, win32event.WAIT_TIMEOUT)
+        open(os.path.join(self.dirs[0], "test_file"), "w").close()
+        rc = win32event.WaitForSingleObject(self.watcher.handle, 5000)
+        self.assertEqual(rc, win32event.WAIT_OBJECT_0)
+        self.assertTrue(self.watcher.get(0))
+
+    def testClosed(self):
+        self.watcher.close()
+        self.assertRaises(ValueError, self.watcher.add, self.dirs[0])
+        self.assertRaises(ValueError, self.watcher.get, 0)
+
+    def testBadDir(self):
+        self.assertRaises(win32file.error, self.watcher.add,
+                          os.path.join(self.dirs[0], "no such dir"))
+
+
+class TestFileNotifyDecode(unittest.TestCase):
+    # Synthetic ReadDirectoryChangesW results.
+    def _build(self, records):
+        import struct
+        chunks = []
+        for i, (action, name) in enumerate(records):
+            fname = name.encode("utf-16-le")
+            size = 12 + len(fname)
+            if i == len(records) - 1:
+                offset = 0
+            else:
+                offset = (size + 3) & ~3
+                fname += str2bytes("\0") * (offset - size)
+            chunks.append(struct.pack("<III", offset, action, len(name) * 2) + fname)
+        return str2bytes("").join(chunks)
+
+    def testDecode(self):
+        records = [(1, "a"), (3, "bb"), (2, "ccc")]
+        buf = self._build(records)
+        self.assertEqual(win32file.FILE_NOTIFY_INFORMATION(buf, len(buf)), records)
+        self.assertEqual(list(win32file.FileNotifyIterator(buf)), records)
+        self.assertEqual(list(win32file.FileNotifyIterator(buf, len(buf))), records)
+
+    def testEmpty(self):
+        self.assertEqual(win32file.FILE_NOTIFY_INFORMATION(str2bytes(""), 0), [])
+        self.assertEqual(list(win32file.FileNotifyIterator(str2bytes(""))), [])
+
+    def testLastRecord(self):
+        # The last record's NextEntryOffset used to be checked against the
+        # buffer after stepping to it, so an entry pointing past the end of
+        # the buffer wasn't detected until it had been read.
+        buf = self._build([(1, "a"), (3, "b")])
+        self.assertRaises(RuntimeError, win32file.FILE_NOTIFY_INFORMATION, buf, 16)
+        self.assertRaises(RuntimeError, list, win32file.FileNotifyIterator(buf, 16))
+
+    def testBadNameLength(self):
+        import struct
+        buf = struct.pack("<III", 0, 1, 100) + "a".encode("utf-16-le")
+        self.assertRaises(RuntimeError, win32file.FILE_NOTIFY_INFORMATION, buf, len(buf))
+        self.assertRaises(RuntimeError, list, win32file.FileNotifyIterator(buf))
+
+    def testCoalesce(self):
+        MOD = winnt.FILE_ACTION_MODIFIED
+        records = [(MOD, "a"), (MOD, "b"), (MOD, "a"), (MOD, "a"),
+                   (winnt.FILE_ACTION_REMOVED, "a"), (MOD, "a"), (MOD, "b")]
+        buf = self._build(records)
+        self.assertEqual(list(win32file.FileNotifyIterator(buf)), records)
+        got = list(win32file.FileNotifyIterator(buf, Coalesce=True))
+        self.assertEqual(got, [(MOD, "a"), (MOD, "b"),
+                               (winnt.FILE_ACTION_REMOVED, "a"), (MOD, "a")])
+
+    def testKeptResults(self):
+        # Results are recycled only when nobody else holds them.
+        buf = self._build([(1, "a"), (2, "b")])
+        it = win32file.FileNotifyIterator(buf)
+        first = next(it)
+        second = next(it)
+        self.assertEqual(first, (1, "a"))
+        self.assertEqual(second, (2, "b"))
+
+
 class TestEncrypt(unittest.TestCase):
 
     def testEncrypt(self):
@@ -0,0 +1,106 @@
+import time
+import unittest
+
+import win32pdh
+
+# Counters which exist on every machine, with several instances.
+PROCESSOR_PATH = r"\Processor(*)\% Processor Time"
+PROCESS_PATH = r"\Process(*)\Handle Count"
+
+
+class TestCounterArrays(unittest.TestCase):
+
+    def setUp(self):
+        self.query = win32pdh.OpenQuery()
+        self.processor = win32pdh.AddEnglishCounter(self.query, PROCESSOR_PATH)
+        self.process = win32pdh.AddEnglishCounter(self.query, PROCESS_PATH)
+        # Rates need two collections.
+        win32pdh.CollectQueryData(self.query)
+        time.sleep(0.1)
+        win32pdh.CollectQueryData(self.query)
+
+    def tearDown(self):
+        win32pdh.CloseQuery(self.query)
+
+    def testFormatted(self):
+        items = win32pdh.GetFormattedCounterArray(self.processor, win32pdh.PDH_FMT_DOUBLE)
+        names = [name for name, value in items]
+        self.assertTrue("_Total" in names)
+        for name, value in items:
+            self.assertTrue(value is None or isinstance(value, float))
+        items = win32pdh.GetFormattedCounterArray(self.process, win32pdh.PDH_FMT_LARGE)
+        self.assertTrue(len(items) > 1)
+        self.assertRaises(ValueError, win32pdh.GetFormattedCounterArray,
+                          self.process, 0)
+
+    def testRaw(self):
+        items = win32pdh.GetRawCounterArray(self.process)
+        self.assertTrue(len(items) > 1)
+        for name, status, timeStamp, first, second, multiCount in items:
+            self.assertEqual(status, 0)
+            self.assertTrue(timeStamp > 0)
+
+    def testSnapshot(self):
+        counters = [self.processor, self.process]
+        snap1 = win32pdh.CollectQuerySnapshot(self.query, counters)
+        snap2 = win32pdh.CollectQuerySnapshot(self.query, counters,
+                                              Format=win32pdh.PDH_FMT_LARGE)
+        self.assertEqual(len(snap1), 2)
+        names1, values1 = snap1[0]
+        names2, values2 = snap2[0]
+        self.assertEqual(len(names1), len(values1))
+        self.assertTrue("_Total" in names1)
+        # Instance names are shared between snapshots.
+        self.assertTrue(names1[names1.index("_Total")] is
+                        names2[names2.index("_Total")])
+
+
+class TestSampler(unittest.TestCase):
+
+    def setUp(self):
+        self.query = win32pdh.OpenQuery()
+        self.counters = [
+            win32pdh.AddEnglishCounter(self.query, PROCESSOR_PATH),
+            win32pdh.AddEnglishCounter(self.query, PROCESS_PATH)]
+
+    def tearDown(self):
+        win32pdh.CloseQuery(self.query)
+
+    def testGet(self):
+        sampler = win32pdh.Sampler(self.query, self.counters, Interval=50)
+        try:
+            snapshots = []
+            while len(snapshots) < 3:
+                got = sampler.Get(5000)
+                self.assertTrue(got)
+                snapshots.extend(got)
+            for when, counters in snapshots:
+                self.assertEqual(len(counters), 2)
+            # The same names are returned as the same tuple.
+            last = snapshots[-1][1][0]
+            self.assertTrue(snapshots[-2][1][0][0] is last[0])
+        finally:
+            sampler.Close()
+        self.assertRaises(ValueError, sampler.Get, 0)
+
+    def testDepth(self):
+        sampler = win32pdh.Sampler(self.query, self.counters, Interval=10, Depth=2)
+        try:
+            time.sleep(0.5)
+            self.assertEqual(sampler.Queued, 2)
+            self.assertTrue(sampler.Dropped > 0)
+            self.assertEqual(len(sampler.Get(0)), 2)
+        finally:
+            sampler.Close()
+
+    def testTimeout(self):
+        sampler = win32pdh.Sampler(self.query, self.counters, Interval=60000)
+        try:
+            self.assertEqual(len(sampler.Get(5000)), 1)
+            self.assertEqual(sampler.Get(10), None)
+        finally:
+            sampler.Close()
+
+
+if __name__ == '__main__':
+    unittest.main()
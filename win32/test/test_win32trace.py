@@ -129,6 +129,49 @@ class TestModuleOps(BasicSetupTearDown):
         win32trace.flush()
 
 
+class TestRing(BasicSetupTearDown):
+
+    def testReadRecords(self):
+        win32trace.write('one')
+        win32trace.write('two')
+        records = win32trace.readrecords()
+        self.assertEqual([r[4] for r in records], ['one', 'two'])
+        (seq1, pid1, tid1, time1, _), (seq2, pid2, tid2, time2, _) = records
+        self.assertEqual(seq2, seq1 + 1)
+        self.assertEqual((pid1, tid1), (os.getpid(), threading.current_thread().ident))
+        self.assertEqual((pid2, tid2), (pid1, tid1))
+        self.assertTrue(time1 <= time2)
+        self.assertEqual(win32trace.readrecords(), [])
+        self.assertEqual(win32trace.read(), '')
+
+    def testHugeWriteIsSplit(self):
+        data = ''.join(chr(ord('a') + i % 26) for i in range(300000))
+        win32trace.write(data)
+        records = win32trace.readrecords()
+        self.assertTrue(len(records) > 1)
+        self.assertEqual(''.join(r[4] for r in records), data)
+
+    def testDroppedWhenFull(self):
+        stats = win32trace.GetStats()
+        self.assertEqual(stats['pending'], 0)
+        chunk = 'x' * 1000
+        # Fill the buffer twice over without reading - writers must never
+        # block, and what doesn't fit is counted rather than lost silently.
+        count = 2 * stats['size'] // len(chunk)
+        for i in range(count):
+            win32trace.write(chunk)
+        after = win32trace.GetStats()
+        dropped = after['dropped_bytes'] - stats['dropped_bytes']
+        self.assertTrue(dropped > 0)
+        self.assertTrue(after['dropped_records'] > stats['dropped_records'])
+        got = win32trace.read()
+        self.assertEqual(len(got) + dropped, count * len(chunk))
+        self.assertEqual(win32trace.GetStats()['pending'], 0)
+        # Once read, there is room again.
+        win32trace.write('more')
+        self.assertEqual(win32trace.read(), 'more')
+
+
 class TestTraceObjectOps(BasicSetupTearDown):
 
     def testInit(self):